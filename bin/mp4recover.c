@@ -0,0 +1,866 @@
+/*****************************************************************************
+ * mp4recover.c: rebuilds the index of interrupted MP4 recordings
+ *****************************************************************************
+ * Copyright (C) 2020 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/* Files recorded by the MP4 muxer with an expected duration start with the
+ * moov of the empty tracks, in the space reserved for the index. If the
+ * recording is interrupted, this tool scans the mdat for the index
+ * checkpoints (see mp4journal.h), and writes back the moov with the sample
+ * tables of all the checkpointed samples. */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "../modules/mux/mp4/mp4journal.h"
+
+#define SCAN_CHUNK      (1 << 20)
+#define MAX_RECORD_SIZE (64 << 20)
+
+typedef struct
+{
+    uint64_t i_pos;
+    uint32_t i_size;
+    uint32_t i_duration;
+    int32_t  i_offset;
+    uint32_t i_flags;
+} sample_t;
+
+typedef struct
+{
+    uint32_t  i_id;
+    uint32_t  i_timescale;
+    int64_t   i_start;
+    bool      b_start;
+
+    sample_t *p_samples;
+    size_t    i_samples;
+    size_t    i_max;
+
+    uint64_t  i_duration; /* in the track timescale */
+} track_t;
+
+typedef struct
+{
+    uint8_t *p;
+    size_t   i_size;
+    size_t   i_max;
+    bool     b_error;
+} buffer_t;
+
+typedef struct
+{
+    FILE     *file;
+    uint64_t  i_file_size;
+
+    uint64_t  i_moov_pos;
+    uint64_t  i_moov_size;
+    uint64_t  i_reserved;  /* moov and the free boxes following it */
+    uint64_t  i_mdat_pos;  /* of the mdat header, or of the preceding wide box */
+    uint64_t  i_data_pos;
+
+    uint8_t  *p_moov;
+    uint32_t  i_movie_timescale;
+
+    track_t  *p_tracks;
+    unsigned  i_tracks;
+    unsigned  i_trak;      /* while rebuilding */
+} recover_t;
+
+static uint32_t GetDW(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static uint64_t GetQW(const uint8_t *p)
+{
+    return ((uint64_t)GetDW(p) << 32) | GetDW(p + 4);
+}
+
+static void SetDW(uint8_t *p, uint32_t i)
+{
+    p[0] = i >> 24; p[1] = i >> 16; p[2] = i >> 8; p[3] = i;
+}
+
+static void SetQW(uint8_t *p, uint64_t i)
+{
+    SetDW(p, i >> 32);
+    SetDW(p + 4, i);
+}
+
+/*****************************************************************************
+ * Output buffer
+ *****************************************************************************/
+static uint8_t *buffer_Grow(buffer_t *b, size_t i_size)
+{
+    if (b->b_error)
+        return NULL;
+    if (b->i_size + i_size > b->i_max)
+    {
+        size_t i_max = (b->i_size + i_size) * 2;
+        uint8_t *p = realloc(b->p, i_max);
+        if (!p)
+        {
+            b->b_error = true;
+            return NULL;
+        }
+        b->p = p;
+        b->i_max = i_max;
+    }
+    uint8_t *p = &b->p[b->i_size];
+    b->i_size += i_size;
+    return p;
+}
+
+static void buffer_Add(buffer_t *b, const void *p_data, size_t i_size)
+{
+    uint8_t *p = buffer_Grow(b, i_size);
+    if (p)
+        memcpy(p, p_data, i_size);
+}
+
+static void buffer_Add32(buffer_t *b, uint32_t i)
+{
+    uint8_t *p = buffer_Grow(b, 4);
+    if (p)
+        SetDW(p, i);
+}
+
+static void buffer_Add64(buffer_t *b, uint64_t i)
+{
+    uint8_t *p = buffer_Grow(b, 8);
+    if (p)
+        SetQW(p, i);
+}
+
+static size_t box_Start(buffer_t *b, const char *psz_type)
+{
+    size_t i_start = b->i_size;
+    buffer_Add32(b, 0);
+    buffer_Add(b, psz_type, 4);
+    return i_start;
+}
+
+static size_t fullbox_Start(buffer_t *b, const char *psz_type, uint8_t i_version)
+{
+    size_t i_start = box_Start(b, psz_type);
+    buffer_Add32(b, (uint32_t)i_version << 24);
+    return i_start;
+}
+
+static void box_End(buffer_t *b, size_t i_start)
+{
+    if (!b->b_error)
+        SetDW(&b->p[i_start], b->i_size - i_start);
+}
+
+/*****************************************************************************
+ * File
+ *****************************************************************************/
+static bool ReadAt(recover_t *r, uint64_t i_pos, void *p, size_t i_size)
+{
+    return fseeko(r->file, i_pos, SEEK_SET) == 0 &&
+           fread(p, 1, i_size, r->file) == i_size;
+}
+
+static bool WriteAt(recover_t *r, uint64_t i_pos, const void *p, size_t i_size)
+{
+    return fseeko(r->file, i_pos, SEEK_SET) == 0 &&
+           fwrite(p, 1, i_size, r->file) == i_size;
+}
+
+/* Finds the moov, the space reserved for it, and the mdat */
+static bool ReadLayout(recover_t *r)
+{
+    uint64_t i_pos = 0, i_wide_end = UINT64_MAX;
+
+    while (i_pos + 8 <= r->i_file_size)
+    {
+        uint8_t hdr[16];
+        if (!ReadAt(r, i_pos, hdr, 8))
+            return false;
+
+        uint64_t i_size = GetDW(hdr);
+        const bool b_to_end = i_size == 0;
+        unsigned i_header = 8;
+        if (i_size == 1)
+        {
+            if (!ReadAt(r, i_pos + 8, &hdr[8], 8))
+                return false;
+            i_size = GetQW(&hdr[8]);
+            i_header = 16;
+        }
+        else if (i_size == 0)
+            i_size = r->i_file_size - i_pos;
+
+        if (!memcmp(&hdr[4], "mdat", 4))
+        {
+            /* the muxer reserves 16 bytes for the mdat header: until the
+             * first checkpoint, a size up to the end of the file and 8
+             * bytes of padding, then either a wide box and a 32 bits
+             * size, or a 64 bits size */
+            if (i_wide_end == i_pos)
+            {
+                r->i_mdat_pos = i_pos - 8;
+                r->i_data_pos = i_pos + 8;
+            }
+            else if (i_header == 16 || b_to_end)
+            {
+                r->i_mdat_pos = i_pos;
+                r->i_data_pos = i_pos + 16;
+            }
+            else
+            {
+                fprintf(stderr, "mdat size cannot be updated\n");
+                return false;
+            }
+            return r->i_moov_size > 0;
+        }
+
+        if (i_size < i_header)
+            break;
+
+        if (!memcmp(&hdr[4], "moov", 4) && !r->i_moov_size)
+        {
+            r->i_moov_pos = i_pos;
+            r->i_moov_size = i_size;
+            r->i_reserved = i_size;
+        }
+        else if ((!memcmp(&hdr[4], "free", 4) || !memcmp(&hdr[4], "skip", 4)) &&
+                 r->i_moov_size && r->i_moov_pos + r->i_reserved == i_pos)
+            r->i_reserved += i_size;
+        else if (!memcmp(&hdr[4], "wide", 4) && i_size == 8)
+            i_wide_end = i_pos + 8;
+
+        i_pos += i_size;
+    }
+    return false;
+}
+
+/*****************************************************************************
+ * moov parsing
+ *****************************************************************************/
+/* Finds the first child box of that type, within [p, p + i_size) */
+static const uint8_t *FindBox(const uint8_t *p, size_t i_size,
+                              const char *psz_type, size_t *pi_box)
+{
+    while (i_size >= 8)
+    {
+        size_t i_box = GetDW(p);
+        if (i_box < 8 || i_box > i_size)
+            return NULL;
+        if (!memcmp(&p[4], psz_type, 4))
+        {
+            *pi_box = i_box;
+            return p;
+        }
+        p += i_box;
+        i_size -= i_box;
+    }
+    return NULL;
+}
+
+static const uint8_t *FindPath(const uint8_t *p, size_t i_size,
+                               const char *const *ppsz_path, size_t *pi_box)
+{
+    for (; *ppsz_path; ppsz_path++)
+    {
+        p = FindBox(p, i_size, *ppsz_path, &i_size);
+        if (!p)
+            return NULL;
+        if (ppsz_path[1])
+        {
+            p += 8;
+            i_size -= 8;
+        }
+    }
+    *pi_box = i_size;
+    return p;
+}
+
+static bool ParseMoov(recover_t *r)
+{
+    const uint8_t *p_moov = r->p_moov + 8;
+    size_t i_moov = r->i_moov_size - 8;
+    size_t i_box;
+
+    if (FindBox(p_moov, i_moov, "mvex", &i_box))
+    {
+        fprintf(stderr, "fragmented file, nothing to recover\n");
+        return false;
+    }
+
+    const uint8_t *p_mvhd = FindBox(p_moov, i_moov, "mvhd", &i_box);
+    if (!p_mvhd || i_box < 32)
+        return false;
+    r->i_movie_timescale = GetDW(&p_mvhd[p_mvhd[8] == 1 ? 28 : 20]);
+
+    const uint8_t *p_trak = p_moov;
+    size_t i_left = i_moov;
+    while ((p_trak = FindBox(p_trak, i_left, "trak", &i_box)))
+    {
+        static const char *const tkhd_path[] = { "tkhd", NULL };
+        static const char *const mdhd_path[] = { "mdia", "mdhd", NULL };
+        static const char *const stsz_path[] = { "mdia", "minf", "stbl", "stsz", NULL };
+        size_t i_tkhd, i_mdhd, i_stsz;
+
+        const uint8_t *p_tkhd = FindPath(p_trak + 8, i_box - 8, tkhd_path, &i_tkhd);
+        const uint8_t *p_mdhd = FindPath(p_trak + 8, i_box - 8, mdhd_path, &i_mdhd);
+        const uint8_t *p_stsz = FindPath(p_trak + 8, i_box - 8, stsz_path, &i_stsz);
+        if (!p_tkhd || i_tkhd < 32 || !p_mdhd || i_mdhd < 32)
+            return false;
+        if (p_stsz && i_stsz >= 20 && GetDW(&p_stsz[16]))
+        {
+            fprintf(stderr, "file is already indexed, nothing to recover\n");
+            return false;
+        }
+
+        track_t *p_tracks = realloc(r->p_tracks, (r->i_tracks + 1) * sizeof(*p_tracks));
+        if (!p_tracks)
+            return false;
+        r->p_tracks = p_tracks;
+
+        track_t *tk = &r->p_tracks[r->i_tracks++];
+        memset(tk, 0, sizeof(*tk));
+        tk->i_id = GetDW(&p_tkhd[p_tkhd[8] == 1 ? 28 : 20]);
+        tk->i_timescale = GetDW(&p_mdhd[p_mdhd[8] == 1 ? 28 : 20]);
+        if (!tk->i_timescale)
+            return false;
+
+        i_left -= p_trak + i_box - p_moov;
+        p_trak += i_box;
+        p_moov = p_trak;
+    }
+
+    return r->i_tracks > 0;
+}
+
+/*****************************************************************************
+ * Checkpoints
+ *****************************************************************************/
+static track_t *GetTrack(recover_t *r, uint32_t i_id)
+{
+    for (unsigned i = 0; i < r->i_tracks; i++)
+        if (r->p_tracks[i].i_id == i_id)
+            return &r->p_tracks[i];
+    return NULL;
+}
+
+static bool ParseCheckpoint(recover_t *r, const uint8_t *p, size_t i_size)
+{
+    if (GetDW(&p[MP4_JOURNAL_MAGIC_SIZE + 4]) != MP4_JOURNAL_VERSION)
+        return false;
+
+    unsigned i_tracks = GetDW(&p[MP4_JOURNAL_MAGIC_SIZE + 12]);
+    p += MP4_JOURNAL_HEADER_SIZE;
+    i_size -= MP4_JOURNAL_HEADER_SIZE + 4;
+
+    for (unsigned i = 0; i < i_tracks; i++)
+    {
+        if (i_size < MP4_JOURNAL_TRACK_SIZE)
+            return false;
+        track_t *tk = GetTrack(r, GetDW(p));
+        int64_t i_start = GetQW(&p[4]);
+        size_t i_samples = GetDW(&p[12]);
+        p += MP4_JOURNAL_TRACK_SIZE;
+        i_size -= MP4_JOURNAL_TRACK_SIZE;
+
+        if (i_size / MP4_JOURNAL_SAMPLE_SIZE < i_samples)
+            return false;
+
+        if (tk && i_samples)
+        {
+            if (!tk->b_start)
+            {
+                tk->i_start = i_start;
+                tk->b_start = true;
+            }
+            if (tk->i_samples + i_samples > tk->i_max)
+            {
+                size_t i_max = (tk->i_samples + i_samples) * 2;
+                sample_t *p_samples = realloc(tk->p_samples, i_max * sizeof(*p_samples));
+                if (!p_samples)
+                    return false;
+                tk->p_samples = p_samples;
+                tk->i_max = i_max;
+            }
+            for (size_t j = 0; j < i_samples; j++)
+            {
+                const uint8_t *s = &p[j * MP4_JOURNAL_SAMPLE_SIZE];
+                sample_t *sample = &tk->p_samples[tk->i_samples];
+                sample->i_pos = GetQW(s);
+                sample->i_size = GetDW(&s[8]);
+                sample->i_duration = GetDW(&s[12]);
+                sample->i_offset = (int32_t)GetDW(&s[16]);
+                sample->i_flags = GetDW(&s[20]);
+                if (sample->i_pos < r->i_data_pos ||
+                    sample->i_pos + sample->i_size > r->i_file_size)
+                    continue;
+                tk->i_samples++;
+            }
+        }
+        p += i_samples * MP4_JOURNAL_SAMPLE_SIZE;
+        i_size -= i_samples * MP4_JOURNAL_SAMPLE_SIZE;
+    }
+    return true;
+}
+
+/* Reads the checkpoint at that position, and returns its size, or 0 */
+static size_t ReadCheckpoint(recover_t *r, uint64_t i_pos)
+{
+    uint8_t hdr[MP4_JOURNAL_HEADER_SIZE];
+    if (i_pos + MP4_JOURNAL_HEADER_SIZE + 4 > r->i_file_size ||
+        !ReadAt(r, i_pos, hdr, sizeof(hdr)))
+        return 0;
+
+    size_t i_size = GetDW(&hdr[MP4_JOURNAL_MAGIC_SIZE]);
+    if (i_size < MP4_JOURNAL_HEADER_SIZE + 4 || i_size > MAX_RECORD_SIZE ||
+        i_pos + i_size > r->i_file_size)
+        return 0;
+
+    uint8_t *p = malloc(i_size);
+    if (!p)
+        return 0;
+    if (!ReadAt(r, i_pos, p, i_size) ||
+        mp4_journal_crc(0, &p[MP4_JOURNAL_MAGIC_SIZE],
+                        i_size - MP4_JOURNAL_MAGIC_SIZE - 4) != GetDW(&p[i_size - 4]) ||
+        !ParseCheckpoint(r, p, i_size))
+        i_size = 0;
+    free(p);
+    return i_size;
+}
+
+static unsigned ScanCheckpoints(recover_t *r)
+{
+    uint8_t *p_buf = malloc(SCAN_CHUNK);
+    if (!p_buf)
+        return 0;
+
+    unsigned i_count = 0;
+    uint64_t i_pos = r->i_data_pos;
+    while (i_pos + MP4_JOURNAL_MAGIC_SIZE <= r->i_file_size)
+    {
+        size_t i_read = SCAN_CHUNK;
+        if (i_read > r->i_file_size - i_pos)
+            i_read = r->i_file_size - i_pos;
+        if (!ReadAt(r, i_pos, p_buf, i_read))
+            break;
+
+        uint64_t i_next = i_pos + i_read - (MP4_JOURNAL_MAGIC_SIZE - 1);
+        const uint8_t *p = p_buf;
+        const uint8_t *p_end = &p_buf[i_read - MP4_JOURNAL_MAGIC_SIZE + 1];
+        while ((p = memchr(p, MP4_JOURNAL_MAGIC[0], p_end - p)))
+        {
+            if (!memcmp(p, MP4_JOURNAL_MAGIC, MP4_JOURNAL_MAGIC_SIZE))
+            {
+                uint64_t i_record = i_pos + (p - p_buf);
+                size_t i_size = ReadCheckpoint(r, i_record);
+                if (i_size)
+                {
+                    i_count++;
+                    i_next = i_record + i_size;
+                    break;
+                }
+            }
+            p++;
+        }
+        if (i_read < MP4_JOURNAL_MAGIC_SIZE || i_next <= i_pos)
+            break;
+        i_pos = i_next;
+    }
+
+    free(p_buf);
+    return i_count;
+}
+
+/*****************************************************************************
+ * moov rebuilding
+ *****************************************************************************/
+static void AddSampleTables(buffer_t *b, const track_t *tk, bool b_co64)
+{
+    /* durations, compensating the drift as the muxer does */
+    size_t i_stts = fullbox_Start(b, "stts", 0);
+    size_t i_count_pos = b->i_size;
+    buffer_Add32(b, 0);
+    uint32_t i_entries = 0;
+    uint64_t i_total_us = 0, i_total_scaled = 0;
+    for (size_t i = 0; i < tk->i_samples; )
+    {
+        uint32_t i_delta = 0, i_run = 0;
+        for (; i < tk->i_samples; i++)
+        {
+            uint64_t i_end = (i_total_us + tk->p_samples[i].i_duration) *
+                             tk->i_timescale / 1000000;
+            uint32_t i_scaled = i_end - i_total_scaled;
+            if (i_run && i_scaled != i_delta)
+                break;
+            i_delta = i_scaled;
+            i_run++;
+            i_total_us += tk->p_samples[i].i_duration;
+            i_total_scaled = i_end;
+        }
+        buffer_Add32(b, i_run);
+        buffer_Add32(b, i_delta);
+        i_entries++;
+    }
+    if (!b->b_error)
+        SetDW(&b->p[i_count_pos], i_entries);
+    box_End(b, i_stts);
+
+    /* sync samples, unless they all are */
+    size_t i_sync = 0;
+    for (size_t i = 0; i < tk->i_samples; i++)
+        if (tk->p_samples[i].i_flags & MP4_JOURNAL_SAMPLE_SYNC)
+            i_sync++;
+    if (i_sync && i_sync < tk->i_samples)
+    {
+        size_t i_stss = fullbox_Start(b, "stss", 0);
+        buffer_Add32(b, i_sync);
+        for (size_t i = 0; i < tk->i_samples; i++)
+            if (tk->p_samples[i].i_flags & MP4_JOURNAL_SAMPLE_SYNC)
+                buffer_Add32(b, i + 1);
+        box_End(b, i_stss);
+    }
+
+    /* composition offsets */
+    bool b_ctts = false;
+    for (size_t i = 0; i < tk->i_samples && !b_ctts; i++)
+        b_ctts = tk->p_samples[i].i_offset != 0;
+    if (b_ctts)
+    {
+        size_t i_ctts = fullbox_Start(b, "ctts", 0);
+        i_count_pos = b->i_size;
+        buffer_Add32(b, 0);
+        i_entries = 0;
+        for (size_t i = 0; i < tk->i_samples; )
+        {
+            int32_t i_offset = tk->p_samples[i].i_offset;
+            size_t i_first = i;
+            while (i < tk->i_samples && tk->p_samples[i].i_offset == i_offset)
+                i++;
+            buffer_Add32(b, i - i_first);
+            buffer_Add32(b, (int64_t)i_offset * tk->i_timescale / 1000000);
+            i_entries++;
+        }
+        if (!b->b_error)
+            SetDW(&b->p[i_count_pos], i_entries);
+        box_End(b, i_ctts);
+    }
+
+    /* chunks are the runs of contiguous samples */
+    size_t i_stsc = fullbox_Start(b, "stsc", 0);
+    i_count_pos = b->i_size;
+    buffer_Add32(b, 0);
+    i_entries = 0;
+    uint32_t i_chunks = 0, i_last_run = 0;
+    for (size_t i = 0; i < tk->i_samples; i_chunks++)
+    {
+        size_t i_first = i;
+        for (i++; i < tk->i_samples; i++)
+            if (tk->p_samples[i - 1].i_pos + tk->p_samples[i - 1].i_size !=
+                tk->p_samples[i].i_pos)
+                break;
+        if (i - i_first != i_last_run)
+        {
+            buffer_Add32(b, i_chunks + 1);
+            buffer_Add32(b, i - i_first);
+            buffer_Add32(b, 1);
+            i_last_run = i - i_first;
+            i_entries++;
+        }
+    }
+    if (!b->b_error)
+        SetDW(&b->p[i_count_pos], i_entries);
+    box_End(b, i_stsc);
+
+    size_t i_stsz = fullbox_Start(b, "stsz", 0);
+    buffer_Add32(b, 0);
+    buffer_Add32(b, tk->i_samples);
+    for (size_t i = 0; i < tk->i_samples; i++)
+        buffer_Add32(b, tk->p_samples[i].i_size);
+    box_End(b, i_stsz);
+
+    size_t i_stco = fullbox_Start(b, b_co64 ? "co64" : "stco", 0);
+    buffer_Add32(b, i_chunks);
+    for (size_t i = 0; i < tk->i_samples; )
+    {
+        if (b_co64)
+            buffer_Add64(b, tk->p_samples[i].i_pos);
+        else
+            buffer_Add32(b, tk->p_samples[i].i_pos);
+        for (i++; i < tk->i_samples; i++)
+            if (tk->p_samples[i - 1].i_pos + tk->p_samples[i - 1].i_size !=
+                tk->p_samples[i].i_pos)
+                break;
+    }
+    box_End(b, i_stco);
+}
+
+/* Patches the duration of a mvhd, tkhd or mdhd box */
+static void SetHeaderDuration(uint8_t *p, uint64_t i_duration)
+{
+    if (p[8] == 1)
+        SetQW(&p[p[4] == 't' ? 36 : 32], i_duration);
+    else
+        SetDW(&p[p[4] == 't' ? 28 : 24], i_duration > UINT32_MAX ? UINT32_MAX : i_duration);
+}
+
+static uint64_t MovieDuration(const recover_t *r, const track_t *tk)
+{
+    uint64_t i_media = tk->i_duration * r->i_movie_timescale / tk->i_timescale;
+    return i_media + tk->i_start * r->i_movie_timescale / 1000000;
+}
+
+static void AddEdits(buffer_t *b, const recover_t *r, const track_t *tk)
+{
+    size_t i_edts = box_Start(b, "edts");
+    size_t i_elst = fullbox_Start(b, "elst", 0);
+    buffer_Add32(b, 2);
+    /* empty edit, then the media from its start */
+    buffer_Add32(b, tk->i_start * r->i_movie_timescale / 1000000);
+    buffer_Add32(b, UINT32_MAX);
+    buffer_Add32(b, 0x10000);
+    buffer_Add32(b, tk->i_duration * r->i_movie_timescale / tk->i_timescale);
+    buffer_Add32(b, 0);
+    buffer_Add32(b, 0x10000);
+    box_End(b, i_elst);
+    box_End(b, i_edts);
+}
+
+static void RebuildBox(buffer_t *b, recover_t *r, const uint8_t *p, size_t i_size,
+                       bool b_co64)
+{
+    static const char containers[][5] = { "moov", "trak", "mdia", "minf", "stbl" };
+
+    while (i_size >= 8)
+    {
+        size_t i_box = GetDW(p);
+        if (i_box < 8 || i_box > i_size)
+            break;
+
+        bool b_container = false;
+        for (size_t i = 0; i < sizeof(containers) / sizeof(containers[0]); i++)
+            b_container |= !memcmp(&p[4], containers[i], 4);
+
+        track_t *tk = r->i_trak < r->i_tracks ? &r->p_tracks[r->i_trak] : NULL;
+
+        if (b_container)
+        {
+            size_t i_start = box_Start(b, (const char *)&p[4]);
+            RebuildBox(b, r, p + 8, i_box - 8, b_co64);
+            if (!memcmp(&p[4], "stbl", 4) && tk)
+                AddSampleTables(b, tk, b_co64);
+            box_End(b, i_start);
+            if (!memcmp(&p[4], "trak", 4))
+                r->i_trak++;
+        }
+        else if (!memcmp(&p[4], "stts", 4) || !memcmp(&p[4], "stss", 4) ||
+                 !memcmp(&p[4], "ctts", 4) || !memcmp(&p[4], "stsc", 4) ||
+                 !memcmp(&p[4], "stsz", 4) || !memcmp(&p[4], "stco", 4) ||
+                 !memcmp(&p[4], "co64", 4) || !memcmp(&p[4], "edts", 4))
+            ; /* rebuilt */
+        else
+        {
+            size_t i_start = b->i_size;
+            buffer_Add(b, p, i_box);
+            if (!b->b_error && i_box >= 32)
+            {
+                uint8_t *p_copy = &b->p[i_start];
+                if (!memcmp(&p[4], "mvhd", 4))
+                {
+                    uint64_t i_duration = 0;
+                    for (unsigned i = 0; i < r->i_tracks; i++)
+                        if (MovieDuration(r, &r->p_tracks[i]) > i_duration)
+                            i_duration = MovieDuration(r, &r->p_tracks[i]);
+                    SetHeaderDuration(p_copy, i_duration);
+                }
+                else if (!memcmp(&p[4], "tkhd", 4) && tk)
+                {
+                    SetHeaderDuration(p_copy, MovieDuration(r, tk));
+                    if (tk->i_start > 0)
+                        AddEdits(b, r, tk);
+                }
+                else if (!memcmp(&p[4], "mdhd", 4) && tk)
+                    SetHeaderDuration(p_copy, tk->i_duration);
+            }
+        }
+
+        p += i_box;
+        i_size -= i_box;
+    }
+}
+
+static bool WriteIndex(recover_t *r, const buffer_t *b)
+{
+    /* the mdat now ends with the file */
+    uint64_t i_mdat_size = r->i_file_size - r->i_mdat_pos;
+    uint8_t hdr[16];
+    if (i_mdat_size >= ((uint64_t)1 << 32))
+    {
+        SetDW(hdr, 1);
+        memcpy(&hdr[4], "mdat", 4);
+        SetQW(&hdr[8], i_mdat_size);
+    }
+    else
+    {
+        SetDW(hdr, 8);
+        memcpy(&hdr[4], "wide", 4);
+        SetDW(&hdr[8], i_mdat_size - 8);
+        memcpy(&hdr[12], "mdat", 4);
+    }
+    if (!WriteAt(r, r->i_mdat_pos, hdr, sizeof(hdr)))
+        return false;
+
+    if (b->i_size == r->i_reserved || b->i_size + 8 <= r->i_reserved)
+    {
+        if (!WriteAt(r, r->i_moov_pos, b->p, b->i_size))
+            return false;
+        if (b->i_size < r->i_reserved)
+        {
+            SetDW(hdr, r->i_reserved - b->i_size);
+            memcpy(&hdr[4], "free", 4);
+            if (fwrite(hdr, 1, 8, r->file) != 8)
+                return false;
+        }
+    }
+    else
+    {
+        /* does not fit, append it and turn the old one into a free box */
+        if (!WriteAt(r, r->i_file_size, b->p, b->i_size) ||
+            !WriteAt(r, r->i_moov_pos + 4, "free", 4))
+            return false;
+    }
+    return fflush(r->file) == 0;
+}
+
+/*****************************************************************************
+ * main
+ *****************************************************************************/
+static void Usage(const char *psz_name)
+{
+    fprintf(stderr, "Usage: %s [-n] <file.mp4>\n"
+            "Rebuilds the index of an interrupted MP4 recording, in place.\n"
+            "  -n  only report what can be recovered\n", psz_name);
+}
+
+int main(int argc, char **argv)
+{
+    bool b_dry_run = false;
+    const char *psz_file = NULL;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-n"))
+            b_dry_run = true;
+        else if (!psz_file && argv[i][0] != '-')
+            psz_file = argv[i];
+        else
+        {
+            Usage(argv[0]);
+            return 1;
+        }
+    }
+    if (!psz_file)
+    {
+        Usage(argv[0]);
+        return 1;
+    }
+
+    recover_t r;
+    memset(&r, 0, sizeof(r));
+    r.file = fopen(psz_file, b_dry_run ? "rb" : "r+b");
+    if (!r.file)
+    {
+        perror(psz_file);
+        return 1;
+    }
+
+    int i_ret = 1;
+    buffer_t b = { NULL, 0, 0, false };
+
+    if (fseeko(r.file, 0, SEEK_END) || (int64_t)(r.i_file_size = ftello(r.file)) < 0)
+        goto error;
+
+    if (!ReadLayout(&r))
+    {
+        fprintf(stderr, "%s: not a recording with a reserved index\n", psz_file);
+        goto error;
+    }
+
+    r.p_moov = malloc(r.i_moov_size);
+    if (!r.p_moov || !ReadAt(&r, r.i_moov_pos, r.p_moov, r.i_moov_size) ||
+        !ParseMoov(&r))
+        goto error;
+
+    unsigned i_checkpoints = ScanCheckpoints(&r);
+    size_t i_samples = 0;
+    bool b_co64 = false;
+    for (unsigned i = 0; i < r.i_tracks; i++)
+    {
+        track_t *tk = &r.p_tracks[i];
+        uint64_t i_total_us = 0;
+        for (size_t j = 0; j < tk->i_samples; j++)
+            i_total_us += tk->p_samples[j].i_duration;
+        tk->i_duration = i_total_us * tk->i_timescale / 1000000;
+
+        i_samples += tk->i_samples;
+        if (tk->i_samples &&
+            tk->p_samples[tk->i_samples - 1].i_pos >= ((uint64_t)1 << 32))
+            b_co64 = true;
+    }
+    printf("%s: %u checkpoints, %zu samples in %u tracks\n",
+           psz_file, i_checkpoints, i_samples, r.i_tracks);
+    if (!i_samples)
+        goto error;
+
+    RebuildBox(&b, &r, r.p_moov, r.i_moov_size, b_co64);
+    if (b.b_error)
+        goto error;
+
+    for (unsigned i = 0; i < r.i_tracks; i++)
+        printf("track %"PRIu32": %zu samples, %.3fs\n", r.p_tracks[i].i_id,
+               r.p_tracks[i].i_samples,
+               (double)r.p_tracks[i].i_duration / r.p_tracks[i].i_timescale);
+
+    if (b_dry_run)
+        i_ret = 0;
+    else if (WriteIndex(&r, &b))
+    {
+        printf("%s: index written\n", psz_file);
+        i_ret = 0;
+    }
+    else
+        perror(psz_file);
+
+error:
+    free(b.p);
+    for (unsigned i = 0; i < r.i_tracks; i++)
+        free(r.p_tracks[i].p_samples);
+    free(r.p_tracks);
+    free(r.p_moov);
+    fclose(r.file);
+    return i_ret;
+}
@@ -26,6 +26,8 @@
 #ifndef VLC_LIBVLC_MEDIA_H
 #define VLC_LIBVLC_MEDIA_H 1
 
+#include <vlc/libvlc_picture.h>
+
 # ifdef __cplusplus
 extern "C" {
 # endif
@@ -884,6 +886,91 @@ LIBVLC_API
 void libvlc_media_slaves_release( libvlc_media_slave_t **pp_slaves,
                                   unsigned int i_count );
 
+/**
+ * Seeking mode of a thumbnail request
+ */
+typedef enum libvlc_thumbnailer_seek_speed_t
+{
+    /** Use the first picture displayed at or after the requested time */
+    libvlc_media_thumbnail_seek_precise,
+    /** Use the key frame nearest to the requested time or position */
+    libvlc_media_thumbnail_seek_fast,
+} libvlc_thumbnailer_seek_speed_t;
+
+typedef struct libvlc_media_thumbnail_request_t libvlc_media_thumbnail_request_t;
+
+/**
+ * Start an asynchronous thumbnail generation
+ *
+ * If the request is successfully queued, the libvlc_MediaThumbnailGenerated
+ * event is guaranteed to be emitted, unless the request is destroyed first.
+ * The picture carried by the event is NULL if the thumbnail could not be
+ * generated, or if the timeout was reached.
+ *
+ * The thumbnail is generated without any output: the media is opened, seeked
+ * and a single picture is decoded, then scaled. Many requests can be
+ * processed concurrently.
+ *
+ * \version LibVLC 3.0.10 and later.
+ *
+ * \param md media descriptor object
+ * \param time The time at which the thumbnail should be generated
+ * \param speed The seeking speed \sa{libvlc_thumbnailer_seek_speed_t}
+ * \param width The thumbnail width
+ * \param height the thumbnail height
+ * \param picture_type The thumbnail picture type \sa{libvlc_picture_type_t}
+ * \param timeout A timeout value in ms, or 0 to disable timeout
+ *
+ * \return A valid opaque request object, or NULL in case of failure.
+ * It must be released with libvlc_media_thumbnail_request_destroy().
+ *
+ * If width is 0, the thumbnail will be scaled according to the given height,
+ * preserving the aspect ratio. Conversely, if height is 0, it is scaled
+ * according to the given width. If both are 0, the original picture size
+ * is used.
+ */
+LIBVLC_API libvlc_media_thumbnail_request_t*
+libvlc_media_thumbnail_request_by_time( libvlc_media_t *md,
+                                        libvlc_time_t time,
+                                        libvlc_thumbnailer_seek_speed_t speed,
+                                        unsigned int width, unsigned int height,
+                                        libvlc_picture_type_t picture_type,
+                                        libvlc_time_t timeout );
+
+/**
+ * Start an asynchronous thumbnail generation
+ *
+ * \version LibVLC 3.0.10 and later.
+ *
+ * \param md media descriptor object
+ * \param pos The position at which the thumbnail should be generated,
+ *            between 0.0 and 1.0
+ *
+ * \see libvlc_media_thumbnail_request_by_time() for the other parameters
+ */
+LIBVLC_API libvlc_media_thumbnail_request_t*
+libvlc_media_thumbnail_request_by_pos( libvlc_media_t *md,
+                                       float pos,
+                                       libvlc_thumbnailer_seek_speed_t speed,
+                                       unsigned int width, unsigned int height,
+                                       libvlc_picture_type_t picture_type,
+                                       libvlc_time_t timeout );
+
+/**
+ * Destroy a thumbnail request
+ *
+ * If the request has not completed yet, it is cancelled, and the
+ * libvlc_MediaThumbnailGenerated event will not be emitted for it.
+ *
+ * \version LibVLC 3.0.10 and later.
+ *
+ * \param req An opaque thumbnail request object.
+ *
+ * \warning This function must not be called from the event callback.
+ */
+LIBVLC_API void
+libvlc_media_thumbnail_request_destroy( libvlc_media_thumbnail_request_t *req );
+
 /** @}*/
 
 # ifdef __cplusplus
@@ -407,7 +407,8 @@ typedef void (*libvlc_video_cleanup_cb)(void *opaque);
  *   cropping and/or picture re-orientation, must be performed by the CPU
  *   instead of the GPU.
  * - Memory copying is required between LibVLC reference picture buffers and
- *   application buffers (between lock and unlock callbacks).
+ *   application buffers (between lock and unlock callbacks), unless the
+ *   application provides its buffers with libvlc_video_set_pool_callbacks().
  *
  * \param mp the media player
  * \param lock callback to lock video memory (must not be NULL)
@@ -458,6 +459,64 @@ void libvlc_video_set_format_callbacks( libvlc_media_player_t *mp,
                                         libvlc_video_format_cb setup,
                                         libvlc_video_cleanup_cb cleanup );
 
+/**
+ * Callback prototype to provide a picture buffer of the application pool.
+ *
+ * It is called once per buffer when the video output starts, after the
+ * @ref libvlc_video_format_cb callback, with increasing indexes, until it
+ * returns NULL or LibVLC has enough buffers. The buffers must remain valid
+ * until the @ref libvlc_video_cleanup_cb callback is invoked.
+ *
+ * \param opaque private pointer as passed to libvlc_video_set_callbacks() [IN]
+ * \param index index of the buffer in the pool [IN]
+ * \param planes start address of the pixel planes, laid out with the pitches
+ *               and lines given by the @ref libvlc_video_format_cb callback
+ *               (LibVLC allocates the array of void pointers, this callback
+ *               must initialize the array) [OUT]
+ * \return a private pointer for the display and release callbacks to identify
+ *         the buffer, or NULL if there are no more buffers
+ */
+typedef void *(*libvlc_video_pool_cb)(void *opaque, unsigned index,
+                                      void **planes);
+
+/**
+ * Callback prototype to release a picture buffer of the application pool.
+ *
+ * It is invoked when LibVLC does not reference the buffer anymore, and may
+ * reuse it for another picture. A displayed buffer is released at the
+ * earliest when the next picture is displayed.
+ *
+ * \note This callback can be invoked from any LibVLC thread.
+ *
+ * \param opaque private pointer as passed to libvlc_video_set_callbacks() [IN]
+ * \param picture private pointer returned from the @ref libvlc_video_pool_cb
+ *                callback [IN]
+ */
+typedef void (*libvlc_video_release_cb)(void *opaque, void *picture);
+
+/**
+ * Set a pool of application picture buffers. This only works in combination
+ * with libvlc_video_set_callbacks() and libvlc_video_set_format_callbacks().
+ *
+ * Pictures are decoded (or converted) straight into the application buffers,
+ * and the @ref libvlc_video_display_cb callback is invoked with the buffer
+ * identifier returned by the pool callback, without any copy.
+ *
+ * If the pitches and lines given by the format callback are too small for
+ * the decoded pictures, or if LibVLC needs to render into its own buffers,
+ * pictures are copied into buffers obtained with the lock callback instead,
+ * as if no pool were set.
+ *
+ * \param mp the media player
+ * \param pool callback to provide the buffers (or NULL to disable the pool)
+ * \param release callback to release a buffer (or NULL if not needed)
+ * \version LibVLC 3.0.10 or later
+ */
+LIBVLC_API
+void libvlc_video_set_pool_callbacks( libvlc_media_player_t *mp,
+                                      libvlc_video_pool_cb pool,
+                                      libvlc_video_release_cb release );
+
 /**
  * Set the NSView handler where the media player should render its video output.
  *
@@ -0,0 +1,144 @@
+/*****************************************************************************
+ * libvlc_picture.h:  libvlc external API
+ *****************************************************************************
+ * Copyright (C) 2020 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef VLC_LIBVLC_PICTURE_H
+#define VLC_LIBVLC_PICTURE_H 1
+
+# ifdef __cplusplus
+extern "C" {
+# endif
+
+/** \defgroup libvlc_picture LibVLC picture
+ * \ingroup libvlc
+ * @ref libvlc_picture_t is an encoded (or raw ARGB) picture, such as a
+ * thumbnail generated by libvlc_media_thumbnail_request_by_time().
+ * @{
+ * \file
+ * LibVLC picture external API
+ */
+
+typedef struct libvlc_picture_t libvlc_picture_t;
+
+typedef enum libvlc_picture_type_t
+{
+    libvlc_picture_Argb,
+    libvlc_picture_Png,
+    libvlc_picture_Jpg,
+} libvlc_picture_type_t;
+
+/**
+ * Increment the reference count of a picture.
+ *
+ * \version LibVLC 3.0.10 and later.
+ *
+ * \see libvlc_picture_release()
+ */
+LIBVLC_API void
+libvlc_picture_retain( libvlc_picture_t* pic );
+
+/**
+ * Decrement the reference count of a picture.
+ *
+ * When the reference count reaches 0, the picture is released.
+ * The picture must not be accessed after calling this function.
+ *
+ * \version LibVLC 3.0.10 and later.
+ *
+ * \see libvlc_picture_retain()
+ */
+LIBVLC_API void
+libvlc_picture_release( libvlc_picture_t* pic );
+
+/**
+ * Saves a picture to a file.
+ *
+ * \version LibVLC 3.0.10 and later.
+ *
+ * \param pic a picture
+ * \param path the path to the file to be written
+ * \return 0 on success, -1 on error
+ */
+LIBVLC_API int
+libvlc_picture_save( const libvlc_picture_t* pic, const char* path );
+
+/**
+ * Returns the image internal buffer, including potential padding.
+ * The picture owns the buffer, which is valid as long as the picture is.
+ *
+ * \version LibVLC 3.0.10 and later.
+ *
+ * \param pic a picture
+ * \param size [out] the buffer size, in bytes (cannot be NULL)
+ * \return a pointer to the picture data
+ */
+LIBVLC_API const unsigned char*
+libvlc_picture_get_buffer( const libvlc_picture_t* pic, size_t *size );
+
+/**
+ * Returns the picture type.
+ *
+ * \version LibVLC 3.0.10 and later.
+ */
+LIBVLC_API libvlc_picture_type_t
+libvlc_picture_type( const libvlc_picture_t* pic );
+
+/**
+ * Returns the picture stride, in bytes.
+ *
+ * \version LibVLC 3.0.10 and later.
+ *
+ * \warning This function must only be called on pictures of type
+ *          libvlc_picture_Argb.
+ */
+LIBVLC_API unsigned int
+libvlc_picture_get_stride( const libvlc_picture_t* pic );
+
+/**
+ * Returns the width of the picture, in pixels.
+ *
+ * \version LibVLC 3.0.10 and later.
+ */
+LIBVLC_API unsigned int
+libvlc_picture_get_width( const libvlc_picture_t* pic );
+
+/**
+ * Returns the height of the picture, in pixels.
+ *
+ * \version LibVLC 3.0.10 and later.
+ */
+LIBVLC_API unsigned int
+libvlc_picture_get_height( const libvlc_picture_t* pic );
+
+/**
+ * Returns the time at which the picture is displayed in its media,
+ * in milliseconds.
+ *
+ * \version LibVLC 3.0.10 and later.
+ */
+LIBVLC_API libvlc_time_t
+libvlc_picture_get_time( const libvlc_picture_t* pic );
+
+/** @}*/
+
+# ifdef __cplusplus
+}
+# endif
+
+#endif /* VLC_LIBVLC_PICTURE_H */
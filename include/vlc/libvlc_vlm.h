@@ -289,6 +289,26 @@ LIBVLC_API int libvlc_vlm_get_media_instance_length( libvlc_instance_t *p_instan
 LIBVLC_API int libvlc_vlm_get_media_instance_rate( libvlc_instance_t *p_instance,
                                                        const char *psz_name,
                                                        int i_instance );
+
+/**
+ * Get vlm_media instance output statistics by name or instance id
+ *
+ * Broadcast instances with identical inputs share a single input: the
+ * statistics only account for the stream output of the instance.
+ *
+ * \param p_instance a libvlc instance
+ * \param psz_name name of vlm media instance
+ * \param i_instance instance id
+ * \param pi_cpu_time CPU time spent in the stream output in microseconds
+ * \param pi_bitrate stream output bitrate in bits per second
+ * \return 0 on success, -1 on error
+ * \version LibVLC 3.0.10 and later
+ */
+LIBVLC_API int libvlc_vlm_get_media_instance_stats( libvlc_instance_t *p_instance,
+                                                    const char *psz_name,
+                                                    int i_instance,
+                                                    int64_t *pi_cpu_time,
+                                                    int64_t *pi_bitrate );
 #if 0
 /**
  * Get vlm_media instance title number by name or instance id
@@ -0,0 +1,117 @@
+/*****************************************************************************
+ * vlc_cpu_budget.h: process-wide codec thread budget
+ *****************************************************************************
+ * Copyright (C) 2020 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef VLC_CPU_BUDGET_H
+#define VLC_CPU_BUDGET_H 1
+
+/**
+ * \defgroup cpu_budget CPU budget
+ * \ingroup os
+ * Sharing of the CPU threads between codecs
+ *
+ * Multi-threaded codecs lease their worker threads from a budget shared by
+ * the whole LibVLC instance ("cpu-budget", the number of CPUs by default),
+ * instead of sizing their thread pools from the number of CPUs each. The
+ * budget is split between the active leases, display-bound playback getting
+ * twice the share of background work (transcoding).
+ * @{
+ * \file
+ * CPU budget interface
+ */
+
+#include <vlc_common.h>
+
+typedef struct vlc_cpu_lease_t vlc_cpu_lease_t;
+
+enum vlc_cpu_priority
+{
+    /** Real-time work, e.g. decoding for display */
+    VLC_CPU_PRIORITY_DISPLAY,
+    /** Work that can be slowed down, e.g. transcoding */
+    VLC_CPU_PRIORITY_BACKGROUND,
+};
+
+/**
+ * Leases threads from the CPU budget
+ *
+ * The priority is inherited from the "cpu-priority" integer variable of the
+ * object or of its parents, VLC_CPU_PRIORITY_DISPLAY if there is none.
+ *
+ * A lease is granted its fair share of the budget, capped to the threads that
+ * are not leased yet, and at least one thread. Display leases can also use the
+ * threads of background leases, and are granted their share right away.
+ * Background leases wait up to "cpu-budget-wait" milliseconds for threads to
+ * be released when the budget is exhausted.
+ *
+ * The grant is fixed for the lifetime of the lease: leases are not rebalanced
+ * when other leases are acquired or released.
+ *
+ * \param obj the codec
+ * \param psz_module name under which the lease is accounted in the statistics
+ * \param i_wanted maximum number of useful threads, 0 for no limit
+ * \return a lease, or NULL on memory error
+ */
+VLC_API vlc_cpu_lease_t *vlc_cpu_lease_Acquire( vlc_object_t *obj,
+                                                const char *psz_module,
+                                                unsigned i_wanted ) VLC_USED;
+#define vlc_cpu_lease_Acquire(o, m, n) \
+    vlc_cpu_lease_Acquire(VLC_OBJECT(o), m, n)
+
+/**
+ * Returns the number of threads granted to a lease (at least 1)
+ */
+VLC_API unsigned vlc_cpu_lease_GetThreads( const vlc_cpu_lease_t *lease );
+
+/**
+ * Returns the leased threads to the budget
+ */
+VLC_API void vlc_cpu_lease_Release( vlc_cpu_lease_t *lease );
+
+/**
+ * Per-module CPU budget statistics
+ */
+typedef struct
+{
+    char     psz_module[32];
+    unsigned i_leases;       /**< active leases */
+    unsigned i_threads;      /**< threads granted to the active leases */
+    unsigned i_total_leases; /**< leases acquired so far */
+    unsigned i_waits;        /**< leases that had to wait for threads */
+    mtime_t  i_wait_time;    /**< total waiting time */
+} vlc_cpu_budget_stats_t;
+
+/**
+ * Reads the CPU budget statistics
+ *
+ * \param obj any object of the LibVLC instance
+ * \param stats array to fill, one entry per module
+ * \param i_max size of the array
+ * \param pi_budget [OUT] total number of threads of the budget (can be NULL)
+ * \return the number of modules (possibly more than i_max)
+ */
+VLC_API size_t vlc_cpu_budget_GetStats( vlc_object_t *obj,
+                                        vlc_cpu_budget_stats_t *stats,
+                                        size_t i_max, unsigned *pi_budget );
+#define vlc_cpu_budget_GetStats(o, s, n, b) \
+    vlc_cpu_budget_GetStats(VLC_OBJECT(o), s, n, b)
+
+/** @} */
+
+#endif
@@ -0,0 +1,106 @@
+/*****************************************************************************
+ * vlc_fft.h: fast Fourier transforms
+ *****************************************************************************
+ * Copyright (C) 2020 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef VLC_FFT_H
+# define VLC_FFT_H
+
+/**
+ * \defgroup fft Fast Fourier transforms
+ * \ingroup cext
+ *
+ * Single precision discrete Fourier transforms of any size made of powers
+ * of 2, 3 and 5, with SIMD kernels when the CPU has them.
+ *
+ * Complex values are stored as interleaved real and imaginary parts. The
+ * forward transform uses the exp(-2*pi*i*j*k/n) kernel, and no transform is
+ * normalized: an inverse transform after a forward one scales the signal by
+ * its size.
+ *
+ * The trigonometric tables of each size are computed once and shared by all
+ * the transforms of the LibVLC instance. Transforms of objects without
+ * instance compute tables of their own. A transform object also owns the
+ * working buffers of its calls, so it must not be used by several threads at
+ * once.
+ * @{
+ * \file
+ */
+
+typedef struct vlc_fft vlc_fft_t;
+
+enum vlc_fft_type
+{
+    VLC_FFT_COMPLEX, /**< n complex values to n complex values */
+    VLC_FFT_REAL,    /**< n real values to n / 2 + 1 complex values */
+};
+
+/**
+ * Creates a transform.
+ *
+ * \param size number of points, a product of powers of 2, 3 and 5 (also
+ *             even for real transforms)
+ * \return the transform, or NULL if the size is not supported or on error
+ */
+VLC_API vlc_fft_t *vlc_fft_New(vlc_object_t *, unsigned size,
+                               enum vlc_fft_type type) VLC_USED;
+#define vlc_fft_New(o, s, t) vlc_fft_New(VLC_OBJECT(o), s, t)
+
+/**
+ * Deletes a transform.
+ */
+VLC_API void vlc_fft_Delete(vlc_fft_t *);
+
+/**
+ * Tells whether a size is supported by vlc_fft_New().
+ */
+VLC_API bool vlc_fft_IsSizeSupported(unsigned size, enum vlc_fft_type type) VLC_USED;
+
+/**
+ * Forward transform.
+ *
+ * The input and output may be the same buffer for complex transforms.
+ *
+ * \param in n complex values, or n real values
+ * \param out n complex values, or n / 2 + 1 complex values
+ */
+VLC_API void vlc_fft_Forward(vlc_fft_t *, const float *in, float *out);
+
+/**
+ * Inverse transform, with the exp(2*pi*i*j*k/n) kernel.
+ *
+ * For a real transform, the imaginary parts of the first and last input
+ * values are ignored.
+ *
+ * \param in n complex values, or n / 2 + 1 complex values
+ * \param out n complex values, or n real values
+ */
+VLC_API void vlc_fft_Inverse(vlc_fft_t *, const float *in, float *out);
+
+/**
+ * Forward transform of real values, keeping only the squared magnitude of
+ * each frequency.
+ *
+ * \param in n real values
+ * \param power n / 2 + 1 values
+ */
+VLC_API void vlc_fft_PowerSpectrum(vlc_fft_t *, const float *in, float *power);
+
+/** @} */
+
+#endif
@@ -278,6 +278,63 @@ VLC_API int filter_Blend( filter_t *, picture_t *p_dst, int i_dst_x, int i_dst_y
  */
 VLC_API void filter_DeleteBlend( filter_t * );
 
+/**
+ * \defgroup filter_slices Slice threading
+ * \ingroup filter
+ *
+ * Video filters computing each output line from a bounded neighbourhood of
+ * their input can split their work in horizontal slices. The slices are run
+ * in parallel by the calling thread and a thread pool shared by the whole
+ * LibVLC instance ("filter-threads").
+ *
+ * A slice callback must only write the output lines of its slice, and may
+ * read any input line. Filters with a vertical recursion (each line depends
+ * on the output of the previous one) declare an overlap: the callback then
+ * restarts the recursion that many lines before its slice, to warm it up.
+ * @{
+ */
+
+/** Lines of a plane to process */
+typedef struct
+{
+    int      i_plane;
+    int      i_first;  /**< first line to read, i_start minus the overlap */
+    int      i_start;  /**< first line to output */
+    int      i_end;    /**< line after the last one to output */
+    unsigned i_worker; /**< index of the running thread, for scratch buffers */
+} filter_slice_t;
+
+typedef void (*filter_slice_cb)( filter_t *, const filter_slice_t *,
+                                 void *p_data );
+
+/**
+ * Returns the number of threads that may run slices of a filter at once.
+ *
+ * filter_slice_t.i_worker is always below this value. It does not change
+ * during the lifetime of the filter, so per-thread scratch buffers can be
+ * allocated when the filter is opened.
+ */
+VLC_API unsigned filter_GetSliceWorkers( filter_t * ) VLC_USED;
+
+/**
+ * Runs a slice callback over the visible lines of the planes of a picture.
+ *
+ * Each visible line of the planes is output by exactly one slice. Slices
+ * are never smaller than four times the overlap. The function returns once
+ * all the slices have been processed.
+ *
+ * \param p_pic picture giving the plane heights, usually the output
+ * \param i_planes number of planes to process, from the first one, or 0
+ * for all the planes of the picture
+ * \param i_overlap number of lines the callback reads before its slice to
+ * warm up a vertical recursion, 0 if it has none
+ */
+VLC_API void filter_ExecuteSlices( filter_t *, const picture_t *p_pic,
+                                   int i_planes, unsigned i_overlap,
+                                   filter_slice_cb pf_slice, void *p_data );
+
+/** @} */
+
 /**
  * Create a picture_t *(*)( filter_t *, picture_t * ) compatible wrapper
  * using a void (*)( filter_t *, picture_t *, picture_t * ) function
@@ -466,5 +523,14 @@ VLC_API int filter_chain_MouseEvent( filter_chain_t *,
 int filter_chain_ForEach( filter_chain_t *chain,
                           int (*cb)( filter_t *, void * ), void *opaque );
 
+/**
+ * Reports the time spent in each video filter of the chain, and the number
+ * of pictures it was given, since the previous call.
+ */
+void filter_chain_GetResetTimes( filter_chain_t *chain,
+                                 void (*cb)( filter_t *, mtime_t, unsigned,
+                                             void * ),
+                                 void *opaque );
+
 /** @} */
 #endif /* _VLC_FILTER_H */
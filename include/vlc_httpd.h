@@ -118,6 +118,15 @@ VLC_API void httpd_UrlDelete( httpd_url_t * );
 VLC_API char* httpd_ClientIP( const httpd_client_t *cl, char *, int * );
 VLC_API char* httpd_ServerIP( const httpd_client_t *cl, char *, int * );
 
+/**
+ * Keeps a client waiting for more data from its URL callback
+ *
+ * Once the current answer is sent, the callback is invoked again about every
+ * 20 ms with the same answer body offset, until it returns more body data.
+ * The answer completes when the callback resets the body offset to zero.
+ */
+VLC_API void httpd_ClientSetStreamMode( httpd_client_t * );
+
 /* High level */
 
 typedef struct httpd_file_t     httpd_file_t;
@@ -0,0 +1,147 @@
+/*****************************************************************************
+ * vlc_seekindex.h: persistent demuxer seek index
+ *****************************************************************************
+ * Copyright (C) 2020 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef VLC_SEEKINDEX_H
+#define VLC_SEEKINDEX_H 1
+
+/**
+ * \defgroup seekindex Seek index
+ * \ingroup demux
+ * Persistent storage of the seek points found by demuxers
+ *
+ * Demuxers that have to scan a file to be able to seek within it can store
+ * the resulting seek points in a seek index, and restore them the next time
+ * the same file is opened. Indexes are kept in the user cache directory and
+ * are identified by the file location, size and modification time: they are
+ * silently discarded whenever the file changes.
+ * @{
+ * \file
+ * Seek index interface
+ */
+
+#include <vlc_common.h>
+
+typedef struct vlc_seekindex_t vlc_seekindex_t;
+
+/** The entry points to a point where decoding can start */
+#define VLC_SEEKINDEX_KEYFRAME 0x1
+/** First flag that can be used freely by the demuxer */
+#define VLC_SEEKINDEX_PRIVATE  0x100
+
+typedef struct
+{
+    int64_t  i_time; /**< time from the beginning of the track (µs) */
+    uint64_t i_pos;  /**< byte offset in the stream */
+    uint64_t i_size; /**< size of the indexed data, 0 if unknown */
+    uint32_t i_flags; /**< VLC_SEEKINDEX_* flags */
+} vlc_seekindex_entry_t;
+
+/**
+ * Opens the seek index of a stream
+ *
+ * Only local files have a seek index. If an index was previously saved for
+ * the same file, it is loaded.
+ *
+ * \param obj the demuxer
+ * \param s the stream to index
+ * \param name name of the index, to store several indexes per file (e.g. the
+ *             demuxer name)
+ * \return a seek index, or NULL if the stream cannot be indexed or if
+ *         "seek-index" is disabled
+ */
+VLC_API vlc_seekindex_t *vlc_seekindex_Open( vlc_object_t *obj, stream_t *s,
+                                             const char *name ) VLC_USED;
+#define vlc_seekindex_Open(o, s, n) vlc_seekindex_Open(VLC_OBJECT(o), s, n)
+
+/**
+ * Closes a seek index
+ *
+ * The index is saved if it was modified.
+ */
+VLC_API void vlc_seekindex_Close( vlc_seekindex_t *idx );
+
+/**
+ * Adds an entry to a track of the index
+ *
+ * Entries are kept sorted by time, then by position; adding an entry that
+ * is already present does nothing.
+ *
+ * \param track demuxer-defined track identifier
+ * \return VLC_SUCCESS or VLC_ENOMEM
+ */
+VLC_API int vlc_seekindex_Add( vlc_seekindex_t *idx, unsigned track,
+                               const vlc_seekindex_entry_t *entry );
+
+/**
+ * Returns the number of entries of a track (0 if the track is unknown)
+ */
+VLC_API size_t vlc_seekindex_Count( const vlc_seekindex_t *idx,
+                                    unsigned track );
+
+/**
+ * Returns an entry of a track
+ *
+ * \param i index of the entry, below vlc_seekindex_Count()
+ */
+VLC_API const vlc_seekindex_entry_t *
+vlc_seekindex_Get( const vlc_seekindex_t *idx, unsigned track, size_t i );
+
+/**
+ * Finds the last entry of a track at or before a given time
+ *
+ * \param time time from the beginning of the track (µs)
+ * \param flags flags that the entry must have (0 for any entry)
+ * \return the index of the entry, or -1 if there is none
+ */
+VLC_API ssize_t vlc_seekindex_Lookup( const vlc_seekindex_t *idx,
+                                      unsigned track, int64_t time,
+                                      uint32_t flags );
+
+/**
+ * Marks a byte range of the stream as completely indexed
+ *
+ * Overlapping and adjacent ranges are merged.
+ *
+ * \param start start offset (included)
+ * \param end end offset (excluded)
+ */
+VLC_API int vlc_seekindex_AddRange( vlc_seekindex_t *idx, uint64_t start,
+                                    uint64_t end );
+
+/**
+ * Returns the number of disjoint indexed byte ranges
+ */
+VLC_API size_t vlc_seekindex_CountRanges( const vlc_seekindex_t *idx );
+
+/**
+ * Returns an indexed byte range, in increasing offset order
+ */
+VLC_API void vlc_seekindex_GetRange( const vlc_seekindex_t *idx, size_t i,
+                                     uint64_t *start, uint64_t *end );
+
+/**
+ * Tells whether a byte range is completely indexed
+ */
+VLC_API bool vlc_seekindex_Covers( const vlc_seekindex_t *idx, uint64_t start,
+                                   uint64_t end );
+
+/** @} */
+
+#endif
@@ -235,6 +235,22 @@ VLC_API ssize_t vlc_stream_Peek(stream_t *, const uint8_t **, size_t) VLC_USED;
  */
 VLC_API block_t *vlc_stream_ReadBlock(stream_t *) VLC_USED;
 
+/**
+ * Reads data from a byte stream into a chain of blocks.
+ *
+ * This function always waits for the requested number of bytes, unless a fatal
+ * error is encountered or the end-of-stream is reached first, like
+ * vlc_stream_Read(). However, the data is not copied into a caller buffer:
+ * blocks from the byte stream back-end (and from the peek buffer) are
+ * returned by reference, and split without copying if they extend beyond
+ * the requested size.
+ *
+ * \param len number of bytes to read
+ * \return a chain of blocks totalling at most len bytes, or NULL if no data
+ * could be read
+ */
+VLC_API block_t *vlc_stream_ReadBlocks(stream_t *, size_t len) VLC_USED;
+
 /**
  * Tells the current stream position.
  *
@@ -0,0 +1,135 @@
+/*****************************************************************************
+ * vlc_thumbnailer.h: Thumbnailing API
+ *****************************************************************************
+ * Copyright (C) 2020 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef VLC_THUMBNAILER_H
+#define VLC_THUMBNAILER_H 1
+
+/**
+ * \defgroup thumbnailer Thumbnailer
+ * \ingroup input
+ * Extract a single picture out of media items
+ * @{
+ * \file
+ * Thumbnailer interface
+ */
+
+#include <vlc_common.h>
+
+typedef struct vlc_thumbnailer_t vlc_thumbnailer_t;
+typedef struct vlc_thumbnailer_request_t vlc_thumbnailer_request_t;
+
+/**
+ * Thumbnailing completion callback
+ *
+ * It is called exactly once per request, from a thumbnailer thread, unless
+ * the request was cancelled before it completed.
+ *
+ * \param data opaque pointer given to the request function
+ * \param picture the generated picture, or NULL in case of failure or
+ *        timeout. It is only valid during the callback; it must be held with
+ *        picture_Hold() to be kept around.
+ */
+typedef void (*vlc_thumbnailer_cb)( void *data, picture_t *picture );
+
+/**
+ * Seeking mode of a thumbnail request
+ */
+enum vlc_thumbnailer_seek_speed
+{
+    /** Use the first picture after the requested time */
+    VLC_THUMBNAILER_SEEK_PRECISE,
+    /** Use the key frame nearest to the requested time (or position), and
+     * skip the decoding of non-reference pictures */
+    VLC_THUMBNAILER_SEEK_FAST,
+};
+
+/**
+ * Creates a thumbnailer
+ *
+ * The thumbnailer processes up to "thumbnailer-threads" requests
+ * concurrently, each of them with its own demuxer and decoder. It does not
+ * use any output, and hence no clock: pictures are decoded as fast as
+ * possible.
+ *
+ * \param parent parent VLC object
+ * \return a thumbnailer, or NULL on error
+ */
+VLC_API vlc_thumbnailer_t *vlc_thumbnailer_Create( vlc_object_t *parent )
+VLC_USED;
+#define vlc_thumbnailer_Create(o) vlc_thumbnailer_Create(VLC_OBJECT(o))
+
+/**
+ * Requests a thumbnail at a given time
+ *
+ * \param thumbnailer a thumbnailer
+ * \param time time from the beginning of the item
+ * \param speed seeking mode
+ * \param item the item to generate a thumbnail for
+ * \param timeout maximum duration of the request, 0 for no timeout
+ * \param cb completion callback
+ * \param data opaque pointer for the completion callback
+ * \return an opaque request handle, to be passed to
+ *         vlc_thumbnailer_DestroyRequest(), or NULL on error (in which case
+ *         the callback is not called)
+ */
+VLC_API vlc_thumbnailer_request_t *
+vlc_thumbnailer_RequestByTime( vlc_thumbnailer_t *thumbnailer, mtime_t time,
+                               enum vlc_thumbnailer_seek_speed speed,
+                               input_item_t *item, mtime_t timeout,
+                               vlc_thumbnailer_cb cb, void *data );
+
+/**
+ * Requests a thumbnail at a given position
+ *
+ * \param pos position in the item, between 0.0 and 1.0
+ *
+ * \see vlc_thumbnailer_RequestByTime() for the other parameters. Positions
+ * are only known approximately, so the seeking mode only selects whether
+ * non-reference pictures are decoded.
+ */
+VLC_API vlc_thumbnailer_request_t *
+vlc_thumbnailer_RequestByPos( vlc_thumbnailer_t *thumbnailer, float pos,
+                              enum vlc_thumbnailer_seek_speed speed,
+                              input_item_t *item, mtime_t timeout,
+                              vlc_thumbnailer_cb cb, void *data );
+
+/**
+ * Destroys a thumbnail request
+ *
+ * If the request is still pending or running, it is cancelled and its
+ * callback will not be called. Once this function returns, the callback is
+ * guaranteed not to be running.
+ *
+ * \warning This function must not be called from the completion callback.
+ */
+VLC_API void vlc_thumbnailer_DestroyRequest( vlc_thumbnailer_t *thumbnailer,
+                                             vlc_thumbnailer_request_t *request );
+
+/**
+ * Releases a thumbnailer
+ *
+ * All the requests must have been destroyed with
+ * vlc_thumbnailer_DestroyRequest() beforehand.
+ */
+VLC_API void vlc_thumbnailer_Release( vlc_thumbnailer_t *thumbnailer );
+
+/** @} */
+
+#endif
@@ -77,6 +77,9 @@ typedef struct
     double      d_position; /*< vlm media instance position in stream */
     bool        b_paused;   /*< vlm media instance is paused */
     int         i_rate;     // normal is INPUT_RATE_DEFAULT
+    int64_t     i_cpu_time; /*< CPU time spent in the stream output (us) */
+    int64_t     i_bitrate;  /*< bitrate written by the stream output (bits/s) */
+    bool        b_shared;   /*< input shared with other instances */
 } vlm_media_instance_t;
 
 #if 0
@@ -326,6 +329,9 @@ static inline void vlm_media_instance_Init( vlm_media_instance_t *p_instance )
     p_instance->d_position = 0.0;
     p_instance->b_paused = false;
     p_instance->i_rate = INPUT_RATE_DEFAULT;
+    p_instance->i_cpu_time = 0;
+    p_instance->i_bitrate = 0;
+    p_instance->b_shared = false;
 }
 
 /**
@@ -31,6 +31,7 @@
 
 #include <vlc_interface.h>
 #include <vlc_vlm.h>
+#include <vlc_thumbnailer.h>
 
 #include <stdarg.h>
 #include <limits.h>
@@ -64,6 +65,7 @@ libvlc_instance_t * libvlc_new( int argc, const char *const *argv )
 
     p_new->p_libvlc_int = p_libvlc_int;
     p_new->vlm = NULL;
+    p_new->thumbnailer = NULL;
     p_new->ref_count = 1;
     p_new->p_callback_list = NULL;
     vlc_mutex_init(&p_new->instance_lock);
@@ -100,6 +102,8 @@ void libvlc_release( libvlc_instance_t *p_instance )
         vlc_mutex_destroy( lock );
         if( p_instance->vlm != NULL )
             libvlc_vlm_release( p_instance );
+        if( p_instance->thumbnailer != NULL )
+            vlc_thumbnailer_Release( p_instance->thumbnailer );
         libvlc_Quit( p_instance->p_libvlc_int );
         libvlc_InternalCleanup( p_instance->p_libvlc_int );
         libvlc_InternalDestroy( p_instance->p_libvlc_int );
@@ -142,6 +142,7 @@ static const event_name_t event_list[] = {
     DEF(MediaFreed)
     DEF(MediaStateChanged)
     DEF(MediaSubItemTreeAdded)
+    DEF(MediaThumbnailGenerated)
 
     DEF(MediaPlayerMediaChanged)
     DEF(MediaPlayerNothingSpecial)
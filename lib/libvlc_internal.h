@@ -61,6 +61,7 @@ struct libvlc_instance_t
 {
     libvlc_int_t *p_libvlc_int;
     struct libvlc_vlm_t *vlm;
+    struct vlc_thumbnailer_t *thumbnailer; /* created on first use */
     unsigned      ref_count;
     vlc_mutex_t   instance_lock;
     struct libvlc_callback_entry_list_t *p_callback_list;
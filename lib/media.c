@@ -37,6 +37,7 @@
 #include <vlc_input.h>
 #include <vlc_meta.h>
 #include <vlc_playlist.h> /* For the preparser */
+#include <vlc_thumbnailer.h>
 #include <vlc_url.h>
 
 #include "../src/libvlc.h"
@@ -44,6 +45,7 @@
 #include "libvlc_internal.h"
 #include "media_internal.h"
 #include "media_list_internal.h"
+#include "picture_internal.h"
 
 static const vlc_meta_type_t libvlc_to_vlc_meta[] =
 {
@@ -1288,3 +1290,145 @@ void libvlc_media_slaves_release( libvlc_media_slave_t **pp_slaves,
     }
     free( pp_slaves );
 }
+
+struct libvlc_media_thumbnail_request_t
+{
+    libvlc_media_t *md;
+    unsigned int width;
+    unsigned int height;
+    libvlc_picture_type_t type;
+    vlc_thumbnailer_request_t *req;
+};
+
+static vlc_thumbnailer_t *get_thumbnailer( libvlc_instance_t *p_instance )
+{
+    vlc_thumbnailer_t *thumbnailer;
+
+    vlc_mutex_lock( &p_instance->instance_lock );
+    if( p_instance->thumbnailer == NULL )
+        p_instance->thumbnailer =
+            vlc_thumbnailer_Create( p_instance->p_libvlc_int );
+    thumbnailer = p_instance->thumbnailer;
+    vlc_mutex_unlock( &p_instance->instance_lock );
+    return thumbnailer;
+}
+
+static void media_on_thumbnail_ready( void *data, picture_t *thumbnail )
+{
+    libvlc_media_thumbnail_request_t *req = data;
+    libvlc_media_t *p_md = req->md;
+    libvlc_picture_t *pic = NULL;
+
+    if( thumbnail != NULL )
+        pic = libvlc_picture_new(
+                VLC_OBJECT(p_md->p_libvlc_instance->p_libvlc_int),
+                thumbnail, req->type, req->width, req->height );
+
+    libvlc_event_t event;
+    event.type = libvlc_MediaThumbnailGenerated;
+    event.u.media_thumbnail_generated.p_thumbnail = pic;
+    libvlc_event_send( &p_md->event_manager, &event );
+
+    if( pic != NULL )
+        libvlc_picture_release( pic );
+}
+
+static libvlc_media_thumbnail_request_t *
+thumbnail_request_new( libvlc_media_t *md, unsigned int width,
+                       unsigned int height, libvlc_picture_type_t picture_type )
+{
+    libvlc_media_thumbnail_request_t *req = malloc( sizeof( *req ) );
+    if( unlikely( req == NULL ) )
+        return NULL;
+
+    req->md = md;
+    req->width = width;
+    req->height = height;
+    req->type = picture_type;
+    req->req = NULL;
+    libvlc_media_retain( md );
+    return req;
+}
+
+static void thumbnail_request_free( libvlc_media_thumbnail_request_t *req )
+{
+    libvlc_media_release( req->md );
+    free( req );
+}
+
+static enum vlc_thumbnailer_seek_speed
+thumbnail_seek_speed( libvlc_thumbnailer_seek_speed_t speed )
+{
+    return speed == libvlc_media_thumbnail_seek_fast ?
+                VLC_THUMBNAILER_SEEK_FAST : VLC_THUMBNAILER_SEEK_PRECISE;
+}
+
+libvlc_media_thumbnail_request_t*
+libvlc_media_thumbnail_request_by_time( libvlc_media_t *md, libvlc_time_t time,
+                                        libvlc_thumbnailer_seek_speed_t speed,
+                                        unsigned int width, unsigned int height,
+                                        libvlc_picture_type_t picture_type,
+                                        libvlc_time_t timeout )
+{
+    assert( md );
+
+    vlc_thumbnailer_t *thumbnailer = get_thumbnailer( md->p_libvlc_instance );
+    if( unlikely( thumbnailer == NULL ) )
+        return NULL;
+
+    libvlc_media_thumbnail_request_t *req =
+        thumbnail_request_new( md, width, height, picture_type );
+    if( unlikely( req == NULL ) )
+        return NULL;
+
+    req->req = vlc_thumbnailer_RequestByTime( thumbnailer, to_mtime( time ),
+                                              thumbnail_seek_speed( speed ),
+                                              md->p_input_item,
+                                              to_mtime( timeout ),
+                                              media_on_thumbnail_ready, req );
+    if( req->req == NULL )
+    {
+        thumbnail_request_free( req );
+        return NULL;
+    }
+    return req;
+}
+
+libvlc_media_thumbnail_request_t*
+libvlc_media_thumbnail_request_by_pos( libvlc_media_t *md, float pos,
+                                       libvlc_thumbnailer_seek_speed_t speed,
+                                       unsigned int width, unsigned int height,
+                                       libvlc_picture_type_t picture_type,
+                                       libvlc_time_t timeout )
+{
+    assert( md );
+
+    vlc_thumbnailer_t *thumbnailer = get_thumbnailer( md->p_libvlc_instance );
+    if( unlikely( thumbnailer == NULL ) )
+        return NULL;
+
+    libvlc_media_thumbnail_request_t *req =
+        thumbnail_request_new( md, width, height, picture_type );
+    if( unlikely( req == NULL ) )
+        return NULL;
+
+    req->req = vlc_thumbnailer_RequestByPos( thumbnailer, pos,
+                                             thumbnail_seek_speed( speed ),
+                                             md->p_input_item,
+                                             to_mtime( timeout ),
+                                             media_on_thumbnail_ready, req );
+    if( req->req == NULL )
+    {
+        thumbnail_request_free( req );
+        return NULL;
+    }
+    return req;
+}
+
+void libvlc_media_thumbnail_request_destroy( libvlc_media_thumbnail_request_t *req )
+{
+    libvlc_instance_t *p_instance = req->md->p_libvlc_instance;
+
+    vlc_thumbnailer_DestroyRequest( p_instance->thumbnailer, req->req );
+    thumbnail_request_free( req );
+}
@@ -0,0 +1,214 @@
+/*****************************************************************************
+ * picture.c:  libvlc API picture management
+ *****************************************************************************
+ * Copyright (C) 2020 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <assert.h>
+
+#include <vlc/libvlc.h>
+#include <vlc/libvlc_picture.h>
+
+#include <vlc_common.h>
+#include <vlc_atomic.h>
+#include <vlc_block.h>
+#include <vlc_fs.h>
+#include <vlc_image.h>
+#include <vlc_picture.h>
+
+#include "libvlc_internal.h"
+#include "picture_internal.h"
+
+struct libvlc_picture_t
+{
+    atomic_uint refs;
+    libvlc_picture_type_t type;
+    unsigned int width;
+    unsigned int height;
+    libvlc_time_t time;
+    /* encoded pictures */
+    block_t* converted;
+    /* raw ARGB pictures */
+    picture_t* argb;
+};
+
+/* Scales the picture to the requested size, keeping the aspect ratio if
+ * only one dimension is given, like picture_Export() does. */
+static picture_t* ConvertToArgb( vlc_object_t* obj, picture_t* input,
+                                 unsigned int width, unsigned int height )
+{
+    video_format_t fmt_in = input->format;
+    if( fmt_in.i_sar_num == 0 || fmt_in.i_sar_den == 0 )
+        fmt_in.i_sar_num = fmt_in.i_sar_den = 1;
+
+    unsigned int src_width = fmt_in.i_visible_width;
+    unsigned int src_height = fmt_in.i_visible_height;
+    if( src_width == 0 || src_height == 0 )
+    {
+        src_width = fmt_in.i_width;
+        src_height = fmt_in.i_height;
+    }
+    if( fmt_in.i_sar_num >= fmt_in.i_sar_den )
+        src_width = (uint64_t)src_width * fmt_in.i_sar_num / fmt_in.i_sar_den;
+    else
+        src_height = (uint64_t)src_height * fmt_in.i_sar_den / fmt_in.i_sar_num;
+
+    if( width == 0 && height == 0 )
+    {
+        width = src_width;
+        height = src_height;
+    }
+    else if( height == 0 )
+        height = (uint64_t)width * src_height / src_width;
+    else if( width == 0 )
+        width = (uint64_t)height * src_width / src_height;
+    if( width == 0 || height == 0 )
+        return NULL;
+
+    video_format_t fmt_out;
+    video_format_Init( &fmt_out, VLC_CODEC_ARGB );
+    fmt_out.i_width = fmt_out.i_visible_width = width;
+    fmt_out.i_height = fmt_out.i_visible_height = height;
+    fmt_out.i_sar_num = fmt_out.i_sar_den = 1;
+
+    image_handler_t* image = image_HandlerCreate( obj );
+    if( image == NULL )
+        return NULL;
+
+    picture_t* argb = image_Convert( image, input, &fmt_in, &fmt_out );
+    image_HandlerDelete( image );
+    return argb;
+}
+
+libvlc_picture_t* libvlc_picture_new( vlc_object_t* obj, picture_t* input,
+                                      libvlc_picture_type_t type,
+                                      unsigned int width, unsigned int height )
+{
+    libvlc_picture_t *pic = malloc( sizeof( *pic ) );
+    if( unlikely( pic == NULL ) )
+        return NULL;
+
+    atomic_init( &pic->refs, 1 );
+    pic->type = type;
+    pic->time = input->date > VLC_TS_INVALID
+              ? from_mtime( input->date - VLC_TS_0 ) : 0;
+    pic->converted = NULL;
+    pic->argb = NULL;
+
+    if( type == libvlc_picture_Argb )
+    {
+        pic->argb = ConvertToArgb( obj, input, width, height );
+        if( pic->argb == NULL )
+            goto error;
+        pic->width = pic->argb->format.i_visible_width;
+        pic->height = pic->argb->format.i_visible_height;
+        return pic;
+    }
+
+    vlc_fourcc_t format = type == libvlc_picture_Png ? VLC_CODEC_PNG
+                                                     : VLC_CODEC_JPEG;
+    /* picture_Export() keeps the original size for negative values */
+    int w = width, h = height;
+    if( w == 0 && h == 0 )
+        w = h = -1;
+
+    video_format_t fmt;
+    if( picture_Export( obj, &pic->converted, &fmt, input, format, w, h ) )
+        goto error;
+    pic->width = fmt.i_width;
+    pic->height = fmt.i_height;
+    return pic;
+
+error:
+    free( pic );
+    return NULL;
+}
+
+void libvlc_picture_retain( libvlc_picture_t* pic )
+{
+    atomic_fetch_add_explicit( &pic->refs, 1, memory_order_relaxed );
+}
+
+void libvlc_picture_release( libvlc_picture_t* pic )
+{
+    if( atomic_fetch_sub( &pic->refs, 1 ) != 1 )
+        return;
+
+    if( pic->converted != NULL )
+        block_Release( pic->converted );
+    if( pic->argb != NULL )
+        picture_Release( pic->argb );
+    free( pic );
+}
+
+const unsigned char* libvlc_picture_get_buffer( const libvlc_picture_t* pic,
+                                                size_t *size )
+{
+    assert( size != NULL );
+
+    if( pic->argb != NULL )
+    {
+        const plane_t *plane = &pic->argb->p[0];
+        *size = (size_t)plane->i_pitch * plane->i_lines;
+        return plane->p_pixels;
+    }
+    *size = pic->converted->i_buffer;
+    return pic->converted->p_buffer;
+}
+
+int libvlc_picture_save( const libvlc_picture_t* pic, const char* path )
+{
+    FILE* file = vlc_fopen( path, "wb" );
+    if( file == NULL )
+        return -1;
+
+    size_t size;
+    const unsigned char* buffer = libvlc_picture_get_buffer( pic, &size );
+    size_t res = fwrite( buffer, size, 1, file );
+    int ret = fclose( file );
+    return res == 1 && ret == 0 ? 0 : -1;
+}
+
+libvlc_picture_type_t libvlc_picture_type( const libvlc_picture_t* pic )
+{
+    return pic->type;
+}
+
+unsigned int libvlc_picture_get_stride( const libvlc_picture_t* pic )
+{
+    assert( pic->type == libvlc_picture_Argb );
+    return pic->argb->p[0].i_pitch;
+}
+
+unsigned int libvlc_picture_get_width( const libvlc_picture_t* pic )
+{
+    return pic->width;
+}
+
+unsigned int libvlc_picture_get_height( const libvlc_picture_t* pic )
+{
+    return pic->height;
+}
+
+libvlc_time_t libvlc_picture_get_time( const libvlc_picture_t* pic )
+{
+    return pic->time;
+}
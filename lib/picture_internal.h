@@ -0,0 +1,44 @@
+/*****************************************************************************
+ * picture_internal.h:  libvlc API picture management
+ *****************************************************************************
+ * Copyright (C) 2020 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef _LIBVLC_PICTURE_INTERNAL_H
+#define _LIBVLC_PICTURE_INTERNAL_H 1
+
+#include <vlc/libvlc.h>
+#include <vlc/libvlc_picture.h>
+
+#include <vlc_common.h>
+#include <vlc_picture.h>
+
+/**
+ * Converts a core picture into a libvlc picture
+ *
+ * \param obj object used to load the conversion and encoding modules
+ * \param picture the picture to convert (it is not released)
+ * \param type the format of the libvlc picture
+ * \param width requested width, or 0 to keep the aspect ratio
+ * \param height requested height, or 0 to keep the aspect ratio
+ * \return a libvlc picture with a reference count of 1, or NULL on error
+ */
+libvlc_picture_t* libvlc_picture_new( vlc_object_t* obj, picture_t* picture,
+                                      libvlc_picture_type_t type,
+                                      unsigned int width, unsigned int height );
+
+#endif /* _LIBVLC_PICTURE_INTERNAL_H */
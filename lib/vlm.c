@@ -697,6 +697,23 @@ int libvlc_vlm_get_media_instance_rate( libvlc_instance_t *p_instance,
     return result;
 }
 
+int libvlc_vlm_get_media_instance_stats( libvlc_instance_t *p_instance,
+                                         const char *psz_name, int i_instance,
+                                         int64_t *pi_cpu_time,
+                                         int64_t *pi_bitrate )
+{
+    vlm_media_instance_t *p_mi;
+
+    p_mi = libvlc_vlm_get_media_instance( p_instance, psz_name, i_instance );
+    if( !p_mi )
+        return -1;
+
+    *pi_cpu_time = p_mi->i_cpu_time;
+    *pi_bitrate = p_mi->i_bitrate;
+    vlm_media_instance_Delete( p_mi );
+    return 0;
+}
+
 #if 0
 int libvlc_vlm_get_media_instance_title( libvlc_instance_t *p_instance,
                                          const char *psz_name, int i_instance )
@@ -50,6 +50,10 @@
 #include <vlc_strings.h>
 #include <vlc_dialog.h>
 
+#ifndef _WIN32
+# include "file_writer.h"
+#endif
+
 #ifndef O_LARGEFILE
 #   define O_LARGEFILE 0
 #endif
@@ -150,6 +154,34 @@ static ssize_t WritePipe(sout_access_out_t *access, block_t *block)
     return total;
 }
 
+#ifndef _WIN32
+/*****************************************************************************
+ * Asynchronous writes
+ *****************************************************************************/
+static ssize_t ReadAsync( sout_access_out_t *p_access, block_t *p_buffer )
+{
+    return file_writer_Read( (file_writer_t *)p_access->p_sys, p_buffer );
+}
+
+static ssize_t WriteAsync( sout_access_out_t *p_access, block_t *p_buffer )
+{
+    ssize_t val = file_writer_Write( (file_writer_t *)p_access->p_sys, p_buffer );
+    if (val < 0)
+    {
+        if (errno == ENOSPC)
+            vlc_dialog_display_error(p_access, "record",
+                                     "An error occurred during recording. Error: %s", vlc_strerror_c(errno));
+        msg_Err( p_access, "cannot write: %s", vlc_strerror_c(errno) );
+    }
+    return val;
+}
+
+static int SeekAsync( sout_access_out_t *p_access, off_t i_pos )
+{
+    return file_writer_Seek( (file_writer_t *)p_access->p_sys, i_pos );
+}
+#endif
+
 #ifdef S_ISSOCK
 static ssize_t Send(sout_access_out_t *access, block_t *block)
 {
@@ -221,10 +253,21 @@ static int Control( sout_access_out_t *p_access, int i_query, va_list args )
 
 static const char *const ppsz_sout_options[] = {
     "append",
+#ifndef _WIN32
+    "async",
+    "async-size",
+# ifdef O_DIRECT
+    "direct",
+# endif
+#endif
     "format",
     "overwrite",
 #ifdef O_SYNC
     "sync",
+#endif
+#ifndef _WIN32
+    "sync-interval",
+    "sync-size",
 #endif
     NULL
 };
@@ -236,6 +279,7 @@ static int Open( vlc_object_t *p_this )
 {
     sout_access_out_t   *p_access = (sout_access_out_t*)p_this;
     int                 fd;
+    int                 direct_fd = -1;
 
     config_ChainParse( p_access, SOUT_CFG_PREFIX, ppsz_sout_options, p_access->p_cfg );
 
@@ -247,6 +291,9 @@ static int Open( vlc_object_t *p_this )
 
     bool overwrite = var_GetBool (p_access, SOUT_CFG_PREFIX"overwrite");
     bool append = var_GetBool( p_access, SOUT_CFG_PREFIX "append" );
+#ifndef _WIN32
+    bool async = var_GetBool( p_access, SOUT_CFG_PREFIX "async" );
+#endif
 
     if (!strcmp (p_access->psz_access, "fd"))
     {
@@ -325,6 +372,18 @@ static int Open( vlc_object_t *p_this )
                                          _("The output file already exists. "
                                          "If recording continues, the file will be "
                                          "overridden and its content will be lost.")) == 1);
+#if !defined (_WIN32) && defined (O_DIRECT)
+        /* Second descriptor for the aligned writes */
+        if (fd != -1 && async
+         && var_GetBool (p_access, SOUT_CFG_PREFIX"direct"))
+        {
+            direct_fd = vlc_open (path, (flags & ~(O_CREAT|O_EXCL|O_TRUNC))
+                                        | O_DIRECT, 0666);
+            if (direct_fd == -1)
+                msg_Warn (p_access, "cannot use direct I/O on %s: %s", path,
+                          vlc_strerror_c(errno));
+        }
+#endif
         free (buf);
         if (fd == -1)
             return VLC_EGENERIC;
@@ -335,12 +394,54 @@ static int Open( vlc_object_t *p_this )
     if (fstat (fd, &st))
     {
         msg_Err (p_access, "write error: %s", vlc_strerror_c(errno));
+        if (direct_fd != -1)
+            vlc_close (direct_fd);
         vlc_close (fd);
         return VLC_EGENERIC;
     }
 
     p_access->pf_read  = Read;
 
+#ifndef _WIN32
+    if (async && (S_ISREG(st.st_mode) || S_ISBLK(st.st_mode)))
+    {
+        file_writer_cfg_t cfg = {
+            .i_max_pending = var_GetInteger (p_access,
+                                         SOUT_CFG_PREFIX"async-size") << 10,
+            .i_sync_period = var_GetInteger (p_access,
+                                         SOUT_CFG_PREFIX"sync-interval")
+                             * CLOCK_FREQ,
+            .i_sync_bytes = var_GetInteger (p_access,
+                                         SOUT_CFG_PREFIX"sync-size") << 20,
+        };
+        off_t pos = lseek (fd, 0, append ? SEEK_END : SEEK_CUR);
+        file_writer_t *writer = NULL;
+
+        if (pos != -1)
+            writer = file_writer_New (VLC_OBJECT(p_access), fd, direct_fd,
+                                      pos, &cfg);
+        if (writer == NULL)
+        {
+            msg_Err (p_access, "cannot start asynchronous writes");
+            if (direct_fd != -1)
+                vlc_close (direct_fd);
+            vlc_close (fd);
+            return VLC_EGENERIC;
+        }
+
+        p_access->pf_read = ReadAsync;
+        p_access->pf_write = WriteAsync;
+        p_access->pf_seek = SeekAsync;
+        p_access->pf_control = Control;
+        p_access->p_sys = (void *)writer;
+        msg_Dbg( p_access, "file access output opened (%s)",
+                 p_access->psz_path );
+        return VLC_SUCCESS;
+    }
+#endif
+    if (direct_fd != -1)
+        vlc_close (direct_fd);
+
     if (S_ISREG(st.st_mode) || S_ISBLK(st.st_mode))
     {
         p_access->pf_write = Write;
@@ -375,7 +476,12 @@ static void Close( vlc_object_t * p_this )
 {
     sout_access_out_t *p_access = (sout_access_out_t*)p_this;
 
-    vlc_close( (intptr_t)p_access->p_sys );
+#ifndef _WIN32
+    if( p_access->pf_write == WriteAsync )
+        file_writer_Delete( (file_writer_t *)p_access->p_sys );
+    else
+#endif
+        vlc_close( (intptr_t)p_access->p_sys );
 
     msg_Dbg( p_access, "file access output closed" );
 }
@@ -391,6 +497,21 @@ static void Close( vlc_object_t * p_this )
     "on the file path")
 #define SYNC_TEXT N_("Synchronous writing")
 #define SYNC_LONGTEXT N_( "Open the file with synchronous writing.")
+#define ASYNC_TEXT N_("Asynchronous writing")
+#define ASYNC_LONGTEXT N_( "Write the file in the background, so that " \
+    "slow disks do not stall the stream output.")
+#define ASYNC_SIZE_TEXT N_("Asynchronous writing buffer size (kB)")
+#define ASYNC_SIZE_LONGTEXT N_( "Most data waiting to be written, " \
+    "beyond which the stream output waits for the disk.")
+#define DIRECT_TEXT N_("Direct I/O")
+#define DIRECT_LONGTEXT N_( "Bypass the operating system cache when " \
+    "writing asynchronously.")
+#define SYNC_INTERVAL_TEXT N_("Synchronization interval (s)")
+#define SYNC_INTERVAL_LONGTEXT N_( "Flush the written data to the disk " \
+    "periodically when writing asynchronously (0 = never).")
+#define SYNC_SIZE_TEXT N_("Synchronization size (MB)")
+#define SYNC_SIZE_LONGTEXT N_( "Flush the written data to the disk " \
+    "each time that much was written asynchronously (0 = never).")
 
 vlc_module_begin ()
     set_description( N_("File stream output") )
@@ -408,6 +529,23 @@ vlc_module_begin ()
 #ifdef O_SYNC
     add_bool( SOUT_CFG_PREFIX "sync", false, SYNC_TEXT,SYNC_LONGTEXT,
               false )
+#endif
+#ifndef _WIN32
+    add_bool( SOUT_CFG_PREFIX "async", false, ASYNC_TEXT, ASYNC_LONGTEXT,
+              true )
+    add_integer( SOUT_CFG_PREFIX "async-size", 8192, ASYNC_SIZE_TEXT,
+                 ASYNC_SIZE_LONGTEXT, true )
+        change_integer_range( 256, 1048576 )
+# ifdef O_DIRECT
+    add_bool( SOUT_CFG_PREFIX "direct", false, DIRECT_TEXT, DIRECT_LONGTEXT,
+              true )
+# endif
+    add_integer( SOUT_CFG_PREFIX "sync-interval", 0, SYNC_INTERVAL_TEXT,
+                 SYNC_INTERVAL_LONGTEXT, true )
+        change_integer_range( 0, 3600 )
+    add_integer( SOUT_CFG_PREFIX "sync-size", 0, SYNC_SIZE_TEXT,
+                 SYNC_SIZE_LONGTEXT, true )
+        change_integer_range( 0, 65536 )
 #endif
     set_callbacks( Open, Close )
 vlc_module_end ()
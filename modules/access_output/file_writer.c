@@ -0,0 +1,646 @@
+/*****************************************************************************
+ * file_writer.c: asynchronous file writer
+ *****************************************************************************
+ * Copyright (C) 2020 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*****************************************************************************
+ * The data is copied to staging buffers, which are written in the background
+ * so that slow disks do not stall the stream output. The buffers are aligned
+ * in memory and, unless the muxer seeks, in the file, as O_DIRECT requires.
+ *
+ * With io_uring, the caller submits the writes and a thread reaps their
+ * completions. Otherwise, a thread performs the writes one after the other.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#ifdef HAVE_LIBURING
+# include <liburing.h>
+#endif
+
+#include <vlc_common.h>
+#include <vlc_block.h>
+#include <vlc_fs.h>
+
+#include "file_writer.h"
+
+#define WRITER_ALIGN  4096
+#define WRITER_CHUNK  (256 * 1024)
+/* Longest time buffered data waits before being written */
+#define WRITER_DELAY  (CLOCK_FREQ / 2)
+/* Most writes in flight */
+#define WRITER_DEPTH  64
+#define WRITER_STATS_PERIOD (10 * CLOCK_FREQ)
+
+typedef struct writer_req_t
+{
+    struct writer_req_t *p_next;
+
+    uint8_t     *p_buf;
+    size_t       i_size;
+    size_t       i_done;
+    uint64_t     i_offset;
+    int          fd;
+    bool         b_sync;
+    mtime_t      i_date;
+    struct iovec iov;
+} writer_req_t;
+
+struct file_writer_t
+{
+    vlc_object_t     *obj;
+    int               fd;
+    int               direct_fd;
+    file_writer_cfg_t cfg;
+
+    /* Caller side */
+    uint8_t  *p_stage;
+    size_t    i_stage;
+    size_t    i_stage_max;
+    mtime_t   i_stage_date;
+    uint64_t  i_offset; /* of the staging buffer in the file */
+    mtime_t   i_sync_date;
+    uint64_t  i_sync_bytes;
+
+    vlc_mutex_t   lock;
+    vlc_cond_t    wait; /* a request completed */
+    vlc_cond_t    work; /* a request was queued */
+    writer_req_t *p_first; /* queued, or in flight with io_uring */
+    writer_req_t **pp_last;
+    size_t        i_pending; /* bytes queued or in flight */
+    unsigned      i_requests;
+    int           i_error;
+    bool          b_quit;
+    vlc_thread_t  thread;
+
+#ifdef HAVE_LIBURING
+    bool            b_uring;
+    bool            b_broken; /* the completion thread failed */
+    struct io_uring ring;
+#endif
+
+    struct
+    {
+        mtime_t  i_date;
+        unsigned i_depth_max;
+        uint64_t i_writes;
+        mtime_t  i_latency;
+        mtime_t  i_latency_max;
+    } stats;
+};
+
+/* Performs a request synchronously, returns an error number */
+static int Process( file_writer_t *w, writer_req_t *req )
+{
+    if( req->b_sync )
+        return fdatasync( w->fd ) ? errno : 0;
+
+    while( req->i_done < req->i_size )
+    {
+        ssize_t val = pwrite( req->fd, req->p_buf + req->i_done,
+                              req->i_size - req->i_done,
+                              req->i_offset + req->i_done );
+        if( val < 0 )
+        {
+            if( errno == EINTR )
+                continue;
+            return errno;
+        }
+        if( val == 0 )
+            return EIO;
+        req->i_done += val;
+    }
+    return 0;
+}
+
+/* Must be called with the lock held */
+static void Complete( file_writer_t *w, writer_req_t *req, int i_error )
+{
+    const mtime_t i_latency = mdate() - req->i_date;
+
+    w->stats.i_writes++;
+    w->stats.i_latency += i_latency;
+    if( i_latency > w->stats.i_latency_max )
+        w->stats.i_latency_max = i_latency;
+
+    if( i_error != 0 && w->i_error == 0 )
+        w->i_error = i_error;
+    w->i_pending -= req->i_size;
+    w->i_requests--;
+    vlc_cond_broadcast( &w->wait );
+
+    aligned_free( req->p_buf );
+    free( req );
+}
+
+static void *Thread( void *data )
+{
+    file_writer_t *w = data;
+
+    vlc_mutex_lock( &w->lock );
+    for( ;; )
+    {
+        while( w->p_first == NULL && !w->b_quit )
+            vlc_cond_wait( &w->work, &w->lock );
+
+        writer_req_t *req = w->p_first;
+        if( req == NULL )
+            break;
+        w->p_first = req->p_next;
+        if( w->p_first == NULL )
+            w->pp_last = &w->p_first;
+        vlc_mutex_unlock( &w->lock );
+
+        int i_error = Process( w, req );
+
+        vlc_mutex_lock( &w->lock );
+        Complete( w, req, i_error );
+    }
+    vlc_mutex_unlock( &w->lock );
+    return NULL;
+}
+
+#ifdef HAVE_LIBURING
+/* Must be called with the lock held */
+static void SubmitUring( file_writer_t *w, writer_req_t *req )
+{
+    struct io_uring_sqe *sqe = io_uring_get_sqe( &w->ring );
+
+    /* There are never more requests than submission entries */
+    assert( sqe != NULL );
+
+    if( req != NULL && req->b_sync )
+    {
+        /* Waits for the writes queued before */
+        io_uring_prep_fsync( sqe, w->fd, IORING_FSYNC_DATASYNC );
+        io_uring_sqe_set_flags( sqe, IOSQE_IO_DRAIN );
+    }
+    else if( req != NULL )
+    {
+        req->iov.iov_base = req->p_buf + req->i_done;
+        req->iov.iov_len = req->i_size - req->i_done;
+        io_uring_prep_writev( sqe, req->fd, &req->iov, 1,
+                              req->i_offset + req->i_done );
+    }
+    else
+        io_uring_prep_nop( sqe );
+    io_uring_sqe_set_data( sqe, req );
+    io_uring_submit( &w->ring );
+}
+
+/* Must be called with the lock held */
+static void Unqueue( file_writer_t *w, writer_req_t *req )
+{
+    writer_req_t **pp = &w->p_first;
+
+    while( *pp != req )
+        pp = &(*pp)->p_next;
+    *pp = req->p_next;
+    if( *pp == NULL )
+        w->pp_last = pp;
+}
+
+static void *UringThread( void *data )
+{
+    file_writer_t *w = data;
+
+    for( ;; )
+    {
+        struct io_uring_cqe *cqe;
+
+        int val = io_uring_wait_cqe( &w->ring, &cqe );
+        if( val == -EINTR )
+            continue;
+        if( val < 0 )
+        {   /* No more completions: fail the requests in flight */
+            msg_Err( w->obj, "cannot wait for writes: %s",
+                     vlc_strerror_c( -val ) );
+            vlc_mutex_lock( &w->lock );
+            w->b_broken = true;
+            if( w->i_error == 0 )
+                w->i_error = -val;
+            while( w->p_first != NULL )
+            {
+                writer_req_t *req = w->p_first;
+
+                w->p_first = req->p_next;
+                Complete( w, req, -val );
+            }
+            w->pp_last = &w->p_first;
+            vlc_mutex_unlock( &w->lock );
+            break;
+        }
+
+        writer_req_t *req = io_uring_cqe_get_data( cqe );
+        int res = cqe->res;
+        io_uring_cqe_seen( &w->ring, cqe );
+
+        if( req == NULL )
+            break; /* woken up to quit */
+
+        int i_error = 0;
+        if( res < 0 )
+            i_error = -res;
+        else if( !req->b_sync )
+        {
+            if( res == 0 )
+                i_error = EIO;
+            else if( (req->i_done += res) < req->i_size )
+            {   /* Short write: queue the rest */
+                vlc_mutex_lock( &w->lock );
+                SubmitUring( w, req );
+                vlc_mutex_unlock( &w->lock );
+                continue;
+            }
+        }
+
+        vlc_mutex_lock( &w->lock );
+        Unqueue( w, req );
+        Complete( w, req, i_error );
+        vlc_mutex_unlock( &w->lock );
+    }
+    return NULL;
+}
+#endif
+
+static void Queue( file_writer_t *w, writer_req_t *req )
+{
+    vlc_mutex_lock( &w->lock );
+    while( w->i_requests > 0
+        && ( w->i_requests >= WRITER_DEPTH
+          || w->i_pending + req->i_size > w->cfg.i_max_pending ) )
+        vlc_cond_wait( &w->wait, &w->lock );
+
+    req->i_date = mdate();
+    w->i_pending += req->i_size;
+    w->i_requests++;
+    if( w->i_requests > w->stats.i_depth_max )
+        w->stats.i_depth_max = w->i_requests;
+
+#ifdef HAVE_LIBURING
+    if( w->b_uring && w->b_broken )
+    {
+        Complete( w, req, w->i_error );
+        vlc_mutex_unlock( &w->lock );
+        return;
+    }
+#endif
+    req->p_next = NULL;
+    *w->pp_last = req;
+    w->pp_last = &req->p_next;
+#ifdef HAVE_LIBURING
+    if( w->b_uring )
+        SubmitUring( w, req );
+    else
+#endif
+        vlc_cond_signal( &w->work );
+    vlc_mutex_unlock( &w->lock );
+}
+
+static void Drain( file_writer_t *w )
+{
+    vlc_mutex_lock( &w->lock );
+    while( w->i_requests > 0 )
+        vlc_cond_wait( &w->wait, &w->lock );
+    vlc_mutex_unlock( &w->lock );
+}
+
+static writer_req_t *RequestNew( void )
+{
+    writer_req_t *req = malloc( sizeof( *req ) );
+    if( likely(req != NULL) )
+    {
+        req->p_buf = NULL;
+        req->i_size = req->i_done = 0;
+        req->i_offset = 0;
+        req->fd = -1;
+        req->b_sync = false;
+    }
+    return req;
+}
+
+/* Queues the staging buffer */
+static void Flush( file_writer_t *w )
+{
+    if( w->i_stage == 0 )
+        return;
+
+    writer_req_t *req = RequestNew();
+    if( unlikely(req == NULL) )
+    {
+        vlc_mutex_lock( &w->lock );
+        if( w->i_error == 0 )
+            w->i_error = ENOMEM;
+        vlc_mutex_unlock( &w->lock );
+        return;
+    }
+
+    const bool b_direct = w->direct_fd != -1
+                       && (w->i_offset % WRITER_ALIGN) == 0
+                       && (w->i_stage % WRITER_ALIGN) == 0;
+
+    req->p_buf = w->p_stage;
+    req->i_size = w->i_stage;
+    req->i_offset = w->i_offset;
+    req->fd = b_direct ? w->direct_fd : w->fd;
+
+    w->i_offset += w->i_stage;
+    w->i_sync_bytes += w->i_stage;
+    w->p_stage = NULL;
+    w->i_stage = 0;
+
+    if( w->direct_fd != -1 && !b_direct )
+    {   /* Keep buffered writes clear of direct ones (e.g. the tail) */
+        Drain( w );
+        Queue( w, req );
+        Drain( w );
+    }
+    else
+        Queue( w, req );
+}
+
+static int Stage( file_writer_t *w )
+{
+    w->p_stage = aligned_alloc( WRITER_ALIGN, WRITER_CHUNK );
+    if( unlikely(w->p_stage == NULL) )
+        return -1;
+
+    /* End the buffer on an aligned offset, even after a seek */
+    w->i_stage_max = WRITER_CHUNK - (w->i_offset % WRITER_ALIGN);
+    w->i_stage_date = mdate();
+    return 0;
+}
+
+static void Sync( file_writer_t *w, mtime_t i_now )
+{
+    /* Direct writes must wait for a full buffer */
+    if( w->direct_fd == -1 )
+        Flush( w );
+
+    w->i_sync_date = i_now;
+    if( w->i_sync_bytes == 0 )
+        return;
+    w->i_sync_bytes = 0;
+
+    writer_req_t *req = RequestNew();
+    if( likely(req != NULL) )
+    {
+        req->fd = w->fd;
+        req->b_sync = true;
+        Queue( w, req );
+    }
+}
+
+static void Stats( file_writer_t *w, mtime_t i_now, bool b_final )
+{
+    if( !b_final && i_now - w->stats.i_date < WRITER_STATS_PERIOD )
+        return;
+
+    vlc_mutex_lock( &w->lock );
+    const unsigned i_depth = w->i_requests;
+    const unsigned i_depth_max = w->stats.i_depth_max;
+    const size_t i_pending = w->i_pending;
+    const uint64_t i_writes = w->stats.i_writes;
+    const mtime_t i_latency = i_writes ? w->stats.i_latency / i_writes : 0;
+    const mtime_t i_latency_max = w->stats.i_latency_max;
+
+    w->stats.i_depth_max = i_depth;
+    w->stats.i_writes = 0;
+    w->stats.i_latency = 0;
+    w->stats.i_latency_max = 0;
+    vlc_mutex_unlock( &w->lock );
+
+    w->stats.i_date = i_now;
+    msg_Dbg( w->obj, "queue depth %u (max %u, %zu bytes), %"PRIu64" writes,"
+             " latency %"PRId64" us (max %"PRId64" us)", i_depth, i_depth_max,
+             i_pending, i_writes, i_latency, i_latency_max );
+}
+
+file_writer_t *file_writer_New( vlc_object_t *obj, int fd, int direct_fd,
+                                uint64_t i_offset,
+                                const file_writer_cfg_t *cfg )
+{
+    file_writer_t *w = malloc( sizeof( *w ) );
+    if( unlikely(w == NULL) )
+        return NULL;
+
+    w->obj = obj;
+    w->fd = fd;
+    w->direct_fd = direct_fd;
+    w->cfg = *cfg;
+    if( w->cfg.i_max_pending < WRITER_CHUNK )
+        w->cfg.i_max_pending = WRITER_CHUNK;
+
+    w->p_stage = NULL;
+    w->i_stage = 0;
+    w->i_offset = i_offset;
+    w->i_sync_date = mdate();
+    w->i_sync_bytes = 0;
+
+    vlc_mutex_init( &w->lock );
+    vlc_cond_init( &w->wait );
+    vlc_cond_init( &w->work );
+    w->p_first = NULL;
+    w->pp_last = &w->p_first;
+    w->i_pending = 0;
+    w->i_requests = 0;
+    w->i_error = 0;
+    w->b_quit = false;
+
+    w->stats.i_date = mdate();
+    w->stats.i_depth_max = 0;
+    w->stats.i_writes = 0;
+    w->stats.i_latency = 0;
+    w->stats.i_latency_max = 0;
+
+    void *(*entry)( void * ) = Thread;
+#ifdef HAVE_LIBURING
+    /* One more entry to wake the completion thread up */
+    int val = io_uring_queue_init( WRITER_DEPTH + 1, &w->ring, 0 );
+    w->b_uring = val == 0;
+    w->b_broken = false;
+    if( w->b_uring )
+        entry = UringThread;
+    else
+        msg_Warn( obj, "io_uring not available (%s), using a thread",
+                  vlc_strerror_c( -val ) );
+#endif
+
+    if( vlc_clone( &w->thread, entry, w, VLC_THREAD_PRIORITY_OUTPUT ) )
+    {
+#ifdef HAVE_LIBURING
+        if( w->b_uring )
+            io_uring_queue_exit( &w->ring );
+#endif
+        vlc_cond_destroy( &w->work );
+        vlc_cond_destroy( &w->wait );
+        vlc_mutex_destroy( &w->lock );
+        free( w );
+        return NULL;
+    }
+
+    msg_Dbg( obj, "asynchronous writes%s%s",
+#ifdef HAVE_LIBURING
+             w->b_uring ? " with io_uring" : "",
+#else
+             "",
+#endif
+             direct_fd != -1 ? ", direct I/O" : "" );
+    return w;
+}
+
+void file_writer_Delete( file_writer_t *w )
+{
+    Flush( w );
+    if( w->cfg.i_sync_period > 0 || w->cfg.i_sync_bytes > 0 )
+        Sync( w, mdate() );
+    Drain( w );
+
+    vlc_mutex_lock( &w->lock );
+    w->b_quit = true;
+#ifdef HAVE_LIBURING
+    if( w->b_uring )
+    {
+        if( !w->b_broken )
+            SubmitUring( w, NULL );
+    }
+    else
+#endif
+        vlc_cond_signal( &w->work );
+    vlc_mutex_unlock( &w->lock );
+    vlc_join( w->thread, NULL );
+
+#ifdef HAVE_LIBURING
+    if( w->b_uring )
+        io_uring_queue_exit( &w->ring );
+#endif
+    if( w->i_error != 0 )
+        msg_Err( w->obj, "cannot write: %s", vlc_strerror_c( w->i_error ) );
+    Stats( w, mdate(), true );
+
+    aligned_free( w->p_stage );
+    if( w->direct_fd != -1 )
+        vlc_close( w->direct_fd );
+    vlc_close( w->fd );
+    vlc_cond_destroy( &w->work );
+    vlc_cond_destroy( &w->wait );
+    vlc_mutex_destroy( &w->lock );
+    free( w );
+}
+
+ssize_t file_writer_Write( file_writer_t *w, block_t *p_block )
+{
+    ssize_t i_total = 0;
+
+    vlc_mutex_lock( &w->lock );
+    int i_error = w->i_error;
+    vlc_mutex_unlock( &w->lock );
+
+    if( i_error != 0 )
+    {
+        block_ChainRelease( p_block );
+        errno = i_error;
+        return -1;
+    }
+
+    while( p_block != NULL )
+    {
+        const uint8_t *p_data = p_block->p_buffer;
+        size_t i_data = p_block->i_buffer;
+
+        while( i_data > 0 )
+        {
+            if( w->p_stage == NULL && Stage( w ) )
+            {
+                block_ChainRelease( p_block );
+                errno = ENOMEM;
+                return -1;
+            }
+
+            size_t i_copy = __MIN( i_data, w->i_stage_max - w->i_stage );
+            memcpy( w->p_stage + w->i_stage, p_data, i_copy );
+            w->i_stage += i_copy;
+            p_data += i_copy;
+            i_data -= i_copy;
+
+            if( w->i_stage == w->i_stage_max )
+                Flush( w );
+        }
+
+        i_total += p_block->i_buffer;
+
+        block_t *p_next = p_block->p_next;
+        block_Release( p_block );
+        p_block = p_next;
+    }
+
+    const mtime_t i_now = mdate();
+
+    /* Direct writes must wait for a full buffer */
+    if( w->direct_fd == -1 && w->i_stage > 0
+     && i_now - w->i_stage_date >= WRITER_DELAY )
+        Flush( w );
+
+    if( ( w->cfg.i_sync_period > 0
+       && i_now - w->i_sync_date >= w->cfg.i_sync_period )
+     || ( w->cfg.i_sync_bytes > 0 && w->i_sync_bytes >= w->cfg.i_sync_bytes ) )
+        Sync( w, i_now );
+
+    Stats( w, i_now, false );
+    return i_total;
+}
+
+int file_writer_Seek( file_writer_t *w, uint64_t i_offset )
+{
+    if( i_offset == w->i_offset + w->i_stage )
+        return 0;
+
+    /* Writes at different offsets may complete in any order */
+    Flush( w );
+    Drain( w );
+    aligned_free( w->p_stage );
+    w->p_stage = NULL;
+    w->i_offset = i_offset;
+    return 0;
+}
+
+ssize_t file_writer_Read( file_writer_t *w, block_t *p_block )
+{
+    ssize_t val;
+
+    Flush( w );
+    Drain( w );
+    aligned_free( w->p_stage );
+    w->p_stage = NULL;
+
+    do
+        val = pread( w->fd, p_block->p_buffer, p_block->i_buffer,
+                     w->i_offset );
+    while( val == -1 && errno == EINTR );
+
+    if( val > 0 )
+        w->i_offset += val;
+    return val;
+}
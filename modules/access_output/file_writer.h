@@ -0,0 +1,58 @@
+/*****************************************************************************
+ * file_writer.h: asynchronous file writer
+ *****************************************************************************
+ * Copyright (C) 2020 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef VLC_ACCESS_OUTPUT_FILE_WRITER_H
+#define VLC_ACCESS_OUTPUT_FILE_WRITER_H 1
+
+typedef struct file_writer_t file_writer_t;
+
+typedef struct
+{
+    size_t   i_max_pending; /* bytes queued or being written */
+    mtime_t  i_sync_period; /* fdatasync() period, 0 to disable */
+    uint64_t i_sync_bytes;  /* fdatasync() every that many bytes, 0 to disable */
+} file_writer_cfg_t;
+
+/**
+ * Creates a writer for the regular file fd, starting at offset i_offset.
+ *
+ * The writer takes ownership of fd, and of direct_fd if not -1. The latter
+ * refers to the same file opened with O_DIRECT and is used for the aligned
+ * parts of the data.
+ */
+file_writer_t *file_writer_New( vlc_object_t *, int fd, int direct_fd,
+                                uint64_t i_offset, const file_writer_cfg_t * );
+/**
+ * Waits for all queued data to be written, then destroys the writer and
+ * closes its file descriptors.
+ */
+void file_writer_Delete( file_writer_t * );
+
+/**
+ * Queues a chain of blocks at the current offset.
+ *
+ * Blocks if more than i_max_pending bytes are already queued.
+ * \return the number of bytes queued, or -1 if a former write failed
+ */
+ssize_t file_writer_Write( file_writer_t *, block_t * );
+int file_writer_Seek( file_writer_t *, uint64_t i_offset );
+ssize_t file_writer_Read( file_writer_t *, block_t * );
+
+#endif
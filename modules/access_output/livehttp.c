@@ -43,6 +43,8 @@
 #include <vlc_fs.h>
 #include <vlc_strings.h>
 #include <vlc_charset.h>
+#include <vlc_httpd.h>
+#include <vlc_memstream.h>
 
 #include <gcrypt.h>
 #include <vlc_gcrypt.h>
@@ -105,6 +107,19 @@ static void Close( vlc_object_t * );
 #define INTITIAL_SEG_TEXT N_("Number of first segment")
 #define INITIAL_SEG_LONGTEXT N_("The number of the first segment generated")
 
+#define PARTLEN_TEXT N_("Partial segment length")
+#define PARTLEN_LONGTEXT N_("Length in milliseconds of the low latency " \
+                            "partial segments, 0 to disable them")
+
+#define MPD_TEXT N_("DASH manifest file")
+#define MPD_LONGTEXT N_("Path to the DASH manifest to create along with the " \
+                        "index, for fragmented MP4 segments")
+
+#define HTTPINDEX_TEXT N_("HTTP index URL")
+#define HTTPINDEX_LONGTEXT N_("Serve the low latency playlist and segments " \
+                              "from the built-in HTTP server, at this URL " \
+                              "(e.g. /live/index.m3u8)")
+
 vlc_module_begin ()
     set_description( N_("HTTP Live streaming output") )
     set_shortname( N_("LiveHTTP" ))
@@ -115,6 +130,9 @@ vlc_module_begin ()
     add_integer( SOUT_CFG_PREFIX "seglen", 10, SEGLEN_TEXT, SEGLEN_LONGTEXT, false )
     add_integer( SOUT_CFG_PREFIX "numsegs", 0, NUMSEGS_TEXT, NUMSEGS_LONGTEXT, false )
     add_integer( SOUT_CFG_PREFIX "initial-segment-number", 1, INTITIAL_SEG_TEXT, INITIAL_SEG_LONGTEXT, false )
+    add_integer( SOUT_CFG_PREFIX "partlen", 0, PARTLEN_TEXT, PARTLEN_LONGTEXT, false )
+    add_string( SOUT_CFG_PREFIX "http-index", NULL,
+                HTTPINDEX_TEXT, HTTPINDEX_LONGTEXT, false )
     add_bool( SOUT_CFG_PREFIX "splitanywhere", false,
               SPLITANYWHERE_TEXT, SPLITANYWHERE_LONGTEXT, true )
     add_bool( SOUT_CFG_PREFIX "delsegs", true,
@@ -129,6 +147,8 @@ vlc_module_begin ()
                 INDEX_TEXT, INDEX_LONGTEXT, false )
     add_string( SOUT_CFG_PREFIX "index-url", NULL,
                 INDEXURL_TEXT, INDEXURL_LONGTEXT, false )
+    add_string( SOUT_CFG_PREFIX "mpd", NULL,
+                MPD_TEXT, MPD_LONGTEXT, false )
     add_string( SOUT_CFG_PREFIX "key-uri", NULL,
                 KEYURI_TEXT, KEYURI_TEXT, true )
     add_loadfile( SOUT_CFG_PREFIX "key-file", NULL,
@@ -156,6 +176,9 @@ static const char *const ppsz_sout_options[] = {
     "key-loadfile",
     "generate-iv",
     "initial-segment-number",
+    "partlen",
+    "http-index",
+    "mpd",
     NULL
 };
 
@@ -171,8 +194,13 @@ typedef struct output_segment
     float f_seglength;
     uint32_t i_segment_number;
     uint8_t aes_ivs[16];
+    mtime_t i_start;
+    mtime_t i_duration;
+    uint64_t i_size;
 } output_segment_t;
 
+typedef struct livehttp_ll_t livehttp_ll_t;
+
 struct sout_access_out_sys_t
 {
     char *psz_cursegPath;
@@ -205,6 +233,22 @@ struct sout_access_out_sys_t
     uint8_t stuffing_bytes[16];
     ssize_t stuffing_size;
     vlc_array_t segments_t;
+    livehttp_ll_t *p_ll;
+
+    /* fragmented MP4 segments, after an init segment */
+    bool b_fmp4;
+    bool b_fmp4_protected;
+    char *psz_initUri;
+    char *psz_mpdPath;
+    char *psz_codecs;
+    unsigned i_width;
+    unsigned i_height;
+    bool b_has_video;
+    uint8_t kid[16];
+    mtime_t i_fmp4_end;
+    mtime_t i_mpd_origin;
+    time_t i_mpd_start;
+    uint64_t i_segment_bytes;
 };
 
 static int LoadCryptFile( sout_access_out_t *p_access);
@@ -212,6 +256,12 @@ static int CryptSetup( sout_access_out_t *p_access, char *keyfile );
 static int CheckSegmentChange( sout_access_out_t *p_access, block_t *p_buffer );
 static ssize_t writeSegment( sout_access_out_t *p_access );
 static ssize_t openNextFile( sout_access_out_t *p_access, sout_access_out_sys_t *p_sys );
+static int writeInitSegment( sout_access_out_t *p_access, block_t *p_block );
+static void writeMPD( sout_access_out_t *p_access, sout_access_out_sys_t *p_sys,
+                      uint32_t i_firstseg, unsigned i_index_offset, bool b_isend );
+static int LLOpen( sout_access_out_t *p_access );
+static void LLClose( sout_access_out_t *p_access );
+static ssize_t LLWrite( sout_access_out_t *p_access, block_t *p_buffer );
 /*****************************************************************************
  * Open: open the file
  *****************************************************************************/
@@ -275,6 +325,14 @@ static int Open( vlc_object_t *p_this )
     }
 
     p_sys->psz_indexUrl = var_GetNonEmptyString( p_access, SOUT_CFG_PREFIX "index-url" );
+    p_sys->psz_mpdPath = NULL;
+    psz_idx = var_GetNonEmptyString( p_access, SOUT_CFG_PREFIX "mpd" );
+    if( psz_idx )
+    {
+        p_sys->psz_mpdPath = vlc_strftime( psz_idx );
+        free( psz_idx );
+    }
+    p_sys->i_mpd_origin = VLC_TS_INVALID;
     p_sys->psz_keyfile  = var_GetNonEmptyString( p_access, SOUT_CFG_PREFIX "key-loadfile" );
     p_sys->key_uri      = var_GetNonEmptyString( p_access, SOUT_CFG_PREFIX "key-uri" );
 
@@ -284,6 +342,7 @@ static int Open( vlc_object_t *p_this )
     {
         free( p_sys->psz_indexUrl );
         free( p_sys->psz_indexPath );
+        free( p_sys->psz_mpdPath );
         free( p_sys );
         msg_Err( p_access, "Encryption init failed" );
         return VLC_EGENERIC;
@@ -292,6 +351,7 @@ static int Open( vlc_object_t *p_this )
     {
         free( p_sys->psz_indexUrl );
         free( p_sys->psz_indexPath );
+        free( p_sys->psz_mpdPath );
         free( p_sys );
         msg_Err( p_access, "Encryption init failed" );
         return VLC_EGENERIC;
@@ -301,6 +361,21 @@ static int Open( vlc_object_t *p_this )
     p_sys->i_segment = p_sys->i_initial_segment-1;
     p_sys->psz_cursegPath = NULL;
 
+    if( var_GetInteger( p_access, SOUT_CFG_PREFIX "partlen" ) > 0 )
+    {
+        if( p_sys->key_uri )
+            msg_Warn( p_access, "Partial segments are not supported with "
+                      "encryption, disabling them" );
+        else if( LLOpen( p_access ) )
+        {
+            free( p_sys->psz_indexUrl );
+            free( p_sys->psz_indexPath );
+            free( p_sys->psz_mpdPath );
+            free( p_sys );
+            return VLC_EGENERIC;
+        }
+    }
+
     p_access->pf_write = Write;
     p_access->pf_control = Control;
 
@@ -504,6 +579,51 @@ static char *formatSegmentPath( char *psz_path, uint32_t i_seg )
     return psz_result;
 }
 
+/*****************************************************************************
+ * formatSegmentTemplate: name of the init segment, or DASH media template
+ *****************************************************************************/
+static char *formatSegmentTemplate( char *psz_path, bool b_init )
+{
+    char *psz_result, *psz_newResult;
+    int ret;
+
+    if ( ! ( psz_result  = vlc_strftime( psz_path ) ) )
+        return NULL;
+
+    char *psz_firstNumSign = psz_result + strcspn( psz_result, SEG_NUMBER_PLACEHOLDER );
+    if ( !*psz_firstNumSign )
+    {
+        if ( !b_init )
+            return psz_result;
+        ret = asprintf( &psz_newResult, "%s.init", psz_result );
+    }
+    else
+    {
+        int i_cnt = strspn( psz_firstNumSign, SEG_NUMBER_PLACEHOLDER );
+
+        *psz_firstNumSign = '\0';
+        if ( b_init )
+            ret = asprintf( &psz_newResult, "%sinit%s", psz_result,
+                            psz_firstNumSign + i_cnt );
+        else
+            ret = asprintf( &psz_newResult, "%s$Number%%0%dd$%s", psz_result,
+                            i_cnt, psz_firstNumSign + i_cnt );
+    }
+    free( psz_result );
+    return ret < 0 ? NULL : psz_newResult;
+}
+
+/*****************************************************************************
+ * formatDuration: locale independent seconds with milliseconds
+ *****************************************************************************/
+static void formatDuration( char psz[24], mtime_t i_duration )
+{
+    int64_t i_ms = (i_duration + 500) / 1000;
+
+    snprintf( psz, 24, "%"PRId64".%03u", i_ms / 1000,
+              (unsigned)(i_ms % 1000) );
+}
+
 static void destroySegment( output_segment_t *segment )
 {
     free( segment->psz_filename );
@@ -593,9 +713,9 @@ static int updateIndexAndDel( sout_access_out_t *p_access, sout_access_out_sys_t
             return -1;
         }
 
-        if ( fprintf( fp, "#EXTM3U\n#EXT-X-TARGETDURATION:%zu\n#EXT-X-VERSION:3\n#EXT-X-ALLOW-CACHE:%s"
+        if ( fprintf( fp, "#EXTM3U\n#EXT-X-TARGETDURATION:%zu\n#EXT-X-VERSION:%d\n#EXT-X-ALLOW-CACHE:%s"
                           "%s\n#EXT-X-MEDIA-SEQUENCE:%"PRIu32"\n%s", p_sys->i_seglen,
-                          p_sys->b_caching ? "YES" : "NO",
+                          p_sys->b_fmp4 ? 7 : 3, p_sys->b_caching ? "YES" : "NO",
                           p_sys->i_numsegs > 0 ? "" : b_isend ? "\n#EXT-X-PLAYLIST-TYPE:VOD" : "\n#EXT-X-PLAYLIST-TYPE:EVENT",
                           i_firstseg, ((p_sys->i_initial_segment > 1) && (p_sys->i_initial_segment == i_firstseg)) ? "#EXT-X-DISCONTINUITY\n" : ""
                           ) < 0 )
@@ -604,6 +724,13 @@ static int updateIndexAndDel( sout_access_out_t *p_access, sout_access_out_sys_t
             fclose( fp );
             return -1;
         }
+        if ( p_sys->b_fmp4 &&
+             fprintf( fp, "#EXT-X-MAP:URI=\"%s\"\n", p_sys->psz_initUri ) < 0 )
+        {
+            free( psz_idxTmp );
+            fclose( fp );
+            return -1;
+        }
         char *psz_current_uri=NULL;
 
 
@@ -620,7 +747,13 @@ static int updateIndexAndDel( sout_access_out_t *p_access, sout_access_out_sys_t
                 int ret = 0;
                 free( psz_current_uri );
                 psz_current_uri = strdup( segment->psz_key_uri );
-                if( p_sys->b_generate_iv )
+                if( p_sys->b_fmp4 )
+                {
+                    /* The IV of the samples is in the init segment */
+                    ret = fprintf( fp, "#EXT-X-KEY:METHOD=SAMPLE-AES,URI=\"%s\","
+                                   "KEYFORMAT=\"identity\"\n", segment->psz_key_uri );
+                }
+                else if( p_sys->b_generate_iv )
                 {
                     unsigned long long iv_hi = segment->aes_ivs[0];
                     unsigned long long iv_lo = segment->aes_ivs[8];
@@ -682,6 +815,9 @@ static int updateIndexAndDel( sout_access_out_t *p_access, sout_access_out_sys_t
         free( psz_idxTmp );
     }
 
+    if ( p_sys->b_fmp4 && p_sys->psz_mpdPath )
+        writeMPD( p_access, p_sys, i_firstseg, i_index_offset, b_isend );
+
     // Then take care of deletion
     // Try to follow pantos draft 11 section 6.2.2
     while( p_sys->b_delsegs && p_sys->i_numsegs &&
@@ -714,7 +850,7 @@ static void closeCurrentSegment( sout_access_out_t *p_access, sout_access_out_sy
     {
         output_segment_t *segment = vlc_array_item_at_index( &p_sys->segments_t, vlc_array_count( &p_sys->segments_t ) - 1 );
 
-        if( p_sys->key_uri )
+        if( p_sys->key_uri && !p_sys->b_fmp4 )
         {
             size_t pad = 16 - p_sys->stuffing_size;
             memset(&p_sys->stuffing_bytes[p_sys->stuffing_size], pad, pad);
@@ -741,6 +877,9 @@ static void closeCurrentSegment( sout_access_out_t *p_access, sout_access_out_sy
             return;
         }
         segment->f_seglength = p_sys->f_seglen;
+        segment->i_start = p_sys->i_opendts;
+        segment->i_duration = p_sys->f_seglen * CLOCK_FREQ;
+        segment->i_size = p_sys->i_segment_bytes;
 
         segment->i_segment_number = p_sys->i_segment;
 
@@ -762,6 +901,17 @@ static void Close( vlc_object_t * p_this )
     sout_access_out_t *p_access = (sout_access_out_t*)p_this;
     sout_access_out_sys_t *p_sys = p_access->p_sys;
 
+    if( p_sys->p_ll )
+    {
+        LLClose( p_access );
+        free( p_sys->psz_indexUrl );
+        free( p_sys->psz_indexPath );
+        free( p_sys->psz_mpdPath );
+        free( p_sys );
+        msg_Dbg( p_access, "livehttp access output closed" );
+        return;
+    }
+
     if( p_sys->ongoing_segment )
         block_ChainLastAppend( &p_sys->full_segments_end, p_sys->ongoing_segment );
     p_sys->ongoing_segment = NULL;
@@ -817,6 +967,9 @@ static void Close( vlc_object_t * p_this )
         destroySegment( segment );
     }
 
+    free( p_sys->psz_initUri );
+    free( p_sys->psz_codecs );
+    free( p_sys->psz_mpdPath );
     free( p_sys->psz_indexUrl );
     free( p_sys->psz_indexPath );
     free( p_sys );
@@ -896,12 +1049,56 @@ static ssize_t openNextFile( sout_access_out_t *p_access, sout_access_out_sys_t
     }
     msg_Dbg( p_access, "Successfully opened livehttp file: %s (%"PRIu32")" , segment->psz_filename, i_newseg );
 
+    if( p_sys->psz_mpdPath && !p_sys->b_fmp4 && i_newseg == p_sys->i_initial_segment )
+        msg_Warn( p_access, "DASH manifest needs fragmented MP4 segments" );
+    if( p_sys->i_mpd_origin == VLC_TS_INVALID )
+        p_sys->i_mpd_origin = p_sys->i_opendts;
+
     p_sys->psz_cursegPath = strdup(segment->psz_filename);
     p_sys->i_handle = fd;
     p_sys->i_segment = i_newseg;
+    p_sys->i_segment_bytes = 0;
     p_sys->b_segment_has_data = false;
     return fd;
 }
+static bool isBox( const block_t *p_buffer, const char *psz_type )
+{
+    return p_buffer->i_buffer >= 8 && !memcmp( &p_buffer->p_buffer[4], psz_type, 4 );
+}
+
+/* Header from the fragmented MP4 muxer, the init segment */
+static bool isFmp4Header( const block_t *p_buffer )
+{
+    return ( p_buffer->i_flags & BLOCK_FLAG_HEADER ) && isBox( p_buffer, "ftyp" );
+}
+
+/*****************************************************************************
+ * isSegmentStart: Check if a segment can start with this block
+ *****************************************************************************/
+static bool isSegmentStart( sout_access_out_sys_t *p_sys, const block_t *p_buffer )
+{
+    if( !p_sys->b_fmp4 )
+        return p_sys->b_splitanywhere || ( p_buffer->i_flags & BLOCK_FLAG_HEADER );
+
+    /* Fragments, flagged by the muxer when they start with a keyframe */
+    return isBox( p_buffer, "moof" ) &&
+           ( p_sys->b_splitanywhere || ( p_buffer->i_flags & BLOCK_FLAG_TYPE_I ) );
+}
+
+/*****************************************************************************
+ * isSegmentEnd: Check if the segment is long enough to be closed
+ *****************************************************************************/
+static bool isSegmentEnd( sout_access_out_sys_t *p_sys, const block_t *p_buffer )
+{
+    if( !p_sys->b_fmp4 )
+        return ( p_buffer->i_length + p_buffer->i_dts - p_sys->i_opendts ) >= p_sys->i_seglenm;
+
+    /* Cut on segment length boundaries of the timeline, so that the segments
+     * of renditions with aligned keyframes are aligned too */
+    return isSegmentStart( p_sys, p_buffer ) &&
+           p_buffer->i_dts / p_sys->i_seglenm > p_sys->i_opendts / p_sys->i_seglenm;
+}
+
 /*****************************************************************************
  * CheckSegmentChange: Check if segment needs to be closed and new opened
  *****************************************************************************/
@@ -911,7 +1108,7 @@ static int CheckSegmentChange( sout_access_out_t *p_access, block_t *p_buffer )
     ssize_t writevalue = 0;
 
     if( p_sys->i_handle > 0 && p_sys->b_segment_has_data &&
-       (( p_buffer->i_length + p_buffer->i_dts - p_sys->i_opendts ) >= p_sys->i_seglenm ) )
+        isSegmentEnd( p_sys, p_buffer ) )
     {
         writevalue = writeSegment( p_access );
         if( unlikely( writevalue < 0 ) )
@@ -925,13 +1122,24 @@ static int CheckSegmentChange( sout_access_out_t *p_access, block_t *p_buffer )
 
     if ( unlikely( p_sys->i_handle < 0 ) )
     {
-        p_sys->i_opendts = p_buffer->i_dts;
+        if( p_sys->b_fmp4 )
+        {
+            /* only the moof carries the fragment time, not the mdat header */
+            block_t *p_first = p_sys->full_segments ? p_sys->full_segments
+                             : p_sys->ongoing_segment ? p_sys->ongoing_segment
+                             : p_buffer;
+            p_sys->i_opendts = p_first->i_dts;
+        }
+        else
+        {
+            p_sys->i_opendts = p_buffer->i_dts;
 
-        if( p_sys->ongoing_segment && ( p_sys->ongoing_segment->i_dts < p_sys->i_opendts) )
-            p_sys->i_opendts = p_sys->ongoing_segment->i_dts;
+            if( p_sys->ongoing_segment && ( p_sys->ongoing_segment->i_dts < p_sys->i_opendts) )
+                p_sys->i_opendts = p_sys->ongoing_segment->i_dts;
 
-        if( p_sys->full_segments && ( p_sys->full_segments->i_dts < p_sys->i_opendts) )
-            p_sys->i_opendts = p_sys->full_segments->i_dts;
+            if( p_sys->full_segments && ( p_sys->full_segments->i_dts < p_sys->i_opendts) )
+                p_sys->i_opendts = p_sys->full_segments->i_dts;
+        }
 
         msg_Dbg( p_access, "Setting new opendts %"PRId64, p_sys->i_opendts );
 
@@ -959,7 +1167,7 @@ static ssize_t writeSegment( sout_access_out_t *p_access )
     bool crypted = false;
     while( output )
     {
-        if( p_sys->key_uri && !crypted )
+        if( p_sys->key_uri && !p_sys->b_fmp4 && !crypted )
         {
             if( p_sys->stuffing_size )
             {
@@ -998,9 +1206,13 @@ static ssize_t writeSegment( sout_access_out_t *p_access )
            return -1;
         }
 
-        p_sys->f_seglen =
-            (float)(output_last_length +
-                    output->i_dts - p_sys->i_opendts) / CLOCK_FREQ;
+        if( p_sys->b_fmp4 )
+            p_sys->f_seglen = (float)(p_sys->i_fmp4_end - p_sys->i_opendts) / CLOCK_FREQ;
+        else
+            p_sys->f_seglen =
+                (float)(output_last_length +
+                        output->i_dts - p_sys->i_opendts) / CLOCK_FREQ;
+        p_sys->i_segment_bytes += val;
 
         if ( (size_t)val >= output->i_buffer )
         {
@@ -1026,12 +1238,37 @@ static ssize_t Write( sout_access_out_t *p_access, block_t *p_buffer )
 {
     size_t i_write = 0;
     sout_access_out_sys_t *p_sys = p_access->p_sys;
+
+    if( p_sys->p_ll )
+    {
+        if( !isFmp4Header( p_buffer ) ||
+            p_sys->i_segment != p_sys->i_initial_segment - 1 )
+            return LLWrite( p_access, p_buffer );
+
+        msg_Warn( p_access, "Partial segments are not supported with "
+                  "fragmented MP4, disabling them" );
+        LLClose( p_access );
+    }
+
     while( p_buffer )
     {
+        if( !p_sys->b_fmp4 && isFmp4Header( p_buffer ) )
+        {
+            block_t *p_next = p_buffer->p_next;
+            p_buffer->p_next = NULL;
+            if( writeInitSegment( p_access, p_buffer ) )
+            {
+                block_ChainRelease( p_next );
+                return -1;
+            }
+            p_buffer = p_next;
+            continue;
+        }
+
         /* Check if current block is already past segment-length
             and we want to write gathered blocks into segment
             and update playlist */
-        if( p_sys->ongoing_segment && ( p_sys->b_splitanywhere  || ( p_buffer->i_flags & BLOCK_FLAG_HEADER ) ) )
+        if( p_sys->ongoing_segment && isSegmentStart( p_sys, p_buffer ) )
         {
             msg_Dbg( p_access, "Moving ongoing segment to full segments-queue" );
             block_ChainLastAppend( &p_sys->full_segments_end, p_sys->ongoing_segment );
@@ -1048,6 +1285,9 @@ static ssize_t Write( sout_access_out_t *p_access, block_t *p_buffer )
         }
         i_write += ret;
 
+        if( p_sys->b_fmp4 && p_buffer->i_length > 0 && isBox( p_buffer, "moof" ) )
+            p_sys->i_fmp4_end = p_buffer->i_dts + p_buffer->i_length;
+
         block_t *p_temp = p_buffer->p_next;
         p_buffer->p_next = NULL;
         block_ChainLastAppend( &p_sys->ongoing_segment_end, p_buffer );
@@ -1056,3 +1296,1301 @@ static ssize_t Write( sout_access_out_t *p_access, block_t *p_buffer )
 
     return i_write;
 }
+
+/*****************************************************************************
+ * Fragmented MP4
+ *****************************************************************************
+ * The header of the fragmented MP4 muxer is written once as the init
+ * segment, and the segments are made of whole fragments. The init segment
+ * tells the codecs for the DASH manifest, and the key ID if the muxer
+ * encrypts the samples ('cbcs' scheme).
+ *****************************************************************************/
+
+/* Finds the next box of that type in p/i, and moves past it */
+static const uint8_t *findBox( const uint8_t **pp, size_t *pi,
+                               const char *psz_type, size_t *pi_payload )
+{
+    while( *pi >= 8 )
+    {
+        const uint8_t *p_box = *pp;
+        size_t i_box = GetDWBE( p_box );
+
+        if( i_box < 8 || i_box > *pi )
+            break;
+        *pp += i_box;
+        *pi -= i_box;
+        if( !memcmp( &p_box[4], psz_type, 4 ) )
+        {
+            *pi_payload = i_box - 8;
+            return &p_box[8];
+        }
+    }
+    return NULL;
+}
+
+static const uint8_t *findChild( const uint8_t *p, size_t i,
+                                 const char *psz_type, size_t *pi_payload )
+{
+    return findBox( &p, &i, psz_type, pi_payload );
+}
+
+/* Reads an MPEG-4 descriptor header, returns its size */
+static size_t readDescriptor( const uint8_t **pp, size_t *pi, uint8_t *pi_tag )
+{
+    size_t i_size = 0;
+
+    if( *pi < 2 )
+        return 0;
+    *pi_tag = *(*pp)++;
+    (*pi)--;
+    for( int i = 0; i < 4 && *pi > 0; i++ )
+    {
+        uint8_t i_byte = *(*pp)++;
+        (*pi)--;
+        i_size = ( i_size << 7 ) | ( i_byte & 0x7f );
+        if( !( i_byte & 0x80 ) )
+            break;
+    }
+    return __MIN( i_size, *pi );
+}
+
+/* Appends the RFC 6381 codecs parameter of a sample entry */
+static void appendCodec( struct vlc_memstream *ms, const char *psz_fcc,
+                         const uint8_t *p, size_t i )
+{
+    size_t i_conf;
+    const uint8_t *p_conf;
+
+    if( ( !memcmp( psz_fcc, "avc1", 4 ) || !memcmp( psz_fcc, "avc3", 4 ) ) &&
+        ( p_conf = findChild( p, i, "avcC", &i_conf ) ) && i_conf >= 4 )
+    {
+        vlc_memstream_printf( ms, "%4.4s.%02x%02x%02x", psz_fcc,
+                              p_conf[1], p_conf[2], p_conf[3] );
+    }
+    else if( ( !memcmp( psz_fcc, "hvc1", 4 ) || !memcmp( psz_fcc, "hev1", 4 ) ) &&
+             ( p_conf = findChild( p, i, "hvcC", &i_conf ) ) && i_conf >= 13 )
+    {
+        /* ISO/IEC 14496-15 Annex E */
+        uint32_t i_compat = GetDWBE( &p_conf[2] ), i_reversed = 0;
+        for( int j = 0; j < 32; j++ )
+            i_reversed |= ( ( i_compat >> j ) & 1 ) << ( 31 - j );
+
+        vlc_memstream_printf( ms, "%4.4s.%s%u.%X.%c%u", psz_fcc,
+                              (const char *[]){ "", "A", "B", "C" }[p_conf[1] >> 6],
+                              p_conf[1] & 0x1f, i_reversed,
+                              ( p_conf[1] & 0x20 ) ? 'H' : 'L', p_conf[12] );
+        int i_constraints = 6;
+        while( i_constraints > 0 && p_conf[5 + i_constraints] == 0 )
+            i_constraints--;
+        for( int j = 0; j < i_constraints; j++ )
+            vlc_memstream_printf( ms, ".%X", p_conf[6 + j] );
+    }
+    else if( !memcmp( psz_fcc, "mp4a", 4 ) &&
+             ( p_conf = findChild( p, i, "esds", &i_conf ) ) && i_conf > 4 )
+    {
+        uint8_t i_tag;
+        size_t i_desc;
+
+        p_conf += 4; /* version and flags */
+        i_conf -= 4;
+        i_desc = readDescriptor( &p_conf, &i_conf, &i_tag );
+        if( i_tag != 0x03 || i_desc < 3 )
+        {
+            vlc_memstream_puts( ms, "mp4a" );
+            return;
+        }
+        /* ES_ID then flags, and their optional fields */
+        uint8_t i_flags = p_conf[2];
+        size_t i_skip = 3 + ( ( i_flags & 0x80 ) ? 2 : 0 ) + ( ( i_flags & 0x20 ) ? 2 : 0 );
+        if( ( i_flags & 0x40 ) && i_desc > 3 )
+            i_skip += 1 + p_conf[3];
+        if( i_skip > i_conf )
+        {
+            vlc_memstream_puts( ms, "mp4a" );
+            return;
+        }
+        p_conf += i_skip;
+        i_conf -= i_skip;
+
+        i_desc = readDescriptor( &p_conf, &i_conf, &i_tag );
+        if( i_tag != 0x04 || i_desc < 13 )
+        {
+            vlc_memstream_puts( ms, "mp4a" );
+            return;
+        }
+        uint8_t i_object_type = p_conf[0];
+        p_conf += 13;
+        i_conf = i_desc - 13;
+
+        i_desc = readDescriptor( &p_conf, &i_conf, &i_tag );
+        if( i_object_type == 0x40 && i_tag == 0x05 && i_desc >= 1 )
+            vlc_memstream_printf( ms, "mp4a.40.%u", p_conf[0] >> 3 );
+        else
+            vlc_memstream_printf( ms, "mp4a.%02x", i_object_type );
+    }
+    else
+        vlc_memstream_printf( ms, "%4.4s", psz_fcc );
+}
+
+/*****************************************************************************
+ * parseInitSegment: Get the codecs and protection of the tracks
+ *****************************************************************************/
+static int parseInitSegment( sout_access_out_t *p_access, const block_t *p_block )
+{
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+    const uint8_t *p = p_block->p_buffer, *p_moov, *p_trak;
+    size_t i = p_block->i_buffer, i_moov, i_trak;
+    struct vlc_memstream ms;
+
+    p_moov = findBox( &p, &i, "moov", &i_moov );
+    if( !p_moov || vlc_memstream_open( &ms ) )
+        return VLC_EGENERIC;
+
+    while( ( p_trak = findBox( &p_moov, &i_moov, "trak", &i_trak ) ) )
+    {
+        const uint8_t *p_box;
+        size_t i_box;
+
+        if( !( p_box = findChild( p_trak, i_trak, "mdia", &i_box ) ) )
+            continue;
+        size_t i_hdlr, i_stbl;
+        const uint8_t *p_hdlr = findChild( p_box, i_box, "hdlr", &i_hdlr );
+        if( !p_hdlr || i_hdlr < 12 ||
+            !( p_box = findChild( p_box, i_box, "minf", &i_box ) ) ||
+            !( p_box = findChild( p_box, i_box, "stbl", &i_stbl ) ) ||
+            !( p_box = findChild( p_box, i_stbl, "stsd", &i_box ) ) ||
+            i_box < 16 )
+            continue;
+
+        const bool b_video = !memcmp( &p_hdlr[8], "vide", 4 );
+        if( !b_video && memcmp( &p_hdlr[8], "soun", 4 ) )
+            continue;
+
+        /* first sample entry, past the stsd version, flags and count */
+        const uint8_t *p_entry = &p_box[8];
+        size_t i_entry = __MIN( GetDWBE( p_entry ), i_box - 8 );
+        size_t i_fields = b_video ? 78 : 28;
+        if( i_entry < 8 + i_fields )
+            continue;
+
+        const char *psz_fcc = (const char *)&p_entry[4];
+        const uint8_t *p_children = &p_entry[8 + i_fields];
+        size_t i_children = i_entry - 8 - i_fields;
+
+        if( b_video )
+        {
+            p_sys->b_has_video = true;
+            p_sys->i_width = GetWBE( &p_entry[8 + 24] );
+            p_sys->i_height = GetWBE( &p_entry[8 + 26] );
+        }
+
+        /* protected entry: original format and scheme */
+        size_t i_sinf, i_info;
+        const uint8_t *p_sinf = findChild( p_children, i_children, "sinf", &i_sinf );
+        const uint8_t *p_info;
+        if( p_sinf && !memcmp( psz_fcc, b_video ? "encv" : "enca", 4 ) )
+        {
+            if( ( p_info = findChild( p_sinf, i_sinf, "frma", &i_info ) ) &&
+                i_info >= 4 )
+                psz_fcc = (const char *)p_info;
+            if( ( p_info = findChild( p_sinf, i_sinf, "schi", &i_info ) ) &&
+                ( p_info = findChild( p_info, i_info, "tenc", &i_info ) ) &&
+                i_info >= 24 )
+            {
+                p_sys->b_fmp4_protected = true;
+                memcpy( p_sys->kid, &p_info[8], 16 );
+            }
+        }
+
+        if( ms.length > 0 )
+            vlc_memstream_putc( &ms, ',' );
+        appendCodec( &ms, psz_fcc, p_children, i_children );
+    }
+
+    if( vlc_memstream_close( &ms ) )
+        return VLC_ENOMEM;
+    free( p_sys->psz_codecs );
+    p_sys->psz_codecs = ms.ptr;
+    msg_Dbg( p_access, "fragmented MP4 codecs \"%s\"%s", p_sys->psz_codecs,
+             p_sys->b_fmp4_protected ? ", encrypted" : "" );
+    return VLC_SUCCESS;
+}
+
+/*****************************************************************************
+ * writeInitSegment: Write the fragmented MP4 header on its own
+ *****************************************************************************/
+static int writeInitSegment( sout_access_out_t *p_access, block_t *p_block )
+{
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+
+    if( parseInitSegment( p_access, p_block ) )
+        msg_Warn( p_access, "cannot parse the init segment" );
+
+    if( p_sys->key_uri && !p_sys->b_fmp4_protected )
+    {
+        msg_Err( p_access, "Fragmented MP4 segments are encrypted by the "
+                 "muxer, set its cenc-key and cenc-kid options" );
+        block_Release( p_block );
+        return -1;
+    }
+
+    char *psz_filename = formatSegmentTemplate( p_access->psz_path, true );
+    free( p_sys->psz_initUri );
+    p_sys->psz_initUri = formatSegmentTemplate( p_sys->psz_indexUrl ?
+                                                p_sys->psz_indexUrl :
+                                                p_access->psz_path, true );
+    if( unlikely( !psz_filename || !p_sys->psz_initUri ) )
+    {
+        free( psz_filename );
+        block_Release( p_block );
+        return -1;
+    }
+
+    int fd = vlc_open( psz_filename, O_WRONLY | O_CREAT | O_LARGEFILE |
+                       O_TRUNC, 0666 );
+    if( fd == -1 )
+    {
+        msg_Err( p_access, "cannot open `%s' (%s)", psz_filename,
+                 vlc_strerror_c(errno) );
+        free( psz_filename );
+        block_Release( p_block );
+        return -1;
+    }
+
+    const uint8_t *p_data = p_block->p_buffer;
+    size_t i_data = p_block->i_buffer;
+    while( i_data > 0 )
+    {
+        ssize_t val = vlc_write( fd, p_data, i_data );
+        if( val == -1 )
+        {
+            if( errno == EINTR )
+                continue;
+            msg_Err( p_access, "cannot write `%s' (%s)", psz_filename,
+                     vlc_strerror_c(errno) );
+            break;
+        }
+        p_data += val;
+        i_data -= val;
+    }
+    vlc_close( fd );
+    block_Release( p_block );
+
+    msg_Dbg( p_access, "Wrote init segment: %s", psz_filename );
+    free( psz_filename );
+    if( i_data > 0 )
+        return -1;
+
+    p_sys->b_fmp4 = true;
+    p_sys->i_mpd_start = time( NULL );
+    return 0;
+}
+
+static void formatUTCTime( char psz[24], time_t i_time )
+{
+    struct tm tm;
+
+    gmtime_r( &i_time, &tm );
+    strftime( psz, 24, "%Y-%m-%dT%H:%M:%SZ", &tm );
+}
+
+/*****************************************************************************
+ * writeMPD: Write the DASH manifest of the segments in the index
+ *****************************************************************************/
+static void writeMPD( sout_access_out_t *p_access, sout_access_out_sys_t *p_sys,
+                      uint32_t i_firstseg, unsigned i_index_offset, bool b_isend )
+{
+    struct vlc_memstream ms;
+    char psz_time[24], psz_duration[24];
+    uint64_t i_bandwidth = 0;
+    mtime_t i_first_start = 0, i_end = 0;
+
+    if( p_sys->i_segment < i_firstseg || vlc_memstream_open( &ms ) )
+        return;
+
+    for ( uint32_t i = i_firstseg; i <= p_sys->i_segment; i++ )
+    {
+        const output_segment_t *segment =
+            vlc_array_item_at_index( &p_sys->segments_t, i - i_firstseg + i_index_offset );
+        if( i == i_firstseg )
+            i_first_start = segment->i_start - p_sys->i_mpd_origin;
+        i_end = segment->i_start - p_sys->i_mpd_origin + segment->i_duration;
+        if( segment->i_duration > 0 )
+            i_bandwidth = __MAX( i_bandwidth, segment->i_size * 8 * CLOCK_FREQ
+                                              / segment->i_duration );
+    }
+
+    vlc_memstream_puts( &ms, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                        "<MPD xmlns=\"urn:mpeg:dash:schema:mpd:2011\" "
+                        "xmlns:cenc=\"urn:mpeg:cenc:2013\" "
+                        "profiles=\"urn:mpeg:dash:profile:isoff-live:2011\"" );
+    if( b_isend )
+    {
+        formatDuration( psz_duration, i_end - i_first_start );
+        vlc_memstream_printf( &ms, " type=\"static\" "
+                              "mediaPresentationDuration=\"PT%sS\"", psz_duration );
+    }
+    else
+    {
+        formatUTCTime( psz_time, p_sys->i_mpd_start );
+        vlc_memstream_printf( &ms, " type=\"dynamic\" availabilityStartTime=\"%s\"",
+                              psz_time );
+        formatUTCTime( psz_time, time( NULL ) );
+        vlc_memstream_printf( &ms, " publishTime=\"%s\" minimumUpdatePeriod=\"PT%zuS\""
+                              " suggestedPresentationDelay=\"PT%zuS\"",
+                              psz_time, p_sys->i_seglen, 3 * p_sys->i_seglen );
+        if( p_sys->i_numsegs )
+            vlc_memstream_printf( &ms, " timeShiftBufferDepth=\"PT%zuS\"",
+                                  p_sys->i_numsegs * p_sys->i_seglen );
+    }
+    vlc_memstream_printf( &ms, " minBufferTime=\"PT%zuS\">\n"
+                          " <Period id=\"0\" start=\"PT0S\">\n"
+                          "  <AdaptationSet mimeType=\"%s/mp4\" "
+                          "segmentAlignment=\"true\" startWithSAP=\"1\">\n",
+                          p_sys->i_seglen, p_sys->b_has_video ? "video" : "audio" );
+
+    if( p_sys->b_fmp4_protected )
+    {
+        const uint8_t *k = p_sys->kid;
+        vlc_memstream_printf( &ms, "   <ContentProtection schemeIdUri="
+            "\"urn:mpeg:dash:mp4protection:2011\" value=\"cbcs\" cenc:default_KID=\""
+            "%02x%02x%02x%02x-%02x%02x-%02x%02x-%02x%02x-%02x%02x%02x%02x%02x%02x\"/>\n",
+            k[0], k[1], k[2], k[3], k[4], k[5], k[6], k[7],
+            k[8], k[9], k[10], k[11], k[12], k[13], k[14], k[15] );
+    }
+
+    vlc_memstream_printf( &ms, "   <Representation id=\"0\" codecs=\"%s\" "
+                          "bandwidth=\"%"PRIu64"\"",
+                          p_sys->psz_codecs ? p_sys->psz_codecs : "",
+                          i_bandwidth );
+    if( p_sys->b_has_video )
+        vlc_memstream_printf( &ms, " width=\"%u\" height=\"%u\"",
+                              p_sys->i_width, p_sys->i_height );
+
+    char *psz_media = formatSegmentTemplate( p_sys->psz_indexUrl ?
+                                             p_sys->psz_indexUrl :
+                                             p_access->psz_path, false );
+    char *psz_media_xml = psz_media ? vlc_xml_encode( psz_media ) : NULL;
+    char *psz_init_xml = vlc_xml_encode( p_sys->psz_initUri );
+    free( psz_media );
+
+    vlc_memstream_printf( &ms, ">\n    <SegmentTemplate timescale=\"1000\" "
+                          "presentationTimeOffset=\"%"PRId64"\" "
+                          "initialization=\"%s\" media=\"%s\" "
+                          "startNumber=\"%"PRIu32"\">\n     <SegmentTimeline>\n",
+                          b_isend ? i_first_start / 1000 : 0,
+                          psz_init_xml ? psz_init_xml : "",
+                          psz_media_xml ? psz_media_xml : "", i_firstseg );
+    free( psz_init_xml );
+    free( psz_media_xml );
+
+    for ( uint32_t i = i_firstseg; i <= p_sys->i_segment; i++ )
+    {
+        const output_segment_t *segment =
+            vlc_array_item_at_index( &p_sys->segments_t, i - i_firstseg + i_index_offset );
+        vlc_memstream_printf( &ms, "      <S t=\"%"PRId64"\" d=\"%"PRId64"\"/>\n",
+                              ( segment->i_start - p_sys->i_mpd_origin ) / 1000,
+                              segment->i_duration / 1000 );
+    }
+
+    vlc_memstream_puts( &ms, "     </SegmentTimeline>\n    </SegmentTemplate>\n"
+                        "   </Representation>\n  </AdaptationSet>\n"
+                        " </Period>\n</MPD>\n" );
+    if( vlc_memstream_close( &ms ) )
+        return;
+
+    char *psz_mpdTmp;
+    if( asprintf( &psz_mpdTmp, "%s.tmp", p_sys->psz_mpdPath ) < 0 )
+    {
+        free( ms.ptr );
+        return;
+    }
+
+    FILE *fp = vlc_fopen( psz_mpdTmp, "wt" );
+    if( !fp )
+    {
+        msg_Err( p_access, "cannot open DASH manifest `%s'", psz_mpdTmp );
+        free( psz_mpdTmp );
+        free( ms.ptr );
+        return;
+    }
+    bool b_ok = fwrite( ms.ptr, 1, ms.length, fp ) == ms.length;
+    b_ok = !fclose( fp ) && b_ok;
+    free( ms.ptr );
+
+    if( !b_ok || vlc_rename( psz_mpdTmp, p_sys->psz_mpdPath ) < 0 )
+    {
+        vlc_unlink( psz_mpdTmp );
+        msg_Err( p_access, "Error moving DASH manifest" );
+    }
+    free( psz_mpdTmp );
+}
+
+/*****************************************************************************
+ * Low latency HLS
+ *****************************************************************************
+ * The segments are written as the data comes, and are announced in the
+ * playlist as partial segments of up to partlen milliseconds (EXT-X-PART),
+ * along with a hint for the part being written (EXT-X-PRELOAD-HINT).
+ *
+ * Files are announced with byte ranges of the segments. The built-in HTTP
+ * server keeps the segments of the playlist in memory and serves them as
+ * media?msn=N and media?msn=N&part=P: the parts being written are sent as
+ * they grow with chunked transfer, and playlist requests with _HLS_msn and
+ * _HLS_part are held until that part is available.
+ *****************************************************************************/
+
+/* Segments whose parts are listed in the playlist */
+#define LL_PART_SEGMENTS 3
+/* Longest time a playlist request is held, under the httpd idle timeout */
+#define LL_HOLD_MAX (9 * CLOCK_FREQ)
+/* Window of the playlist when serving from memory, if numsegs is unset */
+#define LL_HTTP_NUMSEGS 5
+
+typedef struct
+{
+    size_t  i_offset; /* in the segment */
+    size_t  i_size;
+    mtime_t i_duration;
+    bool    b_independent;
+    bool    b_complete;
+} ll_part_t;
+
+typedef struct
+{
+    uint32_t   i_number;
+    char      *psz_filename;
+    char      *psz_uri;
+    mtime_t    i_start;
+    mtime_t    i_duration;
+    bool       b_complete;
+
+    ll_part_t *p_parts;
+    unsigned   i_parts;
+
+    size_t     i_size;
+    uint8_t   *p_data; /* only kept for the HTTP server */
+    size_t     i_alloc;
+} ll_segment_t;
+
+struct livehttp_ll_t
+{
+    mtime_t        i_part_target;
+    mtime_t        i_part_start;
+    mtime_t        i_last_end;
+    int            i_fd;
+
+    /* Protects the segments against the HTTP server thread */
+    vlc_mutex_t    lock;
+    ll_segment_t **pp_segments;
+    int            i_segments;
+    bool           b_ended;
+
+    httpd_host_t  *p_host;
+    httpd_url_t   *p_index_url;
+    httpd_url_t   *p_media_url;
+    char          *psz_media; /* relative to the playlist */
+};
+
+static void LLSegmentDelete( ll_segment_t *p_seg )
+{
+    free( p_seg->psz_filename );
+    free( p_seg->psz_uri );
+    free( p_seg->p_parts );
+    free( p_seg->p_data );
+    free( p_seg );
+}
+
+static ll_segment_t *LLCurrentSegment( livehttp_ll_t *p_ll )
+{
+    if( p_ll->i_segments == 0 )
+        return NULL;
+
+    ll_segment_t *p_seg = p_ll->pp_segments[p_ll->i_segments - 1];
+    return p_seg->b_complete ? NULL : p_seg;
+}
+
+static ll_part_t *LLCurrentPart( ll_segment_t *p_seg )
+{
+    if( p_seg->i_parts == 0 )
+        return NULL;
+
+    ll_part_t *p_part = &p_seg->p_parts[p_seg->i_parts - 1];
+    return p_part->b_complete ? NULL : p_part;
+}
+
+static ll_segment_t *LLFindSegment( livehttp_ll_t *p_ll, uint32_t i_number )
+{
+    for( int i = 0; i < p_ll->i_segments; i++ )
+        if( p_ll->pp_segments[i]->i_number == i_number )
+            return p_ll->pp_segments[i];
+    return NULL;
+}
+
+/* Index of the first segment listed in the playlist */
+static int LLFirstSegment( sout_access_out_sys_t *p_sys )
+{
+    livehttp_ll_t *p_ll = p_sys->p_ll;
+    int i_complete = p_ll->i_segments;
+
+    if( i_complete > 0 && !p_ll->pp_segments[i_complete - 1]->b_complete )
+        i_complete--;
+    if( p_sys->i_numsegs == 0 || i_complete <= (int)p_sys->i_numsegs )
+        return 0;
+    return i_complete - p_sys->i_numsegs;
+}
+
+static void LLPlaylist( sout_access_out_sys_t *p_sys,
+                        struct vlc_memstream *ms, bool b_http )
+{
+    livehttp_ll_t *p_ll = p_sys->p_ll;
+    char psz_duration[24];
+
+    vlc_memstream_printf( ms, "#EXTM3U\n#EXT-X-TARGETDURATION:%zu\n"
+                          "#EXT-X-VERSION:6\n", p_sys->i_seglen );
+    formatDuration( psz_duration, p_ll->i_part_target );
+    vlc_memstream_printf( ms, "#EXT-X-PART-INF:PART-TARGET=%s\n",
+                          psz_duration );
+    formatDuration( psz_duration, 3 * p_ll->i_part_target );
+    vlc_memstream_printf( ms, "#EXT-X-SERVER-CONTROL:%sPART-HOLD-BACK=%s\n",
+                          b_http ? "CAN-BLOCK-RELOAD=YES," : "",
+                          psz_duration );
+    if( p_sys->i_numsegs == 0 )
+        vlc_memstream_printf( ms, "#EXT-X-PLAYLIST-TYPE:%s\n",
+                              p_ll->b_ended ? "VOD" : "EVENT" );
+    if( !p_sys->b_caching )
+        vlc_memstream_puts( ms, "#EXT-X-ALLOW-CACHE:NO\n" );
+
+    int i_first = LLFirstSegment( p_sys );
+    if( i_first < p_ll->i_segments )
+        vlc_memstream_printf( ms, "#EXT-X-MEDIA-SEQUENCE:%"PRIu32"\n",
+                              p_ll->pp_segments[i_first]->i_number );
+
+    for( int i = i_first; i < p_ll->i_segments; i++ )
+    {
+        const ll_segment_t *p_seg = p_ll->pp_segments[i];
+
+        if( i >= p_ll->i_segments - LL_PART_SEGMENTS )
+        {
+            for( unsigned j = 0; j < p_seg->i_parts; j++ )
+            {
+                const ll_part_t *p_part = &p_seg->p_parts[j];
+
+                if( !p_part->b_complete )
+                    break;
+                formatDuration( psz_duration, p_part->i_duration );
+                if( b_http )
+                    vlc_memstream_printf( ms, "#EXT-X-PART:DURATION=%s,"
+                                          "URI=\"%s?msn=%"PRIu32"&part=%u\"",
+                                          psz_duration, p_ll->psz_media,
+                                          p_seg->i_number, j );
+                else
+                    vlc_memstream_printf( ms, "#EXT-X-PART:DURATION=%s,"
+                                          "URI=\"%s\",BYTERANGE=\"%zu@%zu\"",
+                                          psz_duration, p_seg->psz_uri,
+                                          p_part->i_size, p_part->i_offset );
+                vlc_memstream_puts( ms, p_part->b_independent
+                                        ? ",INDEPENDENT=YES\n" : "\n" );
+            }
+        }
+
+        if( !p_seg->b_complete )
+        {
+            if( p_ll->b_ended )
+                break;
+            /* The part being written, or the next one */
+            if( b_http )
+                vlc_memstream_printf( ms, "#EXT-X-PRELOAD-HINT:TYPE=PART,"
+                                      "URI=\"%s?msn=%"PRIu32"&part=%u\"\n",
+                                      p_ll->psz_media, p_seg->i_number,
+                                      p_seg->i_parts
+                                      - (LLCurrentPart( (ll_segment_t *)p_seg )
+                                         != NULL) );
+            else
+            {
+                const ll_part_t *p_part =
+                    LLCurrentPart( (ll_segment_t *)p_seg );
+                vlc_memstream_printf( ms, "#EXT-X-PRELOAD-HINT:TYPE=PART,"
+                                      "URI=\"%s\",BYTERANGE-START=%zu\n",
+                                      p_seg->psz_uri, p_part != NULL
+                                      ? p_part->i_offset : p_seg->i_size );
+            }
+            break;
+        }
+
+        formatDuration( psz_duration, p_seg->i_duration );
+        if( b_http )
+            vlc_memstream_printf( ms, "#EXTINF:%s,\n%s?msn=%"PRIu32"\n",
+                                  psz_duration, p_ll->psz_media,
+                                  p_seg->i_number );
+        else
+            vlc_memstream_printf( ms, "#EXTINF:%s,\n%s\n",
+                                  psz_duration, p_seg->psz_uri );
+    }
+
+    if( p_ll->b_ended )
+        vlc_memstream_puts( ms, STR_ENDLIST );
+}
+
+static void LLUpdateIndex( sout_access_out_t *p_access )
+{
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+    struct vlc_memstream ms;
+    char *psz_idxTmp;
+
+    if( !p_sys->psz_indexPath )
+        return;
+
+    if( vlc_memstream_open( &ms ) )
+        return;
+    LLPlaylist( p_sys, &ms, false );
+    if( vlc_memstream_close( &ms ) )
+        return;
+
+    if( asprintf( &psz_idxTmp, "%s.tmp", p_sys->psz_indexPath ) < 0 )
+    {
+        free( ms.ptr );
+        return;
+    }
+
+    FILE *fp = vlc_fopen( psz_idxTmp, "wt" );
+    if( !fp )
+    {
+        msg_Err( p_access, "cannot open index file `%s'", psz_idxTmp );
+        free( psz_idxTmp );
+        free( ms.ptr );
+        return;
+    }
+
+    bool b_ok = fwrite( ms.ptr, 1, ms.length, fp ) == ms.length;
+    b_ok = !fclose( fp ) && b_ok;
+    free( ms.ptr );
+
+    if( !b_ok || vlc_rename( psz_idxTmp, p_sys->psz_indexPath ) < 0 )
+    {
+        vlc_unlink( psz_idxTmp );
+        msg_Err( p_access, "Error moving LiveHttp index file" );
+    }
+    free( psz_idxTmp );
+}
+
+/* Drops the segments that left the playlist for a while */
+static void LLEvict( sout_access_out_t *p_access )
+{
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+    livehttp_ll_t *p_ll = p_sys->p_ll;
+
+    if( p_sys->i_numsegs == 0 )
+        return;
+
+    while( LLFirstSegment( p_sys ) > 1 )
+    {
+        ll_segment_t *p_seg = p_ll->pp_segments[0];
+
+        vlc_mutex_lock( &p_ll->lock );
+        TAB_ERASE( p_ll->i_segments, p_ll->pp_segments, 0 );
+        vlc_mutex_unlock( &p_ll->lock );
+
+        msg_Dbg( p_access, "Removing segment number %"PRIu32,
+                 p_seg->i_number );
+        if( p_sys->b_delsegs )
+            vlc_unlink( p_seg->psz_filename );
+        LLSegmentDelete( p_seg );
+    }
+}
+
+static int LLSegmentOpen( sout_access_out_t *p_access, mtime_t i_dts )
+{
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+    livehttp_ll_t *p_ll = p_sys->p_ll;
+    uint32_t i_newseg = p_sys->i_segment + 1;
+
+    ll_segment_t *p_seg = calloc( 1, sizeof( *p_seg ) );
+    if( unlikely( !p_seg ) )
+        return -1;
+
+    p_seg->i_number = i_newseg;
+    p_seg->i_start = i_dts;
+    p_seg->psz_filename = formatSegmentPath( p_access->psz_path, i_newseg );
+    p_seg->psz_uri = formatSegmentPath( p_sys->psz_indexUrl
+                                        ? p_sys->psz_indexUrl
+                                        : p_access->psz_path, i_newseg );
+    if( unlikely( !p_seg->psz_filename || !p_seg->psz_uri ) )
+    {
+        msg_Err( p_access, "Format segmentpath failed");
+        LLSegmentDelete( p_seg );
+        return -1;
+    }
+
+    p_ll->i_fd = vlc_open( p_seg->psz_filename, O_WRONLY | O_CREAT |
+                           O_LARGEFILE | O_TRUNC, 0666 );
+    if( p_ll->i_fd == -1 )
+    {
+        msg_Err( p_access, "cannot open `%s' (%s)", p_seg->psz_filename,
+                 vlc_strerror_c(errno) );
+        LLSegmentDelete( p_seg );
+        return -1;
+    }
+
+    vlc_mutex_lock( &p_ll->lock );
+    TAB_APPEND( p_ll->i_segments, p_ll->pp_segments, p_seg );
+    vlc_mutex_unlock( &p_ll->lock );
+
+    msg_Dbg( p_access, "Successfully opened livehttp file: %s (%"PRIu32")",
+             p_seg->psz_filename, i_newseg );
+    p_sys->i_segment = i_newseg;
+    return 0;
+}
+
+static int LLPartOpen( livehttp_ll_t *p_ll, ll_segment_t *p_seg,
+                       mtime_t i_dts, bool b_independent )
+{
+    ll_part_t *p_parts = realloc( p_seg->p_parts,
+                                  (p_seg->i_parts + 1) * sizeof( *p_parts ) );
+    if( unlikely( !p_parts ) )
+        return -1;
+
+    ll_part_t *p_part = &p_parts[p_seg->i_parts];
+    p_part->i_offset = p_seg->i_size;
+    p_part->i_size = 0;
+    p_part->i_duration = 0;
+    p_part->b_independent = b_independent;
+    p_part->b_complete = false;
+
+    vlc_mutex_lock( &p_ll->lock );
+    p_seg->p_parts = p_parts;
+    p_seg->i_parts++;
+    vlc_mutex_unlock( &p_ll->lock );
+
+    p_ll->i_part_start = i_dts;
+    return 0;
+}
+
+static void LLPartClose( sout_access_out_t *p_access, ll_segment_t *p_seg,
+                         mtime_t i_end, bool b_update )
+{
+    livehttp_ll_t *p_ll = p_access->p_sys->p_ll;
+    ll_part_t *p_part = LLCurrentPart( p_seg );
+
+    if( p_part == NULL )
+        return;
+
+    vlc_mutex_lock( &p_ll->lock );
+    p_part->i_duration = i_end - p_ll->i_part_start;
+    p_part->b_complete = true;
+    vlc_mutex_unlock( &p_ll->lock );
+
+    if( b_update )
+        LLUpdateIndex( p_access );
+}
+
+static void LLSegmentClose( sout_access_out_t *p_access, ll_segment_t *p_seg,
+                            mtime_t i_end )
+{
+    livehttp_ll_t *p_ll = p_access->p_sys->p_ll;
+
+    LLPartClose( p_access, p_seg, i_end, false );
+
+    vlc_close( p_ll->i_fd );
+    p_ll->i_fd = -1;
+
+    vlc_mutex_lock( &p_ll->lock );
+    p_seg->i_duration = i_end - p_seg->i_start;
+    p_seg->b_complete = true;
+    vlc_mutex_unlock( &p_ll->lock );
+
+    msg_Dbg( p_access, "LiveHttpSegmentComplete: %s (%"PRIu32")",
+             p_seg->psz_filename, p_seg->i_number );
+    LLEvict( p_access );
+    LLUpdateIndex( p_access );
+}
+
+static ssize_t LLAppend( livehttp_ll_t *p_ll, ll_segment_t *p_seg,
+                         const block_t *p_block )
+{
+    const uint8_t *p_data = p_block->p_buffer;
+    size_t i_data = p_block->i_buffer;
+
+    while( i_data > 0 )
+    {
+        ssize_t val = vlc_write( p_ll->i_fd, p_data, i_data );
+        if( val == -1 )
+        {
+            if( errno == EINTR )
+                continue;
+            return -1;
+        }
+        p_data += val;
+        i_data -= val;
+    }
+
+    vlc_mutex_lock( &p_ll->lock );
+    if( p_ll->p_host && p_seg->i_size + p_block->i_buffer > p_seg->i_alloc )
+    {
+        size_t i_alloc = __MAX( 2 * p_seg->i_alloc,
+                                p_seg->i_size + p_block->i_buffer );
+        uint8_t *p_realloc = realloc( p_seg->p_data, i_alloc );
+        if( unlikely( !p_realloc ) )
+        {
+            vlc_mutex_unlock( &p_ll->lock );
+            return -1;
+        }
+        p_seg->p_data = p_realloc;
+        p_seg->i_alloc = i_alloc;
+    }
+    if( p_ll->p_host )
+        memcpy( &p_seg->p_data[p_seg->i_size], p_block->p_buffer,
+                p_block->i_buffer );
+    p_seg->i_size += p_block->i_buffer;
+    p_seg->p_parts[p_seg->i_parts - 1].i_size += p_block->i_buffer;
+    vlc_mutex_unlock( &p_ll->lock );
+
+    return p_block->i_buffer;
+}
+
+static ssize_t LLWrite( sout_access_out_t *p_access, block_t *p_buffer )
+{
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+    livehttp_ll_t *p_ll = p_sys->p_ll;
+    ssize_t i_write = 0;
+
+    while( p_buffer )
+    {
+        block_t *p_next = p_buffer->p_next;
+        const bool b_header = p_buffer->i_flags & BLOCK_FLAG_HEADER;
+        const mtime_t i_dts = p_buffer->i_dts > VLC_TS_INVALID
+                            ? p_buffer->i_dts : p_ll->i_last_end;
+        const mtime_t i_end = i_dts + p_buffer->i_length;
+        ll_segment_t *p_seg = LLCurrentSegment( p_ll );
+
+        if( p_seg && ( p_sys->b_splitanywhere || b_header ) &&
+            i_end - p_seg->i_start >= p_sys->i_seglenm )
+        {
+            LLSegmentClose( p_access, p_seg, i_dts );
+            p_seg = NULL;
+        }
+
+        if( !p_seg )
+        {
+            if( LLSegmentOpen( p_access, i_dts ) )
+                goto error;
+            p_seg = LLCurrentSegment( p_ll );
+        }
+
+        /* Parts can start anywhere, those starting with a key frame are
+         * flagged as independent */
+        if( LLCurrentPart( p_seg ) &&
+            i_end - p_ll->i_part_start > p_ll->i_part_target )
+            LLPartClose( p_access, p_seg, i_dts, true );
+
+        if( !LLCurrentPart( p_seg ) &&
+            LLPartOpen( p_ll, p_seg, i_dts, b_header ) )
+            goto error;
+
+        ssize_t val = LLAppend( p_ll, p_seg, p_buffer );
+        if( val < 0 )
+        {
+            msg_Err( p_access, "cannot write `%s' (%s)", p_seg->psz_filename,
+                     vlc_strerror_c(errno) );
+            goto error;
+        }
+        i_write += val;
+        p_ll->i_last_end = i_end;
+
+        block_Release( p_buffer );
+        p_buffer = p_next;
+    }
+    return i_write;
+
+error:
+    block_ChainRelease( p_buffer );
+    return -1;
+}
+
+/*****************************************************************************
+ * Low latency HLS built-in HTTP delivery
+ *****************************************************************************/
+static bool LLGetArg( const uint8_t *psz_args, const char *psz_name,
+                      unsigned *pi_value )
+{
+    const char *psz = (const char *)psz_args;
+    const size_t i_name = strlen( psz_name );
+
+    while( psz != NULL && *psz )
+    {
+        if( !strncmp( psz, psz_name, i_name ) && psz[i_name] == '=' )
+        {
+            char *psz_end;
+            unsigned long i_value = strtoul( &psz[i_name + 1], &psz_end, 10 );
+            if( psz_end == &psz[i_name + 1] || i_value > UINT32_MAX )
+                return false;
+            *pi_value = i_value;
+            return true;
+        }
+        psz = strchr( psz, '&' );
+        if( psz != NULL )
+            psz++;
+    }
+    return false;
+}
+
+/* Whether the playlist has the given part (or the whole segment if
+ * i_part is -1) yet: 1 if so, 0 if it will, -1 if it is too far ahead */
+static int LLIsAvailable( livehttp_ll_t *p_ll, uint32_t i_msn, int i_part )
+{
+    if( p_ll->b_ended )
+        return 1;
+    if( p_ll->i_segments == 0 )
+        return 0;
+
+    const ll_segment_t *p_last = p_ll->pp_segments[p_ll->i_segments - 1];
+
+    if( i_msn > p_last->i_number + 2 )
+        return -1;
+    if( i_msn < p_last->i_number || ( p_last->b_complete &&
+                                      i_msn == p_last->i_number ) )
+        return 1;
+    if( i_msn > p_last->i_number || i_part < 0 )
+        return 0;
+
+    unsigned i_complete = p_last->i_parts;
+    if( i_complete > 0 && !p_last->p_parts[i_complete - 1].b_complete )
+        i_complete--;
+    return (unsigned)i_part < i_complete;
+}
+
+static void LLRawAnswer( struct vlc_memstream *ms,
+                         const httpd_message_t *query, int i_status,
+                         const char *psz_reason, const char *psz_mime )
+{
+    vlc_memstream_printf( ms, "HTTP/1.%d %d %s\r\nCache-Control: no-cache\r\n"
+                          "Content-Type: %s\r\n", query->i_version > 0,
+                          i_status, psz_reason, psz_mime );
+    if( query->i_version == 0 )
+        vlc_memstream_puts( ms, "Connection: close\r\n" );
+}
+
+static int LLIndexCallback( httpd_callback_sys_t *p_cbsys, httpd_client_t *cl,
+                            httpd_message_t *answer,
+                            const httpd_message_t *query )
+{
+    sout_access_out_t *p_access = (sout_access_out_t *)p_cbsys;
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+    livehttp_ll_t *p_ll = p_sys->p_ll;
+    unsigned i_msn, i_part;
+    int i_ready = 1;
+
+    if( !answer || !query || !cl )
+        return VLC_SUCCESS;
+
+    vlc_mutex_lock( &p_ll->lock );
+    if( LLGetArg( query->psz_args, "_HLS_msn", &i_msn ) )
+        i_ready = LLIsAvailable( p_ll, i_msn,
+                                 LLGetArg( query->psz_args, "_HLS_part",
+                                           &i_part ) ? (int)i_part : -1 );
+
+    if( i_ready == 0 )
+    {
+        if( answer->i_body_offset == 0 )
+        {
+            /* Hold the request, the answer will be sent raw once the
+             * playlist has the part */
+            vlc_mutex_unlock( &p_ll->lock );
+            answer->i_proto = HTTPD_PROTO_NONE;
+            answer->i_type = HTTPD_MSG_ANSWER;
+            answer->i_body_offset = mdate() + __MIN( 3 * p_sys->i_seglenm,
+                                                     LL_HOLD_MAX );
+            httpd_ClientSetStreamMode( cl );
+            return VLC_SUCCESS;
+        }
+        if( mdate() < answer->i_body_offset )
+        {
+            vlc_mutex_unlock( &p_ll->lock );
+            return VLC_SUCCESS; /* wait */
+        }
+    }
+
+    struct vlc_memstream body;
+    vlc_memstream_open( &body );
+    if( i_ready > 0 )
+        LLPlaylist( p_sys, &body, true );
+    vlc_mutex_unlock( &p_ll->lock );
+    if( vlc_memstream_close( &body ) )
+        return VLC_EGENERIC;
+
+    const int i_status = i_ready > 0 ? 200 : i_ready < 0 ? 400 : 503;
+    const char *psz_mime = i_ready > 0 ? "application/vnd.apple.mpegurl"
+                                       : "text/plain";
+
+    if( answer->i_body_offset == 0 )
+    {
+        answer->i_proto = HTTPD_PROTO_HTTP;
+        answer->i_version = 1;
+        answer->i_type = HTTPD_MSG_ANSWER;
+        answer->i_status = i_status;
+        httpd_MsgAdd( answer, "Content-Type", "%s", psz_mime );
+        httpd_MsgAdd( answer, "Cache-Control", "no-cache" );
+        httpd_MsgAdd( answer, "Content-Length", "%zu", body.length );
+        if( httpd_MsgGet( query, "Connection" ) != NULL )
+            httpd_MsgAdd( answer, "Connection", "close" );
+        answer->i_body = body.length;
+        answer->p_body = (uint8_t *)body.ptr;
+        return VLC_SUCCESS;
+    }
+
+    struct vlc_memstream ms;
+    vlc_memstream_open( &ms );
+    LLRawAnswer( &ms, query, i_status, i_status == 200 ? "OK" :
+                 i_status == 400 ? "Bad Request" : "Service Unavailable",
+                 psz_mime );
+    vlc_memstream_printf( &ms, "Content-Length: %zu\r\n\r\n", body.length );
+    vlc_memstream_write( &ms, body.ptr, body.length );
+    free( body.ptr );
+    if( vlc_memstream_close( &ms ) )
+        return VLC_EGENERIC;
+
+    answer->i_type = HTTPD_MSG_ANSWER;
+    answer->i_body = ms.length;
+    answer->p_body = (uint8_t *)ms.ptr;
+    answer->i_body_offset = 0;
+    return VLC_SUCCESS;
+}
+
+static int LLMediaCallback( httpd_callback_sys_t *p_cbsys, httpd_client_t *cl,
+                            httpd_message_t *answer,
+                            const httpd_message_t *query )
+{
+    sout_access_out_t *p_access = (sout_access_out_t *)p_cbsys;
+    livehttp_ll_t *p_ll = p_access->p_sys->p_ll;
+    unsigned i_msn, i_part;
+    bool b_found = false, b_complete = false;
+    size_t i_start = 0, i_size = 0;
+
+    if( !answer || !query || !cl )
+        return VLC_SUCCESS;
+
+    const bool b_part = LLGetArg( query->psz_args, "part", &i_part );
+    const bool b_chunked = query->i_version > 0;
+
+    vlc_mutex_lock( &p_ll->lock );
+    if( LLGetArg( query->psz_args, "msn", &i_msn ) )
+    {
+        const ll_segment_t *p_seg = LLFindSegment( p_ll, i_msn );
+
+        if( p_seg == NULL )
+        {
+            /* The first part of the next segment can be hinted */
+            const ll_segment_t *p_last = p_ll->i_segments > 0
+                ? p_ll->pp_segments[p_ll->i_segments - 1] : NULL;
+            b_found = !p_ll->b_ended && b_part && i_part == 0 &&
+                      ( p_last ? i_msn == p_last->i_number + 1 : true );
+        }
+        else if( !b_part )
+        {
+            b_found = true;
+            i_size = p_seg->i_size;
+            b_complete = p_seg->b_complete;
+        }
+        else if( i_part < p_seg->i_parts )
+        {
+            b_found = true;
+            i_start = p_seg->p_parts[i_part].i_offset;
+            i_size = p_seg->p_parts[i_part].i_size;
+            b_complete = p_seg->p_parts[i_part].b_complete;
+        }
+        else if( i_part == p_seg->i_parts && !p_seg->b_complete )
+        {
+            b_found = true; /* part hinted in the playlist */
+            i_start = p_seg->i_size;
+        }
+        b_complete = b_complete || p_ll->b_ended;
+    }
+
+    if( answer->i_body_offset == 0 && ( !b_found || b_complete ) )
+    {
+        const ll_segment_t *p_seg = b_found ? LLFindSegment( p_ll, i_msn )
+                                            : NULL;
+
+        answer->i_proto = HTTPD_PROTO_HTTP;
+        answer->i_version = 1;
+        answer->i_type = HTTPD_MSG_ANSWER;
+        answer->i_status = b_found ? 200 : 404;
+        if( p_seg != NULL && i_size > 0 )
+        {
+            answer->p_body = malloc( i_size );
+            if( answer->p_body != NULL )
+            {
+                memcpy( answer->p_body, &p_seg->p_data[i_start], i_size );
+                answer->i_body = i_size;
+            }
+        }
+        vlc_mutex_unlock( &p_ll->lock );
+
+        httpd_MsgAdd( answer, "Content-Type", "%s",
+                      b_found ? "video/MP2T" : "text/plain" );
+        httpd_MsgAdd( answer, "Cache-Control", "no-cache" );
+        httpd_MsgAdd( answer, "Content-Length", "%d", answer->i_body );
+        if( httpd_MsgGet( query, "Connection" ) != NULL )
+            httpd_MsgAdd( answer, "Connection", "close" );
+        return VLC_SUCCESS;
+    }
+
+    /* Growing part or segment: i_body_offset - 1 bytes were sent */
+    struct vlc_memstream ms;
+    vlc_memstream_open( &ms );
+
+    if( answer->i_body_offset == 0 )
+    {
+        LLRawAnswer( &ms, query, 200, "OK", "video/MP2T" );
+        if( b_chunked )
+            vlc_memstream_puts( &ms, "Transfer-Encoding: chunked\r\n" );
+        vlc_memstream_puts( &ms, "\r\n" );
+        answer->i_proto = HTTPD_PROTO_NONE;
+        answer->i_body_offset = 1;
+        httpd_ClientSetStreamMode( cl );
+    }
+
+    size_t i_sent = answer->i_body_offset - 1;
+    if( !b_found )
+        b_complete = true; /* evicted meanwhile */
+    else if( i_size > i_sent )
+    {
+        const ll_segment_t *p_seg = LLFindSegment( p_ll, i_msn );
+        size_t i_chunk = i_size - i_sent;
+
+        if( b_chunked )
+            vlc_memstream_printf( &ms, "%zx\r\n", i_chunk );
+        vlc_memstream_write( &ms, &p_seg->p_data[i_start + i_sent], i_chunk );
+        if( b_chunked )
+            vlc_memstream_puts( &ms, "\r\n" );
+        i_sent += i_chunk;
+    }
+    vlc_mutex_unlock( &p_ll->lock );
+
+    if( b_complete )
+    {
+        if( b_chunked )
+            vlc_memstream_puts( &ms, "0\r\n\r\n" );
+        answer->i_body_offset = 0;
+    }
+    else
+        answer->i_body_offset = i_sent + 1;
+
+    if( vlc_memstream_close( &ms ) )
+        return VLC_EGENERIC;
+    if( ms.length == 0 && !b_complete )
+    {
+        free( ms.ptr );
+        return VLC_SUCCESS; /* wait */
+    }
+    answer->i_type = HTTPD_MSG_ANSWER;
+    answer->i_body = ms.length;
+    answer->p_body = (uint8_t *)ms.ptr;
+    return VLC_SUCCESS;
+}
+
+static int LLOpen( sout_access_out_t *p_access )
+{
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+    livehttp_ll_t *p_ll = calloc( 1, sizeof( *p_ll ) );
+
+    if( unlikely( !p_ll ) )
+        return VLC_ENOMEM;
+
+    p_ll->i_part_target = INT64_C(1000)
+        * var_GetInteger( p_access, SOUT_CFG_PREFIX "partlen" );
+    p_ll->i_fd = -1;
+    vlc_mutex_init( &p_ll->lock );
+    p_sys->p_ll = p_ll;
+
+    char *psz_url = var_GetNonEmptyString( p_access,
+                                           SOUT_CFG_PREFIX "http-index" );
+    if( psz_url == NULL )
+    {
+        msg_Dbg( p_access, "%"PRId64" ms partial segments",
+                 p_ll->i_part_target / 1000 );
+        return VLC_SUCCESS;
+    }
+
+    /* The segments are served from memory: keep a window */
+    if( p_sys->i_numsegs == 0 )
+        p_sys->i_numsegs = LL_HTTP_NUMSEGS;
+
+    /* Media at the same place as the playlist, with a .ts extension */
+    char *psz_media_url;
+    const char *psz_name = strrchr( psz_url, '/' );
+    psz_name = psz_name ? psz_name + 1 : psz_url;
+    const char *psz_ext = strrchr( psz_name, '.' );
+    int i_base = psz_ext ? psz_ext - psz_url : (int)strlen( psz_url );
+    if( asprintf( &psz_media_url, "%.*s.ts", i_base, psz_url ) < 0 )
+        psz_media_url = NULL;
+    else
+        p_ll->psz_media = strdup( &psz_media_url[psz_name - psz_url] );
+
+    p_ll->p_host = vlc_http_HostNew( VLC_OBJECT(p_access) );
+    if( p_ll->p_host && psz_media_url && p_ll->psz_media )
+    {
+        p_ll->p_index_url = httpd_UrlNew( p_ll->p_host, psz_url, NULL, NULL );
+        p_ll->p_media_url = httpd_UrlNew( p_ll->p_host, psz_media_url,
+                                          NULL, NULL );
+    }
+    if( !p_ll->p_index_url || !p_ll->p_media_url )
+    {
+        msg_Err( p_access, "cannot serve %s", psz_url );
+        free( psz_media_url );
+        free( psz_url );
+        LLClose( p_access );
+        return VLC_EGENERIC;
+    }
+
+    httpd_UrlCatch( p_ll->p_index_url, HTTPD_MSG_GET, LLIndexCallback,
+                    (httpd_callback_sys_t *)p_access );
+    httpd_UrlCatch( p_ll->p_media_url, HTTPD_MSG_GET, LLMediaCallback,
+                    (httpd_callback_sys_t *)p_access );
+
+    msg_Dbg( p_access, "%"PRId64" ms partial segments, serving %s and %s",
+             p_ll->i_part_target / 1000, psz_url, psz_media_url );
+    free( psz_media_url );
+    free( psz_url );
+    return VLC_SUCCESS;
+}
+
+static void LLClose( sout_access_out_t *p_access )
+{
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+    livehttp_ll_t *p_ll = p_sys->p_ll;
+    ll_segment_t *p_seg = LLCurrentSegment( p_ll );
+
+    vlc_mutex_lock( &p_ll->lock );
+    p_ll->b_ended = true;
+    vlc_mutex_unlock( &p_ll->lock );
+
+    if( p_seg )
+        LLSegmentClose( p_access, p_seg, p_ll->i_last_end );
+
+    /* Stops the callbacks */
+    if( p_ll->p_index_url )
+        httpd_UrlDelete( p_ll->p_index_url );
+    if( p_ll->p_media_url )
+        httpd_UrlDelete( p_ll->p_media_url );
+    if( p_ll->p_host )
+        httpd_HostDelete( p_ll->p_host );
+
+    for( int i = 0; i < p_ll->i_segments; i++ )
+    {
+        p_seg = p_ll->pp_segments[i];
+        if( p_sys->b_delsegs && p_sys->i_numsegs )
+        {
+            msg_Dbg( p_access, "Removing segment number %"PRIu32" name %s",
+                     p_seg->i_number, p_seg->psz_filename );
+            vlc_unlink( p_seg->psz_filename );
+        }
+        LLSegmentDelete( p_seg );
+    }
+    TAB_CLEAN( p_ll->i_segments, p_ll->pp_segments );
+
+    vlc_mutex_destroy( &p_ll->lock );
+    free( p_ll->psz_media );
+    free( p_ll );
+    p_sys->p_ll = NULL;
+}
@@ -30,6 +30,11 @@
 # include "config.h"
 #endif
 
+#ifdef COMPRESSOR_TEST
+# undef NDEBUG
+#endif
+
+#include <assert.h>
 #include <math.h>
 #include <stdint.h>
 
@@ -38,6 +43,18 @@
 
 #include <vlc_aout.h>
 #include <vlc_filter.h>
+#include <vlc_cpu.h>
+
+#ifdef HAVE_SSE2_INTRINSICS
+# include <xmmintrin.h>
+#endif
+#ifdef HAVE_AVX2_INTRINSICS
+# include <immintrin.h>
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+# include <arm_neon.h>
+# define COMPRESSOR_NEON 1
+#endif
 
 /*****************************************************************************
 * Local prototypes.
@@ -54,6 +71,7 @@
 #define DB_DEFAULT_CUBE
 #define RMS_BUF_SIZE    (960)
 #define LOOKAHEAD_SIZE  ((RMS_BUF_SIZE)<<1)
+#define WORK_FRAMES     (256)
 
 #define LIN_INTERP(f,a,b) ((a) + (f) * ( (b) - (a) ))
 #define LIMIT(v,l,u)      (v < l ? l : ( v > u ? u : v ))
@@ -69,14 +87,11 @@ typedef struct
 
 typedef struct
 {
-    struct
-    {
-        float pf_vals[AOUT_CHAN_MAX];
-        float f_lev_in;
-
-    } p_buf[LOOKAHEAD_SIZE];
+    float        *pf_vals;      /* i_count frames of i_channels samples */
+    float        pf_lev_in[LOOKAHEAD_SIZE];
     unsigned int i_pos;
     unsigned int i_count;
+    unsigned int i_channels;
 
 } lookahead;
 
@@ -97,6 +112,13 @@ struct filter_sys_t
     float pf_db_data[DB_TABLE_SIZE];
     float pf_lin_data[LIN_TABLE_SIZE];
 
+    /* Samples are processed WORK_FRAMES frames at a time */
+    float pf_lev[WORK_FRAMES];      /* peak value of each frame */
+    float pf_gain[WORK_FRAMES];     /* total gain of each frame */
+    void (*pf_peak)( const float *, float *, unsigned int, unsigned int );
+    void (*pf_delay)( float *, const float *, float, unsigned int,
+                      lookahead * );
+
     vlc_mutex_t lock;
 
     float f_rms_peak;
@@ -119,6 +141,10 @@ static int      Open            ( vlc_object_t * );
 static void     Close           ( vlc_object_t * );
 static block_t *DoWork          ( filter_t *, block_t * );
 
+static void     RateInit        ( filter_sys_t *, float );
+static int      BufferInit      ( filter_sys_t *, unsigned int, bool );
+static void     Compress        ( filter_sys_t *, float *, int );
+
 static void     DbInit          ( filter_sys_t * );
 static float    Db2Lin          ( float, filter_sys_t * );
 static float    Lin2Db          ( float, filter_sys_t * );
@@ -131,7 +157,6 @@ static float    Max             ( float, float );
 static float    Clamp           ( float, float, float );
 static int      Round           ( float );
 static float    RmsEnvProcess   ( rms_env *, const float );
-static void     BufferProcess   ( float *, int, float, float, lookahead * );
 
 static int RMSPeakCallback      ( vlc_object_t *, char const *, vlc_value_t,
                                   vlc_value_t, void * );
@@ -206,8 +231,6 @@ static int Open( vlc_object_t *p_this )
 {
     filter_t *p_filter = (filter_t*)p_this;
     vlc_object_t *p_aout = p_filter->obj.parent;
-    float f_sample_rate = p_filter->fmt_in.audio.i_rate;
-    float f_num;
 
     /* Initialize the filter parameter structure */
     filter_sys_t *p_sys = p_filter->p_sys = calloc( 1, sizeof(*p_sys) );
@@ -216,21 +239,16 @@ static int Open( vlc_object_t *p_this )
         return VLC_ENOMEM;
     }
 
-    /* Initialize the attack lookup table */
-    p_sys->pf_as[0] = 1.0f;
-    for( int i = 1; i < A_TBL; i++ )
+    /* Initialize the lookup tables and the buffers */
+    RateInit( p_sys, p_filter->fmt_in.audio.i_rate );
+    DbInit( p_sys );
+    if( BufferInit( p_sys, aout_FormatNbChannels( &p_filter->fmt_in.audio ),
+                    true ) )
     {
-        p_sys->pf_as[i] = expf( -1.0f / ( f_sample_rate * i / A_TBL ) );
+        free( p_sys );
+        return VLC_ENOMEM;
     }
 
-    /* Calculate the RMS and lookahead sizes from the sample rate */
-    f_num = 0.01f * f_sample_rate;
-    p_sys->rms.i_count = Round( Clamp( 0.5f * f_num, 1.0f, RMS_BUF_SIZE ) );
-    p_sys->la.i_count = Round( Clamp( f_num, 1.0f, LOOKAHEAD_SIZE ) );
-
-    /* Initialize decibel lookup tables */
-    DbInit( p_sys );
-
     /* Restore the last saved settings */
     p_sys->f_rms_peak    = var_CreateGetFloat( p_aout, "compressor-rms-peak" );
     p_sys->f_attack      = var_CreateGetFloat( p_aout, "compressor-attack" );
@@ -287,6 +305,7 @@ static void Close( vlc_object_t *p_this )
     vlc_mutex_destroy( &p_sys->lock );
 
     /* Destroy the filter parameter structure */
+    free( p_sys->la.pf_vals );
     free( p_sys );
 }
 
@@ -296,13 +315,22 @@ static void Close( vlc_object_t *p_this )
 
 static block_t * DoWork( filter_t * p_filter, block_t * p_in_buf )
 {
-    int i_samples = p_in_buf->i_nb_samples;
-    int i_channels = aout_FormatNbChannels( &p_filter->fmt_in.audio );
-    float *pf_buf = (float*)p_in_buf->p_buffer;
+    Compress( p_filter->p_sys, (float*)p_in_buf->p_buffer,
+              p_in_buf->i_nb_samples );
+    return p_in_buf;
+}
 
-    /* Current parameters */
-    filter_sys_t *p_sys = p_filter->p_sys;
+/*****************************************************************************
+ * Compress: process interleaved samples in place
+ *****************************************************************************
+ * The samples go WORK_FRAMES frames at a time through the kernels, that find
+ * the peak value of each frame and output the delayed frames with their gain,
+ * for all the channels at once. Only the envelopes and the gain run frame by
+ * frame in between.
+ *****************************************************************************/
 
+static void Compress( filter_sys_t *p_sys, float *pf_buf, int i_samples )
+{
     /* Fetch the configurable parameters */
     vlc_mutex_lock( &p_sys->lock );
 
@@ -327,6 +355,7 @@ static block_t * DoWork( filter_t * p_filter, block_t * p_in_buf )
     rms_env *p_rms   = &p_sys->rms;
     float f_sum      =  p_sys->f_sum;
     lookahead *p_la  = &p_sys->la;
+    const unsigned int i_channels = p_la->i_channels;
 
     /* Prepare other compressor parameters */
     float f_ga       = f_attack < 2.0f ? 0.0f :
@@ -340,94 +369,106 @@ static block_t * DoWork( filter_t * p_filter, block_t * p_in_buf )
     float f_ef_ai    = 1.0f - f_ef_a;
 
     /* Process the current buffer */
-    for( int i = 0; i < i_samples; i++ )
+    for( int i_start = 0; i_start < i_samples; i_start += WORK_FRAMES )
     {
-        float f_lev_in_old, f_lev_in_new;
+        const int i_frames = __MIN( WORK_FRAMES, i_samples - i_start );
+        float *pf_frames = pf_buf + i_start * i_channels;
+        unsigned int i_pos = p_la->i_pos;
 
-        /* Now, compress the pre-equalized audio (ported from sc4_1882
-         * plugin with a few modifications) */
+        /* Find the peak value of each frame */
+        p_sys->pf_peak( pf_frames, p_sys->pf_lev, i_frames, i_channels );
 
-        /* Fetch the old delayed buffer value */
-        f_lev_in_old = p_la->p_buf[p_la->i_pos].f_lev_in;
-
-        /* Find the peak value of current sample.  This becomes the new delayed
-         * buffer value that replaces the old one in the lookahead array */
-        f_lev_in_new = fabs( pf_buf[0] );
-        for( int i_chan = 1; i_chan < i_channels; i_chan++ )
+        for( int i = 0; i < i_frames; i++ )
         {
-            f_lev_in_new = Max( f_lev_in_new, fabs( pf_buf[i_chan] ) );
-        }
-        p_la->p_buf[p_la->i_pos].f_lev_in = f_lev_in_new;
+            float f_lev_in_old, f_lev_in_new;
 
-        /* Add the square of the peak value to a running sum */
-        f_sum += f_lev_in_new * f_lev_in_new;
+            /* Now, compress the pre-equalized audio (ported from sc4_1882
+             * plugin with a few modifications) */
 
-        /* Update the RMS envelope */
-        if( f_amp > f_env_rms )
-        {
-            f_env_rms = f_env_rms * f_ga + f_amp * ( 1.0f - f_ga );
-        }
-        else
-        {
-            f_env_rms = f_env_rms * f_gr + f_amp * ( 1.0f - f_gr );
-        }
-        RoundToZero( &f_env_rms );
+            /* Fetch the old delayed buffer value */
+            f_lev_in_old = p_la->pf_lev_in[i_pos];
 
-        /* Update the peak envelope */
-        if( f_lev_in_old > f_env_peak )
-        {
-            f_env_peak = f_env_peak * f_ga + f_lev_in_old * ( 1.0f - f_ga );
-        }
-        else
-        {
-            f_env_peak = f_env_peak * f_gr + f_lev_in_old * ( 1.0f - f_gr );
-        }
-        RoundToZero( &f_env_peak );
+            /* The peak value of current sample becomes the new delayed buffer
+             * value that replaces the old one in the lookahead array */
+            f_lev_in_new = p_sys->pf_lev[i];
+            p_la->pf_lev_in[i_pos] = f_lev_in_new;
 
-        /* Process the RMS value and update the output gain every 4 samples */
-        if( ( p_sys->i_count++ & 3 ) == 3 )
-        {
-            /* Process the RMS value by placing in the mean square value, and
-             * reset the running sum */
-            f_amp = RmsEnvProcess( p_rms, f_sum * 0.25f );
-            f_sum = 0.0f;
-            if( isnan( f_env_rms ) )
+            /* Add the square of the peak value to a running sum */
+            f_sum += f_lev_in_new * f_lev_in_new;
+
+            /* Update the RMS envelope */
+            if( f_amp > f_env_rms )
             {
-                /* This can happen sometimes, but I don't know why. */
-                f_env_rms = 0.0f;
+                f_env_rms = f_env_rms * f_ga + f_amp * ( 1.0f - f_ga );
             }
-
-            /* Find the superposition of the RMS and peak envelopes */
-            f_env = LIN_INTERP( f_rms_peak, f_env_rms, f_env_peak );
-
-            /* Update the output gain */
-            if( f_env <= f_knee_min )
+            else
             {
-                /* Gain below the knee (and below the threshold) */
-                f_gain_out = 1.0f;
+                f_env_rms = f_env_rms * f_gr + f_amp * ( 1.0f - f_gr );
             }
-            else if( f_env < f_knee_max )
+            RoundToZero( &f_env_rms );
+
+            /* Update the peak envelope */
+            if( f_lev_in_old > f_env_peak )
             {
-                /* Gain within the knee */
-                const float f_x = -( f_threshold
-                                   - f_knee - Lin2Db( f_env, p_sys ) ) / f_knee;
-                f_gain_out = Db2Lin( -f_knee * f_rs * f_x * f_x * 0.25f,
-                                      p_sys );
+                f_env_peak = f_env_peak * f_ga + f_lev_in_old * ( 1.0f - f_ga );
             }
             else
             {
-                /* Gain above the knee (and above the threshold) */
-                f_gain_out = Db2Lin( ( f_threshold - Lin2Db( f_env, p_sys ) )
-                                     * f_rs, p_sys );
+                f_env_peak = f_env_peak * f_gr + f_lev_in_old * ( 1.0f - f_gr );
+            }
+            RoundToZero( &f_env_peak );
+
+            /* Process the RMS value and update the output gain every 4
+             * samples */
+            if( ( p_sys->i_count++ & 3 ) == 3 )
+            {
+                /* Process the RMS value by placing in the mean square value,
+                 * and reset the running sum */
+                f_amp = RmsEnvProcess( p_rms, f_sum * 0.25f );
+                f_sum = 0.0f;
+                if( isnan( f_env_rms ) )
+                {
+                    /* This can happen sometimes, but I don't know why. */
+                    f_env_rms = 0.0f;
+                }
+
+                /* Find the superposition of the RMS and peak envelopes */
+                f_env = LIN_INTERP( f_rms_peak, f_env_rms, f_env_peak );
+
+                /* Update the output gain */
+                if( f_env <= f_knee_min )
+                {
+                    /* Gain below the knee (and below the threshold) */
+                    f_gain_out = 1.0f;
+                }
+                else if( f_env < f_knee_max )
+                {
+                    /* Gain within the knee */
+                    const float f_x = -( f_threshold - f_knee
+                                       - Lin2Db( f_env, p_sys ) ) / f_knee;
+                    f_gain_out = Db2Lin( -f_knee * f_rs * f_x * f_x * 0.25f,
+                                          p_sys );
+                }
+                else
+                {
+                    /* Gain above the knee (and above the threshold) */
+                    f_gain_out = Db2Lin( ( f_threshold
+                                           - Lin2Db( f_env, p_sys ) ) * f_rs,
+                                         p_sys );
+                }
             }
-        }
 
-        /* Find the total gain */
-        f_gain = f_gain * f_ef_a + f_gain_out * f_ef_ai;
+            /* Find the total gain */
+            f_gain = f_gain * f_ef_a + f_gain_out * f_ef_ai;
+            p_sys->pf_gain[i] = f_gain;
+
+            /* Go to the next delayed buffer value for the next frame */
+            if( ++i_pos == p_la->i_count )
+                i_pos = 0;
+        }
 
         /* Write the resulting buffer to the output */
-        BufferProcess( pf_buf, i_channels, f_gain, f_mug, p_la );
-        pf_buf += i_channels;
+        p_sys->pf_delay( pf_frames, p_sys->pf_gain, f_mug, i_frames, p_la );
     }
 
     /* Update the internal parameters */
@@ -438,14 +479,29 @@ static block_t * DoWork( filter_t * p_filter, block_t * p_in_buf )
     p_sys->f_env      = f_env;
     p_sys->f_env_rms  = f_env_rms;
     p_sys->f_env_peak = f_env_peak;
-
-    return p_in_buf;
 }
 
 /*****************************************************************************
  * Helper functions for compressor
  *****************************************************************************/
 
+static void RateInit( filter_sys_t * p_sys, float f_sample_rate )
+{
+    float f_num;
+
+    /* Initialize the attack lookup table */
+    p_sys->pf_as[0] = 1.0f;
+    for( int i = 1; i < A_TBL; i++ )
+    {
+        p_sys->pf_as[i] = expf( -1.0f / ( f_sample_rate * i / A_TBL ) );
+    }
+
+    /* Calculate the RMS and lookahead sizes from the sample rate */
+    f_num = 0.01f * f_sample_rate;
+    p_sys->rms.i_count = Round( Clamp( 0.5f * f_num, 1.0f, RMS_BUF_SIZE ) );
+    p_sys->la.i_count = Round( Clamp( f_num, 1.0f, LOOKAHEAD_SIZE ) );
+}
+
 static void DbInit( filter_sys_t * p_sys )
 {
     float *pf_lin_data = p_sys->pf_lin_data;
@@ -603,27 +659,274 @@ static float RmsEnvProcess( rms_env * p_r, const float f_x )
     return sqrt( p_r->f_sum / p_r->i_count );
 }
 
+/*****************************************************************************
+ * Kernels: peak values and delayed output of the frames, over all channels
+ *****************************************************************************/
+
+/* Find the peak value of each frame */
+static void PeakC( const float * pf_buf, float * pf_lev,
+                   unsigned int i_frames, unsigned int i_channels )
+{
+    for( unsigned int i = 0; i < i_frames; i++, pf_buf += i_channels )
+    {
+        float f_lev = fabsf( pf_buf[0] );
+        for( unsigned int l = 1; l < i_channels; l++ )
+        {
+            f_lev = Max( f_lev, fabsf( pf_buf[l] ) );
+        }
+        pf_lev[i] = f_lev;
+    }
+}
+
 /* Output the compressed delayed buffer and store the current buffer.  Uses a
  * circular array, just like the one used in calculating the RMS of the buffer
  */
-static void BufferProcess( float * pf_buf, int i_channels, float f_gain,
-                           float f_mug, lookahead * p_la )
+static void DelayC( float * pf_buf, const float * pf_gain, float f_mug,
+                    unsigned int i_frames, lookahead * p_la )
 {
-    /* Loop through every channel */
-    for( int i_chan = 0; i_chan < i_channels; i_chan++ )
+    const unsigned int i_channels = p_la->i_channels;
+
+    for( unsigned int i = 0; i < i_frames; i++, pf_buf += i_channels )
     {
-        float f_x = pf_buf[i_chan]; /* Current buffer value */
+        float *pf_vals = p_la->pf_vals + p_la->i_pos * i_channels;
+
+        for( unsigned int l = 0; l < i_channels; l++ )
+        {
+            float f_x = pf_buf[l]; /* Current buffer value */
 
-        /* Output the compressed delayed buffer value */
-        pf_buf[i_chan] = p_la->p_buf[p_la->i_pos].pf_vals[i_chan]
-                       * f_gain * f_mug;
+            /* Output the compressed delayed buffer value */
+            pf_buf[l] = pf_vals[l] * pf_gain[i] * f_mug;
 
-        /* Update the delayed buffer value */
-        p_la->p_buf[p_la->i_pos].pf_vals[i_chan] = f_x;
+            /* Update the delayed buffer value */
+            pf_vals[l] = f_x;
+        }
+
+        /* Go to the next delayed buffer value for the next run */
+        if( ++p_la->i_pos == p_la->i_count )
+            p_la->i_pos = 0;
     }
+}
 
-    /* Go to the next delayed buffer value for the next run */
-    p_la->i_pos = ( p_la->i_pos + 1 ) % ( p_la->i_count );
+#ifdef HAVE_SSE2_INTRINSICS
+VLC_SSE
+static void PeakSSE( const float * pf_buf, float * pf_lev,
+                     unsigned int i_frames, unsigned int i_channels )
+{
+    const __m128 sign = _mm_set1_ps( -0.0f );
+
+    for( unsigned int i = 0; i < i_frames; i++, pf_buf += i_channels )
+    {
+        __m128 m = _mm_andnot_ps( sign, _mm_loadu_ps( pf_buf ) );
+        unsigned int l = 4;
+        for( ; l + 4 <= i_channels; l += 4 )
+            m = _mm_max_ps( m, _mm_andnot_ps( sign,
+                                              _mm_loadu_ps( pf_buf + l ) ) );
+        m = _mm_max_ps( m, _mm_movehl_ps( m, m ) );
+        m = _mm_max_ss( m, _mm_shuffle_ps( m, m, _MM_SHUFFLE(1, 1, 1, 1) ) );
+
+        float f_lev = _mm_cvtss_f32( m );
+        for( ; l < i_channels; l++ )
+            f_lev = Max( f_lev, fabsf( pf_buf[l] ) );
+        pf_lev[i] = f_lev;
+    }
+}
+
+VLC_SSE
+static void DelaySSE( float * pf_buf, const float * pf_gain, float f_mug,
+                      unsigned int i_frames, lookahead * p_la )
+{
+    const unsigned int i_channels = p_la->i_channels;
+    const __m128 mug = _mm_set1_ps( f_mug );
+
+    for( unsigned int i = 0; i < i_frames; i++, pf_buf += i_channels )
+    {
+        float *pf_vals = p_la->pf_vals + p_la->i_pos * i_channels;
+        const __m128 gain = _mm_set1_ps( pf_gain[i] );
+        unsigned int l = 0;
+
+        for( ; l + 4 <= i_channels; l += 4 )
+        {
+            __m128 x = _mm_loadu_ps( pf_buf + l );
+            __m128 y = _mm_mul_ps( _mm_loadu_ps( pf_vals + l ), gain );
+            _mm_storeu_ps( pf_buf + l, _mm_mul_ps( y, mug ) );
+            _mm_storeu_ps( pf_vals + l, x );
+        }
+        for( ; l < i_channels; l++ )
+        {
+            float f_x = pf_buf[l];
+            pf_buf[l] = pf_vals[l] * pf_gain[i] * f_mug;
+            pf_vals[l] = f_x;
+        }
+
+        if( ++p_la->i_pos == p_la->i_count )
+            p_la->i_pos = 0;
+    }
+}
+#endif
+
+#ifdef HAVE_AVX2_INTRINSICS
+__attribute__ ((__target__ ("avx2")))
+static void PeakAVX2( const float * pf_buf, float * pf_lev,
+                      unsigned int i_frames, unsigned int i_channels )
+{
+    const __m256 sign = _mm256_set1_ps( -0.0f );
+
+    for( unsigned int i = 0; i < i_frames; i++, pf_buf += i_channels )
+    {
+        __m256 m8 = _mm256_andnot_ps( sign, _mm256_loadu_ps( pf_buf ) );
+        unsigned int l = 8;
+        for( ; l + 8 <= i_channels; l += 8 )
+            m8 = _mm256_max_ps( m8, _mm256_andnot_ps( sign,
+                                            _mm256_loadu_ps( pf_buf + l ) ) );
+        __m128 m = _mm_max_ps( _mm256_castps256_ps128( m8 ),
+                               _mm256_extractf128_ps( m8, 1 ) );
+        if( l + 4 <= i_channels )
+        {
+            m = _mm_max_ps( m, _mm_andnot_ps( _mm256_castps256_ps128( sign ),
+                                              _mm_loadu_ps( pf_buf + l ) ) );
+            l += 4;
+        }
+        m = _mm_max_ps( m, _mm_movehl_ps( m, m ) );
+        m = _mm_max_ss( m, _mm_shuffle_ps( m, m, _MM_SHUFFLE(1, 1, 1, 1) ) );
+
+        float f_lev = _mm_cvtss_f32( m );
+        for( ; l < i_channels; l++ )
+            f_lev = Max( f_lev, fabsf( pf_buf[l] ) );
+        pf_lev[i] = f_lev;
+    }
+}
+
+__attribute__ ((__target__ ("avx2")))
+static void DelayAVX2( float * pf_buf, const float * pf_gain, float f_mug,
+                       unsigned int i_frames, lookahead * p_la )
+{
+    const unsigned int i_channels = p_la->i_channels;
+    const __m256 mug = _mm256_set1_ps( f_mug );
+
+    for( unsigned int i = 0; i < i_frames; i++, pf_buf += i_channels )
+    {
+        float *pf_vals = p_la->pf_vals + p_la->i_pos * i_channels;
+        const __m256 gain = _mm256_set1_ps( pf_gain[i] );
+        unsigned int l = 0;
+
+        for( ; l + 8 <= i_channels; l += 8 )
+        {
+            __m256 x = _mm256_loadu_ps( pf_buf + l );
+            __m256 y = _mm256_mul_ps( _mm256_loadu_ps( pf_vals + l ), gain );
+            _mm256_storeu_ps( pf_buf + l, _mm256_mul_ps( y, mug ) );
+            _mm256_storeu_ps( pf_vals + l, x );
+        }
+        for( ; l < i_channels; l++ )
+        {
+            float f_x = pf_buf[l];
+            pf_buf[l] = pf_vals[l] * pf_gain[i] * f_mug;
+            pf_vals[l] = f_x;
+        }
+
+        if( ++p_la->i_pos == p_la->i_count )
+            p_la->i_pos = 0;
+    }
+}
+#endif
+
+#ifdef COMPRESSOR_NEON
+static void PeakNEON( const float * pf_buf, float * pf_lev,
+                      unsigned int i_frames, unsigned int i_channels )
+{
+    for( unsigned int i = 0; i < i_frames; i++, pf_buf += i_channels )
+    {
+        float32x4_t m = vabsq_f32( vld1q_f32( pf_buf ) );
+        unsigned int l = 4;
+        for( ; l + 4 <= i_channels; l += 4 )
+            m = vmaxq_f32( m, vabsq_f32( vld1q_f32( pf_buf + l ) ) );
+        float32x2_t h = vpmax_f32( vget_low_f32( m ), vget_high_f32( m ) );
+        h = vpmax_f32( h, h );
+
+        float f_lev = vget_lane_f32( h, 0 );
+        for( ; l < i_channels; l++ )
+            f_lev = Max( f_lev, fabsf( pf_buf[l] ) );
+        pf_lev[i] = f_lev;
+    }
+}
+
+static void DelayNEON( float * pf_buf, const float * pf_gain, float f_mug,
+                       unsigned int i_frames, lookahead * p_la )
+{
+    const unsigned int i_channels = p_la->i_channels;
+
+    for( unsigned int i = 0; i < i_frames; i++, pf_buf += i_channels )
+    {
+        float *pf_vals = p_la->pf_vals + p_la->i_pos * i_channels;
+        unsigned int l = 0;
+
+        for( ; l + 4 <= i_channels; l += 4 )
+        {
+            float32x4_t x = vld1q_f32( pf_buf + l );
+            float32x4_t y = vmulq_n_f32( vld1q_f32( pf_vals + l ), pf_gain[i] );
+            vst1q_f32( pf_buf + l, vmulq_n_f32( y, f_mug ) );
+            vst1q_f32( pf_vals + l, x );
+        }
+        for( ; l < i_channels; l++ )
+        {
+            float f_x = pf_buf[l];
+            pf_buf[l] = pf_vals[l] * pf_gain[i] * f_mug;
+            pf_vals[l] = f_x;
+        }
+
+        if( ++p_la->i_pos == p_la->i_count )
+            p_la->i_pos = 0;
+    }
+}
+#endif
+
+/* Pick the kernels for the number of channels, the vectors of which must be
+ * filled at least once by every frame */
+static void KernelsInit( filter_sys_t * p_sys, unsigned int i_channels,
+                         bool b_optimized )
+{
+    p_sys->pf_peak = PeakC;
+    p_sys->pf_delay = DelayC;
+
+    if( !b_optimized )
+        return;
+#ifdef HAVE_SSE2_INTRINSICS
+    if( vlc_CPU_SSE() && i_channels >= 4 )
+    {
+        p_sys->pf_peak = PeakSSE;
+        p_sys->pf_delay = DelaySSE;
+    }
+#endif
+#ifdef HAVE_AVX2_INTRINSICS
+    if( vlc_CPU_AVX2() && i_channels >= 8 )
+    {
+        p_sys->pf_peak = PeakAVX2;
+        p_sys->pf_delay = DelayAVX2;
+    }
+#endif
+#ifdef COMPRESSOR_NEON
+    if( i_channels >= 4 )
+    {
+        p_sys->pf_peak = PeakNEON;
+        p_sys->pf_delay = DelayNEON;
+    }
+#endif
+}
+
+/* Allocate the lookahead buffer */
+static int BufferInit( filter_sys_t * p_sys, unsigned int i_channels,
+                       bool b_optimized )
+{
+    lookahead *p_la = &p_sys->la;
+
+    KernelsInit( p_sys, i_channels, b_optimized );
+
+    p_la->i_channels = i_channels;
+    p_la->pf_vals = calloc( p_la->i_count * i_channels, sizeof(float) );
+    if( !p_la->pf_vals )
+    {
+        return VLC_ENOMEM;
+    }
+    return VLC_SUCCESS;
 }
 
 /*****************************************************************************
@@ -726,3 +1029,191 @@ static int MakeupGainCallback( vlc_object_t *p_this, char const *psz_cmd,
 
     return VLC_SUCCESS;
 }
+
+#ifdef COMPRESSOR_TEST
+#include <stdio.h>
+#include <unistd.h>
+
+/* Comparison of the kernels with the plain C code, checks of the delay and of
+ * the gain, then speed of the filter on request */
+
+static const unsigned int channels[] = { 1, 2, 3, 6, 8, 9, 16 };
+
+static void Setup( filter_sys_t * p_sys, unsigned int i_channels,
+                   bool b_optimized )
+{
+    memset( p_sys, 0, sizeof (*p_sys) );
+    RateInit( p_sys, 48000 );
+    DbInit( p_sys );
+
+    /* Default settings */
+    p_sys->f_rms_peak    = 0.2f;
+    p_sys->f_attack      = 25.0f;
+    p_sys->f_release     = 100.0f;
+    p_sys->f_threshold   = -11.0f;
+    p_sys->f_ratio       = 4.0f;
+    p_sys->f_knee        = 5.0f;
+    p_sys->f_makeup_gain = 7.0f;
+    vlc_mutex_init( &p_sys->lock );
+    assert( BufferInit( p_sys, i_channels, b_optimized ) == VLC_SUCCESS );
+}
+
+static void Clean( filter_sys_t * p_sys )
+{
+    vlc_mutex_destroy( &p_sys->lock );
+    free( p_sys->la.pf_vals );
+}
+
+/* Noise with a level going up and down between -40 and +6 dB */
+static float *Signal( size_t i_frames, unsigned int i_channels )
+{
+    float *pf_buf = vlc_alloc( i_frames * i_channels, sizeof (float) );
+    assert( pf_buf != NULL );
+
+    uint32_t seed = 0x5eed;
+    for( size_t i = 0; i < i_frames; i++ )
+    {
+        float f_db = -17.f + 23.f * sinf( 2 * (float)M_PI * i / 24000 );
+        float f_amp = powf( 10.f, f_db / 20.f );
+        for( unsigned int ch = 0; ch < i_channels; ch++ )
+        {
+            seed = seed * 1664525 + 1013904223;
+            pf_buf[i * i_channels + ch] = f_amp * (int32_t)seed / 2147483648.f;
+        }
+    }
+    return pf_buf;
+}
+
+/* Runs the filter over the buffer, in blocks of varying sizes as from the
+ * audio output */
+static mtime_t Run( filter_sys_t * p_sys, float * pf_buf, size_t i_frames )
+{
+    const unsigned int i_channels = p_sys->la.i_channels;
+    mtime_t start = mdate();
+
+    for( size_t i = 0, n = 1; i < i_frames; i += n, n = n * 2 + 1 )
+    {
+        n = __MIN( n, i_frames - i );
+        Compress( p_sys, pf_buf + i * i_channels, n );
+    }
+    return mdate() - start;
+}
+
+/* Quiet samples come out delayed by the lookahead, with the makeup gain only,
+ * and loud ones are compressed */
+static int TestGain( void )
+{
+    const size_t i_frames = 48000;
+    filter_sys_t sys;
+    int errors = 0;
+    float *pf_in = vlc_alloc( i_frames, sizeof (float) );
+    float *pf_out = vlc_alloc( i_frames, sizeof (float) );
+    assert( pf_in != NULL && pf_out != NULL );
+
+    for( int loud = 0; loud < 2; loud++ )
+    {
+        const float f_amp = loud ? 1.0f : 0.01f;
+
+        Setup( &sys, 1, false );
+        for( size_t i = 0; i < i_frames; i++ )
+            pf_in[i] = f_amp * sinf( 2 * (float)M_PI * 440 * i / 48000 );
+        memcpy( pf_out, pf_in, i_frames * sizeof (float) );
+        Run( &sys, pf_out, i_frames );
+
+        const float f_mug = Db2Lin( sys.f_makeup_gain, &sys );
+        const unsigned int i_delay = sys.la.i_count;
+        double in = 0, out = 0, err = 0;
+        for( size_t i = i_frames / 2; i < i_frames; i++ )
+        {
+            const float f_x = pf_in[i - i_delay];
+            in += (double)f_x * f_x;
+            out += (double)pf_out[i] * pf_out[i];
+            err = __MAX( err, fabs( (double)f_mug * f_x - pf_out[i] ) );
+        }
+        const double db = 10. * log10( out / in ) - 20. * log10( f_mug );
+
+        if( !loud && err > f_amp * f_mug * 1e-5 )
+        {
+            fprintf( stderr, "quiet signal: error %g\n", err );
+            errors++;
+        }
+        /* About 9 dB over the threshold, with a ratio of 4 */
+        if( loud && ( db > -5. || db < -9. ) )
+        {
+            fprintf( stderr, "loud signal: gain %.2f dB\n", db );
+            errors++;
+        }
+        Clean( &sys );
+    }
+
+    free( pf_out );
+    free( pf_in );
+    return errors;
+}
+
+/* Runs both filters over the same noise, and prints their speed if asked */
+static int Compare( size_t i_frames, bool b_bench )
+{
+    int errors = 0;
+
+    for( size_t c = 0; c < ARRAY_SIZE(channels); c++ )
+    {
+        const unsigned int ch = channels[c];
+        const size_t samples = i_frames * ch;
+        filter_sys_t ref, opt;
+        mtime_t times[2];
+
+        Setup( &ref, ch, false );
+        Setup( &opt, ch, true );
+
+        float *pf_in = Signal( i_frames, ch );
+        float *pf_out[2];
+        for( int k = 0; k < 2; k++ )
+        {
+            pf_out[k] = vlc_alloc( samples, sizeof (float) );
+            assert( pf_out[k] != NULL );
+            memcpy( pf_out[k], pf_in, samples * sizeof (float) );
+            times[k] = Run( k ? &opt : &ref, pf_out[k], i_frames );
+        }
+
+        double max = 0, err = 0;
+        for( size_t i = 0; i < samples; i++ )
+        {
+            max = __MAX( max, fabs( pf_out[0][i] ) );
+            err = __MAX( err, fabs( (double)pf_out[0][i] - pf_out[1][i] ) );
+        }
+        if( err > max * 1e-5 )
+        {
+            fprintf( stderr, "%u channels: relative error %g\n", ch,
+                     err / max );
+            errors++;
+        }
+
+        if( b_bench )
+            printf( "%2u channels: C %.2f, optimized %.2f "
+                    "ns/sample/channel\n", ch,
+                    times[0] * 1000. / samples, times[1] * 1000. / samples );
+
+        for( int k = 0; k < 2; k++ )
+            free( pf_out[k] );
+        free( pf_in );
+        Clean( &opt );
+        Clean( &ref );
+    }
+    return errors;
+}
+
+int main( int argc, char *argv[] )
+{
+    int errors = 0;
+
+    alarm( 120 );
+    errors += TestGain();
+    errors += Compare( 48000, false );
+    /* compressor_test <seconds>: also benchmarks that much audio */
+    if( argc > 1 )
+        errors += Compare( 48000 * (size_t)atoi( argv[1] ), true );
+
+    return errors ? 1 : 0;
+}
+#endif
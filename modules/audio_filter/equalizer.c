@@ -29,6 +29,11 @@
 # include "config.h"
 #endif
 
+#ifdef EQUALIZER_TEST
+# undef NDEBUG
+#endif
+
+#include <assert.h>
 #include <math.h>
 
 #include <vlc_common.h>
@@ -37,11 +42,22 @@
 
 #include <vlc_aout.h>
 #include <vlc_filter.h>
+#include <vlc_cpu.h>
+
+#ifdef HAVE_SSE2_INTRINSICS
+# include <xmmintrin.h>
+#endif
+#ifdef HAVE_AVX2_INTRINSICS
+# include <immintrin.h>
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+# include <arm_neon.h>
+# define EQUALIZER_NEON 1
+#endif
 
 #include "equalizer_presets.h"
 
 /* TODO:
- *  - optimize a bit (you can hardly do slower ;)
  *  - add tables for more bands (15 and 32 would be cool), maybe with auto coeffs
  *    computation (not too hard once the Q is found).
  *  - support for external preset
@@ -114,13 +130,21 @@ struct filter_sys_t
     float f_gamp;   /* Global preamp */
     bool b_2eqz;
 
-    /* Filter state */
-    float x[32][2];
-    float y[32][128][2];
+    /* Samples are filtered frame by frame in lanes, one per channel, padded
+     * to the width of the kernel */
+    unsigned i_channels;
+    unsigned i_lanes;
+    float *p_work;  /* EQZ_WORK_FRAMES frames, if there is padding */
+
+    /* Filter state, x[n-1] and x[n-2], then y[n-1] and y[n-2] of each band,
+     * of each lane */
+    float *p_state;
 
     /* Second filter state */
-    float x2[32][2];
-    float y2[32][128][2];
+    float *p_state2;
+
+    void (*pf_bank)( const filter_sys_t *, float *, unsigned, float *,
+                     float );
 
     vlc_mutex_t lock;
 };
@@ -128,8 +152,12 @@ struct filter_sys_t
 static block_t *DoWork( filter_t *, block_t * );
 
 #define EQZ_IN_FACTOR (0.25f)
+/* Frames filtered at once through both passes, so that they stay in the
+ * data cache */
+#define EQZ_WORK_FRAMES 256
 static int  EqzInit( filter_t *, int );
-static void EqzFilter( filter_t *, float *, float *, int, int );
+static int  EqzInitState( filter_sys_t *, unsigned, bool );
+static void EqzFilter( filter_sys_t *, float *, unsigned );
 static void EqzClean( filter_t * );
 
 static int PresetCallback ( vlc_object_t *, char const *, vlc_value_t,
@@ -191,9 +219,8 @@ static void Close( vlc_object_t *p_this )
  *****************************************************************************/
 static block_t * DoWork( filter_t * p_filter, block_t * p_in_buf )
 {
-    EqzFilter( p_filter, (float*)p_in_buf->p_buffer,
-               (float*)p_in_buf->p_buffer, p_in_buf->i_nb_samples,
-               aout_FormatNbChannels( &p_filter->fmt_in.audio ) );
+    EqzFilter( p_filter->p_sys, (float*)p_in_buf->p_buffer,
+               p_in_buf->i_nb_samples );
     return p_in_buf;
 }
 
@@ -281,7 +308,7 @@ static int EqzInit( filter_t *p_filter, int i_rate )
 {
     filter_sys_t *p_sys = p_filter->p_sys;
     eqz_config_t cfg;
-    int i, ch;
+    int i;
     vlc_value_t val1, val2, val3;
     vlc_object_t *p_aout = p_filter->obj.parent;
     int i_ret = VLC_ENOMEM;
@@ -317,20 +344,11 @@ static int EqzInit( filter_t *p_filter, int i_rate )
     }
 
     /* Filter state */
-    for( ch = 0; ch < 32; ch++ )
+    if( EqzInitState( p_sys, aout_FormatNbChannels( &p_filter->fmt_in.audio ),
+                      true ) )
     {
-        p_sys->x[ch][0]  =
-        p_sys->x[ch][1]  =
-        p_sys->x2[ch][0] =
-        p_sys->x2[ch][1] = 0.0f;
-
-        for( i = 0; i < p_sys->i_band; i++ )
-        {
-            p_sys->y[ch][i][0]  =
-            p_sys->y[ch][i][1]  =
-            p_sys->y2[ch][i][0] =
-            p_sys->y2[ch][i][1] = 0.0f;
-        }
+        free( p_sys->f_amp );
+        goto error;
     }
 
     var_Create( p_aout, "equalizer-bands", VLC_VAR_STRING | VLC_VAR_DOINHERIT );
@@ -358,6 +376,8 @@ static int EqzInit( filter_t *p_filter, int i_rate )
         msg_Err(p_filter, "No preset selected");
         free( val2.psz_string );
         free( p_sys->f_amp );
+        free( p_sys->p_work );
+        free( p_sys->p_state );
         i_ret = VLC_EGENERIC;
         goto error;
     }
@@ -386,65 +406,344 @@ error:
     return i_ret;
 }
 
-static void EqzFilter( filter_t *p_filter, float *out, float *in,
-                       int i_samples, int i_channels )
+/*****************************************************************************
+ * Kernels: one pass of the bands, over all the lanes
+ *****************************************************************************
+ * Each frame goes through all the bands, and is replaced with the source PCM
+ * plus the filtered PCM, times gain. The feedback of y[n-1] comes last, to
+ * keep the recursions short.
+ *****************************************************************************/
+static void EqzBankC( const filter_sys_t *p_sys, float *buf, unsigned frames,
+                      float *state, float gain )
 {
-    filter_sys_t *p_sys = p_filter->p_sys;
-    int i, ch, j;
+    const unsigned lanes = p_sys->i_lanes;
+    const int bands = p_sys->i_band;
 
-    vlc_mutex_lock( &p_sys->lock );
-    for( i = 0; i < i_samples; i++ )
+    for( unsigned l = 0; l < lanes; l++ )
     {
-        for( ch = 0; ch < i_channels; ch++ )
+        float x1 = state[l], x2 = state[lanes + l];
+        float y[EQZ_BANDS_MAX][2];
+        float *p = buf + l;
+
+        for( int j = 0; j < bands; j++ )
+        {
+            y[j][0] = state[(2 + 2 * j) * lanes + l];
+            y[j][1] = state[(3 + 2 * j) * lanes + l];
+        }
+
+        for( unsigned i = 0; i < frames; i++, p += lanes )
         {
-            const float x = in[ch];
+            const float x = *p;
+            const float d = x - x2;
             float o = 0.0f;
 
-            for( j = 0; j < p_sys->i_band; j++ )
+            for( int j = 0; j < bands; j++ )
             {
-                float y = p_sys->f_alpha[j] * ( x - p_sys->x[ch][1] ) +
-                          p_sys->f_gamma[j] * p_sys->y[ch][j][0] -
-                          p_sys->f_beta[j]  * p_sys->y[ch][j][1];
+                const float v = p_sys->f_alpha[j] * d
+                              - p_sys->f_beta[j]  * y[j][1]
+                              + p_sys->f_gamma[j] * y[j][0];
+                y[j][1] = y[j][0];
+                y[j][0] = v;
+                o += v * p_sys->f_amp[j];
+            }
+            x2 = x1;
+            x1 = x;
 
-                p_sys->y[ch][j][1] = p_sys->y[ch][j][0];
-                p_sys->y[ch][j][0] = y;
+            /* We add source PCM + filtered PCM */
+            *p = gain * ( EQZ_IN_FACTOR * x + o );
+        }
+
+        state[l] = x1;
+        state[lanes + l] = x2;
+        for( int j = 0; j < bands; j++ )
+        {
+            state[(2 + 2 * j) * lanes + l] = y[j][0];
+            state[(3 + 2 * j) * lanes + l] = y[j][1];
+        }
+    }
+}
+
+#ifdef HAVE_SSE2_INTRINSICS
+VLC_SSE
+static void EqzBankSSE( const filter_sys_t *p_sys, float *buf,
+                        unsigned frames, float *state, float gain )
+{
+    const unsigned lanes = p_sys->i_lanes;
+    const int bands = p_sys->i_band;
+    const __m128 in_factor = _mm_set1_ps( EQZ_IN_FACTOR );
+    const __m128 g = _mm_set1_ps( gain );
+    __m128 c[EQZ_BANDS_MAX][4];
+
+    for( int j = 0; j < bands; j++ )
+    {
+        c[j][0] = _mm_set1_ps( p_sys->f_alpha[j] );
+        c[j][1] = _mm_set1_ps( p_sys->f_beta[j] );
+        c[j][2] = _mm_set1_ps( p_sys->f_gamma[j] );
+        c[j][3] = _mm_set1_ps( p_sys->f_amp[j] );
+    }
+
+    for( unsigned l = 0; l < lanes; l += 4 )
+    {
+        __m128 x1 = _mm_loadu_ps( state + l );
+        __m128 x2 = _mm_loadu_ps( state + lanes + l );
+        __m128 y[EQZ_BANDS_MAX][2];
+        float *p = buf + l;
+
+        for( int j = 0; j < bands; j++ )
+        {
+            y[j][0] = _mm_loadu_ps( state + (2 + 2 * j) * lanes + l );
+            y[j][1] = _mm_loadu_ps( state + (3 + 2 * j) * lanes + l );
+        }
+
+        for( unsigned i = 0; i < frames; i++, p += lanes )
+        {
+            const __m128 x = _mm_loadu_ps( p );
+            const __m128 d = _mm_sub_ps( x, x2 );
+            __m128 o = _mm_setzero_ps();
 
-                o += y * p_sys->f_amp[j];
+            for( int j = 0; j < bands; j++ )
+            {
+                __m128 v = _mm_sub_ps( _mm_mul_ps( c[j][0], d ),
+                                       _mm_mul_ps( c[j][1], y[j][1] ) );
+                v = _mm_add_ps( v, _mm_mul_ps( c[j][2], y[j][0] ) );
+                y[j][1] = y[j][0];
+                y[j][0] = v;
+                o = _mm_add_ps( o, _mm_mul_ps( v, c[j][3] ) );
             }
-            p_sys->x[ch][1] = p_sys->x[ch][0];
-            p_sys->x[ch][0] = x;
+            x2 = x1;
+            x1 = x;
+
+            o = _mm_add_ps( _mm_mul_ps( in_factor, x ), o );
+            _mm_storeu_ps( p, _mm_mul_ps( g, o ) );
+        }
 
-            /* Second filter */
-            if( p_sys->b_2eqz )
+        _mm_storeu_ps( state + l, x1 );
+        _mm_storeu_ps( state + lanes + l, x2 );
+        for( int j = 0; j < bands; j++ )
+        {
+            _mm_storeu_ps( state + (2 + 2 * j) * lanes + l, y[j][0] );
+            _mm_storeu_ps( state + (3 + 2 * j) * lanes + l, y[j][1] );
+        }
+    }
+}
+#endif
+
+#ifdef HAVE_AVX2_INTRINSICS
+__attribute__ ((__target__ ("avx2")))
+static void EqzBankAVX2( const filter_sys_t *p_sys, float *buf,
+                         unsigned frames, float *state, float gain )
+{
+    const unsigned lanes = p_sys->i_lanes;
+    const int bands = p_sys->i_band;
+    const __m256 in_factor = _mm256_set1_ps( EQZ_IN_FACTOR );
+    const __m256 g = _mm256_set1_ps( gain );
+    __m256 c[EQZ_BANDS_MAX][4];
+
+    for( int j = 0; j < bands; j++ )
+    {
+        c[j][0] = _mm256_set1_ps( p_sys->f_alpha[j] );
+        c[j][1] = _mm256_set1_ps( p_sys->f_beta[j] );
+        c[j][2] = _mm256_set1_ps( p_sys->f_gamma[j] );
+        c[j][3] = _mm256_set1_ps( p_sys->f_amp[j] );
+    }
+
+    for( unsigned l = 0; l < lanes; l += 8 )
+    {
+        __m256 x1 = _mm256_loadu_ps( state + l );
+        __m256 x2 = _mm256_loadu_ps( state + lanes + l );
+        __m256 y[EQZ_BANDS_MAX][2];
+        float *p = buf + l;
+
+        for( int j = 0; j < bands; j++ )
+        {
+            y[j][0] = _mm256_loadu_ps( state + (2 + 2 * j) * lanes + l );
+            y[j][1] = _mm256_loadu_ps( state + (3 + 2 * j) * lanes + l );
+        }
+
+        for( unsigned i = 0; i < frames; i++, p += lanes )
+        {
+            const __m256 x = _mm256_loadu_ps( p );
+            const __m256 d = _mm256_sub_ps( x, x2 );
+            __m256 o = _mm256_setzero_ps();
+
+            for( int j = 0; j < bands; j++ )
             {
-                const float x2 = EQZ_IN_FACTOR * x + o;
-                o = 0.0f;
-                for( j = 0; j < p_sys->i_band; j++ )
-                {
-                    float y = p_sys->f_alpha[j] * ( x2 - p_sys->x2[ch][1] ) +
-                              p_sys->f_gamma[j] * p_sys->y2[ch][j][0] -
-                              p_sys->f_beta[j]  * p_sys->y2[ch][j][1];
-
-                    p_sys->y2[ch][j][1] = p_sys->y2[ch][j][0];
-                    p_sys->y2[ch][j][0] = y;
-
-                    o += y * p_sys->f_amp[j];
-                }
-                p_sys->x2[ch][1] = p_sys->x2[ch][0];
-                p_sys->x2[ch][0] = x2;
-
-                /* We add source PCM + filtered PCM */
-                out[ch] = p_sys->f_gamp * p_sys->f_gamp *( EQZ_IN_FACTOR * x2 + o );
+                __m256 v = _mm256_mul_ps( c[j][0], d );
+                v = _mm256_sub_ps( v, _mm256_mul_ps( c[j][1], y[j][1] ) );
+                v = _mm256_add_ps( v, _mm256_mul_ps( c[j][2], y[j][0] ) );
+                y[j][1] = y[j][0];
+                y[j][0] = v;
+                o = _mm256_add_ps( o, _mm256_mul_ps( v, c[j][3] ) );
             }
-            else
+            x2 = x1;
+            x1 = x;
+
+            o = _mm256_add_ps( _mm256_mul_ps( in_factor, x ), o );
+            _mm256_storeu_ps( p, _mm256_mul_ps( g, o ) );
+        }
+
+        _mm256_storeu_ps( state + l, x1 );
+        _mm256_storeu_ps( state + lanes + l, x2 );
+        for( int j = 0; j < bands; j++ )
+        {
+            _mm256_storeu_ps( state + (2 + 2 * j) * lanes + l, y[j][0] );
+            _mm256_storeu_ps( state + (3 + 2 * j) * lanes + l, y[j][1] );
+        }
+    }
+}
+#endif
+
+#ifdef EQUALIZER_NEON
+static void EqzBankNEON( const filter_sys_t *p_sys, float *buf,
+                         unsigned frames, float *state, float gain )
+{
+    const unsigned lanes = p_sys->i_lanes;
+    const int bands = p_sys->i_band;
+
+    for( unsigned l = 0; l < lanes; l += 4 )
+    {
+        float32x4_t x1 = vld1q_f32( state + l );
+        float32x4_t x2 = vld1q_f32( state + lanes + l );
+        float32x4_t y[EQZ_BANDS_MAX][2];
+        float *p = buf + l;
+
+        for( int j = 0; j < bands; j++ )
+        {
+            y[j][0] = vld1q_f32( state + (2 + 2 * j) * lanes + l );
+            y[j][1] = vld1q_f32( state + (3 + 2 * j) * lanes + l );
+        }
+
+        for( unsigned i = 0; i < frames; i++, p += lanes )
+        {
+            const float32x4_t x = vld1q_f32( p );
+            const float32x4_t d = vsubq_f32( x, x2 );
+            float32x4_t o = vdupq_n_f32( 0.0f );
+
+            for( int j = 0; j < bands; j++ )
             {
-                /* We add source PCM + filtered PCM */
-                out[ch] = p_sys->f_gamp *( EQZ_IN_FACTOR * x + o );
+                float32x4_t v = vmulq_n_f32( d, p_sys->f_alpha[j] );
+                v = vmlsq_n_f32( v, y[j][1], p_sys->f_beta[j] );
+                v = vmlaq_n_f32( v, y[j][0], p_sys->f_gamma[j] );
+                y[j][1] = y[j][0];
+                y[j][0] = v;
+                o = vmlaq_n_f32( o, v, p_sys->f_amp[j] );
             }
+            x2 = x1;
+            x1 = x;
+
+            o = vmlaq_n_f32( o, x, EQZ_IN_FACTOR );
+            vst1q_f32( p, vmulq_n_f32( o, gain ) );
+        }
+
+        vst1q_f32( state + l, x1 );
+        vst1q_f32( state + lanes + l, x2 );
+        for( int j = 0; j < bands; j++ )
+        {
+            vst1q_f32( state + (2 + 2 * j) * lanes + l, y[j][0] );
+            vst1q_f32( state + (3 + 2 * j) * lanes + l, y[j][1] );
+        }
+    }
+}
+#endif
+
+/* Picks the kernel, and the number of lanes it needs */
+static void EqzInitKernels( filter_sys_t *p_sys, bool b_optimized )
+{
+    const unsigned i_channels = p_sys->i_channels;
+
+    p_sys->pf_bank = EqzBankC;
+    p_sys->i_lanes = i_channels;
+
+    /* A single channel fills no vector */
+    if( !b_optimized || i_channels < 2 )
+        return;
+#ifdef HAVE_SSE2_INTRINSICS
+    if( vlc_CPU_SSE() )
+    {
+        p_sys->pf_bank = EqzBankSSE;
+        p_sys->i_lanes = ( i_channels + 3 ) & ~3;
+    }
+#endif
+#ifdef HAVE_AVX2_INTRINSICS
+    if( vlc_CPU_AVX2() && i_channels > 4 )
+    {
+        p_sys->pf_bank = EqzBankAVX2;
+        p_sys->i_lanes = ( i_channels + 7 ) & ~7;
+    }
+#endif
+#ifdef EQUALIZER_NEON
+    p_sys->pf_bank = EqzBankNEON;
+    p_sys->i_lanes = ( i_channels + 3 ) & ~3;
+#endif
+}
+
+/* Allocates the state of both passes and the work buffer of the kernels */
+static int EqzInitState( filter_sys_t *p_sys, unsigned i_channels,
+                         bool b_optimized )
+{
+    p_sys->i_channels = i_channels;
+    EqzInitKernels( p_sys, b_optimized );
+
+    const size_t i_size = ( 2 + 2 * p_sys->i_band ) * p_sys->i_lanes;
+
+    p_sys->p_work = NULL;
+    p_sys->p_state = calloc( 2 * i_size, sizeof(float) );
+    if( !p_sys->p_state )
+        return VLC_ENOMEM;
+    p_sys->p_state2 = p_sys->p_state + i_size;
+
+    if( p_sys->i_lanes != i_channels )
+    {
+        /* The padding lanes stay zero */
+        p_sys->p_work = calloc( EQZ_WORK_FRAMES * p_sys->i_lanes,
+                                sizeof(float) );
+        if( !p_sys->p_work )
+        {
+            free( p_sys->p_state );
+            return VLC_ENOMEM;
+        }
+    }
+    return VLC_SUCCESS;
+}
+
+/* Filters interleaved samples in place, EQZ_WORK_FRAMES frames at a time:
+ * each chunk goes through both passes while it is in the cache, and is only
+ * copied to padded lanes and back if the channels do not fill the vectors. */
+static void EqzFilter( filter_sys_t *p_sys, float *buf, unsigned i_samples )
+{
+    const unsigned channels = p_sys->i_channels;
+    const unsigned lanes = p_sys->i_lanes;
+
+    vlc_mutex_lock( &p_sys->lock );
+    for( unsigned i = 0; i < i_samples; i += EQZ_WORK_FRAMES )
+    {
+        const unsigned frames = __MIN( EQZ_WORK_FRAMES, i_samples - i );
+        float *in = buf + i * channels;
+        float *work = in;
+
+        if( lanes != channels )
+        {
+            work = p_sys->p_work;
+            for( unsigned j = 0; j < frames; j++ )
+                memcpy( work + j * lanes, in + j * channels,
+                        channels * sizeof(float) );
+        }
+
+        if( p_sys->b_2eqz )
+        {
+            /* Second filter, on the output of the first one */
+            p_sys->pf_bank( p_sys, work, frames, p_sys->p_state, 1.0f );
+            p_sys->pf_bank( p_sys, work, frames, p_sys->p_state2,
+                            p_sys->f_gamp * p_sys->f_gamp );
         }
+        else
+            p_sys->pf_bank( p_sys, work, frames, p_sys->p_state,
+                            p_sys->f_gamp );
 
-        in  += i_channels;
-        out += i_channels;
+        if( lanes != channels )
+            for( unsigned j = 0; j < frames; j++ )
+                memcpy( in + j * channels, work + j * lanes,
+                        channels * sizeof(float) );
     }
     vlc_mutex_unlock( &p_sys->lock );
 }
@@ -464,6 +763,8 @@ static void EqzClean( filter_t *p_filter )
     free( p_sys->f_gamma );
 
     free( p_sys->f_amp );
+    free( p_sys->p_work );
+    free( p_sys->p_state );
 }
 
 
@@ -575,3 +876,178 @@ static int TwoPassCallback( vlc_object_t *p_this, char const *psz_cmd,
     return VLC_SUCCESS;
 }
 
+
+#ifdef EQUALIZER_TEST
+#include <stdio.h>
+#include <unistd.h>
+
+/* Comparison of the kernels with the plain C code, and of the gain of a band
+ * with its setting, then speed of the filter on request */
+
+static const unsigned channels[] = { 1, 2, 3, 6, 8, 9, 16 };
+
+static void Setup( filter_sys_t *p_sys, unsigned i_channels, bool b_2eqz,
+                   bool b_optimized )
+{
+    const eqz_preset_t *preset = &eqz_preset_10b[13]; /* rock */
+    eqz_config_t cfg;
+
+    memset( p_sys, 0, sizeof (*p_sys) );
+    EqzCoeffs( 48000, 1.0f, true, &cfg );
+    p_sys->i_band = cfg.i_band;
+    p_sys->f_alpha = vlc_alloc( p_sys->i_band, sizeof(float) );
+    p_sys->f_beta  = vlc_alloc( p_sys->i_band, sizeof(float) );
+    p_sys->f_gamma = vlc_alloc( p_sys->i_band, sizeof(float) );
+    p_sys->f_amp   = vlc_alloc( p_sys->i_band, sizeof(float) );
+    assert( p_sys->f_alpha && p_sys->f_beta && p_sys->f_gamma
+         && p_sys->f_amp );
+    for( int i = 0; i < p_sys->i_band; i++ )
+    {
+        p_sys->f_alpha[i] = cfg.band[i].f_alpha;
+        p_sys->f_beta[i]  = cfg.band[i].f_beta;
+        p_sys->f_gamma[i] = cfg.band[i].f_gamma;
+        p_sys->f_amp[i]   = EqzConvertdB( preset->f_amp[i] );
+    }
+    p_sys->f_gamp = powf( 10.f, preset->f_preamp / 20.f );
+    p_sys->b_2eqz = b_2eqz;
+    vlc_mutex_init( &p_sys->lock );
+    assert( EqzInitState( p_sys, i_channels, b_optimized ) == VLC_SUCCESS );
+}
+
+static void Clean( filter_sys_t *p_sys )
+{
+    vlc_mutex_destroy( &p_sys->lock );
+    free( p_sys->f_alpha );
+    free( p_sys->f_beta );
+    free( p_sys->f_gamma );
+    free( p_sys->f_amp );
+    free( p_sys->p_work );
+    free( p_sys->p_state );
+}
+
+static float *Noise( size_t samples )
+{
+    float *buf = vlc_alloc( samples, sizeof (float) );
+    assert( buf != NULL );
+
+    uint32_t seed = 0x5eed;
+    for( size_t i = 0; i < samples; i++ )
+    {
+        seed = seed * 1664525 + 1013904223;
+        buf[i] = (int32_t)seed / 2147483648.f;
+    }
+    return buf;
+}
+
+/* Level of a sine at the center frequency of the 1 kHz band, boosted alone */
+static int TestGain( void )
+{
+    const size_t frames = 48000;
+    filter_sys_t sys;
+    float *buf = vlc_alloc( frames, sizeof (float) );
+    assert( buf != NULL );
+
+    Setup( &sys, 1, false, false );
+    for( int i = 0; i < sys.i_band; i++ )
+        sys.f_amp[i] = EqzConvertdB( i == 4 ? 6.f : 0.f );
+    sys.f_gamp = 1.f;
+
+    for( size_t i = 0; i < frames; i++ )
+        buf[i] = sinf( 2 * (float)M_PI * 1000 * i / 48000 );
+    EqzFilter( &sys, buf, frames );
+
+    double sum = 0;
+    for( size_t i = frames / 2; i < frames; i++ )
+        sum += (double)buf[i] * buf[i];
+    /* relative to the source PCM, scaled by EQZ_IN_FACTOR */
+    double db = 10. * log10( sum / ( frames / 2 ) * 2. )
+              - 20. * log10( EQZ_IN_FACTOR );
+    Clean( &sys );
+    free( buf );
+
+    if( fabs( db - 6. ) > .1 )
+    {
+        fprintf( stderr, "gain at 1 kHz: %.2f dB instead of 6 dB\n", db );
+        return 1;
+    }
+    return 0;
+}
+
+/* Runs both filters over the same noise, and prints their speed if asked */
+static int Compare( size_t frames, bool b_bench )
+{
+    int errors = 0;
+
+    for( size_t c = 0; c < ARRAY_SIZE(channels); c++ )
+    for( int pass = 1; pass <= 2; pass++ )
+    {
+        const unsigned ch = channels[c];
+        const size_t samples = frames * ch;
+        filter_sys_t ref, opt;
+        mtime_t times[2] = { 0, 0 };
+
+        Setup( &ref, ch, pass == 2, false );
+        Setup( &opt, ch, pass == 2, true );
+
+        float *in = Noise( samples );
+        float *out[2];
+        for( int k = 0; k < 2; k++ )
+        {
+            out[k] = vlc_alloc( samples, sizeof (float) );
+            assert( out[k] != NULL );
+            memcpy( out[k], in, samples * sizeof (float) );
+        }
+
+        /* Blocks of varying sizes, as from the audio output */
+        for( int k = 0; k < 2; k++ )
+        {
+            mtime_t start = mdate();
+            for( size_t i = 0, n = 1; i < frames; i += n, n = n * 2 + 1 )
+            {
+                n = __MIN( n, frames - i );
+                EqzFilter( k ? &opt : &ref, out[k] + i * ch, n );
+            }
+            times[k] = mdate() - start;
+        }
+
+        double max = 0, err = 0;
+        for( size_t i = 0; i < samples; i++ )
+        {
+            max = __MAX( max, fabs( out[0][i] ) );
+            err = __MAX( err, fabs( (double)out[0][i] - out[1][i] ) );
+        }
+        if( err > max * 1e-5 )
+        {
+            fprintf( stderr, "%u channels, %d pass: relative error %g\n", ch,
+                     pass, err / max );
+            errors++;
+        }
+
+        if( b_bench )
+            printf( "%2u channels, %d pass: C %.2f, optimized %.2f "
+                    "ns/sample/channel\n", ch, pass,
+                    times[0] * 1000. / samples, times[1] * 1000. / samples );
+
+        for( int k = 0; k < 2; k++ )
+            free( out[k] );
+        free( in );
+        Clean( &opt );
+        Clean( &ref );
+    }
+    return errors;
+}
+
+int main( int argc, char *argv[] )
+{
+    int errors = 0;
+
+    alarm( 120 );
+    errors += TestGain();
+    errors += Compare( 48000, false );
+    /* equalizer_test <seconds>: also benchmarks that much audio */
+    if( argc > 1 )
+        errors += Compare( 48000 * (size_t)atoi( argv[1] ), true );
+
+    return errors ? 1 : 0;
+}
+#endif
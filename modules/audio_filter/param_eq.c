@@ -30,12 +30,29 @@
 # include "config.h"
 #endif
 
+#ifdef PARAM_EQ_TEST
+# undef NDEBUG
+#endif
+
+#include <assert.h>
 #include <math.h>
 
 #include <vlc_common.h>
 #include <vlc_plugin.h>
 #include <vlc_aout.h>
 #include <vlc_filter.h>
+#include <vlc_cpu.h>
+
+#ifdef HAVE_SSE2_INTRINSICS
+# include <xmmintrin.h>
+#endif
+#ifdef HAVE_AVX2_INTRINSICS
+# include <immintrin.h>
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+# include <arm_neon.h>
+# define PARAM_EQ_NEON 1
+#endif
 
 /*****************************************************************************
  * Module descriptor
@@ -44,8 +61,6 @@ static int  Open ( vlc_object_t * );
 static void Close( vlc_object_t * );
 static void CalcPeakEQCoeffs( float, float, float, float, float * );
 static void CalcShelfEQCoeffs( float, float, float, int, float, float * );
-static void ProcessEQ( const float *, float *, float *, unsigned, unsigned,
-                       const float *, unsigned );
 static block_t *DoWork( filter_t *, block_t * );
 
 vlc_module_begin ()
@@ -83,6 +98,10 @@ vlc_module_end ()
 /*****************************************************************************
  * Local prototypes
  *****************************************************************************/
+/* Frames filtered at once through all the stages, so that they stay in the
+ * data cache */
+#define WORK_FRAMES 256
+
 struct filter_sys_t
 {
     /* Filter static config */
@@ -91,14 +110,316 @@ struct filter_sys_t
     float   f_f2, f_Q2, f_gain2;
     float   f_f3, f_Q3, f_gain3;
     float   f_highf, f_highgain;
-    /* Filter computed coeffs */
+    /* Filter computed coeffs, of the stages with a non-zero gain only */
     float   coeffs[5*5];
-    /* State */
+    unsigned i_stages;
+    /* Samples are filtered frame by frame in lanes, one per channel, padded
+     * to the width of the kernel */
+    unsigned i_channels;
+    unsigned i_lanes;
+    float  *p_work;     /* WORK_FRAMES frames, if there is padding */
+    /* State, 4 values of each lane per stage */
     float  *p_state;
+    void  (*pf_cascade)( float *, unsigned, unsigned, float *, const float *,
+                         unsigned );
 };
 
+/*****************************************************************************
+ * Kernels: the direct form 1 IIR stages, over all the lanes
+ *****************************************************************************
+ * buf holds frames of lanes samples, state x[n-1], x[n-2], y[n-1] and
+ * y[n-2] of each lane per stage, and coeffs b0, b1, b2, a1 and a2 per stage.
+ * Each frame goes through all the stages in turn, so that the recursions of
+ * the stages overlap in the pipeline of the CPU. The feedback of y[n-1]
+ * comes last, to keep the recursions short.
+ *****************************************************************************/
+static void CascadeC( float *buf, unsigned frames, unsigned lanes,
+                      float *state, const float *coeffs, unsigned stages )
+{
+    for( unsigned l = 0; l < lanes; l++ )
+    {
+        float s[5][4];
+        float *p = buf + l;
+
+        for( unsigned eq = 0; eq < stages; eq++ )
+            for( unsigned k = 0; k < 4; k++ )
+                s[eq][k] = state[(eq * 4 + k) * lanes + l];
+
+        for( unsigned i = 0; i < frames; i++, p += lanes )
+        {
+            float x = *p;
+            for( unsigned eq = 0; eq < stages; eq++ )
+            {
+                const float *c = coeffs + eq * 5;
+                const float y = x*c[0] + s[eq][0]*c[1] + s[eq][1]*c[2]
+                              - s[eq][3]*c[4] - s[eq][2]*c[3];
+                s[eq][1] = s[eq][0];
+                s[eq][0] = x;
+                s[eq][3] = s[eq][2];
+                s[eq][2] = y;
+                x = y;
+            }
+            *p = x;
+        }
+
+        for( unsigned eq = 0; eq < stages; eq++ )
+            for( unsigned k = 0; k < 4; k++ )
+                state[(eq * 4 + k) * lanes + l] = s[eq][k];
+    }
+}
+
+#ifdef HAVE_SSE2_INTRINSICS
+VLC_SSE
+static void CascadeSSE( float *buf, unsigned frames, unsigned lanes,
+                        float *state, const float *coeffs, unsigned stages )
+{
+    __m128 c[5][5];
+
+    for( unsigned eq = 0; eq < stages; eq++ )
+        for( unsigned k = 0; k < 5; k++ )
+            c[eq][k] = _mm_set1_ps( coeffs[eq * 5 + k] );
+
+    for( unsigned l = 0; l < lanes; l += 4 )
+    {
+        __m128 s[5][4];
+        float *p = buf + l;
+
+        for( unsigned eq = 0; eq < stages; eq++ )
+            for( unsigned k = 0; k < 4; k++ )
+                s[eq][k] = _mm_loadu_ps( state + (eq * 4 + k) * lanes + l );
+
+        for( unsigned i = 0; i < frames; i++, p += lanes )
+        {
+            __m128 x = _mm_loadu_ps( p );
+            for( unsigned eq = 0; eq < stages; eq++ )
+            {
+                __m128 y = _mm_add_ps( _mm_mul_ps( x, c[eq][0] ),
+                                       _mm_mul_ps( s[eq][0], c[eq][1] ) );
+                y = _mm_add_ps( y, _mm_mul_ps( s[eq][1], c[eq][2] ) );
+                y = _mm_sub_ps( y, _mm_mul_ps( s[eq][3], c[eq][4] ) );
+                y = _mm_sub_ps( y, _mm_mul_ps( s[eq][2], c[eq][3] ) );
+                s[eq][1] = s[eq][0];
+                s[eq][0] = x;
+                s[eq][3] = s[eq][2];
+                s[eq][2] = y;
+                x = y;
+            }
+            _mm_storeu_ps( p, x );
+        }
+
+        for( unsigned eq = 0; eq < stages; eq++ )
+            for( unsigned k = 0; k < 4; k++ )
+                _mm_storeu_ps( state + (eq * 4 + k) * lanes + l, s[eq][k] );
+    }
+}
+#endif
+
+#ifdef HAVE_AVX2_INTRINSICS
+__attribute__ ((__target__ ("avx2")))
+static void CascadeAVX2( float *buf, unsigned frames, unsigned lanes,
+                         float *state, const float *coeffs, unsigned stages )
+{
+    __m256 c[5][5];
+
+    for( unsigned eq = 0; eq < stages; eq++ )
+        for( unsigned k = 0; k < 5; k++ )
+            c[eq][k] = _mm256_set1_ps( coeffs[eq * 5 + k] );
 
+    for( unsigned l = 0; l < lanes; l += 8 )
+    {
+        __m256 s[5][4];
+        float *p = buf + l;
+
+        for( unsigned eq = 0; eq < stages; eq++ )
+            for( unsigned k = 0; k < 4; k++ )
+                s[eq][k] = _mm256_loadu_ps( state + (eq * 4 + k) * lanes + l );
 
+        for( unsigned i = 0; i < frames; i++, p += lanes )
+        {
+            __m256 x = _mm256_loadu_ps( p );
+            for( unsigned eq = 0; eq < stages; eq++ )
+            {
+                __m256 y = _mm256_add_ps( _mm256_mul_ps( x, c[eq][0] ),
+                                          _mm256_mul_ps( s[eq][0], c[eq][1] ) );
+                y = _mm256_add_ps( y, _mm256_mul_ps( s[eq][1], c[eq][2] ) );
+                y = _mm256_sub_ps( y, _mm256_mul_ps( s[eq][3], c[eq][4] ) );
+                y = _mm256_sub_ps( y, _mm256_mul_ps( s[eq][2], c[eq][3] ) );
+                s[eq][1] = s[eq][0];
+                s[eq][0] = x;
+                s[eq][3] = s[eq][2];
+                s[eq][2] = y;
+                x = y;
+            }
+            _mm256_storeu_ps( p, x );
+        }
+
+        for( unsigned eq = 0; eq < stages; eq++ )
+            for( unsigned k = 0; k < 4; k++ )
+                _mm256_storeu_ps( state + (eq * 4 + k) * lanes + l, s[eq][k] );
+    }
+}
+#endif
+
+#ifdef PARAM_EQ_NEON
+static void CascadeNEON( float *buf, unsigned frames, unsigned lanes,
+                         float *state, const float *coeffs, unsigned stages )
+{
+    for( unsigned l = 0; l < lanes; l += 4 )
+    {
+        float32x4_t s[5][4];
+        float *p = buf + l;
+
+        for( unsigned eq = 0; eq < stages; eq++ )
+            for( unsigned k = 0; k < 4; k++ )
+                s[eq][k] = vld1q_f32( state + (eq * 4 + k) * lanes + l );
+
+        for( unsigned i = 0; i < frames; i++, p += lanes )
+        {
+            float32x4_t x = vld1q_f32( p );
+            for( unsigned eq = 0; eq < stages; eq++ )
+            {
+                const float *c = coeffs + eq * 5;
+                float32x4_t y = vmulq_n_f32( x, c[0] );
+                y = vmlaq_n_f32( y, s[eq][0], c[1] );
+                y = vmlaq_n_f32( y, s[eq][1], c[2] );
+                y = vmlsq_n_f32( y, s[eq][3], c[4] );
+                y = vmlsq_n_f32( y, s[eq][2], c[3] );
+                s[eq][1] = s[eq][0];
+                s[eq][0] = x;
+                s[eq][3] = s[eq][2];
+                s[eq][2] = y;
+                x = y;
+            }
+            vst1q_f32( p, x );
+        }
+
+        for( unsigned eq = 0; eq < stages; eq++ )
+            for( unsigned k = 0; k < 4; k++ )
+                vst1q_f32( state + (eq * 4 + k) * lanes + l, s[eq][k] );
+    }
+}
+#endif
+
+/* Picks the kernel, and the number of lanes it needs */
+static void InitKernels( filter_sys_t *p_sys, bool b_optimized )
+{
+    const unsigned i_channels = p_sys->i_channels;
+
+    p_sys->pf_cascade = CascadeC;
+    p_sys->i_lanes = i_channels;
+
+    /* A single channel fills no vector */
+    if( !b_optimized || i_channels < 2 )
+        return;
+#ifdef HAVE_SSE2_INTRINSICS
+    if( vlc_CPU_SSE() )
+    {
+        p_sys->pf_cascade = CascadeSSE;
+        p_sys->i_lanes = ( i_channels + 3 ) & ~3;
+    }
+#endif
+#ifdef HAVE_AVX2_INTRINSICS
+    if( vlc_CPU_AVX2() && i_channels > 4 )
+    {
+        p_sys->pf_cascade = CascadeAVX2;
+        p_sys->i_lanes = ( i_channels + 7 ) & ~7;
+    }
+#endif
+#ifdef PARAM_EQ_NEON
+    p_sys->pf_cascade = CascadeNEON;
+    p_sys->i_lanes = ( i_channels + 3 ) & ~3;
+#endif
+}
+
+/* Allocates the state and work buffers of the kernels */
+static int InitState( filter_sys_t *p_sys, unsigned i_channels,
+                      bool b_optimized )
+{
+    p_sys->i_channels = i_channels;
+    InitKernels( p_sys, b_optimized );
+
+    p_sys->p_work = NULL;
+    p_sys->p_state = calloc( p_sys->i_lanes * 5 * 4, sizeof(float) );
+    if( p_sys->i_lanes != i_channels )
+    {
+        /* The padding lanes stay zero */
+        p_sys->p_work = calloc( WORK_FRAMES * p_sys->i_lanes, sizeof(float) );
+        if( !p_sys->p_work )
+        {
+            free( p_sys->p_state );
+            return VLC_ENOMEM;
+        }
+    }
+    return p_sys->p_state ? VLC_SUCCESS : VLC_ENOMEM;
+}
+
+/*
+ * Filters interleaved samples in place, WORK_FRAMES frames at a time: each
+ * chunk goes through all the stages while it is in the cache, and is only
+ * copied to padded lanes and back if the channels do not fill the vectors.
+ */
+static void ProcessEQ( filter_sys_t *p_sys, float *buf, unsigned samples )
+{
+    const unsigned channels = p_sys->i_channels;
+    const unsigned lanes = p_sys->i_lanes;
+
+    if( p_sys->i_stages == 0 )
+        return;
+
+    for( unsigned i = 0; i < samples; i += WORK_FRAMES )
+    {
+        const unsigned frames = __MIN( WORK_FRAMES, samples - i );
+        float *in = buf + i * channels;
+        float *work = in;
+
+        if( lanes != channels )
+        {
+            work = p_sys->p_work;
+            for( unsigned j = 0; j < frames; j++ )
+                memcpy( work + j * lanes, in + j * channels,
+                        channels * sizeof(float) );
+        }
+
+        p_sys->pf_cascade( work, frames, lanes, p_sys->p_state,
+                           p_sys->coeffs, p_sys->i_stages );
+
+        if( lanes != channels )
+            for( unsigned j = 0; j < frames; j++ )
+                memcpy( in + j * channels, work + j * lanes,
+                        channels * sizeof(float) );
+    }
+}
+
+/* Stages with no gain let the signal through as it is */
+static void AddStage( filter_sys_t *p_sys, float gain, const float *coeffs )
+{
+    if( gain == 0.f )
+        return;
+    memcpy( p_sys->coeffs + p_sys->i_stages * 5, coeffs, 5 * sizeof(float) );
+    p_sys->i_stages++;
+}
+
+static void InitCoeffs( filter_sys_t *p_sys, unsigned i_samplerate )
+{
+    float coeffs[5];
+
+    p_sys->i_stages = 0;
+    CalcPeakEQCoeffs(p_sys->f_f1, p_sys->f_Q1, p_sys->f_gain1,
+                     i_samplerate, coeffs);
+    AddStage( p_sys, p_sys->f_gain1, coeffs );
+    CalcPeakEQCoeffs(p_sys->f_f2, p_sys->f_Q2, p_sys->f_gain2,
+                     i_samplerate, coeffs);
+    AddStage( p_sys, p_sys->f_gain2, coeffs );
+    CalcPeakEQCoeffs(p_sys->f_f3, p_sys->f_Q3, p_sys->f_gain3,
+                     i_samplerate, coeffs);
+    AddStage( p_sys, p_sys->f_gain3, coeffs );
+    CalcShelfEQCoeffs(p_sys->f_lowf, 1, p_sys->f_lowgain, 0,
+                      i_samplerate, coeffs);
+    AddStage( p_sys, p_sys->f_lowgain, coeffs );
+    CalcShelfEQCoeffs(p_sys->f_highf, 1, p_sys->f_highgain, 0,
+                      i_samplerate, coeffs);
+    AddStage( p_sys, p_sys->f_highgain, coeffs );
+}
 
 /*****************************************************************************
  * Open:
@@ -106,7 +427,6 @@ struct filter_sys_t
 static int Open( vlc_object_t *p_this )
 {
     filter_t     *p_filter = (filter_t *)p_this;
-    unsigned     i_samplerate;
 
     /* Allocate structure */
     filter_sys_t *p_sys = p_filter->p_sys = malloc( sizeof( *p_sys ) );
@@ -134,20 +454,12 @@ static int Open( vlc_object_t *p_this )
     p_sys->f_Q3 = var_InheritFloat( p_this, "param-eq-q3");
     p_sys->f_gain3 = var_InheritFloat( p_this, "param-eq-gain3");
  
-
-    i_samplerate = p_filter->fmt_in.audio.i_rate;
-    CalcPeakEQCoeffs(p_sys->f_f1, p_sys->f_Q1, p_sys->f_gain1,
-                     i_samplerate, p_sys->coeffs+0*5);
-    CalcPeakEQCoeffs(p_sys->f_f2, p_sys->f_Q2, p_sys->f_gain2,
-                     i_samplerate, p_sys->coeffs+1*5);
-    CalcPeakEQCoeffs(p_sys->f_f3, p_sys->f_Q3, p_sys->f_gain3,
-                     i_samplerate, p_sys->coeffs+2*5);
-    CalcShelfEQCoeffs(p_sys->f_lowf, 1, p_sys->f_lowgain, 0,
-                      i_samplerate, p_sys->coeffs+3*5);
-    CalcShelfEQCoeffs(p_sys->f_highf, 1, p_sys->f_highgain, 0,
-                      i_samplerate, p_sys->coeffs+4*5);
-    p_sys->p_state = (float*)calloc( p_filter->fmt_in.audio.i_channels*5*4,
-                                     sizeof(float) );
+    InitCoeffs( p_sys, p_filter->fmt_in.audio.i_rate );
+    if( InitState( p_sys, p_filter->fmt_in.audio.i_channels, true ) )
+    {
+        free( p_sys );
+        return VLC_ENOMEM;
+    }
 
     return VLC_SUCCESS;
 }
@@ -155,6 +467,7 @@ static int Open( vlc_object_t *p_this )
 static void Close( vlc_object_t *p_this )
 {
     filter_t *p_filter = (filter_t *)p_this;
+    free( p_filter->p_sys->p_work );
     free( p_filter->p_sys->p_state );
     free( p_filter->p_sys );
 }
@@ -166,10 +479,8 @@ static void Close( vlc_object_t *p_this )
  *****************************************************************************/
 static block_t *DoWork( filter_t * p_filter, block_t * p_in_buf )
 {
-    ProcessEQ( (float*)p_in_buf->p_buffer, (float*)p_in_buf->p_buffer,
-               p_filter->p_sys->p_state,
-               p_filter->fmt_in.audio.i_channels, p_in_buf->i_nb_samples,
-               p_filter->p_sys->coeffs, 5 );
+    ProcessEQ( p_filter->p_sys, (float*)p_in_buf->p_buffer,
+               p_in_buf->i_nb_samples );
     return p_in_buf;
 }
 
@@ -274,49 +585,155 @@ static void CalcShelfEQCoeffs( float f0, float slope, float gainDB, int high,
     coeffs[4] = a2/a0;
 }
 
-/*
-  src is assumed to be interleaved
-  dest is assumed to be interleaved
-  size of state is 4*channels*eqCount
-  samples is not premultiplied by channels
-  size of coeffs is 5*eqCount
-*/
-void ProcessEQ( const float *src, float *dest, float *state,
-                unsigned channels, unsigned samples, const float *coeffs,
-                unsigned eqCount )
+#ifdef PARAM_EQ_TEST
+#include <stdio.h>
+#include <unistd.h>
+
+/* Comparison of the kernels with the plain C code, and of the gain of the
+ * filters with their settings, then speed of the whole cascade on request */
+
+static const unsigned channels[] = { 1, 2, 3, 6, 8, 9, 16 };
+
+static void Setup( filter_sys_t *p_sys, unsigned i_channels, float gain,
+                   bool b_optimized )
+{
+    memset( p_sys, 0, sizeof (*p_sys) );
+    p_sys->f_lowf = 100;   p_sys->f_lowgain = gain;
+    p_sys->f_highf = 10000; p_sys->f_highgain = -gain;
+    p_sys->f_f1 = 300;  p_sys->f_Q1 = 3; p_sys->f_gain1 = gain;
+    p_sys->f_f2 = 1000; p_sys->f_Q2 = 3; p_sys->f_gain2 = -gain;
+    p_sys->f_f3 = 3000; p_sys->f_Q3 = 3; p_sys->f_gain3 = gain;
+    InitCoeffs( p_sys, 48000 );
+    assert( InitState( p_sys, i_channels, b_optimized ) == VLC_SUCCESS );
+}
+
+static void Clean( filter_sys_t *p_sys )
+{
+    free( p_sys->p_work );
+    free( p_sys->p_state );
+}
+
+static float *Noise( size_t samples )
+{
+    float *buf = vlc_alloc( samples, sizeof (float) );
+    assert( buf != NULL );
+
+    uint32_t seed = 0x5eed;
+    for( size_t i = 0; i < samples; i++ )
+    {
+        seed = seed * 1664525 + 1013904223;
+        buf[i] = (int32_t)seed / 2147483648.f;
+    }
+    return buf;
+}
+
+/* Level of a sine through a peaking filter, at its center frequency */
+static int TestGain( void )
+{
+    const size_t frames = 48000;
+    filter_sys_t sys;
+    float *buf = vlc_alloc( frames, sizeof (float) );
+    assert( buf != NULL );
+
+    Setup( &sys, 1, 0, false );
+    sys.f_gain2 = 6;
+    InitCoeffs( &sys, 48000 );
+    assert( sys.i_stages == 1 );
+
+    for( size_t i = 0; i < frames; i++ )
+        buf[i] = sinf( 2 * (float)M_PI * 1000 * i / 48000 );
+    ProcessEQ( &sys, buf, frames );
+
+    double sum = 0;
+    for( size_t i = frames / 2; i < frames; i++ )
+        sum += (double)buf[i] * buf[i];
+    double db = 10. * log10( sum / ( frames / 2 ) * 2. );
+    Clean( &sys );
+    free( buf );
+
+    if( fabs( db - 6. ) > .05 )
+    {
+        fprintf( stderr, "gain at 1 kHz: %.2f dB instead of 6 dB\n", db );
+        return 1;
+    }
+    return 0;
+}
+
+/* Runs both cascades over the same noise, and prints their speed if asked */
+static int Compare( size_t frames, bool b_bench )
 {
-    unsigned i, chn, eq;
-    float   b0, b1, b2, a1, a2;
-    float   x, y = 0;
-    const float *src1 = src;
-    float *dest1 = dest;
+    int errors = 0;
 
-    for (i = 0; i < samples; i++)
+    for( size_t c = 0; c < ARRAY_SIZE(channels); c++ )
     {
-        float *state1 = state;
-        for (chn = 0; chn < channels; chn++)
+        const unsigned ch = channels[c];
+        const size_t samples = frames * ch;
+        filter_sys_t ref, opt;
+        mtime_t times[2] = { 0, 0 };
+
+        Setup( &ref, ch, 12, false );
+        Setup( &opt, ch, 12, true );
+        assert( ref.i_stages == 5 );
+
+        float *in = Noise( samples );
+        float *out[2];
+        for( int k = 0; k < 2; k++ )
+        {
+            out[k] = vlc_alloc( samples, sizeof (float) );
+            assert( out[k] != NULL );
+            memcpy( out[k], in, samples * sizeof (float) );
+        }
+
+        /* Blocks of varying sizes, as from the audio output */
+        for( int k = 0; k < 2; k++ )
         {
-            const float *coeffs1 = coeffs;
-            x = *src1++;
-            /* Direct form 1 IIRs */
-            for (eq = 0; eq < eqCount; eq++)
+            mtime_t start = mdate();
+            for( size_t i = 0, n = 1; i < frames; i += n, n = n * 2 + 1 )
             {
-                b0 = coeffs1[0];
-                b1 = coeffs1[1];
-                b2 = coeffs1[2];
-                a1 = coeffs1[3];
-                a2 = coeffs1[4];
-                coeffs1 += 5;
-                y = x*b0 + state1[0]*b1 + state1[1]*b2 - state1[2]*a1 - state1[3]*a2;
-                state1[1] = state1[0];
-                state1[0] = x;
-                state1[3] = state1[2];
-                state1[2] = y;
-                x = y;
-                state1 += 4;
+                n = __MIN( n, frames - i );
+                ProcessEQ( k ? &opt : &ref, out[k] + i * ch, n );
             }
-            *dest1++ = y;
+            times[k] = mdate() - start;
+        }
+
+        double max = 0, err = 0;
+        for( size_t i = 0; i < samples; i++ )
+        {
+            max = __MAX( max, fabs( out[0][i] ) );
+            err = __MAX( err, fabs( (double)out[0][i] - out[1][i] ) );
+        }
+        if( err > max * 1e-5 )
+        {
+            fprintf( stderr, "%u channels: relative error %g\n", ch,
+                     err / max );
+            errors++;
         }
+
+        if( b_bench )
+            printf( "%2u channels, %u stages: C %.2f, optimized %.2f "
+                    "ns/sample/channel\n", ch, ref.i_stages,
+                    times[0] * 1000. / samples, times[1] * 1000. / samples );
+
+        for( int k = 0; k < 2; k++ )
+            free( out[k] );
+        free( in );
+        Clean( &opt );
+        Clean( &ref );
     }
+    return errors;
 }
 
+int main( int argc, char *argv[] )
+{
+    int errors = 0;
+
+    alarm( 120 );
+    errors += TestGain();
+    errors += Compare( 48000, false );
+    /* param_eq_test <seconds>: also benchmarks that much audio */
+    if( argc > 1 )
+        errors += Compare( 48000 * (size_t)atoi( argv[1] ), true );
+
+    return errors ? 1 : 0;
+}
+#endif
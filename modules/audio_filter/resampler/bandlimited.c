@@ -24,12 +24,18 @@
 /*****************************************************************************
  * Preamble:
  *
- * This implementation of the band-limited interpolationis based on the
+ * This implementation of the band-limited interpolation is based on the
  * following paper:
  * http://ccrma-www.stanford.edu/~jos/resample/resample.html
  *
- * It uses a Kaiser-windowed sinc-function low-pass filter and the width of the
- * filter is 13 samples.
+ * It uses a Kaiser-windowed sinc-function low-pass filter, in polyphase
+ * form: the coefficients of the filter are computed once for each output
+ * phase, so that every output sample is a plain inner product.
+ *  - When the ratio of the rates reduces to few enough phases, there is one
+ *    set of coefficients per phase (an "exact" bank).
+ *  - Otherwise, and while the audio output shifts the input rate to catch up
+ *    a drift, there are sets for BANK_PHASES regular phases and the output is
+ *    interpolated between the inner products of the two nearest ones.
  *
  *****************************************************************************/
 
@@ -37,46 +43,97 @@
 # include "config.h"
 #endif
 
+#ifdef BANDLIMITED_TEST
+# undef NDEBUG
+#endif
+
 #include <vlc_common.h>
 #include <vlc_plugin.h>
 #include <vlc_aout.h>
 #include <vlc_filter.h>
 #include <vlc_block.h>
+#include <vlc_cpu.h>
 
 #include <assert.h>
+#include <math.h>
+
+#ifdef HAVE_SSE2_INTRINSICS
+# include <xmmintrin.h>
+#endif
+#ifdef HAVE_AVX2_INTRINSICS
+# include <immintrin.h>
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+# include <arm_neon.h>
+# define BANDLIMITED_NEON 1
+#endif
+
+/* Filter design, relative to the lowest of the Nyquist frequencies */
+#define FILTER_ATTENUATION  96.  /* dB in the stop band */
+#define FILTER_PASSBAND     .91  /* end of the pass band */
+#define FILTER_STOPBAND     1.   /* start of the stop band */
+
+#define TAPS_ALIGN          8    /* coefficients per SIMD iteration */
+#define MAX_TAPS            8192 /* wider transition band beyond that */
+#define MAX_EXACT_PHASES    1024
+#define BANK_PHASES_LOG     8
+#define BANK_PHASES         (1 << BANK_PHASES_LOG)
+#define BANK_FRAC_BITS      (32 - BANK_PHASES_LOG)
 
-#include "bandlimited.h"
+/* Relative change of the cut-off frequency that warrants a new bank */
+#define BANK_CUTOFF_SLACK   .01
 
 /*****************************************************************************
  * Local prototypes
  *****************************************************************************/
-
-/* audio filter */
-static int  OpenFilter ( vlc_object_t * );
-static void CloseFilter( vlc_object_t * );
+static int  OpenConverter( vlc_object_t * );
+static int  OpenResampler( vlc_object_t * );
+static void Close( vlc_object_t * );
 static block_t *Resample( filter_t *, block_t * );
-
-static void ResampleFloat( filter_t *p_filter,
-                           block_t **pp_out_buf,  size_t *pi_out,
-                           float **pp_in,
-                           int i_in, int i_in_end,
-                           double d_factor, bool b_factor_old,
-                           int i_nb_channels, int i_bytes_per_frame );
+static block_t *Drain( filter_t * );
+static void     Flush( filter_t * );
 
 /*****************************************************************************
  * Local structures
  *****************************************************************************/
-struct filter_sys_t
+typedef struct
 {
-    int32_t *p_buf;                        /* this filter introduces a delay */
-    size_t i_buf_size;
+    float   *p_coefs;   /* i_phases (+1 if interpolated) sets of i_taps */
+    unsigned i_taps;    /* multiple of TAPS_ALIGN */
+    unsigned i_phases;
+    /* exact banks: output phase step, and the rates they are made for */
+    unsigned i_step;
+    unsigned i_in_rate;
+    unsigned i_out_rate;
+    /* interpolated banks: min(1, out/in) they are made for */
+    double   f_ratio;
+} filter_bank_t;
+
+typedef float (*dot_cb)( const float *, const float *, unsigned );
+typedef float (*dot_interp_cb)( const float *, const float *, const float *,
+                                unsigned, float );
 
-    double d_old_factor;
-    size_t i_old_wing;
+struct filter_sys_t
+{
+    filter_bank_t exact;               /* for the nominal rates, if any */
+    filter_bank_t interp;              /* for the other ones */
+    const filter_bank_t *p_bank;       /* of the last block, NULL if same rates */
+
+    /* input samples, one run of i_work_size per channel */
+    float   *p_work;
+    size_t   i_work_size;
+    size_t   i_work;
+    size_t   i_keep;                   /* history before i_center */
+    /* the next output is at i_center + i_phase / exact.i_phases, or at
+     * i_center + i_frac / 2^32 with the interpolated bank */
+    size_t   i_center;
+    unsigned i_phase;
+    uint32_t i_frac;
+
+    dot_cb        pf_dot;
+    dot_interp_cb pf_dot_interp;
 
-    unsigned int i_remainder;                /* remainder of previous sample */
     bool b_first;
-
     date_t end_date;
 };
 
@@ -88,459 +145,1089 @@ vlc_module_begin ()
     set_subcategory( SUBCAT_AUDIO_RESAMPLER )
     set_description( N_("Audio filter for band-limited interpolation resampling") )
     set_capability( "audio converter", 20 )
-    set_callbacks( OpenFilter, CloseFilter )
+    set_callbacks( OpenConverter, Close )
 
     add_submodule()
     set_capability( "audio resampler", 20 )
-    set_callbacks( OpenFilter, CloseFilter )
+    set_callbacks( OpenResampler, Close )
+    add_shortcut( "bandlimited" )
 vlc_module_end ()
 
 /*****************************************************************************
- * Resample: convert a buffer
+ * Inner products
+ *****************************************************************************
+ * The coefficients are aligned on 32 bytes and come in multiples of
+ * TAPS_ALIGN, the samples are not aligned.
  *****************************************************************************/
-static block_t *Resample( filter_t * p_filter, block_t * p_in_buf )
+static float DotC( const float *h, const float *x, unsigned taps )
 {
-    if( !p_in_buf || !p_in_buf->i_nb_samples )
+    float a0 = 0, a1 = 0, a2 = 0, a3 = 0;
+
+    for( unsigned i = 0; i < taps; i += 4 )
     {
-        if( p_in_buf )
-            block_Release( p_in_buf );
-        return NULL;
+        a0 += h[i]     * x[i];
+        a1 += h[i + 1] * x[i + 1];
+        a2 += h[i + 2] * x[i + 2];
+        a3 += h[i + 3] * x[i + 3];
     }
+    return ( a0 + a2 ) + ( a1 + a3 );
+}
 
-    filter_sys_t *p_sys = p_filter->p_sys;
-    unsigned int i_out_rate = p_filter->fmt_out.audio.i_rate;
-    int i_nb_channels = p_filter->fmt_in.audio.i_channels;
+static float DotInterpC( const float *h0, const float *h1, const float *x,
+                         unsigned taps, float w )
+{
+    float a = DotC( h0, x, taps );
+    return a + w * ( DotC( h1, x, taps ) - a );
+}
+
+#ifdef HAVE_SSE2_INTRINSICS
+VLC_SSE
+static inline float SumSSE( __m128 v )
+{
+    v = _mm_add_ps( v, _mm_movehl_ps( v, v ) );
+    v = _mm_add_ss( v, _mm_shuffle_ps( v, v, 1 ) );
+    return _mm_cvtss_f32( v );
+}
+
+VLC_SSE
+static float DotSSE( const float *h, const float *x, unsigned taps )
+{
+    __m128 a0 = _mm_setzero_ps(), a1 = _mm_setzero_ps();
 
-    /* Check if we really need to run the resampler */
-    if( i_out_rate == p_filter->fmt_in.audio.i_rate )
+    for( unsigned i = 0; i < taps; i += 8 )
     {
-        if( !(p_in_buf->i_flags & BLOCK_FLAG_DISCONTINUITY) &&
-            p_sys->i_old_wing )
-        {
-            /* output the whole thing with the samples from last time */
-            p_in_buf = block_Realloc( p_in_buf,
-                p_sys->i_old_wing * p_filter->fmt_in.audio.i_bytes_per_frame,
-                p_in_buf->i_buffer );
-            if( !p_in_buf )
-                return NULL;
-            memcpy( p_in_buf->p_buffer, p_sys->p_buf +
-                    i_nb_channels * p_sys->i_old_wing,
-                    p_sys->i_old_wing *
-                    p_filter->fmt_in.audio.i_bytes_per_frame );
-
-            p_in_buf->i_nb_samples += p_sys->i_old_wing;
-
-            p_in_buf->i_pts = date_Get( &p_sys->end_date );
-            p_in_buf->i_length =
-                date_Increment( &p_sys->end_date,
-                                p_in_buf->i_nb_samples ) - p_in_buf->i_pts;
-        }
-        p_sys->i_old_wing = 0;
-        p_sys->b_first = true;
-        return p_in_buf;
+        a0 = _mm_add_ps( a0, _mm_mul_ps( _mm_load_ps( &h[i] ),
+                                         _mm_loadu_ps( &x[i] ) ) );
+        a1 = _mm_add_ps( a1, _mm_mul_ps( _mm_load_ps( &h[i + 4] ),
+                                         _mm_loadu_ps( &x[i + 4] ) ) );
     }
+    return SumSSE( _mm_add_ps( a0, a1 ) );
+}
+
+VLC_SSE
+static float DotInterpSSE( const float *h0, const float *h1, const float *x,
+                           unsigned taps, float w )
+{
+    __m128 a0 = _mm_setzero_ps(), a1 = _mm_setzero_ps();
+    __m128 b0 = _mm_setzero_ps(), b1 = _mm_setzero_ps();
 
-    unsigned i_bytes_per_frame = p_filter->fmt_out.audio.i_channels *
-                                 p_filter->fmt_out.audio.i_bitspersample / 8;
-    size_t i_out_size = i_bytes_per_frame * ( 1 + ( p_in_buf->i_nb_samples *
-              p_filter->fmt_out.audio.i_rate / p_filter->fmt_in.audio.i_rate) )
-            + p_filter->p_sys->i_buf_size;
-    block_t *p_out_buf = block_Alloc( i_out_size );
-    if( !p_out_buf )
+    for( unsigned i = 0; i < taps; i += 8 )
     {
-        block_Release( p_in_buf );
-        return NULL;
+        const __m128 x0 = _mm_loadu_ps( &x[i] );
+        const __m128 x1 = _mm_loadu_ps( &x[i + 4] );
+        a0 = _mm_add_ps( a0, _mm_mul_ps( _mm_load_ps( &h0[i] ), x0 ) );
+        a1 = _mm_add_ps( a1, _mm_mul_ps( _mm_load_ps( &h0[i + 4] ), x1 ) );
+        b0 = _mm_add_ps( b0, _mm_mul_ps( _mm_load_ps( &h1[i] ), x0 ) );
+        b1 = _mm_add_ps( b1, _mm_mul_ps( _mm_load_ps( &h1[i + 4] ), x1 ) );
     }
+    float a = SumSSE( _mm_add_ps( a0, a1 ) );
+    return a + w * ( SumSSE( _mm_add_ps( b0, b1 ) ) - a );
+}
+#endif
+
+#ifdef HAVE_AVX2_INTRINSICS
+__attribute__ ((__target__ ("avx2")))
+static inline float SumAVX2( __m256 v )
+{
+    __m128 s = _mm_add_ps( _mm256_castps256_ps128( v ),
+                           _mm256_extractf128_ps( v, 1 ) );
+    s = _mm_add_ps( s, _mm_movehl_ps( s, s ) );
+    s = _mm_add_ss( s, _mm_shuffle_ps( s, s, 1 ) );
+    return _mm_cvtss_f32( s );
+}
+
+__attribute__ ((__target__ ("avx2")))
+static float DotAVX2( const float *h, const float *x, unsigned taps )
+{
+    __m256 a0 = _mm256_setzero_ps(), a1 = _mm256_setzero_ps();
+    unsigned i = 0;
 
-    if( (p_in_buf->i_flags & BLOCK_FLAG_DISCONTINUITY) || p_sys->b_first )
+    for( ; i + 16 <= taps; i += 16 )
     {
-        /* Continuity in sound samples has been broken, we'd better reset
-         * everything. */
-        p_out_buf->i_flags |= BLOCK_FLAG_DISCONTINUITY;
-        p_sys->i_remainder = 0;
-        date_Init( &p_sys->end_date, i_out_rate, 1 );
-        date_Set( &p_sys->end_date, p_in_buf->i_pts );
-        p_sys->d_old_factor = 1;
-        p_sys->i_old_wing   = 0;
-        p_sys->b_first = false;
+        a0 = _mm256_add_ps( a0, _mm256_mul_ps( _mm256_load_ps( &h[i] ),
+                                               _mm256_loadu_ps( &x[i] ) ) );
+        a1 = _mm256_add_ps( a1, _mm256_mul_ps( _mm256_load_ps( &h[i + 8] ),
+                                               _mm256_loadu_ps( &x[i + 8] ) ) );
     }
+    if( i < taps )
+        a0 = _mm256_add_ps( a0, _mm256_mul_ps( _mm256_load_ps( &h[i] ),
+                                               _mm256_loadu_ps( &x[i] ) ) );
+    return SumAVX2( _mm256_add_ps( a0, a1 ) );
+}
 
-    size_t i_in_nb = p_in_buf->i_nb_samples;
-    size_t i_in, i_out = 0;
-    double d_factor, d_scale_factor, d_old_scale_factor;
-    size_t i_filter_wing;
-
-#if 0
-    msg_Err( p_filter, "old rate: %i, old factor: %f, old wing: %i, i_in: %i",
-             p_sys->i_old_rate, p_sys->d_old_factor,
-             p_sys->i_old_wing, i_in_nb );
-#endif
+__attribute__ ((__target__ ("avx2")))
+static float DotInterpAVX2( const float *h0, const float *h1, const float *x,
+                            unsigned taps, float w )
+{
+    __m256 a = _mm256_setzero_ps(), b = _mm256_setzero_ps();
 
-    /* Same format in and out... */
-    assert( p_filter->fmt_in.audio.i_bytes_per_frame == i_bytes_per_frame );
-
-    /* Prepare the source buffer */
-    if( p_sys->i_old_wing )
-    {   /* Copy all our samples in p_in_buf */
-        /* Normally, there should be enough room for the old wing in the
-         * buffer head room. Otherwise, we need to copy memory anyway. */
-        p_in_buf = block_Realloc( p_in_buf,
-                                  p_sys->i_old_wing * 2 * i_bytes_per_frame,
-                                  p_in_buf->i_buffer );
-        if( unlikely(p_in_buf == NULL) )
-            return NULL;
-        memcpy( p_in_buf->p_buffer, p_sys->p_buf,
-                p_sys->i_old_wing * 2 * i_bytes_per_frame );
+    for( unsigned i = 0; i < taps; i += 8 )
+    {
+        const __m256 v = _mm256_loadu_ps( &x[i] );
+        a = _mm256_add_ps( a, _mm256_mul_ps( _mm256_load_ps( &h0[i] ), v ) );
+        b = _mm256_add_ps( b, _mm256_mul_ps( _mm256_load_ps( &h1[i] ), v ) );
     }
-    i_in_nb += (p_sys->i_old_wing * 2);
-    float *p_in = (float *)p_in_buf->p_buffer;
-    const float *p_in_orig = p_in;
+    float sa = SumAVX2( a );
+    return sa + w * ( SumAVX2( b ) - sa );
+}
+#endif
 
-    /* Make sure the output buffer is reset */
-    memset( p_out_buf->p_buffer, 0, p_out_buf->i_buffer );
+#ifdef BANDLIMITED_NEON
+static inline float SumNEON( float32x4_t v )
+{
+    float32x2_t s = vadd_f32( vget_low_f32( v ), vget_high_f32( v ) );
+    return vget_lane_f32( vpadd_f32( s, s ), 0 );
+}
 
-    /* Calculate the new length of the filter wing */
-    d_factor = (double)i_out_rate / p_filter->fmt_in.audio.i_rate;
-    i_filter_wing = ((SMALL_FILTER_NMULT+1)/2.0) * __MAX(1.0,1.0/d_factor) + 1;
+static float DotNEON( const float *h, const float *x, unsigned taps )
+{
+    float32x4_t a0 = vdupq_n_f32( 0 ), a1 = vdupq_n_f32( 0 );
 
-    /* Account for increased filter gain when using factors less than 1 */
-    d_old_scale_factor = SMALL_FILTER_SCALE *
-        p_sys->d_old_factor + 0.5;
-    d_scale_factor = SMALL_FILTER_SCALE * d_factor + 0.5;
+    for( unsigned i = 0; i < taps; i += 8 )
+    {
+        a0 = vmlaq_f32( a0, vld1q_f32( &h[i] ), vld1q_f32( &x[i] ) );
+        a1 = vmlaq_f32( a1, vld1q_f32( &h[i + 4] ), vld1q_f32( &x[i + 4] ) );
+    }
+    return SumNEON( vaddq_f32( a0, a1 ) );
+}
 
-    /* Apply the old rate until we have enough samples for the new one */
-    i_in = p_sys->i_old_wing;
-    p_in += p_sys->i_old_wing * i_nb_channels;
+static float DotInterpNEON( const float *h0, const float *h1, const float *x,
+                            unsigned taps, float w )
+{
+    float32x4_t a = vdupq_n_f32( 0 ), b = vdupq_n_f32( 0 );
 
-    size_t i_old_in_end = 0;
-    if( p_sys->i_old_wing <= i_in_nb )
-        i_old_in_end = __MIN( i_filter_wing, i_in_nb - p_sys->i_old_wing );
+    for( unsigned i = 0; i < taps; i += 4 )
+    {
+        const float32x4_t v = vld1q_f32( &x[i] );
+        a = vmlaq_f32( a, vld1q_f32( &h0[i] ), v );
+        b = vmlaq_f32( b, vld1q_f32( &h1[i] ), v );
+    }
+    float sa = SumNEON( a );
+    return sa + w * ( SumNEON( b ) - sa );
+}
+#endif
 
-    ResampleFloat( p_filter,
-                   &p_out_buf, &i_out, &p_in,
-                   i_in, i_old_in_end,
-                   p_sys->d_old_factor, true,
-                   i_nb_channels, i_bytes_per_frame );
-    i_in = __MAX( i_in, i_old_in_end );
+static void InitKernels( filter_sys_t *p_sys, bool b_optimized )
+{
+    p_sys->pf_dot = DotC;
+    p_sys->pf_dot_interp = DotInterpC;
 
-    /* Apply the new rate for the rest of the samples */
-    if( i_in < i_in_nb - i_filter_wing )
+    if( !b_optimized )
+        return;
+#ifdef HAVE_SSE2_INTRINSICS
+    if( vlc_CPU_SSE() )
     {
-        p_sys->d_old_factor = d_factor;
-        p_sys->i_old_wing   = i_filter_wing;
+        p_sys->pf_dot = DotSSE;
+        p_sys->pf_dot_interp = DotInterpSSE;
     }
-    if( p_out_buf )
+#endif
+#ifdef HAVE_AVX2_INTRINSICS
+    if( vlc_CPU_AVX2() )
     {
-        ResampleFloat( p_filter,
-                       &p_out_buf, &i_out, &p_in,
-                       i_in, i_in_nb - i_filter_wing,
-                       d_factor, false,
-                       i_nb_channels, i_bytes_per_frame );
+        p_sys->pf_dot = DotAVX2;
+        p_sys->pf_dot_interp = DotInterpAVX2;
+    }
+#endif
+#ifdef BANDLIMITED_NEON
+    p_sys->pf_dot = DotNEON;
+    p_sys->pf_dot_interp = DotInterpNEON;
+#endif
+}
 
-        /* Finalize aout buffer */
-        p_out_buf->i_nb_samples = i_out;
-        p_out_buf->i_dts =
-        p_out_buf->i_pts = date_Get( &p_sys->end_date );
-        p_out_buf->i_length = date_Increment( &p_sys->end_date,
-                                      p_out_buf->i_nb_samples ) - p_out_buf->i_pts;
+/*****************************************************************************
+ * Filter banks
+ *****************************************************************************/
+static double BesselI0( double x )
+{
+    double sum = 1., term = 1.;
 
-        p_out_buf->i_buffer = p_out_buf->i_nb_samples *
-            i_nb_channels * sizeof(int32_t);
+    for( unsigned k = 1; term > sum * 1e-12; k++ )
+    {
+        term *= ( x / ( 2 * k ) ) * ( x / ( 2 * k ) );
+        sum += term;
     }
+    return sum;
+}
 
-    /* Buffer i_filter_wing * 2 samples for next time */
-    if( p_sys->i_old_wing )
+static double Ratio( unsigned i_in_rate, unsigned i_out_rate )
+{
+    return __MIN( 1., (double)i_out_rate / i_in_rate );
+}
+
+/* Computes the coefficients of the phases, i_phases sets for the fractions
+ * k / i_phases of an input sample, plus the extra one for k = i_phases of
+ * the interpolated banks */
+static int BankInit( filter_bank_t *p_bank, double f_ratio, unsigned i_phases,
+                     unsigned i_sets )
+{
+    const double A = FILTER_ATTENUATION;
+    /* In cycles per input sample */
+    const double fc = .25 * f_ratio * ( FILTER_PASSBAND + FILTER_STOPBAND );
+    const double df = .5 * f_ratio * ( FILTER_STOPBAND - FILTER_PASSBAND );
+    const double beta = .1102 * ( A - 8.7 );
+
+    unsigned i_taps = ( A - 7.95 ) / ( 14.36 * df ) + 1;
+    i_taps = ( i_taps + TAPS_ALIGN - 1 ) & ~(TAPS_ALIGN - 1);
+    i_taps = VLC_CLIP( i_taps, TAPS_ALIGN, MAX_TAPS );
+
+    float *p_coefs = aligned_alloc( 32, i_sets * i_taps * sizeof (float) );
+    if( unlikely(p_coefs == NULL) )
+        return VLC_ENOMEM;
+
+    const double half = i_taps / 2;
+    const double i0_beta = BesselI0( beta );
+
+    for( unsigned k = 0; k < i_sets; k++ )
     {
-        size_t newsize = p_sys->i_old_wing * 2 * i_bytes_per_frame;
-        if( newsize > p_sys->i_buf_size )
+        float *h = &p_coefs[k * i_taps];
+        const double f = (double)k / i_phases;
+        double sum = 0.;
+
+        for( unsigned j = 0; j < i_taps; j++ )
         {
-            free( p_sys->p_buf );
-            p_sys->p_buf = malloc( newsize );
-            if( p_sys->p_buf != NULL )
-                p_sys->i_buf_size = newsize;
-            else
+            /* Time of the sample relative to the output one */
+            const double t = j - ( half - 1. ) - f;
+            const double x = t / half;
+            double v = 0.;
+
+            if( fabs( x ) < 1. )
             {
-                p_sys->i_buf_size = p_sys->i_old_wing = 0; /* oops! */
-                block_Release( p_in_buf );
-                return p_out_buf;
+                v = 2. * fc * BesselI0( beta * sqrt( 1. - x * x ) ) / i0_beta;
+                if( t != 0. )
+                    v *= sin( 2. * M_PI * fc * t ) / ( 2. * M_PI * fc * t );
             }
+            h[j] = v;
+            sum += v;
         }
-        memcpy( p_sys->p_buf,
-                p_in_orig + (i_in_nb - 2 * p_sys->i_old_wing) *
-                i_nb_channels, (2 * p_sys->i_old_wing) *
-                p_filter->fmt_in.audio.i_bytes_per_frame );
+        /* Unity gain at DC for every phase */
+        for( unsigned j = 0; j < i_taps; j++ )
+            h[j] /= sum;
     }
 
-#if 0
-    msg_Err( p_filter, "p_out size: %i, nb bytes out: %i", p_out_buf->i_buffer,
-             i_out * p_filter->fmt_in.audio.i_bytes_per_frame );
-#endif
+    aligned_free( p_bank->p_coefs );
+    p_bank->p_coefs = p_coefs;
+    p_bank->i_taps = i_taps;
+    p_bank->i_phases = i_phases;
+    p_bank->f_ratio = f_ratio;
+    return VLC_SUCCESS;
+}
 
-    block_Release( p_in_buf );
-    return p_out_buf;
+static int BankInitExact( filter_bank_t *p_bank, unsigned i_in_rate,
+                          unsigned i_out_rate )
+{
+    unsigned a = i_in_rate, b = i_out_rate;
+    while( b != 0 )
+    {
+        unsigned r = a % b;
+        a = b;
+        b = r;
+    }
+
+    if( i_out_rate / a > MAX_EXACT_PHASES )
+        return VLC_EGENERIC;
+    if( BankInit( p_bank, Ratio( i_in_rate, i_out_rate ), i_out_rate / a,
+                  i_out_rate / a ) )
+        return VLC_ENOMEM;
+
+    p_bank->i_step = i_in_rate / a;
+    p_bank->i_in_rate = i_in_rate;
+    p_bank->i_out_rate = i_out_rate;
+    return VLC_SUCCESS;
+}
+
+static int BankInitInterp( filter_bank_t *p_bank, unsigned i_in_rate,
+                           unsigned i_out_rate )
+{
+    return BankInit( p_bank, Ratio( i_in_rate, i_out_rate ), BANK_PHASES,
+                     BANK_PHASES + 1 );
+}
+
+static void BankClean( filter_bank_t *p_bank )
+{
+    aligned_free( p_bank->p_coefs );
 }
 
 /*****************************************************************************
- * OpenFilter:
+ * Input buffer
  *****************************************************************************/
-static int OpenFilter( vlc_object_t *p_this )
+static size_t Half( const filter_bank_t *p_bank )
 {
-    filter_t *p_filter = (filter_t *)p_this;
-    filter_sys_t *p_sys;
-    unsigned int i_out_rate  = p_filter->fmt_out.audio.i_rate;
+    return p_bank->i_taps / 2 - 1;
+}
 
-    if ( p_filter->fmt_in.audio.i_rate == p_filter->fmt_out.audio.i_rate
-      || p_filter->fmt_in.audio.i_format != p_filter->fmt_out.audio.i_format
-      || p_filter->fmt_in.audio.i_channels != p_filter->fmt_out.audio.i_channels
-      || p_filter->fmt_in.audio.i_format != VLC_CODEC_FL32 )
-    {
-        return VLC_EGENERIC;
-    }
+/* Inserts i_front null frames before the samples, and makes room for
+ * i_back more frames after them */
+static int Grow( filter_sys_t *p_sys, unsigned i_channels, size_t i_front,
+                 size_t i_back )
+{
+    const size_t i_size = i_front + p_sys->i_work + i_back;
 
-    /* Allocate the memory needed to store the module's structure */
-    p_filter->p_sys = p_sys = malloc( sizeof(struct filter_sys_t) );
-    if( p_sys == NULL )
-        return VLC_ENOMEM;
+    if( i_front == 0 && i_size <= p_sys->i_work_size )
+        return VLC_SUCCESS;
 
-    p_sys->p_buf = NULL;
-    p_sys->i_buf_size = 0;
+    float *p_work = p_sys->p_work;
+    size_t i_work_size = p_sys->i_work_size;
+    if( i_size > i_work_size )
+    {
+        /* Do not reallocate for every slightly larger block */
+        i_work_size = i_size + i_size / 2;
+        p_work = vlc_alloc( i_channels * i_work_size, sizeof (float) );
+        if( unlikely(p_work == NULL) )
+            return VLC_ENOMEM;
+    }
 
-    p_sys->i_old_wing = 0;
-    p_sys->b_first = true;
-    p_filter->pf_audio_filter = Resample;
+    for( unsigned c = 0; c < i_channels; c++ )
+    {
+        if( p_sys->i_work > 0 )
+            memmove( &p_work[c * i_work_size + i_front],
+                     &p_sys->p_work[c * p_sys->i_work_size],
+                     p_sys->i_work * sizeof (float) );
+        memset( &p_work[c * i_work_size], 0, i_front * sizeof (float) );
+    }
 
-    msg_Dbg( p_this, "%4.4s/%iKHz/%i->%4.4s/%iKHz/%i",
-             (char *)&p_filter->fmt_in.i_codec,
-             p_filter->fmt_in.audio.i_rate,
-             p_filter->fmt_in.audio.i_channels,
-             (char *)&p_filter->fmt_out.i_codec,
-             p_filter->fmt_out.audio.i_rate,
-             p_filter->fmt_out.audio.i_channels);
+    if( p_work != p_sys->p_work )
+    {
+        free( p_sys->p_work );
+        p_sys->p_work = p_work;
+        p_sys->i_work_size = i_work_size;
+    }
+    p_sys->i_work += i_front;
+    p_sys->i_center += i_front;
+    return VLC_SUCCESS;
+}
 
-    p_filter->fmt_out = p_filter->fmt_in;
-    p_filter->fmt_out.audio.i_rate = i_out_rate;
+/* Drops the samples that no output needs anymore */
+static void Shrink( filter_sys_t *p_sys, unsigned i_channels )
+{
+    if( p_sys->i_center <= p_sys->i_keep )
+        return;
 
-    return 0;
+    const size_t i_drop = p_sys->i_center - p_sys->i_keep;
+    for( unsigned c = 0; c < i_channels; c++ )
+    {
+        float *p_run = &p_sys->p_work[c * p_sys->i_work_size];
+        memmove( p_run, &p_run[i_drop],
+                 ( p_sys->i_work - i_drop ) * sizeof (float) );
+    }
+    p_sys->i_work -= i_drop;
+    p_sys->i_center -= i_drop;
 }
 
-/*****************************************************************************
- * CloseFilter : deallocate data structures
- *****************************************************************************/
-static void CloseFilter( vlc_object_t *p_this )
+static void UpdateKeep( filter_sys_t *p_sys )
 {
-    filter_t *p_filter = (filter_t *)p_this;
-    free( p_filter->p_sys->p_buf );
-    free( p_filter->p_sys );
+    size_t i_keep = 0;
+
+    if( p_sys->exact.p_coefs != NULL )
+        i_keep = Half( &p_sys->exact );
+    if( p_sys->interp.p_coefs != NULL )
+        i_keep = __MAX( i_keep, Half( &p_sys->interp ) );
+    p_sys->i_keep = i_keep;
 }
 
-static void FilterFloatUP( const float Imp[], const float ImpD[], uint16_t Nwing, float *p_in,
-                            float *p_out, uint32_t ui_remainder,
-                            uint32_t ui_output_rate, int16_t Inc, int i_nb_channels )
+static int Reset( filter_t *p_filter, mtime_t i_pts )
 {
-    const float *Hp, *Hdp, *End;
-    float t, temp;
-    uint32_t ui_linear_remainder;
-    int i;
+    filter_sys_t *p_sys = p_filter->p_sys;
 
-    Hp = &Imp[(ui_remainder<<Nhc)/ui_output_rate];
-    Hdp = &ImpD[(ui_remainder<<Nhc)/ui_output_rate];
+    date_Init( &p_sys->end_date, p_filter->fmt_out.audio.i_rate, 1 );
+    date_Set( &p_sys->end_date, i_pts );
 
-    End = &Imp[Nwing];
+    /* The filter is centered on the first input sample, after silence */
+    p_sys->i_work = 0;
+    p_sys->i_center = 0;
+    p_sys->i_phase = 0;
+    p_sys->i_frac = 0;
+    return Grow( p_sys, p_filter->fmt_in.audio.i_channels, p_sys->i_keep, 0 );
+}
 
-    ui_linear_remainder = (ui_remainder<<Nhc) -
-                            (ui_remainder<<Nhc)/ui_output_rate*ui_output_rate;
+/*****************************************************************************
+ * Resampling
+ *****************************************************************************/
 
-    if (Inc == 1)               /* If doing right wing...              */
-    {                           /* ...drop extra coeff, so when Ph is  */
-        End--;                  /*    0.5, we don't do too many mult's */
-        if (ui_remainder == 0)  /* If the phase is zero...           */
-        {                       /* ...then we've already skipped the */
-            Hp += Npc;          /*    first sample, so we must also  */
-            Hdp += Npc;         /*    skip ahead in Imp[] and ImpD[] */
+/* Picks the bank of the current rates, and carries the output time over */
+static int SetBank( filter_t *p_filter, unsigned i_in_rate,
+                    unsigned i_out_rate )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+    const filter_bank_t *p_old = p_sys->p_bank;
+    const filter_bank_t *p_bank;
+
+    /* Carry the output time over as a fraction of 2^32 */
+    if( p_old == &p_sys->exact )
+        p_sys->i_frac = ( (uint64_t)p_sys->i_phase << 32 )
+                      / p_sys->exact.i_phases;
+
+    /* The samples are passed through unless the output time fell between
+     * two of them while the rates differed */
+    if( i_in_rate == i_out_rate && p_sys->i_frac == 0 )
+        p_bank = NULL;
+    else if( p_sys->exact.p_coefs != NULL
+          && p_sys->exact.i_in_rate == i_in_rate
+          && p_sys->exact.i_out_rate == i_out_rate )
+        p_bank = &p_sys->exact;
+    else
+    {
+        const double f_ratio = Ratio( i_in_rate, i_out_rate );
+        if( p_sys->interp.p_coefs == NULL
+         || fabs( f_ratio - p_sys->interp.f_ratio )
+                > BANK_CUTOFF_SLACK * p_sys->interp.f_ratio )
+        {
+            if( BankInitInterp( &p_sys->interp, i_in_rate, i_out_rate ) )
+                return VLC_ENOMEM;
+            UpdateKeep( p_sys );
+            msg_Dbg( p_filter, "%u taps for %u Hz to %u Hz",
+                     p_sys->interp.i_taps, i_in_rate, i_out_rate );
         }
+        p_bank = &p_sys->interp;
     }
 
-    while (Hp < End) {
-        t = *Hp;                /* Get filter coeff */
-                                /* t is now interp'd filter coeff */
-        t += *Hdp * ui_linear_remainder / ui_output_rate / Npc;
-        for( i = 0; i < i_nb_channels; i++ )
+    if( p_bank == &p_sys->exact && p_old != p_bank )
+    {
+        /* Rounded to the nearest phase, a fraction of a sample apart */
+        const unsigned i_phases = p_sys->exact.i_phases;
+        p_sys->i_phase = ( (uint64_t)p_sys->i_frac * i_phases
+                           + ( UINT64_C(1) << 31 ) ) >> 32;
+        if( p_sys->i_phase == i_phases )
         {
-            temp = t;
-            temp *= *(p_in+i);  /* Mult coeff by input sample */
-            *(p_out+i) += temp; /* The filter output */
+            p_sys->i_phase = 0;
+            p_sys->i_center++;
         }
-        Hdp += Npc;             /* Filter coeff differences step */
-        Hp += Npc;              /* Filter coeff step */
-        p_in += (Inc * i_nb_channels); /* Input signal step */
     }
+    p_sys->p_bank = p_bank;
+
+    /* A longer filter needs more history */
+    if( p_sys->i_center < p_sys->i_keep )
+        return Grow( p_sys, p_filter->fmt_in.audio.i_channels,
+                     p_sys->i_keep - p_sys->i_center, 0 );
+    return VLC_SUCCESS;
 }
 
-static void FilterFloatUD( const float Imp[], const float ImpD[], uint16_t Nwing, float *p_in,
-                           float *p_out, uint32_t ui_remainder,
-                           uint32_t ui_output_rate, uint32_t ui_input_rate,
-                           int16_t Inc, int i_nb_channels )
+static size_t RunExact( filter_sys_t *p_sys, float *p_out, unsigned i_channels )
 {
-    const float *Hp, *Hdp, *End;
-    float t, temp;
-    uint32_t ui_linear_remainder;
-    int i, ui_counter = 0;
+    const filter_bank_t *p_bank = &p_sys->exact;
+    const size_t i_half = Half( p_bank );
+    size_t i_out = 0;
 
-    Hp = Imp + (ui_remainder<<Nhc) / ui_input_rate;
-    Hdp = ImpD  + (ui_remainder<<Nhc) / ui_input_rate;
+    while( p_sys->i_center + p_bank->i_taps - i_half <= p_sys->i_work )
+    {
+        const float *h = &p_bank->p_coefs[p_sys->i_phase * p_bank->i_taps];
+        const float *x = &p_sys->p_work[p_sys->i_center - i_half];
 
-    End = &Imp[Nwing];
+        for( unsigned c = 0; c < i_channels; c++ )
+            *p_out++ = p_sys->pf_dot( h, &x[c * p_sys->i_work_size],
+                                      p_bank->i_taps );
+        i_out++;
 
-    if (Inc == 1)               /* If doing right wing...              */
-    {                           /* ...drop extra coeff, so when Ph is  */
-        End--;                  /*    0.5, we don't do too many mult's */
-        if (ui_remainder == 0)  /* If the phase is zero...           */
-        {                       /* ...then we've already skipped the */
-            Hp = Imp +          /* first sample, so we must also  */
-                  (ui_output_rate << Nhc) / ui_input_rate;
-            Hdp = ImpD +        /* skip ahead in Imp[] and ImpD[] */
-                  (ui_output_rate << Nhc) / ui_input_rate;
-            ui_counter++;
-        }
+        p_sys->i_phase += p_bank->i_step;
+        p_sys->i_center += p_sys->i_phase / p_bank->i_phases;
+        p_sys->i_phase %= p_bank->i_phases;
+    }
+    return i_out;
+}
+
+static size_t RunInterp( filter_sys_t *p_sys, float *p_out, unsigned i_channels,
+                         unsigned i_in_rate, unsigned i_out_rate )
+{
+    const filter_bank_t *p_bank = &p_sys->interp;
+    const size_t i_half = Half( p_bank );
+    const uint64_t i_step = ( (uint64_t)i_in_rate << 32 ) / i_out_rate;
+    size_t i_out = 0;
+
+    while( p_sys->i_center + p_bank->i_taps - i_half <= p_sys->i_work )
+    {
+        const unsigned k = p_sys->i_frac >> BANK_FRAC_BITS;
+        const float w = ( p_sys->i_frac & ( ( 1 << BANK_FRAC_BITS ) - 1 ) )
+                      * ( 1.f / ( 1 << BANK_FRAC_BITS ) );
+        const float *h = &p_bank->p_coefs[k * p_bank->i_taps];
+        const float *x = &p_sys->p_work[p_sys->i_center - i_half];
+
+        for( unsigned c = 0; c < i_channels; c++ )
+            *p_out++ = p_sys->pf_dot_interp( h, h + p_bank->i_taps,
+                                             &x[c * p_sys->i_work_size],
+                                             p_bank->i_taps, w );
+        i_out++;
+
+        const uint64_t i_pos = p_sys->i_frac + i_step;
+        p_sys->i_center += i_pos >> 32;
+        p_sys->i_frac = i_pos;
     }
+    return i_out;
+}
+
+static size_t RunCopy( filter_sys_t *p_sys, float *p_out, unsigned i_channels )
+{
+    size_t i_out = 0;
+
+    for( ; p_sys->i_center < p_sys->i_work; p_sys->i_center++, i_out++ )
+        for( unsigned c = 0; c < i_channels; c++ )
+            *p_out++ = p_sys->p_work[c * p_sys->i_work_size + p_sys->i_center];
+    return i_out;
+}
+
+/* Resamples i_frames interleaved input frames */
+static block_t *Process( filter_t *p_filter, const float *p_in,
+                         size_t i_frames )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+    const unsigned i_channels = p_filter->fmt_in.audio.i_channels;
+    const unsigned i_in_rate = p_filter->fmt_in.audio.i_rate;
+    const unsigned i_out_rate = p_filter->fmt_out.audio.i_rate;
+
+    if( SetBank( p_filter, i_in_rate, i_out_rate )
+     || Grow( p_sys, i_channels, 0, i_frames ) )
+        return NULL;
 
-    while (Hp < End) {
-        t = *Hp;                /* Get filter coeff */
-                                /* t is now interp'd filter coeff */
-        ui_linear_remainder =
-          ((ui_output_rate * ui_counter + ui_remainder)<< Nhc) -
-          ((ui_output_rate * ui_counter + ui_remainder)<< Nhc) /
-          ui_input_rate * ui_input_rate;
-        t += *Hdp * ui_linear_remainder / ui_input_rate / Npc;
-        for( i = 0; i < i_nb_channels; i++ )
+    for( unsigned c = 0; c < i_channels; c++ )
+    {
+        float *p_run = &p_sys->p_work[c * p_sys->i_work_size + p_sys->i_work];
+        for( size_t i = 0; i < i_frames; i++ )
+            p_run[i] = p_in[i * i_channels + c];
+    }
+    p_sys->i_work += i_frames;
+
+    /* Every output moves forward by in / out input samples */
+    const size_t i_max = (uint64_t)p_sys->i_work * i_out_rate / i_in_rate + 2;
+    block_t *p_out_buf = block_Alloc( i_max * i_channels * sizeof (float) );
+    if( unlikely(p_out_buf == NULL) )
+        return NULL;
+
+    float *p_out = (float *)p_out_buf->p_buffer;
+    size_t i_out;
+    if( p_sys->p_bank == NULL )
+        i_out = RunCopy( p_sys, p_out, i_channels );
+    else if( p_sys->p_bank == &p_sys->exact )
+        i_out = RunExact( p_sys, p_out, i_channels );
+    else
+        i_out = RunInterp( p_sys, p_out, i_channels, i_in_rate, i_out_rate );
+    assert( i_out <= i_max );
+
+    Shrink( p_sys, i_channels );
+
+    p_out_buf->i_nb_samples = i_out;
+    p_out_buf->i_buffer = i_out * i_channels * sizeof (float);
+    p_out_buf->i_dts =
+    p_out_buf->i_pts = date_Get( &p_sys->end_date );
+    p_out_buf->i_length = date_Increment( &p_sys->end_date, i_out )
+                        - p_out_buf->i_pts;
+    return p_out_buf;
+}
+
+/*****************************************************************************
+ * Resample: convert a buffer
+ *****************************************************************************/
+static block_t *Resample( filter_t *p_filter, block_t *p_in_buf )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+
+    if( !p_in_buf->i_nb_samples )
+    {
+        block_Release( p_in_buf );
+        return NULL;
+    }
+
+    const bool b_discontinuity =
+        p_sys->b_first || (p_in_buf->i_flags & BLOCK_FLAG_DISCONTINUITY);
+    if( b_discontinuity )
+    {
+        /* Continuity in sound samples has been broken, we'd better reset
+         * everything. */
+        if( Reset( p_filter, p_in_buf->i_pts ) )
         {
-            temp = t;
-            temp *= *(p_in+i);  /* Mult coeff by input sample */
-            *(p_out+i) += temp; /* The filter output */
+            block_Release( p_in_buf );
+            return NULL;
         }
+        p_sys->b_first = false;
+    }
+
+    block_t *p_out_buf = Process( p_filter, (const float *)p_in_buf->p_buffer,
+                                  p_in_buf->i_nb_samples );
+    block_Release( p_in_buf );
+
+    if( p_out_buf != NULL && b_discontinuity )
+        p_out_buf->i_flags |= BLOCK_FLAG_DISCONTINUITY;
+    return p_out_buf;
+}
 
-        ui_counter++;
+/*****************************************************************************
+ * Drain: output the samples still in the filter
+ *****************************************************************************/
+static block_t *Drain( filter_t *p_filter )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
 
-        /* Filter coeff step */
-        Hp = Imp + ((ui_output_rate * ui_counter + ui_remainder)<< Nhc)
-                    / ui_input_rate;
-        /* Filter coeff differences step */
-        Hdp = ImpD + ((ui_output_rate * ui_counter + ui_remainder)<< Nhc)
-                     / ui_input_rate;
+    if( p_sys->b_first || p_sys->p_bank == NULL )
+        return NULL;
 
-        p_in += (Inc * i_nb_channels); /* Input signal step */
-    }
+    /* Enough silence for the outputs up to the last input sample */
+    const unsigned i_channels = p_filter->fmt_in.audio.i_channels;
+    const size_t i_frames = p_sys->p_bank->i_taps - Half( p_sys->p_bank ) - 1;
+    float *p_zero = calloc( i_frames * i_channels, sizeof (float) );
+    if( unlikely(p_zero == NULL) )
+        return NULL;
+
+    block_t *p_out_buf = Process( p_filter, p_zero, i_frames );
+    free( p_zero );
+
+    p_sys->b_first = true;
+    return p_out_buf;
 }
 
-static int ReallocBuffer( block_t **pp_out_buf,
-                          float **pp_out, size_t i_out,
-                          int i_nb_channels, int i_bytes_per_frame )
+static void Flush( filter_t *p_filter )
 {
-    if( i_out < (*pp_out_buf)->i_buffer/i_bytes_per_frame )
-        return VLC_SUCCESS;
+    p_filter->p_sys->b_first = true;
+}
 
-    /* It may happen when the wing size changes */
-    const unsigned i_extra_frame = 256;
-    *pp_out_buf = block_Realloc( *pp_out_buf, 0,
-                                 (*pp_out_buf)->i_buffer +
-                                    i_extra_frame * i_bytes_per_frame );
-    if( !*pp_out_buf )
+/*****************************************************************************
+ * Open:
+ *****************************************************************************/
+static int Open( vlc_object_t *p_this, bool b_variable )
+{
+    filter_t *p_filter = (filter_t *)p_this;
+    const unsigned i_in_rate = p_filter->fmt_in.audio.i_rate;
+    const unsigned i_out_rate = p_filter->fmt_out.audio.i_rate;
+
+    if( p_filter->fmt_in.audio.i_format != p_filter->fmt_out.audio.i_format
+     || p_filter->fmt_in.audio.i_channels != p_filter->fmt_out.audio.i_channels
+     || p_filter->fmt_in.audio.i_format != VLC_CODEC_FL32
+     || i_in_rate == 0 || i_out_rate == 0 )
         return VLC_EGENERIC;
 
-    *pp_out = (float*)(*pp_out_buf)->p_buffer + i_out * i_nb_channels;
-    memset( *pp_out, 0, i_extra_frame * i_bytes_per_frame );
+    filter_sys_t *p_sys = calloc( 1, sizeof (*p_sys) );
+    if( unlikely(p_sys == NULL) )
+        return VLC_ENOMEM;
+    p_filter->p_sys = p_sys;
+
+    InitKernels( p_sys, true );
+
+    /* The exact bank of the nominal rates, and the interpolated one for the
+     * adjustments of the audio output, so as not to compute it on the fly */
+    int ret = VLC_SUCCESS;
+    if( i_in_rate != i_out_rate )
+        ret = BankInitExact( &p_sys->exact, i_in_rate, i_out_rate );
+    if( ret == VLC_ENOMEM
+     || ( ( ret != VLC_SUCCESS || b_variable )
+       && BankInitInterp( &p_sys->interp, i_in_rate, i_out_rate ) ) )
+    {
+        Close( p_this );
+        return VLC_ENOMEM;
+    }
+    UpdateKeep( p_sys );
+    p_sys->b_first = true;
+
+    p_filter->pf_audio_filter = Resample;
+    p_filter->pf_audio_drain = Drain;
+    p_filter->pf_flush = Flush;
+
+    msg_Dbg( p_this, "%4.4s/%iKHz/%i->%4.4s/%iKHz/%i, %u phases of %u taps",
+             (char *)&p_filter->fmt_in.i_codec,
+             p_filter->fmt_in.audio.i_rate,
+             p_filter->fmt_in.audio.i_channels,
+             (char *)&p_filter->fmt_out.i_codec,
+             p_filter->fmt_out.audio.i_rate,
+             p_filter->fmt_out.audio.i_channels,
+             p_sys->exact.p_coefs ? p_sys->exact.i_phases : BANK_PHASES,
+             p_sys->exact.p_coefs ? p_sys->exact.i_taps : p_sys->interp.i_taps );
+
+    p_filter->fmt_out = p_filter->fmt_in;
+    p_filter->fmt_out.audio.i_rate = i_out_rate;
+
     return VLC_SUCCESS;
 }
 
-static void ResampleFloat( filter_t *p_filter,
-                           block_t **pp_out_buf,  size_t *pi_out,
-                           float **pp_in,
-                           int i_in, int i_in_end,
-                           double d_factor, bool b_factor_old,
-                           int i_nb_channels, int i_bytes_per_frame )
+static int OpenConverter( vlc_object_t *p_this )
 {
+    filter_t *p_filter = (filter_t *)p_this;
+
+    if( p_filter->fmt_in.audio.i_rate == p_filter->fmt_out.audio.i_rate )
+        return VLC_EGENERIC;
+    return Open( p_this, false );
+}
+
+static int OpenResampler( vlc_object_t *p_this )
+{
+    /* The input rate may be the output one, and follow the adjustments of
+     * the audio output */
+    return Open( p_this, true );
+}
+
+/*****************************************************************************
+ * Close : deallocate data structures
+ *****************************************************************************/
+static void Close( vlc_object_t *p_this )
+{
+    filter_t *p_filter = (filter_t *)p_this;
     filter_sys_t *p_sys = p_filter->p_sys;
 
-    float *p_in = *pp_in;
-    size_t i_out = *pi_out;
-    float *p_out = (float*)(*pp_out_buf)->p_buffer + i_out * i_nb_channels;
+    BankClean( &p_sys->exact );
+    BankClean( &p_sys->interp );
+    free( p_sys->p_work );
+    free( p_sys );
+}
+
+#ifdef BANDLIMITED_TEST
+#include <stdio.h>
+#include <unistd.h>
+#ifdef BANDLIMITED_TEST_SOXR
+# include <soxr.h>
+#endif
+
+/* Offline checks of the quality, of the continuity across blocks and rate
+ * adjustments, then speed of the resampler on request, with SoX's if
+ * available. */
 
-    for( ; i_in < i_in_end; i_in++ )
+static const struct
+{
+    unsigned in, out;
+} ratios[] = {
+    { 44100, 48000 },
+    { 48000, 44100 },
+    { 48000, 96000 },
+    { 96000, 44100 },
+    { 44100, 48003 }, /* no exact bank */
+};
+
+static void Setup( filter_t *filter, unsigned in, unsigned out,
+                   unsigned channels, bool variable, bool optimized )
+{
+    memset( filter, 0, sizeof (*filter) );
+    filter->obj.flags = OBJECT_FLAGS_QUIET;
+    filter->fmt_in.i_codec = VLC_CODEC_FL32;
+    filter->fmt_in.audio.i_format = VLC_CODEC_FL32;
+    filter->fmt_in.audio.i_rate = in;
+    filter->fmt_in.audio.i_channels = channels;
+    filter->fmt_in.audio.i_bitspersample = 32;
+    filter->fmt_in.audio.i_bytes_per_frame = 4 * channels;
+    filter->fmt_in.audio.i_frame_length = 1;
+    filter->fmt_out = filter->fmt_in;
+    filter->fmt_out.audio.i_rate = out;
+
+    int ret = variable ? OpenResampler( VLC_OBJECT(filter) )
+                       : OpenConverter( VLC_OBJECT(filter) );
+    assert( ret == VLC_SUCCESS );
+    InitKernels( filter->p_sys, optimized );
+}
+
+static float *Tone( double freq, unsigned rate, unsigned channels,
+                    size_t frames )
+{
+    float *buf = vlc_alloc( frames * channels, sizeof (float) );
+    assert( buf != NULL );
+    for( size_t i = 0; i < frames; i++ )
+        for( unsigned ch = 0; ch < channels; ch++ )
+            buf[i * channels + ch] = .5 * sin( 2. * M_PI * freq * i / rate );
+    return buf;
+}
+
+static void Append( float **out, size_t *out_frames, block_t *block,
+                    unsigned channels )
+{
+    if( block == NULL )
+        return;
+    *out = realloc( *out, ( *out_frames + block->i_nb_samples ) * channels
+                          * sizeof (float) );
+    assert( *out != NULL );
+    memcpy( *out + *out_frames * channels, block->p_buffer, block->i_buffer );
+    *out_frames += block->i_nb_samples;
+    block_Release( block );
+}
+
+/* Runs the filter over the clip in blocks of random sizes up to max_block
+ * frames, with the input rate shifted by up to drift Hz every block */
+static float *Run( filter_t *filter, const float *in, size_t frames,
+                   size_t max_block, int drift, size_t *out_frames,
+                   mtime_t *time )
+{
+    const unsigned channels = filter->fmt_in.audio.i_channels;
+    const unsigned nominal = filter->fmt_in.audio.i_rate;
+    uint32_t seed = 0x5eed;
+    float *out = NULL;
+    *out_frames = 0;
+
+    mtime_t start = mdate();
+    for( size_t off = 0; off < frames; )
     {
-        if( b_factor_old && d_factor == 1 )
-        {
-            if( ReallocBuffer( pp_out_buf, &p_out,
-                               i_out, i_nb_channels, i_bytes_per_frame ) )
-                return;
-            /* Just copy the samples */
-            memcpy( p_out, p_in, i_bytes_per_frame );
-            p_in += i_nb_channels;
-            p_out += i_nb_channels;
-            i_out++;
-            continue;
-        }
+        seed = seed * 1664525 + 1013904223;
+        size_t len = max_block > 1 ? 1 + ( seed >> 8 ) % max_block : 1024;
+        len = __MIN( len, frames - off );
+
+        block_t *block = block_Alloc( len * channels * sizeof (float) );
+        assert( block != NULL );
+        memcpy( block->p_buffer, in + off * channels, block->i_buffer );
+        block->i_nb_samples = len;
+        block->i_pts = VLC_TS_0 + off * CLOCK_FREQ / nominal;
+        if( drift )
+            filter->fmt_in.audio.i_rate =
+                nominal + (int)( ( seed >> 4 ) % ( 2 * drift + 1 ) ) - drift;
+
+        Append( &out, out_frames, Resample( filter, block ), channels );
+        filter->fmt_in.audio.i_rate = nominal;
+        off += len;
+    }
+    Append( &out, out_frames, Drain( filter ), channels );
+    if( time != NULL )
+        *time += mdate() - start;
+    return out;
+}
 
-        while( p_sys->i_remainder < p_filter->fmt_out.audio.i_rate )
-        {
-            if( ReallocBuffer( pp_out_buf, &p_out,
-                               i_out, i_nb_channels, i_bytes_per_frame ) )
-                return;
+/* Least squares fit of the tone to the middle of the output, in dB of the
+ * tone over the residual; the phase is that of the tone at the first
+ * output sample, which should be 0 */
+static double ToneSNR( const float *buf, size_t frames, unsigned channels,
+                       double freq, unsigned rate, double *phase )
+{
+    const double w = 2. * M_PI * freq / rate;
+    const size_t from = frames / 8, to = frames - frames / 8;
+    double ss = 0, sc = 0, cc = 0, ys = 0, yc = 0;
 
-            if( d_factor >= 1 )
-            {
-                /* FilterFloatUP() is faster if we can use it */
-
-                /* Perform left-wing inner product */
-                FilterFloatUP( SMALL_FILTER_FLOAT_IMP, SMALL_FILTER_FLOAT_IMPD,
-                               SMALL_FILTER_NWING, p_in, p_out,
-                               p_sys->i_remainder,
-                               p_filter->fmt_out.audio.i_rate,
-                               -1, i_nb_channels );
-                /* Perform right-wing inner product */
-                FilterFloatUP( SMALL_FILTER_FLOAT_IMP, SMALL_FILTER_FLOAT_IMPD,
-                               SMALL_FILTER_NWING, p_in + i_nb_channels, p_out,
-                               p_filter->fmt_out.audio.i_rate -
-                               p_sys->i_remainder,
-                               p_filter->fmt_out.audio.i_rate,
-                               1, i_nb_channels );
-
-#if 0
-                /* Normalize for unity filter gain */
-                for( i = 0; i < i_nb_channels; i++ )
-                {
-                    *(p_out+i) *= d_old_scale_factor;
-                }
-#endif
-            }
-            else
-            {
-                /* Perform left-wing inner product */
-                FilterFloatUD( SMALL_FILTER_FLOAT_IMP, SMALL_FILTER_FLOAT_IMPD,
-                               SMALL_FILTER_NWING, p_in, p_out,
-                               p_sys->i_remainder,
-                               p_filter->fmt_out.audio.i_rate, p_filter->fmt_in.audio.i_rate,
-                               -1, i_nb_channels );
-                /* Perform right-wing inner product */
-                FilterFloatUD( SMALL_FILTER_FLOAT_IMP, SMALL_FILTER_FLOAT_IMPD,
-                               SMALL_FILTER_NWING, p_in + i_nb_channels, p_out,
-                               p_filter->fmt_out.audio.i_rate -
-                               p_sys->i_remainder,
-                               p_filter->fmt_out.audio.i_rate, p_filter->fmt_in.audio.i_rate,
-                               1, i_nb_channels );
-            }
+    for( size_t i = from; i < to; i++ )
+    {
+        const double s = sin( w * i ), c = cos( w * i );
+        const double y = buf[i * channels];
+        ss += s * s; sc += s * c; cc += c * c;
+        ys += y * s; yc += y * c;
+    }
+    const double det = ss * cc - sc * sc;
+    const double a = ( ys * cc - yc * sc ) / det;
+    const double b = ( yc * ss - ys * sc ) / det;
+
+    double signal = 0, noise = 0;
+    for( size_t i = from; i < to; i++ )
+    {
+        const double fit = a * sin( w * i ) + b * cos( w * i );
+        const double y = buf[i * channels];
+        signal += fit * fit;
+        noise += ( y - fit ) * ( y - fit );
+    }
+    if( phase != NULL )
+        *phase = atan2( b, a );
+    return 10. * log10( signal / noise );
+}
 
-            p_out += i_nb_channels;
-            i_out++;
+/* Level of the output relative to the input, in dB */
+static double Gain( const float *in, size_t in_frames, const float *out,
+                    size_t out_frames, unsigned channels )
+{
+    double ein = 0, eout = 0;
+    for( size_t i = in_frames / 8; i < in_frames - in_frames / 8; i++ )
+        ein += (double)in[i * channels] * in[i * channels];
+    for( size_t i = out_frames / 8; i < out_frames - out_frames / 8; i++ )
+        eout += (double)out[i * channels] * out[i * channels];
+    return 10. * log10( ( eout / ( out_frames - out_frames / 4 ) )
+                      / ( ein / ( in_frames - in_frames / 4 ) ) );
+}
 
-            p_sys->i_remainder += p_filter->fmt_in.audio.i_rate;
+/* Largest second difference of the output, to detect clicks */
+static double MaxCurvature( const float *buf, size_t frames, unsigned channels )
+{
+    double max = 0;
+    for( size_t i = frames / 8; i < frames - frames / 8; i++ )
+        max = __MAX( max, fabs( buf[( i + 1 ) * channels]
+                                - 2. * buf[i * channels]
+                                + buf[( i - 1 ) * channels] ) );
+    return max;
+}
+
+#ifdef BANDLIMITED_TEST_SOXR
+static float *RunSoXR( unsigned in_rate, unsigned out_rate, unsigned channels,
+                       unsigned long recipe, const float *in, size_t frames,
+                       size_t *out_frames, mtime_t *time )
+{
+    soxr_error_t error;
+    soxr_io_spec_t io_spec = soxr_io_spec( SOXR_FLOAT32_I, SOXR_FLOAT32_I );
+    soxr_quality_spec_t q_spec = soxr_quality_spec( recipe, 0 );
+    soxr_t soxr = soxr_create( in_rate, out_rate, channels, &error, &io_spec,
+                               &q_spec, NULL );
+    assert( soxr != NULL && !error );
+
+    size_t max = (uint64_t)frames * out_rate / in_rate + 4096;
+    float *out = vlc_alloc( max * channels, sizeof (float) );
+    assert( out != NULL );
+    *out_frames = 0;
+
+    mtime_t start = mdate();
+    for( size_t off = 0; off <= frames; off += 1024 )
+    {
+        size_t len = __MIN( 1024, frames - off ), idone, odone;
+        error = soxr_process( soxr, len ? in + off * channels : NULL, len,
+                              &idone, out + *out_frames * channels,
+                              max - *out_frames, &odone );
+        assert( !error && idone == len );
+        *out_frames += odone;
+    }
+    *time += mdate() - start;
+    soxr_delete( soxr );
+    return out;
+}
+#endif
+
+/* Checks the quality of a conversion, and prints its speed if asked, along
+ * with the one of SoX when available */
+static int TestRatio( unsigned in_rate, unsigned out_rate, bool b_bench )
+{
+    const unsigned channels = 2, seconds = 4;
+    const size_t frames = seconds * in_rate;
+    const unsigned low = __MIN( in_rate, out_rate );
+    int errors = 0;
+    filter_t filter;
+    size_t n;
+
+    /* A tone in the middle of the pass band, at its end, and beyond the
+     * lowest Nyquist frequency */
+    const double mid = 1000., high = .9 * low / 2, alias = 1.04 * low / 2;
+    double snr[2], snr_high, att, phase;
+    mtime_t times[2] = { 0, 0 };
+    float *out[2];
+
+    float *in = Tone( mid, in_rate, channels, frames );
+    for( int k = 0; k < 2; k++ )
+    {
+        Setup( &filter, in_rate, out_rate, channels, false, k );
+        out[k] = Run( &filter, in, frames, 0, 0, &n, &times[k] );
+        /* Every input sample is output, and nothing more */
+        assert( n >= (uint64_t)frames * out_rate / in_rate
+             && n <= (uint64_t)frames * out_rate / in_rate + 1 );
+        snr[k] = ToneSNR( out[k], n, channels, mid, out_rate, &phase );
+        if( fabs( phase ) > 1e-4 )
+        {
+            fprintf( stderr, "%u -> %u: tone phase %g\n", in_rate, out_rate,
+                     phase );
+            errors++;
         }
+        Close( VLC_OBJECT(&filter) );
+    }
+    for( size_t i = 0; i < n * channels; i++ )
+        assert( fabsf( out[0][i] - out[1][i] ) < 1e-5f );
+    free( out[0] );
+    free( out[1] );
+    free( in );
+
+    /* The output does not depend on the size of the blocks */
+    in = Tone( mid, in_rate, channels, frames / 4 );
+    Setup( &filter, in_rate, out_rate, channels, false, true );
+    size_t n1, n2;
+    float *one = Run( &filter, in, frames / 4, 0, 0, &n1, NULL );
+    float *many = Run( &filter, in, frames / 4, 3000, 0, &n2, NULL );
+    assert( n1 == n2 );
+    assert( memcmp( one, many, n1 * channels * sizeof (float) ) == 0 );
+    free( one );
+    free( many );
+    Close( VLC_OBJECT(&filter) );
+    free( in );
+
+    in = Tone( high, in_rate, channels, frames );
+    Setup( &filter, in_rate, out_rate, channels, false, true );
+    float *buf = Run( &filter, in, frames, 0, 0, &n, NULL );
+    snr_high = ToneSNR( buf, n, channels, high, out_rate, NULL );
+    free( buf );
+    Close( VLC_OBJECT(&filter) );
+    free( in );
+
+    in = Tone( alias, in_rate, channels, frames );
+    Setup( &filter, in_rate, out_rate, channels, false, true );
+    buf = Run( &filter, in, frames, 0, 0, &n, NULL );
+    att = in_rate > out_rate ? Gain( in, frames, buf, n, channels ) : -INFINITY;
+    free( buf );
+    Close( VLC_OBJECT(&filter) );
+    free( in );
+
+    if( snr[0] < 90. || snr[1] < 90. || snr_high < 85. || att > -90. )
+    {
+        fprintf( stderr, "%u -> %u: SNR %.1f/%.1f dB, %.0f Hz SNR %.1f dB, "
+                 "%.0f Hz %.1f dB\n", in_rate, out_rate, snr[0], snr[1],
+                 high, snr_high, alias, att );
+        errors++;
+    }
+
+    if( !b_bench )
+        return errors;
 
-        p_in += i_nb_channels;
-        p_sys->i_remainder -= p_filter->fmt_out.audio.i_rate;
+    const double clip_time = seconds * (double)CLOCK_FREQ;
+    printf( "%5u -> %5u Hz: %.1f dB SNR, %.0f Hz %.1f dB SNR", in_rate,
+            out_rate, snr[1], high, snr_high );
+    if( in_rate > out_rate )
+        printf( ", %.0f Hz %.1f dB", alias, att );
+    printf( ", C %.0fx, optimized %.0fx realtime\n",
+            clip_time / times[0], clip_time / times[1] );
+
+#ifdef BANDLIMITED_TEST_SOXR
+    static const struct
+    {
+        unsigned long recipe;
+        const char *name;
+    } recipes[] = { { SOXR_MQ, "MQ" }, { SOXR_HQ, "HQ" } };
+
+    for( size_t r = 0; r < ARRAY_SIZE(recipes); r++ )
+    {
+        mtime_t time = 0;
+        in = Tone( mid, in_rate, channels, frames );
+        buf = RunSoXR( in_rate, out_rate, channels, recipes[r].recipe, in,
+                       frames, &n, &time );
+        double soxr_snr = ToneSNR( buf, n, channels, mid, out_rate, NULL );
+        free( buf );
+        free( in );
+
+        in = Tone( high, in_rate, channels, frames );
+        buf = RunSoXR( in_rate, out_rate, channels, recipes[r].recipe, in,
+                       frames, &n, &time );
+        double soxr_high = ToneSNR( buf, n, channels, high, out_rate, NULL );
+        free( buf );
+        free( in );
+
+        printf( "  soxr %s: %.1f dB SNR, %.0f Hz %.1f dB SNR, %.0fx realtime\n",
+                recipes[r].name, soxr_snr, high, soxr_high,
+                2 * clip_time / time );
     }
+#endif
+    return errors;
+}
 
-    *pp_in  = p_in;
-    *pi_out = i_out;
+/* The audio output shifts the input rate by a few Hz to catch up a drift */
+static int TestDrift( unsigned in_rate, unsigned out_rate, int drift )
+{
+    const unsigned channels = 2;
+    const size_t frames = 4 * in_rate;
+    const double freq = 1000.;
+    filter_t filter;
+    size_t n;
+    int errors = 0;
+
+    float *in = Tone( freq, in_rate, channels, frames );
+    Setup( &filter, in_rate, out_rate, channels, true, true );
+    float *out = Run( &filter, in, frames, 2048, drift, &n, NULL );
+
+    /* Smooth, without clicks where the bank or the rate changes */
+    const double w = 2. * M_PI * freq * ( in_rate + drift ) / out_rate / in_rate;
+    const double curvature = MaxCurvature( out, n, channels );
+    if( curvature > .5 * w * w * 1.1 )
+    {
+        fprintf( stderr, "%u -> %u, drift %d: curvature %g over %g\n",
+                 in_rate, out_rate, drift, curvature, .5 * w * w );
+        errors++;
+    }
+    double expected = (double)frames * out_rate / in_rate;
+    assert( fabs( n - expected ) < expected * drift / in_rate + 2 );
+
+    printf( "%5u -> %5u Hz, +/-%d Hz drift: no clicks, %zu frames out\n",
+            in_rate, out_rate, drift, n );
+    free( out );
+    free( in );
+    Close( VLC_OBJECT(&filter) );
+    return errors;
 }
 
+int main( int argc, char *argv[] )
+{
+    /* bandlimited_test bench: also prints the speed of the conversions */
+    const bool b_bench = argc > 1 && !strcmp( argv[1], "bench" );
+    int errors = 0;
 
+    alarm( 120 );
+    for( size_t i = 0; i < ARRAY_SIZE(ratios); i++ )
+        errors += TestRatio( ratios[i].in, ratios[i].out, b_bench );
+
+    errors += TestDrift( 48000, 48000, 5 );
+    errors += TestDrift( 44100, 48000, 3 );
+    errors += TestDrift( 48000, 44100, 20 );
+
+    return errors ? 1 : 0;
+}
+#endif
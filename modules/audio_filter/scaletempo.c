@@ -28,16 +28,28 @@
 # include "config.h"
 #endif
 
+#ifdef SCALETEMPO_TEST
+# undef NDEBUG
+#endif
+
 #include <vlc_common.h>
 #include <vlc_plugin.h>
 #include <vlc_aout.h>
 #include <vlc_filter.h>
 #include <vlc_modules.h>
 #include <vlc_atomic.h>
+#include <vlc_cpu.h>
+#include <vlc_fft.h>
 
+#include <assert.h>
+#include <math.h>
 #include <string.h> /* for memset */
 #include <limits.h> /* form INT_MIN */
 
+#ifdef HAVE_SSE2_INTRINSICS
+# include <xmmintrin.h>
+#endif
+
 /*****************************************************************************
  * Module descriptor
  *****************************************************************************/
@@ -89,6 +101,8 @@ vlc_module_end ()
  * Scaletempo smooths the overlap further by searching within the input buffer
  * for the best overlap position.  Scaletempo uses a statistical cross correlation
  * (roughly a dot-product).  Scaletempo consumes most of its CPU cycles here.
+ * With long overlaps and search windows, the correlation of every offset is
+ * computed at once in the frequency domain instead.
  *
  * NOTE:
  * sample: a single audio sample for one channel
@@ -130,6 +144,18 @@ struct filter_sys_t
     void     *buf_pre_corr;
     void     *table_window;
     unsigned(*best_overlap_offset)( filter_t *p_filter );
+    /* FFT overlap search */
+    unsigned  fft_size;
+    vlc_fft_t *fft;         /* complex, both inputs of a channel */
+    vlc_fft_t *fft_real;    /* real, inverse of the cross spectrum */
+    float    *fft_buf;      /* complex, overlap + i * search window of a channel */
+    float    *fft_acc;      /* complex, cross spectrum of all channels */
+    float    *fft_corr;     /* real, correlations */
+    /* kernels */
+    void    (*window)( float *, const float *, const float *, unsigned );
+    float   (*correlate)( const float *, const float *, unsigned );
+    void    (*blend)( float *, const float *, const float *, const float *,
+                      unsigned );
 #ifdef PITCH_SHIFTER
     /* pitch */
     filter_t * resampler;
@@ -137,33 +163,121 @@ struct filter_sys_t
 #endif
 };
 
+/*****************************************************************************
+ * kernels: inner loops of the overlap search and blending
+ *****************************************************************************/
+static void window_c( float *restrict dst, const float *restrict w,
+                      const float *restrict src, unsigned n )
+{
+    for( unsigned i = 0; i < n; i++ )
+        dst[i] = w[i] * src[i];
+}
+
+static float correlate_c( const float *a, const float *b, unsigned n )
+{
+    float corr = 0;
+    for( unsigned i = 0; i < n; i++ )
+        corr += a[i] * b[i];
+    return corr;
+}
+
+static void blend_c( float *restrict out, const float *restrict po,
+                     const float *restrict pb, const float *restrict pin,
+                     unsigned n )
+{
+    for( unsigned i = 0; i < n; i++ )
+        out[i] = po[i] - pb[i] * ( po[i] - pin[i] );
+}
+
+#ifdef HAVE_SSE2_INTRINSICS
+VLC_SSE
+static void window_sse( float *restrict dst, const float *restrict w,
+                        const float *restrict src, unsigned n )
+{
+    unsigned i = 0;
+    for( ; i + 4 <= n; i += 4 )
+        _mm_storeu_ps( dst + i, _mm_mul_ps( _mm_loadu_ps( w + i ),
+                                            _mm_loadu_ps( src + i ) ) );
+    for( ; i < n; i++ )
+        dst[i] = w[i] * src[i];
+}
+
+VLC_SSE
+static float correlate_sse( const float *a, const float *b, unsigned n )
+{
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    unsigned i = 0;
+    for( ; i + 8 <= n; i += 8 )
+    {
+        acc0 = _mm_add_ps( acc0, _mm_mul_ps( _mm_loadu_ps( a + i ),
+                                             _mm_loadu_ps( b + i ) ) );
+        acc1 = _mm_add_ps( acc1, _mm_mul_ps( _mm_loadu_ps( a + i + 4 ),
+                                             _mm_loadu_ps( b + i + 4 ) ) );
+    }
+
+    float sum[4];
+    _mm_storeu_ps( sum, _mm_add_ps( acc0, acc1 ) );
+    float corr = ( sum[0] + sum[1] ) + ( sum[2] + sum[3] );
+    for( ; i < n; i++ )
+        corr += a[i] * b[i];
+    return corr;
+}
+
+VLC_SSE
+static void blend_sse( float *restrict out, const float *restrict po,
+                       const float *restrict pb, const float *restrict pin,
+                       unsigned n )
+{
+    unsigned i = 0;
+    for( ; i + 4 <= n; i += 4 )
+    {
+        __m128 o = _mm_loadu_ps( po + i );
+        __m128 d = _mm_sub_ps( o, _mm_loadu_ps( pin + i ) );
+        _mm_storeu_ps( out + i,
+                       _mm_sub_ps( o, _mm_mul_ps( _mm_loadu_ps( pb + i ), d ) ) );
+    }
+    for( ; i < n; i++ )
+        out[i] = po[i] - pb[i] * ( po[i] - pin[i] );
+}
+#endif
+
+static void init_kernels( filter_sys_t *p, bool optimized )
+{
+    p->window    = window_c;
+    p->correlate = correlate_c;
+    p->blend     = blend_c;
+#ifdef HAVE_SSE2_INTRINSICS
+    if( optimized && vlc_CPU_SSE() )
+    {
+        p->window    = window_sse;
+        p->correlate = correlate_sse;
+        p->blend     = blend_sse;
+    }
+#else
+    VLC_UNUSED( optimized );
+#endif
+}
+
 /*****************************************************************************
  * best_overlap_offset: calculate best offset for overlap
  *****************************************************************************/
 static unsigned best_overlap_offset_float( filter_t *p_filter )
 {
     filter_sys_t *p = p_filter->p_sys;
-    float *pw, *po, *ppc, *search_start;
+    const unsigned samples_corr = p->samples_overlap - p->samples_per_frame;
+    float *ppc = p->buf_pre_corr;
+    float *search_start;
     float best_corr = INT_MIN;
     unsigned best_off = 0;
-    unsigned i, off;
-
-    pw  = p->table_window;
-    po  = p->buf_overlap;
-    po += p->samples_per_frame;
-    ppc = p->buf_pre_corr;
-    for( i = p->samples_per_frame; i < p->samples_overlap; i++ ) {
-      *ppc++ = *pw++ * *po++;
-    }
+    unsigned off;
+
+    p->window( ppc, p->table_window,
+               (float *)p->buf_overlap + p->samples_per_frame, samples_corr );
 
     search_start = (float *)p->buf_queue + p->samples_per_frame;
     for( off = 0; off < p->frames_search; off++ ) {
-      float corr = 0;
-      float *ps = search_start;
-      ppc = p->buf_pre_corr;
-      for( i = p->samples_per_frame; i < p->samples_overlap; i++ ) {
-        corr += *ppc++ * *ps++;
-      }
+      float corr = p->correlate( ppc, search_start, samples_corr );
       if( corr > best_corr ) {
         best_corr = corr;
         best_off  = off;
@@ -174,6 +288,147 @@ static unsigned best_overlap_offset_float( filter_t *p_filter )
     return best_off * p->bytes_per_frame;
 }
 
+/*****************************************************************************
+ * best_overlap_offset_fft: same as above, in the frequency domain
+ *****************************************************************************
+ * The correlation of each channel is the inverse transform of the product of
+ * the spectrum of the search window with the conjugate spectrum of the
+ * windowed overlap. The products of all channels are summed before a single
+ * inverse transform. Both real inputs of a channel share one complex FFT.
+ *
+ * The offsets that come within the rounding error of the transform from the
+ * best one are then correlated directly, so that the result matches the
+ * direct search.
+ *****************************************************************************/
+/* Relative to the product of the norms of the inputs */
+#define SCALETEMPO_FFT_TOLERANCE 3e-5f
+
+static unsigned best_overlap_offset_fft( filter_t *p_filter )
+{
+    filter_sys_t *p = p_filter->p_sys;
+    const unsigned n = p->fft_size;
+    const unsigned spf = p->samples_per_frame;
+    const unsigned frames_corr = p->samples_overlap / spf - 1;
+    const unsigned frames_in = p->frames_search + frames_corr - 1;
+    const float *ppc = p->buf_pre_corr;
+    const float *ps = (float *)p->buf_queue + spf;
+    float *z = p->fft_buf;
+    float *acc = p->fft_acc;
+    float *corr = p->fft_corr;
+
+    p->window( p->buf_pre_corr, p->table_window,
+               (float *)p->buf_overlap + spf, frames_corr * spf );
+
+    float energy_pc = 0, energy_s = 0;
+    memset( acc, 0, ( n + 2 ) * sizeof (*acc) );
+    for( unsigned ch = 0; ch < spf; ch++ )
+    {
+        unsigned k = 0;
+        for( ; k < frames_corr; k++ )
+        {
+            z[2 * k]     = ppc[k * spf + ch];
+            z[2 * k + 1] = ps[k * spf + ch];
+            energy_pc += z[2 * k] * z[2 * k];
+            energy_s  += z[2 * k + 1] * z[2 * k + 1];
+        }
+        for( ; k < frames_in; k++ )
+        {
+            z[2 * k]     = 0;
+            z[2 * k + 1] = ps[k * spf + ch];
+            energy_s  += z[2 * k + 1] * z[2 * k + 1];
+        }
+        memset( z + 2 * k, 0, 2 * ( n - k ) * sizeof (*z) );
+
+        vlc_fft_Forward( p->fft, z, z );
+
+        /* With Z = X + iY, 2X = Z[k] + Z*[n-k] and 2iY = Z[k] - Z*[n-k].
+         * Only the first half of X* Y is needed as it is hermitian. */
+        for( k = 0; k <= n / 2; k++ )
+        {
+            unsigned m = k ? n - k : 0;
+            float xr = z[2 * k] + z[2 * m],     xi = z[2 * k + 1] - z[2 * m + 1];
+            float yr = z[2 * k + 1] + z[2 * m + 1], yi = z[2 * m] - z[2 * k];
+            acc[2 * k]     += xr * yr + xi * yi;
+            acc[2 * k + 1] += xr * yi - xi * yr;
+        }
+    }
+
+    /* The correlations are real: they are the inverse real transform of the
+     * first half of the spectrum. */
+    vlc_fft_Inverse( p->fft_real, acc, corr );
+
+    if( !( energy_pc * energy_s > 0 ) )
+        return 0; /* all correlations are null */
+
+    /* The transform scales the correlations by 4n */
+    float best_fft = corr[0];
+    for( unsigned off = 1; off < p->frames_search; off++ )
+        best_fft = __MAX( best_fft, corr[off] );
+    best_fft -= SCALETEMPO_FFT_TOLERANCE * 4.f * n
+              * sqrtf( energy_pc ) * sqrtf( energy_s );
+
+    float best_corr = INT_MIN;
+    unsigned best_off = 0;
+    for( unsigned off = 0; off < p->frames_search; off++ )
+    {
+        if( corr[off] < best_fft )
+            continue;
+        float corr = p->correlate( ppc, ps + off * spf, frames_corr * spf );
+        if( corr > best_corr )
+        {
+            best_corr = corr;
+            best_off  = off;
+        }
+    }
+
+    return best_off * p->bytes_per_frame;
+}
+
+/* Smallest transform size that holds the overlap and the search window
+ * without circular aliasing */
+static unsigned fft_size( const filter_sys_t *p, unsigned frames_overlap )
+{
+    unsigned n = 2;
+    while( n < p->frames_search + frames_overlap - 2
+        || !vlc_fft_IsSizeSupported( n, VLC_FFT_REAL ) )
+        n += 2;
+    return n;
+}
+
+/* Whether the FFT search costs less than the direct one: the latter takes
+ * one multiply-add per sample of the overlap and per searched offset, the
+ * former about (channels + 1) transforms of n points of n log2(n) butterfly
+ * operations each, which cost more than the vectorized multiply-adds. */
+static bool fft_search_cheaper( const filter_sys_t *p, unsigned frames_overlap )
+{
+    unsigned n = fft_size( p, frames_overlap ), log2n = 1;
+    while( ( 2u << log2n ) <= n )
+        log2n++;
+
+    uint64_t direct = (uint64_t)p->frames_search * ( frames_overlap - 1 )
+                    * p->samples_per_frame;
+    uint64_t fft = (uint64_t)( p->samples_per_frame + 1 ) * n * log2n
+                 * ( p->correlate == correlate_c ? 3 : 12 );
+    return fft < direct;
+}
+
+static int init_fft( filter_t *p_filter, unsigned frames_overlap )
+{
+    filter_sys_t *p = p_filter->p_sys;
+    unsigned n = fft_size( p, frames_overlap );
+
+    p->fft_size = n;
+    p->fft      = vlc_fft_New( p_filter, n, VLC_FFT_COMPLEX );
+    p->fft_real = vlc_fft_New( p_filter, n, VLC_FFT_REAL );
+    p->fft_buf  = vlc_alloc( 2 * n, sizeof (float) );
+    p->fft_acc  = vlc_alloc( n + 2, sizeof (float) );
+    p->fft_corr = vlc_alloc( n, sizeof (float) );
+    if( !p->fft || !p->fft_real || !p->fft_buf || !p->fft_acc || !p->fft_corr )
+        return VLC_ENOMEM;
+
+    return VLC_SUCCESS;
+}
+
 /*****************************************************************************
  * output_overlap: blend end of previous stride with beginning of current stride
  *****************************************************************************/
@@ -182,14 +437,8 @@ static void output_overlap_float( filter_t        *p_filter,
                                   unsigned         bytes_off )
 {
     filter_sys_t *p = p_filter->p_sys;
-    float *pout = buf_out;
-    float *pb   = p->table_blend;
-    float *po   = p->buf_overlap;
-    float *pin  = (float *)( p->buf_queue + bytes_off );
-    unsigned i;
-    for( i = 0; i < p->samples_overlap; i++ ) {
-        *pout++ = *po - *pb++ * ( *po - *pin++ ); po++;
-    }
+    p->blend( buf_out, p->buf_overlap, p->table_blend,
+              (float *)( p->buf_queue + bytes_off ), p->samples_overlap );
 }
 
 /*****************************************************************************
@@ -354,14 +603,23 @@ static int reinit_buffers( filter_t *p_filter )
         p->table_window = malloc( bytes_pre_corr );
         if( ! p->buf_pre_corr || ! p->table_window )
             return VLC_ENOMEM;
+        /* Normalized to a peak of 1, so that the windowed overlap has the
+         * magnitude of the searched samples it shares FFTs with */
         float *pw = p->table_window;
+        float norm = 4.f / ( (float)frames_overlap * frames_overlap );
         for( i = 1; i<frames_overlap; i++ )
         {
-            float v = i * ( frames_overlap - i );
+            float v = i * ( frames_overlap - i ) * norm;
             for( j = 0; j < p->samples_per_frame; j++ )
                 *pw++ = v;
         }
         p->best_overlap_offset = best_overlap_offset_float;
+        if( fft_search_cheaper( p, frames_overlap ) )
+        {
+            if( init_fft( p_filter, frames_overlap ) != VLC_SUCCESS )
+                return VLC_ENOMEM;
+            p->best_overlap_offset = best_overlap_offset_fft;
+        }
     }
 
     unsigned new_size = ( p->frames_search + frames_stride + frames_overlap ) * p->bytes_per_frame;
@@ -391,13 +649,14 @@ static int reinit_buffers( filter_t *p_filter )
     p->frames_stride_scaled = p->bytes_stride_scaled / p->bytes_per_frame;
 
     msg_Dbg( VLC_OBJECT(p_filter),
-             "%.3f scale, %.3f stride_in, %i stride_out, %i standing, %i overlap, %i search, %i queue, %s mode",
+             "%.3f scale, %.3f stride_in, %i stride_out, %i standing, %i overlap, %i search (%s), %i queue, %s mode",
              p->scale,
              p->frames_stride_scaled,
              (int)( p->bytes_stride / p->bytes_per_frame ),
              (int)( p->bytes_standing / p->bytes_per_frame ),
              (int)( p->bytes_overlap / p->bytes_per_frame ),
              p->frames_search,
+             p->best_overlap_offset == best_overlap_offset_fft ? "fft" : "direct",
              (int)( p->bytes_queue_max / p->bytes_per_frame ),
              "fl32");
 
@@ -440,10 +699,16 @@ static int Open( vlc_object_t *p_this )
     p_sys->table_blend    = NULL;
     p_sys->buf_pre_corr   = NULL;
     p_sys->table_window   = NULL;
+    p_sys->fft            = NULL;
+    p_sys->fft_real       = NULL;
+    p_sys->fft_buf        = NULL;
+    p_sys->fft_acc        = NULL;
+    p_sys->fft_corr       = NULL;
     p_sys->bytes_overlap  = 0;
     p_sys->bytes_queued   = 0;
     p_sys->bytes_to_slide = 0;
     p_sys->frames_stride_error = 0;
+    init_kernels( p_sys, true );
 
     if( reinit_buffers( p_filter ) != VLC_SUCCESS )
     {
@@ -536,6 +801,13 @@ static void Close( vlc_object_t *p_this )
     free( p_sys->table_blend );
     free( p_sys->buf_pre_corr );
     free( p_sys->table_window );
+    if( p_sys->fft != NULL )
+        vlc_fft_Delete( p_sys->fft );
+    if( p_sys->fft_real != NULL )
+        vlc_fft_Delete( p_sys->fft_real );
+    free( p_sys->fft_buf );
+    free( p_sys->fft_acc );
+    free( p_sys->fft_corr );
     free( p_sys );
 }
 
@@ -615,3 +887,241 @@ static block_t *DoPitchWork( filter_t * p_filter, block_t * p_in_buf )
     return DoWork( p_filter, p_in_buf );
 }
 #endif
+
+#ifdef SCALETEMPO_TEST
+#include <stdio.h>
+#include <unistd.h>
+
+/* Offline comparison of the overlap search implementations on synthetic
+ * reference clips: the FFT search must find offsets as good as the direct
+ * one, and the whole output must stay close to that of the plain C code.
+ * Their speed is measured on request. */
+
+static const struct
+{
+    unsigned ms_stride;
+    float    percent_overlap;
+    unsigned ms_search;
+} params[] = {
+    {  30, .20f, 14 }, /* defaults */
+    {  60, .50f, 30 },
+    { 100, .50f, 60 },
+};
+
+static const struct
+{
+    unsigned rate;
+    unsigned channels;
+} formats[] = {
+    { 44100, 2 },
+    { 48000, 1 },
+    { 48000, 6 },
+};
+
+static const double scales[] = { 0.5, 1.33, 2.0 };
+
+enum { CLIP_TONES, CLIP_SPEECH, CLIP_SWEEP, CLIP_MAX };
+static const char *const clip_names[] = { "tones", "speech", "sweep" };
+
+static float *Clip( int type, unsigned rate, unsigned channels, size_t frames )
+{
+    float *buf = vlc_alloc( frames * channels, sizeof (float) );
+    assert( buf != NULL );
+
+    uint32_t seed = 0x5eed;
+    float lp = 0;
+    for( size_t i = 0; i < frames; i++ )
+    {
+        const double t = (double)i / rate;
+        for( unsigned ch = 0; ch < channels; ch++ )
+        {
+            double v = 0;
+            switch( type )
+            {
+                case CLIP_TONES: /* harmonics with vibrato */
+                {
+                    double f = 220. * ( 1. + .01 * sin( 2. * M_PI * 5. * t ) );
+                    for( int h = 1; h <= 4; h++ )
+                        v += sin( 2. * M_PI * f * h * t + ch ) / ( 2 * h );
+                    break;
+                }
+                case CLIP_SPEECH: /* syllable modulated noise and pitch */
+                {
+                    seed = seed * 1664525 + 1013904223;
+                    lp += .2f * ( (int32_t)seed / 2147483648.f - lp );
+                    double env = .5 + .5 * sin( 2. * M_PI * 4. * t );
+                    v = env * ( lp + .3 * sin( 2. * M_PI * 140. * t ) );
+                    break;
+                }
+                case CLIP_SWEEP: /* 50 Hz to 5 kHz */
+                    v = .5 * sin( 2. * M_PI * ( 50. * t + 495. * t * t ) + ch );
+                    break;
+            }
+            buf[i * channels + ch] = v;
+        }
+    }
+    return buf;
+}
+
+static void Setup( filter_t *filter, unsigned rate, unsigned channels,
+                   size_t param, bool optimized )
+{
+    filter_sys_t *p = calloc( 1, sizeof (*p) );
+    assert( p != NULL );
+
+    memset( filter, 0, sizeof (*filter) );
+    filter->obj.flags = OBJECT_FLAGS_QUIET;
+    filter->p_sys = p;
+
+    p->scale             = 1.0;
+    p->sample_rate       = rate;
+    p->samples_per_frame = channels;
+    p->bytes_per_sample  = 4;
+    p->bytes_per_frame   = channels * 4;
+    p->ms_stride         = params[param].ms_stride;
+    p->percent_overlap   = params[param].percent_overlap;
+    p->ms_search         = params[param].ms_search;
+    init_kernels( p, optimized );
+    assert( reinit_buffers( filter ) == VLC_SUCCESS );
+}
+
+static void SetScale( filter_t *filter, double scale )
+{
+    filter_sys_t *p = filter->p_sys;
+    p->scale = scale;
+    p->bytes_stride_scaled  = p->bytes_stride * p->scale;
+    p->frames_stride_scaled = p->bytes_stride_scaled / p->bytes_per_frame;
+}
+
+static void ForceFFT( filter_t *filter )
+{
+    filter_sys_t *p = filter->p_sys;
+    if( p->best_overlap_offset != best_overlap_offset_fft )
+    {
+        assert( init_fft( filter, p->samples_overlap / p->samples_per_frame )
+                == VLC_SUCCESS );
+        p->best_overlap_offset = best_overlap_offset_fft;
+    }
+}
+
+/* Runs the filter over the clip, in blocks of 1024 frames */
+static float *Run( filter_t *filter, double scale, const float *in,
+                   size_t frames, size_t *out_frames, mtime_t *time )
+{
+    filter_sys_t *p = filter->p_sys;
+    const size_t block = 1024 * p->bytes_per_frame;
+    const size_t size = frames * p->bytes_per_frame;
+    size_t out_size = 0;
+
+    SetScale( filter, scale );
+    uint8_t *out = malloc( size / scale + 2 * p->bytes_queue_max );
+    assert( out != NULL );
+
+    mtime_t start = mdate();
+    for( size_t off = 0; off < size; off += block )
+    {
+        size_t len = __MIN( block, size - off );
+        size_t max = calculate_output_buffer_size( filter, len );
+        size_t done = transform_buffer( filter, (uint8_t *)in + off, len,
+                                        out + out_size );
+        assert( done <= max );
+        out_size += done;
+    }
+    *time += mdate() - start;
+    *out_frames = out_size / p->bytes_per_frame;
+    return (float *)out;
+}
+
+static double SNR( const float *ref, const float *test, size_t samples )
+{
+    double signal = 0, noise = 0;
+    for( size_t i = 0; i < samples; i++ )
+    {
+        signal += (double)ref[i] * ref[i];
+        noise += ( (double)ref[i] - test[i] ) * ( (double)ref[i] - test[i] );
+    }
+    return noise > 0 ? 10. * log10( signal / noise ) : INFINITY;
+}
+
+int main( int argc, char *argv[] )
+{
+    /* scaletempo_test <seconds>: also benchmarks clips of that length */
+    const bool bench = argc > 1;
+    const unsigned seconds = bench ? (unsigned)atoi( argv[1] ) : 1;
+    int errors = 0;
+
+    alarm( 120 );
+    for( size_t f = 0; f < ARRAY_SIZE(formats); f++ )
+    for( size_t i = 0; i < ARRAY_SIZE(params); i++ )
+    {
+        const unsigned rate = formats[f].rate, channels = formats[f].channels;
+        const size_t frames = seconds * rate;
+        /* direct and FFT search, with the C and optimized kernels */
+        filter_t filters[4];
+        mtime_t times[4] = { 0, 0, 0, 0 };
+        double snr[2] = { INFINITY, INFINITY };
+        bool chosen;
+
+        for( int k = 0; k < 4; k++ )
+        {
+            Setup( &filters[k], rate, channels, i, k >= 2 );
+            chosen = filters[k].p_sys->best_overlap_offset
+                     == best_overlap_offset_fft;
+            if( k & 1 )
+                ForceFFT( &filters[k] );
+            else
+                filters[k].p_sys->best_overlap_offset = best_overlap_offset_float;
+        }
+
+        for( int type = 0; type < CLIP_MAX; type++ )
+        for( size_t s = 0; s < ARRAY_SIZE(scales); s++ )
+        {
+            float *in = Clip( type, rate, channels, frames );
+            float *out[4];
+            size_t n[4];
+
+            for( int k = 0; k < 4; k++ )
+                out[k] = Run( &filters[k], scales[s], in, frames, &n[k],
+                              &times[k] );
+
+            /* The FFT search must pick the same offsets as the direct one
+             * with the same kernels, and thus output the same samples. */
+            for( int k = 0; k < 4; k += 2 )
+            {
+                assert( n[k] == n[k + 1] );
+                double v = SNR( out[k], out[k + 1], n[k] * channels );
+                snr[k / 2] = __MIN( snr[k / 2], v );
+                if( v < 60. )
+                {
+                    fprintf( stderr, "%s x%.2f: FFT output SNR %.1f dB\n",
+                             clip_names[type], scales[s], v );
+                    errors++;
+                }
+            }
+
+            for( int k = 0; k < 4; k++ )
+                free( out[k] );
+            free( in );
+        }
+
+        /* Realtime factor of the input consumed */
+        const double clip_time = CLIP_MAX * ARRAY_SIZE(scales) * seconds
+                               * (double)CLOCK_FREQ;
+        if( bench )
+            printf( "%5u Hz %u ch, %3u ms stride, %2.0f%% overlap, "
+                    "%2u ms search (%s): C direct %.0fx, FFT %.0fx "
+                    "(SNR %.0f dB), optimized direct %.0fx, FFT %.0fx "
+                    "(SNR %.0f dB) realtime\n",
+                    rate, channels, params[i].ms_stride,
+                    params[i].percent_overlap * 100, params[i].ms_search,
+                    chosen ? "fft" : "direct",
+                    clip_time / times[0], clip_time / times[1], snr[0],
+                    clip_time / times[2], clip_time / times[3], snr[1] );
+
+        for( int k = 0; k < 4; k++ )
+            Close( VLC_OBJECT(&filters[k]) );
+    }
+
+    return errors ? 1 : 0;
+}
+#endif
@@ -41,6 +41,7 @@
 #include <vlc_dialog.h>
 #include <vlc_avcodec.h>
 #include <vlc_cpu.h>
+#include <vlc_cpu_budget.h>
 
 #include <libavcodec/avcodec.h>
 #include <libavutil/channel_layout.h>
@@ -146,6 +147,8 @@ struct encoder_sys_t
     int        i_aac_profile; /* AAC profile to use.*/
 
     AVFrame    *frame;
+
+    vlc_cpu_lease_t *p_cpu_lease;
 };
 
 
@@ -862,6 +865,16 @@ int InitVideoEnc( vlc_object_t *p_this )
 
     if( p_enc->i_threads >= 1)
         p_context->thread_count = p_enc->i_threads;
+    else if( p_enc->fmt_out.i_cat == VIDEO_ES )
+    {
+        /* Share the CPU with the other codecs of the instance */
+        p_sys->p_cpu_lease = vlc_cpu_lease_Acquire( p_enc, "avcodec", 0 );
+        if( p_sys->p_cpu_lease != NULL )
+            p_context->thread_count =
+                vlc_cpu_lease_GetThreads( p_sys->p_cpu_lease );
+        else
+            p_context->thread_count = vlc_GetCPUCount();
+    }
     else
         p_context->thread_count = vlc_GetCPUCount();
 
@@ -1050,6 +1063,8 @@ errmsg:
 
     return VLC_SUCCESS;
 error:
+    if( p_sys->p_cpu_lease != NULL )
+        vlc_cpu_lease_Release( p_sys->p_cpu_lease );
     free( p_enc->fmt_out.p_extra );
     av_free( p_sys->p_buffer );
     av_free( p_sys->p_interleave_buf );
@@ -1462,5 +1477,7 @@ void EndVideoEnc( vlc_object_t *p_this )
     av_free( p_sys->p_interleave_buf );
     av_free( p_sys->p_buffer );
 
+    if( p_sys->p_cpu_lease != NULL )
+        vlc_cpu_lease_Release( p_sys->p_cpu_lease );
     free( p_sys );
 }
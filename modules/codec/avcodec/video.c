@@ -33,6 +33,7 @@
 #include <vlc_codec.h>
 #include <vlc_avcodec.h>
 #include <vlc_cpu.h>
+#include <vlc_cpu_budget.h>
 #include <vlc_atomic.h>
 #include <assert.h>
 
@@ -92,6 +93,9 @@ struct decoder_sys_t
     int level;
 
     vlc_sem_t sem_mt;
+
+    /* threads leased from the CPU budget, if automatic */
+    vlc_cpu_lease_t *p_cpu_lease;
 };
 
 static inline void wait_mt(decoder_sys_t *sys)
@@ -429,6 +433,11 @@ static int OpenVideoCodec( decoder_t *p_dec )
     {
         ctx->flags |= AV_CODEC_FLAG_LOW_DELAY;
     }
+    /* Output the pictures without waiting for the reordering delay */
+    if( var_InheritBool( p_dec, "low-latency-live" ) )
+    {
+        ctx->flags |= AV_CODEC_FLAG_LOW_DELAY;
+    }
 
     post_mt( p_sys );
     ret = ffmpeg_OpenCodec( p_dec, ctx, codec );
@@ -557,7 +566,8 @@ int InitVideoDec( vlc_object_t *obj )
     p_context->opaque = p_dec;
 
     int i_thread_count = var_InheritInteger( p_dec, "avcodec-threads" );
-    if( i_thread_count <= 0 )
+    const bool b_auto_threads = i_thread_count <= 0;
+    if( b_auto_threads )
     {
         i_thread_count = vlc_GetCPUCount();
         if( i_thread_count > 1 )
@@ -571,8 +581,6 @@ int InitVideoDec( vlc_object_t *obj )
 #endif
     }
     i_thread_count = __MIN( i_thread_count, p_codec->id == AV_CODEC_ID_HEVC ? 32 : 16 );
-    msg_Dbg( p_dec, "allowing %d thread(s) for decoding", i_thread_count );
-    p_context->thread_count = i_thread_count;
     p_context->thread_safe_callbacks = true;
 
     switch( p_codec->id )
@@ -595,6 +603,22 @@ int InitVideoDec( vlc_object_t *obj )
             break;
     }
 
+    /* Frame threads delay the output by one picture each */
+    if( var_InheritBool( p_dec, "low-latency-live" ) )
+        p_context->thread_type &= ~FF_THREAD_FRAME;
+
+    /* Share the CPU with the other decoders and encoders */
+    p_sys->p_cpu_lease = NULL;
+    if( b_auto_threads && p_context->thread_type != 0 && i_thread_count > 1 )
+    {
+        p_sys->p_cpu_lease = vlc_cpu_lease_Acquire( p_dec, "avcodec",
+                                                    i_thread_count );
+        if( p_sys->p_cpu_lease != NULL )
+            i_thread_count = vlc_cpu_lease_GetThreads( p_sys->p_cpu_lease );
+    }
+    msg_Dbg( p_dec, "allowing %d thread(s) for decoding", i_thread_count );
+    p_context->thread_count = i_thread_count;
+
     if( p_context->thread_type & FF_THREAD_FRAME )
         p_dec->i_extra_picture_buffers = 2 * p_context->thread_count;
 
@@ -630,6 +654,8 @@ int InitVideoDec( vlc_object_t *obj )
     /* ***** Open the codec ***** */
     if( OpenVideoCodec( p_dec ) < 0 )
     {
+        if( p_sys->p_cpu_lease != NULL )
+            vlc_cpu_lease_Release( p_sys->p_cpu_lease );
         vlc_sem_destroy( &p_sys->sem_mt );
         free( p_sys );
         avcodec_free_context( &p_context );
@@ -1293,6 +1319,8 @@ void EndVideoDec( vlc_object_t *obj )
     if( p_sys->p_va )
         vlc_va_Delete( p_sys->p_va, &hwaccel_context );
 
+    if( p_sys->p_cpu_lease != NULL )
+        vlc_cpu_lease_Release( p_sys->p_cpu_lease );
     vlc_sem_destroy( &p_sys->sem_mt );
     free( p_sys );
 }
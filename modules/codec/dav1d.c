@@ -32,6 +32,7 @@
 #include <vlc_common.h>
 #include <vlc_plugin.h>
 #include <vlc_codec.h>
+#include <vlc_cpu_budget.h>
 #include <vlc_timestamp_helper.h>
 
 #include <errno.h>
@@ -76,6 +77,7 @@ struct decoder_sys_t
 {
     Dav1dSettings s;
     Dav1dContext *c;
+    vlc_cpu_lease_t *cpu_lease;
 };
 
 static const struct
@@ -282,12 +284,25 @@ static int OpenDecoder(vlc_object_t *p_this)
         return VLC_ENOMEM;
 
     dav1d_default_settings(&p_sys->s);
+
+    /* Automatic thread counts are leased from the instance CPU budget */
+    unsigned i_cpus = vlc_GetCPUCount();
+    p_sys->cpu_lease = NULL;
     p_sys->s.n_tile_threads = var_InheritInteger(p_this, "dav1d-thread-tiles");
-    if (p_sys->s.n_tile_threads == 0)
-        p_sys->s.n_tile_threads = VLC_CLIP(vlc_GetCPUCount(), 1, 4);
     p_sys->s.n_frame_threads = var_InheritInteger(p_this, "dav1d-thread-frames");
+    if (p_sys->s.n_tile_threads == 0 || p_sys->s.n_frame_threads == 0)
+    {
+        p_sys->cpu_lease = vlc_cpu_lease_Acquire(dec, "dav1d", i_cpus);
+        if (p_sys->cpu_lease != NULL)
+            i_cpus = vlc_cpu_lease_GetThreads(p_sys->cpu_lease);
+    }
+    if (p_sys->s.n_tile_threads == 0)
+        p_sys->s.n_tile_threads = VLC_CLIP(i_cpus, 1, 4);
     if (p_sys->s.n_frame_threads == 0)
-        p_sys->s.n_frame_threads = __MAX(1, vlc_GetCPUCount());
+        p_sys->s.n_frame_threads = __MAX(1, i_cpus);
+    /* Frame threads delay the output by one picture each */
+    if (var_InheritBool(p_this, "low-latency-live"))
+        p_sys->s.n_frame_threads = 1;
     p_sys->s.allocator.cookie = dec;
     p_sys->s.allocator.alloc_picture_callback = NewPicture;
     p_sys->s.allocator.release_picture_callback = FreePicture;
@@ -295,6 +310,8 @@ static int OpenDecoder(vlc_object_t *p_this)
     if (dav1d_open(&p_sys->c, &p_sys->s) < 0)
     {
         msg_Err(p_this, "Could not open the Dav1d decoder");
+        if (p_sys->cpu_lease != NULL)
+            vlc_cpu_lease_Release(p_sys->cpu_lease);
         return VLC_EGENERIC;
     }
 
@@ -334,5 +351,7 @@ static void CloseDecoder(vlc_object_t *p_this)
     FlushDecoder(dec);
 
     dav1d_close(&p_sys->c);
+    if (p_sys->cpu_lease != NULL)
+        vlc_cpu_lease_Release(p_sys->cpu_lease);
 }
 
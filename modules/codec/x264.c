@@ -36,6 +36,7 @@
 #include <vlc_codec.h>
 #include <vlc_charset.h>
 #include <vlc_cpu.h>
+#include <vlc_cpu_budget.h>
 #include <math.h>
 
 #ifdef PTW32_STATIC_LIB
@@ -768,6 +769,8 @@ struct encoder_sys_t
     int             i_sei_size;
     uint32_t         i_colorspace;
     uint8_t         *p_sei;
+
+    vlc_cpu_lease_t *p_cpu_lease;
 };
 
 #ifdef PTW32_STATIC_LIB
@@ -868,6 +871,7 @@ static int  Open ( vlc_object_t *p_this )
     p_sys->psz_stat_name = NULL;
     p_sys->i_sei_size = 0;
     p_sys->p_sei = NULL;
+    p_sys->p_cpu_lease = NULL;
 
     char *psz_preset = var_GetString( p_enc, SOUT_CFG_PREFIX  "preset" );
     char *psz_tune = var_GetString( p_enc, SOUT_CFG_PREFIX  "tune" );
@@ -1401,6 +1405,17 @@ static int  Open ( vlc_object_t *p_this )
     }
     free(psz_opts);
 
+    /* Lease the automatic threads from the instance CPU budget, x264 would
+     * otherwise start 1.5 thread per CPU regardless of the other codecs */
+    if( p_sys->param.i_threads == 0 )
+    {
+        p_sys->p_cpu_lease = vlc_cpu_lease_Acquire( p_enc, "x264",
+                                    3 * vlc_GetCPUCount() / 2 );
+        if( p_sys->p_cpu_lease != NULL )
+            p_sys->param.i_threads =
+                vlc_cpu_lease_GetThreads( p_sys->p_cpu_lease );
+    }
+
     /* Open the encoder */
     p_sys->h = x264_encoder_open( &p_sys->param );
 
@@ -1573,6 +1588,9 @@ static void Close( vlc_object_t *p_this )
         x264_encoder_close( p_sys->h );
     }
 
+    if( p_sys->p_cpu_lease != NULL )
+        vlc_cpu_lease_Release( p_sys->p_cpu_lease );
+
 #ifdef PTW32_STATIC_LIB
     vlc_mutex_lock( &pthread_win32_mutex );
     pthread_win32_count--;
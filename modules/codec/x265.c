@@ -33,6 +33,7 @@
 #include <vlc_threads.h>
 #include <vlc_sout.h>
 #include <vlc_codec.h>
+#include <vlc_cpu_budget.h>
 
 #include <x265.h>
 
@@ -54,6 +55,10 @@ struct encoder_sys_t
 {
     x265_encoder    *h;
     x265_param      param;
+    vlc_cpu_lease_t *cpu_lease;
+#if X265_BUILD >= 47
+    char            numa_pools[12];
+#endif
 
     mtime_t         i_initial_delay;
 
@@ -194,9 +199,26 @@ static int  Open (vlc_object_t *p_this)
         param->rc.rateControlMode = X265_RC_ABR;
     }
 
+    /* Lease the threads from the instance CPU budget. The worker pool is
+     * sized separately from the frame threads, from all the CPUs otherwise */
+    p_sys->cpu_lease = vlc_cpu_lease_Acquire(p_enc, "x265",
+                                             param->frameNumThreads);
+    if (p_sys->cpu_lease != NULL) {
+        unsigned threads = vlc_cpu_lease_GetThreads(p_sys->cpu_lease);
+
+        param->frameNumThreads = threads;
+#if X265_BUILD >= 47
+        snprintf(p_sys->numa_pools, sizeof (p_sys->numa_pools), "%u",
+                 threads);
+        param->numaPools = p_sys->numa_pools;
+#endif
+    }
+
     p_sys->h = x265_encoder_open(param);
     if (p_sys->h == NULL) {
         msg_Err(p_enc, "cannot open x265 encoder");
+        if (p_sys->cpu_lease != NULL)
+            vlc_cpu_lease_Release(p_sys->cpu_lease);
         free(p_sys);
         return VLC_EGENERIC;
     }
@@ -242,6 +264,8 @@ static void Close(vlc_object_t *p_this)
     encoder_sys_t *p_sys = p_enc->p_sys;
 
     x265_encoder_close(p_sys->h);
+    if (p_sys->cpu_lease != NULL)
+        vlc_cpu_lease_Release(p_sys->cpu_lease);
 
     free(p_sys);
 }
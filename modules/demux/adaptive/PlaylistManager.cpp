@@ -36,6 +36,8 @@
 #include "logic/AlwaysLowestAdaptationLogic.hpp"
 #include "logic/PredictiveAdaptationLogic.hpp"
 #include "logic/NearOptimalAdaptationLogic.hpp"
+#include "logic/BufferBasedAdaptationLogic.hpp"
+#include "logic/AdaptationTelemetry.hpp"
 #include "tools/Debug.hpp"
 #include <vlc_stream.h>
 #include <vlc_demux.h>
@@ -56,6 +58,7 @@ PlaylistManager::PlaylistManager( demux_t *p_demux_,
              conManager     ( NULL ),
              logicType      ( type ),
              logic          ( NULL ),
+             telemetry      ( NULL ),
              playlist       ( pl ),
              streamFactory  ( factory ),
              p_demux        ( p_demux_ )
@@ -86,6 +89,7 @@ PlaylistManager::~PlaylistManager   ()
     delete playlist;
     delete conManager;
     delete logic;
+    delete telemetry;
     delete authStorage;
     vlc_cond_destroy(&waitcond);
     vlc_mutex_destroy(&lock);
@@ -775,6 +779,19 @@ AbstractAdaptationLogic *PlaylistManager::createLogic(AbstractAdaptationLogic::L
             if(predictivelogic)
                 conn->setDownloadRateObserver(predictivelogic);
             logic = predictivelogic;
+            break;
+        }
+        case AbstractAdaptationLogic::BufferBased:
+        {
+            mtime_t target = var_InheritInteger(p_demux, "adaptive-bola-target") * 1000;
+            mtime_t safety = var_InheritInteger(p_demux, "adaptive-bola-safety") * 1000;
+            AbstractAdaptationLogic *bolalogic =
+                    new (std::nothrow) BufferBasedAdaptationLogic(VLC_OBJECT(p_demux),
+                                                                  target, safety);
+            if(bolalogic)
+                conn->setDownloadRateObserver(bolalogic);
+            logic = bolalogic;
+            break;
         }
 
         default:
@@ -785,6 +802,12 @@ AbstractAdaptationLogic *PlaylistManager::createLogic(AbstractAdaptationLogic::L
     {
         logic->setMaxDeviceResolution( var_InheritInteger(p_demux, "adaptive-maxwidth"),
                                        var_InheritInteger(p_demux, "adaptive-maxheight") );
+        if(var_InheritBool(p_demux, "adaptive-telemetry"))
+        {
+            if(!telemetry)
+                telemetry = new (std::nothrow) MessageTelemetry(VLC_OBJECT(p_demux));
+            logic->setTelemetry(telemetry);
+        }
     }
 
     return logic;
@@ -73,6 +73,26 @@ static void Close   (vlc_object_t *);
 
 #define ADAPT_LOGIC_TEXT N_("Adaptive Logic")
 
+#define ADAPT_CACHE_SIZE_TEXT N_("Segment cache size (MiB)")
+#define ADAPT_CACHE_SIZE_LONGTEXT N_("Size of the in-memory cache of downloaded " \
+    "segments, shared by all the adaptive streams of the process. 0 disables it.")
+
+#define ADAPT_CACHE_TTL_TEXT N_("Segment cache lifetime (s)")
+#define ADAPT_CACHE_TTL_LONGTEXT N_("Maximum time a segment is kept in the cache. " \
+    "0 keeps segments until they are evicted by newer ones.")
+
+#define ADAPT_BOLA_TARGET_TEXT N_("Buffer based logic target (ms)")
+#define ADAPT_BOLA_TARGET_LONGTEXT N_("Buffer level at which the buffer based " \
+    "logic selects the highest quality")
+
+#define ADAPT_BOLA_SAFETY_TEXT N_("Buffer based logic safety level (ms)")
+#define ADAPT_BOLA_SAFETY_LONGTEXT N_("Buffer level under which the buffer based " \
+    "logic selects the lowest quality")
+
+#define ADAPT_TELEMETRY_TEXT N_("Log adaptation decisions")
+#define ADAPT_TELEMETRY_LONGTEXT N_("Log throughput estimate, buffer level, " \
+    "selected representation and reason for each adaptation decision")
+
 #define ADAPT_ACCESS_TEXT N_("Use regular HTTP modules")
 #define ADAPT_ACCESS_LONGTEXT N_("Connect using HTTP access instead of custom HTTP code")
 
@@ -80,6 +100,7 @@ static const AbstractAdaptationLogic::LogicType pi_logics[] = {
                                 AbstractAdaptationLogic::Default,
                                 AbstractAdaptationLogic::Predictive,
                                 AbstractAdaptationLogic::NearOptimal,
+                                AbstractAdaptationLogic::BufferBased,
                                 AbstractAdaptationLogic::RateBased,
                                 AbstractAdaptationLogic::FixedRate,
                                 AbstractAdaptationLogic::AlwaysLowest,
@@ -89,6 +110,7 @@ static const char *const ppsz_logics_values[] = {
                                 "",
                                 "predictive",
                                 "nearoptimal",
+                                "bola",
                                 "rate",
                                 "fixedrate",
                                 "lowest",
@@ -97,6 +119,7 @@ static const char *const ppsz_logics_values[] = {
 static const char *const ppsz_logics[] = { N_("Default"),
                                            N_("Predictive"),
                                            N_("Near Optimal"),
+                                           N_("Buffer Based (BOLA)"),
                                            N_("Bandwidth Adaptive"),
                                            N_("Fixed Bandwidth"),
                                            N_("Lowest Bandwidth/Quality"),
@@ -121,7 +144,12 @@ vlc_module_begin ()
         add_integer( "adaptive-maxheight", 0,
                      ADAPT_HEIGHT_TEXT, ADAPT_HEIGHT_TEXT, false )
         add_integer( "adaptive-bw",     250, ADAPT_BW_TEXT,     ADAPT_BW_LONGTEXT,     false )
+        add_integer( "adaptive-bola-target", 12000, ADAPT_BOLA_TARGET_TEXT, ADAPT_BOLA_TARGET_LONGTEXT, true )
+        add_integer( "adaptive-bola-safety", 3000, ADAPT_BOLA_SAFETY_TEXT, ADAPT_BOLA_SAFETY_LONGTEXT, true )
+        add_bool   ( "adaptive-telemetry", false, ADAPT_TELEMETRY_TEXT, ADAPT_TELEMETRY_LONGTEXT, true )
         add_bool   ( "adaptive-use-access", false, ADAPT_ACCESS_TEXT, ADAPT_ACCESS_LONGTEXT, true );
+        add_integer( "adaptive-cache-size", 0, ADAPT_CACHE_SIZE_TEXT, ADAPT_CACHE_SIZE_LONGTEXT, true )
+        add_integer( "adaptive-cache-ttl", 60, ADAPT_CACHE_TTL_TEXT, ADAPT_CACHE_TTL_LONGTEXT, true )
         set_callbacks( Open, Close )
 vlc_module_end ()
 
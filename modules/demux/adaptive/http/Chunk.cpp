@@ -29,6 +29,7 @@
 #include "HTTPConnection.hpp"
 #include "HTTPConnectionManager.h"
 #include "Downloader.hpp"
+#include "SegmentCache.hpp"
 
 #include <vlc_common.h>
 #include <vlc_block.h>
@@ -286,13 +287,17 @@ HTTPChunkBufferedSource::HTTPChunkBufferedSource(const std::string& url, Abstrac
     HTTPChunkSource(url, manager, sourceid, access),
     p_head     (NULL),
     pp_tail    (&p_head),
-    buffered     (0)
+    buffered     (0),
+    p_record   (NULL),
+    pp_record_tail(&p_record)
 {
     vlc_cond_init(&avail);
     done = false;
     eof = false;
     held = false;
     downloadstart = 0;
+    cache = manager ? manager->getSegmentCache() : NULL;
+    recording = (cache != NULL);
 }
 
 HTTPChunkBufferedSource::~HTTPChunkBufferedSource()
@@ -312,6 +317,8 @@ HTTPChunkBufferedSource::~HTTPChunkBufferedSource()
         pp_tail = &p_head;
     }
     buffered = 0;
+    if(p_record)
+        block_ChainRelease(p_record);
     vlc_mutex_unlock(&lock);
 
     vlc_cond_destroy(&avail);
@@ -336,9 +343,76 @@ void HTTPChunkBufferedSource::release()
     vlc_cond_signal(&avail);
 }
 
+bool HTTPChunkBufferedSource::readFromCache()
+{
+    if(!cache || prepared || done)
+        return false;
+
+    cachekey = SegmentCache::makeKey(params.getUrl(), bytesRange);
+    block_t *p_cached = cache->get(cachekey, &cachedtype);
+    if(!p_cached)
+        return false;
+
+    size_t size;
+    block_ChainProperties(p_cached, NULL, &size, NULL);
+    block_ChainLastAppend(&pp_tail, p_cached);
+    buffered += size;
+    contentLength = size;
+    prepared = true;
+    done = true;
+    recording = false;
+    return true;
+}
+
+void HTTPChunkBufferedSource::recordToCache(block_t *p_block)
+{
+    if(!recording)
+        return;
+
+    if(!contentLength || !cache->accepts(contentLength))
+    {
+        /* unknown or unsuitable size, can't validate the segment */
+        recording = false;
+    }
+    else if(p_block)
+    {
+        block_t *p_dup = block_Duplicate(p_block);
+        if(p_dup)
+        {
+            block_ChainLastAppend(&pp_record_tail, p_dup);
+            return;
+        }
+        recording = false;
+    }
+    else if(buffered + consumed == contentLength)
+    {
+        std::string type = connection ? connection->getContentType() : std::string();
+        cache->put(cachekey, p_record, type);
+        p_record = NULL;
+        pp_record_tail = &p_record;
+        recording = false;
+        return;
+    }
+    else recording = false; /* incomplete */
+
+    if(p_record)
+    {
+        block_ChainRelease(p_record);
+        p_record = NULL;
+        pp_record_tail = &p_record;
+    }
+}
+
 void HTTPChunkBufferedSource::bufferize(size_t readsize)
 {
     vlc_mutex_lock(&lock);
+    if(readFromCache())
+    {
+        vlc_cond_signal(&avail);
+        vlc_mutex_unlock(&lock);
+        return;
+    }
+
     if(!prepare())
     {
         done = true;
@@ -379,15 +453,18 @@ void HTTPChunkBufferedSource::bufferize(size_t readsize)
         rate.size = buffered + consumed;
         rate.time = mdate() - downloadstart;
         downloadstart = 0;
+        recordToCache(NULL);
     }
     else
     {
         p_block->i_buffer = (size_t) ret;
         vlc_mutex_locker locker( &lock );
         buffered += p_block->i_buffer;
+        recordToCache(p_block);
         block_ChainLastAppend(&pp_tail, p_block);
         if((size_t) ret < readsize)
         {
+            recordToCache(NULL);
             done = true;
             rate.size = buffered + consumed;
             rate.time = mdate() - downloadstart;
@@ -419,6 +496,15 @@ bool HTTPChunkBufferedSource::hasMoreData() const
     return !eof;
 }
 
+std::string HTTPChunkBufferedSource::getContentType() const
+{
+    vlc_mutex_locker locker(&lock);
+    if(connection)
+        return connection->getContentType();
+    else
+        return cachedtype;
+}
+
 block_t * HTTPChunkBufferedSource::readBlock()
 {
     block_t *p_block = NULL;
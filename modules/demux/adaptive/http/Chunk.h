@@ -41,6 +41,7 @@ namespace adaptive
         class AbstractConnection;
         class AbstractConnectionManager;
         class AbstractChunk;
+        class SegmentCache;
 
         class AbstractChunkSource
         {
@@ -106,10 +107,10 @@ namespace adaptive
                 bool                prepared;
                 bool                eof;
                 ID                  sourceid;
+                ConnectionParams    params;
 
             private:
                 bool init(const std::string &);
-                ConnectionParams    params;
         };
 
         class HTTPChunkBufferedSource : public HTTPChunkSource
@@ -123,6 +124,7 @@ namespace adaptive
                 virtual block_t *  readBlock       (); /* reimpl */
                 virtual block_t *  read            (size_t); /* reimpl */
                 virtual bool       hasMoreData     () const; /* impl */
+                virtual std::string getContentType () const; /* reimpl */
                 void               hold();
                 void               release();
 
@@ -130,6 +132,8 @@ namespace adaptive
                 virtual bool       prepare(); /* reimpl */
                 void               bufferize(size_t);
                 bool               isDone() const;
+                bool               readFromCache();
+                void               recordToCache(block_t *);
 
             private:
                 block_t            *p_head; /* read cache buffer */
@@ -140,6 +144,13 @@ namespace adaptive
                 mtime_t             downloadstart;
                 vlc_cond_t          avail;
                 bool                held;
+                /* segment cache */
+                SegmentCache       *cache;
+                std::string         cachekey;
+                std::string         cachedtype;
+                block_t            *p_record;
+                block_t           **pp_record_tail;
+                bool                recording;
         };
 
         class HTTPChunk : public AbstractChunk
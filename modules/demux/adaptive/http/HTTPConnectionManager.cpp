@@ -30,6 +30,7 @@
 #include "ConnectionParams.hpp"
 #include "Transport.hpp"
 #include "Downloader.hpp"
+#include "SegmentCache.hpp"
 #include <vlc_url.h>
 #include <vlc_http.h>
 
@@ -40,11 +41,25 @@ AbstractConnectionManager::AbstractConnectionManager(vlc_object_t *p_object_)
 {
     p_object = p_object_;
     rateObserver = NULL;
+    segmentCache = SegmentCache::acquire(p_object);
 }
 
 AbstractConnectionManager::~AbstractConnectionManager()
 {
+    if(segmentCache)
+    {
+        SegmentCache::Stats stats = segmentCache->getStats();
+        msg_Dbg(p_object, "segment cache: %" PRIu64 " hits, %" PRIu64 " misses, "
+                "%" PRIu64 " bytes saved, %zu entries (%zu bytes)",
+                stats.hits, stats.misses, stats.bytesSaved,
+                stats.entries, stats.size);
+        segmentCache->release();
+    }
+}
 
+SegmentCache * AbstractConnectionManager::getSegmentCache() const
+{
+    return segmentCache;
 }
 
 void AbstractConnectionManager::updateDownloadRate(const adaptive::ID &sourceid, size_t size, mtime_t time)
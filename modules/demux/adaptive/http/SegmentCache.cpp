@@ -0,0 +1,201 @@
+/*
+ * SegmentCache.cpp
+ *****************************************************************************
+ * Copyright (C) 2020 - VideoLabs, VideoLAN and VLC Authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "SegmentCache.hpp"
+#include "BytesRange.hpp"
+
+#include <vlc_block.h>
+
+#include <cassert>
+#include <new>
+#include <sstream>
+
+using namespace adaptive::http;
+
+vlc_mutex_t SegmentCache::instanceLock = VLC_STATIC_MUTEX;
+SegmentCache * SegmentCache::instance = NULL;
+
+SegmentCache::Stats::Stats()
+{
+    hits = misses = stored = evicted = bytesSaved = 0;
+    entries = size = 0;
+}
+
+SegmentCache::SegmentCache(size_t maxsize, mtime_t ttl_)
+{
+    vlc_mutex_init(&lock);
+    maxSize = maxsize;
+    ttl = ttl_;
+    refcount = 0;
+}
+
+SegmentCache::~SegmentCache()
+{
+    EntryList::iterator it;
+    for(it = entries.begin(); it != entries.end(); ++it)
+        block_ChainRelease((*it).p_data);
+    vlc_mutex_destroy(&lock);
+}
+
+SegmentCache * SegmentCache::acquire(vlc_object_t *p_obj)
+{
+    const int64_t size = var_InheritInteger(p_obj, "adaptive-cache-size");
+    if(size <= 0)
+        return NULL;
+
+    vlc_mutex_locker locker(&instanceLock);
+    if(!instance)
+    {
+        const int64_t ttl = var_InheritInteger(p_obj, "adaptive-cache-ttl");
+        instance = new (std::nothrow) SegmentCache(size * 1024 * 1024,
+                                                   (ttl > 0) ? CLOCK_FREQ * ttl : 0);
+        if(!instance)
+            return NULL;
+        msg_Dbg(p_obj, "created segment cache (%" PRId64 " MiB, ttl %" PRId64 "s)",
+                size, ttl);
+    }
+    instance->refcount++;
+    return instance;
+}
+
+void SegmentCache::release()
+{
+    vlc_mutex_locker locker(&instanceLock);
+    assert(instance == this);
+    if(--refcount == 0)
+    {
+        instance = NULL;
+        delete this;
+    }
+}
+
+std::string SegmentCache::makeKey(const std::string &url, const BytesRange &range)
+{
+    std::stringstream ss;
+    ss << url;
+    if(range.isValid())
+        ss << '@' << range.getStartByte() << '-' << range.getEndByte();
+    return ss.str();
+}
+
+bool SegmentCache::accepts(size_t size) const
+{
+    /* Don't let a single segment flush a large part of the cache */
+    return size > 0 && size <= maxSize / 4;
+}
+
+void SegmentCache::evict(EntryList::iterator it)
+{
+    index.erase((*it).key);
+    stats.size -= (*it).size;
+    stats.entries--;
+    stats.evicted++;
+    block_ChainRelease((*it).p_data);
+    entries.erase(it);
+}
+
+void SegmentCache::purge(mtime_t now)
+{
+    if(!ttl)
+        return;
+    EntryList::iterator it = entries.begin();
+    while(it != entries.end())
+    {
+        EntryList::iterator cur = it++;
+        if((*cur).expiry <= now)
+            evict(cur);
+    }
+}
+
+block_t * SegmentCache::get(const std::string &key, std::string *contentType)
+{
+    vlc_mutex_locker locker(&lock);
+
+    purge(mdate());
+
+    std::map<std::string, EntryList::iterator>::iterator it = index.find(key);
+    if(it == index.end())
+    {
+        stats.misses++;
+        return NULL;
+    }
+
+    /* Blocks are not refcounted, hand out a copy */
+    const Entry &entry = *(*it).second;
+    block_t *p_chain = NULL;
+    block_t **pp_tail = &p_chain;
+    for(const block_t *p = entry.p_data; p; p = p->p_next)
+    {
+        block_t *p_dup = block_Duplicate(const_cast<block_t *>(p));
+        if(!p_dup)
+        {
+            block_ChainRelease(p_chain);
+            stats.misses++;
+            return NULL;
+        }
+        block_ChainLastAppend(&pp_tail, p_dup);
+    }
+
+    *contentType = entry.contentType;
+    stats.hits++;
+    stats.bytesSaved += entry.size;
+    entries.splice(entries.begin(), entries, (*it).second);
+    return p_chain;
+}
+
+void SegmentCache::put(const std::string &key, block_t *p_data,
+                       const std::string &contentType)
+{
+    size_t size;
+    block_ChainProperties(p_data, NULL, &size, NULL);
+
+    vlc_mutex_locker locker(&lock);
+
+    if(!accepts(size) || index.find(key) != index.end())
+    {
+        block_ChainRelease(p_data);
+        return;
+    }
+
+    purge(mdate());
+    while(!entries.empty() && stats.size + size > maxSize)
+        evict(--entries.end());
+
+    Entry entry;
+    entry.key = key;
+    entry.contentType = contentType;
+    entry.p_data = p_data;
+    entry.size = size;
+    entry.expiry = mdate() + ttl;
+    entries.push_front(entry);
+    index[key] = entries.begin();
+    stats.size += size;
+    stats.entries++;
+    stats.stored++;
+}
+
+SegmentCache::Stats SegmentCache::getStats() const
+{
+    vlc_mutex_locker locker(&lock);
+    return stats;
+}
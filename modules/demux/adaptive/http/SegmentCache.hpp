@@ -0,0 +1,96 @@
+/*
+ * SegmentCache.hpp
+ *****************************************************************************
+ * Copyright (C) 2020 - VideoLabs, VideoLAN and VLC Authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifndef SEGMENTCACHE_HPP_
+#define SEGMENTCACHE_HPP_
+
+#include <vlc_common.h>
+
+#include <list>
+#include <map>
+#include <string>
+
+typedef struct block_t block_t;
+
+namespace adaptive
+{
+    namespace http
+    {
+        class BytesRange;
+
+        /* Process wide cache of downloaded segments, keyed by URL and byte
+         * range, and shared by all the adaptive demuxers instances. */
+        class SegmentCache
+        {
+            public:
+                class Stats
+                {
+                    public:
+                        Stats();
+                        uint64_t hits;
+                        uint64_t misses;
+                        uint64_t stored;
+                        uint64_t evicted;
+                        uint64_t bytesSaved;
+                        size_t   entries;
+                        size_t   size;
+                };
+
+                static SegmentCache *acquire(vlc_object_t *);
+                void release();
+
+                static std::string makeKey(const std::string &, const BytesRange &);
+                block_t *get(const std::string &, std::string *);
+                void     put(const std::string &, block_t *, const std::string &);
+                bool     accepts(size_t) const;
+                Stats    getStats() const;
+
+            private:
+                SegmentCache(size_t, mtime_t);
+                ~SegmentCache();
+
+                class Entry
+                {
+                    public:
+                        std::string key;
+                        std::string contentType;
+                        block_t    *p_data;
+                        size_t      size;
+                        mtime_t     expiry;
+                };
+                typedef std::list<Entry> EntryList;
+
+                void purge(mtime_t);
+                void evict(EntryList::iterator);
+
+                mutable vlc_mutex_t lock;
+                EntryList           entries; /* most recently used first */
+                std::map<std::string, EntryList::iterator> index;
+                size_t              maxSize;
+                mtime_t             ttl;
+                Stats               stats;
+                unsigned            refcount;
+
+                static vlc_mutex_t  instanceLock;
+                static SegmentCache *instance;
+        };
+    }
+}
+
+#endif
@@ -26,6 +26,7 @@
 #endif
 
 #include "AbstractAdaptationLogic.h"
+#include "AdaptationTelemetry.hpp"
 
 #include <limits>
 
@@ -35,6 +36,7 @@ AbstractAdaptationLogic::AbstractAdaptationLogic    ()
 {
     maxwidth = std::numeric_limits<int>::max();
     maxheight = std::numeric_limits<int>::max();
+    telemetry = NULL;
 }
 
 AbstractAdaptationLogic::~AbstractAdaptationLogic   ()
@@ -50,3 +52,14 @@ void AbstractAdaptationLogic::setMaxDeviceResolution (int w, int h)
     maxwidth = (w > 0) ? w : std::numeric_limits<int>::max();
     maxheight = (h > 0) ? h : std::numeric_limits<int>::max();
 }
+
+void AbstractAdaptationLogic::setTelemetry(AdaptationTelemetryInterface *t)
+{
+    telemetry = t;
+}
+
+void AbstractAdaptationLogic::notifyDecision(const AdaptationDecision &decision) const
+{
+    if(telemetry)
+        telemetry->decisionMade(decision);
+}
@@ -40,6 +40,9 @@ namespace adaptive
     {
         using namespace playlist;
 
+        class AdaptationDecision;
+        class AdaptationTelemetryInterface;
+
         class AbstractAdaptationLogic : public IDownloadRateObserver,
                                         public SegmentTrackerListenerInterface
         {
@@ -51,6 +54,7 @@ namespace adaptive
                 virtual void                updateDownloadRate     (const ID &, size_t, mtime_t);
                 virtual void                trackerEvent           (const SegmentTrackerEvent &) {}
                 void                        setMaxDeviceResolution (int, int);
+                void                        setTelemetry           (AdaptationTelemetryInterface *);
 
                 enum LogicType
                 {
@@ -61,11 +65,16 @@ namespace adaptive
                     FixedRate,
                     Predictive,
                     NearOptimal,
+                    BufferBased,
                 };
 
             protected:
+                void notifyDecision(const AdaptationDecision &) const;
                 int maxwidth;
                 int maxheight;
+
+            private:
+                AdaptationTelemetryInterface *telemetry;
         };
     }
 }
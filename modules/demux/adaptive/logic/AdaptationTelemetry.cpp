@@ -0,0 +1,55 @@
+/*
+ * AdaptationTelemetry.cpp
+ *****************************************************************************
+ * Copyright (C) 2020 - VideoLAN and VLC Authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "AdaptationTelemetry.hpp"
+#include "../playlist/BaseRepresentation.h"
+
+using namespace adaptive::logic;
+using namespace adaptive;
+
+AdaptationDecision::AdaptationDecision(const ID &id_)
+    : id(id_)
+{
+    throughput = 0;
+    bufferLevel = 0;
+    bufferTarget = 0;
+    prev = NULL;
+    next = NULL;
+    reason = "";
+}
+
+MessageTelemetry::MessageTelemetry(vlc_object_t *p_obj_)
+{
+    p_obj = p_obj_;
+}
+
+void MessageTelemetry::decisionMade(const AdaptationDecision &d)
+{
+    /* keep it key=value so logs can be parsed back and replayed */
+    msg_Info(p_obj, "adaptation stream=%s throughput=%" PRIu64 " buffer=%" PRId64
+             " target=%" PRId64 " prev=%" PRIu64 " next=%" PRIu64 " reason=%s",
+             d.id.str().c_str(), d.throughput,
+             d.bufferLevel / 1000, d.bufferTarget / 1000,
+             d.prev ? d.prev->getBandwidth() : 0,
+             d.next ? d.next->getBandwidth() : 0, d.reason);
+}
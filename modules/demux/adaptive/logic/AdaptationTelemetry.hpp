@@ -0,0 +1,71 @@
+/*
+ * AdaptationTelemetry.hpp
+ *****************************************************************************
+ * Copyright (C) 2020 - VideoLAN and VLC Authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifndef ADAPTATIONTELEMETRY_HPP
+#define ADAPTATIONTELEMETRY_HPP
+
+#include <vlc_common.h>
+#include "../ID.hpp"
+
+namespace adaptive
+{
+    namespace playlist
+    {
+        class BaseRepresentation;
+    }
+
+    namespace logic
+    {
+        using namespace playlist;
+
+        /* Snapshot of a logic internal state when selecting a representation */
+        class AdaptationDecision
+        {
+            public:
+                AdaptationDecision(const ID &);
+                ID                        id;
+                uint64_t                  throughput;    /* estimate, bps, 0 if unknown */
+                mtime_t                   bufferLevel;   /* 0 if unknown */
+                mtime_t                   bufferTarget;  /* 0 if unknown */
+                const BaseRepresentation *prev;
+                const BaseRepresentation *next;
+                const char               *reason;
+        };
+
+        class AdaptationTelemetryInterface
+        {
+            public:
+                virtual ~AdaptationTelemetryInterface() {}
+                virtual void decisionMade(const AdaptationDecision &) = 0;
+        };
+
+        /* Logs decisions through the messages subsystem */
+        class MessageTelemetry : public AdaptationTelemetryInterface
+        {
+            public:
+                MessageTelemetry(vlc_object_t *);
+                virtual void decisionMade(const AdaptationDecision &); /* impl */
+
+            private:
+                vlc_object_t *p_obj;
+        };
+    }
+}
+
+#endif // ADAPTATIONTELEMETRY_HPP
@@ -0,0 +1,255 @@
+/*
+ * BufferBasedAdaptationLogic.cpp
+ *****************************************************************************
+ * Copyright (C) 2020 - VideoLAN and VLC Authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "BufferBasedAdaptationLogic.hpp"
+#include "AdaptationTelemetry.hpp"
+
+#include "../playlist/BaseAdaptationSet.h"
+#include "../playlist/BaseRepresentation.h"
+#include "../tools/Debug.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace adaptive::logic;
+using namespace adaptive;
+
+/*
+ * BOLA-BASIC buffer occupancy based selection, with a throughput cap on
+ * up switches (as BOLA-O) and a throughput based startup phase.
+ * BOLA: Near-Optimal Bitrate Adaptation for Online Videos
+ * http://arxiv.org/abs/1601.06748
+ */
+
+#define defaultSafetyBuffer (CLOCK_FREQ * 3)
+
+BufferBasedContext::BufferBasedContext()
+{
+    segments_count = 0;
+    buffering_level = 0;
+    buffering_target = 0;
+    last_duration = 0;
+    last_download_rate = 0;
+}
+
+BufferBasedAdaptationLogic::BufferBasedAdaptationLogic(vlc_object_t *p_obj_,
+                                                       mtime_t target_, mtime_t safety_)
+    : AbstractAdaptationLogic()
+{
+    p_obj = p_obj_;
+    safety = (safety_ > 0) ? safety_ : defaultSafetyBuffer;
+    target = (target_ > safety) ? target_ : safety + defaultSafetyBuffer;
+    vlc_mutex_init(&lock);
+}
+
+BufferBasedAdaptationLogic::~BufferBasedAdaptationLogic()
+{
+    vlc_mutex_destroy(&lock);
+}
+
+void BufferBasedAdaptationLogic::getRepresentations(BaseAdaptationSet *adaptSet,
+                                                    RepresentationSelector &selector,
+                                                    std::vector<BaseRepresentation *> &reps) const
+{
+    BaseRepresentation *prev = NULL;
+    for(BaseRepresentation *rep = selector.lowest(adaptSet);
+                            rep && rep != prev; rep = selector.higher(adaptSet, rep))
+    {
+        reps.push_back(rep);
+        prev = rep;
+    }
+}
+
+BaseRepresentation *
+BufferBasedAdaptationLogic::getBolaRepresentation(const std::vector<BaseRepresentation *> &reps,
+                                                  mtime_t Q, mtime_t Qmax) const
+{
+    /* utilities are relative to the lowest bitrate, u0 == 1 */
+    const double S0 = reps.front()->getBandwidth();
+    const double umax = std::log(reps.back()->getBandwidth() / S0) + 1.0;
+    /* lowest quality when at safety level, highest once reaching target */
+    const double gp = (umax - 1.0) / ((double) Qmax / safety - 1.0);
+    const double Vp = ((double) safety / CLOCK_FREQ) / gp;
+    const double q = (double) Q / CLOCK_FREQ;
+
+    BaseRepresentation *ret = NULL;
+    double argmax = 0.0;
+    std::vector<BaseRepresentation *>::const_iterator it;
+    for(it = reps.begin(); it != reps.end(); ++it)
+    {
+        const double u = std::log((*it)->getBandwidth() / S0) + 1.0;
+        const double arg = (Vp * (u + gp) - q) / (*it)->getBandwidth();
+        if(ret == NULL || arg >= argmax)
+        {
+            ret = *it;
+            argmax = arg;
+        }
+    }
+    return ret;
+}
+
+BaseRepresentation *BufferBasedAdaptationLogic::getNextRepresentation(BaseAdaptationSet *adaptSet,
+                                                                      BaseRepresentation *prevRep)
+{
+    if(adaptSet == NULL)
+        return NULL;
+
+    RepresentationSelector selector(maxwidth, maxheight);
+    std::vector<BaseRepresentation *> reps;
+    getRepresentations(adaptSet, selector, reps);
+    if(reps.empty())
+        return NULL;
+
+    AdaptationDecision decision(adaptSet->getID());
+    decision.prev = prevRep;
+
+    vlc_mutex_lock(&lock);
+
+    BufferBasedContext ctx;
+    std::map<ID, BufferBasedContext>::iterator it = streams.find(adaptSet->getID());
+    if(it != streams.end())
+    {
+        (*it).second.segments_count++;
+        ctx = (*it).second;
+    }
+
+    vlc_mutex_unlock(&lock);
+
+    /* Can't go higher than what the demuxer will buffer */
+    mtime_t Qmax = target;
+    if(ctx.buffering_target && ctx.buffering_target < Qmax)
+        Qmax = ctx.buffering_target;
+    if(Qmax <= safety + ctx.last_duration)
+        Qmax = safety + std::max(ctx.last_duration, (mtime_t) CLOCK_FREQ);
+
+    const uint64_t throughput = ctx.last_download_rate;
+    decision.throughput = throughput;
+    decision.bufferLevel = ctx.buffering_level;
+    decision.bufferTarget = Qmax;
+
+    BaseRepresentation *rep;
+    if(reps.size() == 1)
+    {
+        rep = reps.front();
+        decision.reason = "single";
+    }
+    else if(ctx.segments_count < 2 || !throughput)
+    {
+        /* No buffer yet: start from a safe share of the throughput */
+        rep = throughput ? selector.select(adaptSet, throughput * 9 / 10)
+                         : reps.front();
+        decision.reason = "startup";
+    }
+    else
+    {
+        rep = getBolaRepresentation(reps, ctx.buffering_level, Qmax);
+        decision.reason = (ctx.buffering_level < safety) ? "safety" : "buffer";
+
+        /* Don't switch up beyond what the network can sustain */
+        if(prevRep && rep->getBandwidth() > prevRep->getBandwidth() &&
+           rep->getBandwidth() > throughput)
+        {
+            BaseRepresentation *capped = selector.select(adaptSet, throughput);
+            if(!capped || capped->getBandwidth() < prevRep->getBandwidth())
+                capped = prevRep;
+            if(capped != rep)
+            {
+                rep = capped;
+                decision.reason = "throughput-cap";
+            }
+        }
+    }
+
+    decision.next = rep;
+    notifyDecision(decision);
+
+    BwDebug( if( rep != prevRep )
+                msg_Info(p_obj, "Stream %s buffer %" PRId64 "ms new bandwidth usage %zu KiB/s (%s)",
+                         adaptSet->getID().str().c_str(), ctx.buffering_level / 1000,
+                         rep->getBandwidth() / 8000, decision.reason); );
+
+    return rep;
+}
+
+void BufferBasedAdaptationLogic::updateDownloadRate(const ID &id, size_t dlsize, mtime_t time)
+{
+    if(unlikely(time == 0))
+        return;
+
+    vlc_mutex_lock(&lock);
+    std::map<ID, BufferBasedContext>::iterator it = streams.find(id);
+    if(it != streams.end())
+    {
+        BufferBasedContext &ctx = (*it).second;
+        ctx.last_download_rate = ctx.average.push(CLOCK_FREQ * dlsize * 8 / time);
+    }
+    vlc_mutex_unlock(&lock);
+}
+
+void BufferBasedAdaptationLogic::trackerEvent(const SegmentTrackerEvent &event)
+{
+    switch(event.type)
+    {
+    case SegmentTrackerEvent::BUFFERING_STATE:
+        {
+            const ID &id = *event.u.buffering.id;
+            vlc_mutex_lock(&lock);
+            if(event.u.buffering.enabled)
+            {
+                if(streams.find(id) == streams.end())
+                    streams.insert(std::pair<ID, BufferBasedContext>(id, BufferBasedContext()));
+            }
+            else
+            {
+                std::map<ID, BufferBasedContext>::iterator it = streams.find(id);
+                if(it != streams.end())
+                    streams.erase(it);
+            }
+            vlc_mutex_unlock(&lock);
+        }
+        break;
+
+    case SegmentTrackerEvent::BUFFERING_LEVEL_CHANGE:
+        {
+            const ID &id = *event.u.buffering_level.id;
+            vlc_mutex_lock(&lock);
+            BufferBasedContext &ctx = streams[id];
+            ctx.buffering_level = event.u.buffering_level.current;
+            ctx.buffering_target = event.u.buffering_level.target;
+            vlc_mutex_unlock(&lock);
+        }
+        break;
+
+    case SegmentTrackerEvent::SEGMENT_CHANGE:
+        {
+            const ID &id = *event.u.segment.id;
+            vlc_mutex_lock(&lock);
+            streams[id].last_duration = event.u.segment.duration;
+            vlc_mutex_unlock(&lock);
+        }
+        break;
+
+    default:
+        break;
+    }
+}
@@ -23,6 +23,7 @@
 
 #include "NearOptimalAdaptationLogic.hpp"
 #include "Representationselectors.hpp"
+#include "AdaptationTelemetry.hpp"
 
 #include "../playlist/BaseAdaptationSet.h"
 #include "../playlist/BaseRepresentation.h"
@@ -109,16 +110,23 @@ BaseRepresentation *NearOptimalAdaptationLogic::getNextRepresentation(BaseAdapta
     const float gammaP = 1.0 + (umax - umin) / ((float)ctxcopy.buffering_target / ctxcopy.buffering_min - 1.0);
     const float Vd = ((float)ctxcopy.buffering_min / CLOCK_FREQ - 1.0) / (umin + gammaP);
 
+    AdaptationDecision decision(adaptSet->getID());
+    decision.throughput = bps;
+    decision.bufferLevel = ctxcopy.buffering_level;
+    decision.bufferTarget = ctxcopy.buffering_target;
+
     BaseRepresentation *m;
     if(prevRep == NULL) /* Starting */
     {
         m = selector.select(adaptSet, bps);
+        decision.reason = "startup";
     }
     else
     {
         /* noted m* */
         m = getNextQualityIndex(adaptSet, selector, gammaP - umin /* umin == Sm, utility = std::log(S/Sm) */,
                                 Vd, (float)ctxcopy.buffering_level / CLOCK_FREQ);
+        decision.reason = "buffer";
         if(m->getBandwidth() < prevRep->getBandwidth()) /* m*[n] < m*[n-1] */
         {
             BaseRepresentation *mp = selector.select(adaptSet, bps); /* m' */
@@ -129,15 +137,21 @@ BaseRepresentation *NearOptimalAdaptationLogic::getNextRepresentation(BaseAdapta
             else if(mp->getBandwidth() > prevRep->getBandwidth())
             {
                 mp = prevRep;
+                decision.reason = "throughput-hold";
             }
             else
             {
                 mp = selector.lower(adaptSet, mp);
+                decision.reason = "throughput";
             }
             m = mp;
         }
     }
 
+    decision.prev = prevRep;
+    decision.next = m;
+    notifyDecision(decision);
+
     BwDebug( msg_Info(p_obj, "buffering level %.2f% rep %ld kBps %zu kBps",
              (float) 100 * ctxcopy.buffering_level / ctxcopy.buffering_target, m->getBandwidth()/8000, bps / 8000); );
 
@@ -24,6 +24,7 @@
 #include "PredictiveAdaptationLogic.hpp"
 
 #include "Representationselectors.hpp"
+#include "AdaptationTelemetry.hpp"
 
 #include "../playlist/BaseAdaptationSet.h"
 #include "../playlist/BaseRepresentation.h"
@@ -71,6 +72,7 @@ BaseRepresentation *PredictiveAdaptationLogic::getNextRepresentation(BaseAdaptat
 {
     RepresentationSelector selector(maxwidth, maxheight);
     BaseRepresentation *rep;
+    AdaptationDecision decision(adaptSet->getID());
 
     vlc_mutex_lock(&lock);
 
@@ -78,6 +80,7 @@ BaseRepresentation *PredictiveAdaptationLogic::getNextRepresentation(BaseAdaptat
     if(it == streams.end())
     {
         rep = selector.highest(adaptSet);
+        decision.reason = "unknown";
     }
     else
     {
@@ -101,9 +104,14 @@ BaseRepresentation *PredictiveAdaptationLogic::getNextRepresentation(BaseAdaptat
             }
         }
 
+        decision.throughput = stats.last_download_rate;
+        decision.bufferLevel = stats.buffering_level;
+        decision.bufferTarget = stats.buffering_target;
+
         if(stats.starting())
         {
             rep = selector.highest(adaptSet);
+            decision.reason = "startup";
         }
         else
         {
@@ -111,25 +119,30 @@ BaseRepresentation *PredictiveAdaptationLogic::getNextRepresentation(BaseAdaptat
             if(!prevRep)
             {
                 rep = selector.select(adaptSet, i_available_bw);
+                decision.reason = "throughput";
             }
             else if(f_buffering_level > 0.8)
             {
                 rep = selector.select(adaptSet, std::max((uint64_t) i_available_bw,
                                                          (uint64_t) prevRep->getBandwidth()));
+                decision.reason = "buffer-high";
             }
             else if(f_buffering_level > 0.5)
             {
                 rep = prevRep;
+                decision.reason = "buffer-steady";
             }
             else
             {
                 if(f_buffering_level > 2 * stats.last_duration)
                 {
                     rep = selector.lower(adaptSet, prevRep);
+                    decision.reason = "buffer-low";
                 }
                 else
                 {
                     rep = selector.select(adaptSet, i_available_bw * f_buffering_level);
+                    decision.reason = "buffer-critical";
                 }
             }
         }
@@ -150,6 +163,10 @@ BaseRepresentation *PredictiveAdaptationLogic::getNextRepresentation(BaseAdaptat
 
     vlc_mutex_unlock(&lock);
 
+    decision.prev = prevRep;
+    decision.next = rep;
+    notifyDecision(decision);
+
     return rep;
 }
 
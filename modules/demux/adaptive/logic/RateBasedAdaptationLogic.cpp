@@ -27,7 +27,9 @@
 
 #include "RateBasedAdaptationLogic.h"
 #include "Representationselectors.hpp"
+#include "AdaptationTelemetry.hpp"
 
+#include "../playlist/BaseAdaptationSet.h"
 #include "../playlist/BaseRepresentation.h"
 #include "../playlist/BasePeriod.h"
 #include "../http/Chunk.h"
@@ -75,6 +77,13 @@ BaseRepresentation *RateBasedAdaptationLogic::getNextRepresentation(BaseAdaptati
             return NULL;
     }
 
+    AdaptationDecision decision(adaptSet->getID());
+    decision.throughput = availBps;
+    decision.prev = currep;
+    decision.next = rep;
+    decision.reason = "throughput";
+    notifyDecision(decision);
+
     return rep;
 }
 
@@ -0,0 +1,395 @@
+/*
+ * AdaptationSimulator.cpp: offline adaptation logic simulator
+ *****************************************************************************
+ * Copyright (C) 2020 - VideoLAN and VLC Authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*
+ * Replays a throughput trace against an adaptation logic, without any
+ * network or demuxer, and reports start-up latency, rebuffering and
+ * average bitrate.
+ *
+ * usage: adaptive_logic_sim [-l logic] [-r kbps,kbps,...] [-s segment_seconds]
+ *                           [-b max_buffer_seconds] [-v] [trace]
+ *
+ * The trace is a text file with one "<duration seconds> <throughput kbps>"
+ * pair per line ('#' starts a comment). It is looped over if shorter than
+ * the simulated session. Without trace, a built-in trace is replayed against
+ * every logic and sanity checks are run.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#undef NDEBUG
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include <vlc_common.h>
+
+#include "../../ID.hpp"
+#include "../../SegmentTracker.hpp"
+#include "../../playlist/BaseAdaptationSet.h"
+#include "../../playlist/BaseRepresentation.h"
+#include "../../logic/AdaptationTelemetry.hpp"
+#include "../../logic/AlwaysBestAdaptationLogic.h"
+#include "../../logic/AlwaysLowestAdaptationLogic.hpp"
+#include "../../logic/BufferBasedAdaptationLogic.hpp"
+#include "../../logic/NearOptimalAdaptationLogic.hpp"
+#include "../../logic/PredictiveAdaptationLogic.hpp"
+#include "../../logic/RateBasedAdaptationLogic.h"
+
+using namespace adaptive;
+using namespace adaptive::logic;
+using namespace adaptive::playlist;
+
+namespace
+{
+    class TraceSample
+    {
+        public:
+            TraceSample(double d, double b) : duration(d), bps(b) {}
+            double duration;
+            double bps;
+    };
+
+    class Trace
+    {
+        public:
+            bool load(const char *);
+            void add(double duration, double bps);
+            double total() const;
+            double downloadTime(double, double) const;
+
+        private:
+            std::vector<TraceSample> samples;
+    };
+
+    class PrintTelemetry : public AdaptationTelemetryInterface
+    {
+        public:
+            PrintTelemetry(bool v) : verbose(v), clock(0.0) {}
+            virtual void decisionMade(const AdaptationDecision &d)
+            {
+                if(verbose)
+                    printf("%.3f,%s,%" PRIu64 ",%.3f,%.3f,%" PRIu64 ",%" PRIu64 ",%s\n",
+                           clock, d.id.str().c_str(), d.throughput,
+                           (double) d.bufferLevel / CLOCK_FREQ,
+                           (double) d.bufferTarget / CLOCK_FREQ,
+                           d.prev ? d.prev->getBandwidth() : 0,
+                           d.next ? d.next->getBandwidth() : 0, d.reason);
+            }
+            bool verbose;
+            double clock;
+    };
+
+    class Results
+    {
+        public:
+            Results() : startup(0.0), stalls(0), stalled(0.0),
+                        segments(0), switches(0), bitrate(0.0) {}
+            double   startup;
+            unsigned stalls;
+            double   stalled;
+            unsigned segments;
+            unsigned switches;
+            double   bitrate;
+    };
+
+    class Config
+    {
+        public:
+            Config() : segment(2.0), maxbuffer(30.0), duration(0.0), verbose(false) {}
+            std::vector<uint64_t> bitrates;
+            double segment;
+            double maxbuffer;
+            double duration;
+            bool   verbose;
+    };
+}
+
+bool Trace::load(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if(!f)
+        return false;
+
+    char line[256];
+    while(fgets(line, sizeof(line), f))
+    {
+        double duration, kbps;
+        char *hash = strchr(line, '#');
+        if(hash)
+            *hash = '\0';
+        if(sscanf(line, "%lf %lf", &duration, &kbps) == 2 && duration > 0)
+            add(duration, kbps * 1000);
+    }
+    fclose(f);
+    return !samples.empty();
+}
+
+void Trace::add(double duration, double bps)
+{
+    samples.push_back(TraceSample(duration, bps > 1.0 ? bps : 1.0));
+}
+
+double Trace::total() const
+{
+    double t = 0.0;
+    for(size_t i = 0; i < samples.size(); i++)
+        t += samples[i].duration;
+    return t;
+}
+
+/* Time to download bits starting at time start, looping over the trace */
+double Trace::downloadTime(double start, double bits) const
+{
+    const double loop = total();
+    double elapsed = 0.0;
+    double t = start - loop * (unsigned)(start / loop);
+    size_t i = 0;
+
+    while(t >= samples[i].duration)
+        t -= samples[i++].duration;
+
+    while(bits > 0.0)
+    {
+        const TraceSample &s = samples[i];
+        const double remain = s.duration - t;
+        if(s.bps * remain >= bits)
+        {
+            elapsed += bits / s.bps;
+            break;
+        }
+        bits -= s.bps * remain;
+        elapsed += remain;
+        t = 0.0;
+        i = (i + 1) % samples.size();
+    }
+    return elapsed;
+}
+
+static AbstractAdaptationLogic *createLogic(const std::string &name)
+{
+    if(name == "rate")
+        return new RateBasedAdaptationLogic(NULL);
+    if(name == "predictive")
+        return new PredictiveAdaptationLogic(NULL);
+    if(name == "nearoptimal")
+        return new NearOptimalAdaptationLogic(NULL);
+    if(name == "bola")
+        return new BufferBasedAdaptationLogic(NULL, CLOCK_FREQ * 12, CLOCK_FREQ * 3);
+    if(name == "lowest")
+        return new AlwaysLowestAdaptationLogic();
+    if(name == "highest")
+        return new AlwaysBestAdaptationLogic();
+    return NULL;
+}
+
+static Results simulate(AbstractAdaptationLogic *logic, const Trace &trace,
+                        const Config &cfg)
+{
+    Results res;
+    PrintTelemetry telemetry(cfg.verbose);
+    logic->setTelemetry(&telemetry);
+
+    BaseAdaptationSet set(NULL);
+    const ID id("sim");
+    set.setID(id);
+    for(size_t i = 0; i < cfg.bitrates.size(); i++)
+    {
+        BaseRepresentation *rep = new BaseRepresentation(&set);
+        rep->setBandwidth(cfg.bitrates[i]);
+        set.addRepresentation(rep);
+    }
+
+    const double duration = cfg.duration > 0 ? cfg.duration : trace.total();
+    const mtime_t segment = cfg.segment * CLOCK_FREQ;
+    double now = 0.0, buffer = 0.0, bitsum = 0.0;
+    bool playing = false;
+    BaseRepresentation *prev = NULL;
+
+    logic->trackerEvent(SegmentTrackerEvent(id, true));
+
+    while(now < duration)
+    {
+        telemetry.clock = now;
+        BaseRepresentation *rep = logic->getNextRepresentation(&set, prev);
+        assert(rep != NULL);
+        if(rep != prev)
+        {
+            logic->trackerEvent(SegmentTrackerEvent(prev, rep));
+            if(prev)
+                res.switches++;
+        }
+        logic->trackerEvent(SegmentTrackerEvent(id, segment));
+
+        const double bits = rep->getBandwidth() * cfg.segment;
+        const double dl = trace.downloadTime(now, bits);
+        if(playing)
+        {
+            if(dl > buffer)
+            {
+                res.stalls++;
+                res.stalled += dl - buffer;
+                buffer = 0.0;
+            }
+            else buffer -= dl;
+        }
+        now += dl;
+        buffer += cfg.segment;
+        if(!playing)
+        {
+            playing = true;
+            res.startup = now;
+        }
+
+        logic->updateDownloadRate(id, bits / 8, dl * CLOCK_FREQ + 1);
+
+        /* Demuxer stops requesting segments once its buffer is full */
+        if(buffer > cfg.maxbuffer)
+        {
+            now += buffer - cfg.maxbuffer;
+            buffer = cfg.maxbuffer;
+        }
+        logic->trackerEvent(SegmentTrackerEvent(id, 0, buffer * CLOCK_FREQ,
+                                                cfg.maxbuffer * CLOCK_FREQ));
+
+        bitsum += rep->getBandwidth();
+        res.segments++;
+        prev = rep;
+    }
+
+    logic->trackerEvent(SegmentTrackerEvent(id, false));
+    logic->setTelemetry(NULL);
+    res.bitrate = res.segments ? bitsum / res.segments : 0.0;
+    return res;
+}
+
+static void report(const std::string &name, const Results &res)
+{
+    printf("%-12s startup %6.3fs stalls %3u (%7.3fs) switches %3u"
+           " avg %8.1f kbps segments %u\n",
+           name.c_str(), res.startup, res.stalls, res.stalled,
+           res.switches, res.bitrate / 1000, res.segments);
+}
+
+static int selfTest(Config &cfg)
+{
+    static const char *const logics[] = {
+        "rate", "predictive", "nearoptimal", "bola", "lowest", "highest",
+    };
+
+    Trace trace;
+    trace.add(60, 5000000);
+    trace.add(30, 1000000);
+    trace.add(60, 5000000);
+    trace.add(30, 600000);
+
+    for(size_t i = 0; i < ARRAY_SIZE(logics); i++)
+    {
+        AbstractAdaptationLogic *logic = createLogic(logics[i]);
+        assert(logic != NULL);
+        Results res = simulate(logic, trace, cfg);
+        delete logic;
+        report(logics[i], res);
+
+        assert(res.segments > 0);
+        if(!strcmp(logics[i], "lowest"))
+        {
+            /* never faster than real time with those bitrates */
+            assert(res.stalls == 0);
+            assert(res.bitrate == cfg.bitrates.front());
+        }
+        else if(!strcmp(logics[i], "bola"))
+        {
+            assert(res.stalled <= 2 * cfg.segment);
+            assert(res.bitrate > cfg.bitrates.front());
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    Config cfg;
+    std::string logicname = "bola";
+    const char *bitrates = "300,800,1500,3000,4500";
+    int c;
+
+    while((c = getopt(argc, argv, "l:r:s:b:d:v")) != -1)
+    {
+        switch(c)
+        {
+            case 'l': logicname = optarg; break;
+            case 'r': bitrates = optarg; break;
+            case 's': cfg.segment = atof(optarg); break;
+            case 'b': cfg.maxbuffer = atof(optarg); break;
+            case 'd': cfg.duration = atof(optarg); break;
+            case 'v': cfg.verbose = true; break;
+            default:
+                fprintf(stderr, "usage: %s [-l logic] [-r kbps,...] [-s segment] "
+                                "[-b maxbuffer] [-d duration] [-v] [trace]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    for(const char *p = bitrates; *p; )
+    {
+        char *end;
+        unsigned long kbps = strtoul(p, &end, 10);
+        if(end == p)
+            break;
+        cfg.bitrates.push_back((uint64_t) kbps * 1000);
+        p = (*end == ',') ? end + 1 : end;
+    }
+    if(cfg.bitrates.empty() || cfg.segment <= 0 || cfg.maxbuffer < cfg.segment)
+    {
+        fprintf(stderr, "invalid parameters\n");
+        return 1;
+    }
+
+    if(optind >= argc)
+        return selfTest(cfg);
+
+    Trace trace;
+    if(!trace.load(argv[optind]))
+    {
+        fprintf(stderr, "cannot load trace %s\n", argv[optind]);
+        return 1;
+    }
+
+    AbstractAdaptationLogic *logic = createLogic(logicname);
+    if(!logic)
+    {
+        fprintf(stderr, "unknown logic %s\n", logicname.c_str());
+        return 1;
+    }
+
+    if(cfg.verbose)
+        printf("time,stream,throughput,buffer,target,prev,next,reason\n");
+    Results res = simulate(logic, trace, cfg);
+    delete logic;
+    report(logicname, res);
+    return 0;
+}
@@ -43,6 +43,7 @@
 #include <vlc_codecs.h>
 #include <vlc_charset.h>
 #include <vlc_memory.h>
+#include <vlc_seekindex.h>
 
 #include "libavi.h"
 #include "../rawdv.h"
@@ -187,6 +188,9 @@ struct demux_sys_t
     uint64_t i_movi_begin;
     uint64_t i_movi_lastchunk_pos;   /* XXX position of last valid chunk */
 
+    /* index built by a previous AVI_IndexCreate() */
+    vlc_seekindex_t *p_seekindex;
+
     /* number of streams and information */
     unsigned int i_track;
     avi_track_t  **track;
@@ -224,6 +228,7 @@ static int AVI_PacketSearch   ( demux_t * );
 
 static void AVI_IndexLoad    ( demux_t * );
 static void AVI_IndexCreate  ( demux_t * );
+static bool AVI_IndexIsCached( demux_t * );
 
 static void AVI_ExtractSubtitle( demux_t *, unsigned int i_stream, avi_chunk_list_t *, avi_chunk_STRING_t * );
 
@@ -295,6 +300,9 @@ static void Close ( vlc_object_t * p_this )
         vlc_input_attachment_Delete(p_sys->attachment[i]);
     free(p_sys->attachment);
 
+    if( p_sys->p_seekindex )
+        vlc_seekindex_Close( p_sys->p_seekindex );
+
     free( p_sys );
 }
 
@@ -375,6 +383,8 @@ static int Open( vlc_object_t * p_this )
     vlc_stream_Control( p_demux->s, STREAM_CAN_FASTSEEK,
                         &p_sys->b_fastseekable );
     vlc_stream_Control( p_demux->s, STREAM_CAN_SEEK, &p_sys->b_seekable );
+    if( p_sys->b_fastseekable )
+        p_sys->p_seekindex = vlc_seekindex_Open( p_demux, p_demux->s, "avi" );
 
     p_sys->b_interleaved = var_InheritBool( p_demux, "avi-interleaved" );
 
@@ -870,6 +880,12 @@ aviindex:
                 b_index = true;
                 goto aviindex;
             }
+            if( AVI_IndexIsCached( p_demux ) )
+            {
+                b_index = true;
+                msg_Dbg( p_demux, "Restoring AVI index" );
+                goto aviindex;
+            }
             if( i_do_index == 0 )
             {
                 const char *psz_msg = _(
@@ -2732,6 +2748,74 @@ static void AVI_IndexLoad( demux_t *p_demux )
     }
 }
 
+/* The cached index covers the whole file from the first LIST-movi */
+static bool AVI_IndexIsCached( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    avi_chunk_list_t *p_riff, *p_movi;
+
+    p_riff = AVI_ChunkFind( &p_sys->ck_root, AVIFOURCC_RIFF, 0, true );
+    p_movi = AVI_ChunkFind( p_riff, AVIFOURCC_movi, 0, true );
+
+    return p_movi && p_sys->p_seekindex &&
+           vlc_seekindex_Covers( p_sys->p_seekindex, p_movi->i_chunk_pos,
+                                 stream_Size( p_demux->s ) );
+}
+
+static void AVI_IndexRestore( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    for( unsigned i_stream = 0; i_stream < p_sys->i_track; i_stream++ )
+    {
+        avi_track_t *tk = p_sys->track[i_stream];
+        size_t i_count = vlc_seekindex_Count( p_sys->p_seekindex, i_stream );
+
+        for( size_t i = 0; i < i_count; i++ )
+        {
+            const vlc_seekindex_entry_t *p_entry =
+                vlc_seekindex_Get( p_sys->p_seekindex, i_stream, i );
+
+            avi_entry_t index;
+            index.i_id      = 0; /* not stored */
+            index.i_flags   = p_entry->i_flags & VLC_SEEKINDEX_KEYFRAME ?
+                              AVIIF_KEYFRAME : 0;
+            index.i_pos     = p_entry->i_pos;
+            index.i_length  = p_entry->i_size;
+            avi_index_Append( &tk->idx, &p_sys->i_movi_lastchunk_pos, &index );
+        }
+        msg_Dbg( p_demux, "stream[%u] restored %u index entries",
+                 i_stream, tk->idx.i_size );
+    }
+}
+
+static void AVI_IndexStore( demux_t *p_demux, uint64_t i_movi_begin )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    for( unsigned i_stream = 0; i_stream < p_sys->i_track; i_stream++ )
+    {
+        avi_track_t *tk = p_sys->track[i_stream];
+
+        for( unsigned i = 0; i < tk->idx.i_size; i++ )
+        {
+            const avi_entry_t *p_index = &tk->idx.p_entry[i];
+            vlc_seekindex_entry_t entry = {
+                .i_time = AVI_GetDPTS( tk, tk->i_samplesize ?
+                                           (int64_t)p_index->i_lengthtotal : i ),
+                .i_pos = p_index->i_pos,
+                .i_size = p_index->i_length,
+                .i_flags = p_index->i_flags & AVIIF_KEYFRAME ?
+                           VLC_SEEKINDEX_KEYFRAME : 0,
+            };
+            if( vlc_seekindex_Add( p_sys->p_seekindex, i_stream, &entry ) )
+                return;
+        }
+    }
+    vlc_seekindex_AddRange( p_sys->p_seekindex, i_movi_begin,
+                            stream_Size( p_demux->s ) );
+}
+
 static void AVI_IndexCreate( demux_t *p_demux )
 {
     demux_sys_t *p_sys = p_demux->p_sys;
@@ -2741,6 +2825,7 @@ static void AVI_IndexCreate( demux_t *p_demux )
 
     unsigned int i_stream;
     uint32_t i_movi_end;
+    bool b_complete = false;
 
     mtime_t i_dialog_update;
     vlc_dialog_id *p_dialog_id = NULL;
@@ -2757,6 +2842,12 @@ static void AVI_IndexCreate( demux_t *p_demux )
     for( i_stream = 0; i_stream < p_sys->i_track; i_stream++ )
         avi_index_Init( &p_sys->track[i_stream]->idx );
 
+    if( AVI_IndexIsCached( p_demux ) )
+    {
+        AVI_IndexRestore( p_demux );
+        return;
+    }
+
     i_movi_end = __MIN( (uint32_t)(p_movi->i_chunk_pos + p_movi->i_chunk_size),
                         stream_Size( p_demux->s ) );
 
@@ -2782,7 +2873,7 @@ static void AVI_IndexCreate( demux_t *p_demux )
         if( p_dialog_id != NULL && mdate() - i_dialog_update > 100000 )
         {
             if( vlc_dialog_is_cancelled( p_demux, p_dialog_id ) )
-                break;
+                goto print_stat;
 
             double f_current = vlc_stream_Tell( p_demux->s );
             double f_size    = stream_Size( p_demux->s );
@@ -2793,7 +2884,10 @@ static void AVI_IndexCreate( demux_t *p_demux )
         }
 
         if( AVI_PacketGetHeader( p_demux, &pk ) )
+        {
+            b_complete = true;
             break;
+        }
 
         if( pk.i_stream < p_sys->i_track &&
             pk.i_cat == p_sys->track[pk.i_stream]->fmt.i_cat )
@@ -2822,9 +2916,13 @@ static void AVI_IndexCreate( demux_t *p_demux )
                     msg_Dbg( p_demux, "looking for new RIFF chunk" );
                     if( !p_sysx || vlc_stream_Seek( p_demux->s,
                                          p_sysx->i_chunk_pos + 24 ) )
+                    {
+                        b_complete = true;
                         goto print_stat;
+                    }
                     break;
                 }
+                b_complete = true;
                 goto print_stat;
 
             case AVIFOURCC_RIFF:
@@ -2848,6 +2946,7 @@ static void AVI_IndexCreate( demux_t *p_demux )
         if( ( !p_sys->b_odml && pk.i_pos + pk.i_size >= i_movi_end ) ||
             AVI_PacketNext( p_demux ) )
         {
+            b_complete = true;
             break;
         }
     }
@@ -2856,6 +2955,10 @@ print_stat:
     if( p_dialog_id != NULL )
         vlc_dialog_release( p_demux, p_dialog_id );
 
+    /* Do not keep partial indexes: they would prevent a complete rebuild */
+    if( b_complete && p_sys->p_seekindex )
+        AVI_IndexStore( p_demux, p_movi->i_chunk_pos );
+
     for( i_stream = 0; i_stream < p_sys->i_track; i_stream++ )
     {
         msg_Dbg( p_demux, "stream[%d] creating %d index entries",
@@ -28,6 +28,7 @@
 #include "util.hpp"
 #include "Ebml_parser.hpp"
 #include "Ebml_dispatcher.hpp"
+#include "stream_io_callback.hpp"
 
 #include <new>
 #include <iterator>
@@ -51,6 +52,7 @@ matroska_segment_c::matroska_segment_c( demux_sys_t & demuxer, EbmlStream & estr
     ,p_prev_segment_uid(NULL)
     ,p_next_segment_uid(NULL)
     ,b_cues(false)
+    ,p_seekindex(NULL)
     ,psz_muxing_application(NULL)
     ,psz_writing_application(NULL)
     ,psz_segment_filename(NULL)
@@ -66,6 +68,12 @@ matroska_segment_c::matroska_segment_c( demux_sys_t & demuxer, EbmlStream & estr
 
 matroska_segment_c::~matroska_segment_c()
 {
+    if( p_seekindex )
+    {
+        _seeker.save_index( p_seekindex );
+        vlc_seekindex_Close( p_seekindex );
+    }
+
     free( psz_writing_application );
     free( psz_muxing_application );
     free( psz_segment_filename );
@@ -695,6 +703,20 @@ bool matroska_segment_c::Preload( )
 
     ComputeTrackPriority();
 
+    /* Without cues, the seek points are found by scanning the clusters:
+     * keep them for the next time this file is opened */
+    if( !b_cues && cluster )
+    {
+        stream_t *s = static_cast<vlc_stream_io_callback *>( &es.I_O() )->GetStream();
+        char psz_name[32];
+
+        snprintf( psz_name, sizeof( psz_name ), "mkv-%" PRIu64,
+                  static_cast<uint64_t>( segment->GetElementPosition() ) );
+        p_seekindex = vlc_seekindex_Open( &sys.demuxer, s, psz_name );
+        if( p_seekindex )
+            _seeker.load_index( p_seekindex );
+    }
+
     b_preloaded = true;
 
     if( cluster )
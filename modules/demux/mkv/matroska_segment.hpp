@@ -113,6 +113,7 @@ public:
     KaxNextUID              *p_next_segment_uid;
 
     bool                    b_cues;
+    vlc_seekindex_t         *p_seekindex;
 
     /* info */
     char                    *psz_muxing_application;
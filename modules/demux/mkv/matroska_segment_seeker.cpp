@@ -516,3 +516,78 @@ SegmentSeeker::mkv_jump_to( matroska_segment_c& ms, fptr_t fpos )
     ms.es.I_O().setFilePointer( fpos );
 }
 
+
+/* cluster positions are stored as a pseudo-track of the seek index */
+static const unsigned SEEKINDEX_CLUSTERS = std::numeric_limits<unsigned>::max();
+
+void
+SegmentSeeker::load_index( vlc_seekindex_t const * idx )
+{
+    size_t const clusters = vlc_seekindex_Count( idx, SEEKINDEX_CLUSTERS );
+
+    if( clusters == 0 )
+        return; /* nothing to jump to */
+
+    for( size_t i = 0; i < clusters; ++i )
+    {
+        fptr_t fpos = vlc_seekindex_Get( idx, SEEKINDEX_CLUSTERS, i )->i_pos;
+
+        if( !std::binary_search( _cluster_positions.begin(), _cluster_positions.end(), fpos ) )
+            add_cluster_position( fpos );
+    }
+
+    for( tracks_seekpoints_t::const_iterator it = _tracks_seekpoints.begin(); it != _tracks_seekpoints.end(); ++it )
+    {
+        size_t const count = vlc_seekindex_Count( idx, it->first );
+
+        for( size_t i = 0; i < count; ++i )
+        {
+            vlc_seekindex_entry_t const * entry = vlc_seekindex_Get( idx, it->first, i );
+
+            add_seekpoint( it->first, Seekpoint( entry->i_pos, entry->i_time,
+                ( entry->i_flags & VLC_SEEKINDEX_KEYFRAME ) ? Seekpoint::TRUSTED
+                                                           : Seekpoint::QUESTIONABLE ) );
+        }
+    }
+
+    for( size_t i = 0; i < vlc_seekindex_CountRanges( idx ); ++i )
+    {
+        uint64_t start, end;
+
+        vlc_seekindex_GetRange( idx, i, &start, &end );
+        mark_range_as_searched( Range( start, end - 1 ) );
+    }
+}
+
+void
+SegmentSeeker::save_index( vlc_seekindex_t * idx ) const
+{
+    for( tracks_seekpoints_t::const_iterator it = _tracks_seekpoints.begin(); it != _tracks_seekpoints.end(); ++it )
+    {
+        for( seekpoints_t::const_iterator sp = it->second.begin(); sp != it->second.end(); ++sp )
+        {
+            if( sp->trust_level == Seekpoint::DISABLED )
+                continue;
+
+            vlc_seekindex_entry_t entry;
+            entry.i_time  = sp->pts;
+            entry.i_pos   = sp->fpos;
+            entry.i_size  = 0;
+            entry.i_flags = sp->trust_level == Seekpoint::TRUSTED ? VLC_SEEKINDEX_KEYFRAME : 0;
+
+            if( vlc_seekindex_Add( idx, it->first, &entry ) )
+                return;
+        }
+    }
+
+    for( cluster_positions_t::const_iterator it = _cluster_positions.begin(); it != _cluster_positions.end(); ++it )
+    {
+        vlc_seekindex_entry_t entry = { 0, *it, 0, 0 };
+
+        if( vlc_seekindex_Add( idx, SEEKINDEX_CLUSTERS, &entry ) )
+            return;
+    }
+
+    for( ranges_t::const_iterator it = _ranges_searched.begin(); it != _ranges_searched.end(); ++it )
+        vlc_seekindex_AddRange( idx, it->start, it->end + 1 );
+}
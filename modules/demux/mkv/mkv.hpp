@@ -45,6 +45,7 @@
 #include <vlc_input.h>
 #include <vlc_demux.h>
 #include <vlc_aout.h> /* For reordering */
+#include <vlc_seekindex.h>
 
 #include <iostream>
 #include <cassert>
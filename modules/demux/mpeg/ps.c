@@ -32,6 +32,7 @@
 #include <vlc_common.h>
 #include <vlc_plugin.h>
 #include <vlc_demux.h>
+#include <vlc_seekindex.h>
 
 #include "pes.h"
 #include "ps.h"
@@ -110,6 +111,10 @@ struct demux_sys_t
         CDXA_PS,
         PSMF_PS,
     } format;
+
+    /* pack positions, about one per second of played data */
+    vlc_seekindex_t *p_seekindex;
+    int64_t     i_index_scr;
 };
 
 static int Demux  ( demux_t *p_demux );
@@ -226,6 +231,12 @@ static int OpenCommon( vlc_object_t *p_this, bool b_force )
 
     vlc_stream_Control( p_demux->s, STREAM_CAN_SEEK, &p_sys->b_seekable );
 
+    /* CDXA seeks must be aligned on sectors */
+    p_sys->p_seekindex = NULL;
+    p_sys->i_index_scr = -1;
+    if( p_sys->b_seekable && format != CDXA_PS && !p_demux->b_preparsing )
+        p_sys->p_seekindex = vlc_seekindex_Open( p_demux, p_demux->s, "ps" );
+
     ps_psm_init( &p_sys->psm );
     ps_track_init( p_sys->tk );
 
@@ -265,6 +276,9 @@ static void Close( vlc_object_t *p_this )
 
     ps_psm_destroy( &p_sys->psm );
 
+    if( p_sys->p_seekindex )
+        vlc_seekindex_Close( p_sys->p_seekindex );
+
     free( p_sys );
 }
 
@@ -461,6 +475,18 @@ static int Demux( demux_t *p_demux )
             CheckPCR( p_sys, p_demux->out, p_sys->i_pack_scr );
             p_sys->i_scr = p_sys->i_pack_scr;
             p_sys->i_lastpack_byte = vlc_stream_Tell( p_demux->s );
+            if( p_sys->p_seekindex && !p_sys->b_bad_scr &&
+                p_sys->i_scr >= p_sys->i_first_scr &&
+                llabs( p_sys->i_scr - p_sys->i_index_scr ) >= CLOCK_FREQ )
+            {
+                vlc_seekindex_entry_t entry = {
+                    .i_time = p_sys->i_scr - p_sys->i_first_scr,
+                    .i_pos = p_sys->i_lastpack_byte - p_pkt->i_buffer,
+                    .i_flags = 0,
+                };
+                vlc_seekindex_Add( p_sys->p_seekindex, 0, &entry );
+                p_sys->i_index_scr = p_sys->i_scr;
+            }
             if( !p_sys->b_have_pack ) p_sys->b_have_pack = true;
             /* done later on to work around bad vcd/svcd streams */
             /* es_out_SetPCR( p_demux->out, p_sys->i_scr ); */
@@ -659,6 +685,27 @@ static int Demux( demux_t *p_demux )
     return VLC_DEMUXER_SUCCESS;
 }
 
+/* Seeks to a pack found while playing this file, if one is close enough */
+static int SeekIndexed( demux_t *p_demux, int64_t i_time )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    ssize_t i_entry = vlc_seekindex_Lookup( p_sys->p_seekindex, 0, i_time, 0 );
+    if( i_entry < 0 )
+        return VLC_EGENERIC;
+
+    const vlc_seekindex_entry_t *p_entry =
+        vlc_seekindex_Get( p_sys->p_seekindex, 0, i_entry );
+    if( i_time - p_entry->i_time > 2 * CLOCK_FREQ ||
+        vlc_stream_Seek( p_demux->s, p_entry->i_pos ) != VLC_SUCCESS )
+        return VLC_EGENERIC;
+
+    p_sys->i_current_pts = 0;
+    p_sys->i_scr = -1;
+    NotifyDiscontinuity( p_sys->tk, p_demux->out );
+    return VLC_SUCCESS;
+}
+
 /*****************************************************************************
  * Control:
  *****************************************************************************/
@@ -752,6 +799,8 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
 
         case DEMUX_SET_TIME:
             i64 = va_arg( args, int64_t );
+            if( p_sys->p_seekindex && SeekIndexed( p_demux, i64 ) == VLC_SUCCESS )
+                return VLC_SUCCESS;
             if( p_sys->i_time_track_index >= 0 && p_sys->i_current_pts > 0 && p_sys->i_length )
             {
                 i64 -= p_sys->tk[p_sys->i_time_track_index].i_first_pts;
@@ -35,6 +35,7 @@
 #include <vlc_access.h>    /* DVB-specific things */
 #include <vlc_demux.h>
 #include <vlc_input.h>
+#include <vlc_seekindex.h>
 
 #include "ts_pid.h"
 #include "ts_streams.h"
@@ -497,6 +498,7 @@ static int Open( vlc_object_t *p_this )
 
     p_sys->b_canseek = false;
     p_sys->b_canfastseek = false;
+    p_sys->p_seekindex = NULL;
     p_sys->b_ignore_time_for_positions = var_InheritBool( p_demux, "ts-seek-percent" );
     p_sys->b_cc_check = var_InheritBool( p_demux, "ts-cc-check" );
 
@@ -526,6 +528,9 @@ static int Open( vlc_object_t *p_this )
     vlc_stream_Control( p_sys->stream, STREAM_CAN_SEEK, &p_sys->b_canseek );
     vlc_stream_Control( p_sys->stream, STREAM_CAN_FASTSEEK,
                         &p_sys->b_canfastseek );
+    if( p_sys->b_canfastseek && !p_demux->b_preparsing &&
+        p_sys->stream == p_demux->s )
+        p_sys->p_seekindex = vlc_seekindex_Open( p_demux, p_sys->stream, "ts" );
 
     if( !p_sys->b_access_control && var_CreateGetBool( p_demux, "ts-pmtfix-waitdata" ) )
         p_sys->es_creation = DELAY_ES;
@@ -589,6 +594,9 @@ static void Close( vlc_object_t *p_this )
     /* Clear up attachments */
     vlc_dictionary_clear( &p_sys->attachments, FreeDictAttachment, NULL );
 
+    if( p_sys->p_seekindex )
+        vlc_seekindex_Close( p_sys->p_seekindex );
+
     free( p_sys );
 }
 
@@ -1904,6 +1912,30 @@ static int SeekToTime( demux_t *p_demux, const ts_pmt_t *p_pmt, int64_t i_scaled
     if( i_head_pos >= i_tail_pos )
         return VLC_EGENERIC;
 
+    /* Narrow the search down with the points found by previous seeks */
+    const int64_t i_reltime = FROM_SCALE_NZ(i_scaledtime - p_pmt->pcr.i_first);
+    if( p_sys->p_seekindex && p_pmt->pcr.i_first > -1 )
+    {
+        ssize_t i_entry = vlc_seekindex_Lookup( p_sys->p_seekindex,
+                                                p_pmt->i_number, i_reltime, 0 );
+        if( i_entry >= 0 )
+        {
+            const vlc_seekindex_entry_t *p_entry =
+                vlc_seekindex_Get( p_sys->p_seekindex, p_pmt->i_number, i_entry );
+            if( i_reltime - p_entry->i_time < CLOCK_FREQ / 2 &&
+                p_entry->i_pos <= (uint64_t) i_stream_size )
+                return vlc_stream_Seek( p_sys->stream, p_entry->i_pos );
+            i_head_pos = __MAX( i_head_pos, p_entry->i_pos );
+        }
+        if( (size_t)(i_entry + 1) < vlc_seekindex_Count( p_sys->p_seekindex,
+                                                        p_pmt->i_number ) )
+        {
+            const vlc_seekindex_entry_t *p_entry =
+                vlc_seekindex_Get( p_sys->p_seekindex, p_pmt->i_number, i_entry + 1 );
+            i_tail_pos = __MIN( i_tail_pos, p_entry->i_pos );
+        }
+    }
+
     bool b_found = false;
     while( (i_head_pos + p_sys->i_packet_size) <= i_tail_pos && !b_found )
     {
@@ -1965,6 +1997,17 @@ static int SeekToTime( demux_t *p_demux, const ts_pmt_t *p_pmt, int64_t i_scaled
 
             if( i_pcr != -1 )
             {
+                int64_t i_pcrtime = TimeStampWrapAround( p_pmt->pcr.i_first, i_pcr )
+                                  - p_pmt->pcr.i_first;
+                if( p_sys->p_seekindex && p_pmt->pcr.i_first > -1 && i_pcrtime >= 0 )
+                {
+                    vlc_seekindex_entry_t entry = {
+                        .i_time = FROM_SCALE_NZ(i_pcrtime),
+                        .i_pos = i_pos,
+                    };
+                    vlc_seekindex_Add( p_sys->p_seekindex, p_pmt->i_number, &entry );
+                }
+
                 int64_t i_diff = i_scaledtime - TimeStampWrapAround( p_pmt->pcr.i_first, i_pcr );
                 if ( i_diff < 0 )
                     i_tail_pos = (i_splitpos >= p_sys->i_packet_size) ? i_splitpos - p_sys->i_packet_size : 0;
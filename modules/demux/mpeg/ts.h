@@ -128,6 +128,9 @@ struct demux_sys_t
     /* downloadable content */
     vlc_dictionary_t attachments;
 
+    /* time/position points found by SeekToTime, per program */
+    struct vlc_seekindex_t *p_seekindex;
+
     /* */
     bool        b_start_record;
 };
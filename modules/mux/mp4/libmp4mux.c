@@ -1051,6 +1051,50 @@ static bo_t *GetTextBox(void)
     return text;
 }
 
+/* Turns a sample entry into its encv/enca counterpart, with the original
+ * format and the 'cbcs' parameters in a protection scheme box (23001-7) */
+static void ProtectSampleEntry(mp4mux_trackinfo_t *p_track, bo_t *entry)
+{
+    if(!entry || !entry->b || entry->b->i_buffer < 8)
+        return;
+
+    const bool b_video = p_track->fmt.i_cat == VIDEO_ES;
+    bo_t *sinf = box_new("sinf");
+    bo_t *frma = box_new("frma");
+    bo_t *schm = box_full_new("schm", 0, 0);
+    bo_t *schi = box_new("schi");
+    bo_t *tenc = box_full_new("tenc", 1, 0);
+    if(!sinf || !frma || !schm || !schi || !tenc)
+    {
+        bo_free(sinf);
+        bo_free(frma);
+        bo_free(schm);
+        bo_free(schi);
+        bo_free(tenc);
+        return;
+    }
+
+    bo_add_mem(frma, 4, &entry->b->p_buffer[4]);  // original format
+    box_gather(sinf, frma);
+
+    bo_add_fourcc(schm, "cbcs");
+    bo_add_32be(schm, 0x00010000);                // scheme version 1.0
+    box_gather(sinf, schm);
+
+    bo_add_8(tenc, 0);                            // reserved
+    bo_add_8(tenc, b_video ? 0x19 : 0x00);        // 1:9 pattern, none for audio
+    bo_add_8(tenc, 1);                            // is protected
+    bo_add_8(tenc, 0);                            // per sample IV size
+    bo_add_mem(tenc, 16, p_track->cenc_kid);
+    bo_add_8(tenc, 16);                           // constant IV size
+    bo_add_mem(tenc, 16, p_track->cenc_iv);
+    box_gather(schi, tenc);
+    box_gather(sinf, schi);
+
+    memcpy(&entry->b->p_buffer[4], b_video ? "encv" : "enca", 4);
+    box_gather(entry, sinf);
+}
+
 static int64_t GetScaledEntryDuration( const mp4mux_entry_t *p_entry, uint32_t i_timescale,
                                        mtime_t *pi_total_mtime, int64_t *pi_total_scaled )
 {
@@ -1072,12 +1116,16 @@ static bo_t *GetStblBox(vlc_object_t *p_obj, mp4mux_trackinfo_t *p_track, bool b
     if(!stsd)
         return NULL;
     bo_add_32be(stsd, 1);
+    bo_t *entry = NULL;
     if (p_track->fmt.i_cat == AUDIO_ES)
-        box_gather(stsd, GetSounBox(p_obj, p_track, b_mov));
+        entry = GetSounBox(p_obj, p_track, b_mov);
     else if (p_track->fmt.i_cat == VIDEO_ES)
-        box_gather(stsd, GetVideBox(p_obj, p_track, b_mov));
+        entry = GetVideBox(p_obj, p_track, b_mov);
     else if (p_track->fmt.i_cat == SPU_ES)
-        box_gather(stsd, GetTextBox());
+        entry = GetTextBox();
+    if (p_track->b_encrypted)
+        ProtectSampleEntry(p_track, entry);
+    box_gather(stsd, entry);
 
     /* chunk offset table */
     bo_t *stco;
@@ -1629,17 +1677,9 @@ bo_t * mp4mux_GetMoovBox(vlc_object_t *p_obj, mp4mux_trackinfo_t **pp_tracks, un
             else bo_free(dref);
         }
 
-        /* add stbl */
-        bo_t *stbl;
-        if ( b_fragmented )
-        {
-            uint32_t i_backup = p_stream->i_entry_count;
-            p_stream->i_entry_count = 0;
-            stbl = GetStblBox(p_obj, p_stream, b_mov, b_stco64);
-            p_stream->i_entry_count = i_backup;
-        }
-        else
-            stbl = GetStblBox(p_obj, p_stream, b_mov, b_stco64);
+        /* add stbl, fragmented files can still index the samples
+         * written before the first fragment */
+        bo_t *stbl = GetStblBox(p_obj, p_stream, b_mov, b_stco64);
 
         /* append stbl to minf */
         p_stream->i_stco_pos += minf->b->i_buffer;
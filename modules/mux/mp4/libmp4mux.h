@@ -72,6 +72,11 @@ typedef struct
     unsigned int i_edits_count;
     mp4mux_edit_t *p_edits;
 
+    /* common encryption, 'cbcs' scheme with a constant IV */
+    bool         b_encrypted;
+    uint8_t      cenc_kid[16];
+    uint8_t      cenc_iv[16];
+
 } mp4mux_trackinfo_t;
 
 bool mp4mux_trackinfo_Init( mp4mux_trackinfo_t *, unsigned, uint32_t );
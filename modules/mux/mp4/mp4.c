@@ -35,13 +35,21 @@
 #include <vlc_block.h>
 
 #include <assert.h>
+#include <ctype.h>
 #include <time.h>
 
 #include <vlc_iso_lang.h>
 #include <vlc_meta.h>
+#include <vlc_rand.h>
+
+#ifdef HAVE_GCRYPT
+# include <gcrypt.h>
+# include <vlc_gcrypt.h>
+#endif
 
 #include "../demux/mp4/libmp4.h"
 #include "libmp4mux.h"
+#include "mp4journal.h"
 #include "../packetizer/hxxx_nal.h"
 
 /*****************************************************************************
@@ -53,6 +61,29 @@
     "\"Fast Start\" files are optimized for downloads and allow the user " \
     "to start previewing the file while it is downloading.")
 
+#define DURATION_TEXT N_("Expected duration")
+#define DURATION_LONGTEXT N_(\
+    "Expected duration of the recording, in seconds. The space of the index " \
+    "is then reserved at the start of the file, instead of moving all the " \
+    "data at the end, and the index is periodically checkpointed so that " \
+    "an interrupted recording can be recovered. 0 to disable.")
+#define CHECKPOINT_TEXT N_("Index checkpoint period")
+#define CHECKPOINT_LONGTEXT N_(\
+    "Period, in seconds, of the index checkpoints of recordings with an " \
+    "expected duration. 0 to disable.")
+
+#define CENCKEY_TEXT N_("Encryption key")
+#define CENCKEY_LONGTEXT N_(\
+    "16 bytes AES key, in hexadecimal, to encrypt the fragments with the " \
+    "common encryption 'cbcs' scheme.")
+#define CENCKID_TEXT N_("Encryption key ID")
+#define CENCKID_LONGTEXT N_(\
+    "16 bytes key identifier, in hexadecimal or as an UUID.")
+#define CENCIV_TEXT N_("Encryption IV")
+#define CENCIV_LONGTEXT N_(\
+    "16 bytes constant initialization vector, in hexadecimal. " \
+    "A random one is used if none is given.")
+
 static int  Open   (vlc_object_t *);
 static void Close  (vlc_object_t *);
 static int  OpenFrag   (vlc_object_t *);
@@ -69,6 +100,10 @@ vlc_module_begin ()
     add_bool(SOUT_CFG_PREFIX "faststart", true,
               FASTSTART_TEXT, FASTSTART_LONGTEXT,
               true)
+    add_integer(SOUT_CFG_PREFIX "duration", 0,
+                DURATION_TEXT, DURATION_LONGTEXT, true)
+    add_integer(SOUT_CFG_PREFIX "checkpoint", 10,
+                CHECKPOINT_TEXT, CHECKPOINT_LONGTEXT, true)
     set_capability("sout mux", 5)
     add_shortcut("mp4", "mov", "3gp")
     set_callbacks(Open, Close)
@@ -79,6 +114,12 @@ add_submodule ()
     set_subcategory(SUBCAT_SOUT_MUX)
     set_shortname("MP4 Frag")
     add_shortcut("mp4frag", "mp4stream")
+    add_string(SOUT_CFG_PREFIX "cenc-key", NULL,
+               CENCKEY_TEXT, CENCKEY_LONGTEXT, true)
+    add_string(SOUT_CFG_PREFIX "cenc-kid", NULL,
+               CENCKID_TEXT, CENCKID_LONGTEXT, true)
+    add_string(SOUT_CFG_PREFIX "cenc-iv", NULL,
+               CENCIV_TEXT, CENCIV_LONGTEXT, true)
     set_capability("sout mux", 0)
     set_callbacks(OpenFrag, CloseFrag)
 
@@ -88,7 +129,8 @@ vlc_module_end ()
  * Exported prototypes
  *****************************************************************************/
 static const char *const ppsz_sout_options[] = {
-    "faststart", NULL
+    "faststart", "duration", "checkpoint",
+    "cenc-key", "cenc-kid", "cenc-iv", NULL
 };
 
 static int Control(sout_mux_t *, int, va_list);
@@ -149,6 +191,9 @@ typedef struct
     mp4_fragindex_t *p_indexentries;
     uint32_t         i_indexentriesmax;
     uint32_t         i_indexentries;
+
+    /*** reserved index ***/
+    unsigned int     i_checkpoint_entry; /* first entry not checkpointed */
 } mp4_stream_t;
 
 struct sout_mux_sys_t
@@ -166,6 +211,16 @@ struct sout_mux_sys_t
     mtime_t  i_read_duration;
     mtime_t  i_start_dts;
 
+    /* index reserved at the start of the file */
+    mtime_t  i_expected_duration;
+    uint64_t i_moov_pos;
+    uint64_t i_moov_reserved;
+    uint64_t i_moov_estimate; /* upper bound of the moov size */
+    bool     b_index_overflow;
+    mtime_t  i_checkpoint_period;
+    mtime_t  i_checkpoint_time;
+    uint32_t i_checkpoint_seq;
+
     unsigned int   i_nb_streams;
     mp4_stream_t **pp_streams;
 
@@ -174,6 +229,14 @@ struct sout_mux_sys_t
     bool           b_fragmented;
     mtime_t        i_written_duration;
     uint32_t       i_mfhd_sequence;
+
+    /* common encryption */
+    bool           b_cenc;
+    uint8_t        cenc_kid[16];
+    uint8_t        cenc_iv[16];
+#ifdef HAVE_GCRYPT
+    gcry_cipher_hd_t cenc_ctx;
+#endif
 };
 
 static void box_send(sout_mux_t *p_mux,  bo_t *box);
@@ -183,6 +246,230 @@ static block_t *ConvertSUBT(block_t *);
 static bool CreateCurrentEdit(mp4_stream_t *, mtime_t, bool);
 static void DebugEdits(sout_mux_t *, const mp4_stream_t *);
 
+/* Upper bound of the index size of a sample: its stsz, stts, ctts, stss,
+ * stsc and co64 entries */
+#define INDEX_SAMPLE_SIZE 44
+/* Upper bound of what the final moov adds per track to the initial one:
+ * edit list and fragments defaults */
+#define INDEX_TRACK_SIZE  128
+
+static uint64_t EstimateSampleRate(const mp4_stream_t *p_stream)
+{
+    const es_format_t *p_fmt = &p_stream->mux.fmt;
+
+    switch (p_fmt->i_cat)
+    {
+        case VIDEO_ES:
+            return 1 + p_fmt->video.i_frame_rate / p_fmt->video.i_frame_rate_base;
+        case AUDIO_ES:
+            /* assume AAC frames if unknown */
+            return 1 + p_fmt->audio.i_rate /
+                   (p_fmt->audio.i_frame_length ? p_fmt->audio.i_frame_length : 1024);
+        default:
+            /* subtitles and their clearing samples */
+            return 2;
+    }
+}
+
+/* Reserves the space of the index for the expected duration. Until the
+ * recording is finalized, it holds the moov of the empty tracks, from which
+ * an interrupted recording can be rebuilt along with the checkpoints. */
+static int ReserveIndex(sout_mux_t *p_mux)
+{
+    sout_mux_sys_t *p_sys = p_mux->p_sys;
+
+    bo_t *moov = BuildMoov(p_mux);
+    if (!moov || !moov->b)
+    {
+        if (moov)
+            bo_free(moov);
+        return VLC_ENOMEM;
+    }
+
+    uint64_t i_samples = 0;
+    for (unsigned int i = 0; i < p_sys->i_nb_streams; i++)
+        i_samples += EstimateSampleRate(p_sys->pp_streams[i]);
+    i_samples = i_samples * p_sys->i_expected_duration / CLOCK_FREQ;
+
+    p_sys->i_moov_estimate = moov->b->i_buffer +
+                             INDEX_TRACK_SIZE * (p_sys->i_nb_streams + 1);
+    p_sys->i_moov_reserved = p_sys->i_moov_estimate +
+                             i_samples * INDEX_SAMPLE_SIZE;
+    if (p_sys->i_moov_reserved > INT32_MAX)
+        p_sys->i_moov_reserved = INT32_MAX;
+
+    size_t i_free = p_sys->i_moov_reserved - moov->b->i_buffer;
+    block_t *p_free = block_Alloc(i_free);
+    if (!p_free)
+    {
+        bo_free(moov);
+        return VLC_ENOMEM;
+    }
+    memset(p_free->p_buffer, 0, i_free);
+    SetDWBE(p_free->p_buffer, i_free);
+    memcpy(&p_free->p_buffer[4], "free", 4);
+
+    msg_Dbg(p_mux, "reserved %"PRIu64" bytes for the index",
+            p_sys->i_moov_reserved);
+
+    p_sys->i_moov_pos = p_sys->i_pos;
+    p_sys->i_pos += p_sys->i_moov_reserved;
+    box_send(p_mux, moov);
+    sout_AccessOutWrite(p_mux->p_access, p_free);
+
+    return VLC_SUCCESS;
+}
+
+/* Writes the moov in the reserved space, followed by a free box for what
+ * remains of it */
+static bool WriteReservedMoov(sout_mux_t *p_mux, bo_t *moov)
+{
+    sout_mux_sys_t *p_sys = p_mux->p_sys;
+    const uint64_t i_size = moov->b->i_buffer;
+
+    if (i_size != p_sys->i_moov_reserved && i_size + 8 > p_sys->i_moov_reserved)
+        return false;
+
+    sout_AccessOutSeek(p_mux->p_access, p_sys->i_moov_pos);
+    box_send(p_mux, moov);
+    if (i_size < p_sys->i_moov_reserved)
+    {
+        block_t *p_free = block_Alloc(8);
+        if (p_free)
+        {
+            SetDWBE(p_free->p_buffer, p_sys->i_moov_reserved - i_size);
+            memcpy(&p_free->p_buffer[4], "free", 4);
+            sout_AccessOutWrite(p_mux->p_access, p_free);
+        }
+    }
+    sout_AccessOutSeek(p_mux->p_access, p_sys->i_pos);
+
+    return true;
+}
+
+static bool WriteMdatSize(sout_mux_t *p_mux)
+{
+    sout_mux_sys_t *p_sys = p_mux->p_sys;
+
+    bo_t bo;
+    if (!bo_init(&bo, 16))
+        return false;
+    if (p_sys->i_pos - p_sys->i_mdat_pos >= (((uint64_t)1)<<32)) {
+        /* Extended size */
+        bo_add_32be  (&bo, 1);
+        bo_add_fourcc(&bo, "mdat");
+        bo_add_64be  (&bo, p_sys->i_pos - p_sys->i_mdat_pos);
+    } else {
+        bo_add_32be  (&bo, 8);
+        bo_add_fourcc(&bo, "wide");
+        bo_add_32be  (&bo, p_sys->i_pos - p_sys->i_mdat_pos - 8);
+        bo_add_fourcc(&bo, "mdat");
+    }
+
+    sout_AccessOutSeek(p_mux->p_access, p_sys->i_mdat_pos);
+    sout_AccessOutWrite(p_mux->p_access, bo.b);
+    return true;
+}
+
+/* Writes in the mdat the index of the samples written since the previous
+ * checkpoint, see mp4journal.h */
+static void WriteCheckpoint(sout_mux_t *p_mux)
+{
+    sout_mux_sys_t *p_sys = p_mux->p_sys;
+
+    bo_t bo;
+    if (!bo_init(&bo, 4096))
+        return;
+    bo_add_mem (&bo, MP4_JOURNAL_MAGIC_SIZE, MP4_JOURNAL_MAGIC);
+    bo_add_32be(&bo, 0); /* fixed later */
+    bo_add_32be(&bo, MP4_JOURNAL_VERSION);
+    bo_add_32be(&bo, p_sys->i_checkpoint_seq++);
+    bo_add_32be(&bo, p_sys->i_nb_streams);
+
+    for (unsigned int i = 0; i < p_sys->i_nb_streams; i++)
+    {
+        mp4_stream_t *p_stream = p_sys->pp_streams[i];
+        unsigned int i_end = p_stream->mux.i_entry_count;
+
+        /* the length of the last subtitle is only known with the next one */
+        if (p_stream->mux.fmt.i_cat == SPU_ES && i_end > p_stream->i_checkpoint_entry)
+            i_end--;
+
+        bo_add_32be(&bo, p_stream->mux.i_track_id);
+        bo_add_64be(&bo, p_stream->i_first_dts > VLC_TS_INVALID ?
+                         p_stream->i_first_dts - p_sys->i_start_dts : 0);
+        bo_add_32be(&bo, i_end - p_stream->i_checkpoint_entry);
+        for (unsigned int j = p_stream->i_checkpoint_entry; j < i_end; j++)
+        {
+            const mp4mux_entry_t *e = &p_stream->mux.entry[j];
+            bo_add_64be(&bo, e->i_pos);
+            bo_add_32be(&bo, e->i_size);
+            bo_add_32be(&bo, __MIN(e->i_length, UINT32_MAX));
+            bo_add_32be(&bo, e->i_pts_dts);
+            bo_add_32be(&bo, (e->i_flags & BLOCK_FLAG_TYPE_I) ? MP4_JOURNAL_SAMPLE_SYNC : 0);
+        }
+        p_stream->i_checkpoint_entry = i_end;
+    }
+
+    if (!bo.b)
+        return;
+    bo_set_32be(&bo, MP4_JOURNAL_MAGIC_SIZE, bo.b->i_buffer + 4);
+    bo_add_32be(&bo, mp4_journal_crc(0, &bo.b->p_buffer[MP4_JOURNAL_MAGIC_SIZE],
+                                     bo.b->i_buffer - MP4_JOURNAL_MAGIC_SIZE));
+    if (!bo.b)
+        return;
+
+    p_sys->i_pos += bo.b->i_buffer;
+    sout_AccessOutWrite(p_mux->p_access, bo.b);
+
+    /* so that the mdat no longer ends at the initial moov */
+    if (WriteMdatSize(p_mux))
+        sout_AccessOutSeek(p_mux->p_access, p_sys->i_pos);
+}
+
+/* The index is about to overflow its reserved space: the samples written
+ * so far are indexed by the moov, and the next ones are written as
+ * fragments. */
+static bool SwitchToFragments(sout_mux_t *p_mux)
+{
+    sout_mux_sys_t *p_sys = p_mux->p_sys;
+
+    if (!WriteMdatSize(p_mux))
+        return false;
+
+    for (unsigned int i = 0; i < p_sys->i_nb_streams; i++)
+    {
+        mp4_stream_t *p_stream = p_sys->pp_streams[i];
+        if (p_stream->i_first_dts > VLC_TS_INVALID && !p_stream->mux.i_edits_count)
+            CreateCurrentEdit(p_stream, p_sys->i_start_dts, true);
+    }
+
+    p_sys->b_fragmented = true;
+    bo_t *moov = BuildMoov(p_mux);
+    if (!moov || !moov->b || !WriteReservedMoov(p_mux, moov))
+    {
+        if (moov)
+            bo_free(moov);
+        msg_Err(p_mux, "cannot switch to fragments, the index will be "
+                       "written at the end");
+        sout_AccessOutSeek(p_mux->p_access, p_sys->i_pos);
+        p_sys->b_fragmented = false;
+        p_sys->b_index_overflow = true;
+        return false;
+    }
+
+    msg_Warn(p_mux, "reserved index space is full, writing fragments");
+    for (unsigned int i = 0; i < p_sys->i_nb_streams; i++)
+    {
+        mp4_stream_t *p_stream = p_sys->pp_streams[i];
+        p_stream->i_written_duration = p_stream->mux.i_read_duration;
+    }
+    p_sys->i_mfhd_sequence = 1;
+    p_mux->pf_mux = MuxFrag;
+
+    return true;
+}
+
 static int WriteSlowStartHeader(sout_mux_t *p_mux)
 {
     sout_mux_sys_t *p_sys = p_mux->p_sys;
@@ -205,10 +492,17 @@ static int WriteSlowStartHeader(sout_mux_t *p_mux)
             return VLC_ENOMEM;
 
         p_sys->i_pos += box->b->i_buffer;
-        p_sys->i_mdat_pos = p_sys->i_pos;
         box_send(p_mux, box);
     }
 
+    if (p_sys->i_expected_duration > 0)
+    {
+        int i_ret = ReserveIndex(p_mux);
+        if (i_ret != VLC_SUCCESS)
+            return i_ret;
+    }
+    p_sys->i_mdat_pos = p_sys->i_pos;
+
     /* Now add mdat header */
     box = box_new("mdat");
     if(!box)
@@ -252,6 +546,18 @@ static int Open(vlc_object_t *p_this)
     p_sys->i_start_dts = VLC_TS_INVALID;
     p_sys->b_fragmented = false;
     p_sys->b_header_sent = false;
+    p_sys->b_cenc = false;
+
+    p_sys->i_expected_duration = CLOCK_FREQ *
+        var_GetInteger(p_mux, SOUT_CFG_PREFIX "duration");
+    p_sys->i_moov_pos = 0;
+    p_sys->i_moov_reserved = 0;
+    p_sys->i_moov_estimate = 0;
+    p_sys->b_index_overflow = false;
+    p_sys->i_checkpoint_period = CLOCK_FREQ *
+        var_GetInteger(p_mux, SOUT_CFG_PREFIX "checkpoint");
+    p_sys->i_checkpoint_time = 0;
+    p_sys->i_checkpoint_seq = 0;
 
     /* FIXME FIXME
      * Quicktime actually doesn't like the 64 bits extensions !!! */
@@ -270,24 +576,16 @@ static void Close(vlc_object_t *p_this)
 
     msg_Dbg(p_mux, "Close");
 
-    /* Update mdat size */
-    bo_t bo;
-    if (!bo_init(&bo, 16))
-        goto cleanup;
-    if (p_sys->i_pos - p_sys->i_mdat_pos >= (((uint64_t)1)<<32)) {
-        /* Extended size */
-        bo_add_32be  (&bo, 1);
-        bo_add_fourcc(&bo, "mdat");
-        bo_add_64be  (&bo, p_sys->i_pos - p_sys->i_mdat_pos);
-    } else {
-        bo_add_32be  (&bo, 8);
-        bo_add_fourcc(&bo, "wide");
-        bo_add_32be  (&bo, p_sys->i_pos - p_sys->i_mdat_pos - 8);
-        bo_add_fourcc(&bo, "mdat");
+    /* The reserved index overflowed into fragments */
+    if (p_sys->b_fragmented)
+    {
+        CloseFrag(p_this);
+        return;
     }
 
-    sout_AccessOutSeek(p_mux->p_access, p_sys->i_mdat_pos);
-    sout_AccessOutWrite(p_mux->p_access, bo.b);
+    /* Update mdat size */
+    if (!WriteMdatSize(p_mux))
+        goto cleanup;
 
     /* Create MOOV header */
     const bool b_stco64 = (p_sys->i_pos >= (((uint64_t)0x1) << 32));
@@ -296,6 +594,26 @@ static void Close(vlc_object_t *p_this)
 
     /* Check we need to create "fast start" files */
     p_sys->b_fast_start = var_GetBool(p_this, SOUT_CFG_PREFIX "faststart");
+    if (p_sys->i_moov_reserved)
+    {
+        /* No need to move the data, unless the index did not fit */
+        p_sys->b_fast_start = false;
+        if (moov && moov->b && WriteReservedMoov(p_mux, moov))
+            moov = NULL;
+        else
+        {
+            block_t *p_free = block_Alloc(8);
+            if (p_free)
+            {
+                msg_Warn(p_mux, "reserved index space is too small, "
+                                "writing the index at the end");
+                SetDWBE(p_free->p_buffer, p_sys->i_moov_reserved);
+                memcpy(&p_free->p_buffer[4], "free", 4);
+                sout_AccessOutSeek(p_mux->p_access, p_sys->i_moov_pos);
+                sout_AccessOutWrite(p_mux->p_access, p_free);
+            }
+        }
+    }
     while (p_sys->b_fast_start && moov && moov->b) {
         /* Move data to the end of the file so we can fit the moov header
          * at the start */
@@ -470,6 +788,23 @@ static int AddStream(sout_mux_t *p_mux, sout_input_t *p_input)
     p_stream->p_indexentries     = NULL;
     p_stream->i_indexentriesmax  = 0;
     p_stream->i_indexentries     = 0;
+    p_stream->i_checkpoint_entry = 0;
+
+    if (p_sys->b_cenc)
+    {
+        /* Video needs subsample encryption to keep the NAL headers clear */
+        if (p_stream->mux.fmt.i_cat == AUDIO_ES ||
+            p_stream->mux.fmt.i_codec == VLC_CODEC_H264 ||
+            p_stream->mux.fmt.i_codec == VLC_CODEC_HEVC)
+        {
+            p_stream->mux.b_encrypted = true;
+            memcpy(p_stream->mux.cenc_kid, p_sys->cenc_kid, 16);
+            memcpy(p_stream->mux.cenc_iv, p_sys->cenc_iv, 16);
+        }
+        else
+            msg_Warn(p_mux, "cannot encrypt %4.4s, leaving stream %d clear",
+                     (char*)&p_input->p_fmt->i_codec, p_sys->i_nb_streams);
+    }
 
     p_input->p_sys          = p_stream;
 
@@ -601,6 +936,19 @@ static int Mux(sout_mux_t *p_mux)
     }
 
     for (;;) {
+        if (p_sys->i_moov_reserved && !p_sys->b_mov && !p_sys->b_index_overflow &&
+            p_sys->i_moov_estimate + 2 * INDEX_SAMPLE_SIZE > p_sys->i_moov_reserved &&
+            SwitchToFragments(p_mux))
+        {
+            while (sout_MuxGetStream(p_mux, 1, NULL) >= 0)
+            {
+                int i_ret = MuxFrag(p_mux);
+                if (i_ret != VLC_SUCCESS)
+                    return i_ret;
+            }
+            return VLC_SUCCESS;
+        }
+
         int i_stream = sout_MuxGetStream(p_mux, 2, NULL);
         if (i_stream < 0)
             return(VLC_SUCCESS);
@@ -736,6 +1084,7 @@ static int Mux(sout_mux_t *p_mux)
 
         /* write data */
         p_sys->i_pos += p_data->i_buffer;
+        p_sys->i_moov_estimate += INDEX_SAMPLE_SIZE;
         sout_AccessOutWrite(p_mux->p_access, p_data);
 
         /* Add SPU clearing tag (duration tb fixed on next SPU or stream end )*/
@@ -762,6 +1111,7 @@ static int Mux(sout_mux_t *p_mux)
                 e_empty->i_flags  = 0;
 
                 p_sys->i_pos += p_empty->i_buffer;
+                p_sys->i_moov_estimate += INDEX_SAMPLE_SIZE;
                 sout_AccessOutWrite(p_mux->p_access, p_empty);
             }
         }
@@ -769,6 +1119,13 @@ static int Mux(sout_mux_t *p_mux)
         /* Update the global segment/media duration */
         if( p_stream->mux.i_read_duration > p_sys->i_read_duration )
             p_sys->i_read_duration = p_stream->mux.i_read_duration;
+
+        if (p_sys->i_moov_reserved && p_sys->i_checkpoint_period > 0 &&
+            p_sys->i_read_duration - p_sys->i_checkpoint_time >= p_sys->i_checkpoint_period)
+        {
+            WriteCheckpoint(p_mux);
+            p_sys->i_checkpoint_time = p_sys->i_read_duration;
+        }
     }
 
     return(VLC_SUCCESS);
@@ -857,6 +1214,144 @@ static void AddKeyframeEntry(mp4_stream_t *p_stream, const uint64_t i_moof_pos,
     }
 }
 
+/* Clear bytes left at the start of video NAL units, covering the slice
+ * headers, and limit keeping the auxiliary info of a sample in a byte */
+#define CENC_CLEAR_LEAD     32
+#define CENC_MAX_SUBSAMPLES 42
+
+#ifdef HAVE_GCRYPT
+/* Encrypts a protected range from the constant IV, every block for audio,
+ * one block out of ten for video */
+static void CencEncryptRange(sout_mux_sys_t *p_sys, uint8_t *p_data,
+                             size_t i_data, bool b_pattern)
+{
+    const size_t i_blocks = i_data / 16;
+
+    gcry_cipher_setiv(p_sys->cenc_ctx, p_sys->cenc_iv, 16);
+    if (!b_pattern)
+    {
+        gcry_cipher_encrypt(p_sys->cenc_ctx, p_data, i_blocks * 16, NULL, 0);
+        return;
+    }
+    for (size_t i = 0; i < i_blocks; i += 10)
+        gcry_cipher_encrypt(p_sys->cenc_ctx, &p_data[i * 16], 16, NULL, 0);
+}
+
+static bool CencIsVCL(vlc_fourcc_t i_codec, uint8_t i_nal_header)
+{
+    if (i_codec == VLC_CODEC_H264)
+    {
+        const uint8_t i_type = i_nal_header & 0x1f;
+        return i_type >= 1 && i_type <= 5;
+    }
+    return ((i_nal_header >> 1) & 0x3f) < 32;
+}
+
+/* Number of subsamples needed to describe clear bytes */
+static unsigned CencClearEntries(size_t i_clear)
+{
+    return (i_clear + UINT16_MAX - 1) / UINT16_MAX;
+}
+
+static void CencAddSubsamples(bo_t *senc, size_t *pi_clear,
+                              uint32_t i_protected, unsigned *pi_count)
+{
+    do
+    {
+        const uint16_t i_clear = __MIN(*pi_clear, UINT16_MAX);
+        *pi_clear -= i_clear;
+        if (senc)
+        {
+            bo_add_16be(senc, i_clear);
+            bo_add_32be(senc, *pi_clear ? 0 : i_protected);
+        }
+        (*pi_count)++;
+    } while (*pi_clear > 0);
+}
+
+/* Splits a video sample in subsamples per NAL unit. A NAL unit is only
+ * protected if the rest of the sample could still be described while left
+ * clear, so that the count never exceeds CENC_MAX_SUBSAMPLES, unless the
+ * sample holds too much clear data from the start.
+ * Encrypts the sample and adds the subsamples to senc, unless senc is NULL.
+ * Returns the number of subsamples. */
+static unsigned CencSplitSample(sout_mux_sys_t *p_sys,
+                                const mp4_stream_t *p_stream,
+                                block_t *p_block, bo_t *senc)
+{
+    unsigned i_count = 0;
+    size_t i_clear = 0;
+    uint8_t *p_data = p_block->p_buffer;
+    size_t i_data = p_block->i_buffer;
+
+    while (i_data > 4)
+    {
+        size_t i_nal = __MIN(GetDWBE(p_data), i_data - 4);
+        const size_t i_rest = i_data - 4 - i_nal;
+
+        if (i_nal > CENC_CLEAR_LEAD + 16 &&
+            CencIsVCL(p_stream->mux.fmt.i_codec, p_data[4]) &&
+            i_count + CencClearEntries(i_clear + 4 + CENC_CLEAR_LEAD) +
+                      CencClearEntries(i_rest) <= CENC_MAX_SUBSAMPLES)
+        {
+            const size_t i_protected = i_nal - CENC_CLEAR_LEAD;
+
+            i_clear += 4 + CENC_CLEAR_LEAD;
+            if (senc)
+                CencEncryptRange(p_sys, &p_data[4 + CENC_CLEAR_LEAD],
+                                 i_protected, true);
+            CencAddSubsamples(senc, &i_clear, i_protected, &i_count);
+        }
+        else
+            i_clear += 4 + i_nal;
+
+        p_data += 4 + i_nal;
+        i_data -= 4 + i_nal;
+    }
+    i_clear += i_data;
+    if (i_clear > 0 || i_count == 0)
+        CencAddSubsamples(senc, &i_clear, 0, &i_count);
+    return i_count;
+}
+
+/* Encrypts a sample in place. Video samples are split in subsamples per
+ * NAL unit, whose sizes are added to senc.
+ * Returns the size of the sample auxiliary information. */
+static uint8_t CencEncryptSample(sout_mux_sys_t *p_sys,
+                                 const mp4_stream_t *p_stream,
+                                 block_t *p_block, bo_t *senc)
+{
+    if (p_stream->mux.fmt.i_cat != VIDEO_ES)
+    {
+        CencEncryptRange(p_sys, p_block->p_buffer, p_block->i_buffer, false);
+        return 0;
+    }
+
+    const size_t i_count_pos = senc->b ? senc->b->i_buffer : 0;
+    unsigned i_count;
+
+    bo_add_16be(senc, 0);
+    if (likely(CencSplitSample(p_sys, p_stream, p_block, NULL)
+                <= CENC_MAX_SUBSAMPLES))
+        i_count = CencSplitSample(p_sys, p_stream, p_block, senc);
+    else
+    {   /* Too much clear data to describe: protect the whole sample */
+        CencEncryptRange(p_sys, p_block->p_buffer, p_block->i_buffer, true);
+        bo_add_16be(senc, 0);
+        bo_add_32be(senc, p_block->i_buffer);
+        i_count = 1;
+    }
+    bo_set_16be(senc, i_count_pos, i_count);
+
+    /* Report the size actually written */
+    if (unlikely(senc->b == NULL))
+        return 0; /* out of memory, the box is lost anyway */
+    const size_t i_size = senc->b->i_buffer - i_count_pos;
+    assert(i_size == 2 + 6 * i_count && i_size <= UINT8_MAX);
+    return i_size;
+}
+#endif
+
 /* Creates moof box and traf/trun information.
  * Single run per traf is absolutely not optimal as interleaving should be done
  * using runs and not limiting moof size, but creating an relative offset only
@@ -868,19 +1363,29 @@ static bo_t *GetMoofBox(sout_mux_t *p_mux, size_t *pi_mdat_total_size,
     sout_mux_sys_t *p_sys = p_mux->p_sys;
 
     bo_t            *moof, *mfhd;
-    size_t           i_fixupoffset = 0;
+    size_t          *pi_fixups;
+    unsigned         i_fixups = 0;
 
     *pi_mdat_total_size = 0;
 
+    /* trun data offset positions, and their offsets in the mdat */
+    pi_fixups = vlc_alloc(p_sys->i_nb_streams, 2 * sizeof(*pi_fixups));
+    if(!pi_fixups)
+        return NULL;
+
     moof = box_new("moof");
     if(!moof)
+    {
+        free(pi_fixups);
         return NULL;
+    }
 
     /* *** add /moof/mfhd *** */
 
     mfhd = box_full_new("mfhd", 0, 0);
     if(!mfhd)
     {
+        free(pi_fixups);
         bo_free(moof);
         return NULL;
     }
@@ -933,6 +1438,11 @@ static bo_t *GetMoofBox(sout_mux_t *p_mux, size_t *pi_mdat_total_size,
             i_tfhd_flags |= MP4_TFHD_DURATION_IS_EMPTY;
         }
 
+        /* Encryption info offsets are relative to the moof, so are all
+         * the data offsets then */
+        if (p_sys->b_cenc)
+            i_tfhd_flags |= MP4_TFHD_DEFAULT_BASE_IS_MOOF;
+
         /* *** add /moof/traf/tfhd *** */
         bo_t *tfhd = box_full_new("tfhd", 0, i_tfhd_flags);
         if(!tfhd)
@@ -981,7 +1491,7 @@ static bo_t *GetMoofBox(sout_mux_t *p_mux, size_t *pi_mdat_total_size,
             if (p_stream->mux.b_hasbframes)
                 i_trun_flags |= MP4_TRUN_SAMPLE_TIME_OFFSET;
 
-            if (i_fixupoffset == 0)
+            if (i_fixups == 0 || p_sys->b_cenc)
                 i_trun_flags |= MP4_TRUN_DATA_OFFSET;
 
             bo_t *trun = box_full_new("trun", 0, i_trun_flags);
@@ -991,6 +1501,32 @@ static bo_t *GetMoofBox(sout_mux_t *p_mux, size_t *pi_mdat_total_size,
                 continue;
             }
 
+            /* sample encryption and its auxiliary info sizes and offset */
+            bo_t *senc = NULL, *saiz = NULL;
+            uint32_t i_aux_count = 0;
+#ifdef HAVE_GCRYPT
+            if (p_stream->mux.b_encrypted &&
+                p_stream->mux.fmt.i_cat == VIDEO_ES)
+            {
+                senc = box_full_new("senc", 0, 0x2); // subsamples
+                saiz = box_full_new("saiz", 0, 0);
+                if (senc && saiz)
+                {
+                    bo_add_32be(senc, 0);
+                    bo_add_8(saiz, 0);    // no default sample info size
+                    bo_add_32be(saiz, 0);
+                }
+                if (!senc || !senc->b || !saiz || !saiz->b)
+                {
+                    bo_free(senc);
+                    bo_free(saiz);
+                    bo_free(trun);
+                    bo_free(traf);
+                    continue;
+                }
+            }
+#endif
+
             /* count entries */
             uint32_t i_entry_count = 0;
             mtime_t i_run_time = p_stream->i_written_duration;
@@ -1007,7 +1543,9 @@ static bo_t *GetMoofBox(sout_mux_t *p_mux, size_t *pi_mdat_total_size,
 
             if (i_trun_flags & MP4_TRUN_DATA_OFFSET)
             {
-                i_fixupoffset = moof->b->i_buffer + traf->b->i_buffer + trun->b->i_buffer;
+                pi_fixups[2 * i_fixups] = moof->b->i_buffer + traf->b->i_buffer + trun->b->i_buffer;
+                pi_fixups[2 * i_fixups + 1] = *pi_mdat_total_size;
+                i_fixups++;
                 bo_add_32be(trun, 0xdeadbeef); // data offset
             }
 
@@ -1037,6 +1575,17 @@ static bo_t *GetMoofBox(sout_mux_t *p_mux, size_t *pi_mdat_total_size,
 
                 *pi_mdat_total_size += p_entry->p_block->i_buffer;
 
+#ifdef HAVE_GCRYPT
+                if (p_stream->mux.b_encrypted)
+                {
+                    uint8_t i_aux = CencEncryptSample(p_sys, p_stream,
+                                                      p_entry->p_block, senc);
+                    if (saiz)
+                        bo_add_8(saiz, i_aux);
+                    i_aux_count++;
+                }
+#endif
+
                 ENQUEUE_ENTRY(p_stream->towrite, p_entry);
                 i_entry_count--;
                 i_sample++;
@@ -1052,6 +1601,25 @@ static bo_t *GetMoofBox(sout_mux_t *p_mux, size_t *pi_mdat_total_size,
             }
 
             box_gather(traf, trun);
+
+            if (senc)
+            {
+                /* saio points to the first sample info, past the count */
+                const size_t i_info_pos = moof->b->i_buffer + traf->b->i_buffer + 16;
+
+                bo_set_32be(senc, 12, i_aux_count);
+                bo_set_32be(saiz, 13, i_aux_count);
+                box_gather(traf, senc);
+                box_gather(traf, saiz);
+
+                bo_t *saio = box_full_new("saio", 0, 0);
+                if (saio)
+                {
+                    bo_add_32be(saio, 1);
+                    bo_add_32be(saio, i_info_pos);
+                }
+                box_gather(traf, saio);
+            }
         }
 
         box_gather(moof, traf);
@@ -1059,21 +1627,18 @@ static bo_t *GetMoofBox(sout_mux_t *p_mux, size_t *pi_mdat_total_size,
 
     if(!moof->b)
     {
+        free(pi_fixups);
         bo_free(moof);
         return NULL;
     }
 
     box_fix(moof, moof->b->i_buffer);
 
-    /* do tfhd base data offset fixup */
-    if (i_fixupoffset)
-    {
-        /* mdat will follow moof */
-        bo_set_32be(moof, i_fixupoffset, moof->b->i_buffer + 8);
-    }
-
-    /* set iframe flag, so the streaming server always starts from moof */
-    moof->b->i_flags |= BLOCK_FLAG_TYPE_I;
+    /* do trun data offset fixups, mdat will follow moof */
+    for (unsigned i = 0; i < i_fixups; i++)
+        bo_set_32be(moof, pi_fixups[2 * i],
+                    moof->b->i_buffer + 8 + pi_fixups[2 * i + 1]);
+    free(pi_fixups);
 
     return moof;
 }
@@ -1178,8 +1743,10 @@ static void FlushHeader(sout_mux_t *p_mux)
 {
     sout_mux_sys_t *p_sys = (sout_mux_sys_t*) p_mux->p_sys;
 
-    /* Now add ftyp header */
-    bo_t *ftyp = mp4mux_GetFtyp(MAJOR_isom, 0, NULL, 0);
+    /* Now add ftyp header, moof relative offsets need iso5 or later */
+    vlc_fourcc_t extra[] = { VLC_FOURCC('i','s','o','6') };
+    bo_t *ftyp = mp4mux_GetFtyp(MAJOR_isom, 0, extra,
+                                p_sys->b_cenc ? ARRAY_SIZE(extra) : 0);
     if(!ftyp)
         return;
 
@@ -1195,6 +1762,84 @@ static void FlushHeader(sout_mux_t *p_mux)
     p_sys->b_header_sent = true;
 }
 
+#ifdef HAVE_GCRYPT
+/* Parses 16 bytes in hexadecimal, ignoring UUID dashes */
+static bool ParseHex16(const char *psz, uint8_t p_out[16])
+{
+    if (!strncasecmp(psz, "0x", 2))
+        psz += 2;
+    for (unsigned i = 0; i < 16; i++)
+    {
+        if (*psz == '-')
+            psz++;
+        unsigned i_byte;
+        if (!isxdigit((unsigned char)psz[0]) ||
+            !isxdigit((unsigned char)psz[1]) ||
+            sscanf(psz, "%2x", &i_byte) != 1)
+            return false;
+        p_out[i] = i_byte;
+        psz += 2;
+    }
+    return *psz == '\0';
+}
+#endif
+
+static int CencOpen(sout_mux_t *p_mux)
+{
+    sout_mux_sys_t *p_sys = p_mux->p_sys;
+    char *psz_key = var_GetNonEmptyString(p_mux, SOUT_CFG_PREFIX "cenc-key");
+
+    p_sys->b_cenc = false;
+    if (!psz_key)
+        return VLC_SUCCESS;
+
+#ifdef HAVE_GCRYPT
+    uint8_t key[16];
+    bool b_ok = ParseHex16(psz_key, key);
+    free(psz_key);
+
+    char *psz_kid = var_GetNonEmptyString(p_mux, SOUT_CFG_PREFIX "cenc-kid");
+    b_ok = b_ok && psz_kid && ParseHex16(psz_kid, p_sys->cenc_kid);
+    free(psz_kid);
+
+    char *psz_iv = var_GetNonEmptyString(p_mux, SOUT_CFG_PREFIX "cenc-iv");
+    if (psz_iv)
+        b_ok = b_ok && ParseHex16(psz_iv, p_sys->cenc_iv);
+    else
+        vlc_rand_bytes(p_sys->cenc_iv, 16);
+    free(psz_iv);
+
+    if (!b_ok)
+    {
+        msg_Err(p_mux, "encryption needs a 16 bytes key and key ID");
+        return VLC_EGENERIC;
+    }
+
+    vlc_gcrypt_init();
+    gcry_error_t err = gcry_cipher_open(&p_sys->cenc_ctx, GCRY_CIPHER_AES,
+                                        GCRY_CIPHER_MODE_CBC, 0);
+    if (!err)
+    {
+        err = gcry_cipher_setkey(p_sys->cenc_ctx, key, 16);
+        if (err)
+            gcry_cipher_close(p_sys->cenc_ctx);
+    }
+    if (err)
+    {
+        msg_Err(p_mux, "cannot setup AES: %s", gpg_strerror(err));
+        return VLC_EGENERIC;
+    }
+
+    p_sys->b_cenc = true;
+    msg_Dbg(p_mux, "encrypting with the cbcs scheme");
+    return VLC_SUCCESS;
+#else
+    free(psz_key);
+    msg_Err(p_mux, "encryption is not supported by this build");
+    return VLC_EGENERIC;
+#endif
+}
+
 static int OpenFrag(vlc_object_t *p_this)
 {
     sout_mux_t *p_mux = (sout_mux_t*) p_this;
@@ -1202,6 +1847,14 @@ static int OpenFrag(vlc_object_t *p_this)
     if (!p_sys)
         return VLC_ENOMEM;
 
+    config_ChainParse(p_mux, SOUT_CFG_PREFIX, ppsz_sout_options, p_mux->p_cfg);
+    p_mux->p_sys = p_sys;
+    if (CencOpen(p_mux))
+    {
+        free(p_sys);
+        return VLC_EGENERIC;
+    }
+
     p_mux->p_sys = (sout_mux_sys_t *) p_sys;
     p_mux->pf_control   = Control;
     p_mux->pf_addstream = AddStream;
@@ -1226,6 +1879,9 @@ static int OpenFrag(vlc_object_t *p_this)
     p_sys->i_start_dts = VLC_TS_INVALID;
     p_sys->i_mfhd_sequence = 1;
 
+    p_sys->i_expected_duration = 0;
+    p_sys->i_moov_reserved = 0;
+
     return VLC_SUCCESS;
 }
 
@@ -1279,9 +1935,35 @@ static void WriteFragments(sout_mux_t *p_mux, bool b_flush)
 
     if (moof)
     {
+        /* Time the fragment for segmenters, and flag it as a starting point
+         * for the streaming server when its video starts with a keyframe */
+        mtime_t i_end = INT64_MAX;
+        bool b_sync = true;
+        for (unsigned int i = 0; i < p_sys->i_nb_streams; i++)
+        {
+            const mp4_stream_t *p_stream = p_sys->pp_streams[i];
+            const mp4_fragentry_t *p_entry = p_stream->towrite.p_first;
+            if (!p_entry || (p_stream->mux.fmt.i_cat != VIDEO_ES &&
+                             p_stream->mux.fmt.i_cat != AUDIO_ES))
+                continue;
+
+            if (p_stream->b_hasiframes &&
+                !(p_entry->p_block->i_flags & BLOCK_FLAG_TYPE_I))
+                b_sync = false;
+
+            mtime_t i_stream_end = p_stream->i_written_duration;
+            for (; p_entry; p_entry = p_entry->p_next)
+                i_stream_end += p_entry->p_block->i_length;
+            i_end = __MIN(i_end, i_stream_end);
+        }
+        moof->b->i_dts = p_sys->i_start_dts + p_sys->i_written_duration;
+        if (i_end != INT64_MAX && i_end > p_sys->i_written_duration)
+            moof->b->i_length = i_end - p_sys->i_written_duration;
+        if (b_sync)
+            moof->b->i_flags |= BLOCK_FLAG_TYPE_I;
+
         msg_Dbg(p_mux, "writing moof @ %"PRId64, p_sys->i_pos);
         p_sys->i_pos += moof->b->i_buffer;
-        assert(moof->b->i_flags & BLOCK_FLAG_TYPE_I); /* http sout */
         box_send(p_mux, moof);
         msg_Dbg(p_mux, "writing mdat @ %"PRId64, p_sys->i_pos);
         WriteFragmentMDAT(p_mux, i_mdat_size);
@@ -1354,6 +2036,10 @@ static void CleanupFrag(sout_mux_sys_t *p_sys)
         free(p_stream);
     }
     TAB_CLEAN(p_sys->i_nb_streams, p_sys->pp_streams);
+#ifdef HAVE_GCRYPT
+    if (p_sys->b_cenc)
+        gcry_cipher_close(p_sys->cenc_ctx);
+#endif
     free(p_sys);
 }
 
@@ -1380,7 +2066,7 @@ static void CloseFrag(vlc_object_t *p_this)
 
     /* Write indexes, but only for non streamed content
        as they refer to moof by absolute position */
-    if (!strcmp(p_mux->psz_mux, "mp4frag"))
+    if (p_sys->i_moov_reserved || !strcmp(p_mux->psz_mux, "mp4frag"))
     {
         bo_t *mfra = GetMfraBox(p_mux);
         if (mfra)
@@ -0,0 +1,68 @@
+/*****************************************************************************
+ * mp4journal.h: index checkpoints of MP4 recordings
+ *****************************************************************************
+ * Copyright (C) 2020 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifndef VLC_MP4_JOURNAL_H
+#define VLC_MP4_JOURNAL_H 1
+
+/* When the MP4 muxer records with a reserved index, it periodically writes
+ * a checkpoint of the samples written since the previous one. Checkpoints
+ * are stored in the mdat, between samples. As the sample tables never
+ * point at them, players ignore them.
+ *
+ * All values are big endian:
+ *  magic       16 bytes
+ *  size        u32, from the magic to the CRC included
+ *  version     u32
+ *  sequence    u32
+ *  tracks      u32
+ *  then for each track:
+ *   track id   u32
+ *   start      i64, first sample time from the start of the recording (us)
+ *   samples    u32
+ *   then for each sample:
+ *    position  u64, in the file
+ *    size      u32
+ *    duration  u32 (us)
+ *    offset    i32, pts - dts (us)
+ *    flags     u32
+ *  crc         u32, CRC-32 of everything from the size on
+ */
+#define MP4_JOURNAL_MAGIC       "\x8bvlc-mp4-index\r\n"
+#define MP4_JOURNAL_MAGIC_SIZE  16
+#define MP4_JOURNAL_VERSION     1
+#define MP4_JOURNAL_HEADER_SIZE (MP4_JOURNAL_MAGIC_SIZE + 16)
+#define MP4_JOURNAL_TRACK_SIZE  16
+#define MP4_JOURNAL_SAMPLE_SIZE 24
+
+#define MP4_JOURNAL_SAMPLE_SYNC 0x1
+
+static inline uint32_t mp4_journal_crc(uint32_t i_crc,
+                                       const uint8_t *p, size_t i_size)
+{
+    i_crc = ~i_crc;
+    while (i_size--)
+    {
+        i_crc ^= *p++;
+        for (int i = 0; i < 8; i++)
+            i_crc = (i_crc >> 1) ^ (0xEDB88320 & -(i_crc & 1));
+    }
+    return ~i_crc;
+}
+
+#endif
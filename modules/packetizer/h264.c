@@ -335,7 +335,7 @@ static int Open( vlc_object_t *p_this )
 
     packetizer_Init( &p_sys->packetizer,
                      p_h264_startcode, sizeof(p_h264_startcode), startcode_FindAnnexB,
-                     p_h264_startcode, 1, 5,
+                     p_h264_startcode, 1, 5, true,
                      PacketizeReset, PacketizeParse, PacketizeValidate, PacketizeDrain,
                      p_dec );
 
@@ -887,7 +887,7 @@ static block_t *OutputPicture( decoder_t *p_dec )
     p_sys->leading.p_head = NULL;
     p_sys->leading.pp_append = &p_sys->leading.p_head;
 
-    p_pic = block_ChainGather( p_pic );
+    p_pic = packetizer_ChainGather( p_pic );
 
     if( !p_pic )
     {
@@ -1059,6 +1059,11 @@ static void PutSPS( decoder_t *p_dec, block_t *p_frag )
 {
     decoder_sys_t *p_sys = p_dec->p_sys;
 
+    /* Stored for later insertion, don't keep the whole input block */
+    p_frag = packetizer_Unshare( p_frag );
+    if( unlikely(p_frag == NULL) )
+        return;
+
     const uint8_t *p_buffer = p_frag->p_buffer;
     size_t i_buffer = p_frag->i_buffer;
 
@@ -1086,6 +1091,12 @@ static void PutSPS( decoder_t *p_dec, block_t *p_frag )
 static void PutPPS( decoder_t *p_dec, block_t *p_frag )
 {
     decoder_sys_t *p_sys = p_dec->p_sys;
+
+    /* Stored for later insertion, don't keep the whole input block */
+    p_frag = packetizer_Unshare( p_frag );
+    if( unlikely(p_frag == NULL) )
+        return;
+
     const uint8_t *p_buffer = p_frag->p_buffer;
     size_t i_buffer = p_frag->i_buffer;
 
@@ -147,7 +147,7 @@ static int Open( vlc_object_t *p_this )
     /* Misc init */
     packetizer_Init( &p_sys->packetizer,
                      p_mp4v_startcode, sizeof(p_mp4v_startcode), startcode_FindAnnexB,
-                     NULL, 0, 4,
+                     NULL, 0, 4, false,
                      PacketizeReset, PacketizeParse, PacketizeValidate, NULL,
                      p_dec );
 
@@ -25,6 +25,7 @@
 #define VLC_PACKETIZER_HELPER_H_
 
 #include <vlc_block.h>
+#include <vlc_atomic.h>
 
 enum
 {
@@ -56,6 +57,8 @@ typedef struct
 
     unsigned i_au_min_size;
 
+    bool b_shared; /* slice fragments out of the input blocks */
+
     void *p_private;
     packetizer_reset_t    pf_reset;
     packetizer_parse_t    pf_parse;
@@ -68,7 +71,7 @@ static inline void packetizer_Init( packetizer_t *p_pack,
                                     const uint8_t *p_startcode, int i_startcode,
                                     block_startcode_helper_t pf_start_helper,
                                     const uint8_t *p_au_prepend, int i_au_prepend,
-                                    unsigned i_au_min_size,
+                                    unsigned i_au_min_size, bool b_shared,
                                     packetizer_reset_t pf_reset,
                                     packetizer_parse_t pf_parse,
                                     packetizer_validate_t pf_validate,
@@ -82,6 +85,7 @@ static inline void packetizer_Init( packetizer_t *p_pack,
     p_pack->i_au_prepend = i_au_prepend;
     p_pack->p_au_prepend = p_au_prepend;
     p_pack->i_au_min_size = i_au_min_size;
+    p_pack->b_shared = b_shared;
 
     p_pack->i_startcode = i_startcode;
     p_pack->p_startcode = p_startcode;
@@ -93,6 +97,221 @@ static inline void packetizer_Init( packetizer_t *p_pack,
     p_pack->p_private = p_private;
 }
 
+/*****************************************************************************
+ * Shared blocks
+ *
+ * The blocks pushed to the packetizer are wrapped into refcounted sources.
+ * Fragments lying within a single source block are then returned as views
+ * into it, and an access unit whose fragments are contiguous in a source is
+ * gathered into a single view, instead of being copied twice.
+ *
+ * Views never overlap, so their owner can modify their content in place, but
+ * data kept longer than the access unit should be unshared to not hold the
+ * whole source block.
+ *****************************************************************************/
+typedef struct
+{
+    block_t      self;    /* the source as seen by the bytestream */
+    block_t     *p_block; /* wrapped block, never modified */
+    atomic_uint  i_refs;  /* self and the views */
+} packetizer_source_t;
+
+typedef struct
+{
+    block_t              self;
+    packetizer_source_t *p_source;
+} packetizer_view_t;
+
+static inline void packetizer_SourceRelease( packetizer_source_t *p_src )
+{
+    if( atomic_fetch_sub_explicit( &p_src->i_refs, 1,
+                                   memory_order_acq_rel ) != 1 )
+        return;
+    block_Release( p_src->p_block );
+    free( p_src );
+}
+
+static void packetizer_SourceBlockRelease( block_t *p_block )
+{
+    packetizer_SourceRelease( (packetizer_source_t *)p_block );
+}
+
+static void packetizer_ViewBlockRelease( block_t *p_block )
+{
+    packetizer_view_t *p_view = (packetizer_view_t *)p_block;
+
+    packetizer_SourceRelease( p_view->p_source );
+    free( p_view );
+}
+
+static inline packetizer_source_t *packetizer_GetSource( const block_t *p_block )
+{
+    if( p_block->pf_release == packetizer_SourceBlockRelease )
+        return (packetizer_source_t *)p_block;
+    if( p_block->pf_release == packetizer_ViewBlockRelease )
+        return ((const packetizer_view_t *)p_block)->p_source;
+    return NULL;
+}
+
+static inline block_t *packetizer_NewView( packetizer_source_t *p_src,
+                                           const uint8_t *p_data, size_t i_data )
+{
+    packetizer_view_t *p_view = malloc( sizeof(*p_view) );
+    if( unlikely(p_view == NULL) )
+        return NULL;
+
+    block_Init( &p_view->self, (uint8_t *)p_data, i_data );
+    p_view->self.pf_release = packetizer_ViewBlockRelease;
+    p_view->p_source = p_src;
+    atomic_fetch_add_explicit( &p_src->i_refs, 1, memory_order_relaxed );
+    return &p_view->self;
+}
+
+/* Wraps a block (not a chain) into a source, returns it unchanged if it is
+ * already shared or on memory error */
+static inline block_t *packetizer_Share( block_t *p_block )
+{
+    if( packetizer_GetSource( p_block ) != NULL )
+        return p_block;
+
+    packetizer_source_t *p_src = malloc( sizeof(*p_src) );
+    if( unlikely(p_src == NULL) )
+        return p_block;
+
+    block_Init( &p_src->self, p_block->p_buffer, p_block->i_buffer );
+    p_src->self.pf_release = packetizer_SourceBlockRelease;
+    p_src->self.i_flags = p_block->i_flags;
+    p_src->self.i_nb_samples = p_block->i_nb_samples;
+    p_src->self.i_pts = p_block->i_pts;
+    p_src->self.i_dts = p_block->i_dts;
+    p_src->self.i_length = p_block->i_length;
+    p_src->p_block = p_block;
+    atomic_init( &p_src->i_refs, 1 );
+    return &p_src->self;
+}
+
+/**
+ * Returns a block that does not hold the source it was sliced from
+ *
+ * To be used on fragments stored beyond the access unit (e.g. parameter
+ * sets). The block is released on error.
+ */
+static inline block_t *packetizer_Unshare( block_t *p_block )
+{
+    if( packetizer_GetSource( p_block ) == NULL )
+        return p_block;
+
+    block_t *p_copy = block_Duplicate( p_block );
+    block_Release( p_block );
+    return p_copy;
+}
+
+/* Returns the next i_data bytes of the bytestream, prefixed with the access
+ * unit prepend, as a view if they lie in a single source block */
+static inline block_t *packetizer_GetFragment( packetizer_t *p_pack,
+                                               size_t i_data )
+{
+    block_bytestream_t *p_bs = &p_pack->bytestream;
+    block_t *p_block = p_bs->p_block;
+    const size_t i_prepend = p_pack->i_au_prepend;
+    packetizer_source_t *p_src = packetizer_GetSource( p_block );
+
+    if( p_src != NULL && p_block->i_buffer - p_bs->i_block_offset >= i_data )
+    {
+        /* The prepend is shared too if the stream already has it in front
+         * of the fragment (4 bytes Annex B startcodes) */
+        const uint8_t *p_data = &p_block->p_buffer[p_bs->i_block_offset];
+        const size_t i_before = p_data - p_src->p_block->p_buffer;
+
+        if( i_prepend == 0 ||
+            ( i_before >= i_prepend &&
+              !memcmp( p_data - i_prepend, p_pack->p_au_prepend, i_prepend ) ) )
+        {
+            block_t *p_view = packetizer_NewView( p_src, p_data - i_prepend,
+                                                  i_data + i_prepend );
+            if( likely(p_view != NULL) )
+            {
+                block_SkipBytes( p_bs, i_data );
+                return p_view;
+            }
+        }
+    }
+
+    block_t *p_frag = block_Alloc( i_data + i_prepend );
+    if( unlikely(p_frag == NULL) )
+    {
+        block_SkipBytes( p_bs, i_data );
+        return NULL;
+    }
+    block_GetBytes( p_bs, &p_frag->p_buffer[i_prepend], i_data );
+    if( i_prepend > 0 )
+        memcpy( p_frag->p_buffer, p_pack->p_au_prepend, i_prepend );
+    return p_frag;
+}
+
+/**
+ * Gathers a chain into one block, like block_ChainGather()
+ *
+ * If the data of the chain is contiguous in a source block, the result is a
+ * view and nothing is copied. Blocks that are not views of that source (e.g.
+ * stored parameter sets) are accepted if their content matches the source.
+ */
+static inline block_t *packetizer_ChainGather( block_t *p_list )
+{
+    if( p_list->p_next == NULL )
+        return p_list;  /* Already gathered */
+
+    /* Locate the chain in the source of its first view */
+    packetizer_source_t *p_src = NULL;
+    const block_t *p_anchor;
+    size_t i_before = 0;
+    for( p_anchor = p_list; p_anchor != NULL; p_anchor = p_anchor->p_next )
+    {
+        p_src = packetizer_GetSource( p_anchor );
+        if( p_src != NULL )
+            break;
+        i_before += p_anchor->i_buffer;
+    }
+    if( p_src == NULL )
+        return block_ChainGather( p_list );
+
+    const uint8_t *p_base = p_src->p_block->p_buffer;
+    const size_t i_total = p_src->p_block->i_buffer;
+    const size_t i_anchor = p_anchor->p_buffer - p_base;
+    if( i_anchor < i_before )
+        return block_ChainGather( p_list );
+
+    const size_t i_start = i_anchor - i_before;
+    size_t i_pos = i_start;
+    mtime_t i_length = 0;
+    for( const block_t *p = p_list; p != NULL; p = p->p_next )
+    {
+        if( p->i_buffer > i_total - i_pos )
+            return block_ChainGather( p_list );
+        if( packetizer_GetSource( p ) == p_src )
+        {
+            if( p->p_buffer != &p_base[i_pos] )
+                return block_ChainGather( p_list );
+        }
+        else if( memcmp( p->p_buffer, &p_base[i_pos], p->i_buffer ) )
+            return block_ChainGather( p_list );
+        i_pos += p->i_buffer;
+        i_length += p->i_length;
+    }
+
+    block_t *g = packetizer_NewView( p_src, &p_base[i_start], i_pos - i_start );
+    if( unlikely(g == NULL) )
+        return block_ChainGather( p_list );
+
+    g->i_flags = p_list->i_flags;
+    g->i_pts   = p_list->i_pts;
+    g->i_dts   = p_list->i_dts;
+    g->i_length = i_length;
+
+    block_ChainRelease( p_list );
+    return g;
+}
+
 static inline void packetizer_Clean( packetizer_t *p_pack )
 {
     block_BytestreamRelease( &p_pack->bytestream );
@@ -132,7 +351,21 @@ static block_t *packetizer_PacketizeBlock( packetizer_t *p_pack, block_t **pp_bl
     }
 
     if( p_block )
+    {
+        if( p_pack->b_shared )
+        {
+            block_t *p_chain = NULL, **pp_last = &p_chain;
+            while( p_block != NULL )
+            {
+                block_t *p_next = p_block->p_next;
+                p_block->p_next = NULL;
+                block_ChainLastAppend( &pp_last, packetizer_Share( p_block ) );
+                p_block = p_next;
+            }
+            p_block = p_chain;
+        }
         block_BytestreamPush( &p_pack->bytestream, p_block );
+    }
 
     for( ;; )
     {
@@ -185,17 +418,34 @@ static block_t *packetizer_PacketizeBlock( packetizer_t *p_pack, block_t **pp_bl
             /* Get the new fragment and set the pts/dts */
             block_t *p_block_bytestream = p_pack->bytestream.p_block;
 
-            p_pic = block_Alloc( p_pack->i_offset + p_pack->i_au_prepend );
-            p_pic->i_pts = p_block_bytestream->i_pts;
-            p_pic->i_dts = p_block_bytestream->i_dts;
-
-            block_GetBytes( &p_pack->bytestream, &p_pic->p_buffer[p_pack->i_au_prepend],
-                            p_pic->i_buffer - p_pack->i_au_prepend );
-            if( p_pack->i_au_prepend > 0 )
-                memcpy( p_pic->p_buffer, p_pack->p_au_prepend, p_pack->i_au_prepend );
+            if( p_pack->b_shared )
+                p_pic = packetizer_GetFragment( p_pack, p_pack->i_offset );
+            else
+            {
+                p_pic = block_Alloc( p_pack->i_offset + p_pack->i_au_prepend );
+                if( likely(p_pic != NULL) )
+                {
+                    block_GetBytes( &p_pack->bytestream,
+                                    &p_pic->p_buffer[p_pack->i_au_prepend],
+                                    p_pack->i_offset );
+                    if( p_pack->i_au_prepend > 0 )
+                        memcpy( p_pic->p_buffer, p_pack->p_au_prepend,
+                                p_pack->i_au_prepend );
+                }
+                else
+                    block_SkipBytes( &p_pack->bytestream, p_pack->i_offset );
+            }
 
             p_pack->i_offset = 0;
 
+            if( unlikely(p_pic == NULL) )
+            {
+                p_pack->i_state = STATE_NOSYNC;
+                break;
+            }
+            p_pic->i_pts = p_block_bytestream->i_pts;
+            p_pic->i_dts = p_block_bytestream->i_dts;
+
             /* Parse the NAL */
             if( p_pic->i_buffer < p_pack->i_au_min_size )
             {
@@ -158,7 +158,7 @@ static int Open( vlc_object_t *p_this )
 
     packetizer_Init( &p_sys->packetizer,
                      p_vc1_startcode, sizeof(p_vc1_startcode), startcode_FindAnnexB,
-                     NULL, 0, 4,
+                     NULL, 0, 4, false,
                      PacketizeReset, PacketizeParse, PacketizeValidate, NULL,
                      p_dec );
 
@@ -0,0 +1,1239 @@
+/*****************************************************************************
+ * multiview.c: multiviewer compositor
+ *****************************************************************************
+ * Copyright (C) 2020 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*
+ * The "multiview-bridge" stream output decodes a video stream and publishes
+ * its latest picture as a tile. The "multiview://" access_demux composes the
+ * tiles into a grid at its own frame rate and outputs the canvas as raw I420
+ * video, which can then be displayed or transcoded like any other input.
+ *
+ * The tiles are shared within one process only, so the bridges and the wall
+ * must run in the same VLC instance, e.g. with a VLM configuration file
+ * (vlc --vlm-conf=multiview.vlm):
+ *
+ *  new in1 broadcast enabled
+ *  setup in1 input udp://@:1234
+ *  setup in1 output #multiview-bridge{id=1}
+ *  (same for in2, in3 and in4)
+ *  new wall broadcast enabled
+ *  setup wall input multiview://
+ *  setup wall option multiview-order=1,2,3,4
+ *  setup wall option multiview-fps=50
+ *  setup wall output #display
+ *  control in1 play
+ *  (same for in2, in3 and in4)
+ *  control wall play
+ *
+ * Unlike the mosaic sub source, no global lock is taken per picture: the
+ * tiles are only looked up when a bridge or a wall starts, and each tile has
+ * its own lock, held while swapping a picture pointer. Each tile is scaled
+ * straight into the canvas, the tiles being processed in parallel. Tiles
+ * whose picture did not change since the canvas buffer was last painted are
+ * not touched, and tiles that are up to date in the previous canvas are
+ * copied from it instead of being scaled again.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <assert.h>
+#include <math.h>
+
+#include <vlc_common.h>
+#include <vlc_plugin.h>
+#include <vlc_atomic.h>
+#include <vlc_sout.h>
+#include <vlc_demux.h>
+#include <vlc_block.h>
+#include <vlc_codec.h>
+#include <vlc_meta.h>
+#include <vlc_image.h>
+#include <vlc_modules.h>
+#include <vlc_cpu_budget.h>
+
+#include "../video_chroma/resize.h"
+
+/*****************************************************************************
+ * Module descriptor
+ *****************************************************************************/
+static int  OpenBridge ( vlc_object_t * );
+static void CloseBridge( vlc_object_t * );
+static int  OpenWall   ( vlc_object_t * );
+static void CloseWall  ( vlc_object_t * );
+
+#define ID_TEXT N_("ID")
+#define ID_LONGTEXT N_( \
+    "Identifier of the tile this stream is shown in." )
+
+#define ORDER_TEXT N_("Tiles")
+#define ORDER_LONGTEXT N_( \
+    "Comma separated identifiers of the tiles, from left to right then " \
+    "top to bottom. By default, the tiles are numbered from 1." )
+#define ROWS_TEXT N_("Number of rows")
+#define ROWS_LONGTEXT N_( \
+    "Number of rows of the grid (0 = automatic)." )
+#define COLS_TEXT N_("Number of columns")
+#define COLS_LONGTEXT N_( \
+    "Number of columns of the grid (0 = automatic)." )
+#define WIDTH_TEXT N_("Width")
+#define WIDTH_LONGTEXT N_( "Width of the output video." )
+#define HEIGHT_TEXT N_("Height")
+#define HEIGHT_LONGTEXT N_( "Height of the output video." )
+#define FPS_TEXT N_("Frame rate")
+#define FPS_LONGTEXT N_( \
+    "Frame rate of the output video. Tiles are shown at their own rate." )
+#define BORDER_TEXT N_("Border")
+#define BORDER_LONGTEXT N_( "Space between the tiles, in pixels." )
+#define KEEP_RATIO_TEXT N_("Keep aspect ratio")
+#define KEEP_RATIO_LONGTEXT N_( \
+    "Keep the aspect ratio of the streams when fitting them in the tiles." )
+#define METHOD_TEXT N_("Scaling method")
+#define METHOD_LONGTEXT N_("Interpolation used to scale the tiles.")
+#define THREADS_TEXT N_("Threads")
+#define THREADS_LONGTEXT N_("Number of threads composing the tiles " \
+    "(0 = from the CPU budget).")
+
+static const int pi_method_values[] = {
+    RESIZE_BILINEAR, RESIZE_BICUBIC, RESIZE_LANCZOS };
+static const char *const ppsz_method_descriptions[] = {
+    N_("Bilinear"), N_("Bicubic"), N_("Lanczos") };
+
+#define CFG_PREFIX "sout-multiview-bridge-"
+#define MAX_THREADS 64
+
+vlc_module_begin ()
+    set_shortname( N_("Multiview") )
+    set_description( N_("Multiview bridge stream output") )
+    set_capability( "sout stream", 0 )
+    add_shortcut( "multiview-bridge" )
+    set_category( CAT_SOUT )
+    set_subcategory( SUBCAT_SOUT_STREAM )
+    add_string( CFG_PREFIX "id", "1", ID_TEXT, ID_LONGTEXT, false )
+    set_callbacks( OpenBridge, CloseBridge )
+
+    add_submodule ()
+    set_description( N_("Multiview compositor input") )
+    set_capability( "access_demux", 0 )
+    add_shortcut( "multiview" )
+    set_category( CAT_INPUT )
+    set_subcategory( SUBCAT_INPUT_ACCESS )
+    add_string( "multiview-order", NULL, ORDER_TEXT, ORDER_LONGTEXT, false )
+    add_integer_with_range( "multiview-rows", 0, 0, 64,
+                            ROWS_TEXT, ROWS_LONGTEXT, false )
+    add_integer_with_range( "multiview-cols", 0, 0, 64,
+                            COLS_TEXT, COLS_LONGTEXT, false )
+    add_integer( "multiview-width", 1920, WIDTH_TEXT, WIDTH_LONGTEXT, false )
+    add_integer( "multiview-height", 1080, HEIGHT_TEXT, HEIGHT_LONGTEXT,
+                 false )
+    add_float( "multiview-fps", 25., FPS_TEXT, FPS_LONGTEXT, false )
+    add_integer_with_range( "multiview-border", 4, 0, 256,
+                            BORDER_TEXT, BORDER_LONGTEXT, false )
+    add_bool( "multiview-keep-ratio", true, KEEP_RATIO_TEXT,
+              KEEP_RATIO_LONGTEXT, false )
+    add_integer( "multiview-method", RESIZE_BICUBIC, METHOD_TEXT,
+                 METHOD_LONGTEXT, true )
+        change_integer_list( pi_method_values, ppsz_method_descriptions )
+    add_integer_with_range( "multiview-threads", 0, 0, MAX_THREADS,
+                            THREADS_TEXT, THREADS_LONGTEXT, true )
+    set_callbacks( OpenWall, CloseWall )
+vlc_module_end ()
+
+/*****************************************************************************
+ * Tiles
+ *****************************************************************************/
+typedef struct
+{
+    char        *psz_id;
+    unsigned     i_refs; /* protected by tiles_lock */
+
+    vlc_mutex_t  lock;
+    picture_t   *p_picture; /* latest picture, NULL for black */
+    uint64_t     i_version; /* incremented for each picture */
+} mv_tile_t;
+
+/* Only taken when a bridge or a wall opens or closes */
+static vlc_mutex_t tiles_lock = VLC_STATIC_MUTEX;
+static mv_tile_t **pp_tiles = NULL;
+static int i_tiles = 0;
+
+static mv_tile_t *TileAcquire( const char *psz_id )
+{
+    mv_tile_t *p_tile = NULL;
+
+    vlc_mutex_lock( &tiles_lock );
+    for( int i = 0; i < i_tiles; i++ )
+    {
+        if( !strcmp( pp_tiles[i]->psz_id, psz_id ) )
+        {
+            p_tile = pp_tiles[i];
+            p_tile->i_refs++;
+            break;
+        }
+    }
+
+    if( p_tile == NULL )
+    {
+        p_tile = malloc( sizeof( *p_tile ) );
+        if( p_tile != NULL )
+        {
+            p_tile->psz_id = strdup( psz_id );
+            if( p_tile->psz_id == NULL )
+            {
+                free( p_tile );
+                p_tile = NULL;
+            }
+        }
+        if( p_tile != NULL )
+        {
+            p_tile->i_refs = 1;
+            vlc_mutex_init( &p_tile->lock );
+            p_tile->p_picture = NULL;
+            p_tile->i_version = 0;
+            TAB_APPEND( i_tiles, pp_tiles, p_tile );
+        }
+    }
+    vlc_mutex_unlock( &tiles_lock );
+    return p_tile;
+}
+
+static void TileRelease( mv_tile_t *p_tile )
+{
+    vlc_mutex_lock( &tiles_lock );
+    if( --p_tile->i_refs > 0 )
+    {
+        vlc_mutex_unlock( &tiles_lock );
+        return;
+    }
+    TAB_REMOVE( i_tiles, pp_tiles, p_tile );
+    vlc_mutex_unlock( &tiles_lock );
+
+    if( p_tile->p_picture != NULL )
+        picture_Release( p_tile->p_picture );
+    vlc_mutex_destroy( &p_tile->lock );
+    free( p_tile->psz_id );
+    free( p_tile );
+}
+
+/* Takes ownership of the picture (can be NULL) */
+static void TilePublish( mv_tile_t *p_tile, picture_t *p_picture )
+{
+    vlc_mutex_lock( &p_tile->lock );
+    picture_t *p_old = p_tile->p_picture;
+    p_tile->p_picture = p_picture;
+    p_tile->i_version++;
+    vlc_mutex_unlock( &p_tile->lock );
+
+    if( p_old != NULL )
+        picture_Release( p_old );
+}
+
+/* The compositor scales planar 8-bits YUV pictures */
+static bool IsPlanarYUV8( vlc_fourcc_t i_chroma )
+{
+    const vlc_chroma_description_t *p_dsc =
+        vlc_fourcc_GetChromaDescription( i_chroma );
+
+    return p_dsc != NULL && p_dsc->plane_count == 3
+        && p_dsc->pixel_size == 1 && vlc_fourcc_IsYUV( i_chroma );
+}
+
+/*****************************************************************************
+ * Bridge
+ *****************************************************************************/
+struct sout_stream_sys_t
+{
+    mv_tile_t       *p_tile;
+    decoder_t       *p_decoder;
+    image_handler_t *p_image; /* for the chromas the compositor can't read */
+    char            *psz_id;
+};
+
+struct decoder_owner_sys_t
+{
+    /* Current format in use by the output */
+    video_format_t video;
+};
+
+static const char *const ppsz_sout_options[] = {
+    "id", NULL
+};
+
+static int DecoderUpdateFormat( decoder_t *p_dec )
+{
+    video_format_t *p_fmt = &p_dec->fmt_out.video;
+
+    p_fmt->i_chroma = p_dec->fmt_out.i_codec;
+    if( !p_fmt->i_visible_width || !p_fmt->i_visible_height )
+    {
+        p_fmt->i_visible_width = p_fmt->i_width;
+        p_fmt->i_visible_height = p_fmt->i_height;
+    }
+    vlc_ureduce( &p_fmt->i_sar_num, &p_fmt->i_sar_den,
+                 p_fmt->i_sar_num, p_fmt->i_sar_den, 0 );
+    p_dec->p_owner->video = *p_fmt;
+    return 0;
+}
+
+static picture_t *DecoderNewBuffer( decoder_t *p_dec )
+{
+    return picture_NewFromFormat( &p_dec->fmt_out.video );
+}
+
+static int DecoderQueueVideo( decoder_t *p_dec, picture_t *p_pic )
+{
+    sout_stream_t *p_stream = p_dec->p_queue_ctx;
+    sout_stream_sys_t *p_sys = p_stream->p_sys;
+
+    if( !IsPlanarYUV8( p_pic->format.i_chroma ) )
+    {
+        video_format_t fmt_out = p_pic->format;
+        fmt_out.i_chroma = VLC_CODEC_I420;
+
+        if( p_sys->p_image == NULL )
+            p_sys->p_image = image_HandlerCreate( p_stream );
+
+        picture_t *p_new_pic = NULL;
+        if( p_sys->p_image != NULL )
+            p_new_pic = image_Convert( p_sys->p_image, p_pic,
+                                       &p_pic->format, &fmt_out );
+        picture_Release( p_pic );
+        if( p_new_pic == NULL )
+        {
+            msg_Err( p_stream, "image conversion failed" );
+            return -1;
+        }
+        p_pic = p_new_pic;
+    }
+
+    /* The decoder pictures are not pooled: the tile can keep the latest
+     * one for as long as the compositor needs it, without copying it. */
+    TilePublish( p_sys->p_tile, p_pic );
+    return 0;
+}
+
+static void DeleteDecoder( decoder_t *p_dec )
+{
+    decoder_owner_sys_t *p_owner = p_dec->p_owner;
+
+    if( p_dec->p_module != NULL )
+        module_unneed( p_dec, p_dec->p_module );
+    if( p_dec->p_description != NULL )
+        vlc_meta_Delete( p_dec->p_description );
+    vlc_object_release( p_dec );
+    free( p_owner );
+}
+
+static sout_stream_id_sys_t *Add( sout_stream_t *p_stream,
+                                  const es_format_t *p_fmt )
+{
+    sout_stream_sys_t *p_sys = p_stream->p_sys;
+
+    if( p_sys->p_decoder != NULL || p_fmt->i_cat != VIDEO_ES )
+        return NULL;
+
+    decoder_t *p_dec = vlc_object_create( p_stream, sizeof( decoder_t ) );
+    if( p_dec == NULL )
+        return NULL;
+    p_dec->p_module = NULL;
+    p_dec->p_description = NULL;
+    p_dec->fmt_in = *p_fmt;
+    p_dec->b_frame_drop_allowed = true;
+    p_dec->fmt_out = p_dec->fmt_in;
+    p_dec->fmt_out.i_extra = 0;
+    p_dec->fmt_out.p_extra = NULL;
+    p_dec->pf_decode = NULL;
+    p_dec->pf_queue_video = DecoderQueueVideo;
+    p_dec->p_queue_ctx = p_stream;
+    p_dec->pf_vout_format_update = DecoderUpdateFormat;
+    p_dec->pf_vout_buffer_new = DecoderNewBuffer;
+    p_dec->p_owner = malloc( sizeof( decoder_owner_sys_t ) );
+    if( p_dec->p_owner == NULL )
+    {
+        vlc_object_release( p_dec );
+        return NULL;
+    }
+    p_dec->p_owner->video = p_fmt->video;
+
+    p_dec->p_module = module_need( p_dec, "video decoder", "$codec", false );
+    if( p_dec->p_module == NULL )
+    {
+        msg_Err( p_stream, "cannot find decoder" );
+        DeleteDecoder( p_dec );
+        return NULL;
+    }
+
+    p_sys->p_decoder = p_dec;
+    msg_Dbg( p_stream, "multiview bridge id=%s", p_sys->psz_id );
+    return (sout_stream_id_sys_t *)p_sys;
+}
+
+static void Del( sout_stream_t *p_stream, sout_stream_id_sys_t *id )
+{
+    sout_stream_sys_t *p_sys = p_stream->p_sys;
+
+    if( (sout_stream_sys_t *)id != p_sys )
+        return;
+
+    DeleteDecoder( p_sys->p_decoder );
+    p_sys->p_decoder = NULL;
+
+    /* Show a black tile until another stream is bridged */
+    TilePublish( p_sys->p_tile, NULL );
+}
+
+static int Send( sout_stream_t *p_stream, sout_stream_id_sys_t *id,
+                 block_t *p_buffer )
+{
+    sout_stream_sys_t *p_sys = p_stream->p_sys;
+
+    if( (sout_stream_sys_t *)id != p_sys )
+    {
+        block_ChainRelease( p_buffer );
+        return VLC_SUCCESS;
+    }
+
+    int ret = p_sys->p_decoder->pf_decode( p_sys->p_decoder, p_buffer );
+    return ret == VLCDEC_SUCCESS ? VLC_SUCCESS : VLC_EGENERIC;
+}
+
+static int OpenBridge( vlc_object_t *p_this )
+{
+    sout_stream_t *p_stream = (sout_stream_t *)p_this;
+    sout_stream_sys_t *p_sys;
+
+    config_ChainParse( p_stream, CFG_PREFIX, ppsz_sout_options,
+                       p_stream->p_cfg );
+
+    p_sys = malloc( sizeof( *p_sys ) );
+    if( p_sys == NULL )
+        return VLC_ENOMEM;
+
+    p_sys->psz_id = var_GetString( p_stream, CFG_PREFIX "id" );
+    if( p_sys->psz_id == NULL )
+    {
+        free( p_sys );
+        return VLC_ENOMEM;
+    }
+
+    p_sys->p_tile = TileAcquire( p_sys->psz_id );
+    if( p_sys->p_tile == NULL )
+    {
+        free( p_sys->psz_id );
+        free( p_sys );
+        return VLC_ENOMEM;
+    }
+    p_sys->p_decoder = NULL;
+    p_sys->p_image = NULL;
+
+    p_stream->p_sys = p_sys;
+    p_stream->pf_add = Add;
+    p_stream->pf_del = Del;
+    p_stream->pf_send = Send;
+    p_stream->pace_nocontrol = true;
+    return VLC_SUCCESS;
+}
+
+static void CloseBridge( vlc_object_t *p_this )
+{
+    sout_stream_t *p_stream = (sout_stream_t *)p_this;
+    sout_stream_sys_t *p_sys = p_stream->p_sys;
+
+    TileRelease( p_sys->p_tile );
+    if( p_sys->p_image != NULL )
+        image_HandlerDelete( p_sys->p_image );
+    free( p_sys->psz_id );
+    free( p_sys );
+}
+
+/*****************************************************************************
+ * Canvas
+ *****************************************************************************/
+/* Canvas buffers that can be in flight downstream */
+#define MV_FRAMES 4
+
+typedef struct mv_canvas_t mv_canvas_t;
+
+typedef struct
+{
+    block_t      block;
+    mv_canvas_t *p_canvas;
+    atomic_bool  b_busy;      /* owned by the block until it is released */
+    uint8_t     *p_pixels;
+    uint64_t    *pi_versions; /* version of each tile painted in the buffer */
+} mv_frame_t;
+
+/* The buffers outlive the wall if blocks are still queued downstream */
+struct mv_canvas_t
+{
+    atomic_uint  refs;
+    size_t       i_size;
+    mv_frame_t   frames[MV_FRAMES];
+};
+
+static void CanvasRelease( mv_canvas_t *p_canvas )
+{
+    if( atomic_fetch_sub( &p_canvas->refs, 1 ) != 1 )
+        return;
+
+    for( unsigned i = 0; i < MV_FRAMES; i++ )
+    {
+        aligned_free( p_canvas->frames[i].p_pixels );
+        free( p_canvas->frames[i].pi_versions );
+    }
+    free( p_canvas );
+}
+
+static void FrameRelease( block_t *p_block )
+{
+    mv_frame_t *p_frame = container_of( p_block, mv_frame_t, block );
+    mv_canvas_t *p_canvas = p_frame->p_canvas;
+
+    atomic_store( &p_frame->b_busy, false );
+    CanvasRelease( p_canvas );
+}
+
+/*****************************************************************************
+ * Wall
+ *****************************************************************************/
+typedef struct
+{
+    mv_tile_t     *p_tile;
+
+    /* Cell of the tile in the canvas, in luma samples */
+    unsigned       i_x, i_y, i_width, i_height;
+
+    /* Scaling setup for the current source format */
+    bool           b_setup;
+    vlc_fourcc_t   i_chroma;
+    unsigned       i_src_x, i_src_y, i_src_width, i_src_height;
+    unsigned       i_sar_num, i_sar_den;
+    unsigned       i_fit_x, i_fit_y, i_fit_width, i_fit_height;
+    resize_plane_t planes[3];
+    void          *p_scratch;
+
+    /* Snapshot of the tile for the frame being composed */
+    picture_t     *p_picture;
+    uint64_t       i_version;
+} mv_slot_t;
+
+typedef struct
+{
+    mv_slot_t        *p_slot;
+    mv_frame_t       *p_dst;
+    const mv_frame_t *p_src; /* copy the cell from there if not NULL */
+} mv_task_t;
+
+struct demux_sys_t
+{
+    es_out_id_t     *es;
+    mtime_t          i_incr;
+    mtime_t          i_next_date;
+    mtime_t          i_start;
+
+    unsigned         i_width, i_height;
+    size_t           pi_pitch[3];
+    size_t           pi_offset[3];
+    bool             b_keep_ratio;
+    enum resize_method method;
+    resize_kernels_t kernels;
+
+    unsigned         i_slots;
+    mv_slot_t       *p_slots;
+    mv_canvas_t     *p_canvas;
+    mv_frame_t      *p_last; /* last frame sent */
+
+    /* Task pool, the demux thread takes part in the work */
+    vlc_cpu_lease_t *p_cpu_lease;
+    unsigned         i_workers;
+    vlc_thread_t     workers[MAX_THREADS - 1];
+    vlc_mutex_t      lock;
+    vlc_cond_t       wait;
+    vlc_cond_t       done;
+    mv_task_t       *p_tasks;
+    unsigned         i_tasks;
+    unsigned         i_next_task;
+    unsigned         i_pending;
+    bool             b_quit;
+
+    struct
+    {
+        mtime_t  i_date;
+        unsigned i_frames;
+        unsigned i_late;
+        unsigned i_dropped;
+        unsigned i_scaled;
+        unsigned i_copied;
+        mtime_t  i_compose_time;
+    } stats;
+};
+
+static void FillRect( uint8_t *p_dst, size_t i_pitch, unsigned i_width,
+                      unsigned i_height, uint8_t i_value )
+{
+    if( i_width == 0 )
+        return;
+    for( unsigned y = 0; y < i_height; y++ )
+        memset( &p_dst[y * i_pitch], i_value, i_width );
+}
+
+static uint8_t *FramePlane( demux_sys_t *p_sys, mv_frame_t *p_frame,
+                            unsigned i_plane, unsigned x, unsigned y )
+{
+    const unsigned i_shift = i_plane > 0;
+
+    return p_frame->p_pixels + p_sys->pi_offset[i_plane]
+         + (y >> i_shift) * p_sys->pi_pitch[i_plane] + (x >> i_shift);
+}
+
+/* Paints a rectangle of the canvas black, coordinates are even */
+static void FrameFill( demux_sys_t *p_sys, mv_frame_t *p_frame,
+                       unsigned x, unsigned y, unsigned w, unsigned h )
+{
+    for( unsigned i = 0; i < 3; i++ )
+    {
+        const unsigned i_shift = i > 0;
+        FillRect( FramePlane( p_sys, p_frame, i, x, y ), p_sys->pi_pitch[i],
+                  w >> i_shift, h >> i_shift, i > 0 ? 0x80 : 0x10 );
+    }
+}
+
+static void SlotClean( mv_slot_t *p_slot )
+{
+    if( !p_slot->b_setup )
+        return;
+    for( unsigned i = 0; i < 3; i++ )
+        ResizePlaneClean( &p_slot->planes[i] );
+    free( p_slot->p_scratch );
+    p_slot->p_scratch = NULL;
+    p_slot->b_setup = false;
+}
+
+static int SlotSetup( demux_sys_t *p_sys, mv_slot_t *p_slot,
+                      const video_format_t *p_fmt )
+{
+    if( p_slot->b_setup && p_slot->i_chroma == p_fmt->i_chroma
+     && p_slot->i_src_x == p_fmt->i_x_offset
+     && p_slot->i_src_y == p_fmt->i_y_offset
+     && p_slot->i_src_width == p_fmt->i_visible_width
+     && p_slot->i_src_height == p_fmt->i_visible_height
+     && p_slot->i_sar_num == p_fmt->i_sar_num
+     && p_slot->i_sar_den == p_fmt->i_sar_den )
+        return VLC_SUCCESS;
+
+    SlotClean( p_slot );
+
+    const vlc_chroma_description_t *p_dsc =
+        vlc_fourcc_GetChromaDescription( p_fmt->i_chroma );
+    if( !IsPlanarYUV8( p_fmt->i_chroma )
+     || p_fmt->i_visible_width < 2 || p_fmt->i_visible_height < 2 )
+        return VLC_EGENERIC;
+
+    /* Fit the picture in the cell, the canvas has square pixels */
+    unsigned w = p_slot->i_width, h = p_slot->i_height;
+    if( p_sys->b_keep_ratio )
+    {
+        uint64_t i_dar_num = (uint64_t)p_fmt->i_visible_width
+                           * (p_fmt->i_sar_num ? p_fmt->i_sar_num : 1);
+        uint64_t i_dar_den = (uint64_t)p_fmt->i_visible_height
+                           * (p_fmt->i_sar_den ? p_fmt->i_sar_den : 1);
+
+        if( w * i_dar_den > h * i_dar_num )
+            w = h * i_dar_num / i_dar_den;
+        else
+            h = w * i_dar_den / i_dar_num;
+        w = __MAX( w & ~1u, 2 );
+        h = __MAX( h & ~1u, 2 );
+    }
+    p_slot->i_fit_x = p_slot->i_x + ((p_slot->i_width - w) / 2 & ~1u);
+    p_slot->i_fit_y = p_slot->i_y + ((p_slot->i_height - h) / 2 & ~1u);
+    p_slot->i_fit_width = w;
+    p_slot->i_fit_height = h;
+
+    size_t i_scratch = 0;
+    for( unsigned i = 0; i < 3; i++ )
+    {
+        const unsigned i_shift = i > 0;
+        unsigned i_src_width = (p_fmt->i_visible_width * p_dsc->p[i].w.num
+                                + p_dsc->p[i].w.den - 1) / p_dsc->p[i].w.den;
+        unsigned i_src_height = (p_fmt->i_visible_height * p_dsc->p[i].h.num
+                                 + p_dsc->p[i].h.den - 1) / p_dsc->p[i].h.den;
+
+        if( ResizePlaneInit( &p_slot->planes[i], p_sys->method,
+                             i_src_width, i_src_height,
+                             w >> i_shift, h >> i_shift, 1, 8 ) )
+        {
+            while( i-- > 0 )
+                ResizePlaneClean( &p_slot->planes[i] );
+            return VLC_ENOMEM;
+        }
+        i_scratch = __MAX( i_scratch,
+                           ResizePlaneScratchSize( &p_slot->planes[i] ) );
+    }
+
+    p_slot->p_scratch = malloc( i_scratch );
+    if( p_slot->p_scratch == NULL )
+    {
+        for( unsigned i = 0; i < 3; i++ )
+            ResizePlaneClean( &p_slot->planes[i] );
+        return VLC_ENOMEM;
+    }
+
+    p_slot->i_chroma = p_fmt->i_chroma;
+    p_slot->i_src_x = p_fmt->i_x_offset;
+    p_slot->i_src_y = p_fmt->i_y_offset;
+    p_slot->i_src_width = p_fmt->i_visible_width;
+    p_slot->i_src_height = p_fmt->i_visible_height;
+    p_slot->i_sar_num = p_fmt->i_sar_num;
+    p_slot->i_sar_den = p_fmt->i_sar_den;
+    p_slot->b_setup = true;
+    return VLC_SUCCESS;
+}
+
+static void SlotScale( demux_sys_t *p_sys, mv_slot_t *p_slot,
+                       mv_frame_t *p_frame )
+{
+    picture_t *p_pic = p_slot->p_picture;
+
+    if( p_pic == NULL || SlotSetup( p_sys, p_slot, &p_pic->format ) )
+    {
+        FrameFill( p_sys, p_frame, p_slot->i_x, p_slot->i_y,
+                   p_slot->i_width, p_slot->i_height );
+        return;
+    }
+
+    /* Borders left by the aspect ratio */
+    const unsigned i_top = p_slot->i_fit_y - p_slot->i_y;
+    const unsigned i_left = p_slot->i_fit_x - p_slot->i_x;
+    const unsigned i_bottom = p_slot->i_fit_y + p_slot->i_fit_height;
+    const unsigned i_right = p_slot->i_fit_x + p_slot->i_fit_width;
+
+    FrameFill( p_sys, p_frame, p_slot->i_x, p_slot->i_y,
+               p_slot->i_width, i_top );
+    FrameFill( p_sys, p_frame, p_slot->i_x, i_bottom, p_slot->i_width,
+               p_slot->i_y + p_slot->i_height - i_bottom );
+    FrameFill( p_sys, p_frame, p_slot->i_x, p_slot->i_fit_y,
+               i_left, p_slot->i_fit_height );
+    FrameFill( p_sys, p_frame, i_right, p_slot->i_fit_y,
+               p_slot->i_x + p_slot->i_width - i_right,
+               p_slot->i_fit_height );
+
+    const vlc_chroma_description_t *p_dsc =
+        vlc_fourcc_GetChromaDescription( p_pic->format.i_chroma );
+    const bool b_swap_uv = p_pic->format.i_chroma == VLC_CODEC_YV12;
+
+    for( unsigned i = 0; i < 3; i++ )
+    {
+        const plane_t *p_src = &p_pic->p[b_swap_uv && i > 0 ? 3 - i : i];
+        const unsigned i_x = p_pic->format.i_x_offset * p_dsc->p[i].w.num
+                           / p_dsc->p[i].w.den;
+        const unsigned i_y = p_pic->format.i_y_offset * p_dsc->p[i].h.num
+                           / p_dsc->p[i].h.den;
+
+        ResizePlaneSlice( &p_slot->planes[i], &p_sys->kernels,
+                          FramePlane( p_sys, p_frame, i, p_slot->i_fit_x,
+                                      p_slot->i_fit_y ),
+                          p_sys->pi_pitch[i],
+                          &p_src->p_pixels[i_y * p_src->i_pitch + i_x],
+                          p_src->i_pitch,
+                          0, p_slot->i_fit_height >> (i > 0),
+                          p_slot->p_scratch );
+    }
+}
+
+static void SlotCopy( demux_sys_t *p_sys, const mv_slot_t *p_slot,
+                      mv_frame_t *p_dst, const mv_frame_t *p_src )
+{
+    for( unsigned i = 0; i < 3; i++ )
+    {
+        const unsigned i_shift = i > 0;
+        const size_t i_pitch = p_sys->pi_pitch[i];
+        const size_t i_offset = FramePlane( p_sys, p_dst, i, p_slot->i_x,
+                                            p_slot->i_y ) - p_dst->p_pixels;
+
+        for( unsigned y = 0; y < p_slot->i_height >> i_shift; y++ )
+            memcpy( &p_dst->p_pixels[i_offset + y * i_pitch],
+                    &p_src->p_pixels[i_offset + y * i_pitch],
+                    p_slot->i_width >> i_shift );
+    }
+}
+
+static void RunTask( demux_sys_t *p_sys, const mv_task_t *p_task )
+{
+    if( p_task->p_src != NULL )
+        SlotCopy( p_sys, p_task->p_slot, p_task->p_dst, p_task->p_src );
+    else
+        SlotScale( p_sys, p_task->p_slot, p_task->p_dst );
+}
+
+static void *Worker( void *data )
+{
+    demux_sys_t *p_sys = data;
+
+    vlc_mutex_lock( &p_sys->lock );
+    for( ;; )
+    {
+        while( !p_sys->b_quit && p_sys->i_next_task >= p_sys->i_tasks )
+            vlc_cond_wait( &p_sys->wait, &p_sys->lock );
+        if( p_sys->b_quit )
+            break;
+
+        const mv_task_t *p_task = &p_sys->p_tasks[p_sys->i_next_task++];
+        vlc_mutex_unlock( &p_sys->lock );
+
+        RunTask( p_sys, p_task );
+
+        vlc_mutex_lock( &p_sys->lock );
+        if( --p_sys->i_pending == 0 )
+            vlc_cond_signal( &p_sys->done );
+    }
+    vlc_mutex_unlock( &p_sys->lock );
+    return NULL;
+}
+
+static void RunTasks( demux_sys_t *p_sys, unsigned i_tasks )
+{
+    vlc_mutex_lock( &p_sys->lock );
+    p_sys->i_tasks = i_tasks;
+    p_sys->i_next_task = 0;
+    p_sys->i_pending = i_tasks;
+    if( p_sys->i_workers > 0 && i_tasks > 1 )
+        vlc_cond_broadcast( &p_sys->wait );
+
+    while( p_sys->i_next_task < p_sys->i_tasks )
+    {
+        const mv_task_t *p_task = &p_sys->p_tasks[p_sys->i_next_task++];
+        vlc_mutex_unlock( &p_sys->lock );
+
+        RunTask( p_sys, p_task );
+
+        vlc_mutex_lock( &p_sys->lock );
+        p_sys->i_pending--;
+    }
+    while( p_sys->i_pending > 0 )
+        vlc_cond_wait( &p_sys->done, &p_sys->lock );
+    vlc_mutex_unlock( &p_sys->lock );
+}
+
+static void StopWorkers( demux_sys_t *p_sys )
+{
+    vlc_mutex_lock( &p_sys->lock );
+    p_sys->b_quit = true;
+    vlc_cond_broadcast( &p_sys->wait );
+    vlc_mutex_unlock( &p_sys->lock );
+
+    for( unsigned i = 0; i < p_sys->i_workers; i++ )
+        vlc_join( p_sys->workers[i], NULL );
+}
+
+static block_t *Compose( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    mv_canvas_t *p_canvas = p_sys->p_canvas;
+    mv_frame_t *p_last = p_sys->p_last;
+    mv_frame_t *p_frame = NULL;
+
+    /* The last frame has the most tiles up to date */
+    if( p_last != NULL && !atomic_load( &p_last->b_busy ) )
+        p_frame = p_last;
+    else
+        for( unsigned i = 0; i < MV_FRAMES && p_frame == NULL; i++ )
+            if( !atomic_load( &p_canvas->frames[i].b_busy ) )
+                p_frame = &p_canvas->frames[i];
+    if( p_frame == NULL )
+    {
+        p_sys->stats.i_dropped++;
+        return NULL;
+    }
+
+    const mtime_t i_start = mdate();
+    unsigned i_tasks = 0;
+
+    for( unsigned i = 0; i < p_sys->i_slots; i++ )
+    {
+        mv_slot_t *p_slot = &p_sys->p_slots[i];
+        mv_tile_t *p_tile = p_slot->p_tile;
+        const mv_frame_t *p_src = NULL;
+
+        vlc_mutex_lock( &p_tile->lock );
+        p_slot->i_version = p_tile->i_version;
+        if( p_frame->pi_versions[i] != p_slot->i_version )
+        {
+            if( p_last != NULL && p_last != p_frame
+             && p_last->pi_versions[i] == p_slot->i_version )
+                p_src = p_last;
+            else if( p_tile->p_picture != NULL )
+                p_slot->p_picture = picture_Hold( p_tile->p_picture );
+        }
+        vlc_mutex_unlock( &p_tile->lock );
+
+        if( p_frame->pi_versions[i] == p_slot->i_version )
+            continue; /* unchanged tile */
+
+        mv_task_t *p_task = &p_sys->p_tasks[i_tasks++];
+        p_task->p_slot = p_slot;
+        p_task->p_dst = p_frame;
+        p_task->p_src = p_src;
+        if( p_src != NULL )
+            p_sys->stats.i_copied++;
+        else
+            p_sys->stats.i_scaled++;
+    }
+
+    if( i_tasks > 0 )
+        RunTasks( p_sys, i_tasks );
+
+    for( unsigned i = 0; i < i_tasks; i++ )
+    {
+        mv_slot_t *p_slot = p_sys->p_tasks[i].p_slot;
+
+        if( p_slot->p_picture != NULL )
+        {
+            picture_Release( p_slot->p_picture );
+            p_slot->p_picture = NULL;
+        }
+        p_frame->pi_versions[p_slot - p_sys->p_slots] = p_slot->i_version;
+    }
+    p_sys->stats.i_compose_time += mdate() - i_start;
+
+    atomic_store( &p_frame->b_busy, true );
+    atomic_fetch_add( &p_canvas->refs, 1 );
+    block_Init( &p_frame->block, p_frame->p_pixels, p_canvas->i_size );
+    p_frame->block.pf_release = FrameRelease;
+    p_sys->p_last = p_frame;
+    return &p_frame->block;
+}
+
+static void Stats( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    const mtime_t i_now = mdate();
+
+    if( i_now - p_sys->stats.i_date < 10 * CLOCK_FREQ )
+        return;
+
+    msg_Dbg( p_demux, "%u frames (%u late, %u dropped), %u tiles scaled, "
+             "%u copied, %"PRId64" us per frame", p_sys->stats.i_frames,
+             p_sys->stats.i_late, p_sys->stats.i_dropped,
+             p_sys->stats.i_scaled, p_sys->stats.i_copied,
+             p_sys->stats.i_frames ? p_sys->stats.i_compose_time
+                                     / p_sys->stats.i_frames : 0 );
+    memset( &p_sys->stats, 0, sizeof( p_sys->stats ) );
+    p_sys->stats.i_date = i_now;
+}
+
+static int Demux( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    if( !p_sys->i_next_date ) p_sys->i_next_date = mdate();
+
+    /* Frame skipping if necessary */
+    while( mdate() >= p_sys->i_next_date + p_sys->i_incr )
+    {
+        p_sys->i_next_date += p_sys->i_incr;
+        p_sys->stats.i_late++;
+    }
+
+    mwait( p_sys->i_next_date );
+
+    block_t *p_block = Compose( p_demux );
+    if( p_block != NULL )
+    {
+        p_block->i_dts = p_block->i_pts = p_sys->i_next_date;
+        p_block->i_length = p_sys->i_incr;
+
+        es_out_SetPCR( p_demux->out, p_block->i_pts );
+        es_out_Send( p_demux->out, p_sys->es, p_block );
+        p_sys->stats.i_frames++;
+    }
+
+    p_sys->i_next_date += p_sys->i_incr;
+    Stats( p_demux );
+    return 1;
+}
+
+static int Control( demux_t *p_demux, int i_query, va_list args )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    bool *pb;
+    int64_t *pi64;
+
+    switch( i_query )
+    {
+        case DEMUX_CAN_PAUSE:
+        case DEMUX_CAN_SEEK:
+        case DEMUX_CAN_CONTROL_PACE:
+            pb = va_arg( args, bool * );
+            *pb = false;
+            return VLC_SUCCESS;
+
+        case DEMUX_GET_PTS_DELAY:
+            pi64 = va_arg( args, int64_t * );
+            *pi64 = INT64_C(1000)
+                  * var_InheritInteger( p_demux, "live-caching" );
+            return VLC_SUCCESS;
+
+        case DEMUX_GET_TIME:
+            pi64 = va_arg( args, int64_t * );
+            *pi64 = mdate() - p_sys->i_start;
+            return VLC_SUCCESS;
+
+        default:
+            return VLC_EGENERIC;
+    }
+}
+
+static mv_canvas_t *CanvasNew( demux_sys_t *p_sys )
+{
+    mv_canvas_t *p_canvas = calloc( 1, sizeof( *p_canvas ) );
+    if( p_canvas == NULL )
+        return NULL;
+
+    atomic_init( &p_canvas->refs, 1 );
+    p_canvas->i_size = p_sys->pi_offset[2]
+                     + p_sys->pi_pitch[2] * (p_sys->i_height / 2);
+
+    for( unsigned i = 0; i < MV_FRAMES; i++ )
+    {
+        mv_frame_t *p_frame = &p_canvas->frames[i];
+
+        p_frame->p_canvas = p_canvas;
+        atomic_init( &p_frame->b_busy, false );
+        p_frame->p_pixels = aligned_alloc( 64, (p_canvas->i_size + 63)
+                                               & ~(size_t)63 );
+        p_frame->pi_versions = calloc( p_sys->i_slots,
+                                       sizeof( *p_frame->pi_versions ) );
+        if( p_frame->p_pixels == NULL || p_frame->pi_versions == NULL )
+        {
+            CanvasRelease( p_canvas );
+            return NULL;
+        }
+        /* Version 0 is the black tile */
+        FrameFill( p_sys, p_frame, 0, 0, p_sys->i_width, p_sys->i_height );
+    }
+    return p_canvas;
+}
+
+static char **ParseOrder( const char *psz_order, unsigned *pi_count )
+{
+    char **ppsz_ids = NULL;
+    int i_ids = 0;
+    char *psz_dup = strdup( psz_order ), *psz_save;
+
+    if( psz_dup == NULL )
+        return NULL;
+    for( char *psz_id = strtok_r( psz_dup, ",", &psz_save ); psz_id != NULL;
+         psz_id = strtok_r( NULL, ",", &psz_save ) )
+    {
+        char *psz = strdup( psz_id );
+        if( psz == NULL )
+            break;
+        TAB_APPEND( i_ids, ppsz_ids, psz );
+    }
+    free( psz_dup );
+    *pi_count = i_ids;
+    return ppsz_ids;
+}
+
+static int OpenWall( vlc_object_t *p_this )
+{
+    demux_t *p_demux = (demux_t *)p_this;
+    demux_sys_t *p_sys;
+
+    p_sys = calloc( 1, sizeof( *p_sys ) );
+    if( p_sys == NULL )
+        return VLC_ENOMEM;
+
+    /* Layout */
+    unsigned i_rows = var_InheritInteger( p_demux, "multiview-rows" );
+    unsigned i_cols = var_InheritInteger( p_demux, "multiview-cols" );
+    char *psz_order = var_InheritString( p_demux, "multiview-order" );
+    char **ppsz_ids = NULL;
+    unsigned i_ids = 0;
+
+    if( psz_order != NULL )
+    {
+        ppsz_ids = ParseOrder( psz_order, &i_ids );
+        free( psz_order );
+    }
+    if( i_ids == 0 )
+        i_ids = (i_rows ? i_rows : 2) * (i_cols ? i_cols : 2);
+    if( i_cols == 0 )
+        i_cols = i_rows ? (i_ids + i_rows - 1) / i_rows
+                        : ceilf( sqrtf( i_ids ) );
+    if( i_rows == 0 )
+        i_rows = (i_ids + i_cols - 1) / i_cols;
+    p_sys->i_slots = __MIN( i_ids, i_rows * i_cols );
+
+    int64_t i_width = var_InheritInteger( p_demux, "multiview-width" );
+    int64_t i_height = var_InheritInteger( p_demux, "multiview-height" );
+    unsigned i_border = var_InheritInteger( p_demux, "multiview-border" ) & ~1;
+    int64_t i_cell_width = (i_width - (int64_t)i_border * (i_cols + 1))
+                         / i_cols & ~1;
+    int64_t i_cell_height = (i_height - (int64_t)i_border * (i_rows + 1))
+                          / i_rows & ~1;
+    if( i_width > 16384 || i_height > 16384
+     || i_cell_width < 16 || i_cell_height < 16 )
+    {
+        msg_Err( p_demux, "invalid layout: %"PRId64"x%"PRId64" canvas, "
+                 "%ux%u tiles", i_width, i_height, i_cols, i_rows );
+        goto error;
+    }
+    p_sys->i_width = i_width & ~1;
+    p_sys->i_height = i_height & ~1;
+    p_sys->pi_pitch[0] = p_sys->i_width;
+    p_sys->pi_pitch[1] = p_sys->pi_pitch[2] = p_sys->i_width / 2;
+    p_sys->pi_offset[0] = 0;
+    p_sys->pi_offset[1] = p_sys->pi_pitch[0] * p_sys->i_height;
+    p_sys->pi_offset[2] = p_sys->pi_offset[1]
+                        + p_sys->pi_pitch[1] * (p_sys->i_height / 2);
+
+    p_sys->b_keep_ratio = var_InheritBool( p_demux, "multiview-keep-ratio" );
+    int i_method = var_InheritInteger( p_demux, "multiview-method" );
+    p_sys->method =
+        i_method == RESIZE_BILINEAR ? RESIZE_BILINEAR :
+        i_method == RESIZE_LANCZOS ? RESIZE_LANCZOS : RESIZE_BICUBIC;
+    ResizeGetKernels( &p_sys->kernels, true );
+
+    p_sys->p_slots = calloc( p_sys->i_slots, sizeof( *p_sys->p_slots ) );
+    p_sys->p_tasks = calloc( p_sys->i_slots, sizeof( *p_sys->p_tasks ) );
+    if( p_sys->p_slots == NULL || p_sys->p_tasks == NULL )
+        goto error;
+
+    for( unsigned i = 0; i < p_sys->i_slots; i++ )
+    {
+        mv_slot_t *p_slot = &p_sys->p_slots[i];
+        char psz_default[11];
+        const char *psz_id;
+
+        if( ppsz_ids != NULL )
+            psz_id = ppsz_ids[i];
+        else
+        {
+            snprintf( psz_default, sizeof( psz_default ), "%u", i + 1 );
+            psz_id = psz_default;
+        }
+
+        p_slot->p_tile = TileAcquire( psz_id );
+        if( p_slot->p_tile == NULL )
+            goto error;
+        p_slot->i_x = i_border + (i % i_cols) * (i_cell_width + i_border);
+        p_slot->i_y = i_border + (i / i_cols) * (i_cell_height + i_border);
+        p_slot->i_width = i_cell_width;
+        p_slot->i_height = i_cell_height;
+    }
+
+    p_sys->p_canvas = CanvasNew( p_sys );
+    if( p_sys->p_canvas == NULL )
+        goto error;
+
+    /* Threads */
+    unsigned i_threads = var_InheritInteger( p_demux, "multiview-threads" );
+    if( i_threads == 0 )
+    {
+        p_sys->p_cpu_lease = vlc_cpu_lease_Acquire( p_demux, "multiview",
+                                                    p_sys->i_slots );
+        if( p_sys->p_cpu_lease != NULL )
+            i_threads = vlc_cpu_lease_GetThreads( p_sys->p_cpu_lease );
+    }
+    i_threads = VLC_CLIP( i_threads, 1, __MIN( p_sys->i_slots, MAX_THREADS ) );
+
+    vlc_mutex_init( &p_sys->lock );
+    vlc_cond_init( &p_sys->wait );
+    vlc_cond_init( &p_sys->done );
+    for( unsigned i = 0; i < i_threads - 1; i++ )
+    {
+        if( vlc_clone( &p_sys->workers[i], Worker, p_sys,
+                       VLC_THREAD_PRIORITY_VIDEO ) )
+            break;
+        p_sys->i_workers++;
+    }
+
+    /* Output */
+    float f_fps = var_InheritFloat( p_demux, "multiview-fps" );
+    if( !(f_fps > 0.f) )
+        f_fps = 25.f;
+
+    es_format_t fmt;
+    es_format_Init( &fmt, VIDEO_ES, VLC_CODEC_I420 );
+    video_format_Setup( &fmt.video, VLC_CODEC_I420,
+                        p_sys->i_width, p_sys->i_height,
+                        p_sys->i_width, p_sys->i_height, 1, 1 );
+    fmt.video.i_frame_rate = lroundf( f_fps * 1000.f );
+    fmt.video.i_frame_rate_base = 1000;
+    p_sys->i_incr = CLOCK_FREQ * fmt.video.i_frame_rate_base
+                  / fmt.video.i_frame_rate;
+    p_sys->i_start = mdate();
+    p_sys->stats.i_date = p_sys->i_start;
+
+    p_sys->es = es_out_Add( p_demux->out, &fmt );
+
+    msg_Dbg( p_demux, "%ux%u canvas, %u tiles of %"PRId64"x%"PRId64
+             ", %u threads", p_sys->i_width, p_sys->i_height,
+             p_sys->i_slots, i_cell_width, i_cell_height,
+             p_sys->i_workers + 1 );
+
+    for( unsigned i = 0; i < i_ids && ppsz_ids != NULL; i++ )
+        free( ppsz_ids[i] );
+    free( ppsz_ids );
+
+    p_demux->p_sys = p_sys;
+    p_demux->pf_demux = Demux;
+    p_demux->pf_control = Control;
+    return VLC_SUCCESS;
+
+error:
+    for( unsigned i = 0; i < i_ids && ppsz_ids != NULL; i++ )
+        free( ppsz_ids[i] );
+    free( ppsz_ids );
+    if( p_sys->p_canvas != NULL )
+        CanvasRelease( p_sys->p_canvas );
+    for( unsigned i = 0; i < p_sys->i_slots && p_sys->p_slots != NULL; i++ )
+        if( p_sys->p_slots[i].p_tile != NULL )
+            TileRelease( p_sys->p_slots[i].p_tile );
+    free( p_sys->p_slots );
+    free( p_sys->p_tasks );
+    free( p_sys );
+    return VLC_EGENERIC;
+}
+
+static void CloseWall( vlc_object_t *p_this )
+{
+    demux_t *p_demux = (demux_t *)p_this;
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    StopWorkers( p_sys );
+    vlc_cond_destroy( &p_sys->done );
+    vlc_cond_destroy( &p_sys->wait );
+    vlc_mutex_destroy( &p_sys->lock );
+    if( p_sys->p_cpu_lease != NULL )
+        vlc_cpu_lease_Release( p_sys->p_cpu_lease );
+
+    for( unsigned i = 0; i < p_sys->i_slots; i++ )
+    {
+        SlotClean( &p_sys->p_slots[i] );
+        TileRelease( p_sys->p_slots[i].p_tile );
+    }
+    CanvasRelease( p_sys->p_canvas );
+    free( p_sys->p_slots );
+    free( p_sys->p_tasks );
+    free( p_sys );
+}
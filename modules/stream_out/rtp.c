@@ -137,6 +137,12 @@
     "Default caching value for outbound RTP streams. This " \
     "value should be set in milliseconds." )
 
+#define SEND_THREADS_TEXT N_("Sending threads")
+#define SEND_THREADS_LONGTEXT N_( \
+    "Number of threads sending the packets of all the RTP streams. " \
+    "This is shared by all the RTP outputs and RTSP sessions of the " \
+    "process." )
+
 #define PROTO_TEXT N_("Transport protocol")
 #define PROTO_LONGTEXT N_( \
     "This selects which transport protocol to use for RTP." )
@@ -227,6 +233,8 @@ vlc_module_begin ()
               RTCP_MUX_TEXT, RTCP_MUX_LONGTEXT, false )
     add_integer( SOUT_CFG_PREFIX "caching", DEFAULT_PTS_DELAY / 1000,
                  CACHING_TEXT, CACHING_LONGTEXT, true )
+    add_integer_with_range( SOUT_CFG_PREFIX "send-threads", 1, 1, 16,
+                            SEND_THREADS_TEXT, SEND_THREADS_LONGTEXT, true )
 
 #ifdef HAVE_SRTP
     add_string( SOUT_CFG_PREFIX "key", "",
@@ -280,7 +288,7 @@ static int               MuxSend( sout_stream_t *, sout_stream_id_sys_t *,
                                   block_t* );
 
 static sout_access_out_t *GrabberCreate( sout_stream_t *p_sout );
-static void* ThreadSend( void * );
+static void SendBatch( void *, block_t * );
 static void *rtp_listen_thread( void * );
 
 static void SDPHandleUrl( sout_stream_t *, const char * );
@@ -373,7 +381,6 @@ struct sout_stream_id_sys_t
 #endif
 
     /* Packets sinks */
-    vlc_thread_t      thread;
     vlc_mutex_t       lock_sink;
     int               sinkc;
     rtp_sink_t       *sinkv;
@@ -383,7 +390,7 @@ struct sout_stream_id_sys_t
         vlc_thread_t  thread;
     } listen;
 
-    block_fifo_t     *p_fifo;
+    rtp_sched_queue_t *p_queue;
     int64_t           i_caching;
 };
 
@@ -976,7 +983,7 @@ static sout_stream_id_sys_t *Add( sout_stream_t *p_stream,
     id->sinkc = 0;
     id->sinkv = NULL;
     id->rtsp_id = NULL;
-    id->p_fifo = NULL;
+    id->p_queue = NULL;
     id->listen.fd = NULL;
 
     id->b_first_packet = true;
@@ -1182,15 +1189,11 @@ static sout_stream_id_sys_t *Add( sout_stream_t *p_stream,
         id->rtsp_id = RtspAddId( p_sys->rtsp, id, GetDWBE( id->ssrc ),
                                  id->rtp_fmt.clock_rate, mcast_fd );
 
-    id->p_fifo = block_FifoNew();
-    if( unlikely(id->p_fifo == NULL) )
-        goto error;
-    if( vlc_clone( &id->thread, ThreadSend, id, VLC_THREAD_PRIORITY_HIGHEST ) )
-    {
-        block_FifoRelease( id->p_fifo );
-        id->p_fifo = NULL;
+    id->p_queue = rtp_sched_Attach(
+        var_InheritInteger( p_stream, SOUT_CFG_PREFIX "send-threads" ),
+        id->i_caching, SendBatch, id );
+    if( unlikely(id->p_queue == NULL) )
         goto error;
-    }
 
     /* Update p_sys context */
     vlc_mutex_lock( &p_sys->lock_es );
@@ -1225,12 +1228,8 @@ static void Del( sout_stream_t *p_stream, sout_stream_id_sys_t *id )
     TAB_REMOVE( p_sys->i_es, p_sys->es, id );
     vlc_mutex_unlock( &p_sys->lock_es );
 
-    if( likely(id->p_fifo != NULL) )
-    {
-        vlc_cancel( id->thread );
-        vlc_join( id->thread, NULL );
-        block_FifoRelease( id->p_fifo );
-    }
+    if( likely(id->p_queue != NULL) )
+        rtp_sched_Detach( id->p_queue );
 
     free( id->rtp_fmt.fmtp );
 
@@ -1392,92 +1391,81 @@ static int  HttpCallback( httpd_file_sys_t *p_args,
 /****************************************************************************
  * RTP send
  ****************************************************************************/
-static void* ThreadSend( void *data )
+/* Sends packets to all the sinks, and releases them */
+static void SendPackets( sout_stream_id_sys_t *id, block_t *const *pktv,
+                         unsigned pktc )
 {
-#ifdef _WIN32
-# define ENOBUFS      WSAENOBUFS
-# define EAGAIN       WSAEWOULDBLOCK
-# define EWOULDBLOCK  WSAEWOULDBLOCK
-#endif
-    sout_stream_id_sys_t *id = data;
-    unsigned i_caching = id->i_caching;
+    vlc_mutex_lock( &id->lock_sink );
+    unsigned deadc = 0; /* How many dead sockets? */
+    int deadv[id->sinkc ? id->sinkc : 1]; /* Dead sockets list */
 
-    for (;;)
+    for( int i = 0; i < id->sinkc; i++ )
     {
-        block_t *out = block_FifoGet( id->p_fifo );
-        block_cleanup_push (out);
-
 #ifdef HAVE_SRTP
-        if( id->srtp )
-        {   /* FIXME: this is awfully inefficient */
-            size_t len = out->i_buffer;
-            out = block_Realloc( out, 0, len + 10 );
-            out->i_buffer = len;
-
-            int canc = vlc_savecancel ();
-            int val = srtp_send( id->srtp, out->p_buffer, &len, len + 10 );
-            vlc_restorecancel (canc);
-            if( val )
-            {
-                msg_Dbg( id->p_stream, "SRTP sending error: %s",
-                         vlc_strerror_c(val) );
-                block_Release( out );
-                out = NULL;
-            }
-            else
-                out->i_buffer = len;
-        }
-        if (out)
-            mwait (out->i_dts + i_caching);
-        vlc_cleanup_pop ();
-        if (out == NULL)
-            continue;
-#else
-        mwait (out->i_dts + i_caching);
-        vlc_cleanup_pop ();
+        if( !id->srtp ) /* FIXME: SRTCP support */
 #endif
+            for( unsigned j = 0; j < pktc; j++ )
+                SendRTCP( id->sinkv[i].rtcp, pktv[j] );
 
-        ssize_t len = out->i_buffer;
-        int canc = vlc_savecancel ();
+        if( !rtp_sched_SendPackets( id->sinkv[i].rtp_fd, pktv, pktc ) )
+            /* Broken connection */
+            deadv[deadc++] = id->sinkv[i].rtp_fd;
+    }
+    id->i_seq_sent_next = ntohs(((uint16_t *) pktv[pktc - 1]->p_buffer)[1]) + 1;
+    vlc_mutex_unlock( &id->lock_sink );
 
-        vlc_mutex_lock( &id->lock_sink );
-        unsigned deadc = 0; /* How many dead sockets? */
-        int deadv[id->sinkc ? id->sinkc : 1]; /* Dead sockets list */
+    for( unsigned i = 0; i < pktc; i++ )
+        block_Release( pktv[i] );
 
-        for( int i = 0; i < id->sinkc; i++ )
+    for( unsigned i = 0; i < deadc; i++ )
+    {
+        msg_Dbg( id->p_stream, "removing socket %d", deadv[i] );
+        rtp_del_sink( id, deadv[i] );
+    }
+}
+
+/* Sends the packets that are due, usually those of one frame */
+static void SendBatch( void *data, block_t *chain )
+{
+    sout_stream_id_sys_t *id = data;
+
+    while( chain != NULL )
+    {
+        block_t *pktv[RTP_SCHED_BATCH];
+        unsigned pktc = 0;
+
+        while( chain != NULL && pktc < RTP_SCHED_BATCH )
         {
-#ifdef HAVE_SRTP
-            if( !id->srtp ) /* FIXME: SRTCP support */
-#endif
-                SendRTCP( id->sinkv[i].rtcp, out );
+            block_t *out = chain;
 
-            if( send( id->sinkv[i].rtp_fd, out->p_buffer, len, 0 ) == -1
-             && net_errno != EAGAIN && net_errno != EWOULDBLOCK
-             && net_errno != ENOBUFS && net_errno != ENOMEM )
+            chain = out->p_next;
+            out->p_next = NULL;
+#ifdef HAVE_SRTP
+            if( id->srtp )
             {
-                int type;
-                getsockopt( id->sinkv[i].rtp_fd, SOL_SOCKET, SO_TYPE,
-                            &type, &(socklen_t){ sizeof(type) });
-                if( type == SOCK_DGRAM )
-                    /* ICMP soft error: ignore and retry */
-                    send( id->sinkv[i].rtp_fd, out->p_buffer, len, 0 );
-                else
-                    /* Broken connection */
-                    deadv[deadc++] = id->sinkv[i].rtp_fd;
+                size_t len = out->i_buffer;
+                out = block_Realloc( out, 0, len + 10 );
+                if( unlikely(out == NULL) )
+                    continue;
+                out->i_buffer = len;
+
+                int val = srtp_send( id->srtp, out->p_buffer, &len, len + 10 );
+                if( val )
+                {
+                    msg_Dbg( id->p_stream, "SRTP sending error: %s",
+                             vlc_strerror_c(val) );
+                    block_Release( out );
+                    continue;
+                }
+                out->i_buffer = len;
             }
+#endif
+            pktv[pktc++] = out;
         }
-        id->i_seq_sent_next = ntohs(((uint16_t *) out->p_buffer)[1]) + 1;
-        vlc_mutex_unlock( &id->lock_sink );
-        block_Release( out );
 
-        for( unsigned i = 0; i < deadc; i++ )
-        {
-            msg_Dbg( id->p_stream, "removing socket %d", deadv[i] );
-            rtp_del_sink( id, deadv[i] );
-        }
-        vlc_restorecancel (canc);
+        if( pktc > 0 )
+            SendPackets( id, pktv, pktc );
     }
-    return NULL;
 }
 
 
@@ -1659,7 +1647,7 @@ uint16_t rtp_get_extended_sequence( sout_stream_id_sys_t *id )
 
 void rtp_packetize_send( sout_stream_id_sys_t *id, block_t *out )
 {
-    block_FifoPut( id->p_fifo, out );
+    rtp_sched_Queue( id->p_queue, out );
 }
 
 /**
@@ -69,6 +69,18 @@ rtcp_sender_t *OpenRTCP (vlc_object_t *obj, int rtp_fd, int proto,
 void CloseRTCP (rtcp_sender_t *rtcp);
 void SendRTCP (rtcp_sender_t *restrict rtcp, const block_t *rtp);
 
+/* Send scheduler */
+#define RTP_SCHED_BATCH 64 /* packets per system call */
+
+typedef struct rtp_sched_queue_t rtp_sched_queue_t;
+typedef void (*rtp_sched_send_cb)( void *opaque, block_t *chain );
+
+rtp_sched_queue_t *rtp_sched_Attach( unsigned i_threads, mtime_t i_delay,
+                                     rtp_sched_send_cb pf_send, void *opaque );
+void rtp_sched_Detach( rtp_sched_queue_t *q );
+void rtp_sched_Queue( rtp_sched_queue_t *q, block_t *p_block );
+bool rtp_sched_SendPackets( int fd, block_t *const *pktv, unsigned pktc );
+
 typedef int (*pf_rtp_packetizer_t)( sout_stream_id_sys_t *, block_t * );
 
 typedef struct rtp_format_t
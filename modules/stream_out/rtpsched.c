@@ -0,0 +1,443 @@
+/*****************************************************************************
+ * rtpsched.c: RTP send scheduler
+ *****************************************************************************
+ * Copyright (C) 2020 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <assert.h>
+#include <errno.h>
+
+#include <vlc_common.h>
+#include <vlc_block.h>
+#include <vlc_network.h>
+#include <vlc_sout.h>
+#include "rtp.h"
+
+#ifdef _WIN32
+# define ENOBUFS      WSAENOBUFS
+# define EAGAIN       WSAEWOULDBLOCK
+# define EWOULDBLOCK  WSAEWOULDBLOCK
+#endif
+
+/*
+ * NOTE on the scheduler implementation:
+ * - all the RTP streams of the process share a few sending threads, instead
+ *   of having one thread per elementary stream,
+ * - each thread has a timer wheel of queues, ordered by the send deadline of
+ *   their first packet, with a millisecond resolution,
+ * - when a queue is due, all its due packets are handed to the sender at
+ *   once, i.e. usually all the packets of a video frame, so that they can be
+ *   encrypted and sent to each sink in a single batch.
+ */
+#define RTP_SCHED_TICK        1000 /* wheel resolution (µs) */
+#define RTP_SCHED_SLOTS       1024 /* wheel size, about one second */
+#define RTP_SCHED_MAX_THREADS   16
+
+typedef struct rtp_sched_worker_t rtp_sched_worker_t;
+
+struct rtp_sched_queue_t
+{
+    rtp_sched_worker_t *worker;
+    rtp_sched_send_cb   pf_send;
+    void               *opaque;
+    mtime_t             i_delay;
+
+    /* Packets waiting for their deadline, in sending order */
+    block_t            *p_first;
+    block_t           **pp_last;
+
+    uint64_t            i_tick; /* wheel tick of the first packet */
+    bool                b_linked;
+    bool                b_busy; /* owned by the sending thread */
+    rtp_sched_queue_t  *p_prev;
+    rtp_sched_queue_t  *p_next;
+};
+
+struct rtp_sched_worker_t
+{
+    vlc_thread_t thread;
+    vlc_mutex_t  lock;
+    vlc_cond_t   wait; /* earlier deadline or exit */
+    vlc_cond_t   idle; /* a queue is no longer busy */
+    bool         b_exit;
+
+    uint64_t     i_tick;   /* next tick to process */
+    uint64_t     i_wakeup; /* tick the thread sleeps until, 0 if running */
+    unsigned     i_queues; /* attached queues, protected by sched_lock */
+    rtp_sched_queue_t *slots[RTP_SCHED_SLOTS];
+};
+
+typedef struct
+{
+    unsigned            i_refs;
+    unsigned            i_workers;
+    rtp_sched_worker_t *workers;
+} rtp_sched_t;
+
+static vlc_mutex_t sched_lock = VLC_STATIC_MUTEX;
+static rtp_sched_t *sched = NULL;
+
+static uint64_t DeadlineTick( const rtp_sched_queue_t *q, const block_t *b )
+{
+    mtime_t i_deadline = b->i_dts + q->i_delay;
+    return i_deadline > 0 ? (uint64_t)i_deadline / RTP_SCHED_TICK : 0;
+}
+
+/* Must be called with the worker lock held */
+static void Link( rtp_sched_worker_t *w, rtp_sched_queue_t *q )
+{
+    assert( !q->b_linked && q->p_first != NULL );
+
+    q->i_tick = __MAX( DeadlineTick( q, q->p_first ), w->i_tick );
+
+    rtp_sched_queue_t **pp_slot = &w->slots[q->i_tick % RTP_SCHED_SLOTS];
+    q->p_prev = NULL;
+    q->p_next = *pp_slot;
+    if( q->p_next != NULL )
+        q->p_next->p_prev = q;
+    *pp_slot = q;
+    q->b_linked = true;
+
+    if( q->i_tick < w->i_wakeup )
+        vlc_cond_signal( &w->wait );
+}
+
+/* Must be called with the worker lock held */
+static void Unlink( rtp_sched_worker_t *w, rtp_sched_queue_t *q )
+{
+    assert( q->b_linked );
+
+    if( q->p_prev != NULL )
+        q->p_prev->p_next = q->p_next;
+    else
+        w->slots[q->i_tick % RTP_SCHED_SLOTS] = q->p_next;
+    if( q->p_next != NULL )
+        q->p_next->p_prev = q->p_prev;
+    q->b_linked = false;
+}
+
+/* Returns the earliest tick of the wheel, UINT64_MAX if it is empty */
+static uint64_t NextTick( const rtp_sched_worker_t *w )
+{
+    uint64_t i_next = UINT64_MAX;
+
+    for( unsigned i = 0; i < RTP_SCHED_SLOTS; i++ )
+    {
+        const uint64_t i_tick = w->i_tick + i;
+
+        for( const rtp_sched_queue_t *q = w->slots[i_tick % RTP_SCHED_SLOTS];
+             q != NULL; q = q->p_next )
+            if( q->i_tick < i_next )
+                i_next = q->i_tick;
+
+        /* Queues of later rounds are in later ticks */
+        if( i_next <= i_tick )
+            break;
+    }
+    return i_next;
+}
+
+/* Removes the due packets from a queue, must be called with the lock held */
+static block_t *Dequeue( rtp_sched_queue_t *q, uint64_t i_now )
+{
+    block_t *p_chain = q->p_first, **pp_tail = &p_chain;
+
+    while( *pp_tail != NULL && DeadlineTick( q, *pp_tail ) <= i_now )
+        pp_tail = &(*pp_tail)->p_next;
+
+    q->p_first = *pp_tail;
+    if( q->p_first == NULL )
+        q->pp_last = &q->p_first;
+    *pp_tail = NULL;
+    return p_chain;
+}
+
+static void *Worker( void *data )
+{
+    rtp_sched_worker_t *w = data;
+
+    vlc_mutex_lock( &w->lock );
+    while( !w->b_exit )
+    {
+        const uint64_t i_now = mdate() / RTP_SCHED_TICK;
+        rtp_sched_queue_t *p_due = NULL;
+
+        w->i_wakeup = 0;
+
+        /* Collect the due queues, scanning each slot at most once */
+        if( i_now >= w->i_tick + RTP_SCHED_SLOTS )
+            w->i_tick = i_now - RTP_SCHED_SLOTS + 1;
+        for( ; w->i_tick <= i_now; w->i_tick++ )
+        {
+            rtp_sched_queue_t *q = w->slots[w->i_tick % RTP_SCHED_SLOTS];
+            while( q != NULL )
+            {
+                rtp_sched_queue_t *p_next = q->p_next;
+                if( q->i_tick <= i_now )
+                {
+                    Unlink( w, q );
+                    q->b_busy = true;
+                    q->p_next = p_due;
+                    p_due = q;
+                }
+                q = p_next;
+            }
+        }
+
+        while( p_due != NULL )
+        {
+            rtp_sched_queue_t *q = p_due;
+            block_t *p_chain = Dequeue( q, i_now );
+
+            p_due = q->p_next;
+            vlc_mutex_unlock( &w->lock );
+            if( p_chain != NULL )
+                q->pf_send( q->opaque, p_chain );
+            vlc_mutex_lock( &w->lock );
+
+            q->b_busy = false;
+            if( q->p_first != NULL )
+                Link( w, q );
+            vlc_cond_broadcast( &w->idle );
+        }
+
+        if( w->b_exit )
+            break;
+
+        const uint64_t i_next = NextTick( w );
+        w->i_wakeup = i_next;
+        if( i_next == UINT64_MAX )
+            vlc_cond_wait( &w->wait, &w->lock );
+        else if( i_next > i_now )
+            vlc_cond_timedwait( &w->wait, &w->lock,
+                                (mtime_t)i_next * RTP_SCHED_TICK );
+    }
+    vlc_mutex_unlock( &w->lock );
+    return NULL;
+}
+
+static void Destroy( rtp_sched_t *p_sched, unsigned i_started )
+{
+    for( unsigned i = 0; i < i_started; i++ )
+    {
+        rtp_sched_worker_t *w = &p_sched->workers[i];
+
+        vlc_mutex_lock( &w->lock );
+        w->b_exit = true;
+        vlc_cond_signal( &w->wait );
+        vlc_mutex_unlock( &w->lock );
+        vlc_join( w->thread, NULL );
+    }
+    for( unsigned i = 0; i < p_sched->i_workers; i++ )
+    {
+        rtp_sched_worker_t *w = &p_sched->workers[i];
+
+        vlc_cond_destroy( &w->idle );
+        vlc_cond_destroy( &w->wait );
+        vlc_mutex_destroy( &w->lock );
+    }
+    free( p_sched->workers );
+    free( p_sched );
+}
+
+static rtp_sched_t *Create( unsigned i_threads )
+{
+    rtp_sched_t *p_sched = malloc( sizeof( *p_sched ) );
+    if( unlikely(p_sched == NULL) )
+        return NULL;
+
+    p_sched->i_refs = 0;
+    p_sched->i_workers = VLC_CLIP( i_threads, 1, RTP_SCHED_MAX_THREADS );
+    p_sched->workers = calloc( p_sched->i_workers,
+                               sizeof( *p_sched->workers ) );
+    if( unlikely(p_sched->workers == NULL) )
+    {
+        free( p_sched );
+        return NULL;
+    }
+
+    const uint64_t i_now = mdate() / RTP_SCHED_TICK;
+    for( unsigned i = 0; i < p_sched->i_workers; i++ )
+    {
+        rtp_sched_worker_t *w = &p_sched->workers[i];
+
+        vlc_mutex_init( &w->lock );
+        vlc_cond_init( &w->wait );
+        vlc_cond_init( &w->idle );
+        w->i_tick = i_now;
+    }
+
+    for( unsigned i = 0; i < p_sched->i_workers; i++ )
+    {
+        rtp_sched_worker_t *w = &p_sched->workers[i];
+
+        if( vlc_clone( &w->thread, Worker, w, VLC_THREAD_PRIORITY_HIGHEST ) )
+        {
+            Destroy( p_sched, i );
+            return NULL;
+        }
+    }
+    return p_sched;
+}
+
+rtp_sched_queue_t *rtp_sched_Attach( unsigned i_threads, mtime_t i_delay,
+                                     rtp_sched_send_cb pf_send, void *opaque )
+{
+    rtp_sched_queue_t *q = malloc( sizeof( *q ) );
+    if( unlikely(q == NULL) )
+        return NULL;
+
+    q->pf_send = pf_send;
+    q->opaque = opaque;
+    q->i_delay = i_delay;
+    q->p_first = NULL;
+    q->pp_last = &q->p_first;
+    q->b_linked = false;
+    q->b_busy = false;
+
+    vlc_mutex_lock( &sched_lock );
+    if( sched == NULL )
+    {
+        sched = Create( i_threads );
+        if( sched == NULL )
+        {
+            vlc_mutex_unlock( &sched_lock );
+            free( q );
+            return NULL;
+        }
+    }
+    sched->i_refs++;
+
+    /* Spread the queues over the threads */
+    rtp_sched_worker_t *w = &sched->workers[0];
+    for( unsigned i = 1; i < sched->i_workers; i++ )
+        if( sched->workers[i].i_queues < w->i_queues )
+            w = &sched->workers[i];
+    w->i_queues++;
+    q->worker = w;
+    vlc_mutex_unlock( &sched_lock );
+
+    return q;
+}
+
+void rtp_sched_Detach( rtp_sched_queue_t *q )
+{
+    rtp_sched_worker_t *w = q->worker;
+
+    vlc_mutex_lock( &w->lock );
+    while( q->b_busy )
+        vlc_cond_wait( &w->idle, &w->lock );
+    if( q->b_linked )
+        Unlink( w, q );
+    vlc_mutex_unlock( &w->lock );
+
+    block_ChainRelease( q->p_first );
+    free( q );
+
+    rtp_sched_t *p_unused = NULL;
+
+    vlc_mutex_lock( &sched_lock );
+    w->i_queues--;
+    if( --sched->i_refs == 0 )
+    {
+        p_unused = sched;
+        sched = NULL;
+    }
+    vlc_mutex_unlock( &sched_lock );
+
+    if( p_unused != NULL )
+        Destroy( p_unused, p_unused->i_workers );
+}
+
+void rtp_sched_Queue( rtp_sched_queue_t *q, block_t *p_block )
+{
+    rtp_sched_worker_t *w = q->worker;
+
+    assert( p_block->p_next == NULL );
+
+    vlc_mutex_lock( &w->lock );
+    const bool b_idle = q->p_first == NULL && !q->b_busy;
+
+    *q->pp_last = p_block;
+    q->pp_last = &p_block->p_next;
+    if( b_idle )
+        Link( w, q );
+    vlc_mutex_unlock( &w->lock );
+}
+
+/* Handles a sending error, returns false if the connection is broken */
+static bool SendError( int fd, const block_t *p_block )
+{
+    if( net_errno == EAGAIN
+#if EWOULDBLOCK != EAGAIN
+     || net_errno == EWOULDBLOCK
+#endif
+     || net_errno == ENOBUFS || net_errno == ENOMEM )
+        return true; /* congestion: drop the packet */
+
+    int type;
+    getsockopt( fd, SOL_SOCKET, SO_TYPE, &type, &(socklen_t){ sizeof(type) });
+    if( type != SOCK_DGRAM )
+        return false;
+
+    /* ICMP soft error: ignore and retry */
+    send( fd, p_block->p_buffer, p_block->i_buffer, 0 );
+    return true;
+}
+
+bool rtp_sched_SendPackets( int fd, block_t *const *pktv, unsigned pktc )
+{
+#ifdef HAVE_SENDMMSG
+    struct mmsghdr msgv[RTP_SCHED_BATCH];
+    struct iovec iov[RTP_SCHED_BATCH];
+
+    for( unsigned i = 0; i < pktc; )
+    {
+        const unsigned n = __MIN( pktc - i, RTP_SCHED_BATCH );
+
+        memset( msgv, 0, n * sizeof( *msgv ) );
+        for( unsigned j = 0; j < n; j++ )
+        {
+            iov[j].iov_base = pktv[i + j]->p_buffer;
+            iov[j].iov_len = pktv[i + j]->i_buffer;
+            msgv[j].msg_hdr.msg_iov = &iov[j];
+            msgv[j].msg_hdr.msg_iovlen = 1;
+        }
+
+        int val = sendmmsg( fd, msgv, n, 0 );
+        if( val > 0 )
+        {
+            i += val;
+            continue;
+        }
+        /* The first packet of the batch failed */
+        if( !SendError( fd, pktv[i] ) )
+            return false;
+        i++;
+    }
+#else
+    for( unsigned i = 0; i < pktc; i++ )
+        if( send( fd, pktv[i]->p_buffer, pktv[i]->i_buffer, 0 ) == -1
+         && !SendError( fd, pktv[i] ) )
+            return false;
+#endif
+    return true;
+}
@@ -34,6 +34,7 @@
 
 #include <vlc_common.h>
 #include <vlc_plugin.h>
+#include <vlc_cpu_budget.h>
 
 #include <vlc_spu.h>
 
@@ -254,6 +255,11 @@ static int Open( vlc_object_t *p_this )
     config_ChainParse( p_stream, SOUT_CFG_PREFIX, ppsz_sout_options,
                    p_stream->p_cfg );
 
+    /* The decoders and encoders inherit the priority of the transcoder, so
+     * that playback keeps the larger share of the codec thread budget */
+    var_Create( p_stream, "cpu-priority", VLC_VAR_INTEGER );
+    var_SetInteger( p_stream, "cpu-priority", VLC_CPU_PRIORITY_BACKGROUND );
+
     /* Audio transcoding parameters */
     psz_string = var_GetString( p_stream, SOUT_CFG_PREFIX "aenc" );
     p_sys->psz_aenc = NULL;
@@ -0,0 +1,704 @@
+/*****************************************************************************
+ * resize.c: separable polyphase picture resizing
+ *****************************************************************************
+ * Copyright (C) 2020 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifdef RESIZE_TEST
+# undef NDEBUG
+#endif
+
+#include <assert.h>
+#include <math.h>
+
+#include <vlc_common.h>
+#include <vlc_cpu.h>
+
+#ifdef HAVE_SSE2_INTRINSICS
+# include <emmintrin.h>
+#endif
+#ifdef HAVE_AVX2_INTRINSICS
+# include <immintrin.h>
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+# include <arm_neon.h>
+# define RESIZE_NEON 1
+#endif
+
+#include "resize.h"
+
+#define COEF_ONE (1 << RESIZE_COEF_BITS)
+#define VSHIFT   (RESIZE_COEF_BITS - RESIZE_EXTRA_BITS)
+#define VROUND   (1 << (VSHIFT - 1))
+#define HSHIFT   (RESIZE_COEF_BITS + RESIZE_EXTRA_BITS)
+#define HROUND   (1 << (HSHIFT - 1))
+
+/* Horizontal filters are padded with null coefficients to a multiple of
+ * this many taps, so that the kernels can process them in blocks. */
+#define HTAPS_ALIGN 4
+
+/*****************************************************************************
+ * Filter coefficients
+ *****************************************************************************/
+static const double radius[] = {
+    [RESIZE_BILINEAR] = 1.,
+    [RESIZE_BICUBIC]  = 2.,
+    [RESIZE_LANCZOS]  = 3.,
+};
+
+static double Kernel(enum resize_method method, double x)
+{
+    x = fabs(x);
+    switch (method)
+    {
+        case RESIZE_BILINEAR:
+            return x < 1. ? 1. - x : 0.;
+        case RESIZE_BICUBIC: /* Keys cubic convolution, a = -0.5 */
+            if (x < 1.)
+                return (1.5 * x - 2.5) * x * x + 1.;
+            if (x < 2.)
+                return ((-0.5 * x + 2.5) * x - 4.) * x + 2.;
+            return 0.;
+        case RESIZE_LANCZOS:
+            if (x < 1e-9)
+                return 1.;
+            if (x >= 3.)
+                return 0.;
+            return 3. * sin(M_PI * x) * sin(M_PI * x / 3.)
+                 / (M_PI * M_PI * x * x);
+    }
+    vlc_assert_unreachable();
+}
+
+int ResizeFilterInit(resize_filter_t *f, enum resize_method method,
+                     unsigned src_size, unsigned dst_size, unsigned align)
+{
+    assert(src_size > 0 && dst_size > 0 && align > 0);
+
+    const double scale = (double)src_size / dst_size;
+    /* When downscaling, stretch the kernel to low-pass the source */
+    const double stretch = scale > 1. ? scale : 1.;
+    const double support = radius[method] * stretch;
+    const unsigned span = 2 * lround(ceil(support));
+    const unsigned taps = span < src_size ? span : src_size;
+
+    f->size = dst_size;
+    f->taps = (taps + align - 1) / align * align;
+    f->pos = malloc(dst_size * sizeof(*f->pos));
+    f->coefs = calloc(dst_size * f->taps, sizeof(*f->coefs));
+
+    double *weights = malloc(taps * sizeof(*weights));
+    if (unlikely(f->pos == NULL || f->coefs == NULL || weights == NULL))
+    {
+        free(weights);
+        ResizeFilterClean(f);
+        return VLC_ENOMEM;
+    }
+
+    for (unsigned i = 0; i < dst_size; i++)
+    {
+        const double center = (i + .5) * scale - .5;
+        const int start = lround(floor(center - support)) + 1;
+        const int first = VLC_CLIP(start, 0, (int)(src_size - taps));
+        double total = 0.;
+
+        for (unsigned t = 0; t < taps; t++)
+            weights[t] = 0.;
+
+        /* Samples outside of the picture repeat the edges: fold their
+         * weights onto the edge samples. */
+        for (unsigned t = 0; t < span; t++)
+        {
+            const int p = start + (int)t;
+            const double w = Kernel(method, (p - center) / stretch);
+            weights[VLC_CLIP(p, 0, (int)src_size - 1) - first] += w;
+            total += w;
+        }
+
+        int16_t *coefs = &f->coefs[i * f->taps];
+        int sum = 0;
+        unsigned peak = 0;
+        for (unsigned t = 0; t < taps; t++)
+        {
+            coefs[t] = lrint(weights[t] / total * COEF_ONE);
+            sum += coefs[t];
+            if (coefs[t] > coefs[peak])
+                peak = t;
+        }
+        /* Rounding errors must not alter flat areas */
+        coefs[peak] += COEF_ONE - sum;
+        f->pos[i] = first;
+    }
+
+    free(weights);
+    return VLC_SUCCESS;
+}
+
+void ResizeFilterClean(resize_filter_t *f)
+{
+    free(f->pos);
+    free(f->coefs);
+    f->pos = NULL;
+    f->coefs = NULL;
+}
+
+/*****************************************************************************
+ * C kernels
+ *****************************************************************************/
+static inline int16_t Clip16(int v)
+{
+    return VLC_CLIP(v, INT16_MIN, INT16_MAX);
+}
+
+static void Vert8Range(int16_t *dst, const uint8_t *const *src,
+                       const int16_t *coefs, unsigned taps,
+                       unsigned x, unsigned width)
+{
+    for (; x < width; x++)
+    {
+        int sum = VROUND;
+        for (unsigned t = 0; t < taps; t++)
+            sum += src[t][x] * coefs[t];
+        dst[x] = Clip16(sum >> VSHIFT);
+    }
+}
+
+static void Vert8C(int16_t *dst, const uint8_t *const *src,
+                   const int16_t *coefs, unsigned taps, unsigned width)
+{
+    Vert8Range(dst, src, coefs, taps, 0, width);
+}
+
+static void Horiz8Range(uint8_t *dst, const int16_t *src,
+                        const resize_filter_t *f, unsigned components,
+                        unsigned x, unsigned width)
+{
+    for (; x < width; x++)
+    {
+        const int16_t *s = &src[f->pos[x] * components];
+        const int16_t *coefs = &f->coefs[x * f->taps];
+
+        for (unsigned k = 0; k < components; k++)
+        {
+            int sum = HROUND;
+            for (unsigned t = 0; t < f->taps; t++)
+                sum += s[t * components + k] * coefs[t];
+            dst[x * components + k] = VLC_CLIP(sum >> HSHIFT, 0, 255);
+        }
+    }
+}
+
+static void Horiz8C(uint8_t *dst, const int16_t *src,
+                    const resize_filter_t *f, unsigned components)
+{
+    Horiz8Range(dst, src, f, components, 0, f->size);
+}
+
+static void Vert16C(int32_t *dst, const uint16_t *const *src,
+                    const int16_t *coefs, unsigned taps, unsigned width)
+{
+    for (unsigned x = 0; x < width; x++)
+    {
+        int64_t sum = VROUND;
+        for (unsigned t = 0; t < taps; t++)
+            sum += src[t][x] * coefs[t];
+        dst[x] = sum >> VSHIFT;
+    }
+}
+
+static void Horiz16C(uint16_t *dst, const int32_t *src,
+                     const resize_filter_t *f, unsigned components,
+                     unsigned max)
+{
+    for (unsigned x = 0; x < f->size; x++)
+    {
+        const int32_t *s = &src[f->pos[x] * components];
+        const int16_t *coefs = &f->coefs[x * f->taps];
+
+        for (unsigned k = 0; k < components; k++)
+        {
+            int64_t sum = HROUND;
+            for (unsigned t = 0; t < f->taps; t++)
+                sum += (int64_t)s[t * components + k] * coefs[t];
+            sum >>= HSHIFT;
+            dst[x * components + k] = VLC_CLIP(sum, 0, (int64_t)max);
+        }
+    }
+}
+
+/*****************************************************************************
+ * SSE2 kernels
+ *****************************************************************************/
+#ifdef HAVE_SSE2_INTRINSICS
+/* Two consecutive coefficients, as expected by pmaddwd */
+# define COEF_PAIR(c0, c1) \
+    _mm_set1_epi32((uint16_t)(c0) | ((uint32_t)(uint16_t)(c1) << 16))
+
+__attribute__ ((__target__ ("sse2")))
+static void Vert8SSE2(int16_t *dst, const uint8_t *const *src,
+                      const int16_t *coefs, unsigned taps, unsigned width)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i round = _mm_set1_epi32(VROUND);
+    unsigned x = 0;
+
+    for (; x + 16 <= width; x += 16)
+    {
+        __m128i a0 = round, a1 = round, a2 = round, a3 = round;
+
+        for (unsigned t = 0; t < taps; t += 2)
+        {
+            const __m128i r0 = _mm_loadu_si128((const __m128i *)&src[t][x]);
+            __m128i r1, c;
+            if (t + 1 < taps)
+            {
+                r1 = _mm_loadu_si128((const __m128i *)&src[t + 1][x]);
+                c = COEF_PAIR(coefs[t], coefs[t + 1]);
+            }
+            else
+            {
+                r1 = zero;
+                c = COEF_PAIR(coefs[t], 0);
+            }
+
+            const __m128i l0 = _mm_unpacklo_epi8(r0, zero);
+            const __m128i l1 = _mm_unpacklo_epi8(r1, zero);
+            const __m128i h0 = _mm_unpackhi_epi8(r0, zero);
+            const __m128i h1 = _mm_unpackhi_epi8(r1, zero);
+
+            a0 = _mm_add_epi32(a0, _mm_madd_epi16(_mm_unpacklo_epi16(l0, l1), c));
+            a1 = _mm_add_epi32(a1, _mm_madd_epi16(_mm_unpackhi_epi16(l0, l1), c));
+            a2 = _mm_add_epi32(a2, _mm_madd_epi16(_mm_unpacklo_epi16(h0, h1), c));
+            a3 = _mm_add_epi32(a3, _mm_madd_epi16(_mm_unpackhi_epi16(h0, h1), c));
+        }
+
+        a0 = _mm_srai_epi32(a0, VSHIFT);
+        a1 = _mm_srai_epi32(a1, VSHIFT);
+        a2 = _mm_srai_epi32(a2, VSHIFT);
+        a3 = _mm_srai_epi32(a3, VSHIFT);
+        _mm_storeu_si128((__m128i *)&dst[x], _mm_packs_epi32(a0, a1));
+        _mm_storeu_si128((__m128i *)&dst[x + 8], _mm_packs_epi32(a2, a3));
+    }
+
+    Vert8Range(dst, src, coefs, taps, x, width);
+}
+
+__attribute__ ((__target__ ("sse2")))
+static inline void Store8x4SSE2(uint8_t *dst, __m128i sum)
+{
+    sum = _mm_srai_epi32(_mm_add_epi32(sum, _mm_set1_epi32(HROUND)), HSHIFT);
+    sum = _mm_packs_epi32(sum, sum);
+    sum = _mm_packus_epi16(sum, sum);
+
+    const uint32_t v = _mm_cvtsi128_si32(sum);
+    memcpy(dst, &v, sizeof(v));
+}
+
+/* Packed pixels with 4 components (RGBA and friends) */
+__attribute__ ((__target__ ("sse2")))
+static void Horiz8x4SSE2(uint8_t *dst, const int16_t *src,
+                         const resize_filter_t *f)
+{
+    for (unsigned x = 0; x < f->size; x++)
+    {
+        const int16_t *s = &src[f->pos[x] * 4];
+        const int16_t *coefs = &f->coefs[x * f->taps];
+        __m128i sum = _mm_setzero_si128();
+
+        for (unsigned t = 0; t < f->taps; t += 2)
+        {
+            const __m128i p0 = _mm_loadl_epi64((const __m128i *)&s[t * 4]);
+            const __m128i p1 = _mm_loadl_epi64((const __m128i *)&s[t * 4 + 4]);
+            sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_unpacklo_epi16(p0, p1),
+                                        COEF_PAIR(coefs[t], coefs[t + 1])));
+        }
+        Store8x4SSE2(&dst[x * 4], sum);
+    }
+}
+
+__attribute__ ((__target__ ("sse2")))
+static void Horiz8SSE2(uint8_t *dst, const int16_t *src,
+                       const resize_filter_t *f, unsigned components)
+{
+    if (components == 4)
+    {
+        Horiz8x4SSE2(dst, src, f);
+        return;
+    }
+    if (components != 1)
+    {
+        Horiz8C(dst, src, f, components);
+        return;
+    }
+
+    unsigned x = 0;
+    for (; x + 4 <= f->size; x += 4)
+    {
+        __m128i acc[4];
+
+        for (unsigned i = 0; i < 4; i++)
+        {
+            const int16_t *s = &src[f->pos[x + i]];
+            const int16_t *coefs = &f->coefs[(x + i) * f->taps];
+            __m128i sum = _mm_setzero_si128();
+            unsigned t = 0;
+
+            for (; t + 8 <= f->taps; t += 8)
+                sum = _mm_add_epi32(sum, _mm_madd_epi16(
+                            _mm_loadu_si128((const __m128i *)&s[t]),
+                            _mm_loadu_si128((const __m128i *)&coefs[t])));
+            if (t < f->taps)
+                sum = _mm_add_epi32(sum, _mm_madd_epi16(
+                            _mm_loadl_epi64((const __m128i *)&s[t]),
+                            _mm_loadl_epi64((const __m128i *)&coefs[t])));
+            acc[i] = sum;
+        }
+
+        /* Transpose and add the partial sums of the 4 outputs */
+        const __m128i t0 = _mm_add_epi32(_mm_unpacklo_epi32(acc[0], acc[1]),
+                                         _mm_unpackhi_epi32(acc[0], acc[1]));
+        const __m128i t1 = _mm_add_epi32(_mm_unpacklo_epi32(acc[2], acc[3]),
+                                         _mm_unpackhi_epi32(acc[2], acc[3]));
+        Store8x4SSE2(&dst[x], _mm_add_epi32(_mm_unpacklo_epi64(t0, t1),
+                                            _mm_unpackhi_epi64(t0, t1)));
+    }
+
+    Horiz8Range(dst, src, f, 1, x, f->size);
+}
+#endif
+
+/*****************************************************************************
+ * AVX2 kernels
+ *****************************************************************************/
+#ifdef HAVE_AVX2_INTRINSICS
+__attribute__ ((__target__ ("avx2")))
+static void Vert8AVX2(int16_t *dst, const uint8_t *const *src,
+                      const int16_t *coefs, unsigned taps, unsigned width)
+{
+    const __m256i round = _mm256_set1_epi32(VROUND);
+    unsigned x = 0;
+
+    for (; x + 16 <= width; x += 16)
+    {
+        __m256i lo = round, hi = round;
+
+        for (unsigned t = 0; t < taps; t += 2)
+        {
+            const __m256i r0 = _mm256_cvtepu8_epi16(
+                    _mm_loadu_si128((const __m128i *)&src[t][x]));
+            __m256i r1, c;
+            if (t + 1 < taps)
+            {
+                r1 = _mm256_cvtepu8_epi16(
+                        _mm_loadu_si128((const __m128i *)&src[t + 1][x]));
+                c = _mm256_set1_epi32((uint16_t)coefs[t]
+                                    | ((uint32_t)(uint16_t)coefs[t + 1] << 16));
+            }
+            else
+            {
+                r1 = _mm256_setzero_si256();
+                c = _mm256_set1_epi32((uint16_t)coefs[t]);
+            }
+            /* Lanes are unpacked and packed back the same way, so the
+             * pixels come out in order */
+            lo = _mm256_add_epi32(lo, _mm256_madd_epi16(_mm256_unpacklo_epi16(r0, r1), c));
+            hi = _mm256_add_epi32(hi, _mm256_madd_epi16(_mm256_unpackhi_epi16(r0, r1), c));
+        }
+
+        _mm256_storeu_si256((__m256i *)&dst[x],
+                            _mm256_packs_epi32(_mm256_srai_epi32(lo, VSHIFT),
+                                               _mm256_srai_epi32(hi, VSHIFT)));
+    }
+
+    Vert8Range(dst, src, coefs, taps, x, width);
+}
+#endif
+
+/*****************************************************************************
+ * NEON kernels
+ *****************************************************************************/
+#ifdef RESIZE_NEON
+static void Vert8NEON(int16_t *dst, const uint8_t *const *src,
+                      const int16_t *coefs, unsigned taps, unsigned width)
+{
+    unsigned x = 0;
+
+    for (; x + 8 <= width; x += 8)
+    {
+        int32x4_t lo = vdupq_n_s32(0), hi = vdupq_n_s32(0);
+
+        for (unsigned t = 0; t < taps; t++)
+        {
+            const int16x8_t p = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(&src[t][x])));
+            lo = vmlal_n_s16(lo, vget_low_s16(p), coefs[t]);
+            hi = vmlal_n_s16(hi, vget_high_s16(p), coefs[t]);
+        }
+        vst1q_s16(&dst[x], vcombine_s16(vqrshrn_n_s32(lo, VSHIFT),
+                                        vqrshrn_n_s32(hi, VSHIFT)));
+    }
+
+    Vert8Range(dst, src, coefs, taps, x, width);
+}
+
+static void Horiz8NEON(uint8_t *dst, const int16_t *src,
+                       const resize_filter_t *f, unsigned components)
+{
+    if (components != 1)
+    {
+        Horiz8C(dst, src, f, components);
+        return;
+    }
+
+    for (unsigned x = 0; x < f->size; x++)
+    {
+        const int16_t *s = &src[f->pos[x]];
+        const int16_t *coefs = &f->coefs[x * f->taps];
+        int32x4_t acc = vdupq_n_s32(0);
+
+        for (unsigned t = 0; t < f->taps; t += 4)
+            acc = vmlal_s16(acc, vld1_s16(&s[t]), vld1_s16(&coefs[t]));
+
+        int32x2_t sum = vadd_s32(vget_low_s32(acc), vget_high_s32(acc));
+        sum = vpadd_s32(sum, sum);
+        dst[x] = VLC_CLIP((vget_lane_s32(sum, 0) + HROUND) >> HSHIFT, 0, 255);
+    }
+}
+#endif
+
+void ResizeGetKernels(resize_kernels_t *k, bool optimized)
+{
+    k->vert8 = Vert8C;
+    k->horiz8 = Horiz8C;
+    k->vert16 = Vert16C;
+    k->horiz16 = Horiz16C;
+
+    if (!optimized)
+        return;
+#ifdef HAVE_SSE2_INTRINSICS
+    if (vlc_CPU_SSE2())
+    {
+        k->vert8 = Vert8SSE2;
+        k->horiz8 = Horiz8SSE2;
+    }
+#endif
+#ifdef HAVE_AVX2_INTRINSICS
+    if (vlc_CPU_AVX2())
+        k->vert8 = Vert8AVX2;
+#endif
+#ifdef RESIZE_NEON
+    k->vert8 = Vert8NEON;
+    k->horiz8 = Horiz8NEON;
+#endif
+}
+
+/*****************************************************************************
+ * Planes
+ *****************************************************************************/
+int ResizePlaneInit(resize_plane_t *p, enum resize_method method,
+                    unsigned src_width, unsigned src_height,
+                    unsigned dst_width, unsigned dst_height,
+                    unsigned components, unsigned bits)
+{
+    p->src_width = src_width;
+    p->src_height = src_height;
+    p->components = components;
+    p->bits = bits;
+
+    if (ResizeFilterInit(&p->h, method, src_width, dst_width, HTAPS_ALIGN))
+        return VLC_ENOMEM;
+    if (ResizeFilterInit(&p->v, method, src_height, dst_height, 1))
+    {
+        ResizeFilterClean(&p->h);
+        return VLC_ENOMEM;
+    }
+    return VLC_SUCCESS;
+}
+
+void ResizePlaneClean(resize_plane_t *p)
+{
+    ResizeFilterClean(&p->h);
+    ResizeFilterClean(&p->v);
+}
+
+/* Intermediate line, padded for the null horizontal taps */
+static size_t RowSamples(const resize_plane_t *p)
+{
+    return (p->src_width + HTAPS_ALIGN) * p->components;
+}
+
+size_t ResizePlaneScratchSize(const resize_plane_t *p)
+{
+    return p->v.taps * sizeof(void *)
+         + RowSamples(p) * (p->bits > 8 ? sizeof(int32_t) : sizeof(int16_t));
+}
+
+void ResizePlaneSlice(const resize_plane_t *p, const resize_kernels_t *k,
+                      uint8_t *dst, size_t dst_pitch,
+                      const uint8_t *src, size_t src_pitch,
+                      unsigned y_start, unsigned y_end, void *scratch)
+{
+    const void **rows = scratch;
+    void *line = rows + p->v.taps;
+    const unsigned width = p->src_width * p->components;
+    const unsigned pad = RowSamples(p) - width;
+
+    assert(y_end <= p->v.size);
+
+    if (p->bits <= 8)
+        memset((int16_t *)line + width, 0, pad * sizeof(int16_t));
+    else
+        memset((int32_t *)line + width, 0, pad * sizeof(int32_t));
+
+    for (unsigned y = y_start; y < y_end; y++)
+    {
+        const int16_t *coefs = &p->v.coefs[y * p->v.taps];
+
+        for (unsigned t = 0; t < p->v.taps; t++)
+            rows[t] = src + (p->v.pos[y] + t) * src_pitch;
+
+        if (p->bits <= 8)
+        {
+            k->vert8(line, (const uint8_t *const *)rows, coefs,
+                     p->v.taps, width);
+            k->horiz8(dst, line, &p->h, p->components);
+        }
+        else
+        {
+            k->vert16(line, (const uint16_t *const *)rows, coefs,
+                      p->v.taps, width);
+            k->horiz16((uint16_t *)dst, line, &p->h, p->components,
+                       (1u << p->bits) - 1);
+        }
+        dst += dst_pitch;
+    }
+}
+
+#ifdef RESIZE_TEST
+#include <stdio.h>
+#include <unistd.h>
+
+static const struct
+{
+    unsigned src_width, src_height;
+    unsigned dst_width, dst_height;
+} sizes[] = {
+    {   64,   48,  128,   96 },
+    {  360,  288,  800,  600 },
+    { 1280,  720,  212,  120 },
+    {  101,   37,   33,   99 },
+    {   17,    3,    5,    1 },
+    {    1,    1,    7,    3 },
+    {  320,  240,  320,  240 },
+};
+
+static const unsigned components[] = { 1, 3, 4 };
+static const unsigned bits[] = { 8, 10 };
+
+static void Fill(uint8_t *buf, size_t size, unsigned depth, unsigned max,
+                 int flat)
+{
+    for (size_t i = 0; i < size / depth; i++)
+    {
+        const unsigned v = flat >= 0 ? (unsigned)flat : rand() % (max + 1);
+        if (depth == 1)
+            buf[i] = v;
+        else
+            ((uint16_t *)buf)[i] = v;
+    }
+}
+
+static uint8_t *Run(const resize_plane_t *plane, const resize_kernels_t *k,
+                    const uint8_t *src, size_t src_pitch, size_t dst_pitch,
+                    unsigned dst_height)
+{
+    uint8_t *dst = malloc(dst_pitch * dst_height);
+    void *scratch = malloc(ResizePlaneScratchSize(plane));
+    assert(dst != NULL && scratch != NULL);
+
+    /* Use uneven slices, as the slice threads would */
+    const unsigned half = dst_height / 3;
+    ResizePlaneSlice(plane, k, dst, dst_pitch, src, src_pitch,
+                     0, half, scratch);
+    ResizePlaneSlice(plane, k, dst + half * dst_pitch, dst_pitch,
+                     src, src_pitch, half, dst_height, scratch);
+    free(scratch);
+    return dst;
+}
+
+int main(void)
+{
+    resize_kernels_t ref, opt;
+
+    alarm(20);
+    ResizeGetKernels(&ref, false);
+    ResizeGetKernels(&opt, true);
+
+    for (int method = RESIZE_BILINEAR; method <= RESIZE_LANCZOS; method++)
+    for (size_t i = 0; i < ARRAY_SIZE(sizes); i++)
+    for (size_t c = 0; c < ARRAY_SIZE(components); c++)
+    for (size_t b = 0; b < ARRAY_SIZE(bits); b++)
+    {
+        const unsigned depth = bits[b] > 8 ? 2 : 1;
+        const unsigned max = (1u << bits[b]) - 1;
+        const size_t src_pitch = sizes[i].src_width * components[c] * depth;
+        const size_t dst_pitch = sizes[i].dst_width * components[c] * depth;
+        const size_t src_size = src_pitch * sizes[i].src_height;
+        const size_t dst_size = dst_pitch * sizes[i].dst_height;
+        resize_plane_t plane;
+
+        int ret = ResizePlaneInit(&plane, method,
+                                  sizes[i].src_width, sizes[i].src_height,
+                                  sizes[i].dst_width, sizes[i].dst_height,
+                                  components[c], bits[b]);
+        assert(ret == VLC_SUCCESS);
+
+        uint8_t *src = malloc(src_size);
+        assert(src != NULL);
+
+        /* Optimized kernels must be bit exact */
+        Fill(src, src_size, depth, max, -1);
+        uint8_t *a = Run(&plane, &ref, src, src_pitch, dst_pitch,
+                         sizes[i].dst_height);
+        uint8_t *o = Run(&plane, &opt, src, src_pitch, dst_pitch,
+                         sizes[i].dst_height);
+        assert(memcmp(a, o, dst_size) == 0);
+
+        /* Same size must be lossless */
+        if (sizes[i].src_width == sizes[i].dst_width
+         && sizes[i].src_height == sizes[i].dst_height)
+            assert(memcmp(a, src, src_size) == 0);
+        free(o);
+        free(a);
+
+        /* Flat areas must stay flat */
+        Fill(src, src_size, depth, max, max / 3);
+        o = Run(&plane, &opt, src, src_pitch, dst_pitch, sizes[i].dst_height);
+        for (size_t j = 0; j < dst_size / depth; j++)
+            assert((depth == 1 ? o[j] : ((uint16_t *)o)[j]) == max / 3);
+        free(o);
+
+        free(src);
+        ResizePlaneClean(&plane);
+    }
+
+    return 0;
+}
+#endif
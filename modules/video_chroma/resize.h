@@ -0,0 +1,103 @@
+/*****************************************************************************
+ * resize.h: separable polyphase picture resizing
+ *****************************************************************************
+ * Copyright (C) 2020 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef VLC_VIDEOCHROMA_RESIZE_H_
+#define VLC_VIDEOCHROMA_RESIZE_H_
+
+/* Coefficients are signed 2.14 fixed point numbers. The intermediate rows
+ * between the vertical and the horizontal pass keep RESIZE_EXTRA_BITS of
+ * extra precision. */
+#define RESIZE_COEF_BITS  14
+#define RESIZE_EXTRA_BITS 6
+
+enum resize_method
+{
+    RESIZE_BILINEAR,
+    RESIZE_BICUBIC,
+    RESIZE_LANCZOS,
+};
+
+/* One dimensional filter: output sample i is the sum of taps input samples
+ * starting at pos[i], weighted by coefs[i * taps]. */
+typedef struct
+{
+    unsigned size;
+    unsigned taps;
+    int32_t *pos;
+    int16_t *coefs;
+} resize_filter_t;
+
+typedef struct
+{
+    /* 8-bits samples */
+    void (*vert8)(int16_t *dst, const uint8_t *const *src,
+                  const int16_t *coefs, unsigned taps, unsigned width);
+    void (*horiz8)(uint8_t *dst, const int16_t *src,
+                   const resize_filter_t *, unsigned components);
+    /* 9 to 16-bits samples */
+    void (*vert16)(int32_t *dst, const uint16_t *const *src,
+                   const int16_t *coefs, unsigned taps, unsigned width);
+    void (*horiz16)(uint16_t *dst, const int32_t *src,
+                    const resize_filter_t *, unsigned components,
+                    unsigned max);
+} resize_kernels_t;
+
+/* A plane of interleaved components with identical sample sizes */
+typedef struct
+{
+    resize_filter_t h;
+    resize_filter_t v;
+    unsigned src_width;
+    unsigned src_height;
+    unsigned components;
+    unsigned bits;
+} resize_plane_t;
+
+int  ResizeFilterInit(resize_filter_t *, enum resize_method,
+                      unsigned src_size, unsigned dst_size, unsigned align);
+void ResizeFilterClean(resize_filter_t *);
+
+/**
+ * Selects the kernels for the running CPU. Optimizations can be turned off
+ * to get the reference C implementation.
+ */
+void ResizeGetKernels(resize_kernels_t *, bool optimized);
+
+int  ResizePlaneInit(resize_plane_t *, enum resize_method,
+                     unsigned src_width, unsigned src_height,
+                     unsigned dst_width, unsigned dst_height,
+                     unsigned components, unsigned bits);
+void ResizePlaneClean(resize_plane_t *);
+
+/**
+ * Returns the size of the scratch buffer ResizePlaneSlice() needs.
+ * Each concurrent caller needs its own scratch buffer.
+ */
+size_t ResizePlaneScratchSize(const resize_plane_t *);
+
+/**
+ * Computes the output lines [y_start, y_end) of a plane.
+ */
+void ResizePlaneSlice(const resize_plane_t *, const resize_kernels_t *,
+                      uint8_t *dst, size_t dst_pitch,
+                      const uint8_t *src, size_t src_pitch,
+                      unsigned y_start, unsigned y_end, void *scratch);
+
+#endif
@@ -0,0 +1,426 @@
+/*****************************************************************************
+ * scaler.c: native slice-threaded video scaling filter
+ *****************************************************************************
+ * Copyright (C) 2020 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*****************************************************************************
+ * Preamble
+ *****************************************************************************/
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <assert.h>
+#include <limits.h>
+
+#include <vlc_common.h>
+#include <vlc_plugin.h>
+#include <vlc_filter.h>
+#include <vlc_picture.h>
+
+#include "resize.h"
+
+/*****************************************************************************
+ * Module descriptor
+ *****************************************************************************/
+static int  Open ( vlc_object_t * );
+static void Close( vlc_object_t * );
+
+#define METHOD_TEXT N_("Scaling method")
+#define METHOD_LONGTEXT N_("Interpolation used to resample the pictures.")
+
+#define THREADS_TEXT N_("Threads")
+#define THREADS_LONGTEXT N_("Number of threads used to scale each picture " \
+    "(0 = one per CPU).")
+
+static const int pi_method_values[] = {
+    RESIZE_BILINEAR, RESIZE_BICUBIC, RESIZE_LANCZOS };
+static const char *const ppsz_method_descriptions[] = {
+    N_("Bilinear"), N_("Bicubic"), N_("Lanczos") };
+
+/* Do not bother waking threads up for less lines than that */
+#define MIN_SLICE_LINES 16
+#define MAX_THREADS     16
+
+vlc_module_begin ()
+    set_description( N_("Native video scaling filter") )
+    set_shortname( N_("Scaler") )
+    set_capability( "video converter", 110 )
+    set_category( CAT_VIDEO )
+    set_subcategory( SUBCAT_VIDEO_VFILTER )
+    set_callbacks( Open, Close )
+    add_integer( "scaler-method", RESIZE_BICUBIC, METHOD_TEXT,
+                 METHOD_LONGTEXT, true )
+        change_integer_list( pi_method_values, ppsz_method_descriptions )
+    add_integer_with_range( "scaler-threads", 0, 0, MAX_THREADS,
+                            THREADS_TEXT, THREADS_LONGTEXT, true )
+vlc_module_end ()
+
+/*****************************************************************************
+ * Local prototypes
+ *****************************************************************************/
+typedef struct
+{
+    vlc_fourcc_t i_chroma;
+    unsigned     i_components;
+} scaler_chroma_t;
+
+#ifdef WORDS_BIGENDIAN
+# define NE(l, b) b
+#else
+# define NE(l, b) l
+#endif
+
+static const scaler_chroma_t p_chromas[] =
+{
+    { VLC_CODEC_I410, 1 }, { VLC_CODEC_I411, 1 },
+    { VLC_CODEC_I420, 1 }, { VLC_CODEC_J420, 1 }, { VLC_CODEC_YV12, 1 },
+    { VLC_CODEC_I422, 1 }, { VLC_CODEC_J422, 1 },
+    { VLC_CODEC_I440, 1 }, { VLC_CODEC_J440, 1 },
+    { VLC_CODEC_I444, 1 }, { VLC_CODEC_J444, 1 },
+    { VLC_CODEC_YUVA, 1 }, { VLC_CODEC_YUV420A, 1 }, { VLC_CODEC_YUV422A, 1 },
+    { VLC_CODEC_GREY, 1 }, { VLC_CODEC_GBR_PLANAR, 1 },
+
+    { NE(VLC_CODEC_I420_9L,  VLC_CODEC_I420_9B),  1 },
+    { NE(VLC_CODEC_I420_10L, VLC_CODEC_I420_10B), 1 },
+    { NE(VLC_CODEC_I420_12L, VLC_CODEC_I420_12B), 1 },
+    { NE(VLC_CODEC_I420_16L, VLC_CODEC_I420_16B), 1 },
+    { NE(VLC_CODEC_I422_9L,  VLC_CODEC_I422_9B),  1 },
+    { NE(VLC_CODEC_I422_10L, VLC_CODEC_I422_10B), 1 },
+    { NE(VLC_CODEC_I422_12L, VLC_CODEC_I422_12B), 1 },
+    { NE(VLC_CODEC_I444_9L,  VLC_CODEC_I444_9B),  1 },
+    { NE(VLC_CODEC_I444_10L, VLC_CODEC_I444_10B), 1 },
+    { NE(VLC_CODEC_I444_12L, VLC_CODEC_I444_12B), 1 },
+    { NE(VLC_CODEC_I444_16L, VLC_CODEC_I444_16B), 1 },
+    { NE(VLC_CODEC_YUVA_444_10L, VLC_CODEC_YUVA_444_10B), 1 },
+
+    { VLC_CODEC_RGB24, 3 },
+    { VLC_CODEC_RGB32, 4 }, { VLC_CODEC_RGBA, 4 }, { VLC_CODEC_ARGB, 4 },
+    { VLC_CODEC_BGRA, 4 },  { VLC_CODEC_VUYA, 4 },
+};
+
+typedef struct
+{
+    resize_plane_t plane;
+    unsigned i_x_num, i_x_den;
+    unsigned i_y_num, i_y_den;
+} scaler_plane_t;
+
+typedef struct
+{
+    filter_sys_t *p_sys;
+    unsigned      i_index;
+    vlc_thread_t  thread;
+} scaler_worker_t;
+
+struct filter_sys_t
+{
+    scaler_plane_t   planes[PICTURE_PLANE_MAX];
+    unsigned         i_planes;
+    unsigned         i_pixel_size;
+    resize_kernels_t kernels;
+
+    /* Slices: the first one is computed by the calling thread */
+    unsigned         i_slices;
+    void            *pp_scratch[MAX_THREADS];
+    scaler_worker_t  workers[MAX_THREADS - 1];
+
+    vlc_mutex_t      lock;
+    vlc_cond_t       wait;
+    vlc_cond_t       done;
+    unsigned         i_generation;
+    unsigned         i_pending;
+    bool             b_quit;
+    const picture_t *p_src;
+    picture_t       *p_dst;
+};
+
+static picture_t *Filter( filter_t *, picture_t * );
+static void ScaleSlice( filter_sys_t *, unsigned );
+
+/*****************************************************************************
+ * Slice threads
+ *****************************************************************************/
+static void *Worker( void *data )
+{
+    scaler_worker_t *p_worker = data;
+    filter_sys_t *p_sys = p_worker->p_sys;
+    unsigned i_generation = 0;
+
+    vlc_mutex_lock( &p_sys->lock );
+    for( ;; )
+    {
+        while( !p_sys->b_quit && p_sys->i_generation == i_generation )
+            vlc_cond_wait( &p_sys->wait, &p_sys->lock );
+        if( p_sys->b_quit )
+            break;
+        i_generation = p_sys->i_generation;
+        vlc_mutex_unlock( &p_sys->lock );
+
+        ScaleSlice( p_sys, p_worker->i_index );
+
+        vlc_mutex_lock( &p_sys->lock );
+        if( --p_sys->i_pending == 0 )
+            vlc_cond_signal( &p_sys->done );
+    }
+    vlc_mutex_unlock( &p_sys->lock );
+    return NULL;
+}
+
+static void StopWorkers( filter_sys_t *p_sys, unsigned i_count )
+{
+    vlc_mutex_lock( &p_sys->lock );
+    p_sys->b_quit = true;
+    vlc_cond_broadcast( &p_sys->wait );
+    vlc_mutex_unlock( &p_sys->lock );
+
+    for( unsigned i = 0; i < i_count; i++ )
+        vlc_join( p_sys->workers[i].thread, NULL );
+}
+
+/*****************************************************************************
+ * Scaling
+ *****************************************************************************/
+static const uint8_t *PlanePixels( const plane_t *p, const video_format_t *fmt,
+                                   const scaler_plane_t *sp, unsigned i_pixel_size )
+{
+    return p->p_pixels
+        + (fmt->i_x_offset * sp->i_x_num / sp->i_x_den) * i_pixel_size
+        + (fmt->i_y_offset * sp->i_y_num / sp->i_y_den) * p->i_pitch;
+}
+
+static void ScaleSlice( filter_sys_t *p_sys, unsigned i_slice )
+{
+    const picture_t *p_src = p_sys->p_src;
+    picture_t *p_dst = p_sys->p_dst;
+
+    for( unsigned i = 0; i < p_sys->i_planes; i++ )
+    {
+        const scaler_plane_t *sp = &p_sys->planes[i];
+        const unsigned i_lines = sp->plane.v.size;
+        const unsigned i_start = i_lines * i_slice / p_sys->i_slices;
+        const unsigned i_end = i_lines * (i_slice + 1) / p_sys->i_slices;
+        const uint8_t *p_in = PlanePixels( &p_src->p[i], &p_src->format, sp,
+                                           p_sys->i_pixel_size );
+        uint8_t *p_out = (uint8_t *)PlanePixels( &p_dst->p[i], &p_dst->format,
+                                                 sp, p_sys->i_pixel_size );
+
+        ResizePlaneSlice( &sp->plane, &p_sys->kernels,
+                          p_out + i_start * p_dst->p[i].i_pitch,
+                          p_dst->p[i].i_pitch,
+                          p_in, p_src->p[i].i_pitch,
+                          i_start, i_end, p_sys->pp_scratch[i_slice] );
+    }
+}
+
+/*****************************************************************************
+ * Open: probe the filter and return score
+ *****************************************************************************/
+static int Open( vlc_object_t *p_this )
+{
+    filter_t *p_filter = (filter_t *)p_this;
+    const video_format_t *p_fmti = &p_filter->fmt_in.video;
+    const video_format_t *p_fmto = &p_filter->fmt_out.video;
+    const scaler_chroma_t *p_chroma = NULL;
+
+    if( p_fmti->i_chroma != p_fmto->i_chroma ||
+        p_fmti->orientation != p_fmto->orientation )
+        return VLC_EGENERIC;
+
+    for( size_t i = 0; i < ARRAY_SIZE(p_chromas); i++ )
+        if( p_chromas[i].i_chroma == p_fmti->i_chroma )
+            p_chroma = &p_chromas[i];
+    if( p_chroma == NULL )
+        return VLC_EGENERIC;
+
+    if( p_fmti->i_visible_width == 0 || p_fmti->i_visible_height == 0 ||
+        p_fmto->i_visible_width == 0 || p_fmto->i_visible_height == 0 )
+        return VLC_EGENERIC;
+
+    const vlc_chroma_description_t *p_dsc =
+        vlc_fourcc_GetChromaDescription( p_fmti->i_chroma );
+    if( p_dsc == NULL || p_dsc->plane_count == 0 )
+        return VLC_EGENERIC;
+
+    filter_sys_t *p_sys = calloc( 1, sizeof(*p_sys) );
+    if( unlikely(p_sys == NULL) )
+        return VLC_ENOMEM;
+
+    const int i_method = var_InheritInteger( p_filter, "scaler-method" );
+    const enum resize_method method =
+        i_method == RESIZE_BILINEAR ? RESIZE_BILINEAR :
+        i_method == RESIZE_LANCZOS ? RESIZE_LANCZOS : RESIZE_BICUBIC;
+    const unsigned i_components = p_chroma->i_components;
+    const unsigned i_bits = i_components > 1 ? 8 : p_dsc->pixel_bits;
+
+    p_sys->i_pixel_size = p_dsc->pixel_size;
+    ResizeGetKernels( &p_sys->kernels, true );
+
+    int i_ret = VLC_EGENERIC;
+    size_t i_scratch = 0;
+    unsigned i_min_lines = UINT_MAX;
+    for( ; p_sys->i_planes < p_dsc->plane_count; p_sys->i_planes++ )
+    {
+        scaler_plane_t *sp = &p_sys->planes[p_sys->i_planes];
+        const unsigned i = p_sys->i_planes;
+
+        sp->i_x_num = p_dsc->p[i].w.num;
+        sp->i_x_den = p_dsc->p[i].w.den;
+        sp->i_y_num = p_dsc->p[i].h.num;
+        sp->i_y_den = p_dsc->p[i].h.den;
+
+#define PLANE_SIZE(v, n, d) (((v) * (n) + (d) - 1) / (d))
+        const unsigned i_src_width = PLANE_SIZE( p_fmti->i_visible_width,
+                                                 sp->i_x_num, sp->i_x_den );
+        const unsigned i_src_height = PLANE_SIZE( p_fmti->i_visible_height,
+                                                  sp->i_y_num, sp->i_y_den );
+        const unsigned i_dst_width = PLANE_SIZE( p_fmto->i_visible_width,
+                                                 sp->i_x_num, sp->i_x_den );
+        const unsigned i_dst_height = PLANE_SIZE( p_fmto->i_visible_height,
+                                                  sp->i_y_num, sp->i_y_den );
+#undef PLANE_SIZE
+
+        if( ResizePlaneInit( &sp->plane, method, i_src_width, i_src_height,
+                             i_dst_width, i_dst_height, i_components, i_bits ) )
+            goto error;
+
+        i_scratch = __MAX( i_scratch, ResizePlaneScratchSize( &sp->plane ) );
+        i_min_lines = __MIN( i_min_lines, i_dst_height );
+    }
+
+    /* Slices */
+    unsigned i_threads = var_InheritInteger( p_filter, "scaler-threads" );
+    if( i_threads == 0 )
+        i_threads = vlc_GetCPUCount();
+    i_threads = VLC_CLIP( i_threads, 1, MAX_THREADS );
+    p_sys->i_slices = VLC_CLIP( i_min_lines / MIN_SLICE_LINES, 1, i_threads );
+
+    i_ret = VLC_ENOMEM;
+    for( unsigned i = 0; i < p_sys->i_slices; i++ )
+    {
+        p_sys->pp_scratch[i] = malloc( i_scratch );
+        if( unlikely(p_sys->pp_scratch[i] == NULL) )
+            goto error;
+    }
+
+    vlc_mutex_init( &p_sys->lock );
+    vlc_cond_init( &p_sys->wait );
+    vlc_cond_init( &p_sys->done );
+
+    for( unsigned i = 1; i < p_sys->i_slices; i++ )
+    {
+        scaler_worker_t *p_worker = &p_sys->workers[i - 1];
+
+        p_worker->p_sys = p_sys;
+        p_worker->i_index = i;
+        if( vlc_clone( &p_worker->thread, Worker, p_worker,
+                       VLC_THREAD_PRIORITY_VIDEO ) )
+        {
+            msg_Warn( p_filter, "cannot start slice thread" );
+            StopWorkers( p_sys, i - 1 );
+            p_sys->b_quit = false;
+            /* Fall back to as many slices as running threads */
+            for( unsigned j = i; j < p_sys->i_slices; j++ )
+            {
+                free( p_sys->pp_scratch[j] );
+                p_sys->pp_scratch[j] = NULL;
+            }
+            p_sys->i_slices = i;
+            break;
+        }
+    }
+
+    p_filter->p_sys = p_sys;
+    p_filter->pf_video_filter = Filter;
+
+    msg_Dbg( p_filter, "%ux%u -> %ux%u chroma: %4.4s using %s, %u slice(s)",
+             p_fmti->i_visible_width, p_fmti->i_visible_height,
+             p_fmto->i_visible_width, p_fmto->i_visible_height,
+             (const char *)&p_fmti->i_chroma,
+             ppsz_method_descriptions[method], p_sys->i_slices );
+    return VLC_SUCCESS;
+
+error:
+    for( unsigned i = 0; i < p_sys->i_planes; i++ )
+        ResizePlaneClean( &p_sys->planes[i].plane );
+    for( unsigned i = 0; i < MAX_THREADS; i++ )
+        free( p_sys->pp_scratch[i] );
+    free( p_sys );
+    return i_ret;
+}
+
+/*****************************************************************************
+ * Close: clean up the filter
+ *****************************************************************************/
+static void Close( vlc_object_t *p_this )
+{
+    filter_t *p_filter = (filter_t *)p_this;
+    filter_sys_t *p_sys = p_filter->p_sys;
+
+    StopWorkers( p_sys, p_sys->i_slices - 1 );
+    vlc_cond_destroy( &p_sys->done );
+    vlc_cond_destroy( &p_sys->wait );
+    vlc_mutex_destroy( &p_sys->lock );
+
+    for( unsigned i = 0; i < p_sys->i_planes; i++ )
+        ResizePlaneClean( &p_sys->planes[i].plane );
+    for( unsigned i = 0; i < p_sys->i_slices; i++ )
+        free( p_sys->pp_scratch[i] );
+    free( p_sys );
+}
+
+/****************************************************************************
+ * Filter: the whole thing
+ ****************************************************************************/
+static picture_t *Filter( filter_t *p_filter, picture_t *p_pic )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+
+    picture_t *p_pic_dst = filter_NewPicture( p_filter );
+    if( !p_pic_dst )
+    {
+        picture_Release( p_pic );
+        return NULL;
+    }
+
+    p_sys->p_src = p_pic;
+    p_sys->p_dst = p_pic_dst;
+
+    if( p_sys->i_slices > 1 )
+    {
+        vlc_mutex_lock( &p_sys->lock );
+        p_sys->i_pending = p_sys->i_slices - 1;
+        p_sys->i_generation++;
+        vlc_cond_broadcast( &p_sys->wait );
+        vlc_mutex_unlock( &p_sys->lock );
+    }
+
+    ScaleSlice( p_sys, 0 );
+
+    if( p_sys->i_slices > 1 )
+    {
+        vlc_mutex_lock( &p_sys->lock );
+        while( p_sys->i_pending > 0 )
+            vlc_cond_wait( &p_sys->done, &p_sys->lock );
+        vlc_mutex_unlock( &p_sys->lock );
+    }
+
+    picture_CopyProperties( p_pic_dst, p_pic );
+    picture_Release( p_pic );
+    return p_pic_dst;
+}
@@ -225,6 +225,136 @@ static void Destroy( vlc_object_t *p_this )
     free( p_sys );
 }
 
+/*****************************************************************************
+ * Slices of a planar YUV picture
+ *****************************************************************************/
+struct adjust_planar
+{
+    picture_t *p_pic;
+    picture_t *p_outpic;
+    const int *pi_luma;
+    bool b_16bit;
+    int (*pf_process_sat_hue)( picture_t *, picture_t *, int, int, int, int, int );
+    int i_sin, i_cos, i_sat, i_x, i_y;
+};
+
+/* View of the lines of a slice of a plane */
+static plane_t SlicePlane( const plane_t *p_plane, const filter_slice_t *p_slice )
+{
+    plane_t view = *p_plane;
+
+    view.p_pixels += p_slice->i_start * p_plane->i_pitch;
+    view.i_lines = view.i_visible_lines = p_slice->i_end - p_slice->i_start;
+    return view;
+}
+
+static void PlanarLuma( const plane_t *p_in_plane, plane_t *p_out_plane,
+                        const int *pi_luma, bool b_16bit )
+{
+    if ( b_16bit )
+    {
+        uint16_t *p_in, *p_in_end, *p_line_end;
+        uint16_t *p_out;
+        p_in = (uint16_t *) p_in_plane->p_pixels;
+        p_in_end = p_in + p_in_plane->i_visible_lines
+            * (p_in_plane->i_pitch >> 1) - 8;
+
+        p_out = (uint16_t *) p_out_plane->p_pixels;
+
+        for( ; p_in < p_in_end ; )
+        {
+            p_line_end = p_in + (p_in_plane->i_visible_pitch >> 1) - 8;
+
+            for( ; p_in < p_line_end ; )
+            {
+                /* Do 8 pixels at a time */
+                *p_out++ = pi_luma[ *p_in++ ]; *p_out++ = pi_luma[ *p_in++ ];
+                *p_out++ = pi_luma[ *p_in++ ]; *p_out++ = pi_luma[ *p_in++ ];
+                *p_out++ = pi_luma[ *p_in++ ]; *p_out++ = pi_luma[ *p_in++ ];
+                *p_out++ = pi_luma[ *p_in++ ]; *p_out++ = pi_luma[ *p_in++ ];
+            }
+
+            p_line_end += 8;
+
+            for( ; p_in < p_line_end ; )
+            {
+                *p_out++ = pi_luma[ *p_in++ ];
+            }
+
+            p_in += (p_in_plane->i_pitch >> 1)
+                - (p_in_plane->i_visible_pitch >> 1);
+            p_out += (p_out_plane->i_pitch >> 1)
+                - (p_out_plane->i_visible_pitch >> 1);
+        }
+    }
+    else
+    {
+        uint8_t *p_in, *p_in_end, *p_line_end;
+        uint8_t *p_out;
+        p_in = p_in_plane->p_pixels;
+        p_in_end = p_in + p_in_plane->i_visible_lines
+                 * p_in_plane->i_pitch - 8;
+
+        p_out = p_out_plane->p_pixels;
+
+        for( ; p_in < p_in_end ; )
+        {
+            p_line_end = p_in + p_in_plane->i_visible_pitch - 8;
+
+            for( ; p_in < p_line_end ; )
+            {
+                /* Do 8 pixels at a time */
+                *p_out++ = pi_luma[ *p_in++ ]; *p_out++ = pi_luma[ *p_in++ ];
+                *p_out++ = pi_luma[ *p_in++ ]; *p_out++ = pi_luma[ *p_in++ ];
+                *p_out++ = pi_luma[ *p_in++ ]; *p_out++ = pi_luma[ *p_in++ ];
+                *p_out++ = pi_luma[ *p_in++ ]; *p_out++ = pi_luma[ *p_in++ ];
+            }
+
+            p_line_end += 8;
+
+            for( ; p_in < p_line_end ; )
+            {
+                *p_out++ = pi_luma[ *p_in++ ];
+            }
+
+            p_in += p_in_plane->i_pitch
+                  - p_in_plane->i_visible_pitch;
+            p_out += p_out_plane->i_pitch
+                   - p_out_plane->i_visible_pitch;
+        }
+    }
+}
+
+static void PlanarSlice( filter_t *p_filter, const filter_slice_t *p_slice,
+                         void *p_data )
+{
+    const struct adjust_planar *p_adj = p_data;
+    VLC_UNUSED(p_filter);
+
+    if( p_slice->i_plane == Y_PLANE )
+    {
+        plane_t in = SlicePlane( &p_adj->p_pic->p[Y_PLANE], p_slice );
+        plane_t out = SlicePlane( &p_adj->p_outpic->p[Y_PLANE], p_slice );
+
+        PlanarLuma( &in, &out, p_adj->pi_luma, p_adj->b_16bit );
+    }
+    else
+    {
+        /* Both chroma planes are done with the slices of the first one */
+        picture_t in = { .format = p_adj->p_pic->format };
+        picture_t out = { .format = p_adj->p_outpic->format };
+
+        in.p[U_PLANE] = SlicePlane( &p_adj->p_pic->p[U_PLANE], p_slice );
+        in.p[V_PLANE] = SlicePlane( &p_adj->p_pic->p[V_PLANE], p_slice );
+        out.p[U_PLANE] = SlicePlane( &p_adj->p_outpic->p[U_PLANE], p_slice );
+        out.p[V_PLANE] = SlicePlane( &p_adj->p_outpic->p[V_PLANE], p_slice );
+        /* Currently no errors are implemented in the function, if any are added
+         * check them here */
+        p_adj->pf_process_sat_hue( &in, &out, p_adj->i_sin, p_adj->i_cos,
+                                   p_adj->i_sat, p_adj->i_x, p_adj->i_y );
+    }
+}
+
 /*****************************************************************************
  * Run the filter on a Planar YUV picture
  *****************************************************************************/
@@ -317,83 +447,7 @@ static picture_t *FilterPlanar( filter_t *p_filter, picture_t *p_pic )
     }
 
     /*
-     * Do the Y plane
-     */
-    if ( b_16bit )
-    {
-        uint16_t *p_in, *p_in_end, *p_line_end;
-        uint16_t *p_out;
-        p_in = (uint16_t *) p_pic->p[Y_PLANE].p_pixels;
-        p_in_end = p_in + p_pic->p[Y_PLANE].i_visible_lines
-            * (p_pic->p[Y_PLANE].i_pitch >> 1) - 8;
-
-        p_out = (uint16_t *) p_outpic->p[Y_PLANE].p_pixels;
-
-        for( ; p_in < p_in_end ; )
-        {
-            p_line_end = p_in + (p_pic->p[Y_PLANE].i_visible_pitch >> 1) - 8;
-
-            for( ; p_in < p_line_end ; )
-            {
-                /* Do 8 pixels at a time */
-                *p_out++ = pi_luma[ *p_in++ ]; *p_out++ = pi_luma[ *p_in++ ];
-                *p_out++ = pi_luma[ *p_in++ ]; *p_out++ = pi_luma[ *p_in++ ];
-                *p_out++ = pi_luma[ *p_in++ ]; *p_out++ = pi_luma[ *p_in++ ];
-                *p_out++ = pi_luma[ *p_in++ ]; *p_out++ = pi_luma[ *p_in++ ];
-            }
-
-            p_line_end += 8;
-
-            for( ; p_in < p_line_end ; )
-            {
-                *p_out++ = pi_luma[ *p_in++ ];
-            }
-
-            p_in += (p_pic->p[Y_PLANE].i_pitch >> 1)
-                - (p_pic->p[Y_PLANE].i_visible_pitch >> 1);
-            p_out += (p_outpic->p[Y_PLANE].i_pitch >> 1)
-                - (p_outpic->p[Y_PLANE].i_visible_pitch >> 1);
-        }
-    }
-    else
-    {
-        uint8_t *p_in, *p_in_end, *p_line_end;
-        uint8_t *p_out;
-        p_in = p_pic->p[Y_PLANE].p_pixels;
-        p_in_end = p_in + p_pic->p[Y_PLANE].i_visible_lines
-                 * p_pic->p[Y_PLANE].i_pitch - 8;
-
-        p_out = p_outpic->p[Y_PLANE].p_pixels;
-
-        for( ; p_in < p_in_end ; )
-        {
-            p_line_end = p_in + p_pic->p[Y_PLANE].i_visible_pitch - 8;
-
-            for( ; p_in < p_line_end ; )
-            {
-                /* Do 8 pixels at a time */
-                *p_out++ = pi_luma[ *p_in++ ]; *p_out++ = pi_luma[ *p_in++ ];
-                *p_out++ = pi_luma[ *p_in++ ]; *p_out++ = pi_luma[ *p_in++ ];
-                *p_out++ = pi_luma[ *p_in++ ]; *p_out++ = pi_luma[ *p_in++ ];
-                *p_out++ = pi_luma[ *p_in++ ]; *p_out++ = pi_luma[ *p_in++ ];
-            }
-
-            p_line_end += 8;
-
-            for( ; p_in < p_line_end ; )
-            {
-                *p_out++ = pi_luma[ *p_in++ ];
-            }
-
-            p_in += p_pic->p[Y_PLANE].i_pitch
-                  - p_pic->p[Y_PLANE].i_visible_pitch;
-            p_out += p_outpic->p[Y_PLANE].i_pitch
-                   - p_outpic->p[Y_PLANE].i_visible_pitch;
-        }
-    }
-
-    /*
-     * Do the U and V planes
+     * Hue and saturation of the U and V planes
      */
 
     int i_sin = sinf(f_hue) * f_max;
@@ -403,20 +457,18 @@ static picture_t *FilterPlanar( filter_t *p_filter, picture_t *p_pic )
     int i_x = ( cosf(f_hue) + sinf(f_hue) ) * f_range * i_mid;
     int i_y = ( cosf(f_hue) - sinf(f_hue) ) * f_range * i_mid;
 
-    if ( i_sat > i_range )
-    {
-        /* Currently no errors are implemented in the function, if any are added
-         * check them here */
-        p_sys->pf_process_sat_hue_clip( p_pic, p_outpic, i_sin, i_cos, i_sat,
-                                        i_x, i_y );
-    }
-    else
-    {
-        /* Currently no errors are implemented in the function, if any are added
-         * check them here */
-        p_sys->pf_process_sat_hue( p_pic, p_outpic, i_sin, i_cos, i_sat,
-                                        i_x, i_y );
-    }
+    struct adjust_planar adj = {
+        .p_pic = p_pic,
+        .p_outpic = p_outpic,
+        .pi_luma = pi_luma,
+        .b_16bit = b_16bit,
+        .pf_process_sat_hue = i_sat > i_range ? p_sys->pf_process_sat_hue_clip
+                                              : p_sys->pf_process_sat_hue,
+        .i_sin = i_sin, .i_cos = i_cos, .i_sat = i_sat, .i_x = i_x, .i_y = i_y,
+    };
+
+    /* Do the Y plane, and the U and V planes together */
+    filter_ExecuteSlices( p_filter, p_pic, 2, 0, PlanarSlice, &adj );
 
     return CopyInfoAndRelease( p_outpic, p_pic );
 }
@@ -32,8 +32,20 @@
 #include <vlc_plugin.h>
 #include <vlc_filter.h>
 #include <vlc_picture.h>
+#include <vlc_cpu.h>
 #include "filter_picture.h"
 
+#ifdef HAVE_SSE2_INTRINSICS
+# include <emmintrin.h>
+#endif
+#ifdef HAVE_AVX2_INTRINSICS
+# include <immintrin.h>
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+# include <arm_neon.h>
+# define BLEND_NEON 1
+#endif
+
 /*****************************************************************************
  * Module descriptor
  *****************************************************************************/
@@ -551,6 +563,529 @@ void Blend(const CPicture &dst_data, const CPicture &src_data,
 typedef void (*blend_function_t)(const CPicture &dst_data, const CPicture &src_data,
                                  unsigned width, unsigned height, int alpha);
 
+/*****************************************************************************
+ * Fast paths
+ *****************************************************************************
+ * 8-bits YUVA onto 4:2:0 pictures and RGBA onto 32-bits RGB are by far the
+ * most common cases (subtitles, OSD, logos). They are blended a line at a
+ * time, with the same arithmetic as the generic functors above, so that the
+ * results are identical.
+ *****************************************************************************/
+
+/* The RGB offsets of a 32-bits RGB destination */
+struct rgb_layout {
+    unsigned r, g, b;
+};
+
+struct blend_kernels_t {
+    /* dst[i] over src[i] with alpha srca[i] */
+    void (*plane)(uint8_t *dst, const uint8_t *src, const uint8_t *srca,
+                  unsigned count, unsigned alpha);
+    /* dst[i] over src[2 * i] with alpha srca[2 * i] (subsampled chroma) */
+    void (*sub2)(uint8_t *dst, const uint8_t *src, const uint8_t *srca,
+                 unsigned count, unsigned alpha);
+    /* interleaved dst[2 * i] and dst[2 * i + 1] over srcu[2 * i] and
+     * srcv[2 * i] with alpha srca[2 * i] (semi-planar chroma) */
+    void (*semiplanar)(uint8_t *dst, const uint8_t *srcu, const uint8_t *srcv,
+                       const uint8_t *srca, unsigned count, unsigned alpha);
+    /* RGBA pixels over 32-bits RGB pixels */
+    void (*rgb)(uint8_t *dst, const uint8_t *src, unsigned count,
+                unsigned alpha, const rgb_layout &layout);
+};
+
+static inline void BlendSample(uint8_t *dst, unsigned src, unsigned srca,
+                               unsigned alpha)
+{
+    merge(dst, src, div255(alpha * srca));
+}
+
+static void BlendPlaneC(uint8_t *dst, const uint8_t *src, const uint8_t *srca,
+                        unsigned count, unsigned alpha)
+{
+    for (unsigned i = 0; i < count; i++)
+        BlendSample(&dst[i], src[i], srca[i], alpha);
+}
+
+static void BlendSub2C(uint8_t *dst, const uint8_t *src, const uint8_t *srca,
+                       unsigned count, unsigned alpha)
+{
+    for (unsigned i = 0; i < count; i++)
+        BlendSample(&dst[i], src[2 * i], srca[2 * i], alpha);
+}
+
+static void BlendSemiPlanarC(uint8_t *dst, const uint8_t *srcu,
+                             const uint8_t *srcv, const uint8_t *srca,
+                             unsigned count, unsigned alpha)
+{
+    for (unsigned i = 0; i < count; i++) {
+        BlendSample(&dst[2 * i + 0], srcu[2 * i], srca[2 * i], alpha);
+        BlendSample(&dst[2 * i + 1], srcv[2 * i], srca[2 * i], alpha);
+    }
+}
+
+static void BlendRGBC(uint8_t *dst, const uint8_t *src, unsigned count,
+                      unsigned alpha, const rgb_layout &layout)
+{
+    for (unsigned i = 0; i < count; i++, dst += 4, src += 4) {
+        BlendSample(&dst[layout.r], src[0], src[3], alpha);
+        BlendSample(&dst[layout.g], src[1], src[3], alpha);
+        BlendSample(&dst[layout.b], src[2], src[3], alpha);
+    }
+}
+
+static const blend_kernels_t kernels_c = {
+    BlendPlaneC, BlendSub2C, BlendSemiPlanarC, BlendRGBC,
+};
+
+#ifdef HAVE_SSE2_INTRINSICS
+/* 16-bits lanes are enough: every intermediate value is below 65281 */
+__attribute__ ((__target__ ("sse2")))
+static inline __m128i Div255SSE2(__m128i v)
+{
+    v = _mm_add_epi16(_mm_add_epi16(_mm_srli_epi16(v, 8), v),
+                      _mm_set1_epi16(1));
+    return _mm_srli_epi16(v, 8);
+}
+
+/* Merges 8 samples held in 16-bits lanes */
+__attribute__ ((__target__ ("sse2")))
+static inline __m128i MergeSSE2(__m128i dst, __m128i src, __m128i srca,
+                                __m128i alpha)
+{
+    const __m128i a = Div255SSE2(_mm_mullo_epi16(srca, alpha));
+    const __m128i na = _mm_sub_epi16(_mm_set1_epi16(255), a);
+    return Div255SSE2(_mm_add_epi16(_mm_mullo_epi16(dst, na),
+                                    _mm_mullo_epi16(src, a)));
+}
+
+__attribute__ ((__target__ ("sse2")))
+static void BlendPlaneSSE2(uint8_t *dst, const uint8_t *src,
+                           const uint8_t *srca, unsigned count, unsigned alpha)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i va = _mm_set1_epi16(alpha);
+    unsigned i = 0;
+
+    for (; i + 16 <= count; i += 16) {
+        const __m128i d = _mm_loadu_si128((const __m128i *)&dst[i]);
+        const __m128i s = _mm_loadu_si128((const __m128i *)&src[i]);
+        const __m128i a = _mm_loadu_si128((const __m128i *)&srca[i]);
+
+        const __m128i lo = MergeSSE2(_mm_unpacklo_epi8(d, zero),
+                                     _mm_unpacklo_epi8(s, zero),
+                                     _mm_unpacklo_epi8(a, zero), va);
+        const __m128i hi = MergeSSE2(_mm_unpackhi_epi8(d, zero),
+                                     _mm_unpackhi_epi8(s, zero),
+                                     _mm_unpackhi_epi8(a, zero), va);
+        _mm_storeu_si128((__m128i *)&dst[i], _mm_packus_epi16(lo, hi));
+    }
+    BlendPlaneC(&dst[i], &src[i], &srca[i], count - i, alpha);
+}
+
+/* Even bytes of 16 bytes, in 16-bits lanes */
+__attribute__ ((__target__ ("sse2")))
+static inline __m128i LoadEvenSSE2(const uint8_t *p)
+{
+    return _mm_and_si128(_mm_loadu_si128((const __m128i *)p),
+                         _mm_set1_epi16(0xff));
+}
+
+__attribute__ ((__target__ ("sse2")))
+static void BlendSub2SSE2(uint8_t *dst, const uint8_t *src,
+                          const uint8_t *srca, unsigned count, unsigned alpha)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i va = _mm_set1_epi16(alpha);
+    unsigned i = 0;
+
+    /* Never read past the last used source sample */
+    for (; i + 16 < count; i += 16) {
+        const __m128i d = _mm_loadu_si128((const __m128i *)&dst[i]);
+
+        const __m128i lo = MergeSSE2(_mm_unpacklo_epi8(d, zero),
+                                     LoadEvenSSE2(&src[2 * i]),
+                                     LoadEvenSSE2(&srca[2 * i]), va);
+        const __m128i hi = MergeSSE2(_mm_unpackhi_epi8(d, zero),
+                                     LoadEvenSSE2(&src[2 * i + 16]),
+                                     LoadEvenSSE2(&srca[2 * i + 16]), va);
+        _mm_storeu_si128((__m128i *)&dst[i], _mm_packus_epi16(lo, hi));
+    }
+    BlendSub2C(&dst[i], &src[2 * i], &srca[2 * i], count - i, alpha);
+}
+
+__attribute__ ((__target__ ("sse2")))
+static void BlendSemiPlanarSSE2(uint8_t *dst, const uint8_t *srcu,
+                                const uint8_t *srcv, const uint8_t *srca,
+                                unsigned count, unsigned alpha)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i va = _mm_set1_epi16(alpha);
+    unsigned i = 0;
+
+    for (; i + 8 < count; i += 8) {
+        const __m128i d = _mm_loadu_si128((const __m128i *)&dst[2 * i]);
+        const __m128i u = LoadEvenSSE2(&srcu[2 * i]);
+        const __m128i v = LoadEvenSSE2(&srcv[2 * i]);
+        const __m128i a = LoadEvenSSE2(&srca[2 * i]);
+
+        const __m128i lo = MergeSSE2(_mm_unpacklo_epi8(d, zero),
+                                     _mm_unpacklo_epi16(u, v),
+                                     _mm_unpacklo_epi16(a, a), va);
+        const __m128i hi = MergeSSE2(_mm_unpackhi_epi8(d, zero),
+                                     _mm_unpackhi_epi16(u, v),
+                                     _mm_unpackhi_epi16(a, a), va);
+        _mm_storeu_si128((__m128i *)&dst[2 * i], _mm_packus_epi16(lo, hi));
+    }
+    BlendSemiPlanarC(&dst[2 * i], &srcu[2 * i], &srcv[2 * i], &srca[2 * i],
+                     count - i, alpha);
+}
+
+/* Source word feeding the destination word j of a pixel, the alpha word
+ * feeds the padding byte */
+static inline constexpr int RGBSource(unsigned j, unsigned r, unsigned g,
+                                      unsigned b)
+{
+    return j == r ? 0 : j == g ? 1 : j == b ? 2 : 3;
+}
+
+template <unsigned r, unsigned g, unsigned b>
+__attribute__ ((__target__ ("sse2")))
+static inline __m128i MergeRGBSSE2(__m128i d, __m128i s, __m128i va)
+{
+    enum { shuffle = RGBSource(0, r, g, b)      | RGBSource(1, r, g, b) << 2 |
+                     RGBSource(2, r, g, b) << 4 | RGBSource(3, r, g, b) << 6 };
+    /* No weight for the padding byte, so that it is preserved */
+    const __m128i pad = _mm_set_epi16(
+        (r != 3 && g != 3 && b != 3) ? 0 : -1, (r != 2 && g != 2 && b != 2) ? 0 : -1,
+        (r != 1 && g != 1 && b != 1) ? 0 : -1, (r != 0 && g != 0 && b != 0) ? 0 : -1,
+        (r != 3 && g != 3 && b != 3) ? 0 : -1, (r != 2 && g != 2 && b != 2) ? 0 : -1,
+        (r != 1 && g != 1 && b != 1) ? 0 : -1, (r != 0 && g != 0 && b != 0) ? 0 : -1);
+
+    __m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s, 0xff), 0xff);
+    a = _mm_and_si128(a, pad);
+    s = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s, shuffle), shuffle);
+    return MergeSSE2(d, s, a, va);
+}
+
+template <unsigned r, unsigned g, unsigned b>
+__attribute__ ((__target__ ("sse2")))
+static void BlendRGBSSE2(uint8_t *dst, const uint8_t *src, unsigned count,
+                         unsigned alpha, const rgb_layout &layout)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i va = _mm_set1_epi16(alpha);
+    unsigned i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        const __m128i d = _mm_loadu_si128((const __m128i *)&dst[4 * i]);
+        const __m128i s = _mm_loadu_si128((const __m128i *)&src[4 * i]);
+
+        const __m128i lo = MergeRGBSSE2<r, g, b>(_mm_unpacklo_epi8(d, zero),
+                                                 _mm_unpacklo_epi8(s, zero), va);
+        const __m128i hi = MergeRGBSSE2<r, g, b>(_mm_unpackhi_epi8(d, zero),
+                                                 _mm_unpackhi_epi8(s, zero), va);
+        _mm_storeu_si128((__m128i *)&dst[4 * i], _mm_packus_epi16(lo, hi));
+    }
+    BlendRGBC(&dst[4 * i], &src[4 * i], count - i, alpha, layout);
+}
+
+static void BlendRGBDispatchSSE2(uint8_t *dst, const uint8_t *src,
+                                 unsigned count, unsigned alpha,
+                                 const rgb_layout &layout)
+{
+    if (layout.r == 2 && layout.g == 1 && layout.b == 0)
+        BlendRGBSSE2<2, 1, 0>(dst, src, count, alpha, layout);
+    else if (layout.r == 0 && layout.g == 1 && layout.b == 2)
+        BlendRGBSSE2<0, 1, 2>(dst, src, count, alpha, layout);
+    else if (layout.r == 1 && layout.g == 2 && layout.b == 3)
+        BlendRGBSSE2<1, 2, 3>(dst, src, count, alpha, layout);
+    else if (layout.r == 3 && layout.g == 2 && layout.b == 1)
+        BlendRGBSSE2<3, 2, 1>(dst, src, count, alpha, layout);
+    else
+        BlendRGBC(dst, src, count, alpha, layout);
+}
+
+static const blend_kernels_t kernels_sse2 = {
+    BlendPlaneSSE2, BlendSub2SSE2, BlendSemiPlanarSSE2, BlendRGBDispatchSSE2,
+};
+#endif
+
+#ifdef HAVE_AVX2_INTRINSICS
+__attribute__ ((__target__ ("avx2")))
+static inline __m256i Div255AVX2(__m256i v)
+{
+    v = _mm256_add_epi16(_mm256_add_epi16(_mm256_srli_epi16(v, 8), v),
+                         _mm256_set1_epi16(1));
+    return _mm256_srli_epi16(v, 8);
+}
+
+__attribute__ ((__target__ ("avx2")))
+static inline __m256i MergeAVX2(__m256i dst, __m256i src, __m256i srca,
+                                __m256i alpha)
+{
+    const __m256i a = Div255AVX2(_mm256_mullo_epi16(srca, alpha));
+    const __m256i na = _mm256_sub_epi16(_mm256_set1_epi16(255), a);
+    return Div255AVX2(_mm256_add_epi16(_mm256_mullo_epi16(dst, na),
+                                       _mm256_mullo_epi16(src, a)));
+}
+
+/* Packs 2x16 words back to 32 bytes in order */
+__attribute__ ((__target__ ("avx2")))
+static inline __m256i PackAVX2(__m256i lo, __m256i hi)
+{
+    return _mm256_permute4x64_epi64(_mm256_packus_epi16(lo, hi), 0xd8);
+}
+
+__attribute__ ((__target__ ("avx2")))
+static inline __m256i Load16AVX2(const uint8_t *p)
+{
+    return _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)p));
+}
+
+__attribute__ ((__target__ ("avx2")))
+static inline __m256i LoadEvenAVX2(const uint8_t *p)
+{
+    return _mm256_and_si256(_mm256_loadu_si256((const __m256i *)p),
+                            _mm256_set1_epi16(0xff));
+}
+
+__attribute__ ((__target__ ("avx2")))
+static void BlendPlaneAVX2(uint8_t *dst, const uint8_t *src,
+                           const uint8_t *srca, unsigned count, unsigned alpha)
+{
+    const __m256i va = _mm256_set1_epi16(alpha);
+    unsigned i = 0;
+
+    for (; i + 32 <= count; i += 32) {
+        const __m256i lo = MergeAVX2(Load16AVX2(&dst[i]), Load16AVX2(&src[i]),
+                                     Load16AVX2(&srca[i]), va);
+        const __m256i hi = MergeAVX2(Load16AVX2(&dst[i + 16]),
+                                     Load16AVX2(&src[i + 16]),
+                                     Load16AVX2(&srca[i + 16]), va);
+        _mm256_storeu_si256((__m256i *)&dst[i], PackAVX2(lo, hi));
+    }
+    BlendPlaneSSE2(&dst[i], &src[i], &srca[i], count - i, alpha);
+}
+
+__attribute__ ((__target__ ("avx2")))
+static void BlendSub2AVX2(uint8_t *dst, const uint8_t *src,
+                          const uint8_t *srca, unsigned count, unsigned alpha)
+{
+    const __m256i va = _mm256_set1_epi16(alpha);
+    unsigned i = 0;
+
+    for (; i + 32 < count; i += 32) {
+        const __m256i lo = MergeAVX2(Load16AVX2(&dst[i]),
+                                     LoadEvenAVX2(&src[2 * i]),
+                                     LoadEvenAVX2(&srca[2 * i]), va);
+        const __m256i hi = MergeAVX2(Load16AVX2(&dst[i + 16]),
+                                     LoadEvenAVX2(&src[2 * i + 32]),
+                                     LoadEvenAVX2(&srca[2 * i + 32]), va);
+        _mm256_storeu_si256((__m256i *)&dst[i], PackAVX2(lo, hi));
+    }
+    BlendSub2SSE2(&dst[i], &src[2 * i], &srca[2 * i], count - i, alpha);
+}
+
+static const blend_kernels_t kernels_avx2 = {
+    BlendPlaneAVX2, BlendSub2AVX2, BlendSemiPlanarSSE2, BlendRGBDispatchSSE2,
+};
+#endif
+
+#ifdef BLEND_NEON
+static inline uint8x8_t MergeNEON(uint8x8_t dst, uint8x8_t src,
+                                  uint8x8_t srca, uint8x8_t alpha)
+{
+    const uint16x8_t one = vdupq_n_u16(1);
+    uint16x8_t v = vmull_u8(srca, alpha);
+    const uint8x8_t a = vshrn_n_u16(vaddq_u16(vaddq_u16(vshrq_n_u16(v, 8), v), one), 8);
+
+    v = vmlal_u8(vmull_u8(dst, vsub_u8(vdup_n_u8(255), a)), src, a);
+    return vshrn_n_u16(vaddq_u16(vaddq_u16(vshrq_n_u16(v, 8), v), one), 8);
+}
+
+static void BlendPlaneNEON(uint8_t *dst, const uint8_t *src,
+                           const uint8_t *srca, unsigned count, unsigned alpha)
+{
+    const uint8x8_t va = vdup_n_u8(alpha);
+    unsigned i = 0;
+
+    for (; i + 8 <= count; i += 8)
+        vst1_u8(&dst[i], MergeNEON(vld1_u8(&dst[i]), vld1_u8(&src[i]),
+                                   vld1_u8(&srca[i]), va));
+    BlendPlaneC(&dst[i], &src[i], &srca[i], count - i, alpha);
+}
+
+static void BlendSub2NEON(uint8_t *dst, const uint8_t *src,
+                          const uint8_t *srca, unsigned count, unsigned alpha)
+{
+    const uint8x8_t va = vdup_n_u8(alpha);
+    unsigned i = 0;
+
+    for (; i + 8 < count; i += 8)
+        vst1_u8(&dst[i], MergeNEON(vld1_u8(&dst[i]), vld2_u8(&src[2 * i]).val[0],
+                                   vld2_u8(&srca[2 * i]).val[0], va));
+    BlendSub2C(&dst[i], &src[2 * i], &srca[2 * i], count - i, alpha);
+}
+
+static void BlendSemiPlanarNEON(uint8_t *dst, const uint8_t *srcu,
+                                const uint8_t *srcv, const uint8_t *srca,
+                                unsigned count, unsigned alpha)
+{
+    const uint8x8_t va = vdup_n_u8(alpha);
+    unsigned i = 0;
+
+    for (; i + 8 < count; i += 8) {
+        uint8x8x2_t d = vld2_u8(&dst[2 * i]);
+        const uint8x8_t a = vld2_u8(&srca[2 * i]).val[0];
+
+        d.val[0] = MergeNEON(d.val[0], vld2_u8(&srcu[2 * i]).val[0], a, va);
+        d.val[1] = MergeNEON(d.val[1], vld2_u8(&srcv[2 * i]).val[0], a, va);
+        vst2_u8(&dst[2 * i], d);
+    }
+    BlendSemiPlanarC(&dst[2 * i], &srcu[2 * i], &srcv[2 * i], &srca[2 * i],
+                     count - i, alpha);
+}
+
+static void BlendRGBNEON(uint8_t *dst, const uint8_t *src, unsigned count,
+                         unsigned alpha, const rgb_layout &layout)
+{
+    const uint8x8_t va = vdup_n_u8(alpha);
+    unsigned i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        uint8x8x4_t d = vld4_u8(&dst[4 * i]);
+        const uint8x8x4_t s = vld4_u8(&src[4 * i]);
+
+        d.val[layout.r] = MergeNEON(d.val[layout.r], s.val[0], s.val[3], va);
+        d.val[layout.g] = MergeNEON(d.val[layout.g], s.val[1], s.val[3], va);
+        d.val[layout.b] = MergeNEON(d.val[layout.b], s.val[2], s.val[3], va);
+        vst4_u8(&dst[4 * i], d);
+    }
+    BlendRGBC(&dst[4 * i], &src[4 * i], count - i, alpha, layout);
+}
+
+static const blend_kernels_t kernels_neon = {
+    BlendPlaneNEON, BlendSub2NEON, BlendSemiPlanarNEON, BlendRGBNEON,
+};
+#endif
+
+static const blend_kernels_t *GetKernels(void)
+{
+#ifdef HAVE_AVX2_INTRINSICS
+    if (vlc_CPU_AVX2())
+        return &kernels_avx2;
+#endif
+#ifdef HAVE_SSE2_INTRINSICS
+    if (vlc_CPU_SSE2())
+        return &kernels_sse2;
+#endif
+#ifdef BLEND_NEON
+    return &kernels_neon;
+#endif
+    return &kernels_c;
+}
+
+struct fast_blend_t {
+    const blend_kernels_t *k;
+    picture_t             *dst;
+    const video_format_t  *dst_fmt;
+    unsigned               dst_x, dst_y;
+    const picture_t       *src;
+    unsigned               src_x, src_y;
+    unsigned               width, height;
+    unsigned               alpha;
+};
+
+static inline uint8_t *FastPixels(const picture_t *pic, unsigned plane,
+                                  unsigned x, unsigned y)
+{
+    return &pic->p[plane].p_pixels[y * pic->p[plane].i_pitch + x];
+}
+
+static void FastYUVAToYUV420(const fast_blend_t &b)
+{
+    const bool swap_uv = b.dst_fmt->i_chroma == VLC_CODEC_YV12;
+    const unsigned phase = b.dst_x % 2;
+    const unsigned count = b.width > phase ? (b.width - phase + 1) / 2 : 0;
+
+    for (unsigned y = 0; y < b.height; y++) {
+        const unsigned sy = b.src_y + y, dy = b.dst_y + y;
+        const uint8_t *a = FastPixels(b.src, A_PLANE, b.src_x, sy);
+
+        b.k->plane(FastPixels(b.dst, Y_PLANE, b.dst_x, dy),
+                   FastPixels(b.src, Y_PLANE, b.src_x, sy), a,
+                   b.width, b.alpha);
+        if ((dy % 2) != 0 || count == 0)
+            continue;
+        b.k->sub2(FastPixels(b.dst, swap_uv ? V_PLANE : U_PLANE,
+                             (b.dst_x + phase) / 2, dy / 2),
+                  FastPixels(b.src, U_PLANE, b.src_x + phase, sy),
+                  a + phase, count, b.alpha);
+        b.k->sub2(FastPixels(b.dst, swap_uv ? U_PLANE : V_PLANE,
+                             (b.dst_x + phase) / 2, dy / 2),
+                  FastPixels(b.src, V_PLANE, b.src_x + phase, sy),
+                  a + phase, count, b.alpha);
+    }
+}
+
+static void FastYUVAToNV12(const fast_blend_t &b)
+{
+    const bool swap_uv = b.dst_fmt->i_chroma == VLC_CODEC_NV21;
+    const unsigned phase = b.dst_x % 2;
+    const unsigned count = b.width > phase ? (b.width - phase + 1) / 2 : 0;
+
+    for (unsigned y = 0; y < b.height; y++) {
+        const unsigned sy = b.src_y + y, dy = b.dst_y + y;
+        const uint8_t *a = FastPixels(b.src, A_PLANE, b.src_x, sy);
+
+        b.k->plane(FastPixels(b.dst, Y_PLANE, b.dst_x, dy),
+                   FastPixels(b.src, Y_PLANE, b.src_x, sy), a,
+                   b.width, b.alpha);
+        if ((dy % 2) != 0 || count == 0)
+            continue;
+        const uint8_t *u = FastPixels(b.src, U_PLANE, b.src_x + phase, sy);
+        const uint8_t *v = FastPixels(b.src, V_PLANE, b.src_x + phase, sy);
+        b.k->semiplanar(FastPixels(b.dst, 1, b.dst_x + phase, dy / 2),
+                        swap_uv ? v : u, swap_uv ? u : v, a + phase,
+                        count, b.alpha);
+    }
+}
+
+static void FastRGBAToRGB32(const fast_blend_t &b)
+{
+    rgb_layout layout;
+#ifdef WORDS_BIGENDIAN
+    layout.r = (32 - b.dst_fmt->i_lrshift) / 8;
+    layout.g = (32 - b.dst_fmt->i_lgshift) / 8;
+    layout.b = (32 - b.dst_fmt->i_lbshift) / 8;
+#else
+    layout.r = b.dst_fmt->i_lrshift / 8;
+    layout.g = b.dst_fmt->i_lgshift / 8;
+    layout.b = b.dst_fmt->i_lbshift / 8;
+#endif
+
+    for (unsigned y = 0; y < b.height; y++)
+        b.k->rgb(FastPixels(b.dst, 0, 4 * b.dst_x, b.dst_y + y),
+                 FastPixels(b.src, 0, 4 * b.src_x, b.src_y + y),
+                 b.width, b.alpha, layout);
+}
+
+typedef void (*fast_blend_function_t)(const fast_blend_t &);
+
+static const struct {
+    vlc_fourcc_t          dst;
+    vlc_fourcc_t          src;
+    fast_blend_function_t blend;
+} fast_blends[] = {
+    { VLC_CODEC_I420,  VLC_CODEC_YUVA, FastYUVAToYUV420 },
+    { VLC_CODEC_J420,  VLC_CODEC_YUVA, FastYUVAToYUV420 },
+    { VLC_CODEC_YV12,  VLC_CODEC_YUVA, FastYUVAToYUV420 },
+    { VLC_CODEC_NV12,  VLC_CODEC_YUVA, FastYUVAToNV12 },
+    { VLC_CODEC_NV21,  VLC_CODEC_YUVA, FastYUVAToNV12 },
+    { VLC_CODEC_RGB32, VLC_CODEC_RGBA, FastRGBAToRGB32 },
+};
+
+
 static const struct {
     vlc_fourcc_t     dst;
     vlc_fourcc_t     src;
@@ -624,10 +1159,12 @@ static const struct {
 };
 
 struct filter_sys_t {
-    filter_sys_t() : blend(NULL)
+    filter_sys_t() : blend(NULL), fast(NULL), kernels(NULL)
     {
     }
     blend_function_t blend;
+    fast_blend_function_t fast;
+    const blend_kernels_t *kernels;
 };
 
 /**
@@ -655,6 +1192,23 @@ static void Blend(filter_t *filter,
     video_format_FixRgb(&filter->fmt_out.video);
     video_format_FixRgb(&filter->fmt_in.video);
 
+    if (sys->fast) {
+        fast_blend_t b;
+        b.k       = sys->kernels;
+        b.dst     = dst;
+        b.dst_fmt = &filter->fmt_out.video;
+        b.dst_x   = filter->fmt_out.video.i_x_offset + x_offset;
+        b.dst_y   = filter->fmt_out.video.i_y_offset + y_offset;
+        b.src     = src;
+        b.src_x   = filter->fmt_in.video.i_x_offset;
+        b.src_y   = filter->fmt_in.video.i_y_offset;
+        b.width   = width;
+        b.height  = height;
+        b.alpha   = alpha;
+        sys->fast(b);
+        return;
+    }
+
     sys->blend(CPicture(dst, &filter->fmt_out.video,
                         filter->fmt_out.video.i_x_offset + x_offset,
                         filter->fmt_out.video.i_y_offset + y_offset),
@@ -676,6 +1230,12 @@ static int Open(vlc_object_t *object)
             sys->blend = blends[i].blend;
     }
 
+    for (size_t i = 0; i < sizeof(fast_blends) / sizeof(*fast_blends); i++) {
+        if (fast_blends[i].src == src && fast_blends[i].dst == dst)
+            sys->fast = fast_blends[i].blend;
+    }
+    sys->kernels = GetKernels();
+
     if (!sys->blend) {
        msg_Err(filter, "no matching alpha blending routine (chroma: %4.4s -> %4.4s)",
                (char *)&src, (char *)&dst);
@@ -53,17 +53,30 @@ static picture_t *Filter( filter_t *, picture_t * );
 #define LOOPS_TEXT N_("Number of time to blend")
 #define LOOPS_LONGTEXT N_("The number of time the blend will be performed")
 
+#define WARMUP_TEXT N_("Number of warm-up blends")
+#define WARMUP_LONGTEXT N_("The number of blends performed before the " \
+                           "measurements start")
+
 #define ALPHA_TEXT N_("Alpha of the blended image")
 #define ALPHA_LONGTEXT N_("Alpha with which the blend image is blended")
 
 #define BASE_IMAGE_TEXT N_("Image to be blended onto")
-#define BASE_IMAGE_LONGTEXT N_("The image which will be used to blend onto")
+#define BASE_IMAGE_LONGTEXT N_("The image which will be used to blend onto. " \
+    "If empty, a synthetic image of the given dimensions is generated.")
 
 #define BASE_CHROMA_TEXT N_("Chroma for the base image")
 #define BASE_CHROMA_LONGTEXT N_("Chroma which the base image will be loaded in")
 
 #define BLEND_IMAGE_TEXT N_("Image which will be blended")
-#define BLEND_IMAGE_LONGTEXT N_("The image blended onto the base image")
+#define BLEND_IMAGE_LONGTEXT N_("The image blended onto the base image. " \
+    "If empty, a synthetic subtitle-like band, as wide as the base image " \
+    "and a quarter of its height, is generated.")
+
+#define WIDTH_TEXT N_("Width of the synthetic base image")
+#define WIDTH_LONGTEXT N_("Width used when no base image is given")
+
+#define HEIGHT_TEXT N_("Height of the synthetic base image")
+#define HEIGHT_LONGTEXT N_("Height used when no base image is given")
 
 #define BLEND_CHROMA_TEXT N_("Chroma for the blend image")
 #define BLEND_CHROMA_LONGTEXT N_("Chroma which the blend image will be loaded" \
@@ -81,6 +94,8 @@ vlc_module_begin ()
     set_section( N_("Benchmarking"), NULL )
     add_integer( CFG_PREFIX "loops", 1000, LOOPS_TEXT,
               LOOPS_LONGTEXT, false )
+    add_integer( CFG_PREFIX "warmup", 10, WARMUP_TEXT,
+              WARMUP_LONGTEXT, false )
     add_integer_with_range( CFG_PREFIX "alpha", 128, 0, 255, ALPHA_TEXT,
               ALPHA_LONGTEXT, false )
 
@@ -89,6 +104,8 @@ vlc_module_begin ()
                   BASE_IMAGE_LONGTEXT, false )
     add_string( CFG_PREFIX "base-chroma", "I420", BASE_CHROMA_TEXT,
               BASE_CHROMA_LONGTEXT, false )
+    add_integer( CFG_PREFIX "width", 1920, WIDTH_TEXT, WIDTH_LONGTEXT, false )
+    add_integer( CFG_PREFIX "height", 1080, HEIGHT_TEXT, HEIGHT_LONGTEXT, false )
 
     set_section( N_("Blend image"), NULL )
     add_loadfile( CFG_PREFIX "blend-image", NULL, BLEND_IMAGE_TEXT,
@@ -100,8 +117,8 @@ vlc_module_begin ()
 vlc_module_end ()
 
 static const char *const ppsz_filter_options[] = {
-    "loops", "alpha", "base-image", "base-chroma", "blend-image",
-    "blend-chroma", NULL
+    "loops", "warmup", "alpha", "base-image", "base-chroma", "width",
+    "height", "blend-image", "blend-chroma", NULL
 };
 
 /*****************************************************************************
@@ -110,7 +127,7 @@ static const char *const ppsz_filter_options[] = {
 struct filter_sys_t
 {
     bool b_done;
-    int i_loops, i_alpha;
+    int i_loops, i_warmup, i_alpha;
 
     picture_t *p_base_image;
     picture_t *p_blend_image;
@@ -119,6 +136,88 @@ struct filter_sys_t
     vlc_fourcc_t i_blend_chroma;
 };
 
+/* Deterministic pseudo-random generator, so that runs are comparable */
+static uint32_t blendbench_Random( uint32_t *p_seed )
+{
+    *p_seed = *p_seed * 1664525 + 1013904223;
+    return *p_seed >> 24;
+}
+
+static int blendbench_SynthImage( vlc_object_t *p_this, picture_t **pp_pic,
+                                  vlc_fourcc_t i_chroma, unsigned i_width,
+                                  unsigned i_height, uint32_t i_seed,
+                                  const char *psz_name )
+{
+    video_format_t fmt;
+
+    if( i_chroma == VLC_CODEC_YUVP || i_width == 0 || i_height == 0 )
+    {
+        msg_Err( p_this, "Unable to generate a %4.4s %ux%u %s image",
+                 (const char *)&i_chroma, i_width, i_height, psz_name );
+        return VLC_EGENERIC;
+    }
+
+    video_format_Init( &fmt, i_chroma );
+    video_format_Setup( &fmt, i_chroma, i_width, i_height,
+                        i_width, i_height, 1, 1 );
+    *pp_pic = picture_NewFromFormat( &fmt );
+    video_format_Clean( &fmt );
+    if( *pp_pic == NULL )
+        return VLC_ENOMEM;
+
+    /* Subtitle-like alpha: mostly transparent, with opaque glyphs and
+     * anti-aliased edges */
+    int i_alpha_plane = -1;
+    unsigned i_alpha_offset = 0, i_alpha_step = 1;
+    if( i_chroma == VLC_CODEC_YUVA )
+        i_alpha_plane = A_PLANE;
+    else if( i_chroma == VLC_CODEC_RGBA || i_chroma == VLC_CODEC_BGRA )
+    {
+        i_alpha_plane = 0;
+        i_alpha_offset = 3;
+        i_alpha_step = 4;
+    }
+
+    for( int i = 0; i < (*pp_pic)->i_planes; i++ )
+    {
+        const plane_t *p = &(*pp_pic)->p[i];
+        for( int y = 0; y < p->i_visible_lines; y++ )
+        {
+            uint8_t *p_line = &p->p_pixels[y * p->i_pitch];
+            for( int x = 0; x < p->i_visible_pitch; x++ )
+                p_line[x] = blendbench_Random( &i_seed );
+
+            if( i != i_alpha_plane )
+                continue;
+            for( int x = i_alpha_offset; x < p->i_visible_pitch;
+                 x += i_alpha_step )
+            {
+                const unsigned r = blendbench_Random( &i_seed );
+                p_line[x] = r < 160 ? 0 : r < 224 ? 255 : p_line[x];
+            }
+        }
+    }
+
+    msg_Dbg( p_this, "%s image is synthetic %4.4s %ux%u", psz_name,
+             (const char *)&i_chroma, i_width, i_height );
+    return VLC_SUCCESS;
+}
+
+/* FNV-1a of the visible samples, to compare blend implementations */
+static uint32_t blendbench_Checksum( const picture_t *p_pic )
+{
+    uint32_t i_hash = 2166136261u;
+
+    for( int i = 0; i < p_pic->i_planes; i++ )
+    {
+        const plane_t *p = &p_pic->p[i];
+        for( int y = 0; y < p->i_visible_lines; y++ )
+            for( int x = 0; x < p->i_visible_pitch; x++ )
+                i_hash = (i_hash ^ p->p_pixels[y * p->i_pitch + x]) * 16777619u;
+    }
+    return i_hash;
+}
+
 static int blendbench_LoadImage( vlc_object_t *p_this, picture_t **pp_pic,
                                  vlc_fourcc_t i_chroma, char *psz_file, const char *psz_name )
 {
@@ -173,15 +272,32 @@ static int Create( vlc_object_t *p_this )
 
     p_sys->i_loops = var_CreateGetIntegerCommand( p_filter,
                                                   CFG_PREFIX "loops" );
+    p_sys->i_warmup = var_CreateGetIntegerCommand( p_filter,
+                                                   CFG_PREFIX "warmup" );
     p_sys->i_alpha = var_CreateGetIntegerCommand( p_filter,
                                                   CFG_PREFIX "alpha" );
+    if( p_sys->i_loops < 1 )
+        p_sys->i_loops = 1;
+    if( p_sys->i_warmup < 0 )
+        p_sys->i_warmup = 0;
+
+    const int i_width = var_CreateGetIntegerCommand( p_filter,
+                                                     CFG_PREFIX "width" );
+    const int i_height = var_CreateGetIntegerCommand( p_filter,
+                                                      CFG_PREFIX "height" );
 
     psz_temp = var_CreateGetStringCommand( p_filter, CFG_PREFIX "base-chroma" );
     p_sys->i_base_chroma = !psz_temp || strlen( psz_temp ) != 4 ? 0 :
         VLC_FOURCC( psz_temp[0], psz_temp[1], psz_temp[2], psz_temp[3] );
     psz_cmd = var_CreateGetStringCommand( p_filter, CFG_PREFIX "base-image" );
-    i_ret = blendbench_LoadImage( p_this, &p_sys->p_base_image,
-                                  p_sys->i_base_chroma, psz_cmd, "Base" );
+    if( EMPTY_STR( psz_cmd ) )
+        i_ret = blendbench_SynthImage( p_this, &p_sys->p_base_image,
+                                       p_sys->i_base_chroma,
+                                       __MAX( i_width, 0 ), __MAX( i_height, 0 ),
+                                       1, "Base" );
+    else
+        i_ret = blendbench_LoadImage( p_this, &p_sys->p_base_image,
+                                      p_sys->i_base_chroma, psz_cmd, "Base" );
     free( psz_temp );
     free( psz_cmd );
     if( i_ret != VLC_SUCCESS )
@@ -195,8 +311,15 @@ static int Create( vlc_object_t *p_this )
     p_sys->i_blend_chroma = !psz_temp || strlen( psz_temp ) != 4
         ? 0 : VLC_FOURCC( psz_temp[0], psz_temp[1], psz_temp[2], psz_temp[3] );
     psz_cmd = var_CreateGetStringCommand( p_filter, CFG_PREFIX "blend-image" );
-    i_ret = blendbench_LoadImage( p_this, &p_sys->p_blend_image, p_sys->i_blend_chroma,
-                                  psz_cmd, "Blend" );
+    if( EMPTY_STR( psz_cmd ) )
+        i_ret = blendbench_SynthImage( p_this, &p_sys->p_blend_image,
+                                       p_sys->i_blend_chroma,
+                                       p_sys->p_base_image->format.i_visible_width,
+                                       __MAX( p_sys->p_base_image->format.i_visible_height / 4, 1 ),
+                                       2, "Blend" );
+    else
+        i_ret = blendbench_LoadImage( p_this, &p_sys->p_blend_image,
+                                      p_sys->i_blend_chroma, psz_cmd, "Blend" );
 
     free( psz_temp );
     free( psz_cmd );
@@ -222,6 +345,7 @@ static void Destroy( vlc_object_t *p_this )
 
     picture_Release( p_sys->p_base_image );
     picture_Release( p_sys->p_blend_image );
+    free( p_sys );
 }
 
 /*****************************************************************************
@@ -251,22 +375,50 @@ static picture_t *Filter( filter_t *p_filter, picture_t *p_pic )
         return NULL;
     }
 
-    mtime_t time = mdate();
+    /* Result of a single blend onto the pristine base image */
+    picture_t *p_check = picture_NewFromFormat( &p_sys->p_base_image->format );
+    if( p_check )
+    {
+        picture_Copy( p_check, p_sys->p_base_image );
+        p_blend->pf_video_blend( p_blend, p_check, p_sys->p_blend_image,
+                                 0, 0, p_sys->i_alpha );
+        msg_Info( p_filter, "Blend of %4.4s onto %4.4s, checksum %08"PRIx32,
+                  (const char *)&p_sys->i_blend_chroma,
+                  (const char *)&p_sys->i_base_chroma,
+                  blendbench_Checksum( p_check ) );
+        picture_Release( p_check );
+    }
+
+    for( int i_iter = 0; i_iter < p_sys->i_warmup; ++i_iter )
+        p_blend->pf_video_blend( p_blend,
+                                 p_sys->p_base_image, p_sys->p_blend_image,
+                                 0, 0, p_sys->i_alpha );
+
+    mtime_t time = 0, time_min = INT64_MAX;
     for( int i_iter = 0; i_iter < p_sys->i_loops; ++i_iter )
     {
+        const mtime_t start = mdate();
         p_blend->pf_video_blend( p_blend,
                                  p_sys->p_base_image, p_sys->p_blend_image,
                                  0, 0, p_sys->i_alpha );
+        const mtime_t duration = mdate() - start;
+
+        time += duration;
+        time_min = __MIN( time_min, duration );
     }
-    time = mdate() - time;
+    if( time <= 0 )
+        time = 1;
+
+    const double pixels = (double)p_sys->p_blend_image->format.i_visible_width *
+                          p_sys->p_blend_image->format.i_visible_height;
+    const double mean = (double)time / p_sys->i_loops;
 
     msg_Info( p_filter, "Blended %d images in %f sec", p_sys->i_loops,
               time / 1000000.0f );
+    msg_Info( p_filter, "Per blend: min %"PRId64" us, mean %.1f us, "
+              "%.3f ns/pixel", time_min, mean, mean * 1000. / pixels );
     msg_Info( p_filter, "Speed is: %f images/second, %f pixels/second",
-              (float) p_sys->i_loops / time * 1000000,
-              (float) p_sys->i_loops / time * 1000000 *
-                  p_sys->p_blend_image->p[Y_PLANE].i_visible_pitch *
-                  p_sys->p_blend_image->p[Y_PLANE].i_visible_lines );
+              1000000. / mean, 1000000. / mean * pixels );
 
     module_unneed( p_blend, p_blend->p_module );
 
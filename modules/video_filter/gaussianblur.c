@@ -186,14 +186,100 @@ static void Destroy( vlc_object_t *p_this )
     free( p_filter->p_sys );
 }
 
+/* Each plane has its own part of pt_buffer, so that all the planes can be
+ * processed at once */
+struct gaussianblur_pictures
+{
+    const picture_t *p_pic;
+    picture_t *p_outpic;
+    size_t pi_offset[PICTURE_PLANE_MAX];
+};
+
+static void HorizontalSlice( filter_t *p_filter, const filter_slice_t *p_slice,
+                             void *p_data )
+{
+    const struct gaussianblur_pictures *p_pics = p_data;
+    filter_sys_t *p_sys = p_filter->p_sys;
+    const int i_dim = p_sys->i_dim;
+    const type_t *pt_distribution = p_sys->pt_distribution;
+    const int i_plane = p_slice->i_plane;
+    const picture_t *p_pic = p_pics->p_pic;
+    type_t *pt_buffer = p_sys->pt_buffer + p_pics->pi_offset[i_plane];
+
+    const uint8_t *p_in = p_pic->p[i_plane].p_pixels;
+    const int i_visible_pitch = p_pic->p[i_plane].i_visible_pitch;
+    const int i_in_pitch = p_pic->p[i_plane].i_pitch;
+
+    const int x_factor = p_pic->p[Y_PLANE].i_visible_pitch/i_visible_pitch-1;
+
+    for( int i_line = p_slice->i_start; i_line < p_slice->i_end; i_line++ )
+    {
+        for( int i_col = 0; i_col < i_visible_pitch; i_col++ )
+        {
+            type_t t_value = 0;
+            const int c = i_line*i_in_pitch+i_col;
+            for( int x = __MAX( -i_dim, -i_col*(x_factor+1) );
+                 x <= __MIN( i_dim, (i_visible_pitch - i_col)*(x_factor+1) + 1 );
+                 x++ )
+            {
+                t_value += pt_distribution[x+i_dim] *
+                           p_in[c+(x>>x_factor)];
+            }
+            pt_buffer[c] = t_value;
+        }
+    }
+}
+
+static void VerticalSlice( filter_t *p_filter, const filter_slice_t *p_slice,
+                           void *p_data )
+{
+    const struct gaussianblur_pictures *p_pics = p_data;
+    filter_sys_t *p_sys = p_filter->p_sys;
+    const int i_dim = p_sys->i_dim;
+    const type_t *pt_distribution = p_sys->pt_distribution;
+    const type_t *pt_scale = p_sys->pt_scale;
+    const int i_plane = p_slice->i_plane;
+    const picture_t *p_pic = p_pics->p_pic;
+    const type_t *pt_buffer = p_sys->pt_buffer + p_pics->pi_offset[i_plane];
+
+    uint8_t *p_out = p_pics->p_outpic->p[i_plane].p_pixels;
+    const int i_out_pitch = p_pics->p_outpic->p[i_plane].i_pitch;
+
+    const int i_visible_lines = p_pic->p[i_plane].i_visible_lines;
+    const int i_visible_pitch = p_pic->p[i_plane].i_visible_pitch;
+    const int i_in_pitch = p_pic->p[i_plane].i_pitch;
+
+    const int x_factor = p_pic->p[Y_PLANE].i_visible_pitch/i_visible_pitch-1;
+    const int y_factor = p_pic->p[Y_PLANE].i_visible_lines/i_visible_lines-1;
+
+    for( int i_line = p_slice->i_start; i_line < p_slice->i_end; i_line++ )
+    {
+        for( int i_col = 0; i_col < i_visible_pitch; i_col++ )
+        {
+            type_t t_value = 0;
+            const int c = i_line*i_in_pitch+i_col;
+            for( int y = __MAX( -i_dim, (-i_line)*(y_factor+1) );
+                 y <= __MIN( i_dim, (i_visible_lines - i_line)*(y_factor+1) - 1 );
+                 y++ )
+            {
+                t_value += pt_distribution[y+i_dim] *
+                           pt_buffer[c+(y>>y_factor)*i_in_pitch];
+            }
+
+            const type_t t_scale = pt_scale[(i_line<<y_factor)*(i_in_pitch<<x_factor)+(i_col<<x_factor)];
+            p_out[i_line * i_out_pitch + i_col] = (uint8_t)(t_value / t_scale); // FIXME wouldn't it be better to round instead of trunc ?
+        }
+    }
+}
+
 static picture_t *Filter( filter_t *p_filter, picture_t *p_pic )
 {
     picture_t *p_outpic;
     filter_sys_t *p_sys = p_filter->p_sys;
     const int i_dim = p_sys->i_dim;
-    type_t *pt_buffer;
     type_t *pt_scale;
     const type_t *pt_distribution = p_sys->pt_distribution;
+    struct gaussianblur_pictures pics;
 
     if( !p_pic ) return NULL;
 
@@ -203,14 +289,20 @@ static picture_t *Filter( filter_t *p_filter, picture_t *p_pic )
         picture_Release( p_pic );
         return NULL;
     }
+
+    size_t i_buffer = 0;
+    for( int i_plane = 0; i_plane < p_pic->i_planes; i_plane++ )
+    {
+        pics.pi_offset[i_plane] = i_buffer;
+        i_buffer += p_pic->p[i_plane].i_visible_lines *
+                    p_pic->p[i_plane].i_pitch;
+    }
     if( !p_sys->pt_buffer )
     {
         p_sys->pt_buffer = realloc_or_free( p_sys->pt_buffer,
-                               p_pic->p[Y_PLANE].i_visible_lines *
-                               p_pic->p[Y_PLANE].i_pitch * sizeof( type_t ) );
+                                            i_buffer * sizeof( type_t ) );
     }
 
-    pt_buffer = p_sys->pt_buffer;
     if( !p_sys->pt_scale )
     {
         const int i_visible_lines = p_pic->p[Y_PLANE].i_visible_lines;
@@ -243,55 +335,12 @@ static picture_t *Filter( filter_t *p_filter, picture_t *p_pic )
         }
     }
 
-    pt_scale = p_sys->pt_scale;
-    for( int i_plane = 0 ; i_plane < p_pic->i_planes ; i_plane++ )
-    {
-
-        uint8_t *p_in = p_pic->p[i_plane].p_pixels;
-        uint8_t *p_out = p_outpic->p[i_plane].p_pixels;
-
-        const int i_visible_lines = p_pic->p[i_plane].i_visible_lines;
-        const int i_visible_pitch = p_pic->p[i_plane].i_visible_pitch;
-        const int i_in_pitch = p_pic->p[i_plane].i_pitch;
-
-        const int x_factor = p_pic->p[Y_PLANE].i_visible_pitch/i_visible_pitch-1;
-        const int y_factor = p_pic->p[Y_PLANE].i_visible_lines/i_visible_lines-1;
-
-        for( int i_line = 0; i_line < i_visible_lines; i_line++ )
-        {
-            for( int i_col = 0; i_col < i_visible_pitch; i_col++ )
-            {
-                type_t t_value = 0;
-                const int c = i_line*i_in_pitch+i_col;
-                for( int x = __MAX( -i_dim, -i_col*(x_factor+1) );
-                     x <= __MIN( i_dim, (i_visible_pitch - i_col)*(x_factor+1) + 1 );
-                     x++ )
-                {
-                    t_value += pt_distribution[x+i_dim] *
-                               p_in[c+(x>>x_factor)];
-                }
-                pt_buffer[c] = t_value;
-            }
-        }
-        for( int i_line = 0; i_line < i_visible_lines; i_line++ )
-        {
-            for( int i_col = 0; i_col < i_visible_pitch; i_col++ )
-            {
-                type_t t_value = 0;
-                const int c = i_line*i_in_pitch+i_col;
-                for( int y = __MAX( -i_dim, (-i_line)*(y_factor+1) );
-                     y <= __MIN( i_dim, (i_visible_lines - i_line)*(y_factor+1) - 1 );
-                     y++ )
-                {
-                    t_value += pt_distribution[y+i_dim] *
-                               pt_buffer[c+(y>>y_factor)*i_in_pitch];
-                }
-
-                const type_t t_scale = pt_scale[(i_line<<y_factor)*(i_in_pitch<<x_factor)+(i_col<<x_factor)];
-                p_out[i_line * p_outpic->p[i_plane].i_pitch + i_col] = (uint8_t)(t_value / t_scale); // FIXME wouldn't it be better to round instead of trunc ?
-            }
-        }
-    }
+    /* The vertical pass reads the horizontal pass output of the lines
+     * around each of its lines: run them one after the other */
+    pics.p_pic = p_pic;
+    pics.p_outpic = p_outpic;
+    filter_ExecuteSlices( p_filter, p_pic, 0, 0, HorizontalSlice, &pics );
+    filter_ExecuteSlices( p_filter, p_pic, 0, 0, VerticalSlice, &pics );
 
     return CopyInfoAndRelease( p_outpic, p_pic );
 }
@@ -108,6 +108,7 @@ struct filter_sys_t {
     int              radius;
     const vlc_chroma_description_t *chroma;
     struct vf_priv_s cfg;
+    size_t           buf_size; /* of the buffer of each slice worker */
 };
 
 static int Open(vlc_object_t *object)
@@ -173,6 +174,48 @@ static void Close(vlc_object_t *object)
     free(sys);
 }
 
+struct gradfun_pictures
+{
+    picture_t *src;
+    picture_t *dst;
+};
+
+static void FilterSlice(filter_t *filter, const filter_slice_t *slice,
+                        void *data)
+{
+    const struct gradfun_pictures *pics = data;
+    filter_sys_t *sys = filter->p_sys;
+    struct vf_priv_s *cfg = &sys->cfg;
+    const int i = slice->i_plane;
+    const plane_t *srcp = &pics->src->p[i];
+    plane_t       *dstp = &pics->dst->p[i];
+
+    const video_format_t *fmt = &filter->fmt_in.video;
+    const vlc_chroma_description_t *chroma = sys->chroma;
+    int w = fmt->i_width  * chroma->p[i].w.num / chroma->p[i].w.den;
+    int h = fmt->i_height * chroma->p[i].h.num / chroma->p[i].h.den;
+    int r = (cfg->radius  * chroma->p[i].w.num / chroma->p[i].w.den +
+             cfg->radius  * chroma->p[i].h.num / chroma->p[i].h.den) / 2;
+    r = VLC_CLIP((r + 1) & ~1, RADIUS_MIN, RADIUS_MAX);
+
+    /* Lines are filtered in pairs */
+    int start = slice->i_start & ~1;
+    int end = slice->i_end < srcp->i_visible_lines ? slice->i_end & ~1 : h;
+
+    if (__MIN(w, h) > 2 * r && cfg->buf) {
+        if (start < __MIN(end, h))
+            filter_plane(cfg, cfg->buf + slice->i_worker * sys->buf_size,
+                         dstp->p_pixels, srcp->p_pixels,
+                         w, h, dstp->i_pitch, srcp->i_pitch, r,
+                         start, __MIN(end, h));
+    } else {
+        const int size = __MIN(srcp->i_visible_pitch, dstp->i_visible_pitch);
+        for (int y = slice->i_start; y < slice->i_end; y++)
+            memcpy(&dstp->p_pixels[y * dstp->i_pitch],
+                   &srcp->p_pixels[y * srcp->i_pitch], size);
+    }
+}
+
 static picture_t *Filter(filter_t *filter, picture_t *src)
 {
     filter_sys_t *sys = filter->p_sys;
@@ -194,27 +237,15 @@ static picture_t *Filter(filter_t *filter, picture_t *src)
     cfg->thresh = (1 << 15) / strength;
     if (cfg->radius != radius) {
         cfg->radius = radius;
-        cfg->buf    = aligned_alloc(16,
-                                   (((fmt->i_width + 15) & ~15) * (cfg->radius + 1) / 2 + 32) * sizeof(*cfg->buf));
+        sys->buf_size = ((fmt->i_width + 15) & ~15) * (cfg->radius + 1) / 2 + 32;
+        aligned_free(cfg->buf);
+        cfg->buf    = aligned_alloc(16, filter_GetSliceWorkers(filter) *
+                                        sys->buf_size * sizeof(*cfg->buf));
     }
 
-    for (int i = 0; i < dst->i_planes; i++) {
-        const plane_t *srcp = &src->p[i];
-        plane_t       *dstp = &dst->p[i];
-
-        const vlc_chroma_description_t *chroma = sys->chroma;
-        int w = fmt->i_width  * chroma->p[i].w.num / chroma->p[i].w.den;
-        int h = fmt->i_height * chroma->p[i].h.num / chroma->p[i].h.den;
-        int r = (cfg->radius  * chroma->p[i].w.num / chroma->p[i].w.den +
-                 cfg->radius  * chroma->p[i].h.num / chroma->p[i].h.den) / 2;
-        r = VLC_CLIP((r + 1) & ~1, RADIUS_MIN, RADIUS_MAX);
-        if (__MIN(w, h) > 2 * r && cfg->buf) {
-            filter_plane(cfg, dstp->p_pixels, srcp->p_pixels,
-                         w, h, dstp->i_pitch, srcp->i_pitch, r);
-        } else {
-            plane_CopyPixels(dstp, srcp);
-        }
-    }
+    /* The slices must be large enough to rebuild the line sums */
+    struct gradfun_pictures pics = { src, dst };
+    filter_ExecuteSlices(filter, src, 0, 2 * cfg->radius, FilterSlice, &pics);
 
     picture_CopyProperties(dst, src);
     picture_Release(src);
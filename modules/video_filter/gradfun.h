@@ -222,45 +222,70 @@ static void blur_line_sse2(uint16_t *dc, uint16_t *buf, uint16_t *buf1,
 }
 #endif // HAVE_6REGS && HAVE_SSE2
 
-static void filter_plane(struct vf_priv_s *ctx, uint8_t *dst, uint8_t *src,
-                         int width, int height, int dstride, int sstride, int r)
+static void blur_plane(struct vf_priv_s *ctx, uint16_t *dc, uint16_t *buf,
+                       int bstride, uint8_t *src, int width, int sstride,
+                       int r, int y)
+{
+    uint32_t dc_factor = (1<<21)/(r*r);
+    int mod = ((y+r)/2)%r;
+    uint16_t *buf0 = buf+mod*bstride;
+    uint16_t *buf1 = buf+(mod?mod-1:r-1)*bstride;
+    int x, v;
+    ctx->blur_line(dc, buf0, buf1, src+(y+r)*sstride, sstride, width/2);
+    for (x=v=0; x<r; x++)
+        v += dc[x];
+    for (; x<width/2; x++) {
+        v += dc[x] - dc[x-r];
+        dc[x-r] = v * dc_factor >> 16;
+    }
+    for (; x<(width+r+1)/2; x++)
+        dc[x-r] = v * dc_factor >> 16;
+    for (x=-r/2; x<0; x++)
+        dc[x] = dc[0];
+}
+
+/* Filters the lines from start to end-1, both even (or end == height), with
+ * ctx_buf as work buffer. Below the first line, the ring of line sums is
+ * rebuilt from the lines above start: as the sums wrap around, starting it
+ * from zero instead of the top of the plane gives the same differences. */
+static void filter_plane(struct vf_priv_s *ctx, uint16_t *ctx_buf,
+                         uint8_t *dst, uint8_t *src, int width, int height,
+                         int dstride, int sstride, int r, int start, int end)
 {
     int bstride = ((width+15)&~15)/2;
     int y;
-    uint32_t dc_factor = (1<<21)/(r*r);
-    uint16_t *dc = ctx->buf+16;
-    uint16_t *buf = ctx->buf+bstride+32;
+    uint16_t *dc = ctx_buf+16;
+    uint16_t *buf = ctx_buf+bstride+32;
     int thresh = ctx->thresh;
 
-    memset(dc, 0, (bstride+16)*sizeof(*buf));
-    for (y=0; y<r; y++)
-        ctx->blur_line(dc, buf+y*bstride, buf+(y-1)*bstride, src+2*y*sstride, sstride, width/2);
+    if (start == 0) {
+        memset(dc, 0, (bstride+16)*sizeof(*buf));
+        for (y=0; y<r; y++)
+            ctx->blur_line(dc, buf+y*bstride, buf+(y-1)*bstride, src+2*y*sstride, sstride, width/2);
+    } else {
+        /* The sums are updated every other line until height-r */
+        int first = y = start;
+        if (first >= height-r)
+            first = r + ((height-2*r-1) & ~1);
+        int p = (first+r)/2;
+
+        memset(buf+(p%r)*bstride, 0, bstride*sizeof(*buf));
+        for (int q = p-r+1; q < p; q++)
+            ctx->blur_line(dc, buf+(q%r)*bstride, buf+((q+r-1)%r)*bstride,
+                           src+2*q*sstride, sstride, width/2);
+        if (first != y)
+            blur_plane(ctx, dc, buf, bstride, src, width, sstride, r, first);
+    }
     for (;;) {
-        if (y < height-r) {
-            int mod = ((y+r)/2)%r;
-            uint16_t *buf0 = buf+mod*bstride;
-            uint16_t *buf1 = buf+(mod?mod-1:r-1)*bstride;
-            int x, v;
-            ctx->blur_line(dc, buf0, buf1, src+(y+r)*sstride, sstride, width/2);
-            for (x=v=0; x<r; x++)
-                v += dc[x];
-            for (; x<width/2; x++) {
-                v += dc[x] - dc[x-r];
-                dc[x-r] = v * dc_factor >> 16;
-            }
-            for (; x<(width+r+1)/2; x++)
-                dc[x-r] = v * dc_factor >> 16;
-            for (x=-r/2; x<0; x++)
-                dc[x] = dc[0];
-        }
-        if (y == r) {
+        if (y < height-r)
+            blur_plane(ctx, dc, buf, bstride, src, width, sstride, r, y);
+        if (start == 0 && y == r) {
             for (y=0; y<r; y++)
                 ctx->filter_line(dst+y*dstride, src+y*sstride, dc-r/2, width, thresh, dither[y&7]);
         }
         ctx->filter_line(dst+y*dstride, src+y*sstride, dc-r/2, width, thresh, dither[y&7]);
-        if (++y >= height) break;
+        if (++y >= end) break;
         ctx->filter_line(dst+y*dstride, src+y*sstride, dc-r/2, width, thresh, dither[y&7]);
-        if (++y >= height) break;
+        if (++y >= end) break;
     }
 }
-
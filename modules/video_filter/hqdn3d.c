@@ -91,6 +91,8 @@ struct filter_sys_t
 {
     const vlc_chroma_description_t *chroma;
     int w[3], h[3];
+    int wmax;   /* width of the Line buffer of each slice worker */
+    int history;
 
     struct vf_priv_s cfg;
     bool   b_recalc_coefs;
@@ -138,7 +140,9 @@ static int Open(vlc_object_t *this)
         if (sys->w[i] > wmax) wmax = sys->w[i];
         sys->h[i] = fmt_out->i_height * chroma->p[i].h.num / chroma->p[i].h.den;
     }
-    cfg->Line = malloc(wmax*sizeof(unsigned int));
+    sys->wmax = wmax;
+    cfg->Line = vlc_alloc(filter_GetSliceWorkers(filter),
+                          wmax*sizeof(unsigned int));
     if (!cfg->Line) {
         free(sys);
         return VLC_ENOMEM;
@@ -192,6 +196,37 @@ static void Close(vlc_object_t *this)
 /*****************************************************************************
  * Filter
  *****************************************************************************/
+/* The vertical part of the spatial filter is recursive: slices restart it
+ * that many lines above their first line at most. Past that, the history is
+ * not exact and each plane is filtered as a single slice. */
+#define HISTORY_MAX 64
+
+struct hqdn3d_pictures
+{
+    picture_t *src;
+    picture_t *dst;
+};
+
+static void DenoiseSlice(filter_t *filter, const filter_slice_t *slice,
+                         void *data)
+{
+    const struct hqdn3d_pictures *pics = data;
+    filter_sys_t *sys = filter->p_sys;
+    struct vf_priv_s *cfg = &sys->cfg;
+    const int i = slice->i_plane;
+    int *spat = cfg->Coefs[i == 0 ? 0 : 2];
+    int *temp = cfg->Coefs[i == 0 ? 1 : 3];
+
+    if (slice->i_start >= sys->h[i])
+        return;
+    deNoise(pics->src->p[i].p_pixels, pics->dst->p[i].p_pixels,
+            cfg->Line + slice->i_worker * sys->wmax, cfg->Frame[i],
+            sys->w[i], slice->i_first, slice->i_start,
+            __MIN(slice->i_end, sys->h[i]),
+            pics->src->p[i].i_pitch, pics->dst->p[i].i_pitch,
+            spat, spat, temp);
+}
+
 static picture_t *Filter(filter_t *filter, picture_t *src)
 {
     picture_t *dst;
@@ -218,27 +253,16 @@ static picture_t *Filter(filter_t *filter, picture_t *src)
         PrecalcCoefs(cfg->Coefs[1], sys->luma_temp);
         PrecalcCoefs(cfg->Coefs[2], sys->chroma_spat);
         PrecalcCoefs(cfg->Coefs[3], sys->chroma_temp);
+        sys->history = __MAX(deNoiseHistory(cfg->Coefs[0], HISTORY_MAX),
+                             deNoiseHistory(cfg->Coefs[2], HISTORY_MAX));
     }
     vlc_mutex_unlock( &sys->coefs_mutex );
 
-    deNoise(src->p[0].p_pixels, dst->p[0].p_pixels,
-            cfg->Line, &cfg->Frame[0], sys->w[0], sys->h[0],
-            src->p[0].i_pitch, dst->p[0].i_pitch,
-            cfg->Coefs[0],
-            cfg->Coefs[0],
-            cfg->Coefs[1]);
-    deNoise(src->p[1].p_pixels, dst->p[1].p_pixels,
-            cfg->Line, &cfg->Frame[1], sys->w[1], sys->h[1],
-            src->p[1].i_pitch, dst->p[1].i_pitch,
-            cfg->Coefs[2],
-            cfg->Coefs[2],
-            cfg->Coefs[3]);
-    deNoise(src->p[2].p_pixels, dst->p[2].p_pixels,
-            cfg->Line, &cfg->Frame[2], sys->w[2], sys->h[2],
-            src->p[2].i_pitch, dst->p[2].i_pitch,
-            cfg->Coefs[2],
-            cfg->Coefs[2],
-            cfg->Coefs[3]);
+    for (int i = 0; i < 3; ++i) {
+        if (!cfg->Frame[i])
+            cfg->Frame[i] = deNoiseInit(src->p[i].p_pixels, sys->w[i],
+                                        sys->h[i], src->p[i].i_pitch);
+    }
 
     if(unlikely(!cfg->Frame[0] || !cfg->Frame[1] || !cfg->Frame[2]))
     {
@@ -247,6 +271,11 @@ static picture_t *Filter(filter_t *filter, picture_t *src)
         return NULL;
     }
 
+    /* An overlap as high as the luma plane leaves one slice per plane */
+    unsigned overlap = sys->history < HISTORY_MAX ? sys->history : sys->h[0];
+    struct hqdn3d_pictures pics = { src, dst };
+    filter_ExecuteSlices(filter, src, 3, overlap, DenoiseSlice, &pics);
+
     return CopyInfoAndRelease(dst, src);
 }
 
@@ -46,16 +46,24 @@ static /*inline*/ unsigned int LowPassMul(unsigned int PrevMul, unsigned int Cur
     return CurrMul + Coef[d];
 }
 
+/* The filters process the lines from Start to End-1 of a plane. The spatial
+ * filter is recursive: when First < Start, the lines from First are only used
+ * to prime LineAnt, so that the slice starts with (nearly) the vertical state
+ * the lines above would have left. FrameAnt is only written from Start. */
+
 static void deNoiseTemporal(
                     unsigned char *Frame,        // mpi->planes[x]
                     unsigned char *FrameDest,    // dmpi->planes[x]
                     unsigned short *FrameAnt,
-                    int W, int H, int sStride, int dStride,
+                    int W, int Start, int End, int sStride, int dStride,
                     int *Temporal)
 {
     unsigned int PixelDst;
 
-    for (long Y = 0; Y < H; Y++){
+    Frame += Start*sStride;
+    FrameDest += Start*dStride;
+    FrameAnt += Start*W;
+    for (long Y = Start; Y < End; Y++){
         for (long X = 0; X < W; X++){
             PixelDst = LowPassMul(FrameAnt[X]<<8, Frame[X]<<16, Temporal);
             FrameAnt[X] = ((PixelDst+0x1000007F)>>8);
@@ -67,30 +75,61 @@ static void deNoiseTemporal(
     }
 }
 
+static void deNoiseWarmUp(
+                    unsigned char *Frame,        // mpi->planes[x]
+                    unsigned int *LineAnt,       // vf->priv->Line (width bytes)
+                    int W, int First, int Start, int sStride,
+                    int *Horizontal, int *Vertical)
+{
+    unsigned int PixelAnt;
+
+    Frame += First*sStride;
+    LineAnt[0] = PixelAnt = Frame[0]<<16;
+    for (long X = 1; X < W; X++)
+        LineAnt[X] = PixelAnt = LowPassMul(PixelAnt, Frame[X]<<16, Horizontal);
+
+    for (long Y = First + 1; Y < Start; Y++){
+        Frame += sStride;
+        PixelAnt = Frame[0]<<16;
+        LineAnt[0] = LowPassMul(LineAnt[0], PixelAnt, Vertical);
+        for (long X = 1; X < W; X++){
+            PixelAnt = LowPassMul(PixelAnt, Frame[X]<<16, Horizontal);
+            LineAnt[X] = LowPassMul(LineAnt[X], PixelAnt, Vertical);
+        }
+    }
+}
+
 static void deNoiseSpacial(
                     unsigned char *Frame,        // mpi->planes[x]
                     unsigned char *FrameDest,    // dmpi->planes[x]
                     unsigned int *LineAnt,       // vf->priv->Line (width bytes)
-                    int W, int H, int sStride, int dStride,
+                    int W, int First, int Start, int End,
+                    int sStride, int dStride,
                     int *Horizontal, int *Vertical)
 {
-    long sLineOffs = 0, dLineOffs = 0;
+    long sLineOffs = Start*sStride, dLineOffs = Start*dStride;
     unsigned int PixelAnt;
     unsigned int PixelDst;
 
-    /* First pixel has no left nor top neighbor. */
-    PixelDst = LineAnt[0] = PixelAnt = Frame[0]<<16;
-    FrameDest[0]= ((PixelDst+0x10007FFF)>>16);
+    if (First < Start)
+        deNoiseWarmUp(Frame, LineAnt, W, First, Start, sStride,
+                      Horizontal, Vertical);
+    else {
+        /* First pixel has no left nor top neighbor. */
+        PixelDst = LineAnt[0] = PixelAnt = Frame[sLineOffs]<<16;
+        FrameDest[dLineOffs]= ((PixelDst+0x10007FFF)>>16);
 
-    /* First line has no top neighbor, only left. */
-    for (long X = 1; X < W; X++){
-        PixelDst = LineAnt[X] = LowPassMul(PixelAnt, Frame[X]<<16, Horizontal);
-        FrameDest[X]= ((PixelDst+0x10007FFF)>>16);
+        /* First line has no top neighbor, only left. */
+        for (long X = 1; X < W; X++){
+            PixelDst = LineAnt[X] = LowPassMul(PixelAnt, Frame[sLineOffs+X]<<16, Horizontal);
+            FrameDest[dLineOffs+X]= ((PixelDst+0x10007FFF)>>16);
+        }
+        Start++;
+        sLineOffs += sStride, dLineOffs += dStride;
     }
 
-    for (long Y = 1; Y < H; Y++){
+    for (long Y = Start; Y < End; Y++){
         unsigned int PixelAnt;
-        sLineOffs += sStride, dLineOffs += dStride;
         /* First pixel on each line doesn't have previous pixel */
         PixelAnt = Frame[sLineOffs]<<16;
         PixelDst = LineAnt[0] = LowPassMul(LineAnt[0], PixelAnt, Vertical);
@@ -103,62 +142,62 @@ static void deNoiseSpacial(
             PixelDst = LineAnt[X] = LowPassMul(LineAnt[X], PixelAnt, Vertical);
             FrameDest[dLineOffs+X]= ((PixelDst+0x10007FFF)>>16);
         }
+        sLineOffs += sStride, dLineOffs += dStride;
     }
 }
 
+/* FrameAnt must have been allocated and initialized by deNoiseInit() */
 static void deNoise(unsigned char *Frame,        // mpi->planes[x]
                     unsigned char *FrameDest,    // dmpi->planes[x]
                     unsigned int *LineAnt,      // vf->priv->Line (width bytes)
-                    unsigned short **FrameAntPtr,
-                    int W, int H, int sStride, int dStride,
+                    unsigned short *FrameAnt,
+                    int W, int First, int Start, int End,
+                    int sStride, int dStride,
                     int *Horizontal, int *Vertical, int *Temporal)
 {
-    long sLineOffs = 0, dLineOffs = 0;
+    long sLineOffs = Start*sStride, dLineOffs = Start*dStride;
     unsigned int PixelAnt;
     unsigned int PixelDst;
-    unsigned short* FrameAnt=(*FrameAntPtr);
-
-    if(!FrameAnt){
-        (*FrameAntPtr)=FrameAnt=malloc(W*H*sizeof(unsigned short));
-        if(!FrameAnt)
-            return;
-        for (long Y = 0; Y < H; Y++){
-            unsigned short* dst=&FrameAnt[Y*W];
-            unsigned char* src=Frame+Y*sStride;
-            for (long X = 0; X < W; X++) dst[X]=src[X]<<8;
-        }
-    }
 
     if(!Horizontal[0] && !Vertical[0]){
         deNoiseTemporal(Frame, FrameDest, FrameAnt,
-                        W, H, sStride, dStride, Temporal);
+                        W, Start, End, sStride, dStride, Temporal);
         return;
     }
     if(!Temporal[0]){
         deNoiseSpacial(Frame, FrameDest, LineAnt,
-                       W, H, sStride, dStride, Horizontal, Vertical);
+                       W, First, Start, End, sStride, dStride,
+                       Horizontal, Vertical);
         return;
     }
 
-    /* First pixel has no left nor top neighbor. Only previous frame */
-    LineAnt[0] = PixelAnt = Frame[0]<<16;
-    PixelDst = LowPassMul(FrameAnt[0]<<8, PixelAnt, Temporal);
-    FrameAnt[0] = ((PixelDst+0x1000007F)>>8);
-    FrameDest[0]= ((PixelDst+0x10007FFF)>>16);
+    if (First < Start)
+        deNoiseWarmUp(Frame, LineAnt, W, First, Start, sStride,
+                      Horizontal, Vertical);
+    else {
+        unsigned short* LinePrev=&FrameAnt[Start*W];
 
-    /* First line has no top neighbor. Only left one for each pixel and
-     * last frame */
-    for (long X = 1; X < W; X++){
-        LineAnt[X] = PixelAnt = LowPassMul(PixelAnt, Frame[X]<<16, Horizontal);
-        PixelDst = LowPassMul(FrameAnt[X]<<8, PixelAnt, Temporal);
-        FrameAnt[X] = ((PixelDst+0x1000007F)>>8);
-        FrameDest[X]= ((PixelDst+0x10007FFF)>>16);
+        /* First pixel has no left nor top neighbor. Only previous frame */
+        LineAnt[0] = PixelAnt = Frame[sLineOffs]<<16;
+        PixelDst = LowPassMul(LinePrev[0]<<8, PixelAnt, Temporal);
+        LinePrev[0] = ((PixelDst+0x1000007F)>>8);
+        FrameDest[dLineOffs]= ((PixelDst+0x10007FFF)>>16);
+
+        /* First line has no top neighbor. Only left one for each pixel and
+         * last frame */
+        for (long X = 1; X < W; X++){
+            LineAnt[X] = PixelAnt = LowPassMul(PixelAnt, Frame[sLineOffs+X]<<16, Horizontal);
+            PixelDst = LowPassMul(LinePrev[X]<<8, PixelAnt, Temporal);
+            LinePrev[X] = ((PixelDst+0x1000007F)>>8);
+            FrameDest[dLineOffs+X]= ((PixelDst+0x10007FFF)>>16);
+        }
+        Start++;
+        sLineOffs += sStride, dLineOffs += dStride;
     }
 
-    for (long Y = 1; Y < H; Y++){
+    for (long Y = Start; Y < End; Y++){
         unsigned int PixelAnt;
         unsigned short* LinePrev=&FrameAnt[Y*W];
-        sLineOffs += sStride, dLineOffs += dStride;
         /* First pixel on each line doesn't have previous pixel */
         PixelAnt = Frame[sLineOffs]<<16;
         LineAnt[0] = LowPassMul(LineAnt[0], PixelAnt, Vertical);
@@ -175,7 +214,46 @@ static void deNoise(unsigned char *Frame,        // mpi->planes[x]
             LinePrev[X] = ((PixelDst+0x1000007F)>>8);
             FrameDest[dLineOffs+X]= ((PixelDst+0x10007FFF)>>16);
         }
+        sLineOffs += sStride, dLineOffs += dStride;
+    }
+}
+
+static unsigned short *deNoiseInit(unsigned char *Frame,
+                                   int W, int H, int sStride)
+{
+    unsigned short* FrameAnt=malloc(W*H*sizeof(unsigned short));
+    if(!FrameAnt)
+        return NULL;
+    for (long Y = 0; Y < H; Y++){
+        unsigned short* dst=&FrameAnt[Y*W];
+        unsigned char* src=Frame+Y*sStride;
+        for (long X = 0; X < W; X++) dst[X]=src[X]<<8;
+    }
+    return FrameAnt;
+}
+
+/* Number of lines after which any difference in the vertical state of the
+ * spatial filter has faded under half a level (or Max) */
+static int deNoiseHistory(const int *Vertical, int Max)
+{
+    int Lines = 0;
+
+    if (!Vertical[0])
+        return 0;
+    for (int Start = 8; Start <= 255*16 && Lines < Max; Start++){
+        int Diff = Start;
+        int n = 0;
+        while (Diff >= 8 && n < Max){
+            int Next = (int)(((int64_t)Vertical[16*256+Diff] * 16) >> 16);
+            if (Next >= Diff)
+                return Max;
+            Diff = Next;
+            n++;
+        }
+        if (n > Lines)
+            Lines = n;
     }
+    return Lines;
 }
 
 
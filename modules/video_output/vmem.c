@@ -82,6 +82,7 @@ vlc_module_end()
  * Local prototypes
  *****************************************************************************/
 struct picture_sys_t {
+    vout_display_sys_t *sys;
     void *id;
 };
 
@@ -96,6 +97,13 @@ struct vout_display_sys_t {
     void (*display)(void *sys, void *id);
     void (*cleanup)(void *sys);
 
+    /* Application buffers, decoded into without any copy */
+    void *(*pool_alloc)(void *sys, unsigned index, void **plane);
+    void (*pool_release)(void *sys, void *id);
+    unsigned pool_count;
+    picture_t *direct; /* last displayed application buffer */
+    bool is_direct;
+
     unsigned pitches[PICTURE_PLANE_MAX];
     unsigned lines[PICTURE_PLANE_MAX];
 };
@@ -134,6 +142,10 @@ static int Open(vlc_object_t *object)
     sys->cleanup = var_InheritAddress(vd, "vmem-cleanup");
     sys->opaque = var_InheritAddress(vd, "vmem-data");
     sys->pool = NULL;
+    sys->pool_alloc = var_InheritAddress(vd, "vmem-pool");
+    sys->pool_release = var_InheritAddress(vd, "vmem-pool-release");
+    sys->direct = NULL;
+    sys->is_direct = false;
 
     /* Define the video format */
     video_format_t fmt;
@@ -226,17 +238,115 @@ static void Close(vlc_object_t *object)
     vout_display_t *vd = (vout_display_t *)object;
     vout_display_sys_t *sys = vd->sys;
 
-    if (sys->cleanup)
-        sys->cleanup(sys->opaque);
+    if (sys->direct)
+        picture_Release(sys->direct);
     if (sys->pool)
         picture_pool_Release(sys->pool);
+    if (sys->cleanup)
+        sys->cleanup(sys->opaque);
     free(sys);
 }
 
+static void DestroyDirect(picture_t *pic)
+{
+    free(pic->p_sys);
+    free(pic);
+}
+
+/* Called whenever a picture returns to the pool */
+static void UnlockDirect(picture_t *pic)
+{
+    picture_sys_t *picsys = pic->p_sys;
+    vout_display_sys_t *sys = picsys->sys;
+
+    if (sys->pool_release != NULL)
+        sys->pool_release(sys->opaque, picsys->id);
+}
+
+/**
+ * Wraps the application buffers into pictures. The pitches and lines given
+ * by the format callback must be large enough for the pictures; otherwise
+ * the buffers cannot be decoded into, and the copy is used instead.
+ */
+static picture_pool_t *PoolDirect(vout_display_t *vd, unsigned count)
+{
+    vout_display_sys_t *sys = vd->sys;
+    picture_t *ref = picture_NewFromFormat(&vd->fmt);
+
+    if (ref == NULL)
+        return NULL;
+    for (int i = 0; i < ref->i_planes; i++)
+        if (sys->pitches[i] < (unsigned)ref->p[i].i_pitch
+         || sys->lines[i] < (unsigned)ref->p[i].i_lines) {
+            msg_Warn(vd, "buffer plane %d too small (%ux%u, need %dx%d), "
+                     "copying pictures", i, sys->pitches[i], sys->lines[i],
+                     ref->p[i].i_pitch, ref->p[i].i_lines);
+            picture_Release(ref);
+            return NULL;
+        }
+    picture_Release(ref);
+
+    picture_t *pictures[count];
+    unsigned n;
+
+    for (n = 0; n < count; n++) {
+        void *planes[PICTURE_PLANE_MAX] = { NULL };
+        picture_sys_t *picsys = malloc(sizeof (*picsys));
+        if (unlikely(picsys == NULL))
+            break;
+
+        picsys->sys = sys;
+        picsys->id = sys->pool_alloc(sys->opaque, n, planes);
+        if (picsys->id == NULL) {
+            free(picsys);
+            break; /* no more application buffers */
+        }
+
+        picture_resource_t rsc = {
+            .p_sys = picsys,
+            .pf_destroy = DestroyDirect,
+        };
+        for (unsigned i = 0; i < PICTURE_PLANE_MAX; i++) {
+            rsc.p[i].p_pixels = planes[i];
+            rsc.p[i].i_lines  = sys->lines[i];
+            rsc.p[i].i_pitch  = sys->pitches[i];
+        }
+
+        pictures[n] = picture_NewFromResource(&vd->fmt, &rsc);
+        if (pictures[n] == NULL) {
+            if (sys->pool_release != NULL)
+                sys->pool_release(sys->opaque, picsys->id);
+            free(picsys);
+            break;
+        }
+    }
+
+    if (n == 0)
+        return NULL;
+    if (n < count)
+        msg_Dbg(vd, "%u application buffers for %u pictures", n, count);
+
+    picture_pool_configuration_t cfg = {
+        .picture_count = n,
+        .picture = pictures,
+        .unlock = UnlockDirect,
+    };
+    picture_pool_t *pool = picture_pool_NewExtended(&cfg);
+    if (pool == NULL)
+        for (unsigned i = 0; i < n; i++)
+            picture_Release(pictures[i]);
+    return pool;
+}
+
 static picture_pool_t *Pool(vout_display_t *vd, unsigned count)
 {
     vout_display_sys_t *sys = vd->sys;
 
+    if (sys->pool == NULL && sys->pool_alloc != NULL) {
+        sys->pool = PoolDirect(vd, count);
+        if (sys->pool == NULL)
+            sys->pool_alloc = NULL;
+    }
     if (sys->pool == NULL)
         sys->pool = picture_pool_NewFromFormat(&vd->fmt, count);
     return sys->pool;
@@ -248,6 +358,15 @@ static void Prepare(vout_display_t *vd, picture_t *pic, subpicture_t *subpic)
     picture_resource_t rsc = { .p_sys = NULL };
     void *planes[PICTURE_PLANE_MAX];
 
+    /* Decoded (or converted) straight into an application buffer */
+    sys->is_direct = sys->pool_alloc != NULL && pic->p_sys != NULL
+                  && pic->p_sys->sys == sys;
+    if (sys->is_direct) {
+        sys->pic_opaque = pic->p_sys->id;
+        (void) subpic;
+        return;
+    }
+
     sys->pic_opaque = sys->lock(sys->opaque, planes);
 
     for (unsigned i = 0; i < PICTURE_PLANE_MAX; i++) {
@@ -275,6 +394,13 @@ static void Display(vout_display_t *vd, picture_t *pic, subpicture_t *subpic)
     if (sys->display != NULL)
         sys->display(sys->opaque, sys->pic_opaque);
 
+    /* Keep the buffer until the next picture is displayed, so that the
+     * application can still read it after the display callback. */
+    if (sys->is_direct) {
+        if (sys->direct != NULL)
+            picture_Release(sys->direct);
+        sys->direct = picture_Hold(pic);
+    }
     picture_Release(pic);
     VLC_UNUSED(subpic);
 }
@@ -421,7 +421,7 @@ static void *Thread( void *p_data )
 
             p_buffl++; p_buffs++;
         }
-        p_state = visual_fft_init();
+        p_state = visual_fft_init(VLC_OBJECT(p_filter));
         if (!p_state)
         {
             msg_Err(p_filter,"unable to initialize FFT transform");
@@ -186,7 +186,7 @@ static int spectrum_Run(visual_effect_t * p_effect, vlc_object_t *p_aout,
 
         p_buffl++ ; p_buffs++ ;
     }
-    p_state  = visual_fft_init();
+    p_state  = visual_fft_init( p_aout );
     if( !p_state)
     {
         free( height );
@@ -534,7 +534,7 @@ static int spectrometer_Run(visual_effect_t * p_effect, vlc_object_t *p_aout,
 
         p_buffl++ ; p_buffs++ ;
     }
-    p_state  = visual_fft_init();
+    p_state  = visual_fft_init( p_aout );
     if( !p_state)
     {
         msg_Err(p_aout,"unable to initialize FFT transform");
@@ -1,5 +1,5 @@
 /*****************************************************************************
- * fft.h: Headers for iterative implementation of a FFT
+ * fft.h: Headers for the spectrum of sound samples
  *****************************************************************************
  * $Id$
  *
@@ -25,6 +25,8 @@
 #ifndef VLC_VISUAL_FFT_H_
 #define VLC_VISUAL_FFT_H_
 
+#include <vlc_fft.h>
+
 #define FFT_BUFFER_SIZE_LOG 9
 
 #define FFT_BUFFER_SIZE (1 << FFT_BUFFER_SIZE_LOG)
@@ -33,22 +35,14 @@
 typedef short int sound_sample;
 
 struct _struct_fft_state {
-     /* Temporary data stores to perform FFT in. */
-     float real[FFT_BUFFER_SIZE];
-     float imag[FFT_BUFFER_SIZE];
-
-     /* */
-     unsigned int bitReverse[FFT_BUFFER_SIZE];
-
-     /* The next two tables could be made to use less space in memory, since they
-      * overlap hugely, but hey. */
-     float sintable[FFT_BUFFER_SIZE / 2];
-     float costable[FFT_BUFFER_SIZE / 2];
+     vlc_fft_t *p_fft;
+     /* The samples as floats */
+     float input[FFT_BUFFER_SIZE];
 };
 
 /* FFT prototypes */
 typedef struct _struct_fft_state fft_state;
-fft_state *visual_fft_init (void);
+fft_state *visual_fft_init (vlc_object_t *);
 void fft_perform (const sound_sample *input, float *output, fft_state *state);
 void fft_close (fft_state *state);
 
@@ -99,6 +99,17 @@
 /* Due to some problems in es_out, we cannot use a large value yet */
 #define CR_BUFFERING_TARGET (100000)
 
+/* Low latency mode:
+ * Instead of averaging the transit delay of the clock references, the
+ * stream is mapped on the smallest transit delay observed over the last
+ * CR_LL_WINDOW to 2*CR_LL_WINDOW, plus a margin covering the measured jitter.
+ * The margin is raised immediately when a clock reference arrives late
+ * (the outputs drop or repeat frames), and lowered by at most CR_LL_SLEW
+ * per mille of the elapsed time (the audio output resamples). */
+#define CR_LL_WINDOW (2 * CLOCK_FREQ)
+#define CR_LL_JITTER_RELEASE (10 * CLOCK_FREQ)
+#define CR_LL_SLEW (10)
+
 /*****************************************************************************
  * Structures
  *****************************************************************************/
@@ -173,6 +184,20 @@ struct input_clock_t
     mtime_t       i_external_clock;
     bool          b_has_external_clock;
 
+    /* Low latency mode */
+    struct
+    {
+        bool    b_enabled;
+        bool    b_active; /* enabled and the source pace is not controlled */
+        mtime_t i_transit;      /* minimal transit delay */
+        mtime_t i_transit_cur;  /* minimal transit delay of the window */
+        mtime_t i_transit_prev; /* minimal transit delay of the last window */
+        mtime_t i_window_end;
+        mtime_t i_jitter;       /* jitter envelope */
+        mtime_t i_offset;       /* applied transit delay and margin */
+        mtime_t i_last;         /* system date of the last update */
+    } ll;
+
     /* Current modifiers */
     bool    b_paused;
     int     i_rate;
@@ -184,6 +209,9 @@ static mtime_t ClockStreamToSystem( input_clock_t *, mtime_t i_stream );
 static mtime_t ClockSystemToStream( input_clock_t *, mtime_t i_system );
 
 static mtime_t ClockGetTsOffset( input_clock_t * );
+static mtime_t ClockGetDrift( input_clock_t * );
+static void    ClockUpdateLowLatency( input_clock_t *, bool b_reset,
+                                      mtime_t i_ck_stream, mtime_t i_ck_system );
 
 /*****************************************************************************
  * input_clock_New: create a new clock
@@ -212,6 +240,9 @@ input_clock_t *input_clock_New( int i_rate )
     for( int i = 0; i < INPUT_CLOCK_LATE_COUNT; i++ )
         cl->late.pi_value[i] = 0;
 
+    cl->ll.b_enabled = false;
+    cl->ll.b_active = false;
+
     cl->i_rate = i_rate;
     cl->i_pts_delay = 0;
     cl->b_paused = false;
@@ -291,6 +322,10 @@ void input_clock_Update( input_clock_t *cl, vlc_object_t *p_log,
         cl->i_next_drift_update = i_ck_system + CLOCK_FREQ/5; /* FIXME why that */
     }
 
+    cl->ll.b_active = cl->ll.b_enabled && !b_can_pace_control;
+    if( cl->ll.b_active )
+        ClockUpdateLowLatency( cl, b_reset_reference, i_ck_stream, i_ck_system );
+
     /* Update the extra buffering value */
     if( !b_can_pace_control || b_reset_reference )
     {
@@ -314,10 +349,11 @@ void input_clock_Update( input_clock_t *cl, vlc_object_t *p_log,
 
     /* It does not take the decoder latency into account but it is not really
      * the goal of the clock here */
-    const mtime_t i_system_expected = ClockStreamToSystem( cl, i_ck_stream + AvgGet( &cl->drift ) );
+    const mtime_t i_system_expected = ClockStreamToSystem( cl, i_ck_stream + ClockGetDrift( cl ) );
     const mtime_t i_late = ( i_ck_system - cl->i_pts_delay ) - i_system_expected;
-    *pb_late = i_late > 0;
-    if( i_late > 0 )
+    /* In low latency mode, the margin was already raised instead */
+    *pb_late = i_late > 0 && !cl->ll.b_active;
+    if( *pb_late )
     {
         cl->late.pi_value[cl->late.i_index] = i_late;
         cl->late.i_index = ( cl->late.i_index + 1 ) % INPUT_CLOCK_LATE_COUNT;
@@ -432,7 +468,7 @@ int input_clock_ConvertTS( vlc_object_t *p_object, input_clock_t *cl,
     /* */
     if( *pi_ts0 > VLC_TS_INVALID )
     {
-        *pi_ts0 = ClockStreamToSystem( cl, *pi_ts0 + AvgGet( &cl->drift ) );
+        *pi_ts0 = ClockStreamToSystem( cl, *pi_ts0 + ClockGetDrift( cl ) );
         if( *pi_ts0 > cl->i_ts_max )
             cl->i_ts_max = *pi_ts0;
         *pi_ts0 += i_ts_delay;
@@ -441,7 +477,7 @@ int input_clock_ConvertTS( vlc_object_t *p_object, input_clock_t *cl,
     /* XXX we do not update i_ts_max on purpose */
     if( pi_ts1 && *pi_ts1 > VLC_TS_INVALID )
     {
-        *pi_ts1 = ClockStreamToSystem( cl, *pi_ts1 + AvgGet( &cl->drift ) ) +
+        *pi_ts1 = ClockStreamToSystem( cl, *pi_ts1 + ClockGetDrift( cl ) ) +
                   i_ts_delay;
     }
 
@@ -576,6 +612,31 @@ void input_clock_SetJitter( input_clock_t *cl,
     vlc_mutex_unlock( &cl->lock );
 }
 
+void input_clock_SetLowLatency( input_clock_t *cl, bool b_enabled )
+{
+    vlc_mutex_lock( &cl->lock );
+    cl->ll.b_enabled = b_enabled;
+    if( !b_enabled )
+        cl->ll.b_active = false;
+    vlc_mutex_unlock( &cl->lock );
+}
+
+int input_clock_GetLowLatency( input_clock_t *cl,
+                               mtime_t *pi_jitter, mtime_t *pi_buffering )
+{
+    vlc_mutex_lock( &cl->lock );
+    if( !cl->ll.b_active || !cl->b_has_reference )
+    {
+        vlc_mutex_unlock( &cl->lock );
+        return VLC_EGENERIC;
+    }
+
+    *pi_jitter = cl->ll.i_jitter;
+    *pi_buffering = cl->ll.i_offset - cl->ll.i_transit + cl->i_pts_delay;
+    vlc_mutex_unlock( &cl->lock );
+    return VLC_SUCCESS;
+}
+
 mtime_t input_clock_GetJitter( input_clock_t *cl )
 {
     vlc_mutex_lock( &cl->lock );
@@ -622,6 +683,67 @@ static mtime_t ClockSystemToStream( input_clock_t *cl, mtime_t i_system )
             cl->ref.i_stream;
 }
 
+/**
+ * It returns the stream clock offset of the stream to system mapping
+ */
+static mtime_t ClockGetDrift( input_clock_t *cl )
+{
+    return cl->ll.b_active ? cl->ll.i_offset : AvgGet( &cl->drift );
+}
+
+/**
+ * It updates the low latency mapping with a new clock reference
+ */
+static void ClockUpdateLowLatency( input_clock_t *cl, bool b_reset,
+                                   mtime_t i_ck_stream, mtime_t i_ck_system )
+{
+    const mtime_t i_transit = ClockSystemToStream( cl, i_ck_system ) - i_ck_stream;
+
+    if( b_reset )
+    {
+        cl->ll.i_transit = cl->ll.i_transit_cur = cl->ll.i_transit_prev = i_transit;
+        cl->ll.i_window_end = i_ck_system + CR_LL_WINDOW;
+        cl->ll.i_jitter = 0;
+        cl->ll.i_offset = i_transit;
+        cl->ll.i_last = i_ck_system;
+        return;
+    }
+
+    /* Minimal transit delay over a sliding window */
+    if( i_ck_system >= cl->ll.i_window_end )
+    {
+        cl->ll.i_transit_prev = cl->ll.i_transit_cur;
+        cl->ll.i_transit_cur = i_transit;
+        cl->ll.i_window_end = i_ck_system + CR_LL_WINDOW;
+    }
+    else if( i_transit < cl->ll.i_transit_cur )
+        cl->ll.i_transit_cur = i_transit;
+    cl->ll.i_transit = __MIN( cl->ll.i_transit_cur, cl->ll.i_transit_prev );
+
+    /* Jitter envelope: instant attack, slow release */
+    const mtime_t i_elapsed = __MAX( i_ck_system - cl->ll.i_last, 0 );
+    const mtime_t i_residue = i_transit - cl->ll.i_transit;
+
+    if( i_residue >= cl->ll.i_jitter )
+        cl->ll.i_jitter = i_residue;
+    else
+        cl->ll.i_jitter -= (cl->ll.i_jitter - i_residue) *
+                           __MIN( i_elapsed, CR_LL_JITTER_RELEASE ) /
+                           CR_LL_JITTER_RELEASE;
+
+    /* Late clock reference: catch up at once rather than rebuffering */
+    const mtime_t i_target = cl->ll.i_transit + cl->ll.i_jitter * 5 / 4;
+    if( i_transit > cl->ll.i_offset )
+        cl->ll.i_offset = __MAX( i_target, i_transit );
+    else if( i_target > cl->ll.i_offset )
+        cl->ll.i_offset = __MIN( i_target, cl->ll.i_offset +
+                                 i_elapsed * CR_LL_SLEW / 1000 );
+    else
+        cl->ll.i_offset = __MAX( i_target, cl->ll.i_offset -
+                                 i_elapsed * CR_LL_SLEW / 1000 );
+    cl->ll.i_last = i_ck_system;
+}
+
 /**
  * It returns timestamp display offset due to ref/last modfied on rate changes
  * It ensures that currently converted dates are not changed.
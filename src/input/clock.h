@@ -130,6 +130,22 @@ int input_clock_GetState( input_clock_t *,
 void input_clock_SetJitter( input_clock_t *,
                             mtime_t i_pts_delay, int i_cr_average );
 
+/**
+ * This function enables the low latency mode for sources whose pace cannot be
+ * controlled: the stream is mapped on the minimal transit delay of the clock
+ * references plus a margin adapted to their jitter, and late clock references
+ * raise the margin instead of causing a rebufferization.
+ */
+void input_clock_SetLowLatency( input_clock_t *, bool b_enabled );
+
+/**
+ * This function returns the jitter estimation and the resulting buffering
+ * (margin and pts_delay) of the low latency mode, or VLC_EGENERIC if the mode
+ * is not active.
+ */
+int input_clock_GetLowLatency( input_clock_t *,
+                               mtime_t *pi_jitter, mtime_t *pi_buffering );
+
 /**
  * This function returns an estimation of the pts_delay needed to avoid rebufferization.
  * XXX in the current implementation, the pts_delay will never be decreased.
@@ -64,6 +64,14 @@ enum reload
     RELOAD_DECODER_AOUT /* Stop the aout and reload the decoder module */
 };
 
+enum decoder_stage
+{
+    DECODER_STAGE_QUEUED,   /* entering the decoder fifo */
+    DECODER_STAGE_DECODING, /* leaving the decoder fifo */
+    DECODER_STAGE_OUTPUT,   /* queued to the audio or video output */
+    DECODER_STAGE_COUNT
+};
+
 struct decoder_owner_sys_t
 {
     input_thread_t  *p_input;
@@ -141,6 +149,16 @@ struct decoder_owner_sys_t
 
     /* Delay */
     mtime_t i_ts_delay;
+
+    /* Low latency statistics: sums of the remaining time until the display
+     * date of the buffers reaching each stage (protected by lock) */
+    struct
+    {
+        bool     b_enabled;
+        mtime_t  i_next_report;
+        unsigned pi_count[DECODER_STAGE_COUNT];
+        mtime_t  pi_margin[DECODER_STAGE_COUNT];
+    } latency;
 };
 
 /* Pictures which are DECODER_BOGUS_VIDEO_DELAY or more in advance probably have
@@ -149,6 +167,7 @@ struct decoder_owner_sys_t
 
 /* */
 #define DECODER_SPU_VOUT_WAIT_DURATION ((int)(0.200*CLOCK_FREQ))
+#define DECODER_LATENCY_REPORT_PERIOD (5*CLOCK_FREQ)
 #define BLOCK_FLAG_CORE_PRIVATE_RELOADED (1 << BLOCK_FLAG_CORE_PRIVATE_SHIFT)
 
 /**
@@ -539,6 +558,8 @@ static int vout_update_format( decoder_t *p_dec )
             msg_Err( p_dec, "failed to create video output" );
             return -1;
         }
+        vout_ChangeLowLatency( p_vout,
+                               var_InheritBool( p_dec, "low-latency-live" ) );
     }
 
     if ( memcmp( &p_dec->fmt_out.video.mastering,
@@ -824,6 +845,86 @@ static void DecoderFixTs( decoder_t *p_dec, mtime_t *pi_ts0, mtime_t *pi_ts1,
         *pi_rate = i_rate;
 }
 
+/* Must be called with the lock held */
+static void DecoderAddLatency( decoder_owner_sys_t *p_owner,
+                               enum decoder_stage i_stage, mtime_t i_date )
+{
+    p_owner->latency.pi_count[i_stage]++;
+    p_owner->latency.pi_margin[i_stage] += i_date - mdate();
+}
+
+/* Must be called with the lock held */
+static void DecoderAddBlockLatency( decoder_t *p_dec,
+                                    enum decoder_stage i_stage,
+                                    const block_t *p_block )
+{
+    decoder_owner_sys_t *p_owner = p_dec->p_owner;
+    mtime_t i_ts = p_block->i_pts > VLC_TS_INVALID ? p_block->i_pts
+                                                   : p_block->i_dts;
+    mtime_t i_stream_start, i_system_start, i_stream_duration, i_system_duration;
+
+    vlc_assert_locked( &p_owner->lock );
+
+    /* Do not complain about the missing clock reference */
+    if( i_ts <= VLC_TS_INVALID || p_owner->p_clock == NULL
+     || input_clock_GetState( p_owner->p_clock, &i_stream_start,
+                              &i_system_start, &i_stream_duration,
+                              &i_system_duration ) )
+        return;
+
+    i_ts += p_owner->i_ts_delay;
+    if( !input_clock_ConvertTS( VLC_OBJECT(p_dec), p_owner->p_clock, NULL,
+                                &i_ts, NULL, INT64_MAX ) )
+        DecoderAddLatency( p_owner, i_stage, i_ts );
+}
+
+/**
+ * Logs the average time spent by the buffers in each stage
+ */
+static void DecoderReportLatency( decoder_t *p_dec )
+{
+    decoder_owner_sys_t *p_owner = p_dec->p_owner;
+    mtime_t pi_avg[DECODER_STAGE_COUNT];
+    bool b_complete = true;
+
+    vlc_mutex_lock( &p_owner->lock );
+    const mtime_t i_now = mdate();
+    if( i_now < p_owner->latency.i_next_report )
+    {
+        vlc_mutex_unlock( &p_owner->lock );
+        return;
+    }
+    p_owner->latency.i_next_report = i_now + DECODER_LATENCY_REPORT_PERIOD;
+
+    for( int i = 0; i < DECODER_STAGE_COUNT; i++ )
+    {
+        unsigned i_count = p_owner->latency.pi_count[i];
+
+        if( i_count == 0 )
+            b_complete = false;
+        else
+            pi_avg[i] = p_owner->latency.pi_margin[i] / i_count;
+        p_owner->latency.pi_count[i] = 0;
+        p_owner->latency.pi_margin[i] = 0;
+    }
+    vlc_mutex_unlock( &p_owner->lock );
+
+    if( !b_complete )
+        return;
+
+    mtime_t i_jitter, i_buffering;
+    if( p_owner->p_clock == NULL
+     || input_clock_GetLowLatency( p_owner->p_clock, &i_jitter, &i_buffering ) )
+        i_jitter = i_buffering = 0;
+
+    msg_Dbg( p_dec, "latency: clock buffering %"PRId64" ms (jitter %"PRId64
+             " ms), decoder queue %"PRId64" ms, decoding %"PRId64" ms, "
+             "output queue %"PRId64" ms", i_buffering / 1000, i_jitter / 1000,
+             (pi_avg[DECODER_STAGE_QUEUED] - pi_avg[DECODER_STAGE_DECODING]) / 1000,
+             (pi_avg[DECODER_STAGE_DECODING] - pi_avg[DECODER_STAGE_OUTPUT]) / 1000,
+             pi_avg[DECODER_STAGE_OUTPUT] / 1000 );
+}
+
 #ifdef ENABLE_SOUT
 static int DecoderPlaySout( decoder_t *p_dec, block_t *p_sout_block )
 {
@@ -1049,9 +1150,14 @@ static int DecoderPlayVideo( decoder_t *p_dec, picture_t *p_picture,
     int i_rate = INPUT_RATE_DEFAULT;
     DecoderFixTs( p_dec, &p_picture->date, NULL, NULL,
                   &i_rate, DECODER_BOGUS_VIDEO_DELAY );
+    if( p_owner->latency.b_enabled && p_picture->date > VLC_TS_INVALID )
+        DecoderAddLatency( p_owner, DECODER_STAGE_OUTPUT, p_picture->date );
 
     vlc_mutex_unlock( &p_owner->lock );
 
+    if( p_owner->latency.b_enabled )
+        DecoderReportLatency( p_dec );
+
     /* FIXME: The *input* FIFO should not be locked here. This will not work
      * properly if/when pictures are queued asynchronously. */
     vlc_fifo_Lock( p_owner->p_fifo );
@@ -1178,8 +1284,13 @@ static int DecoderPlayAudio( decoder_t *p_dec, block_t *p_audio,
     DecoderWaitUnblock( p_dec );
     DecoderFixTs( p_dec, &p_audio->i_pts, NULL, &p_audio->i_length,
                   &i_rate, AOUT_MAX_ADVANCE_TIME );
+    if( p_owner->latency.b_enabled && p_audio->i_pts > VLC_TS_INVALID )
+        DecoderAddLatency( p_owner, DECODER_STAGE_OUTPUT, p_audio->i_pts );
     vlc_mutex_unlock( &p_owner->lock );
 
+    if( p_owner->latency.b_enabled )
+        DecoderReportLatency( p_dec );
+
     audio_output_t *p_aout = p_owner->p_aout;
 
     if( p_aout != NULL && p_audio->i_pts > VLC_TS_INVALID
@@ -1616,6 +1727,12 @@ static void *DecoderThread( void *p_data )
         vlc_fifo_Unlock( p_owner->p_fifo );
 
         int canc = vlc_savecancel();
+        if( p_owner->latency.b_enabled && p_block != NULL )
+        {
+            vlc_mutex_lock( &p_owner->lock );
+            DecoderAddBlockLatency( p_dec, DECODER_STAGE_DECODING, p_block );
+            vlc_mutex_unlock( &p_owner->lock );
+        }
         DecoderProcess( p_dec, p_block );
 
         if( p_block == NULL )
@@ -1701,6 +1818,16 @@ static decoder_t * CreateDecoder( vlc_object_t *p_parent,
     atomic_init( &p_owner->reload, RELOAD_NO_REQUEST );
     p_owner->b_idle = false;
 
+    p_owner->latency.b_enabled = p_input != NULL && p_sout == NULL
+        && ( fmt->i_cat == VIDEO_ES || fmt->i_cat == AUDIO_ES )
+        && var_InheritBool( p_dec, "low-latency-live" );
+    p_owner->latency.i_next_report = mdate() + DECODER_LATENCY_REPORT_PERIOD;
+    for( int i = 0; i < DECODER_STAGE_COUNT; i++ )
+    {
+        p_owner->latency.pi_count[i] = 0;
+        p_owner->latency.pi_margin[i] = 0;
+    }
+
     es_format_Init( &p_owner->fmt, fmt->i_cat, 0 );
 
     /* decoder fifo */
@@ -2031,6 +2158,13 @@ void input_DecoderDecode( decoder_t *p_dec, block_t *p_block, bool b_do_pace )
 {
     decoder_owner_sys_t *p_owner = p_dec->p_owner;
 
+    if( p_owner->latency.b_enabled )
+    {
+        vlc_mutex_lock( &p_owner->lock );
+        DecoderAddBlockLatency( p_dec, DECODER_STAGE_QUEUED, p_block );
+        vlc_mutex_unlock( &p_owner->lock );
+    }
+
     vlc_fifo_Lock( p_owner->p_fifo );
     if( !b_do_pace )
     {
@@ -156,6 +156,7 @@ struct es_out_sys_t
     mtime_t     i_pts_jitter;
     int         i_cr_average;
     int         i_rate;
+    bool        b_low_latency;
 
     /* */
     bool        b_paused;
@@ -328,6 +329,7 @@ es_out_t *input_EsOutNew( input_thread_t *p_input, int i_rate )
     p_sys->i_pause_date = -1;
 
     p_sys->i_rate = i_rate;
+    p_sys->b_low_latency = false; /* Fixed with the jitter */
 
     p_sys->b_buffering = true;
     p_sys->i_preroll_end = -1;
@@ -1105,6 +1107,7 @@ static es_out_pgrm_t *EsOutProgramAdd( es_out_t *out, int i_group )
     if( p_sys->b_paused )
         input_clock_ChangePause( p_pgrm->p_clock, p_sys->b_paused, p_sys->i_pause_date );
     input_clock_SetJitter( p_pgrm->p_clock, p_sys->i_pts_delay, p_sys->i_cr_average );
+    input_clock_SetLowLatency( p_pgrm->p_clock, p_sys->b_low_latency );
 
     /* Append it */
     TAB_APPEND( p_sys->i_pgrm, p_sys->pgrm, p_pgrm );
@@ -2828,6 +2831,17 @@ static int EsOutControlLocked( es_out_t *out, int i_query, va_list args )
             i_pts_delay + i_pts_jitter != p_sys->i_pts_delay ||
             i_cr_average != p_sys->i_cr_average;
 
+        /* The input enables low latency once it knows the source is live */
+        const bool b_low_latency = var_InheritBool( p_sys->p_input,
+                                                    "low-latency-live" );
+        if( b_low_latency != p_sys->b_low_latency )
+        {
+            p_sys->b_low_latency = b_low_latency;
+            for( int i = 0; i < p_sys->i_pgrm; i++ )
+                input_clock_SetLowLatency( p_sys->pgrm[i]->p_clock,
+                                           b_low_latency );
+        }
+
         assert( i_pts_jitter >= 0 );
         p_sys->i_pts_delay  = i_pts_delay + i_pts_jitter;
         p_sys->i_pts_jitter = i_pts_jitter;
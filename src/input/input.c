@@ -1242,6 +1242,19 @@ static void UpdatePtsDelay( input_thread_t *p_input )
     if( i_pts_delay < 0 )
         i_pts_delay = 0;
 
+    /* In low latency mode, the clock adds the measured jitter */
+    const bool b_low_latency = var_InheritBool( p_input, "low-latency" )
+                            && !p_sys->b_can_pace_control;
+    if( b_low_latency )
+    {
+        const mtime_t i_min_delay =
+            INT64_C(1000) * var_InheritInteger( p_input, "low-latency-delay" );
+        if( i_pts_delay > i_min_delay )
+            i_pts_delay = i_min_delay;
+    }
+    /* The decoders also avoid their reordering and threading delays */
+    var_SetBool( p_input, "low-latency-live", b_low_latency );
+
     /* Take care of audio/spu delay */
     const mtime_t i_audio_delay = var_GetInteger( p_input, "audio-delay" );
     const mtime_t i_spu_delay   = var_GetInteger( p_input, "spu-delay" );
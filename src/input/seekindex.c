@@ -0,0 +1,617 @@
+/*****************************************************************************
+ * seekindex.c: persistent demuxer seek index
+ *****************************************************************************
+ * Copyright (C) 2020 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <assert.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+#include <vlc_common.h>
+#include <vlc_configuration.h>
+#include <vlc_fs.h>
+#include <vlc_md5.h>
+#include <vlc_memstream.h>
+#include <vlc_seekindex.h>
+#include <vlc_stream.h>
+#include <vlc_url.h>
+
+/*
+ * Index files are stored as <cache dir>/seekindex/<md5>.idx, where the hash
+ * covers the stream URL and the index name. All the integers are stored as
+ * LEB128 variable-length integers; entries are delta-coded against the
+ * previous entry of the same track, which keeps a keyframe index of a few
+ * bytes per entry.
+ */
+#define SEEKINDEX_DIR    "seekindex"
+#define SEEKINDEX_MAGIC  "VLCSIDX\x01"
+#define SEEKINDEX_MAX_SIZE (256 << 20)
+
+struct seekindex_track
+{
+    unsigned i_id;
+    size_t i_count;
+    size_t i_alloc;
+    vlc_seekindex_entry_t *p_entries;
+};
+
+struct seekindex_range
+{
+    uint64_t i_start;
+    uint64_t i_end;
+};
+
+struct vlc_seekindex_t
+{
+    vlc_object_t *obj;
+    char *psz_path;
+    char *psz_url;
+    char *psz_name;
+    uint64_t i_size;
+    int64_t i_mtime;
+    bool b_dirty;
+
+    size_t i_tracks;
+    struct seekindex_track *p_tracks;
+    size_t i_ranges;
+    struct seekindex_range *p_ranges;
+};
+
+/*****************************************************************************
+ * Tracks and ranges
+ *****************************************************************************/
+static struct seekindex_track *FindTrack( const vlc_seekindex_t *idx,
+                                          unsigned id )
+{
+    for( size_t i = 0; i < idx->i_tracks; i++ )
+        if( idx->p_tracks[i].i_id == id )
+            return &idx->p_tracks[i];
+    return NULL;
+}
+
+static struct seekindex_track *GetTrack( vlc_seekindex_t *idx, unsigned id )
+{
+    struct seekindex_track *track = FindTrack( idx, id );
+    if( track != NULL )
+        return track;
+
+    track = realloc( idx->p_tracks, (idx->i_tracks + 1) * sizeof( *track ) );
+    if( unlikely(track == NULL) )
+        return NULL;
+    idx->p_tracks = track;
+    track = &idx->p_tracks[idx->i_tracks++];
+    track->i_id = id;
+    track->i_count = track->i_alloc = 0;
+    track->p_entries = NULL;
+    return track;
+}
+
+static int Reserve( struct seekindex_track *track, size_t i_count )
+{
+    if( i_count <= track->i_alloc )
+        return VLC_SUCCESS;
+
+    size_t i_alloc = track->i_alloc ? track->i_alloc : 64;
+    while( i_alloc < i_count )
+        i_alloc *= 2;
+
+    if( i_alloc > SIZE_MAX / sizeof( vlc_seekindex_entry_t ) )
+        return VLC_ENOMEM;
+    vlc_seekindex_entry_t *p = realloc( track->p_entries,
+                                        i_alloc * sizeof( *p ) );
+    if( unlikely(p == NULL) )
+        return VLC_ENOMEM;
+    track->p_entries = p;
+    track->i_alloc = i_alloc;
+    return VLC_SUCCESS;
+}
+
+static int Compare( const vlc_seekindex_entry_t *a,
+                    const vlc_seekindex_entry_t *b )
+{
+    if( a->i_time != b->i_time )
+        return a->i_time < b->i_time ? -1 : 1;
+    if( a->i_pos != b->i_pos )
+        return a->i_pos < b->i_pos ? -1 : 1;
+    return 0;
+}
+
+int vlc_seekindex_Add( vlc_seekindex_t *idx, unsigned id,
+                       const vlc_seekindex_entry_t *entry )
+{
+    struct seekindex_track *track = GetTrack( idx, id );
+    if( unlikely(track == NULL) )
+        return VLC_ENOMEM;
+
+    /* Entries are mostly added in order: check the tail first */
+    size_t lo = track->i_count, hi = track->i_count;
+    if( lo > 0 && Compare( entry, &track->p_entries[lo - 1] ) <= 0 )
+    {
+        lo = 0;
+        while( lo < hi )
+        {
+            size_t mid = lo + (hi - lo) / 2;
+            if( Compare( &track->p_entries[mid], entry ) < 0 )
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        if( lo < track->i_count &&
+            Compare( &track->p_entries[lo], entry ) == 0 )
+            return VLC_SUCCESS;
+    }
+
+    if( Reserve( track, track->i_count + 1 ) )
+        return VLC_ENOMEM;
+
+    memmove( &track->p_entries[lo + 1], &track->p_entries[lo],
+             (track->i_count - lo) * sizeof( *entry ) );
+    track->p_entries[lo] = *entry;
+    track->i_count++;
+    idx->b_dirty = true;
+    return VLC_SUCCESS;
+}
+
+size_t vlc_seekindex_Count( const vlc_seekindex_t *idx, unsigned id )
+{
+    const struct seekindex_track *track = FindTrack( idx, id );
+    return track != NULL ? track->i_count : 0;
+}
+
+const vlc_seekindex_entry_t *vlc_seekindex_Get( const vlc_seekindex_t *idx,
+                                                unsigned id, size_t i )
+{
+    const struct seekindex_track *track = FindTrack( idx, id );
+    assert( track != NULL && i < track->i_count );
+    return &track->p_entries[i];
+}
+
+ssize_t vlc_seekindex_Lookup( const vlc_seekindex_t *idx, unsigned id,
+                              int64_t time, uint32_t flags )
+{
+    const struct seekindex_track *track = FindTrack( idx, id );
+    if( track == NULL )
+        return -1;
+
+    /* First entry after the given time */
+    size_t lo = 0, hi = track->i_count;
+    while( lo < hi )
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if( track->p_entries[mid].i_time <= time )
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    while( lo > 0 )
+    {
+        const vlc_seekindex_entry_t *entry = &track->p_entries[--lo];
+        if( (entry->i_flags & flags) == flags )
+            return lo;
+    }
+    return -1;
+}
+
+int vlc_seekindex_AddRange( vlc_seekindex_t *idx, uint64_t start,
+                            uint64_t end )
+{
+    if( start >= end || vlc_seekindex_Covers( idx, start, end ) )
+        return VLC_SUCCESS;
+
+    /* Ranges [i, j) overlap or touch the new range */
+    size_t i = 0;
+    while( i < idx->i_ranges && idx->p_ranges[i].i_end < start )
+        i++;
+    size_t j = i;
+    while( j < idx->i_ranges && idx->p_ranges[j].i_start <= end )
+        j++;
+
+    if( i < j )
+    {
+        start = __MIN( start, idx->p_ranges[i].i_start );
+        end = __MAX( end, idx->p_ranges[j - 1].i_end );
+        memmove( &idx->p_ranges[i + 1], &idx->p_ranges[j],
+                 (idx->i_ranges - j) * sizeof( *idx->p_ranges ) );
+        idx->i_ranges -= j - i - 1;
+    }
+    else
+    {
+        struct seekindex_range *p = realloc( idx->p_ranges,
+                                        (idx->i_ranges + 1) * sizeof( *p ) );
+        if( unlikely(p == NULL) )
+            return VLC_ENOMEM;
+        idx->p_ranges = p;
+        memmove( &idx->p_ranges[i + 1], &idx->p_ranges[i],
+                 (idx->i_ranges - i) * sizeof( *p ) );
+        idx->i_ranges++;
+    }
+    idx->p_ranges[i].i_start = start;
+    idx->p_ranges[i].i_end = end;
+    idx->b_dirty = true;
+    return VLC_SUCCESS;
+}
+
+size_t vlc_seekindex_CountRanges( const vlc_seekindex_t *idx )
+{
+    return idx->i_ranges;
+}
+
+void vlc_seekindex_GetRange( const vlc_seekindex_t *idx, size_t i,
+                             uint64_t *start, uint64_t *end )
+{
+    assert( i < idx->i_ranges );
+    *start = idx->p_ranges[i].i_start;
+    *end = idx->p_ranges[i].i_end;
+}
+
+bool vlc_seekindex_Covers( const vlc_seekindex_t *idx, uint64_t start,
+                           uint64_t end )
+{
+    for( size_t i = 0; i < idx->i_ranges; i++ )
+        if( idx->p_ranges[i].i_start <= start && end <= idx->p_ranges[i].i_end )
+            return true;
+    return false;
+}
+
+/*****************************************************************************
+ * Serialization
+ *****************************************************************************/
+static void PutVarint( struct vlc_memstream *ms, uint64_t v )
+{
+    while( v >= 0x80 )
+    {
+        vlc_memstream_putc( ms, (v & 0x7f) | 0x80 );
+        v >>= 7;
+    }
+    vlc_memstream_putc( ms, v );
+}
+
+static void PutSigned( struct vlc_memstream *ms, int64_t v )
+{
+    PutVarint( ms, ((uint64_t)v << 1) ^ (uint64_t)(v >> 63) );
+}
+
+static void PutString( struct vlc_memstream *ms, const char *psz )
+{
+    size_t i_len = strlen( psz );
+    PutVarint( ms, i_len );
+    vlc_memstream_write( ms, psz, i_len );
+}
+
+struct reader
+{
+    const uint8_t *p;
+    const uint8_t *end;
+    bool b_error;
+};
+
+static uint64_t GetVarint( struct reader *r )
+{
+    uint64_t v = 0;
+
+    for( unsigned shift = 0; shift < 64; shift += 7 )
+    {
+        if( r->p >= r->end )
+            break;
+        uint8_t c = *(r->p++);
+        v |= (uint64_t)(c & 0x7f) << shift;
+        if( !(c & 0x80) )
+            return v;
+    }
+    r->b_error = true;
+    return 0;
+}
+
+static int64_t GetSigned( struct reader *r )
+{
+    uint64_t v = GetVarint( r );
+    return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+static bool CheckString( struct reader *r, const char *psz )
+{
+    uint64_t i_len = GetVarint( r );
+    if( r->b_error || i_len > (uint64_t)(r->end - r->p) )
+    {
+        r->b_error = true;
+        return false;
+    }
+    bool b_match = i_len == strlen( psz ) && !memcmp( r->p, psz, i_len );
+    r->p += i_len;
+    return b_match;
+}
+
+static void Serialize( const vlc_seekindex_t *idx, struct vlc_memstream *ms )
+{
+    vlc_memstream_write( ms, SEEKINDEX_MAGIC, 8 );
+    PutString( ms, idx->psz_url );
+    PutString( ms, idx->psz_name );
+    PutVarint( ms, idx->i_size );
+    PutSigned( ms, idx->i_mtime );
+
+    PutVarint( ms, idx->i_ranges );
+    uint64_t i_prev = 0;
+    for( size_t i = 0; i < idx->i_ranges; i++ )
+    {
+        PutVarint( ms, idx->p_ranges[i].i_start - i_prev );
+        PutVarint( ms, idx->p_ranges[i].i_end - idx->p_ranges[i].i_start );
+        i_prev = idx->p_ranges[i].i_end;
+    }
+
+    PutVarint( ms, idx->i_tracks );
+    for( size_t i = 0; i < idx->i_tracks; i++ )
+    {
+        const struct seekindex_track *track = &idx->p_tracks[i];
+        int64_t i_time = 0;
+        uint64_t i_pos = 0;
+
+        PutVarint( ms, track->i_id );
+        PutVarint( ms, track->i_count );
+        for( size_t j = 0; j < track->i_count; j++ )
+        {
+            const vlc_seekindex_entry_t *e = &track->p_entries[j];
+
+            PutSigned( ms, e->i_time - i_time );
+            PutSigned( ms, (int64_t)(e->i_pos - i_pos) );
+            PutVarint( ms, e->i_size );
+            PutVarint( ms, e->i_flags );
+            i_time = e->i_time;
+            i_pos = e->i_pos;
+        }
+    }
+}
+
+static int Deserialize( vlc_seekindex_t *idx, struct reader *r )
+{
+    if( r->end - r->p < 8 || memcmp( r->p, SEEKINDEX_MAGIC, 8 ) )
+        return VLC_EGENERIC;
+    r->p += 8;
+
+    /* Hash collision, or the file has changed */
+    if( !CheckString( r, idx->psz_url ) || !CheckString( r, idx->psz_name ) ||
+        GetVarint( r ) != idx->i_size || GetSigned( r ) != idx->i_mtime )
+        return VLC_EGENERIC;
+
+    uint64_t i_ranges = GetVarint( r ), i_prev = 0;
+    for( uint64_t i = 0; i < i_ranges && !r->b_error; i++ )
+    {
+        uint64_t i_start = i_prev + GetVarint( r );
+        i_prev = i_start + GetVarint( r );
+        if( vlc_seekindex_AddRange( idx, i_start, i_prev ) )
+            return VLC_ENOMEM;
+    }
+
+    uint64_t i_tracks = GetVarint( r );
+    for( uint64_t i = 0; i < i_tracks && !r->b_error; i++ )
+    {
+        unsigned i_id = GetVarint( r );
+        uint64_t i_count = GetVarint( r );
+        /* Each entry takes at least 4 bytes */
+        if( r->b_error || i_count > (uint64_t)(r->end - r->p) / 4 ||
+            FindTrack( idx, i_id ) != NULL )
+            return VLC_EGENERIC;
+
+        struct seekindex_track *track = GetTrack( idx, i_id );
+        if( unlikely(track == NULL) || Reserve( track, i_count ) )
+            return VLC_ENOMEM;
+
+        vlc_seekindex_entry_t e = { .i_time = 0, .i_pos = 0 };
+        for( uint64_t j = 0; j < i_count; j++ )
+        {
+            e.i_time += GetSigned( r );
+            e.i_pos += GetSigned( r );
+            e.i_size = GetVarint( r );
+            e.i_flags = GetVarint( r );
+            if( j > 0 && Compare( &track->p_entries[j - 1], &e ) >= 0 )
+                r->b_error = true;
+            track->p_entries[j] = e;
+        }
+        track->i_count = i_count;
+    }
+
+    return r->b_error ? VLC_EGENERIC : VLC_SUCCESS;
+}
+
+static void Clear( vlc_seekindex_t *idx )
+{
+    for( size_t i = 0; i < idx->i_tracks; i++ )
+        free( idx->p_tracks[i].p_entries );
+    free( idx->p_tracks );
+    free( idx->p_ranges );
+    idx->p_tracks = NULL;
+    idx->p_ranges = NULL;
+    idx->i_tracks = idx->i_ranges = 0;
+}
+
+static void Load( vlc_seekindex_t *idx )
+{
+    FILE *file = vlc_fopen( idx->psz_path, "rb" );
+    if( file == NULL )
+        return;
+
+    struct stat st;
+    uint8_t *p_data = NULL;
+    if( fstat( fileno( file ), &st ) == 0 && st.st_size > 0 &&
+        st.st_size <= SEEKINDEX_MAX_SIZE )
+    {
+        p_data = malloc( st.st_size );
+        if( p_data != NULL && fread( p_data, st.st_size, 1, file ) != 1 )
+        {
+            free( p_data );
+            p_data = NULL;
+        }
+    }
+    fclose( file );
+    if( p_data == NULL )
+        return;
+
+    struct reader r = { p_data, p_data + st.st_size, false };
+    if( Deserialize( idx, &r ) )
+    {
+        msg_Dbg( idx->obj, "discarding seek index %s", idx->psz_path );
+        Clear( idx );
+    }
+    else
+        msg_Dbg( idx->obj, "loaded seek index %s (%zu tracks, %zu ranges)",
+                 idx->psz_path, idx->i_tracks, idx->i_ranges );
+    idx->b_dirty = false;
+    free( p_data );
+}
+
+static void Save( vlc_seekindex_t *idx )
+{
+    struct vlc_memstream ms;
+    char *psz_tmp;
+
+    if( asprintf( &psz_tmp, "%s.tmp", idx->psz_path ) < 0 )
+        return;
+
+    if( vlc_memstream_open( &ms ) )
+    {
+        free( psz_tmp );
+        return;
+    }
+    Serialize( idx, &ms );
+    if( vlc_memstream_close( &ms ) )
+    {
+        free( psz_tmp );
+        return;
+    }
+
+    FILE *file = vlc_fopen( psz_tmp, "wb" );
+    if( file == NULL )
+    {
+        msg_Warn( idx->obj, "cannot write seek index %s: %s", psz_tmp,
+                  vlc_strerror_c( errno ) );
+        goto end;
+    }
+
+    bool b_error = fwrite( ms.ptr, ms.length, 1, file ) != 1;
+    if( fclose( file ) || b_error )
+    {
+        msg_Warn( idx->obj, "cannot write seek index %s", psz_tmp );
+        vlc_unlink( psz_tmp );
+    }
+    else if( vlc_rename( psz_tmp, idx->psz_path ) )
+    {
+        msg_Warn( idx->obj, "cannot rename seek index: %s",
+                  vlc_strerror_c( errno ) );
+        vlc_unlink( psz_tmp );
+    }
+
+end:
+    free( ms.ptr );
+    free( psz_tmp );
+}
+
+/*****************************************************************************
+ * Open/Close
+ *****************************************************************************/
+/* Returns the index file path, creating the index directory if needed */
+static char *GetPath( const char *psz_url, const char *psz_name )
+{
+    char *psz_cache = config_GetUserDir( VLC_CACHE_DIR );
+    if( psz_cache == NULL )
+        return NULL;
+
+    char *psz_dir, *psz_path = NULL;
+    if( asprintf( &psz_dir, "%s" DIR_SEP SEEKINDEX_DIR, psz_cache ) < 0 )
+    {
+        free( psz_cache );
+        return NULL;
+    }
+    vlc_mkdir( psz_cache, 0700 );
+    vlc_mkdir( psz_dir, 0700 );
+    free( psz_cache );
+
+    struct md5_s md5;
+    InitMD5( &md5 );
+    AddMD5( &md5, psz_url, strlen( psz_url ) + 1 );
+    AddMD5( &md5, psz_name, strlen( psz_name ) );
+    EndMD5( &md5 );
+
+    char *psz_hash = psz_md5_hash( &md5 );
+    if( psz_hash != NULL &&
+        asprintf( &psz_path, "%s" DIR_SEP "%s.idx", psz_dir, psz_hash ) < 0 )
+        psz_path = NULL;
+    free( psz_hash );
+    free( psz_dir );
+    return psz_path;
+}
+
+#undef vlc_seekindex_Open
+vlc_seekindex_t *vlc_seekindex_Open( vlc_object_t *obj, stream_t *s,
+                                     const char *psz_name )
+{
+    /* Only regular local files can be indexed */
+    if( !var_InheritBool( obj, "seek-index" ) || s->psz_url == NULL ||
+        strncasecmp( s->psz_url, "file://", 7 ) )
+        return NULL;
+
+    char *psz_file = vlc_uri2path( s->psz_url );
+    if( psz_file == NULL )
+        return NULL;
+
+    struct stat st;
+    int i_ret = vlc_stat( psz_file, &st );
+    free( psz_file );
+    if( i_ret || !S_ISREG( st.st_mode ) )
+        return NULL;
+
+    vlc_seekindex_t *idx = calloc( 1, sizeof( *idx ) );
+    if( unlikely(idx == NULL) )
+        return NULL;
+
+    idx->obj = obj;
+    idx->i_size = st.st_size;
+    idx->i_mtime = st.st_mtime;
+    idx->psz_url = strdup( s->psz_url );
+    idx->psz_name = strdup( psz_name );
+    if( unlikely(idx->psz_url == NULL || idx->psz_name == NULL) )
+        goto error;
+
+    idx->psz_path = GetPath( idx->psz_url, idx->psz_name );
+    if( idx->psz_path == NULL )
+        goto error;
+
+    Load( idx );
+    return idx;
+
+error:
+    free( idx->psz_name );
+    free( idx->psz_url );
+    free( idx );
+    return NULL;
+}
+
+void vlc_seekindex_Close( vlc_seekindex_t *idx )
+{
+    if( idx->b_dirty )
+        Save( idx );
+
+    Clear( idx );
+    free( idx->psz_path );
+    free( idx->psz_name );
+    free( idx->psz_url );
+    free( idx );
+}
@@ -34,6 +34,7 @@
 
 #include <vlc_common.h>
 #include <vlc_block.h>
+#include <vlc_atomic.h>
 #include <vlc_memory.h>
 #include <vlc_access.h>
 #include <vlc_charset.h>
@@ -387,6 +388,119 @@ static ssize_t vlc_stream_CopyBlock(block_t **restrict pp,
     return likely(len > 0) ? (ssize_t)len : -1;
 }
 
+/**
+ * Shared storage for blocks split by vlc_stream_SplitBlock().
+ *
+ * The original block is kept alive until every view onto it is released.
+ */
+struct vlc_stream_block_share
+{
+    block_t *origin;
+    atomic_uint refs;
+};
+
+struct vlc_stream_block_view
+{
+    block_t self;
+    struct vlc_stream_block_share *share;
+};
+
+static void vlc_stream_BlockViewRelease(block_t *block)
+{
+    struct vlc_stream_block_view *view =
+        container_of(block, struct vlc_stream_block_view, self);
+    struct vlc_stream_block_share *share = view->share;
+
+    free(view);
+
+    if (atomic_fetch_sub(&share->refs, 1) == 1)
+    {
+        block_Release(share->origin);
+        free(share);
+    }
+}
+
+static block_t *vlc_stream_BlockViewNew(struct vlc_stream_block_share *share,
+                                        uint8_t *buf, size_t len)
+{
+    struct vlc_stream_block_view *view = malloc(sizeof (*view));
+    if (unlikely(view == NULL))
+        return NULL;
+
+    block_Init(&view->self, buf, len);
+    view->self.pf_release = vlc_stream_BlockViewRelease;
+    view->share = share;
+    return &view->self;
+}
+
+/**
+ * Splits a block without copying its payload.
+ *
+ * On success, the leading len bytes of *pp are returned as a new block, and
+ * *pp is updated to refer to the remaining bytes. Both blocks share the same
+ * storage, but their buffers do not overlap, so either can be written to.
+ *
+ * \return the leading block, or NULL on error (*pp is then left untouched)
+ */
+static block_t *vlc_stream_SplitBlock(block_t **restrict pp, size_t len)
+{
+    block_t *block = *pp;
+    struct vlc_stream_block_share *share;
+    block_t *head;
+
+    assert(len > 0 && len < block->i_buffer);
+
+    if (block->pf_release == vlc_stream_BlockViewRelease)
+    {   /* Already a view: add a leading view and shrink the existing one */
+        share = container_of(block, struct vlc_stream_block_view,
+                             self)->share;
+
+        head = vlc_stream_BlockViewNew(share, block->p_buffer, len);
+        if (unlikely(head == NULL))
+            return NULL;
+
+        atomic_fetch_add(&share->refs, 1);
+        block_CopyProperties(head, block);
+        block->p_buffer += len;
+        block->i_buffer -= len;
+        block->p_start = block->p_buffer;
+        block->i_size = block->i_buffer;
+        /* Same properties as a fresh tail view */
+        block->i_flags = 0;
+        block->i_nb_samples = 0;
+        block->i_pts = block->i_dts = VLC_TS_INVALID;
+        block->i_length = 0;
+        return head;
+    }
+
+    share = malloc(sizeof (*share));
+    if (unlikely(share == NULL))
+        return NULL;
+
+    share->origin = block;
+    atomic_init(&share->refs, 2);
+
+    head = vlc_stream_BlockViewNew(share, block->p_buffer, len);
+    if (unlikely(head == NULL))
+    {
+        free(share);
+        return NULL;
+    }
+
+    block_t *tail = vlc_stream_BlockViewNew(share, block->p_buffer + len,
+                                            block->i_buffer - len);
+    if (unlikely(tail == NULL))
+    {
+        free(head);
+        free(share);
+        return NULL;
+    }
+
+    block_CopyProperties(head, block);
+    *pp = tail;
+    return head;
+}
+
 static ssize_t vlc_stream_ReadRaw(stream_t *s, void *buf, size_t len)
 {
     stream_priv_t *priv = (stream_priv_t *)s;
@@ -475,6 +589,9 @@ ssize_t vlc_stream_Read(stream_t *s, void *buf, size_t len)
     return copied;
 }
 
+/** Peek size above which the peek buffer is grown geometrically */
+#define STREAM_PEEK_GROW_MIN 4096
+
 ssize_t vlc_stream_Peek(stream_t *s, const uint8_t **restrict bufp, size_t len)
 {
     stream_priv_t *priv = (stream_priv_t *)s;
@@ -500,8 +617,20 @@ ssize_t vlc_stream_Peek(stream_t *s, const uint8_t **restrict bufp, size_t len)
     if (peek->i_buffer < len)
     {
         size_t avail = peek->i_buffer;
+        size_t size = len;
 
-        peek = block_TryRealloc(peek, 0, len);
+        /* Grow large peek buffers geometrically, so that demuxers peeking
+         * progressively further do not reallocate and copy the same data
+         * over and over again. */
+        if (len > STREAM_PEEK_GROW_MIN && peek->p_start + peek->i_size
+                                        < peek->p_buffer + len)
+        {
+            size = avail + (avail / 2);
+            if (size < len)
+                size = len;
+        }
+
+        peek = block_TryRealloc(peek, 0, size);
         if (unlikely(peek == NULL))
             return VLC_ENOMEM;
 
@@ -579,6 +708,86 @@ block_t *vlc_stream_ReadBlock(stream_t *s)
     return block;
 }
 
+block_t *vlc_stream_ReadBlocks(stream_t *s, size_t len)
+{
+    stream_priv_t *priv = (stream_priv_t *)s;
+    block_t *chain = NULL, **last = &chain;
+
+    while (len > 0)
+    {
+        block_t **pp;
+
+        if (priv->peek != NULL)
+            pp = &priv->peek;
+        else if (priv->block != NULL)
+            pp = &priv->block;
+        else if (s->pf_block != NULL)
+        {
+            bool eof = false;
+
+            if (vlc_killed())
+                break;
+
+            priv->block = s->pf_block(s, &eof);
+            if (priv->block == NULL)
+            {
+                if (eof)
+                {
+                    priv->eof = true;
+                    break;
+                }
+                continue;
+            }
+            pp = &priv->block;
+        }
+        else
+        {   /* Byte stream back-end: there is nothing to share. */
+            block_t *block = block_Alloc(len);
+            if (unlikely(block == NULL))
+                break;
+
+            ssize_t val = vlc_stream_Read(s, block->p_buffer, len);
+            if (val <= 0)
+            {
+                block_Release(block);
+                break;
+            }
+
+            block->i_buffer = val;
+            block_ChainLastAppend(&last, block);
+            break;
+        }
+
+        block_t *block = *pp;
+
+        if (block->i_buffer <= len)
+            *pp = NULL; /* Take the whole block */
+        else
+        {
+            block = vlc_stream_SplitBlock(pp, len);
+            if (unlikely(block == NULL))
+            {   /* Fall back to copying */
+                block = block_Alloc(len);
+                if (unlikely(block == NULL))
+                    break;
+                vlc_stream_CopyBlock(pp, block->p_buffer, len);
+            }
+        }
+
+        if (block->i_buffer == 0)
+        {
+            block_Release(block);
+            continue;
+        }
+
+        priv->offset += block->i_buffer;
+        len -= block->i_buffer;
+        block_ChainLastAppend(&last, block);
+    }
+
+    return chain;
+}
+
 uint64_t vlc_stream_Tell(const stream_t *s)
 {
     const stream_priv_t *priv = (const stream_priv_t *)s;
@@ -702,18 +911,9 @@ block_t *vlc_stream_Block( stream_t *s, size_t size )
     if( unlikely(size > SSIZE_MAX) )
         return NULL;
 
-    block_t *block = block_Alloc( size );
-    if( unlikely(block == NULL) )
-        return NULL;
-
-    ssize_t val = vlc_stream_Read( s, block->p_buffer, size );
-    if( val <= 0 )
-    {
-        block_Release( block );
-        return NULL;
-    }
-
-    block->i_buffer = val;
+    block_t *block = vlc_stream_ReadBlocks( s, size );
+    if( block != NULL && block->p_next != NULL )
+        block = block_ChainGather( block );
     return block;
 }
 
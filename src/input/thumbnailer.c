@@ -0,0 +1,727 @@
+/*****************************************************************************
+ * thumbnailer.c: Thumbnailing API
+ *****************************************************************************
+ * Copyright (C) 2020 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <assert.h>
+
+#include <vlc_common.h>
+#include <vlc_atomic.h>
+#include <vlc_codec.h>
+#include <vlc_demux.h>
+#include <vlc_es_out.h>
+#include <vlc_input_item.h>
+#include <vlc_interrupt.h>
+#include <vlc_modules.h>
+#include <vlc_picture.h>
+#include <vlc_thumbnailer.h>
+
+#include "demux.h"
+#include "input_internal.h"
+#include "stream.h"
+#include "../misc/background_worker.h"
+#include "../misc/interrupt.h"
+
+/*
+ * The thumbnailer does not rely on an input thread: an input thread always
+ * comes with its clock, its ES output and its resources (vout, aout), none of
+ * which are wanted here. Each request instead drives its own demuxer, with
+ * an ES output that only feeds the first video track into a packetizer and a
+ * decoder, and stops as soon as a picture is decoded.
+ */
+
+struct vlc_thumbnailer_t
+{
+    vlc_object_t *parent;
+    struct background_worker *worker;
+};
+
+struct vlc_thumbnailer_request_t
+{
+    vlc_thumbnailer_t *thumbnailer;
+    input_item_t *item;
+
+    bool b_pos;
+    mtime_t i_time;
+    float f_pos;
+    enum vlc_thumbnailer_seek_speed speed;
+
+    vlc_thumbnailer_cb cb;
+    void *data;
+
+    atomic_uint refs;
+    atomic_bool cancelled;
+};
+
+struct es_out_id_t
+{
+    bool b_decoded;
+};
+
+/* A running request */
+struct thumbnailer_task
+{
+    es_out_t out;
+
+    vlc_thumbnailer_request_t *req;
+    struct background_worker *worker;
+    vlc_object_t *obj;
+
+    vlc_thread_t thread;
+    vlc_interrupt_t interrupt;
+    atomic_bool active;
+
+    decoder_t *packetizer;
+    decoder_t *decoder;
+    video_format_t fmt;
+
+    /* Pictures are dropped until the demuxer has reached the requested time
+     * (precise seek only) */
+    bool b_reached;
+    mtime_t i_display_date;
+    picture_t *picture;
+};
+
+/*****************************************************************************
+ * Decoder
+ *****************************************************************************/
+static int VideoFormatUpdate( decoder_t *dec )
+{
+    struct thumbnailer_task *task = (void *)dec->p_owner;
+
+    if( !dec->fmt_out.video.i_width || !dec->fmt_out.video.i_height
+     || dec->fmt_out.video.i_width < dec->fmt_out.video.i_visible_width
+     || dec->fmt_out.video.i_height < dec->fmt_out.video.i_visible_height )
+        return -1;
+
+    video_format_t *fmt = &task->fmt;
+
+    video_format_Clean( fmt );
+    video_format_Copy( fmt, &dec->fmt_out.video );
+    fmt->i_chroma = dec->fmt_out.i_codec;
+
+    if( !fmt->i_visible_width || !fmt->i_visible_height )
+    {
+        fmt->i_visible_width = fmt->i_width;
+        fmt->i_visible_height = fmt->i_height;
+        fmt->i_x_offset = fmt->i_y_offset = 0;
+    }
+    if( !fmt->i_sar_num || !fmt->i_sar_den )
+        fmt->i_sar_num = fmt->i_sar_den = 1;
+    return 0;
+}
+
+static picture_t *VideoBufferNew( decoder_t *dec )
+{
+    struct thumbnailer_task *task = (void *)dec->p_owner;
+
+    if( task->fmt.i_chroma != dec->fmt_out.i_codec
+     && VideoFormatUpdate( dec ) )
+        return NULL;
+    return picture_NewFromFormat( &task->fmt );
+}
+
+static int QueueVideo( decoder_t *dec, picture_t *pic )
+{
+    struct thumbnailer_task *task = (void *)dec->p_owner;
+
+    if( task->picture == NULL
+     && ( task->b_reached || ( task->i_display_date > VLC_TS_INVALID
+                            && pic->date >= task->i_display_date ) ) )
+        task->picture = pic;
+    else
+        picture_Release( pic );
+    return 0;
+}
+
+static int DecoderLoad( decoder_t *dec, const char *capability,
+                        const es_format_t *fmt )
+{
+    es_format_Copy( &dec->fmt_in, fmt );
+    es_format_Init( &dec->fmt_out, fmt->i_cat, 0 );
+
+    dec->p_module = module_need( dec, capability, NULL, false );
+    if( dec->p_module == NULL )
+    {
+        es_format_Clean( &dec->fmt_in );
+        return VLC_EGENERIC;
+    }
+    return VLC_SUCCESS;
+}
+
+static void DecoderUnload( decoder_t *dec )
+{
+    if( dec->p_module != NULL )
+    {
+        module_unneed( dec, dec->p_module );
+        dec->p_module = NULL;
+        es_format_Clean( &dec->fmt_out );
+        es_format_Clean( &dec->fmt_in );
+    }
+    if( dec->p_description != NULL )
+    {
+        vlc_meta_Delete( dec->p_description );
+        dec->p_description = NULL;
+    }
+}
+
+static void DecoderDelete( struct thumbnailer_task *task )
+{
+    if( task->decoder != NULL )
+    {
+        DecoderUnload( task->decoder );
+        vlc_object_release( task->decoder );
+        task->decoder = NULL;
+    }
+    if( task->packetizer != NULL )
+    {
+        DecoderUnload( task->packetizer );
+        vlc_object_release( task->packetizer );
+        task->packetizer = NULL;
+    }
+}
+
+static int DecoderNew( struct thumbnailer_task *task, const es_format_t *fmt )
+{
+    decoder_t *packetizer = vlc_object_create( task->obj, sizeof(*packetizer) );
+    if( unlikely(packetizer == NULL) )
+        return VLC_ENOMEM;
+    task->packetizer = packetizer;
+
+    decoder_t *dec = vlc_object_create( task->obj, sizeof(*dec) );
+    if( unlikely(dec == NULL) )
+        goto error;
+    task->decoder = dec;
+
+    dec->p_owner = (void *)task;
+    dec->pf_vout_format_update = VideoFormatUpdate;
+    dec->pf_vout_buffer_new = VideoBufferNew;
+    dec->pf_queue_video = QueueVideo;
+    /* The picture is the very point of the request: never drop it */
+    dec->b_frame_drop_allowed = false;
+
+    /* Decoding hints: the decoder is alone on its thread, picture quality
+     * does not matter much, and in fast mode, any key frame will do. */
+    var_Create( dec, "avcodec-hw", VLC_VAR_STRING );
+    var_SetString( dec, "avcodec-hw", "none" );
+    var_Create( dec, "avcodec-threads", VLC_VAR_INTEGER );
+    var_SetInteger( dec, "avcodec-threads", 1 );
+    var_Create( dec, "avcodec-hurry-up", VLC_VAR_BOOL );
+    var_SetBool( dec, "avcodec-hurry-up", false );
+    if( task->req->speed == VLC_THUMBNAILER_SEEK_FAST )
+    {
+        var_Create( dec, "avcodec-fast", VLC_VAR_BOOL );
+        var_SetBool( dec, "avcodec-fast", true );
+        /* AVDISCARD_NONREF */
+        var_Create( dec, "avcodec-skip-frame", VLC_VAR_INTEGER );
+        var_SetInteger( dec, "avcodec-skip-frame", 1 );
+        /* AVDISCARD_ALL */
+        var_Create( dec, "avcodec-skiploopfilter", VLC_VAR_INTEGER );
+        var_SetInteger( dec, "avcodec-skiploopfilter", 4 );
+    }
+
+    if( DecoderLoad( packetizer, "packetizer", fmt ) )
+        goto error;
+    if( DecoderLoad( dec, "video decoder", &packetizer->fmt_out ) )
+        goto error;
+    return VLC_SUCCESS;
+
+error:
+    DecoderDelete( task );
+    return VLC_EGENERIC;
+}
+
+static void DecoderProcess( struct thumbnailer_task *task, block_t *block )
+{
+    decoder_t *packetizer = task->packetizer;
+    decoder_t *dec = task->decoder;
+    block_t **pp_block = block != NULL ? &block : NULL;
+    block_t *packet;
+
+    while( task->picture == NULL
+        && (packet = packetizer->pf_packetize( packetizer, pp_block )) != NULL )
+    {
+        if( !es_format_IsSimilar( &dec->fmt_in, &packetizer->fmt_out ) )
+        {
+            DecoderUnload( dec );
+            if( DecoderLoad( dec, "video decoder", &packetizer->fmt_out ) )
+            {
+                block_ChainRelease( packet );
+                goto error;
+            }
+        }
+
+        while( packet != NULL )
+        {
+            block_t *next = packet->p_next;
+
+            packet->p_next = NULL;
+            if( task->picture != NULL )
+                block_Release( packet );
+            else if( dec->pf_decode( dec, packet ) == VLCDEC_ECRITICAL )
+            {
+                block_ChainRelease( next );
+                goto error;
+            }
+            packet = next;
+        }
+    }
+
+    if( block == NULL ) /* drain */
+    {
+        if( task->picture == NULL )
+            dec->pf_decode( dec, NULL );
+        return;
+    }
+    if( task->picture != NULL )
+        block_Release( block );
+    return;
+
+error:
+    /* The decoder cannot be reloaded: give up on this track */
+    DecoderDelete( task );
+    if( block != NULL )
+        block_Release( block );
+}
+
+/*****************************************************************************
+ * ES output
+ *****************************************************************************/
+static es_out_id_t *EsOutAdd( es_out_t *out, const es_format_t *fmt )
+{
+    struct thumbnailer_task *task = (struct thumbnailer_task *)out;
+    es_out_id_t *id = malloc( sizeof(*id) );
+
+    if( unlikely(id == NULL) )
+        return NULL;
+
+    id->b_decoded = fmt->i_cat == VIDEO_ES && task->decoder == NULL
+                 && fmt->i_priority >= ES_PRIORITY_SELECTABLE_MIN
+                 && DecoderNew( task, fmt ) == VLC_SUCCESS;
+    if( id->b_decoded )
+        msg_Dbg( task->obj, "decoding video track %d (%4.4s)", fmt->i_id,
+                 (const char *)&fmt->i_codec );
+    return id;
+}
+
+static int EsOutSend( es_out_t *out, es_out_id_t *id, block_t *block )
+{
+    struct thumbnailer_task *task = (struct thumbnailer_task *)out;
+
+    if( id->b_decoded && task->decoder != NULL )
+        DecoderProcess( task, block );
+    else
+        block_Release( block );
+    return VLC_SUCCESS;
+}
+
+static void EsOutDel( es_out_t *out, es_out_id_t *id )
+{
+    struct thumbnailer_task *task = (struct thumbnailer_task *)out;
+
+    if( id->b_decoded && task->decoder != NULL )
+    {
+        DecoderProcess( task, NULL );
+        DecoderDelete( task );
+    }
+    free( id );
+}
+
+static int EsOutControl( es_out_t *out, int query, va_list args )
+{
+    struct thumbnailer_task *task = (struct thumbnailer_task *)out;
+
+    switch( query )
+    {
+        case ES_OUT_GET_ES_STATE:
+        {
+            es_out_id_t *id = va_arg( args, es_out_id_t * );
+            *va_arg( args, bool * ) = id->b_decoded;
+            break;
+        }
+        case ES_OUT_SET_NEXT_DISPLAY_TIME:
+        {
+            mtime_t date = va_arg( args, mtime_t );
+            if( task->req->speed == VLC_THUMBNAILER_SEEK_PRECISE
+             && !task->req->b_pos )
+                task->i_display_date = date;
+            break;
+        }
+        case ES_OUT_GET_EMPTY:
+            *va_arg( args, bool * ) = true;
+            break;
+        case ES_OUT_SET_ES:
+        case ES_OUT_SET_ES_DEFAULT:
+        case ES_OUT_SET_ES_STATE:
+        case ES_OUT_SET_ES_CAT_POLICY:
+        case ES_OUT_SET_GROUP:
+        case ES_OUT_SET_PCR:
+        case ES_OUT_SET_GROUP_PCR:
+        case ES_OUT_RESET_PCR:
+        case ES_OUT_SET_ES_FMT:
+        case ES_OUT_SET_GROUP_META:
+        case ES_OUT_SET_GROUP_EPG:
+        case ES_OUT_DEL_GROUP:
+        case ES_OUT_SET_ES_SCRAMBLED_STATE:
+        case ES_OUT_SET_META:
+            break;
+        default:
+            return VLC_EGENERIC;
+    }
+    return VLC_SUCCESS;
+}
+
+static void EsOutDestroy( es_out_t *out )
+{
+    (void) out;
+}
+
+/*****************************************************************************
+ * Request processing
+ *****************************************************************************/
+static demux_t *DemuxNew( struct thumbnailer_task *task, const char *mrl )
+{
+    const char *psz_access, *psz_demux, *psz_path, *psz_anchor;
+    char *dup = strdup( mrl );
+
+    if( unlikely(dup == NULL) )
+        return NULL;
+
+    input_SplitMRL( &psz_access, &psz_demux, &psz_path, &psz_anchor, dup );
+    if( psz_demux == NULL || psz_demux[0] == '\0' )
+        psz_demux = "any";
+
+    /* access demux first, then a regular demux over an access stream */
+    demux_t *demux = demux_NewAdvanced( task->obj, NULL, psz_access,
+                                        psz_demux, psz_path, NULL,
+                                        &task->out, false );
+    if( demux == NULL )
+    {
+        char *base;
+        if( asprintf( &base, "%s://%s", psz_access, psz_path ) >= 0 )
+        {
+            stream_t *s = stream_AccessNew( task->obj, NULL, false, base );
+            free( base );
+            if( s != NULL )
+            {
+                demux = demux_NewAdvanced( task->obj, NULL, psz_access,
+                                           psz_demux, psz_path, s,
+                                           &task->out, false );
+                if( demux == NULL )
+                    vlc_stream_Delete( s );
+            }
+        }
+    }
+    free( dup );
+    return demux;
+}
+
+static void Seek( struct thumbnailer_task *task, demux_t *demux )
+{
+    const vlc_thumbnailer_request_t *req = task->req;
+    bool precise = req->speed == VLC_THUMBNAILER_SEEK_PRECISE;
+    int ret;
+
+    if( req->b_pos )
+    {
+        /* There is no way to tell when a position is reached. */
+        task->b_reached = true;
+        if( req->f_pos <= 0.f )
+            return;
+        ret = demux_Control( demux, DEMUX_SET_POSITION, (double) req->f_pos,
+                             precise );
+    }
+    else
+    {
+        task->b_reached = !precise || req->i_time <= 0;
+        if( req->i_time <= 0 )
+            return;
+        ret = demux_Control( demux, DEMUX_SET_TIME, req->i_time, precise );
+    }
+
+    if( ret != VLC_SUCCESS )
+    {
+        /* Not seekable: use whatever comes first */
+        msg_Warn( task->obj, "cannot seek, using the first picture" );
+        task->b_reached = true;
+    }
+}
+
+static void Process( struct thumbnailer_task *task )
+{
+    vlc_thumbnailer_request_t *req = task->req;
+    char *mrl = input_item_GetURI( req->item );
+
+    if( mrl == NULL )
+        return;
+
+    demux_t *demux = DemuxNew( task, mrl );
+    if( demux == NULL )
+    {
+        msg_Err( task->obj, "cannot open %s", mrl );
+        free( mrl );
+        return;
+    }
+    free( mrl );
+
+    Seek( task, demux );
+
+    while( task->picture == NULL && !vlc_killed() )
+    {
+        if( !task->b_reached )
+        {
+            mtime_t time;
+            if( demux_Control( demux, DEMUX_GET_TIME, &time ) != VLC_SUCCESS
+             || time >= req->i_time )
+                task->b_reached = true;
+        }
+
+        if( demux_Demux( demux ) <= 0 )
+            break;
+    }
+
+    /* Drain the decoder at end of stream */
+    if( task->picture == NULL && task->decoder != NULL && !vlc_killed() )
+    {
+        task->b_reached = true;
+        DecoderProcess( task, NULL );
+    }
+
+    demux_Delete( demux );
+    DecoderDelete( task );
+}
+
+static void *Thread( void *data )
+{
+    struct thumbnailer_task *task = data;
+
+    vlc_interrupt_set( &task->interrupt );
+    Process( task );
+
+    atomic_store( &task->active, false );
+    background_worker_RequestProbe( task->worker );
+    return NULL;
+}
+
+static void RequestRelease( void *data )
+{
+    vlc_thumbnailer_request_t *req = data;
+
+    if( atomic_fetch_sub( &req->refs, 1 ) != 1 )
+        return;
+
+    input_item_Release( req->item );
+    free( req );
+}
+
+static void RequestHold( void *data )
+{
+    vlc_thumbnailer_request_t *req = data;
+    atomic_fetch_add_explicit( &req->refs, 1, memory_order_relaxed );
+}
+
+static int StartTask( void *owner, void *entity, void **out )
+{
+    vlc_thumbnailer_t *thumbnailer = owner;
+    struct thumbnailer_task *task = malloc( sizeof(*task) );
+
+    if( unlikely(task == NULL) )
+        return VLC_ENOMEM;
+
+    task->obj = vlc_custom_create( thumbnailer->parent, sizeof(vlc_object_t),
+                                   "thumbnailer" );
+    if( unlikely(task->obj == NULL) )
+    {
+        free( task );
+        return VLC_ENOMEM;
+    }
+
+    task->out.pf_add = EsOutAdd;
+    task->out.pf_send = EsOutSend;
+    task->out.pf_del = EsOutDel;
+    task->out.pf_control = EsOutControl;
+    task->out.pf_destroy = EsOutDestroy;
+    task->out.p_sys = NULL;
+
+    task->req = entity;
+    task->worker = thumbnailer->worker;
+    task->packetizer = NULL;
+    task->decoder = NULL;
+    video_format_Init( &task->fmt, 0 );
+    task->b_reached = false;
+    task->i_display_date = VLC_TS_INVALID;
+    task->picture = NULL;
+
+    vlc_interrupt_init( &task->interrupt );
+    atomic_init( &task->active, true );
+
+    if( vlc_clone( &task->thread, Thread, task, VLC_THREAD_PRIORITY_LOW ) )
+    {
+        vlc_interrupt_deinit( &task->interrupt );
+        vlc_object_release( task->obj );
+        free( task );
+        return VLC_EGENERIC;
+    }
+
+    *out = task;
+    return VLC_SUCCESS;
+}
+
+static int ProbeTask( void *owner, void *handle )
+{
+    struct thumbnailer_task *task = handle;
+    VLC_UNUSED( owner );
+
+    return !atomic_load( &task->active );
+}
+
+static void StopTask( void *owner, void *handle )
+{
+    struct thumbnailer_task *task = handle;
+    vlc_thumbnailer_request_t *req = task->req;
+    VLC_UNUSED( owner );
+
+    /* Either done, timed out, or cancelled */
+    vlc_interrupt_kill( &task->interrupt );
+    vlc_join( task->thread, NULL );
+    vlc_interrupt_deinit( &task->interrupt );
+
+    if( task->picture != NULL )
+        msg_Dbg( task->obj, "thumbnail generated (%ux%u)",
+                 task->picture->format.i_visible_width,
+                 task->picture->format.i_visible_height );
+    else
+        msg_Warn( task->obj, "thumbnail generation failed" );
+
+    if( !atomic_load( &req->cancelled ) )
+        req->cb( req->data, task->picture );
+
+    if( task->picture != NULL )
+        picture_Release( task->picture );
+    video_format_Clean( &task->fmt );
+    vlc_object_release( task->obj );
+    free( task );
+}
+
+/*****************************************************************************
+ * Public API
+ *****************************************************************************/
+#undef vlc_thumbnailer_Create
+vlc_thumbnailer_t *vlc_thumbnailer_Create( vlc_object_t *parent )
+{
+    vlc_thumbnailer_t *thumbnailer = malloc( sizeof(*thumbnailer) );
+
+    if( unlikely(thumbnailer == NULL) )
+        return NULL;
+
+    thumbnailer->parent = parent;
+
+    struct background_worker_config conf = {
+        .default_timeout = 0,
+        .max_threads = var_InheritInteger( parent, "thumbnailer-threads" ),
+        .pf_admit = NULL,
+        .pf_start = StartTask,
+        .pf_probe = ProbeTask,
+        .pf_stop = StopTask,
+        .pf_release = RequestRelease,
+        .pf_hold = RequestHold,
+    };
+
+    thumbnailer->worker = background_worker_New( thumbnailer, &conf );
+    if( unlikely(thumbnailer->worker == NULL) )
+    {
+        free( thumbnailer );
+        return NULL;
+    }
+    return thumbnailer;
+}
+
+static vlc_thumbnailer_request_t *
+RequestNew( vlc_thumbnailer_t *thumbnailer, input_item_t *item,
+            enum vlc_thumbnailer_seek_speed speed, mtime_t timeout,
+            vlc_thumbnailer_cb cb, void *data, bool b_pos, mtime_t time,
+            float pos )
+{
+    assert( cb != NULL );
+
+    vlc_thumbnailer_request_t *req = malloc( sizeof(*req) );
+    if( unlikely(req == NULL) )
+        return NULL;
+
+    req->thumbnailer = thumbnailer;
+    req->item = item;
+    input_item_Hold( item );
+    req->b_pos = b_pos;
+    req->i_time = time;
+    req->f_pos = pos;
+    req->speed = speed;
+    req->cb = cb;
+    req->data = data;
+    atomic_init( &req->refs, 1 );
+    atomic_init( &req->cancelled, false );
+
+    /* timeouts are given in microseconds, the worker counts milliseconds */
+    int timeout_ms = timeout > 0 ? __MAX(timeout / 1000, 1) : 0;
+
+    if( background_worker_Push( thumbnailer->worker, req, req, timeout_ms ) )
+    {
+        RequestRelease( req );
+        return NULL;
+    }
+    return req;
+}
+
+vlc_thumbnailer_request_t *
+vlc_thumbnailer_RequestByTime( vlc_thumbnailer_t *thumbnailer, mtime_t time,
+                               enum vlc_thumbnailer_seek_speed speed,
+                               input_item_t *item, mtime_t timeout,
+                               vlc_thumbnailer_cb cb, void *data )
+{
+    return RequestNew( thumbnailer, item, speed, timeout, cb, data,
+                       false, time, 0.f );
+}
+
+vlc_thumbnailer_request_t *
+vlc_thumbnailer_RequestByPos( vlc_thumbnailer_t *thumbnailer, float pos,
+                              enum vlc_thumbnailer_seek_speed speed,
+                              input_item_t *item, mtime_t timeout,
+                              vlc_thumbnailer_cb cb, void *data )
+{
+    return RequestNew( thumbnailer, item, speed, timeout, cb, data,
+                       true, 0, pos );
+}
+
+void vlc_thumbnailer_DestroyRequest( vlc_thumbnailer_t *thumbnailer,
+                                     vlc_thumbnailer_request_t *req )
+{
+    assert( req->thumbnailer == thumbnailer );
+
+    atomic_store( &req->cancelled, true );
+    background_worker_Cancel( thumbnailer->worker, req );
+    RequestRelease( req );
+}
+
+void vlc_thumbnailer_Release( vlc_thumbnailer_t *thumbnailer )
+{
+    background_worker_Delete( thumbnailer->worker );
+    free( thumbnailer );
+}
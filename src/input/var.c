@@ -486,6 +486,9 @@ void input_ConfigVarInit ( input_thread_t *p_input )
     var_Create( p_input, "can-rewind", VLC_VAR_BOOL );
     var_SetBool( p_input, "can-rewind", false );
 
+    var_Create( p_input, "low-latency-live", VLC_VAR_BOOL );
+    var_SetBool( p_input, "low-latency-live", false ); /* Fixed later */
+
     var_Create( p_input, "can-record", VLC_VAR_BOOL );
     var_SetBool( p_input, "can-record", false ); /* Fixed later*/
 
@@ -48,6 +48,7 @@
 #include <vlc_vod.h>
 #include <vlc_sout.h>
 #include <vlc_url.h>
+#include <vlc_memstream.h>
 #include "../stream_output/stream_output.h"
 #include "../libvlc.h"
 
@@ -163,6 +164,8 @@ vlm_t *vlm_New ( vlc_object_t *p_this )
     p_vlm->i_id = 1;
     TAB_INIT( p_vlm->i_media, p_vlm->media );
     TAB_INIT( p_vlm->i_schedule, p_vlm->schedule );
+    TAB_INIT( p_vlm->i_share, p_vlm->share );
+    p_vlm->i_share_id = 0;
     p_vlm->p_vod = NULL;
     p_vlm->i_consecutive_errors = 0;
     var_Create( p_vlm, "intf-event", VLC_VAR_ADDRESS );
@@ -235,6 +238,10 @@ void vlm_Delete( vlm_t *p_vlm )
 
     vlm_ControlInternal( p_vlm, VLM_CLEAR_SCHEDULES );
     TAB_CLEAN( p_vlm->i_schedule, p_vlm->schedule );
+
+    /* Shared inputs go away with their last instance */
+    assert( p_vlm->i_share == 0 );
+    TAB_CLEAN( p_vlm->i_share, p_vlm->share );
     vlc_mutex_unlock( &p_vlm->lock );
 
     vlc_cancel( p_vlm->thread );
@@ -893,19 +900,42 @@ static vlm_media_instance_sys_t *vlm_MediaInstanceNew( vlm_t *p_vlm, const char
 
     p_instance->i_index = 0;
     p_instance->b_sout_keep = false;
+    p_instance->b_share = false;
+    p_instance->p_share = NULL;
+    p_instance->p_share_output = NULL;
     p_instance->p_parent = vlc_object_create( p_vlm, sizeof (vlc_object_t) );
     p_instance->p_input = NULL;
+    /* Found by the stream output of the instance, unless shared */
+    sout_StatsInit( &p_instance->stats );
+    var_Create( p_instance->p_parent, "sout-stats", VLC_VAR_ADDRESS );
+    var_SetAddress( p_instance->p_parent, "sout-stats", &p_instance->stats );
     p_instance->p_input_resource = input_resource_New( p_instance->p_parent );
 
     return p_instance;
 }
+static void vlm_MediaInstanceUnshare( vlm_media_instance_sys_t *p_instance, vlm_media_sys_t *p_media )
+{
+    var_DelCallback( p_instance->p_input, "intf-event", InputEvent, p_media );
+    vlc_object_release( p_instance->p_input );
+    p_instance->p_input = NULL;
+
+    /* The input stops with its last output */
+    vlm_ShareDetach( p_instance->p_share, p_instance->p_share_output );
+    p_instance->p_share = NULL;
+    p_instance->p_share_output = NULL;
+}
 static void vlm_MediaInstanceDelete( vlm_t *p_vlm, int64_t id, vlm_media_instance_sys_t *p_instance, vlm_media_sys_t *p_media )
 {
     input_thread_t *p_input = p_instance->p_input;
     if( p_input )
     {
-        input_Stop( p_input );
-        input_Close( p_input );
+        if( p_instance->p_share )
+            vlm_MediaInstanceUnshare( p_instance, p_media );
+        else
+        {
+            input_Stop( p_input );
+            input_Close( p_input );
+        }
 
         vlm_SendEventMediaInstanceStopped( p_vlm, id, p_media->cfg.psz_name );
     }
@@ -920,11 +950,128 @@ static void vlm_MediaInstanceDelete( vlm_t *p_vlm, int64_t id, vlm_media_instanc
 }
 
 
+static input_thread_t *vlm_InputNew( vlm_t *p_vlm, vlm_media_sys_t *p_media, vlc_object_t *p_parent, input_item_t *p_item, input_resource_t *p_resource )
+{
+    input_thread_t *p_input;
+    char *psz_log;
+
+    if( asprintf( &psz_log, _("Media: %s"), p_media->cfg.psz_name ) == -1 )
+        return NULL;
+
+    p_input = input_Create( p_parent, p_item, psz_log, p_resource, NULL );
+    free( psz_log );
+    if( !p_input )
+        return NULL;
+
+    var_AddCallback( p_input, "intf-event", InputEvent, p_media );
+
+    if (p_vlm->i_consecutive_errors)
+    {
+        int slowdown = 1 << (p_vlm->i_consecutive_errors - 1);
+        /* 100ms, 200ms, 400ms, 800ms, 1.6s, 3.2s */
+        mtime_t deadline = mdate() + slowdown * 100000L; /* usecs */
+
+        /* like a sleep, but interrupted on deletion */
+        vlc_mutex_lock(&p_vlm->lock_delete);
+        vlc_cond_timedwait(&p_vlm->wait_delete, &p_vlm->lock_delete, deadline);
+        vlc_mutex_unlock(&p_vlm->lock_delete);
+    }
+
+    if( input_Start( p_input ) != VLC_SUCCESS )
+    {
+        var_DelCallback( p_input, "intf-event", InputEvent, p_media );
+        input_Close( p_input );
+        return NULL;
+    }
+    return p_input;
+}
+
+static bool vlm_IsSoutKeepOption( const char *psz_option )
+{
+    return !strcmp( psz_option, "sout-keep" ) ||
+           !strcmp( psz_option, "nosout-keep" ) ||
+           !strcmp( psz_option, "no-sout-keep" );
+}
+
+/* Broadcast instances reading the same MRL with the same options share
+ * their input, each one only adding its stream output chain */
+static int vlm_MediaInstanceShare( vlm_t *p_vlm, vlm_media_instance_sys_t *p_instance, vlm_media_sys_t *p_media )
+{
+    const vlm_media_t *p_cfg = &p_media->cfg;
+    char *psz_uri = input_item_GetURI( p_instance->p_item );
+    struct vlc_memstream key;
+
+    if( !psz_uri )
+        return VLC_ENOMEM;
+
+    vlc_memstream_open( &key );
+    vlc_memstream_puts( &key, psz_uri );
+    for( int i = 0; i < p_cfg->i_option; i++ )
+        if( !vlm_IsSoutKeepOption( p_cfg->ppsz_option[i] ) )
+            vlc_memstream_printf( &key, "\n%s", p_cfg->ppsz_option[i] );
+    if( vlc_memstream_close( &key ) )
+    {
+        free( psz_uri );
+        return VLC_ENOMEM;
+    }
+
+    const bool b_exclusive = !var_InheritBool( p_vlm, "vlm-share" );
+    vlm_share_t *p_share = b_exclusive ? NULL
+                                       : vlm_ShareFind( p_vlm, key.ptr );
+    if( !p_share )
+    {
+        p_share = vlm_ShareNew( p_vlm, key.ptr, b_exclusive );
+        if( p_share )
+        {
+            input_item_SetURI( p_share->p_item, psz_uri );
+            for( int i = 0; i < p_cfg->i_option; i++ )
+                if( !vlm_IsSoutKeepOption( p_cfg->ppsz_option[i] ) )
+                    input_item_AddOption( p_share->p_item, p_cfg->ppsz_option[i],
+                                          VLC_INPUT_OPTION_TRUSTED );
+        }
+    }
+    else
+        msg_Dbg( p_vlm, "media %s shares the input of %s",
+                 p_cfg->psz_name, psz_uri );
+    free( key.ptr );
+    free( psz_uri );
+    if( !p_share )
+        return VLC_ENOMEM;
+
+    /* Attach before starting, so that no elementary stream is missed */
+    vlm_share_output_t *p_output =
+        vlm_ShareAttach( p_share, &p_cfg->psz_output[1], &p_instance->stats );
+    if( !p_output )
+    {
+        if( p_share->i_output == 0 )
+            vlm_ShareDelete( p_share );
+        return VLC_EGENERIC;
+    }
+
+    if( !p_share->p_input )
+    {
+        p_share->p_input = vlm_InputNew( p_vlm, p_media, p_share->p_parent,
+                                         p_share->p_item,
+                                         p_share->p_input_resource );
+        if( !p_share->p_input )
+        {
+            vlm_ShareDetach( p_share, p_output );
+            return VLC_EGENERIC;
+        }
+    }
+    else
+        var_AddCallback( p_share->p_input, "intf-event", InputEvent, p_media );
+
+    p_instance->p_share = p_share;
+    p_instance->p_share_output = p_output;
+    p_instance->p_input = vlc_object_hold( p_share->p_input );
+    return VLC_SUCCESS;
+}
+
 static int vlm_ControlMediaInstanceStart( vlm_t *p_vlm, int64_t id, const char *psz_id, int i_input_index, const char *psz_vod_output )
 {
     vlm_media_sys_t *p_media = vlm_ControlMediaGetById( p_vlm, id );
     vlm_media_instance_sys_t *p_instance;
-    char *psz_log;
 
     if( !p_media || !p_media->cfg.b_enabled || p_media->cfg.i_input <= 0 )
         return VLC_EGENERIC;
@@ -977,6 +1124,9 @@ static int vlm_ControlMediaInstanceStart( vlm_t *p_vlm, int64_t id, const char *
             else
                 input_item_AddOption( p_instance->p_item, p_cfg->ppsz_option[i], VLC_INPUT_OPTION_TRUSTED );
         }
+        /* Chains given as MRL or kept across inputs are not shared */
+        p_instance->b_share = !p_cfg->b_vod && !p_instance->b_sout_keep &&
+                              p_cfg->psz_output && p_cfg->psz_output[0] == '#';
         TAB_APPEND( p_media->i_instance, p_media->instance, p_instance );
     }
 
@@ -993,12 +1143,17 @@ static int vlm_ControlMediaInstanceStart( vlm_t *p_vlm, int64_t id, const char *
             return VLC_SUCCESS;
         }
 
-        input_Stop( p_input );
-        input_Close( p_input );
+        if( p_instance->p_share )
+            vlm_MediaInstanceUnshare( p_instance, p_media );
+        else
+        {
+            input_Stop( p_input );
+            input_Close( p_input );
 
-        if( !p_instance->b_sout_keep )
-            input_resource_TerminateSout( p_instance->p_input_resource );
-        input_resource_TerminateVout( p_instance->p_input_resource );
+            if( !p_instance->b_sout_keep )
+                input_resource_TerminateSout( p_instance->p_input_resource );
+            input_resource_TerminateVout( p_instance->p_input_resource );
+        }
 
         vlm_SendEventMediaInstanceStopped( p_vlm, id, p_media->cfg.psz_name );
     }
@@ -1015,45 +1170,26 @@ static int vlm_ControlMediaInstanceStart( vlm_t *p_vlm, int64_t id, const char *
     else
         input_item_SetURI( p_instance->p_item, p_media->cfg.ppsz_input[p_instance->i_index] ) ;
 
-    if( asprintf( &psz_log, _("Media: %s"), p_media->cfg.psz_name ) != -1 )
+    /* vlc: items have no stream output to share */
+    if( p_instance->b_share &&
+        strncasecmp( p_media->cfg.ppsz_input[p_instance->i_index], "vlc:", 4 ) )
     {
-        p_instance->p_input = input_Create( p_instance->p_parent,
-                                            p_instance->p_item, psz_log,
-                                            p_instance->p_input_resource,
-                                            NULL );
-        if( p_instance->p_input )
-        {
-            var_AddCallback( p_instance->p_input, "intf-event", InputEvent, p_media );
-
-            if (p_vlm->i_consecutive_errors)
-            {
-                int slowdown = 1 << (p_vlm->i_consecutive_errors - 1);
-                /* 100ms, 200ms, 400ms, 800ms, 1.6s, 3.2s */
-                mtime_t deadline = mdate() + slowdown * 100000L; /* usecs */
-
-                /* like a sleep, but interrupted on deletion */
-                vlc_mutex_lock(&p_vlm->lock_delete);
-                vlc_cond_timedwait(&p_vlm->wait_delete, &p_vlm->lock_delete, deadline);
-                vlc_mutex_unlock(&p_vlm->lock_delete);
-            }
-
-            if( input_Start( p_instance->p_input ) != VLC_SUCCESS )
-            {
-                var_DelCallback( p_instance->p_input, "intf-event", InputEvent, p_media );
-                input_Close( p_instance->p_input );
-                p_instance->p_input = NULL;
-            }
-        }
+        if( vlm_MediaInstanceShare( p_vlm, p_instance, p_media ) )
+            p_instance->p_input = NULL;
+    }
+    else
+        p_instance->p_input = vlm_InputNew( p_vlm, p_media,
+                                            p_instance->p_parent,
+                                            p_instance->p_item,
+                                            p_instance->p_input_resource );
 
-        if( !p_instance->p_input )
-        {
-            vlm_MediaInstanceDelete( p_vlm, id, p_instance, p_media );
-        }
-        else
-        {
-            vlm_SendEventMediaInstanceStarted( p_vlm, id, p_media->cfg.psz_name );
-        }
-        free( psz_log );
+    if( !p_instance->p_input )
+    {
+        vlm_MediaInstanceDelete( p_vlm, id, p_instance, p_media );
+    }
+    else
+    {
+        vlm_SendEventMediaInstanceStarted( p_vlm, id, p_media->cfg.psz_name );
     }
 
     return VLC_SUCCESS;
@@ -1088,6 +1224,10 @@ static int vlm_ControlMediaInstancePause( vlm_t *p_vlm, int64_t id, const char *
     if( !p_instance || !p_instance->p_input )
         return VLC_EGENERIC;
 
+    /* Other instances read the same input */
+    if( p_instance->p_share && p_instance->p_share->i_output > 1 )
+        return VLC_EGENERIC;
+
     /* Toggle pause state */
     i_state = var_GetInteger( p_instance->p_input, "state" );
     if( i_state == PAUSE_S && !p_media->cfg.b_vod )
@@ -1126,6 +1266,9 @@ static int vlm_ControlMediaInstanceSetTimePosition( vlm_t *p_vlm, int64_t id, co
     if( !p_instance || !p_instance->p_input )
         return VLC_EGENERIC;
 
+    if( p_instance->p_share && p_instance->p_share->i_output > 1 )
+        return VLC_EGENERIC;
+
     if( i_time >= 0 )
         return var_SetInteger( p_instance->p_input, "time", i_time );
     else if( d_position >= 0 && d_position <= 100 )
@@ -1159,7 +1302,11 @@ static int vlm_ControlMediaInstanceGets( vlm_t *p_vlm, int64_t id, vlm_media_ins
                 p_idsc->b_paused = true;
             p_idsc->i_rate = INPUT_RATE_DEFAULT
                              / var_GetFloat( p_instance->p_input, "rate" );
+            sout_StatsGet( &p_instance->stats,
+                           &p_idsc->i_cpu_time, &p_idsc->i_bitrate );
         }
+        if( p_instance->p_share )
+            p_idsc->b_shared = p_instance->p_share->i_output > 1;
 
         TAB_APPEND( i_idsc, pp_idsc, p_idsc );
     }
@@ -25,7 +25,36 @@
 #define LIBVLC_VLM_INTERNAL_H 1
 
 #include <vlc_vlm.h>
+#include <vlc_sout.h>
 #include "input_interface.h"
+#include "../stream_output/stream_output.h"
+
+/* Input shared by the broadcast instances of identical sources */
+typedef struct vlm_share_output_t vlm_share_output_t;
+
+typedef struct
+{
+    vlm_t *p_vlm;
+
+    /* input MRL and options */
+    char *psz_key;
+    /* not to be reused by other instances (vlm-share disabled) */
+    bool b_exclusive;
+
+    vlc_object_t     *p_parent;
+    input_item_t     *p_item;
+    input_thread_t   *p_input;
+    input_resource_t *p_input_resource;
+    sout_instance_t  *p_sout;
+
+    /* elementary streams of the input, replayed to late outputs */
+    int                   i_es;
+    sout_stream_id_sys_t **es;
+
+    /* one stream output chain per instance */
+    int                  i_output;
+    vlm_share_output_t **output;
+} vlm_share_t;
 
 /* Private */
 typedef struct
@@ -43,6 +72,14 @@ typedef struct
     input_thread_t    *p_input;
     input_resource_t *p_input_resource;
 
+    /* broadcast through a shared input */
+    bool                b_share;
+    vlm_share_t        *p_share;
+    vlm_share_output_t *p_share_output;
+
+    /* stream output statistics, shared input or not */
+    sout_stats_t        stats;
+
 } vlm_media_instance_sys_t;
 
 
@@ -113,10 +150,22 @@ struct vlm_t
     vlm_schedule_sys_t **schedule;
 
     unsigned i_consecutive_errors;
+
+    /* Shared inputs list */
+    int            i_share;
+    vlm_share_t    **share;
+    unsigned       i_share_id;
 };
 
 int vlm_ControlInternal( vlm_t *p_vlm, int i_query, ... );
 int ExecuteCommand( vlm_t *, const char *, vlm_message_t ** );
 void vlm_ScheduleDelete( vlm_t *vlm, vlm_schedule_sys_t *sched );
 
+vlm_share_t *vlm_ShareNew( vlm_t *, const char *psz_key, bool b_exclusive );
+void vlm_ShareDelete( vlm_share_t * );
+vlm_share_t *vlm_ShareFind( vlm_t *, const char *psz_key );
+vlm_share_output_t *vlm_ShareAttach( vlm_share_t *, const char *psz_chain,
+                                     sout_stats_t * );
+void vlm_ShareDetach( vlm_share_t *, vlm_share_output_t * );
+
 #endif
@@ -0,0 +1,393 @@
+/*****************************************************************************
+ * vlm_share.c: inputs shared between VLM broadcast instances
+ *****************************************************************************
+ * Copyright (C) 2020 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*****************************************************************************
+ * Broadcast instances reading the same MRL with the same options are served
+ * by a single input. Its stream output is a core stream that duplicates each
+ * elementary stream to the output chain of every attached instance, like the
+ * duplicate stream output would, except that chains can be attached and
+ * detached while the input is running.
+ *****************************************************************************/
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc_common.h>
+
+#include <assert.h>
+
+#include <vlc_block.h>
+#include <vlc_input.h>
+#include <vlc_sout.h>
+#include "vlm_internal.h"
+#include "resource.h"
+#include "../stream_output/stream_output.h"
+
+struct vlm_share_output_t
+{
+    sout_stream_t *p_stream;
+
+    /* output ES, in the same order as the shared input ES */
+    int                   i_id;
+    sout_stream_id_sys_t **id;
+
+    sout_stats_t *p_stats; /* statistics of the attached instance */
+};
+
+struct sout_stream_id_sys_t
+{
+    es_format_t fmt;
+};
+
+/* The access outputs that a chain creates account their bytes to the
+ * statistics set on the instance at that time */
+static void SetStats( vlm_share_t *p_share, sout_stats_t *p_stats )
+{
+    var_SetAddress( p_share->p_sout, "sout-stats", p_stats );
+}
+
+/*****************************************************************************
+ * Shared stream output
+ *****************************************************************************/
+static sout_stream_id_sys_t *Add( sout_stream_t *p_stream,
+                                  const es_format_t *p_fmt )
+{
+    vlm_share_t *p_share = (vlm_share_t *)p_stream->p_sys;
+    sout_stream_id_sys_t *id = malloc( sizeof( *id ) );
+
+    if( unlikely(id == NULL) )
+        return NULL;
+    if( es_format_Copy( &id->fmt, p_fmt ) )
+    {
+        free( id );
+        return NULL;
+    }
+
+    for( int i = 0; i < p_share->i_output; i++ )
+    {
+        vlm_share_output_t *p_output = p_share->output[i];
+
+        SetStats( p_share, p_output->p_stats );
+        sout_stream_id_sys_t *p_id = sout_StreamIdAdd( p_output->p_stream,
+                                                       p_fmt );
+        TAB_APPEND( p_output->i_id, p_output->id, p_id );
+    }
+    SetStats( p_share, NULL );
+    TAB_APPEND( p_share->i_es, p_share->es, id );
+    return id;
+}
+
+static void Del( sout_stream_t *p_stream, sout_stream_id_sys_t *id )
+{
+    vlm_share_t *p_share = (vlm_share_t *)p_stream->p_sys;
+    int i_es;
+
+    TAB_FIND( p_share->i_es, p_share->es, id, i_es );
+    assert( i_es >= 0 );
+
+    for( int i = 0; i < p_share->i_output; i++ )
+    {
+        vlm_share_output_t *p_output = p_share->output[i];
+
+        if( p_output->id[i_es] != NULL )
+            sout_StreamIdDel( p_output->p_stream, p_output->id[i_es] );
+        TAB_ERASE( p_output->i_id, p_output->id, i_es );
+    }
+    TAB_ERASE( p_share->i_es, p_share->es, i_es );
+
+    es_format_Clean( &id->fmt );
+    free( id );
+}
+
+static int Send( sout_stream_t *p_stream, sout_stream_id_sys_t *id,
+                 block_t *p_buffer )
+{
+    vlm_share_t *p_share = (vlm_share_t *)p_stream->p_sys;
+    int i_es;
+
+    TAB_FIND( p_share->i_es, p_share->es, id, i_es );
+    assert( i_es >= 0 );
+
+    for( int i = 0; i < p_share->i_output; i++ )
+    {
+        vlm_share_output_t *p_output = p_share->output[i];
+
+        if( p_output->id[i_es] == NULL )
+            continue;
+
+        block_t *p_dup = block_Duplicate( p_buffer );
+        if( unlikely(p_dup == NULL) )
+            continue;
+
+        sout_StatsSend( p_output->p_stats, p_output->p_stream,
+                        p_output->id[i_es], p_dup );
+    }
+    block_Release( p_buffer );
+    return VLC_SUCCESS;
+}
+
+static void Flush( sout_stream_t *p_stream, sout_stream_id_sys_t *id )
+{
+    vlm_share_t *p_share = (vlm_share_t *)p_stream->p_sys;
+    int i_es;
+
+    TAB_FIND( p_share->i_es, p_share->es, id, i_es );
+    assert( i_es >= 0 );
+
+    for( int i = 0; i < p_share->i_output; i++ )
+    {
+        vlm_share_output_t *p_output = p_share->output[i];
+
+        if( p_output->id[i_es] != NULL )
+            sout_StreamFlush( p_output->p_stream, p_output->id[i_es] );
+    }
+}
+
+static int Control( sout_stream_t *p_stream, int i_query, va_list args )
+{
+    vlm_share_t *p_share = (vlm_share_t *)p_stream->p_sys;
+
+    switch( i_query )
+    {
+        case SOUT_STREAM_EMPTY:
+        {
+            bool *pb_empty = va_arg( args, bool * );
+
+            *pb_empty = true;
+            for( int i = 0; i < p_share->i_output && *pb_empty; i++ )
+                if( sout_StreamControl( p_share->output[i]->p_stream,
+                                        SOUT_STREAM_EMPTY, pb_empty ) )
+                    *pb_empty = true;
+            return VLC_SUCCESS;
+        }
+    }
+    return VLC_EGENERIC;
+}
+
+/* Creates the stream output instance of the shared input. The instance is
+ * built around the core stream above rather than a module chain, and is
+ * identified by a unique name that the input finds in its "sout" option. */
+static sout_instance_t *SoutNew( vlm_share_t *p_share, unsigned i_id )
+{
+    sout_instance_t *p_sout = vlc_custom_create( p_share->p_parent,
+                                                 sizeof( *p_sout ),
+                                                 "stream output" );
+    if( unlikely(p_sout == NULL) )
+        return NULL;
+
+    if( asprintf( &p_sout->psz_sout, "vlm-share://%u", i_id ) == -1 )
+    {
+        vlc_object_release( p_sout );
+        return NULL;
+    }
+    p_sout->i_out_pace_nocontrol = 0;
+    vlc_mutex_init( &p_sout->lock );
+    var_Create( p_sout, "sout-mux-caching",
+                VLC_VAR_INTEGER | VLC_VAR_DOINHERIT );
+    /* Each chain has its own statistics, not the instance */
+    var_Create( p_sout, "sout-stats", VLC_VAR_ADDRESS );
+
+    sout_stream_t *p_stream = vlc_custom_create( p_sout, sizeof( *p_stream ),
+                                                 "stream out" );
+    if( unlikely(p_stream == NULL) )
+    {
+        free( p_sout->psz_sout );
+        vlc_mutex_destroy( &p_sout->lock );
+        vlc_object_release( p_sout );
+        return NULL;
+    }
+    p_stream->p_module = NULL;
+    p_stream->p_sout = p_sout;
+    p_stream->psz_name = strdup( "vlm-share" );
+    p_stream->p_cfg = NULL;
+    p_stream->p_next = NULL;
+    p_stream->pf_add = Add;
+    p_stream->pf_del = Del;
+    p_stream->pf_send = Send;
+    p_stream->pf_control = Control;
+    p_stream->pf_flush = Flush;
+    p_stream->p_sys = (void *)p_share;
+    p_stream->pace_nocontrol = false;
+
+    p_sout->p_stream = p_stream;
+    return p_sout;
+}
+
+/*****************************************************************************
+ * Shared inputs
+ *****************************************************************************/
+vlm_share_t *vlm_ShareNew( vlm_t *p_vlm, const char *psz_key,
+                           bool b_exclusive )
+{
+    vlm_share_t *p_share = calloc( 1, sizeof( *p_share ) );
+    if( unlikely(p_share == NULL) )
+        return NULL;
+
+    p_share->p_vlm = p_vlm;
+    p_share->psz_key = strdup( psz_key );
+    p_share->b_exclusive = b_exclusive;
+    p_share->p_parent = vlc_object_create( p_vlm, sizeof (vlc_object_t) );
+    p_share->p_item = input_item_New( NULL, NULL );
+    p_share->p_input = NULL;
+    TAB_INIT( p_share->i_es, p_share->es );
+    TAB_INIT( p_share->i_output, p_share->output );
+
+    if( unlikely(p_share->psz_key == NULL || p_share->p_parent == NULL
+               || p_share->p_item == NULL) )
+        goto error;
+
+    p_share->p_input_resource = input_resource_New( p_share->p_parent );
+    if( unlikely(p_share->p_input_resource == NULL) )
+        goto error;
+
+    p_share->p_sout = SoutNew( p_share, p_vlm->i_share_id++ );
+    if( unlikely(p_share->p_sout == NULL) )
+    {
+        input_resource_Release( p_share->p_input_resource );
+        goto error;
+    }
+
+    /* The resource hands the instance over to the input, that looks it up
+     * by name */
+    input_resource_RequestSout( p_share->p_input_resource, p_share->p_sout,
+                                NULL );
+
+    char *psz_option;
+    if( asprintf( &psz_option, "sout=%s", p_share->p_sout->psz_sout ) != -1 )
+    {
+        input_item_AddOption( p_share->p_item, psz_option,
+                              VLC_INPUT_OPTION_TRUSTED );
+        free( psz_option );
+    }
+
+    TAB_APPEND( p_vlm->i_share, p_vlm->share, p_share );
+    return p_share;
+
+error:
+    if( p_share->p_item != NULL )
+        input_item_Release( p_share->p_item );
+    if( p_share->p_parent != NULL )
+        vlc_object_release( p_share->p_parent );
+    free( p_share->psz_key );
+    free( p_share );
+    return NULL;
+}
+
+void vlm_ShareDelete( vlm_share_t *p_share )
+{
+    vlm_t *p_vlm = p_share->p_vlm;
+
+    assert( p_share->i_output == 0 );
+
+    if( p_share->p_input != NULL )
+    {
+        input_Stop( p_share->p_input );
+        input_Close( p_share->p_input );
+    }
+    assert( p_share->i_es == 0 );
+
+    /* Destroys the stream output instance as well */
+    input_resource_Terminate( p_share->p_input_resource );
+    input_resource_Release( p_share->p_input_resource );
+    vlc_object_release( p_share->p_parent );
+
+    TAB_REMOVE( p_vlm->i_share, p_vlm->share, p_share );
+    input_item_Release( p_share->p_item );
+    free( p_share->psz_key );
+    free( p_share );
+}
+
+vlm_share_t *vlm_ShareFind( vlm_t *p_vlm, const char *psz_key )
+{
+    for( int i = 0; i < p_vlm->i_share; i++ )
+    {
+        vlm_share_t *p_share = p_vlm->share[i];
+
+        if( p_share->b_exclusive || p_share->p_input == NULL
+         || strcmp( p_share->psz_key, psz_key ) )
+            continue;
+
+        /* Finished inputs are left to the instances that are moving on */
+        int i_state = var_GetInteger( p_share->p_input, "state" );
+        if( i_state != END_S && i_state != ERROR_S )
+            return p_share;
+    }
+    return NULL;
+}
+
+vlm_share_output_t *vlm_ShareAttach( vlm_share_t *p_share,
+                                     const char *psz_chain,
+                                     sout_stats_t *p_stats )
+{
+    sout_instance_t *p_sout = p_share->p_sout;
+    vlm_share_output_t *p_output = calloc( 1, sizeof( *p_output ) );
+
+    if( unlikely(p_output == NULL) )
+        return NULL;
+    TAB_INIT( p_output->i_id, p_output->id );
+    p_output->p_stats = p_stats;
+
+    vlc_mutex_lock( &p_sout->lock );
+    SetStats( p_share, p_stats );
+    p_output->p_stream = sout_StreamChainNew( p_sout, psz_chain, NULL, NULL );
+    if( p_output->p_stream == NULL )
+    {
+        SetStats( p_share, NULL );
+        vlc_mutex_unlock( &p_sout->lock );
+        msg_Err( p_sout, "stream chain failed for `%s'", psz_chain );
+        free( p_output );
+        return NULL;
+    }
+
+    /* Catch up with the elementary streams already running */
+    for( int i = 0; i < p_share->i_es; i++ )
+    {
+        sout_stream_id_sys_t *p_id =
+            sout_StreamIdAdd( p_output->p_stream, &p_share->es[i]->fmt );
+
+        TAB_APPEND( p_output->i_id, p_output->id, p_id );
+    }
+    SetStats( p_share, NULL );
+    TAB_APPEND( p_share->i_output, p_share->output, p_output );
+    vlc_mutex_unlock( &p_sout->lock );
+
+    msg_Dbg( p_sout, "output %d attached (chain=`%s')", p_share->i_output,
+             psz_chain );
+    return p_output;
+}
+
+void vlm_ShareDetach( vlm_share_t *p_share, vlm_share_output_t *p_output )
+{
+    sout_instance_t *p_sout = p_share->p_sout;
+
+    vlc_mutex_lock( &p_sout->lock );
+    TAB_REMOVE( p_share->i_output, p_share->output, p_output );
+    for( int i = 0; i < p_output->i_id; i++ )
+        if( p_output->id[i] != NULL )
+            sout_StreamIdDel( p_output->p_stream, p_output->id[i] );
+    sout_StreamChainDelete( p_output->p_stream, NULL );
+    vlc_mutex_unlock( &p_sout->lock );
+
+    TAB_CLEAN( p_output->i_id, p_output->id );
+    free( p_output );
+
+    if( p_share->i_output == 0 )
+        vlm_ShareDelete( p_share );
+}
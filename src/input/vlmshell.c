@@ -1359,6 +1359,20 @@ static vlm_message_t *vlm_ShowMedia( vlm_media_sys_t *p_media )
 #undef APPEND_INPUT_INFO
         vlm_MessageAdd( p_msg_instance, vlm_MessageNew( "playlistindex",
                         "%d", p_instance->i_index + 1 ) );
+        if( p_instance->p_input )
+        {
+            int64_t i_cpu_time, i_bitrate;
+
+            sout_StatsGet( &p_instance->stats, &i_cpu_time, &i_bitrate );
+            vlm_MessageAdd( p_msg_instance,
+                            vlm_MessageNew( "cputime", "%"PRId64, i_cpu_time ) );
+            vlm_MessageAdd( p_msg_instance,
+                            vlm_MessageNew( "bitrate", "%"PRId64, i_bitrate ) );
+        }
+        if( p_instance->p_share )
+            vlm_MessageAdd( p_msg_instance,
+                            vlm_MessageNew( "shared", "%d",
+                                            p_instance->p_share->i_output ) );
     }
     return p_msg;
 }
@@ -36,6 +36,7 @@
 #include <vlc_common.h>
 #include <vlc_plugin.h>
 #include <vlc_cpu.h>
+#include <vlc_cpu_budget.h>
 #include <vlc_playlist.h>
 #include "libvlc.h"
 #include "modules/modules.h"
@@ -475,6 +476,12 @@ static const char *const ppsz_pos_descriptions[] =
     "This drops frames that are late (arrive to the video output after " \
     "their intended display date)." )
 
+#define FILTER_QUEUE_TEXT N_("Pictures filtered ahead of display")
+#define FILTER_QUEUE_LONGTEXT N_( \
+    "Number of pictures the static video filters (deinterlacing and " \
+    "post-processing) prepare ahead of display, on a thread of their own " \
+    "(0 = filter on the video output thread).")
+
 #define QUIET_SYNCHRO_TEXT N_("Quiet synchro")
 #define QUIET_SYNCHRO_LONGTEXT N_( \
     "This avoids flooding the message log with debug output from the " \
@@ -530,6 +537,18 @@ static const char *const ppsz_pos_descriptions[] =
     "This defines the maximum input delay jitter that the synchronization " \
     "algorithms should try to compensate (in milliseconds)." )
 
+#define LOW_LATENCY_TEXT N_("Low latency mode")
+#define LOW_LATENCY_LONGTEXT N_( \
+    "For live sources, this replaces the caching with the measured " \
+    "network jitter, and catches up by dropping or repeating frames and " \
+    "resampling audio instead of rebuffering. Decoders avoid reordering " \
+    "delays." )
+
+#define LOW_LATENCY_DELAY_TEXT N_("Low latency minimal caching (ms)")
+#define LOW_LATENCY_DELAY_LONGTEXT N_( \
+    "Caching value for live sources in low latency mode, in milliseconds. " \
+    "The measured jitter is added to it." )
+
 #define NETSYNC_TEXT N_("Network synchronisation" )
 #define NETSYNC_LONGTEXT N_( "This allows you to remotely " \
         "synchronise clocks for server and client. The detailed settings " \
@@ -1012,6 +1031,12 @@ static const char *const ppsz_prefres[] = {
 #define DEMUX_FILTER_LONGTEXT N_( \
     "Demux filters are used to modify/control the stream that is being read." )
 
+#define SEEK_INDEX_TEXT N_("Keep demuxer seek indexes")
+#define SEEK_INDEX_LONGTEXT N_( \
+    "Store the seek points found by demuxers that have to scan local files " \
+    "(AVI, MKV, TS, PS) in the cache directory, so that seeking is fast " \
+    "the next time the same file is opened." )
+
 #define DEMUX_TEXT N_("Demux module")
 #define DEMUX_LONGTEXT N_( \
     "Demultiplexers are used to separate the \"elementary\" streams " \
@@ -1046,6 +1071,12 @@ static const char *const ppsz_prefres[] = {
 #define VLM_CONF_LONGTEXT N_( \
     "Read a VLM configuration file as soon as VLM is started." )
 
+#define VLM_SHARE_TEXT N_("Share VLM inputs")
+#define VLM_SHARE_LONGTEXT N_( \
+    "Broadcast media reading the same input with the same options are " \
+    "served by a single input, which is opened and demuxed only once " \
+    "for all their outputs." )
+
 #define PLUGINS_CACHE_TEXT N_("Use a plugins cache")
 #define PLUGINS_CACHE_LONGTEXT N_( \
     "Use a plugins cache which will greatly improve the startup time of VLC.")
@@ -1095,6 +1126,21 @@ static const char *const ppsz_prefres[] = {
     "all the processor time and render the whole system unresponsive which " \
     "might require a reboot of your machine.")
 
+#define CPU_BUDGET_TEXT N_("Codec threads")
+#define CPU_BUDGET_LONGTEXT N_( \
+    "Total number of threads shared by all the multi-threaded decoders " \
+    "and encoders (0 = number of CPUs).")
+
+#define CPU_BUDGET_WAIT_TEXT N_("Codec threads wait time (ms)")
+#define CPU_BUDGET_WAIT_LONGTEXT N_( \
+    "Maximum time a transcoding codec waits for threads to be released " \
+    "when all the codec threads are in use.")
+
+#define FILTER_THREADS_TEXT N_("Video filter threads")
+#define FILTER_THREADS_LONGTEXT N_( \
+    "Number of threads running the slices of the video filters that " \
+    "support it (0 = number of CPUs, 1 = no threading).")
+
 #define PLAYLISTENQUEUE_TEXT N_( \
     "Enqueue items into playlist in one instance mode")
 #define PLAYLISTENQUEUE_LONGTEXT N_( \
@@ -1123,6 +1169,25 @@ static const char *const ppsz_prefres[] = {
 #define PREPARSE_TIMEOUT_LONGTEXT N_( \
     "Maximum time allowed to preparse an item, in milliseconds" )
 
+#define PREPARSE_THREADS_TEXT N_( "Preparsing threads" )
+#define PREPARSE_THREADS_LONGTEXT N_( \
+    "Maximum number of items preparsed concurrently." )
+
+#define PREPARSE_LIMITS_TEXT N_( "Preparsing limits per protocol" )
+#define PREPARSE_LIMITS_LONGTEXT N_( \
+    "Maximum number of items preparsed concurrently for a given protocol, " \
+    "as a comma separated list of protocol=limit pairs. Protocols not " \
+    "listed are only limited by the number of preparsing threads." )
+
+#define PREPARSE_CACHE_TEXT N_( "Cache preparsed metadata" )
+#define PREPARSE_CACHE_LONGTEXT N_( \
+    "Keep the metadata of preparsed local files in a cache, so that " \
+    "unmodified files do not need to be preparsed again." )
+
+#define THUMBNAILER_THREADS_TEXT N_( "Thumbnailer threads" )
+#define THUMBNAILER_THREADS_LONGTEXT N_( \
+    "Maximum number of thumbnails generated concurrently." )
+
 #define METADATA_NETWORK_TEXT N_( "Allow metadata network access" )
 
 static const char *const psz_recursive_list[] = {
@@ -1563,6 +1628,8 @@ vlc_module_begin ()
         change_private ()
     add_bool( "drop-late-frames", 1, DROP_LATE_FRAMES_TEXT,
               DROP_LATE_FRAMES_LONGTEXT, true )
+    add_integer_with_range( "vout-filter-queue", 0, 0, 16, FILTER_QUEUE_TEXT,
+                            FILTER_QUEUE_LONGTEXT, true )
     /* Used in vout_synchro */
     add_bool( "skip-frames", 1, SKIP_FRAMES_TEXT,
               SKIP_FRAMES_LONGTEXT, true )
@@ -1914,6 +1981,17 @@ vlc_module_begin ()
     add_integer( "clock-jitter", 5 * CLOCK_FREQ/1000, CLOCK_JITTER_TEXT,
               CLOCK_JITTER_LONGTEXT, true )
         change_safe()
+    add_bool( "low-latency", false, LOW_LATENCY_TEXT,
+              LOW_LATENCY_LONGTEXT, true )
+        change_safe()
+    add_integer( "low-latency-delay", 20, LOW_LATENCY_DELAY_TEXT,
+                 LOW_LATENCY_DELAY_LONGTEXT, true )
+        change_integer_range( 0, 1000 )
+        change_safe()
+    /* Set by the input for live sources, see UpdatePtsDelay() */
+    add_bool( "low-latency-live", false, "", "", true )
+        change_private ()
+        change_volatile ()
 
     add_bool( "network-synchronisation", false, NETSYNC_TEXT,
               NETSYNC_LONGTEXT, true )
@@ -1946,6 +2024,7 @@ vlc_module_begin ()
 
     set_subcategory( SUBCAT_INPUT_DEMUX )
     add_module( "demux", "demux", "any", DEMUX_TEXT, DEMUX_LONGTEXT, true )
+    add_bool( "seek-index", true, SEEK_INDEX_TEXT, SEEK_INDEX_LONGTEXT, true )
     set_subcategory( SUBCAT_INPUT_ACODEC )
     set_subcategory( SUBCAT_INPUT_SCODEC )
     add_obsolete_bool( "prefer-system-codecs" )
@@ -1980,6 +2059,8 @@ vlc_module_begin ()
     set_section( N_("VLM"), NULL )
     add_loadfile( "vlm-conf", NULL, VLM_CONF_TEXT,
                     VLM_CONF_LONGTEXT, true )
+    add_bool( "vlm-share", true, VLM_SHARE_TEXT,
+              VLM_SHARE_LONGTEXT, true )
 
 
 
@@ -2020,6 +2101,16 @@ vlc_module_begin ()
 #if defined( __powerpc__ ) || defined( __ppc__ ) || defined( __ppc64__ )
     add_obsolete_bool( "altivec" ) /* since 2.0.0 */
 #endif
+    add_integer_with_range( "cpu-budget", 0, 0, 1024, CPU_BUDGET_TEXT,
+                            CPU_BUDGET_LONGTEXT, true )
+    add_integer_with_range( "cpu-budget-wait", 1000, 0, 60000,
+                            CPU_BUDGET_WAIT_TEXT, CPU_BUDGET_WAIT_LONGTEXT,
+                            true )
+    /* Set by the stream outputs that transcode, see vlc_cpu_lease_Acquire() */
+    add_integer( "cpu-priority", VLC_CPU_PRIORITY_DISPLAY, "", "", true )
+        change_private ()
+    add_integer_with_range( "filter-threads", 0, 0, 1024, FILTER_THREADS_TEXT,
+                            FILTER_THREADS_LONGTEXT, true )
 
 /* Misc options */
     set_subcategory( SUBCAT_ADVANCED_MISC )
@@ -2111,6 +2202,17 @@ vlc_module_begin ()
 
     add_integer( "preparse-timeout", 5000, PREPARSE_TIMEOUT_TEXT,
                  PREPARSE_TIMEOUT_LONGTEXT, false )
+    add_integer_with_range( "preparse-threads", 4, 1, 32,
+                            PREPARSE_THREADS_TEXT,
+                            PREPARSE_THREADS_LONGTEXT, true )
+    add_string( "preparse-protocol-limits",
+                "smb=1,nfs=1,ftp=1,ftps=1,sftp=1,http=2,https=2",
+                PREPARSE_LIMITS_TEXT, PREPARSE_LIMITS_LONGTEXT, true )
+    add_bool( "preparse-cache", true, PREPARSE_CACHE_TEXT,
+              PREPARSE_CACHE_LONGTEXT, true )
+    add_integer_with_range( "thumbnailer-threads", 4, 1, 32,
+                            THUMBNAILER_THREADS_TEXT,
+                            THUMBNAILER_THREADS_LONGTEXT, true )
 
     add_obsolete_integer( "album-art" )
     add_bool( "metadata-network-access", false, METADATA_NETWORK_TEXT,
@@ -93,6 +93,9 @@ libvlc_int_t * libvlc_InternalCreate( void )
     priv = libvlc_priv (p_libvlc);
     priv->playlist = NULL;
     priv->p_vlm = NULL;
+    priv->cpu_budget = NULL;
+    priv->filter_slices = NULL;
+    priv->fft_plans = NULL;
 
     vlc_ExitInit( &priv->exit );
 
@@ -231,6 +234,18 @@ int libvlc_InternalInit( libvlc_int_t *p_libvlc, int i_argc,
 
     priv->b_stats = var_InheritBool( p_libvlc, "stats" );
 
+    priv->cpu_budget = vlc_cpu_budget_Create( p_libvlc );
+    if( unlikely(priv->cpu_budget == NULL) )
+        goto error;
+
+    priv->filter_slices = vlc_filter_slices_Create( p_libvlc );
+    if( unlikely(priv->filter_slices == NULL) )
+        goto error;
+
+    priv->fft_plans = vlc_fft_plans_Create( p_libvlc );
+    if( unlikely(priv->fft_plans == NULL) )
+        goto error;
+
     /*
      * Initialize hotkey handling
      */
@@ -416,6 +431,15 @@ void libvlc_InternalCleanup( libvlc_int_t *p_libvlc )
     if (priv->parser != NULL)
         playlist_preparser_Delete(priv->parser);
 
+    if (priv->cpu_budget != NULL)
+        vlc_cpu_budget_Destroy(priv->cpu_budget);
+
+    if (priv->filter_slices != NULL)
+        vlc_filter_slices_Destroy(priv->filter_slices);
+
+    if (priv->fft_plans != NULL)
+        vlc_fft_plans_Destroy(priv->fft_plans);
+
     libvlc_InternalActionsClean( p_libvlc );
 
     /* Save the configuration */
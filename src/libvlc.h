@@ -45,6 +45,24 @@ size_t EnumClockSource( vlc_object_t *, const char *, char ***, char *** );
 void vlc_CPU_init(void);
 void vlc_CPU_dump(vlc_object_t *);
 
+/*
+ * Codec threads budget
+ */
+struct vlc_cpu_budget *vlc_cpu_budget_Create(libvlc_int_t *);
+void vlc_cpu_budget_Destroy(struct vlc_cpu_budget *);
+
+/*
+ * Video filter slice threads
+ */
+struct vlc_filter_slices *vlc_filter_slices_Create(libvlc_int_t *);
+void vlc_filter_slices_Destroy(struct vlc_filter_slices *);
+
+/*
+ * FFT trigonometric tables
+ */
+struct vlc_fft_plans *vlc_fft_plans_Create(libvlc_int_t *);
+void vlc_fft_plans_Destroy(struct vlc_fft_plans *);
+
 /*
  * Threads subsystem
  */
@@ -191,6 +209,9 @@ typedef struct libvlc_priv_t
     struct playlist_t *playlist; ///< Playlist for interfaces
     struct playlist_preparser_t *parser; ///< Input item meta data handler
     vlc_actions_t *actions; ///< Hotkeys handler
+    struct vlc_cpu_budget *cpu_budget; ///< Codec threads budget
+    struct vlc_filter_slices *filter_slices; ///< Video filter slice threads
+    struct vlc_fft_plans *fft_plans; ///< FFT trigonometric tables
 
     /* Exit callback */
     vlc_exit_t       exit;
@@ -34,18 +34,24 @@ struct bg_queued_item {
     int timeout; /**< timeout duration in microseconds */
 };
 
+struct bg_task {
+    void* id; /**< id of the running entity */
+    mtime_t deadline; /**< deadline of the task, VLC_TS_0 when cancelled */
+    bool probe_request; /**< true if a probe is requested */
+};
+
 struct background_worker {
     void* owner;
     struct background_worker_config conf;
 
     vlc_mutex_t lock; /**< acquire to inspect members that follow */
     struct {
-        bool probe_request; /**< true if a probe is requested */
-        vlc_cond_t wait; /**< wait for update in terms of head */
+        vlc_cond_t wait; /**< wait for a task or a thread to terminate */
         vlc_cond_t worker_wait; /**< wait for probe request or cancelation */
-        mtime_t deadline; /**< deadline of the current task */
-        void* id; /**< id of the current task */
-        bool active; /**< true if there is an active thread */
+        vlc_array_t tasks; /**< running tasks */
+        int threads; /**< number of running threads */
+        int idle; /**< number of threads waiting for an entity */
+        unsigned flush; /**< number of pending cancelations of everything */
     } head;
 
     struct {
@@ -54,68 +60,83 @@ struct background_worker {
     } tail;
 };
 
+/* Takes the first queued entity that can be started, if any */
+static struct bg_queued_item* TakeNext( struct background_worker* worker )
+{
+    for( size_t i = 0; i < vlc_array_count( &worker->tail.data ); ++i )
+    {
+        struct bg_queued_item* item =
+            vlc_array_item_at_index( &worker->tail.data, i );
+
+        if( worker->conf.pf_admit &&
+            !worker->conf.pf_admit( worker->owner, item->entity ) )
+            continue;
+
+        vlc_array_remove( &worker->tail.data, i );
+        return item;
+    }
+    return NULL;
+}
+
+static void TaskEnded( struct background_worker* worker, struct bg_task* task )
+{
+    vlc_mutex_lock( &worker->lock );
+    vlc_array_remove( &worker->head.tasks,
+                      vlc_array_index_of_item( &worker->head.tasks, task ) );
+    vlc_cond_broadcast( &worker->head.wait );
+    /* Held back entities may be admitted now */
+    vlc_cond_broadcast( &worker->tail.wait );
+    vlc_mutex_unlock( &worker->lock );
+}
+
 static void* Thread( void* data )
 {
     struct background_worker* worker = data;
 
+    vlc_mutex_lock( &worker->lock );
     for( ;; )
     {
-        struct bg_queued_item* item = NULL;
-        void* handle;
+        struct bg_queued_item* item = TakeNext( worker );
 
-        vlc_mutex_lock( &worker->lock );
-        for( ;; )
+        if( item == NULL )
         {
-            if( vlc_array_count( &worker->tail.data ) )
-            {
-                item = vlc_array_item_at_index( &worker->tail.data, 0 );
-                handle = NULL;
-
-                vlc_array_remove( &worker->tail.data, 0 );
-            }
-
-            if( worker->head.deadline == VLC_TS_0 && item == NULL )
-                worker->head.active = false;
-            worker->head.id = item ? item->id : NULL;
-            vlc_cond_broadcast( &worker->head.wait );
+            if( worker->head.flush > 0 )
+                break;
 
-            if( item )
-            {
-                if( item->timeout > 0 )
-                    worker->head.deadline = mdate() + item->timeout * 1000;
-                else
-                    worker->head.deadline = INT64_MAX;
-            }
-            else if( worker->head.deadline != VLC_TS_0 )
-            {
-                /* Wait 1 seconds for new inputs before terminating */
-                mtime_t deadline = mdate() + INT64_C(1000000);
-                int ret = vlc_cond_timedwait( &worker->tail.wait,
-                                              &worker->lock, deadline );
-                if( ret != 0 )
-                {
-                    /* Timeout: if there is still no items, the thread will be
-                     * terminated at next loop iteration (active = false). */
-                    worker->head.deadline = VLC_TS_0;
-                }
-                continue;
-            }
-            break;
+            /* Wait 1 seconds for new inputs before terminating */
+            mtime_t deadline = mdate() + INT64_C(1000000);
+            worker->head.idle++;
+            int ret = vlc_cond_timedwait( &worker->tail.wait,
+                                          &worker->lock, deadline );
+            worker->head.idle--;
+            if( ret != 0 && vlc_array_count( &worker->tail.data ) == 0 )
+                break;
+            continue;
         }
 
-        if( !worker->head.active )
+        struct bg_task task = {
+            .id = item->id,
+            .deadline = item->timeout > 0 ? mdate() + item->timeout * 1000
+                                          : INT64_MAX,
+            .probe_request = false,
+        };
+        if( vlc_array_append( &worker->head.tasks, &task ) )
         {
             vlc_mutex_unlock( &worker->lock );
-            break;
+            worker->conf.pf_release( item->entity );
+            free( item );
+            vlc_mutex_lock( &worker->lock );
+            continue;
         }
         vlc_mutex_unlock( &worker->lock );
 
-        assert( item != NULL );
-
+        void* handle;
         if( worker->conf.pf_start( worker->owner, item->entity, &handle ) )
         {
             worker->conf.pf_release( item->entity );
             free( item );
+            TaskEnded( worker, &task );
+            vlc_mutex_lock( &worker->lock );
             continue;
         }
 
@@ -123,8 +144,8 @@ static void* Thread( void* data )
         {
             vlc_mutex_lock( &worker->lock );
 
-            bool const b_timeout = worker->head.deadline <= mdate();
-            worker->head.probe_request = false;
+            bool const b_timeout = task.deadline <= mdate();
+            task.probe_request = false;
 
             vlc_mutex_unlock( &worker->lock );
 
@@ -138,19 +159,42 @@ static void* Thread( void* data )
             }
 
             vlc_mutex_lock( &worker->lock );
-            if( worker->head.probe_request == false &&
-                worker->head.deadline > mdate() )
+            if( task.probe_request == false &&
+                task.deadline > mdate() )
             {
                 vlc_cond_timedwait( &worker->head.worker_wait, &worker->lock,
-                                     worker->head.deadline );
+                                     task.deadline );
             }
             vlc_mutex_unlock( &worker->lock );
         }
+
+        TaskEnded( worker, &task );
+        vlc_mutex_lock( &worker->lock );
     }
 
+    worker->head.threads--;
+    vlc_cond_broadcast( &worker->head.wait );
+    vlc_mutex_unlock( &worker->lock );
     return NULL;
 }
 
+static bool HasTask( struct background_worker* worker, void* id )
+{
+    bool found = false;
+
+    for( size_t i = 0; i < vlc_array_count( &worker->head.tasks ); ++i )
+    {
+        struct bg_task* task = vlc_array_item_at_index( &worker->head.tasks, i );
+
+        if( id == NULL || task->id == id )
+        {
+            task->deadline = VLC_TS_0;
+            found = true;
+        }
+    }
+    return found;
+}
+
 static void BackgroundWorkerCancel( struct background_worker* worker, void* id)
 {
     vlc_mutex_lock( &worker->lock );
@@ -170,14 +214,19 @@ static void BackgroundWorkerCancel( struct background_worker* worker, void* id)
         ++i;
     }
 
-    while( ( id == NULL && worker->head.active )
-        || ( id != NULL && worker->head.id == id ) )
+    if( id == NULL )
+        worker->head.flush++;
+
+    while( HasTask( worker, id )
+        || ( id == NULL && worker->head.threads > 0 ) )
     {
-        worker->head.deadline = VLC_TS_0;
-        vlc_cond_signal( &worker->head.worker_wait );
-        vlc_cond_signal( &worker->tail.wait );
+        vlc_cond_broadcast( &worker->head.worker_wait );
+        vlc_cond_broadcast( &worker->tail.wait );
         vlc_cond_wait( &worker->head.wait, &worker->lock );
     }
+
+    if( id == NULL )
+        worker->head.flush--;
     vlc_mutex_unlock( &worker->lock );
 }
 
@@ -190,14 +239,17 @@ struct background_worker* background_worker_New( void* owner,
         return NULL;
 
     worker->conf = *conf;
+    if( worker->conf.max_threads < 1 )
+        worker->conf.max_threads = 1;
     worker->owner = owner;
-    worker->head.id = NULL;
-    worker->head.active = false;
-    worker->head.deadline = VLC_TS_INVALID;
+    worker->head.threads = 0;
+    worker->head.idle = 0;
+    worker->head.flush = 0;
 
     vlc_mutex_init( &worker->lock );
     vlc_cond_init( &worker->head.wait );
     vlc_cond_init( &worker->head.worker_wait );
+    vlc_array_init( &worker->head.tasks );
 
     vlc_array_init( &worker->tail.data );
     vlc_cond_init( &worker->tail.wait );
@@ -218,25 +270,32 @@ int background_worker_Push( struct background_worker* worker, void* entity,
     item->timeout = timeout < 0 ? worker->conf.default_timeout : timeout;
 
     vlc_mutex_lock( &worker->lock );
-    int i_ret = vlc_array_append( &worker->tail.data, item );
-    vlc_cond_signal( &worker->tail.wait );
-    if( i_ret != 0 )
+    if( vlc_array_append( &worker->tail.data, item ) != 0 )
     {
+        vlc_mutex_unlock( &worker->lock );
         free( item );
         return VLC_EGENERIC;
     }
 
-    if( worker->head.active == false )
+    if( worker->head.idle > 0 )
+        vlc_cond_signal( &worker->tail.wait );
+    if( worker->head.threads < worker->conf.max_threads &&
+        vlc_array_count( &worker->tail.data ) > (size_t)worker->head.idle )
     {
-        worker->head.probe_request = false;
-        worker->head.active =
-            !vlc_clone_detach( NULL, Thread, worker, VLC_THREAD_PRIORITY_LOW );
+        if( !vlc_clone_detach( NULL, Thread, worker, VLC_THREAD_PRIORITY_LOW ) )
+            worker->head.threads++;
     }
 
-    if( worker->head.active )
+    int ret = VLC_SUCCESS;
+    if( worker->head.threads > 0 )
         worker->conf.pf_hold( item->entity );
-
-    int ret = worker->head.active ? VLC_SUCCESS : VLC_EGENERIC;
+    else
+    {
+        vlc_array_remove( &worker->tail.data,
+                          vlc_array_count( &worker->tail.data ) - 1 );
+        free( item );
+        ret = VLC_EGENERIC;
+    }
     vlc_mutex_unlock( &worker->lock );
 
     return ret;
@@ -250,14 +309,19 @@ void background_worker_Cancel( struct background_worker* worker, void* id )
 void background_worker_RequestProbe( struct background_worker* worker )
 {
     vlc_mutex_lock( &worker->lock );
-    worker->head.probe_request = true;
-    vlc_cond_signal( &worker->head.worker_wait );
+    for( size_t i = 0; i < vlc_array_count( &worker->head.tasks ); ++i )
+    {
+        struct bg_task* task = vlc_array_item_at_index( &worker->head.tasks, i );
+        task->probe_request = true;
+    }
+    vlc_cond_broadcast( &worker->head.worker_wait );
     vlc_mutex_unlock( &worker->lock );
 }
 
 void background_worker_Delete( struct background_worker* worker )
 {
     BackgroundWorkerCancel( worker, NULL );
+    vlc_array_clear( &worker->head.tasks );
     vlc_array_clear( &worker->tail.data );
     vlc_mutex_destroy( &worker->lock );
     vlc_cond_destroy( &worker->head.wait );
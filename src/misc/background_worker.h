@@ -29,6 +29,35 @@ struct background_worker_config {
      **/
     mtime_t default_timeout;
 
+    /**
+     * Maximum number of tasks running concurrently
+     *
+     * Each task runs on its own thread. Threads are spawned on demand, up to
+     * this limit, and terminate after having been idle for a while. A value
+     * less-than 1 is the same as 1, in which case entities are processed one
+     * at a time, in order.
+     **/
+    int max_threads;
+
+    /**
+     * Admit an entity (optional)
+     *
+     * This callback is called, with the background-worker lock held, before
+     * a queued entity is started. If it returns false, the entity is left in
+     * the queue and the next one is considered; it will be reconsidered when
+     * another task terminates. It can be used to limit the concurrency of some
+     * class of entities. Resources accounted by an admission shall be given
+     * back in \ref pf_stop, or in \ref pf_start if it fails.
+     *
+     * It must not call into the background-worker. If `NULL`, every entity
+     * is admitted.
+     *
+     * \param owner the owner of the background-worker
+     * \param entity the entity about to be started
+     * \return true if the entity can be started now
+     **/
+    bool( *pf_admit )( void* owner, void* entity );
+
     /**
      * Release an entity
      *
@@ -119,10 +148,10 @@ struct background_worker* background_worker_New( void* owner,
     struct background_worker_config* config );
 
 /**
- * Request the background-worker to probe the current task
+ * Request the background-worker to probe the current tasks
  *
  * This function is used to signal the background-worker that it should do
- * another probe to see whether the current task is still alive.
+ * another probe to see whether the current tasks are still alive.
  *
  * \warning Note that the function will not wait for the probing to finish, it
  *          will simply ask the background worker to recheck it as soon as
@@ -136,8 +165,9 @@ void background_worker_RequestProbe( struct background_worker* worker );
  * Push an entity into the background-worker
  *
  * This function is used to push an entity into the queue of pending work. The
- * entities will be processed in the order in which they are received (in terms
- * of the order of invocations in a single-threaded environment).
+ * entities will be started in the order in which they are received (in terms
+ * of the order of invocations in a single-threaded environment), unless they
+ * are held back by \ref background_worker_config.pf_admit.
  *
  * \param worker the background-worker
  * \param entity the entity which is to be queued
@@ -158,12 +188,13 @@ int background_worker_Push( struct background_worker* worker, void* entity,
  * associated id, or to remove all queued (including currently running)
  * entities.
  *
- * \warning if the `id` passed refers to an entity that is currently being
- *          processed, the call will block until the task has been terminated.
+ * \warning if the `id` passed refers to entities that are currently being
+ *          processed, the call will block until their tasks have been
+ *          terminated.
  *
  * \param worker the background-worker
  * \param id NULL if every entity shall be removed, and the currently running
- *        task (if any) shall be cancelled.
+ *        tasks (if any) shall be cancelled.
  **/
 void background_worker_Cancel( struct background_worker* worker, void* id );
 
@@ -171,11 +202,11 @@ void background_worker_Cancel( struct background_worker* worker, void* id );
  * Delete a background-worker
  *
  * This function will destroy a background-worker created through \ref
- * background_worker_New. It will effectively stop the currently running task,
+ * background_worker_New. It will effectively stop the currently running tasks,
  * if any, and empty the queue of pending entities.
  *
- * \warning If there is a currently running task, the function will block until
- *          it has been stopped.
+ * \warning If there are running tasks, the function will block until they
+ *          have been stopped.
  *
  * \param worker the background-worker
  **/
@@ -0,0 +1,257 @@
+/*****************************************************************************
+ * cpu_budget.c: process-wide codec thread budget
+ *****************************************************************************
+ * Copyright (C) 2020 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <assert.h>
+
+#include <vlc_common.h>
+#include <vlc_cpu_budget.h>
+
+#include "libvlc.h"
+
+struct vlc_cpu_budget
+{
+    vlc_mutex_t lock;
+    vlc_cond_t  wait;
+
+    unsigned i_total;   /* threads in the budget */
+    mtime_t  i_max_wait;
+    unsigned i_used;    /* threads granted to active leases */
+    unsigned i_display; /* threads granted to active display leases */
+    unsigned i_weight;  /* sum of the weights of active leases */
+    unsigned i_leases;
+
+    size_t   i_modules;
+    vlc_cpu_budget_stats_t *p_modules; /* statistics per module */
+};
+
+struct vlc_cpu_lease_t
+{
+    struct vlc_cpu_budget *budget;
+    vlc_object_t *obj;
+    size_t   i_module;
+    unsigned i_wanted;
+    unsigned i_weight;
+    unsigned i_threads;
+    bool     b_background;
+};
+
+struct vlc_cpu_budget *vlc_cpu_budget_Create( libvlc_int_t *libvlc )
+{
+    struct vlc_cpu_budget *budget = malloc( sizeof( *budget ) );
+    if( unlikely(budget == NULL) )
+        return NULL;
+
+    int64_t i_total = var_InheritInteger( libvlc, "cpu-budget" );
+    budget->i_total = i_total > 0 ? i_total : vlc_GetCPUCount();
+    if( budget->i_total == 0 )
+        budget->i_total = 1;
+    budget->i_max_wait = var_InheritInteger( libvlc, "cpu-budget-wait" ) * 1000;
+    budget->i_used = budget->i_display = 0;
+    budget->i_weight = budget->i_leases = 0;
+    budget->i_modules = 0;
+    budget->p_modules = NULL;
+    vlc_mutex_init( &budget->lock );
+    vlc_cond_init( &budget->wait );
+
+    msg_Dbg( libvlc, "codec thread budget: %u threads", budget->i_total );
+    return budget;
+}
+
+void vlc_cpu_budget_Destroy( struct vlc_cpu_budget *budget )
+{
+    assert( budget->i_leases == 0 );
+
+    vlc_cond_destroy( &budget->wait );
+    vlc_mutex_destroy( &budget->lock );
+    free( budget->p_modules );
+    free( budget );
+}
+
+static struct vlc_cpu_budget *GetBudget( vlc_object_t *obj )
+{
+    return libvlc_priv( obj->obj.libvlc )->cpu_budget;
+}
+
+/* Must be called with the lock held */
+static size_t GetModule( struct vlc_cpu_budget *budget, const char *psz_module )
+{
+    for( size_t i = 0; i < budget->i_modules; i++ )
+        if( !strcmp( budget->p_modules[i].psz_module, psz_module ) )
+            return i;
+
+    vlc_cpu_budget_stats_t *p = realloc( budget->p_modules,
+                                    (budget->i_modules + 1) * sizeof( *p ) );
+    if( unlikely(p == NULL) )
+        return SIZE_MAX;
+    budget->p_modules = p;
+
+    p = &budget->p_modules[budget->i_modules];
+    memset( p, 0, sizeof( *p ) );
+    strlcpy( p->psz_module, psz_module, sizeof( p->psz_module ) );
+    return budget->i_modules++;
+}
+
+/* Must be called with the lock held */
+static unsigned GetTarget( const vlc_cpu_lease_t *lease )
+{
+    const struct vlc_cpu_budget *budget = lease->budget;
+    unsigned i_share = budget->i_total * lease->i_weight / budget->i_weight;
+
+    if( i_share == 0 )
+        i_share = 1;
+    if( lease->i_wanted > 0 && i_share > lease->i_wanted )
+        i_share = lease->i_wanted;
+    return i_share;
+}
+
+/* Must be called with the lock held
+ *
+ * Leases are capped to the free part of the budget. Display leases can also
+ * take the threads of the background leases: the budget is then overcommitted
+ * until those end, since codecs cannot shrink their thread pools. */
+static unsigned Grant( const vlc_cpu_lease_t *lease, unsigned i_threads )
+{
+    const struct vlc_cpu_budget *budget = lease->budget;
+    unsigned i_used = lease->b_background ? budget->i_used
+                                          : budget->i_display;
+    unsigned i_free = budget->i_total > i_used ? budget->i_total - i_used : 0;
+
+    if( i_threads > i_free )
+        i_threads = __MAX( i_free, 1 );
+    return i_threads;
+}
+
+#undef vlc_cpu_lease_Acquire
+vlc_cpu_lease_t *vlc_cpu_lease_Acquire( vlc_object_t *obj,
+                                        const char *psz_module,
+                                        unsigned i_wanted )
+{
+    struct vlc_cpu_budget *budget = GetBudget( obj );
+    vlc_cpu_lease_t *lease = malloc( sizeof( *lease ) );
+    if( unlikely(lease == NULL) )
+        return NULL;
+
+    lease->budget = budget;
+    lease->obj = obj;
+    lease->i_wanted = i_wanted;
+    lease->i_threads = 0;
+    lease->b_background = var_InheritInteger( obj, "cpu-priority" )
+                          == VLC_CPU_PRIORITY_BACKGROUND;
+    lease->i_weight = lease->b_background ? 1 : 2;
+
+    vlc_mutex_lock( &budget->lock );
+    lease->i_module = GetModule( budget, psz_module );
+    if( unlikely(lease->i_module == SIZE_MAX) )
+    {
+        vlc_mutex_unlock( &budget->lock );
+        free( lease );
+        return NULL;
+    }
+
+    budget->i_weight += lease->i_weight;
+    budget->i_leases++;
+
+    mtime_t i_wait = -1;
+    if( lease->b_background && budget->i_used >= budget->i_total &&
+        budget->i_max_wait > 0 )
+    {
+        mtime_t i_start = mdate();
+        mtime_t i_deadline = i_start + budget->i_max_wait;
+
+        while( budget->i_used >= budget->i_total )
+            if( vlc_cond_timedwait( &budget->wait, &budget->lock,
+                                    i_deadline ) )
+                break;
+        i_wait = mdate() - i_start;
+    }
+
+    /* The statistics array may have been reallocated while waiting */
+    vlc_cpu_budget_stats_t *stats = &budget->p_modules[lease->i_module];
+    if( i_wait >= 0 )
+    {
+        stats->i_waits++;
+        stats->i_wait_time += i_wait;
+    }
+
+    lease->i_threads = Grant( lease, GetTarget( lease ) );
+    budget->i_used += lease->i_threads;
+    if( !lease->b_background )
+        budget->i_display += lease->i_threads;
+    stats->i_leases++;
+    stats->i_total_leases++;
+    stats->i_threads += lease->i_threads;
+    vlc_mutex_unlock( &budget->lock );
+
+    msg_Dbg( obj, "leased %u thread(s) (%s priority, %u wanted)",
+             lease->i_threads, lease->b_background ? "background" : "display",
+             i_wanted );
+    return lease;
+}
+
+unsigned vlc_cpu_lease_GetThreads( const vlc_cpu_lease_t *lease )
+{
+    return lease->i_threads;
+}
+
+void vlc_cpu_lease_Release( vlc_cpu_lease_t *lease )
+{
+    struct vlc_cpu_budget *budget = lease->budget;
+
+    vlc_mutex_lock( &budget->lock );
+    vlc_cpu_budget_stats_t *stats = &budget->p_modules[lease->i_module];
+
+    budget->i_used -= lease->i_threads;
+    if( !lease->b_background )
+        budget->i_display -= lease->i_threads;
+    budget->i_weight -= lease->i_weight;
+    budget->i_leases--;
+    stats->i_leases--;
+    stats->i_threads -= lease->i_threads;
+    vlc_cond_broadcast( &budget->wait );
+
+    if( libvlc_stats( lease->obj ) )
+        msg_Dbg( lease->obj, "%s: %u active lease(s) with %u thread(s), "
+                 "%u lease(s) waited %"PRId64" ms in total",
+                 stats->psz_module, stats->i_leases, stats->i_threads,
+                 stats->i_waits, stats->i_wait_time / 1000 );
+    vlc_mutex_unlock( &budget->lock );
+    free( lease );
+}
+
+#undef vlc_cpu_budget_GetStats
+size_t vlc_cpu_budget_GetStats( vlc_object_t *obj,
+                                vlc_cpu_budget_stats_t *stats, size_t i_max,
+                                unsigned *pi_budget )
+{
+    struct vlc_cpu_budget *budget = GetBudget( obj );
+
+    vlc_mutex_lock( &budget->lock );
+    for( size_t i = 0; i < budget->i_modules && i < i_max; i++ )
+        stats[i] = budget->p_modules[i];
+    size_t i_count = budget->i_modules;
+    if( pi_budget != NULL )
+        *pi_budget = budget->i_total;
+    vlc_mutex_unlock( &budget->lock );
+    return i_count;
+}
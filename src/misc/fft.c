@@ -0,0 +1,688 @@
+/*****************************************************************************
+ * fft.c: fast Fourier transforms
+ *****************************************************************************
+ * Copyright (C) 2020 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <assert.h>
+#include <limits.h>
+#include <math.h>
+#include <string.h>
+
+#include <vlc_common.h>
+#include <vlc_cpu.h>
+#include <vlc_fft.h>
+
+#include "libvlc.h"
+
+/* Only the x86 CPUs get SIMD kernels so far. Other architectures, such as
+ * ARM with NEON, run the C stages. */
+#ifdef HAVE_SSE2_INTRINSICS
+# include <xmmintrin.h>
+#endif
+
+/* Complex transforms are computed by a Stockham autosort algorithm: each
+ * stage splits the sub-transforms of the previous one by its radix, from
+ * one buffer to the other, and the last one leaves the output in natural
+ * order. The inner loop of a stage runs over the interleaved
+ * sub-transforms, so it reads and writes consecutive values.
+ *
+ * Real transforms of size 2n go through a complex transform of size n. */
+
+#define FFT_MAX_STAGES 32
+
+/* Each twiddle factor is stored as (re, im, re, im) and (-im, re, -im, re),
+ * so that the SIMD kernels multiply 2 complex values at once */
+#define TWIDDLE_FLOATS 8
+
+struct fft_stage
+{
+    unsigned radix;
+    unsigned m; /* size of the sub-transforms after the stage */
+    unsigned s; /* number of sub-transforms before the stage */
+    const float *twiddles; /* (radix - 1) factors for each of the m outputs */
+};
+
+/* Trigonometric tables of a complex transform size */
+struct fft_plan
+{
+    unsigned size;
+    unsigned stages;
+    struct fft_stage stage[FFT_MAX_STAGES];
+    float *twiddles;
+    float *real; /* exp(-i*pi*k/size), for real transforms of twice the size */
+    struct fft_plan *next;
+};
+
+struct vlc_fft_plans
+{
+    vlc_mutex_t lock;
+    struct fft_plan *first;
+};
+
+struct vlc_fft
+{
+    const struct fft_plan *plan;
+    struct fft_plan *own; /* plan of a transform without LibVLC instance */
+    enum vlc_fft_type type;
+    bool sse;
+    float *work[3]; /* plan->size + 1 complex values each */
+};
+
+static unsigned Factorize(unsigned size, unsigned *radices)
+{
+    static const unsigned factors[] = { 4, 2, 3, 5 };
+    unsigned count = 0;
+
+    for (unsigned i = 0; i < ARRAY_SIZE(factors); i++)
+        while (size % factors[i] == 0)
+        {
+            radices[count++] = factors[i];
+            size /= factors[i];
+        }
+    return size == 1 ? count : UINT_MAX;
+}
+
+static struct fft_plan *PlanCreate(unsigned size)
+{
+    unsigned radices[FFT_MAX_STAGES];
+    unsigned stages = Factorize(size, radices);
+
+    if (stages == UINT_MAX)
+        return NULL;
+
+    struct fft_plan *plan = malloc(sizeof (*plan));
+    if (unlikely(plan == NULL))
+        return NULL;
+
+    /* The stages need (radix - 1) * m factors each: size - 1 in total */
+    plan->twiddles = vlc_alloc(size, TWIDDLE_FLOATS * sizeof (float));
+    plan->real = vlc_alloc(size, 2 * sizeof (float));
+    if (unlikely(plan->twiddles == NULL || plan->real == NULL))
+    {
+        free(plan->real);
+        free(plan->twiddles);
+        free(plan);
+        return NULL;
+    }
+
+    plan->size = size;
+    plan->stages = stages;
+
+    float *tw = plan->twiddles;
+    unsigned n = size, s = 1;
+    for (unsigned i = 0; i < stages; i++)
+    {
+        struct fft_stage *st = &plan->stage[i];
+        const unsigned p = radices[i];
+
+        st->radix = p;
+        st->m = n / p;
+        st->s = s;
+        st->twiddles = tw;
+        for (unsigned q = 0; q < st->m; q++)
+            for (unsigned r = 1; r < p; r++)
+            {
+                const double a = -2. * M_PI * r * q / n;
+                const float c = cos(a), si = sin(a);
+
+                tw[0] = c;   tw[1] = si; tw[2] = c;   tw[3] = si;
+                tw[4] = -si; tw[5] = c;  tw[6] = -si; tw[7] = c;
+                tw += TWIDDLE_FLOATS;
+            }
+        n = st->m;
+        s *= p;
+    }
+
+    for (unsigned k = 0; k < size; k++)
+    {
+        const double a = -M_PI * k / size;
+
+        plan->real[2 * k] = cos(a);
+        plan->real[2 * k + 1] = sin(a);
+    }
+    return plan;
+}
+
+static void PlanDelete(struct fft_plan *plan)
+{
+    free(plan->real);
+    free(plan->twiddles);
+    free(plan);
+}
+
+struct vlc_fft_plans *vlc_fft_plans_Create(libvlc_int_t *libvlc)
+{
+    struct vlc_fft_plans *plans = malloc(sizeof (*plans));
+    if (unlikely(plans == NULL))
+        return NULL;
+
+    vlc_mutex_init(&plans->lock);
+    plans->first = NULL;
+    (void) libvlc;
+    return plans;
+}
+
+void vlc_fft_plans_Destroy(struct vlc_fft_plans *plans)
+{
+    while (plans->first != NULL)
+    {
+        struct fft_plan *plan = plans->first;
+
+        plans->first = plan->next;
+        PlanDelete(plan);
+    }
+    vlc_mutex_destroy(&plans->lock);
+    free(plans);
+}
+
+/* The plans are kept until the instance is destroyed, as callers tend to
+ * create their transforms for every block they analyse */
+static const struct fft_plan *PlanGet(struct vlc_fft_plans *plans,
+                                      unsigned size)
+{
+    struct fft_plan *plan;
+
+    vlc_mutex_lock(&plans->lock);
+    for (plan = plans->first; plan != NULL; plan = plan->next)
+        if (plan->size == size)
+            break;
+
+    if (plan == NULL)
+    {
+        plan = PlanCreate(size);
+        if (plan != NULL)
+        {
+            plan->next = plans->first;
+            plans->first = plan;
+        }
+    }
+    vlc_mutex_unlock(&plans->lock);
+    return plan;
+}
+
+/*****************************************************************************
+ * Stages
+ *****************************************************************************/
+#define C3  (-0.5f)
+#define S3  0.866025403784438646764f
+#define C51 0.309016994374947424102f  /* cos(2*pi/5) */
+#define C52 (-0.809016994374947424102f) /* cos(4*pi/5) */
+#define S51 0.951056516295153572116f  /* sin(2*pi/5) */
+#define S52 0.587785252292473129169f  /* sin(4*pi/5) */
+
+/* Small forward DFT of the values a, in place */
+static inline void Butterfly(unsigned p, float *re, float *im)
+{
+    switch (p)
+    {
+        case 2:
+        {
+            const float r = re[0] - re[1], i = im[0] - im[1];
+            re[0] += re[1]; im[0] += im[1];
+            re[1] = r; im[1] = i;
+            break;
+        }
+        case 3:
+        {
+            const float tr = re[1] + re[2], ti = im[1] + im[2];
+            const float mr = re[0] + C3 * tr, mi = im[0] + C3 * ti;
+            /* -i * S3 * (a1 - a2) */
+            const float nr = S3 * (im[1] - im[2]), ni = -S3 * (re[1] - re[2]);
+            re[0] += tr; im[0] += ti;
+            re[1] = mr + nr; im[1] = mi + ni;
+            re[2] = mr - nr; im[2] = mi - ni;
+            break;
+        }
+        case 4:
+        {
+            const float t0r = re[0] + re[2], t0i = im[0] + im[2];
+            const float t1r = re[0] - re[2], t1i = im[0] - im[2];
+            const float t2r = re[1] + re[3], t2i = im[1] + im[3];
+            /* -i * (a1 - a3) */
+            const float t3r = im[1] - im[3], t3i = re[3] - re[1];
+            re[0] = t0r + t2r; im[0] = t0i + t2i;
+            re[1] = t1r + t3r; im[1] = t1i + t3i;
+            re[2] = t0r - t2r; im[2] = t0i - t2i;
+            re[3] = t1r - t3r; im[3] = t1i - t3i;
+            break;
+        }
+        case 5:
+        {
+            const float t1r = re[1] + re[4], t1i = im[1] + im[4];
+            const float t2r = re[2] + re[3], t2i = im[2] + im[3];
+            const float d1r = re[1] - re[4], d1i = im[1] - im[4];
+            const float d2r = re[2] - re[3], d2i = im[2] - im[3];
+            const float m1r = re[0] + C51 * t1r + C52 * t2r;
+            const float m1i = im[0] + C51 * t1i + C52 * t2i;
+            const float m2r = re[0] + C52 * t1r + C51 * t2r;
+            const float m2i = im[0] + C52 * t1i + C51 * t2i;
+            /* -i * (S51 * d1 + S52 * d2) and -i * (S52 * d1 - S51 * d2) */
+            const float n1r = S51 * d1i + S52 * d2i, n1i = -(S51 * d1r + S52 * d2r);
+            const float n2r = S52 * d1i - S51 * d2i, n2i = -(S52 * d1r - S51 * d2r);
+            re[0] += t1r + t2r; im[0] += t1i + t2i;
+            re[1] = m1r + n1r; im[1] = m1i + n1i;
+            re[4] = m1r - n1r; im[4] = m1i - n1i;
+            re[2] = m2r + n2r; im[2] = m2i + n2i;
+            re[3] = m2r - n2r; im[3] = m2i - n2i;
+            break;
+        }
+        default:
+            vlc_assert_unreachable();
+    }
+}
+
+static void StageC(const float *restrict x, float *restrict y,
+                   const struct fft_stage *st)
+{
+    const unsigned p = st->radix, m = st->m, s = st->s;
+
+    for (unsigned q = 0; q < m; q++)
+    {
+        const float *tw = st->twiddles + q * (p - 1) * TWIDDLE_FLOATS;
+
+        for (unsigned k = 0; k < s; k++)
+        {
+            float re[5], im[5];
+
+            for (unsigned j = 0; j < p; j++)
+            {
+                const float *a = x + 2 * (k + s * (q + m * j));
+                re[j] = a[0];
+                im[j] = a[1];
+            }
+
+            Butterfly(p, re, im);
+
+            float *b = y + 2 * (k + s * p * q);
+            b[0] = re[0];
+            b[1] = im[0];
+            for (unsigned r = 1; r < p; r++)
+            {
+                const float *w = tw + (r - 1) * TWIDDLE_FLOATS;
+                b = y + 2 * (k + s * (p * q + r));
+                b[0] = re[r] * w[0] - im[r] * w[1];
+                b[1] = re[r] * w[1] + im[r] * w[0];
+            }
+        }
+    }
+}
+
+#ifdef HAVE_SSE2_INTRINSICS
+/* Vectors of 2 complex values */
+VLC_SSE
+static inline __m128 MulNegI(__m128 v)
+{
+    const __m128 sign = _mm_set_ps(-0.f, 0.f, -0.f, 0.f);
+
+    v = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+    return _mm_xor_ps(v, sign);
+}
+
+VLC_SSE
+static inline __m128 MulTwiddle(__m128 v, const float *w)
+{
+    const __m128 re = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 0, 0));
+    const __m128 im = _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 1, 1));
+
+    return _mm_add_ps(_mm_mul_ps(re, _mm_loadu_ps(w)),
+                      _mm_mul_ps(im, _mm_loadu_ps(w + 4)));
+}
+
+VLC_SSE
+static inline void ButterflySSE(unsigned p, __m128 *a)
+{
+    switch (p)
+    {
+        case 2:
+        {
+            const __m128 d = _mm_sub_ps(a[0], a[1]);
+            a[0] = _mm_add_ps(a[0], a[1]);
+            a[1] = d;
+            break;
+        }
+        case 3:
+        {
+            const __m128 t = _mm_add_ps(a[1], a[2]);
+            const __m128 m = _mm_add_ps(a[0], _mm_mul_ps(_mm_set1_ps(C3), t));
+            const __m128 n = MulNegI(_mm_mul_ps(_mm_set1_ps(S3),
+                                                _mm_sub_ps(a[1], a[2])));
+            a[0] = _mm_add_ps(a[0], t);
+            a[1] = _mm_add_ps(m, n);
+            a[2] = _mm_sub_ps(m, n);
+            break;
+        }
+        case 4:
+        {
+            const __m128 t0 = _mm_add_ps(a[0], a[2]);
+            const __m128 t1 = _mm_sub_ps(a[0], a[2]);
+            const __m128 t2 = _mm_add_ps(a[1], a[3]);
+            const __m128 t3 = MulNegI(_mm_sub_ps(a[1], a[3]));
+            a[0] = _mm_add_ps(t0, t2);
+            a[1] = _mm_add_ps(t1, t3);
+            a[2] = _mm_sub_ps(t0, t2);
+            a[3] = _mm_sub_ps(t1, t3);
+            break;
+        }
+        case 5:
+        {
+            const __m128 c1 = _mm_set1_ps(C51), c2 = _mm_set1_ps(C52);
+            const __m128 s1 = _mm_set1_ps(S51), s2 = _mm_set1_ps(S52);
+            const __m128 t1 = _mm_add_ps(a[1], a[4]);
+            const __m128 t2 = _mm_add_ps(a[2], a[3]);
+            const __m128 d1 = _mm_sub_ps(a[1], a[4]);
+            const __m128 d2 = _mm_sub_ps(a[2], a[3]);
+            const __m128 m1 = _mm_add_ps(a[0], _mm_add_ps(_mm_mul_ps(c1, t1),
+                                                          _mm_mul_ps(c2, t2)));
+            const __m128 m2 = _mm_add_ps(a[0], _mm_add_ps(_mm_mul_ps(c2, t1),
+                                                          _mm_mul_ps(c1, t2)));
+            const __m128 n1 = MulNegI(_mm_add_ps(_mm_mul_ps(s1, d1),
+                                                 _mm_mul_ps(s2, d2)));
+            const __m128 n2 = MulNegI(_mm_sub_ps(_mm_mul_ps(s2, d1),
+                                                 _mm_mul_ps(s1, d2)));
+            a[0] = _mm_add_ps(a[0], _mm_add_ps(t1, t2));
+            a[1] = _mm_add_ps(m1, n1);
+            a[4] = _mm_sub_ps(m1, n1);
+            a[2] = _mm_add_ps(m2, n2);
+            a[3] = _mm_sub_ps(m2, n2);
+            break;
+        }
+        default:
+            vlc_assert_unreachable();
+    }
+}
+
+/* The number of sub-transforms must be even */
+VLC_SSE
+static void StageSSE(const float *restrict x, float *restrict y,
+                     const struct fft_stage *st)
+{
+    const unsigned p = st->radix, m = st->m, s = st->s;
+
+    for (unsigned q = 0; q < m; q++)
+    {
+        const float *tw = st->twiddles + q * (p - 1) * TWIDDLE_FLOATS;
+
+        for (unsigned k = 0; k < s; k += 2)
+        {
+            __m128 a[5];
+
+            for (unsigned j = 0; j < p; j++)
+                a[j] = _mm_loadu_ps(x + 2 * (k + s * (q + m * j)));
+
+            ButterflySSE(p, a);
+
+            _mm_storeu_ps(y + 2 * (k + s * p * q), a[0]);
+            for (unsigned r = 1; r < p; r++)
+                _mm_storeu_ps(y + 2 * (k + s * (p * q + r)),
+                              MulTwiddle(a[r], tw + (r - 1) * TWIDDLE_FLOATS));
+        }
+    }
+}
+
+VLC_SSE
+static void PowerSSE(const float *spectrum, float *power, unsigned count)
+{
+    unsigned i = 0;
+
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 a = _mm_loadu_ps(spectrum + 2 * i);
+        __m128 b = _mm_loadu_ps(spectrum + 2 * i + 4);
+
+        a = _mm_mul_ps(a, a);
+        b = _mm_mul_ps(b, b);
+        _mm_storeu_ps(power + i,
+                      _mm_add_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)),
+                                 _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1))));
+    }
+    for (; i < count; i++)
+        power[i] = spectrum[2 * i] * spectrum[2 * i]
+                 + spectrum[2 * i + 1] * spectrum[2 * i + 1];
+}
+#endif
+
+static void PowerC(const float *spectrum, float *power, unsigned count)
+{
+    for (unsigned i = 0; i < count; i++)
+        power[i] = spectrum[2 * i] * spectrum[2 * i]
+                 + spectrum[2 * i + 1] * spectrum[2 * i + 1];
+}
+
+/* Forward complex transform of the plan size */
+static void Transform(vlc_fft_t *fft, const float *in, float *out)
+{
+    const struct fft_plan *plan = fft->plan;
+    const float *src = in;
+
+    if (plan->stages == 0)
+    {
+        if (in != out)
+            memmove(out, in, 2 * sizeof (float) * plan->size);
+        return;
+    }
+
+    if (in == out && plan->stages == 1)
+    {
+        memcpy(fft->work[1], in, 2 * sizeof (float) * plan->size);
+        src = fft->work[1];
+    }
+
+    for (unsigned i = 0; i < plan->stages; i++)
+    {
+        const struct fft_stage *st = &plan->stage[i];
+        float *dst = (i + 1 == plan->stages) ? out : fft->work[i & 1];
+
+#ifdef HAVE_SSE2_INTRINSICS
+        if (fft->sse && (st->s & 1) == 0)
+            StageSSE(src, dst, st);
+        else
+#endif
+            StageC(src, dst, st);
+        src = dst;
+    }
+}
+
+static void Conjugate(float *values, unsigned count)
+{
+    for (unsigned i = 0; i < count; i++)
+        values[2 * i + 1] = -values[2 * i + 1];
+}
+
+/* Spectrum of 2n real values from the complex transform z of n values made
+ * of their even and odd samples */
+static void RealForward(const struct fft_plan *plan, const float *z,
+                        float *out)
+{
+    const unsigned n = plan->size;
+    const float *w = plan->real;
+
+    out[0] = z[0] + z[1];
+    out[1] = 0.f;
+    out[2 * n] = z[0] - z[1];
+    out[2 * n + 1] = 0.f;
+
+    for (unsigned k = 1; k < n; k++)
+    {
+        const float zr = z[2 * k], zi = z[2 * k + 1];
+        const float cr = z[2 * (n - k)], ci = -z[2 * (n - k) + 1];
+        /* Transforms of the even and odd samples */
+        const float er = .5f * (zr + cr), ei = .5f * (zi + ci);
+        const float odd_r = .5f * (zi - ci), odd_i = -.5f * (zr - cr);
+        const float wr = w[2 * k], wi = w[2 * k + 1];
+
+        out[2 * k]     = er + wr * odd_r - wi * odd_i;
+        out[2 * k + 1] = ei + wr * odd_i + wi * odd_r;
+    }
+}
+
+/* Conjugate of the complex values of n points, whose forward transform is
+ * the conjugate of n times the even and odd samples of the inverse real
+ * transform of 2n points */
+static void RealInverse(const struct fft_plan *plan, const float *in,
+                        float *z)
+{
+    const unsigned n = plan->size;
+    const float *w = plan->real;
+
+    /* The first and last values are real */
+    z[0] = in[0] + in[2 * n];
+    z[1] = -(in[0] - in[2 * n]);
+
+    for (unsigned k = 1; k < n; k++)
+    {
+        const float xr = in[2 * k], xi = in[2 * k + 1];
+        const float cr = in[2 * (n - k)], ci = -in[2 * (n - k) + 1];
+        const float er = xr + cr, ei = xi + ci;
+        const float dr = xr - cr, di = xi - ci;
+        /* times the conjugate twiddle factor */
+        const float wr = w[2 * k], wi = -w[2 * k + 1];
+        const float odd_r = dr * wr - di * wi, odd_i = dr * wi + di * wr;
+
+        /* conjugate of e + i * o */
+        z[2 * k]     = er - odd_i;
+        z[2 * k + 1] = -(ei + odd_r);
+    }
+}
+
+/*****************************************************************************
+ * API
+ *****************************************************************************/
+bool vlc_fft_IsSizeSupported(unsigned size, enum vlc_fft_type type)
+{
+    unsigned radices[FFT_MAX_STAGES];
+
+    if (type == VLC_FFT_REAL)
+    {
+        if (size & 1)
+            return false;
+        size /= 2;
+    }
+    return size > 0 && Factorize(size, radices) != UINT_MAX;
+}
+
+#undef vlc_fft_New
+vlc_fft_t *vlc_fft_New(vlc_object_t *obj, unsigned size,
+                       enum vlc_fft_type type)
+{
+    if (!vlc_fft_IsSizeSupported(size, type))
+        return NULL;
+
+    const unsigned n = type == VLC_FFT_REAL ? size / 2 : size;
+    const struct fft_plan *plan;
+    struct fft_plan *own = NULL;
+
+    /* Objects created outside of an instance, such as by the standalone
+     * tests, get their own tables */
+    if (obj->obj.libvlc != NULL)
+        plan = PlanGet(libvlc_priv(obj->obj.libvlc)->fft_plans, n);
+    else
+        plan = own = PlanCreate(n);
+    if (plan == NULL)
+        return NULL;
+
+    vlc_fft_t *fft = malloc(sizeof (*fft));
+    if (unlikely(fft == NULL))
+    {
+        if (own != NULL)
+            PlanDelete(own);
+        return NULL;
+    }
+
+    fft->plan = plan;
+    fft->own = own;
+    fft->type = type;
+    fft->sse = false;
+#ifdef HAVE_SSE2_INTRINSICS
+    fft->sse = vlc_CPU_SSE();
+#endif
+
+    for (unsigned i = 0; i < ARRAY_SIZE(fft->work); i++)
+    {
+        fft->work[i] = vlc_alloc(plan->size + 1, 2 * sizeof (float));
+        if (unlikely(fft->work[i] == NULL))
+        {
+            while (i > 0)
+                free(fft->work[--i]);
+            if (own != NULL)
+                PlanDelete(own);
+            free(fft);
+            return NULL;
+        }
+    }
+    return fft;
+}
+
+void vlc_fft_Delete(vlc_fft_t *fft)
+{
+    for (unsigned i = 0; i < ARRAY_SIZE(fft->work); i++)
+        free(fft->work[i]);
+    if (fft->own != NULL)
+        PlanDelete(fft->own);
+    free(fft);
+}
+
+void vlc_fft_Forward(vlc_fft_t *fft, const float *in, float *out)
+{
+    if (fft->type == VLC_FFT_COMPLEX)
+    {
+        Transform(fft, in, out);
+        return;
+    }
+
+    /* The even and odd samples as complex values */
+    Transform(fft, in, fft->work[2]);
+    RealForward(fft->plan, fft->work[2], out);
+}
+
+void vlc_fft_Inverse(vlc_fft_t *fft, const float *in, float *out)
+{
+    const unsigned n = fft->plan->size;
+
+    /* The inverse transform is the conjugate of the forward transform of
+     * the conjugate */
+    if (fft->type == VLC_FFT_COMPLEX)
+    {
+        memcpy(fft->work[2], in, 2 * sizeof (float) * n);
+        Conjugate(fft->work[2], n);
+    }
+    else
+        RealInverse(fft->plan, in, fft->work[2]);
+
+    Transform(fft, fft->work[2], out);
+    Conjugate(out, n);
+}
+
+void vlc_fft_PowerSpectrum(vlc_fft_t *fft, const float *in, float *power)
+{
+    const unsigned n = fft->plan->size;
+
+    assert(fft->type == VLC_FFT_REAL);
+    Transform(fft, in, fft->work[2]);
+    RealForward(fft->plan, fft->work[2], fft->work[0]);
+
+#ifdef HAVE_SSE2_INTRINSICS
+    if (fft->sse)
+        PowerSSE(fft->work[0], power, n + 1);
+    else
+#endif
+        PowerC(fft->work[0], power, n + 1);
+}
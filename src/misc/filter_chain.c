@@ -40,6 +40,8 @@ typedef struct chained_filter_t
     struct chained_filter_t *prev, *next;
     vlc_mouse_t *mouse;
     picture_t *pending;
+    mtime_t time; /**< Time spent filtering since the last report */
+    unsigned count; /**< Calls since the last report */
 } chained_filter_t;
 
 /* Only use this with filter objects from _this_ C module */
@@ -247,6 +249,8 @@ static filter_t *filter_chain_AppendInner( filter_chain_t *chain,
         vlc_mouse_Init( mouse );
     chained->mouse = mouse;
     chained->pending = NULL;
+    chained->time = 0;
+    chained->count = 0;
 
     msg_Dbg( parent, "Filter '%s' (%p) appended to chain",
              (name != NULL) ? name : module_get_name(filter->p_module, false),
@@ -373,6 +377,19 @@ int filter_chain_ForEach( filter_chain_t *chain,
     return VLC_SUCCESS;
 }
 
+void filter_chain_GetResetTimes( filter_chain_t *chain,
+                                 void (*cb)( filter_t *, mtime_t, unsigned,
+                                             void * ),
+                                 void *opaque )
+{
+    for( chained_filter_t *f = chain->first; f != NULL; f = f->next )
+    {
+        cb( &f->filter, f->time, f->count, opaque );
+        f->time = 0;
+        f->count = 0;
+    }
+}
+
 bool filter_chain_IsEmpty(const filter_chain_t *chain)
 {
     return chain->first == NULL;
@@ -396,7 +413,10 @@ static picture_t *FilterChainVideoFilter( chained_filter_t *f, picture_t *p_pic
     for( ; f != NULL; f = f->next )
     {
         filter_t *p_filter = &f->filter;
+        mtime_t i_start = mdate();
         p_pic = p_filter->pf_video_filter( p_filter, p_pic );
+        f->time += mdate() - i_start;
+        f->count++;
         if( !p_pic )
             break;
         if( f->pending )
@@ -0,0 +1,287 @@
+/*****************************************************************************
+ * filter_slices.c: slice threading of video filters
+ *****************************************************************************
+ * Copyright (C) 2020 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <assert.h>
+
+#include <vlc_common.h>
+#include <vlc_filter.h>
+#include <vlc_picture.h>
+
+#include "libvlc.h"
+
+/* Do not bother waking threads up for less lines than that */
+#define MIN_SLICE_LINES 16
+
+/* Slices of one filter_ExecuteSlices() call */
+struct filter_slice_job
+{
+    filter_t        *p_filter;
+    filter_slice_cb  pf_slice;
+    void            *p_data;
+    unsigned         i_overlap;
+
+    int              pi_lines[PICTURE_PLANE_MAX];
+    unsigned         pi_slices[PICTURE_PLANE_MAX];
+    int              i_planes;
+
+    unsigned         i_count;
+    unsigned         i_next;  /* next slice to start */
+    unsigned         i_done;
+    struct filter_slice_job *p_next;
+};
+
+struct vlc_filter_slices
+{
+    vlc_mutex_t lock;
+    vlc_cond_t  wait; /* for jobs, by the threads */
+    vlc_cond_t  done; /* for slices, by the callers */
+    struct filter_slice_job *p_jobs; /* jobs with slices left to start */
+    bool        b_exit;
+
+    unsigned     i_threads; /* besides the calling threads */
+    unsigned     i_started;
+    bool         b_started;
+    vlc_thread_t threads[];
+};
+
+struct filter_slice_thread
+{
+    struct vlc_filter_slices *p_pool;
+    unsigned i_worker;
+};
+
+static void RunSlice( const struct filter_slice_job *p_job, unsigned i_slice,
+                      unsigned i_worker )
+{
+    filter_slice_t slice = { .i_worker = i_worker };
+    int i_plane = 0;
+
+    while( i_slice >= p_job->pi_slices[i_plane] )
+        i_slice -= p_job->pi_slices[i_plane++];
+
+    const int i_lines = p_job->pi_lines[i_plane];
+    const unsigned i_count = p_job->pi_slices[i_plane];
+    slice.i_plane = i_plane;
+    slice.i_start = (int64_t)i_lines * i_slice / i_count;
+    slice.i_end   = (int64_t)i_lines * (i_slice + 1) / i_count;
+    slice.i_first = __MAX( slice.i_start - (int)p_job->i_overlap, 0 );
+
+    p_job->pf_slice( p_job->p_filter, &slice, p_job->p_data );
+}
+
+/* Must be called with the lock held */
+static unsigned TakeSlice( struct vlc_filter_slices *p_pool,
+                           struct filter_slice_job *p_job )
+{
+    unsigned i_slice = p_job->i_next++;
+
+    if( p_job->i_next == p_job->i_count )
+    {
+        struct filter_slice_job **pp = &p_pool->p_jobs;
+        while( *pp != p_job )
+            pp = &(*pp)->p_next;
+        *pp = p_job->p_next;
+    }
+    return i_slice;
+}
+
+static void *Thread( void *data )
+{
+    struct filter_slice_thread *p_thread = data;
+    struct vlc_filter_slices *p_pool = p_thread->p_pool;
+    const unsigned i_worker = p_thread->i_worker;
+
+    free( p_thread );
+
+    vlc_mutex_lock( &p_pool->lock );
+    for( ;; )
+    {
+        while( !p_pool->b_exit && p_pool->p_jobs == NULL )
+            vlc_cond_wait( &p_pool->wait, &p_pool->lock );
+        if( p_pool->b_exit )
+            break;
+
+        struct filter_slice_job *p_job = p_pool->p_jobs;
+        unsigned i_slice = TakeSlice( p_pool, p_job );
+        vlc_mutex_unlock( &p_pool->lock );
+
+        RunSlice( p_job, i_slice, i_worker );
+
+        vlc_mutex_lock( &p_pool->lock );
+        if( ++p_job->i_done == p_job->i_count )
+            vlc_cond_broadcast( &p_pool->done );
+    }
+    vlc_mutex_unlock( &p_pool->lock );
+    return NULL;
+}
+
+/* Must be called with the lock held */
+static void StartThreads( struct vlc_filter_slices *p_pool )
+{
+    /* Do not retry if a thread fails to start: the calling threads
+     * process the slices left by the missing ones */
+    p_pool->b_started = true;
+    while( p_pool->i_started < p_pool->i_threads )
+    {
+        struct filter_slice_thread *p_thread = malloc( sizeof( *p_thread ) );
+        if( unlikely(p_thread == NULL) )
+            break;
+
+        p_thread->p_pool = p_pool;
+        p_thread->i_worker = p_pool->i_started + 1;
+        if( vlc_clone( &p_pool->threads[p_pool->i_started], Thread, p_thread,
+                       VLC_THREAD_PRIORITY_VIDEO ) )
+        {
+            free( p_thread );
+            break;
+        }
+        p_pool->i_started++;
+    }
+}
+
+struct vlc_filter_slices *vlc_filter_slices_Create( libvlc_int_t *libvlc )
+{
+    int64_t i_threads = var_InheritInteger( libvlc, "filter-threads" );
+    if( i_threads <= 0 )
+        i_threads = vlc_GetCPUCount();
+    if( i_threads <= 0 )
+        i_threads = 1;
+
+    struct vlc_filter_slices *p_pool =
+        malloc( sizeof( *p_pool ) + (i_threads - 1) * sizeof( vlc_thread_t ) );
+    if( unlikely(p_pool == NULL) )
+        return NULL;
+
+    vlc_mutex_init( &p_pool->lock );
+    vlc_cond_init( &p_pool->wait );
+    vlc_cond_init( &p_pool->done );
+    p_pool->p_jobs = NULL;
+    p_pool->b_exit = false;
+    /* The threads are started on first use */
+    p_pool->i_threads = i_threads - 1;
+    p_pool->i_started = 0;
+    p_pool->b_started = false;
+
+    msg_Dbg( libvlc, "video filter slices: %u threads",
+             p_pool->i_threads + 1 );
+    return p_pool;
+}
+
+void vlc_filter_slices_Destroy( struct vlc_filter_slices *p_pool )
+{
+    assert( p_pool->p_jobs == NULL );
+
+    vlc_mutex_lock( &p_pool->lock );
+    p_pool->b_exit = true;
+    vlc_cond_broadcast( &p_pool->wait );
+    vlc_mutex_unlock( &p_pool->lock );
+
+    for( unsigned i = 0; i < p_pool->i_started; i++ )
+        vlc_join( p_pool->threads[i], NULL );
+
+    vlc_cond_destroy( &p_pool->done );
+    vlc_cond_destroy( &p_pool->wait );
+    vlc_mutex_destroy( &p_pool->lock );
+    free( p_pool );
+}
+
+static struct vlc_filter_slices *GetPool( filter_t *p_filter )
+{
+    return libvlc_priv( p_filter->obj.libvlc )->filter_slices;
+}
+
+unsigned filter_GetSliceWorkers( filter_t *p_filter )
+{
+    struct vlc_filter_slices *p_pool = GetPool( p_filter );
+
+    return p_pool != NULL ? p_pool->i_threads + 1 : 1;
+}
+
+void filter_ExecuteSlices( filter_t *p_filter, const picture_t *p_pic,
+                           int i_planes, unsigned i_overlap,
+                           filter_slice_cb pf_slice, void *p_data )
+{
+    struct vlc_filter_slices *p_pool = GetPool( p_filter );
+    const unsigned i_workers = filter_GetSliceWorkers( p_filter );
+    const int i_min_lines = __MAX( MIN_SLICE_LINES, 4 * i_overlap );
+
+    if( i_planes <= 0 || i_planes > p_pic->i_planes )
+        i_planes = p_pic->i_planes;
+
+    struct filter_slice_job job = {
+        .p_filter  = p_filter,
+        .pf_slice  = pf_slice,
+        .p_data    = p_data,
+        .i_overlap = i_overlap,
+        .i_planes  = i_planes,
+    };
+
+    for( int i = 0; i < i_planes; i++ )
+    {
+        const int i_lines = p_pic->p[i].i_visible_lines;
+        job.pi_lines[i] = i_lines;
+        job.pi_slices[i] = VLC_CLIP( i_lines / i_min_lines, 1, (int)i_workers );
+        job.i_count += job.pi_slices[i];
+    }
+
+    if( i_workers == 1 || job.i_count == (unsigned)i_planes )
+    {
+        /* Nothing to split */
+        for( unsigned i = 0; i < job.i_count; i++ )
+            RunSlice( &job, i, 0 );
+        return;
+    }
+
+    /* The job lives on the stack: do not leave before all the slices are
+     * done, even if the calling thread is cancelled */
+    int canc = vlc_savecancel();
+
+    vlc_mutex_lock( &p_pool->lock );
+    if( !p_pool->b_started )
+        StartThreads( p_pool );
+
+    struct filter_slice_job **pp = &p_pool->p_jobs;
+    while( *pp != NULL )
+        pp = &(*pp)->p_next;
+    *pp = &job;
+    vlc_cond_broadcast( &p_pool->wait );
+
+    /* The calling thread processes slices too */
+    while( job.i_next < job.i_count )
+    {
+        unsigned i_slice = TakeSlice( p_pool, &job );
+        vlc_mutex_unlock( &p_pool->lock );
+
+        RunSlice( &job, i_slice, 0 );
+
+        vlc_mutex_lock( &p_pool->lock );
+        job.i_done++;
+    }
+
+    while( job.i_done < job.i_count )
+        vlc_cond_wait( &p_pool->done, &p_pool->lock );
+    vlc_mutex_unlock( &p_pool->lock );
+
+    vlc_restorecancel( canc );
+}
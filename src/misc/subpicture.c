@@ -192,6 +192,7 @@ subpicture_region_private_t *subpicture_region_private_New( video_format_t *p_fm
     }
 
     p_private->p_picture = NULL;
+    p_private->opaque.b_valid = false;
     return p_private;
 }
 
@@ -24,6 +24,16 @@
 struct subpicture_region_private_t {
     video_format_t fmt;
     picture_t      *p_picture;
+
+    /* Bounding box of the non transparent pixels of p_picture, relative to
+     * the visible area of fmt. It is computed once, on first use. */
+    struct {
+        bool     b_valid;
+        unsigned i_x;
+        unsigned i_y;
+        unsigned i_width;
+        unsigned i_height;
+    } opaque;
 };
 
 subpicture_region_private_t *subpicture_region_private_New(video_format_t *);
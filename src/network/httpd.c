@@ -1199,6 +1199,11 @@ char* httpd_ClientIP(const httpd_client_t *cl, char *ip, int *port)
     return net_GetPeerAddress(vlc_tls_GetFD(cl->sock), ip, port) ? NULL : ip;
 }
 
+void httpd_ClientSetStreamMode(httpd_client_t *cl)
+{
+    cl->b_stream_mode = true;
+}
+
 char* httpd_ServerIP(const httpd_client_t *cl, char *ip, int *port)
 {
     return net_GetSockAddress(vlc_tls_GetFD(cl->sock), ip, port) ? NULL : ip;
@@ -1881,6 +1886,7 @@ static void httpdLoop(httpd_host_t *host)
                     bool do_close = false;
 
                     cl->url = NULL;
+                    cl->b_stream_mode = false;
 
                     if (cl->query.i_proto != HTTPD_PROTO_HTTP
                      || cl->query.i_version > 0)
@@ -0,0 +1,734 @@
+/*****************************************************************************
+ * metacache.c: persistent cache of preparsed metadata
+ *****************************************************************************
+ * Copyright (C) 2020 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <vlc_common.h>
+#include <vlc_arrays.h>
+#include <vlc_configuration.h>
+#include <vlc_fs.h>
+#include <vlc_memstream.h>
+#include <vlc_meta.h>
+#include <vlc_url.h>
+
+#include "input/item.h"
+#include "metacache.h"
+
+/*
+ * The cache file is a text file. Each entry starts with a line
+ *   @ <mtime> <size> <uri>
+ * followed by the record lines of the item:
+ *   d <duration>
+ *   m <meta type> <value>
+ *   x <extra meta name> <value>
+ *   i <category> <name> <value>
+ *   e <cat> <codec> <original fourcc> <id> <group> <priority> <bitrate>
+ *     <profile> <level> <language> <description>
+ *   a <rate> <physical channels> <channels> <bits per sample>
+ *   v <chroma> <width> <height> <x offset> <y offset> <visible width>
+ *     <visible height> <sar num> <sar den> <frame rate> <frame rate base>
+ *     <orientation>
+ *   s <encoding>
+ * where a, v and s lines describe the previous e line. Strings are URI
+ * encoded, and NULL strings are written as a single '*'.
+ *
+ * Entries are written from the least to the most recently used, so that the
+ * oldest ones are evicted first when the cache is full.
+ */
+#define METACACHE_HEADER "VLC preparser cache 1\n"
+#define METACACHE_FILE   "preparser.cache"
+#define METACACHE_FIELDS 16
+#define METACACHE_MAX_ENTRIES 4096
+/* Save the new entries regularly, not only on exit */
+#define METACACHE_SAVE_DELAY (CLOCK_FREQ * 60)
+
+struct metacache_entry
+{
+    int64_t  i_mtime;
+    uint64_t i_size;
+    uint64_t i_used; /* last use, from playlist_metacache_t.i_clock */
+    char    *psz_record;
+};
+
+struct playlist_metacache_t
+{
+    vlc_object_t *owner;
+    vlc_mutex_t lock;
+    bool b_loaded;
+    bool b_dirty;
+    mtime_t i_next_save;
+    uint64_t i_clock;
+    unsigned i_entries;
+    vlc_dictionary_t entries;
+};
+
+static void EntryDelete( void *p_entry, void *obj )
+{
+    struct metacache_entry *entry = p_entry;
+
+    free( entry->psz_record );
+    free( entry );
+    VLC_UNUSED( obj );
+}
+
+/* Gets the version of a local file, from its URI */
+static bool StatFile( const char *psz_uri, int64_t *pi_mtime,
+                      uint64_t *pi_size )
+{
+    struct stat st;
+    bool b_ret = false;
+
+    if( strncasecmp( psz_uri, "file://", 7 ) )
+        return false;
+
+    char *psz_path = vlc_uri2path( psz_uri );
+    if( psz_path == NULL )
+        return false;
+
+    if( vlc_stat( psz_path, &st ) == 0 && S_ISREG( st.st_mode ) )
+    {
+        *pi_mtime = st.st_mtime;
+        *pi_size = st.st_size;
+        b_ret = true;
+    }
+    free( psz_path );
+    return b_ret;
+}
+
+static void Insert( playlist_metacache_t *cache, const char *psz_uri,
+                    struct metacache_entry *entry )
+{
+    if( vlc_dictionary_has_key( &cache->entries, psz_uri ) )
+        vlc_dictionary_remove_value_for_key( &cache->entries, psz_uri,
+                                             EntryDelete, NULL );
+    else
+        cache->i_entries++;
+    entry->i_used = ++cache->i_clock;
+    vlc_dictionary_insert( &cache->entries, psz_uri, entry );
+}
+
+/* Evicts the least recently used entries */
+static void Trim( playlist_metacache_t *cache )
+{
+    while( cache->i_entries > METACACHE_MAX_ENTRIES )
+    {
+        const vlc_dictionary_entry_t *oldest = NULL;
+
+        for( int i = 0; i < cache->entries.i_size; i++ )
+            for( const vlc_dictionary_entry_t *p = cache->entries.p_entries[i];
+                 p != NULL; p = p->p_next )
+            {
+                const struct metacache_entry *entry = p->p_value;
+                if( oldest == NULL || entry->i_used <
+                    ((const struct metacache_entry *)oldest->p_value)->i_used )
+                    oldest = p;
+            }
+
+        vlc_dictionary_remove_value_for_key( &cache->entries, oldest->psz_key,
+                                             EntryDelete, NULL );
+        cache->i_entries--;
+        cache->b_dirty = true;
+    }
+}
+
+static char *GetPath( void )
+{
+    char *psz_dir = config_GetUserDir( VLC_CACHE_DIR );
+    char *psz_path;
+
+    if( psz_dir == NULL )
+        return NULL;
+    if( asprintf( &psz_path, "%s" DIR_SEP METACACHE_FILE, psz_dir ) < 0 )
+        psz_path = NULL;
+    free( psz_dir );
+    return psz_path;
+}
+
+/* Splits a line into space separated fields, in place */
+static unsigned Split( char *psz_line, char **ppsz_fields, unsigned i_max )
+{
+    unsigned i_count = 0;
+    char *psz_save;
+
+    for( char *psz = strtok_r( psz_line, " \n", &psz_save );
+         psz != NULL && i_count < i_max;
+         psz = strtok_r( NULL, " \n", &psz_save ) )
+        ppsz_fields[i_count++] = psz;
+    return i_count;
+}
+
+/* Decodes a string field in place, NULL for '*' */
+static const char *DecodeField( char *psz )
+{
+    if( !strcmp( psz, "*" ) )
+        return NULL;
+    return vlc_uri_decode( psz );
+}
+
+static void PutString( struct vlc_memstream *ms, const char *psz )
+{
+    char *psz_enc = psz ? vlc_uri_encode( psz ) : NULL;
+
+    vlc_memstream_putc( ms, ' ' );
+    vlc_memstream_puts( ms, psz_enc ? psz_enc : "*" );
+    free( psz_enc );
+}
+
+static void Load( playlist_metacache_t *cache )
+{
+    char *psz_path = GetPath();
+    if( psz_path == NULL )
+        return;
+
+    FILE *file = vlc_fopen( psz_path, "rt" );
+    free( psz_path );
+    if( file == NULL )
+        return;
+
+    char *psz_line = NULL;
+    size_t i_len = 0;
+    ssize_t i_read;
+    char *psz_uri = NULL;
+    struct metacache_entry *entry = NULL;
+    struct vlc_memstream ms;
+    unsigned i_stale = 0;
+
+    if( getline( &psz_line, &i_len, file ) < 0 ||
+        strcmp( psz_line, METACACHE_HEADER ) )
+    {
+        msg_Warn( cache->owner, "ignoring invalid preparser cache" );
+        goto end;
+    }
+
+    for( ;; )
+    {
+        i_read = getline( &psz_line, &i_len, file );
+
+        if( i_read < 0 || psz_line[0] == '@' )
+        {
+            /* Flush the previous entry */
+            if( entry != NULL && vlc_memstream_close( &ms ) == 0 )
+            {
+                entry->psz_record = ms.ptr;
+                Insert( cache, psz_uri, entry );
+            }
+            else
+                free( entry );
+            free( psz_uri );
+            entry = NULL;
+            psz_uri = NULL;
+        }
+        if( i_read < 0 )
+            break;
+
+        if( psz_line[0] == '@' )
+        {
+            char *ppsz_fields[4];
+            int64_t i_mtime;
+            uint64_t i_size;
+
+            if( Split( psz_line, ppsz_fields, 4 ) != 4 ||
+                sscanf( ppsz_fields[1], "%"SCNd64, &i_mtime ) != 1 ||
+                sscanf( ppsz_fields[2], "%"SCNu64, &i_size ) != 1 )
+                continue;
+
+            const char *psz_decoded = DecodeField( ppsz_fields[3] );
+            int64_t i_file_mtime;
+            uint64_t i_file_size;
+
+            /* Drop the entries of deleted or modified files */
+            if( psz_decoded == NULL ||
+                !StatFile( psz_decoded, &i_file_mtime, &i_file_size ) ||
+                i_file_mtime != i_mtime || i_file_size != i_size )
+            {
+                i_stale++;
+                continue;
+            }
+
+            entry = malloc( sizeof( *entry ) );
+            psz_uri = psz_decoded ? strdup( psz_decoded ) : NULL;
+            if( unlikely( entry == NULL || psz_uri == NULL ) ||
+                vlc_memstream_open( &ms ) )
+            {
+                free( entry );
+                free( psz_uri );
+                entry = NULL;
+                psz_uri = NULL;
+                continue;
+            }
+            entry->i_mtime = i_mtime;
+            entry->i_size = i_size;
+        }
+        else if( entry != NULL )
+            vlc_memstream_puts( &ms, psz_line );
+    }
+
+    if( i_stale > 0 )
+        cache->b_dirty = true;
+    Trim( cache );
+    msg_Dbg( cache->owner, "loaded %u preparsed items from cache (%u stale)",
+             cache->i_entries, i_stale );
+end:
+    free( psz_line );
+    fclose( file );
+}
+
+static int CompareUse( const void *a, const void *b )
+{
+    const struct metacache_entry *ea = (*(vlc_dictionary_entry_t **)a)->p_value;
+    const struct metacache_entry *eb = (*(vlc_dictionary_entry_t **)b)->p_value;
+
+    return (ea->i_used > eb->i_used) - (ea->i_used < eb->i_used);
+}
+
+static int Save( playlist_metacache_t *cache )
+{
+    char *psz_dir = config_GetUserDir( VLC_CACHE_DIR );
+    char *psz_path = GetPath();
+    char *psz_tmp;
+    int i_ret = VLC_EGENERIC;
+
+    if( psz_dir != NULL )
+        vlc_mkdir( psz_dir, 0700 );
+    free( psz_dir );
+
+    if( psz_path == NULL || asprintf( &psz_tmp, "%s.tmp", psz_path ) < 0 )
+    {
+        free( psz_path );
+        return VLC_ENOMEM;
+    }
+
+    vlc_dictionary_entry_t **pp_sorted =
+        vlc_alloc( cache->i_entries, sizeof( *pp_sorted ) );
+    if( unlikely( pp_sorted == NULL && cache->i_entries > 0 ) )
+    {
+        i_ret = VLC_ENOMEM;
+        goto end;
+    }
+
+    unsigned i_count = 0;
+    for( int i = 0; i < cache->entries.i_size; i++ )
+        for( vlc_dictionary_entry_t *p = cache->entries.p_entries[i];
+             p != NULL; p = p->p_next )
+            pp_sorted[i_count++] = p;
+    assert( i_count == cache->i_entries );
+    if( i_count > 0 )
+        qsort( pp_sorted, i_count, sizeof( *pp_sorted ), CompareUse );
+
+    FILE *file = vlc_fopen( psz_tmp, "wt" );
+    if( file == NULL )
+    {
+        msg_Warn( cache->owner, "cannot write preparser cache %s: %s",
+                  psz_tmp, vlc_strerror_c( errno ) );
+        goto end;
+    }
+
+    bool b_error = fputs( METACACHE_HEADER, file ) == EOF;
+    for( unsigned i = 0; i < i_count && !b_error; i++ )
+    {
+        const struct metacache_entry *entry = pp_sorted[i]->p_value;
+        char *psz_uri = vlc_uri_encode( pp_sorted[i]->psz_key );
+
+        b_error = psz_uri == NULL ||
+                  fprintf( file, "@ %"PRId64" %"PRIu64" %s\n",
+                           entry->i_mtime, entry->i_size, psz_uri ) < 0 ||
+                  fputs( entry->psz_record, file ) == EOF;
+        free( psz_uri );
+    }
+
+    if( fclose( file ) || b_error )
+    {
+        msg_Warn( cache->owner, "cannot write preparser cache %s", psz_tmp );
+        vlc_unlink( psz_tmp );
+    }
+    else if( vlc_rename( psz_tmp, psz_path ) )
+    {
+        msg_Warn( cache->owner, "cannot rename preparser cache: %s",
+                  vlc_strerror_c( errno ) );
+        vlc_unlink( psz_tmp );
+    }
+    else
+        i_ret = VLC_SUCCESS;
+
+end:
+    free( pp_sorted );
+    free( psz_tmp );
+    free( psz_path );
+    return i_ret;
+}
+
+static void EnsureLoaded( playlist_metacache_t *cache )
+{
+    if( !cache->b_loaded )
+    {
+        Load( cache );
+        cache->b_loaded = true;
+        cache->i_next_save = mdate() + METACACHE_SAVE_DELAY;
+    }
+}
+
+playlist_metacache_t *playlist_metacache_New( vlc_object_t *owner )
+{
+    playlist_metacache_t *cache = malloc( sizeof( *cache ) );
+    if( unlikely( cache == NULL ) )
+        return NULL;
+
+    cache->owner = owner;
+    cache->b_loaded = false;
+    cache->b_dirty = false;
+    cache->i_next_save = 0;
+    cache->i_clock = 0;
+    cache->i_entries = 0;
+    vlc_mutex_init( &cache->lock );
+    vlc_dictionary_init( &cache->entries, 1024 );
+    return cache;
+}
+
+void playlist_metacache_Delete( playlist_metacache_t *cache )
+{
+    if( cache->b_dirty )
+        Save( cache );
+
+    vlc_dictionary_clear( &cache->entries, EntryDelete, NULL );
+    vlc_mutex_destroy( &cache->lock );
+    free( cache );
+}
+
+/* Only regular local files can be cached */
+static void GetStamp( input_item_t *item, playlist_metacache_stamp_t *stamp )
+{
+    char *psz_uri = NULL;
+
+    stamp->b_valid = false;
+
+    vlc_mutex_lock( &item->lock );
+    if( item->i_type == ITEM_TYPE_FILE && !item->b_net && item->psz_uri )
+        psz_uri = strdup( item->psz_uri );
+    vlc_mutex_unlock( &item->lock );
+
+    if( psz_uri == NULL )
+        return;
+
+    stamp->b_valid = StatFile( psz_uri, &stamp->i_mtime, &stamp->i_size );
+    free( psz_uri );
+}
+
+static void RestoreRecord( input_item_t *item, char *psz_record )
+{
+    es_format_t fmt;
+    bool b_fmt = false;
+    char *psz_save;
+
+    for( char *psz_line = strtok_r( psz_record, "\n", &psz_save );
+         psz_line != NULL; psz_line = strtok_r( NULL, "\n", &psz_save ) )
+    {
+        char *f[METACACHE_FIELDS];
+        const unsigned n = Split( psz_line, f, METACACHE_FIELDS );
+
+        if( n == 0 )
+            continue;
+
+        switch( f[0][0] )
+        {
+            case 'd':
+                if( n == 2 )
+                    input_item_SetDuration( item, strtoll( f[1], NULL, 10 ) );
+                break;
+            case 'm':
+            {
+                const int i_type = n == 3 ? atoi( f[1] ) : -1;
+                if( i_type >= 0 && i_type < VLC_META_TYPE_COUNT )
+                    input_item_SetMeta( item, i_type, DecodeField( f[2] ) );
+                break;
+            }
+            case 'x':
+            {
+                const char *psz_name = n == 3 ? DecodeField( f[1] ) : NULL;
+                if( psz_name == NULL )
+                    break;
+                vlc_mutex_lock( &item->lock );
+                if( !item->p_meta )
+                    item->p_meta = vlc_meta_New();
+                if( item->p_meta )
+                    vlc_meta_AddExtra( item->p_meta, psz_name,
+                                       DecodeField( f[2] ) );
+                vlc_mutex_unlock( &item->lock );
+                break;
+            }
+            case 'i':
+            {
+                const char *psz_cat = n == 4 ? DecodeField( f[1] ) : NULL;
+                const char *psz_name = n == 4 ? DecodeField( f[2] ) : NULL;
+                const char *psz_value = n == 4 ? DecodeField( f[3] ) : NULL;
+                if( psz_cat && psz_name )
+                    input_item_AddInfo( item, psz_cat, psz_name, "%s",
+                                        psz_value ? psz_value : "" );
+                break;
+            }
+            case 'e':
+                if( b_fmt )
+                {
+                    input_item_UpdateTracksInfo( item, &fmt );
+                    es_format_Clean( &fmt );
+                    b_fmt = false;
+                }
+                if( n != 12 )
+                    break;
+                es_format_Init( &fmt, atoi( f[1] ), strtoul( f[2], NULL, 16 ) );
+                fmt.i_original_fourcc = strtoul( f[3], NULL, 16 );
+                fmt.i_id              = atoi( f[4] );
+                fmt.i_group           = atoi( f[5] );
+                fmt.i_priority        = atoi( f[6] );
+                fmt.i_bitrate         = strtoul( f[7], NULL, 10 );
+                fmt.i_profile         = atoi( f[8] );
+                fmt.i_level           = atoi( f[9] );
+                {
+                    const char *psz = DecodeField( f[10] );
+                    fmt.psz_language = psz ? strdup( psz ) : NULL;
+                    psz = DecodeField( f[11] );
+                    fmt.psz_description = psz ? strdup( psz ) : NULL;
+                }
+                b_fmt = true;
+                break;
+            case 'a':
+                if( !b_fmt || fmt.i_cat != AUDIO_ES || n != 5 )
+                    break;
+                fmt.audio.i_rate              = strtoul( f[1], NULL, 10 );
+                fmt.audio.i_physical_channels = strtoul( f[2], NULL, 10 );
+                fmt.audio.i_channels          = strtoul( f[3], NULL, 10 );
+                fmt.audio.i_bitspersample     = strtoul( f[4], NULL, 10 );
+                break;
+            case 'v':
+                if( !b_fmt || fmt.i_cat != VIDEO_ES || n != 13 )
+                    break;
+                fmt.video.i_chroma          = strtoul( f[1], NULL, 16 );
+                fmt.video.i_width           = strtoul( f[2], NULL, 10 );
+                fmt.video.i_height          = strtoul( f[3], NULL, 10 );
+                fmt.video.i_x_offset        = strtoul( f[4], NULL, 10 );
+                fmt.video.i_y_offset        = strtoul( f[5], NULL, 10 );
+                fmt.video.i_visible_width   = strtoul( f[6], NULL, 10 );
+                fmt.video.i_visible_height  = strtoul( f[7], NULL, 10 );
+                fmt.video.i_sar_num         = strtoul( f[8], NULL, 10 );
+                fmt.video.i_sar_den         = strtoul( f[9], NULL, 10 );
+                fmt.video.i_frame_rate      = strtoul( f[10], NULL, 10 );
+                fmt.video.i_frame_rate_base = strtoul( f[11], NULL, 10 );
+                fmt.video.orientation       = atoi( f[12] );
+                break;
+            case 's':
+                if( !b_fmt || fmt.i_cat != SPU_ES || n != 2 )
+                    break;
+                {
+                    const char *psz = DecodeField( f[1] );
+                    fmt.subs.psz_encoding = psz ? strdup( psz ) : NULL;
+                }
+                break;
+        }
+    }
+
+    if( b_fmt )
+    {
+        input_item_UpdateTracksInfo( item, &fmt );
+        es_format_Clean( &fmt );
+    }
+}
+
+int playlist_metacache_Restore( playlist_metacache_t *cache,
+                                input_item_t *item,
+                                playlist_metacache_stamp_t *stamp )
+{
+    GetStamp( item, stamp );
+    if( !stamp->b_valid )
+        return VLC_EGENERIC;
+
+    char *psz_uri = input_item_GetURI( item );
+    if( psz_uri == NULL )
+        return VLC_EGENERIC;
+
+    char *psz_record = NULL;
+
+    vlc_mutex_lock( &cache->lock );
+    EnsureLoaded( cache );
+    struct metacache_entry *entry =
+        vlc_dictionary_value_for_key( &cache->entries, psz_uri );
+    if( entry != NULL && entry->i_mtime == stamp->i_mtime &&
+        entry->i_size == stamp->i_size )
+    {
+        psz_record = strdup( entry->psz_record );
+        entry->i_used = ++cache->i_clock;
+    }
+    vlc_mutex_unlock( &cache->lock );
+    free( psz_uri );
+
+    if( psz_record == NULL )
+        return VLC_EGENERIC;
+
+    RestoreRecord( item, psz_record );
+    free( psz_record );
+    return VLC_SUCCESS;
+}
+
+static char *StoreRecord( input_item_t *item )
+{
+    struct vlc_memstream ms;
+
+    if( vlc_memstream_open( &ms ) )
+        return NULL;
+
+    vlc_mutex_lock( &item->lock );
+    vlc_memstream_printf( &ms, "d %"PRId64"\n", item->i_duration );
+
+    if( item->p_meta )
+    {
+        for( int i = 0; i < VLC_META_TYPE_COUNT; i++ )
+        {
+            const char *psz = vlc_meta_Get( item->p_meta, i );
+            if( psz == NULL )
+                continue;
+            vlc_memstream_printf( &ms, "m %d", i );
+            PutString( &ms, psz );
+            vlc_memstream_putc( &ms, '\n' );
+        }
+
+        char **ppsz_names = vlc_meta_CopyExtraNames( item->p_meta );
+        for( int i = 0; ppsz_names && ppsz_names[i]; i++ )
+        {
+            vlc_memstream_putc( &ms, 'x' );
+            PutString( &ms, ppsz_names[i] );
+            PutString( &ms, vlc_meta_GetExtra( item->p_meta, ppsz_names[i] ) );
+            vlc_memstream_putc( &ms, '\n' );
+            free( ppsz_names[i] );
+        }
+        free( ppsz_names );
+    }
+
+    for( int i = 0; i < item->i_categories; i++ )
+    {
+        const info_category_t *cat = item->pp_categories[i];
+        for( int j = 0; j < cat->i_infos; j++ )
+        {
+            vlc_memstream_putc( &ms, 'i' );
+            PutString( &ms, cat->psz_name );
+            PutString( &ms, cat->pp_infos[j]->psz_name );
+            PutString( &ms, cat->pp_infos[j]->psz_value );
+            vlc_memstream_putc( &ms, '\n' );
+        }
+    }
+
+    for( int i = 0; i < item->i_es; i++ )
+    {
+        const es_format_t *fmt = item->es[i];
+
+        vlc_memstream_printf( &ms, "e %d %08"PRIx32" %08"PRIx32" %d %d %d %u"
+                              " %d %d", fmt->i_cat, fmt->i_codec,
+                              fmt->i_original_fourcc, fmt->i_id, fmt->i_group,
+                              fmt->i_priority, fmt->i_bitrate, fmt->i_profile,
+                              fmt->i_level );
+        PutString( &ms, fmt->psz_language );
+        PutString( &ms, fmt->psz_description );
+        vlc_memstream_putc( &ms, '\n' );
+
+        switch( fmt->i_cat )
+        {
+            case AUDIO_ES:
+                vlc_memstream_printf( &ms, "a %u %u %u %u\n",
+                                      fmt->audio.i_rate,
+                                      fmt->audio.i_physical_channels,
+                                      fmt->audio.i_channels,
+                                      fmt->audio.i_bitspersample );
+                break;
+            case VIDEO_ES:
+                vlc_memstream_printf( &ms, "v %08"PRIx32" %u %u %u %u %u %u"
+                                      " %u %u %u %u %d\n",
+                                      fmt->video.i_chroma,
+                                      fmt->video.i_width, fmt->video.i_height,
+                                      fmt->video.i_x_offset,
+                                      fmt->video.i_y_offset,
+                                      fmt->video.i_visible_width,
+                                      fmt->video.i_visible_height,
+                                      fmt->video.i_sar_num,
+                                      fmt->video.i_sar_den,
+                                      fmt->video.i_frame_rate,
+                                      fmt->video.i_frame_rate_base,
+                                      (int)fmt->video.orientation );
+                break;
+            case SPU_ES:
+                vlc_memstream_putc( &ms, 's' );
+                PutString( &ms, fmt->subs.psz_encoding );
+                vlc_memstream_putc( &ms, '\n' );
+                break;
+            default:
+                break;
+        }
+    }
+    vlc_mutex_unlock( &item->lock );
+
+    if( vlc_memstream_close( &ms ) )
+        return NULL;
+    return ms.ptr;
+}
+
+void playlist_metacache_Store( playlist_metacache_t *cache,
+                               input_item_t *item,
+                               const playlist_metacache_stamp_t *stamp )
+{
+    if( !stamp->b_valid )
+        return;
+
+    char *psz_uri = input_item_GetURI( item );
+    struct metacache_entry *entry = malloc( sizeof( *entry ) );
+    if( unlikely( psz_uri == NULL || entry == NULL ) )
+        goto error;
+
+    entry->i_mtime = stamp->i_mtime;
+    entry->i_size = stamp->i_size;
+    entry->psz_record = StoreRecord( item );
+    if( unlikely( entry->psz_record == NULL ) )
+        goto error;
+
+    vlc_mutex_lock( &cache->lock );
+    EnsureLoaded( cache );
+    Insert( cache, psz_uri, entry );
+    Trim( cache );
+    cache->b_dirty = true;
+
+    const mtime_t now = mdate();
+    if( now >= cache->i_next_save )
+    {
+        if( Save( cache ) == VLC_SUCCESS )
+            cache->b_dirty = false;
+        cache->i_next_save = now + METACACHE_SAVE_DELAY;
+    }
+    vlc_mutex_unlock( &cache->lock );
+
+    free( psz_uri );
+    return;
+
+error:
+    free( entry );
+    free( psz_uri );
+}
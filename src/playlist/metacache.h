@@ -0,0 +1,78 @@
+/*****************************************************************************
+ * metacache.h: persistent cache of preparsed metadata
+ *****************************************************************************
+ * Copyright (C) 2020 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef _PLAYLIST_METACACHE_H
+#define _PLAYLIST_METACACHE_H 1
+
+#include <vlc_input_item.h>
+
+/**
+ * Metadata cache opaque structure.
+ *
+ * The metadata cache remembers the result of preparsing local files (meta
+ * data, duration, tracks and information) across runs. Entries are keyed by
+ * URI, and are only valid as long as the modification time and the size of
+ * the file are unchanged.
+ */
+typedef struct playlist_metacache_t playlist_metacache_t;
+
+/**
+ * Identifies a version of a local file.
+ */
+typedef struct
+{
+    bool     b_valid; /**< false if the item cannot be cached */
+    int64_t  i_mtime;
+    uint64_t i_size;
+} playlist_metacache_stamp_t;
+
+/**
+ * This function creates the metadata cache.
+ *
+ * The cache file is only read on first use.
+ */
+playlist_metacache_t *playlist_metacache_New( vlc_object_t * );
+
+/**
+ * This function destroys the metadata cache, and saves it if it was
+ * modified.
+ */
+void playlist_metacache_Delete( playlist_metacache_t * );
+
+/**
+ * This function restores the preparsed data of an item from the cache.
+ *
+ * @param stamp [out] version of the item file, to be passed to
+ * playlist_metacache_Store() once the item has been preparsed.
+ * @return VLC_SUCCESS if the item was restored, and does not need to be
+ * preparsed.
+ */
+int playlist_metacache_Restore( playlist_metacache_t *, input_item_t *,
+                                playlist_metacache_stamp_t *stamp );
+
+/**
+ * This function stores the preparsed data of an item into the cache.
+ *
+ * @param stamp version of the file, before it was preparsed
+ */
+void playlist_metacache_Store( playlist_metacache_t *, input_item_t *,
+                               const playlist_metacache_stamp_t *stamp );
+
+#endif
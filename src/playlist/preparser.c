@@ -23,6 +23,8 @@
 # include "config.h"
 #endif
 
+#include <assert.h>
+
 #include <vlc_common.h>
 
 #include "misc/background_worker.h"
@@ -30,15 +32,128 @@
 #include "input/input_internal.h"
 #include "preparser.h"
 #include "fetcher.h"
+#include "metacache.h"
+
+#define PREPARSER_MAX_LIMITS 16
+
+struct preparser_limit
+{
+    char psz_scheme[16];
+    unsigned i_max;
+    unsigned i_running;
+};
 
 struct playlist_preparser_t
 {
     vlc_object_t* owner;
     playlist_fetcher_t* fetcher;
+    playlist_metacache_t* cache;
     struct background_worker* worker;
     atomic_bool deactivated;
+
+    vlc_mutex_t limits_lock;
+    struct preparser_limit limits[PREPARSER_MAX_LIMITS];
+    unsigned limits_count;
+};
+
+struct preparser_task
+{
+    input_item_t* item;
+    input_thread_t* input; /**< NULL if restored from the cache */
+    struct preparser_limit* limit;
+    playlist_metacache_stamp_t stamp;
+    atomic_bool has_subitems;
 };
 
+/* Parses "scheme=max,scheme=max,..." */
+static void ParseLimits( playlist_preparser_t* preparser, const char* psz )
+{
+    preparser->limits_count = 0;
+
+    while( psz && *psz && preparser->limits_count < PREPARSER_MAX_LIMITS )
+    {
+        struct preparser_limit* limit =
+            &preparser->limits[preparser->limits_count];
+        size_t len = strcspn( psz, "=," );
+
+        if( psz[len] == '=' && len > 0 && len < sizeof( limit->psz_scheme ) )
+        {
+            unsigned max = strtoul( &psz[len + 1], NULL, 10 );
+            if( max > 0 )
+            {
+                memcpy( limit->psz_scheme, psz, len );
+                limit->psz_scheme[len] = '\0';
+                limit->i_max = max;
+                limit->i_running = 0;
+                preparser->limits_count++;
+            }
+        }
+
+        psz = strchr( psz, ',' );
+        if( psz )
+            psz++;
+    }
+}
+
+static struct preparser_limit* GetLimit( playlist_preparser_t* preparser,
+                                         input_item_t* item )
+{
+    struct preparser_limit* limit = NULL;
+
+    if( preparser->limits_count == 0 )
+        return NULL;
+
+    vlc_mutex_lock( &item->lock );
+    const char* psz_uri = item->psz_uri;
+    const char* psz_end = psz_uri ? strstr( psz_uri, "://" ) : NULL;
+    if( psz_end )
+    {
+        for( unsigned i = 0; i < preparser->limits_count; i++ )
+        {
+            const char* psz_scheme = preparser->limits[i].psz_scheme;
+            size_t len = strlen( psz_scheme );
+            if( (size_t)( psz_end - psz_uri ) == len &&
+                !strncasecmp( psz_uri, psz_scheme, len ) )
+            {
+                limit = &preparser->limits[i];
+                break;
+            }
+        }
+    }
+    vlc_mutex_unlock( &item->lock );
+    return limit;
+}
+
+static void ReleaseLimit( playlist_preparser_t* preparser,
+                          struct preparser_limit* limit )
+{
+    if( limit == NULL )
+        return;
+
+    vlc_mutex_lock( &preparser->limits_lock );
+    assert( limit->i_running > 0 );
+    limit->i_running--;
+    vlc_mutex_unlock( &preparser->limits_lock );
+}
+
+static bool PreparserAdmit( void* preparser_, void* item_ )
+{
+    playlist_preparser_t* preparser = preparser_;
+    struct preparser_limit* limit = GetLimit( preparser, item_ );
+    bool admitted = true;
+
+    if( limit == NULL )
+        return true;
+
+    vlc_mutex_lock( &preparser->limits_lock );
+    if( limit->i_running < limit->i_max )
+        limit->i_running++;
+    else
+        admitted = false;
+    vlc_mutex_unlock( &preparser->limits_lock );
+    return admitted;
+}
+
 static int InputEvent( vlc_object_t* obj, const char* varname,
     vlc_value_t old, vlc_value_t cur, void* worker )
 {
@@ -50,60 +165,127 @@ static int InputEvent( vlc_object_t* obj, const char* varname,
     return VLC_SUCCESS;
 }
 
+static void SubItemsAdded( const vlc_event_t* event, void* task_ )
+{
+    struct preparser_task* task = task_;
+
+    atomic_store( &task->has_subitems, true );
+    VLC_UNUSED( event );
+}
+
 static int PreparserOpenInput( void* preparser_, void* item_, void** out )
 {
     playlist_preparser_t* preparser = preparser_;
+    input_item_t* item = item_;
+    struct preparser_task* task = malloc( sizeof( *task ) );
 
-    input_thread_t* input = input_CreatePreparser( preparser->owner, item_ );
-    if( !input )
+    if( unlikely( !task ) )
+    {
+        ReleaseLimit( preparser, GetLimit( preparser, item ) );
+        input_item_SignalPreparseEnded( item, ITEM_PREPARSE_FAILED );
+        return VLC_ENOMEM;
+    }
+
+    task->item = item;
+    task->input = NULL;
+    task->limit = GetLimit( preparser, item );
+    task->stamp.b_valid = false;
+    atomic_init( &task->has_subitems, false );
+
+    /* Unchanged local files do not need to be opened at all */
+    if( preparser->cache &&
+        !playlist_metacache_Restore( preparser->cache, item, &task->stamp ) )
     {
-        input_item_SignalPreparseEnded( item_, ITEM_PREPARSE_FAILED );
-        return VLC_EGENERIC;
+        *out = task;
+        return VLC_SUCCESS;
     }
 
+    input_thread_t* input = input_CreatePreparser( preparser->owner, item );
+    if( !input )
+        goto error;
+
+    if( task->stamp.b_valid )
+        vlc_event_attach( &item->event_manager, vlc_InputItemSubItemTreeAdded,
+                          SubItemsAdded, task );
+
     var_AddCallback( input, "intf-event", InputEvent, preparser->worker );
     if( input_Start( input ) )
     {
         var_DelCallback( input, "intf-event", InputEvent, preparser->worker );
+        if( task->stamp.b_valid )
+            vlc_event_detach( &item->event_manager,
+                              vlc_InputItemSubItemTreeAdded,
+                              SubItemsAdded, task );
         input_Close( input );
-        input_item_SignalPreparseEnded( item_, ITEM_PREPARSE_FAILED );
-        return VLC_EGENERIC;
+        goto error;
     }
 
-    *out = input;
+    task->input = input;
+    *out = task;
     return VLC_SUCCESS;
+
+error:
+    ReleaseLimit( preparser, task->limit );
+    free( task );
+    input_item_SignalPreparseEnded( item, ITEM_PREPARSE_FAILED );
+    return VLC_EGENERIC;
 }
 
-static int PreparserProbeInput( void* preparser_, void* input_ )
+static int PreparserProbeInput( void* preparser_, void* task_ )
 {
-    int state = input_GetState( input_ );
+    struct preparser_task* task = task_;
+
+    if( task->input == NULL )
+        return true;
+
+    int state = input_GetState( task->input );
     return state == END_S || state == ERROR_S;
     VLC_UNUSED( preparser_ );
 }
 
-static void PreparserCloseInput( void* preparser_, void* input_ )
+static void PreparserCloseInput( void* preparser_, void* task_ )
 {
     playlist_preparser_t* preparser = preparser_;
-    input_thread_t* input = input_;
-    input_item_t* item = input_priv(input)->p_item;
+    struct preparser_task* task = task_;
+    input_thread_t* input = task->input;
+    input_item_t* item = task->item;
 
-    var_DelCallback( input, "intf-event", InputEvent, preparser->worker );
-
-    int status;
-    switch( input_GetState( input ) )
+    int status = ITEM_PREPARSE_DONE;
+    if( input )
     {
-        case END_S:
-            status = ITEM_PREPARSE_DONE;
-            break;
-        case ERROR_S:
-            status = ITEM_PREPARSE_FAILED;
-            break;
-        default:
-            status = ITEM_PREPARSE_TIMEOUT;
+        var_DelCallback( input, "intf-event", InputEvent, preparser->worker );
+
+        switch( input_GetState( input ) )
+        {
+            case END_S:
+                status = ITEM_PREPARSE_DONE;
+                break;
+            case ERROR_S:
+                status = ITEM_PREPARSE_FAILED;
+                break;
+            default:
+                status = ITEM_PREPARSE_TIMEOUT;
+        }
+
+        input_Stop( input );
+        input_Close( input );
+
+        if( task->stamp.b_valid )
+        {
+            vlc_event_detach( &item->event_manager,
+                              vlc_InputItemSubItemTreeAdded,
+                              SubItemsAdded, task );
+            /* Playlists and the like are not cached, their sub-items would
+             * not be restored */
+            if( status == ITEM_PREPARSE_DONE &&
+                !atomic_load( &task->has_subitems ) )
+                playlist_metacache_Store( preparser->cache, item,
+                                          &task->stamp );
+        }
     }
 
-    input_Stop( input );
-    input_Close( input );
+    ReleaseLimit( preparser, task->limit );
+    free( task );
 
     if( preparser->fetcher )
     {
@@ -124,6 +306,8 @@ playlist_preparser_t* playlist_preparser_New( vlc_object_t *parent )
 
     struct background_worker_config conf = {
         .default_timeout = var_InheritInteger( parent, "preparse-timeout" ),
+        .max_threads = var_InheritInteger( parent, "preparse-threads" ),
+        .pf_admit = PreparserAdmit,
         .pf_start = PreparserOpenInput,
         .pf_probe = PreparserProbeInput,
         .pf_stop = PreparserCloseInput,
@@ -147,6 +331,19 @@ playlist_preparser_t* playlist_preparser_New( vlc_object_t *parent )
     if( unlikely( !preparser->fetcher ) )
         msg_Warn( parent, "unable to create art fetcher" );
 
+    preparser->cache = NULL;
+    if( var_InheritBool( parent, "preparse-cache" ) )
+    {
+        preparser->cache = playlist_metacache_New( parent );
+        if( unlikely( !preparser->cache ) )
+            msg_Warn( parent, "unable to create preparser cache" );
+    }
+
+    vlc_mutex_init( &preparser->limits_lock );
+    char* limits = var_InheritString( parent, "preparse-protocol-limits" );
+    ParseLimits( preparser, limits );
+    free( limits );
+
     return preparser;
 }
 
@@ -204,5 +401,9 @@ void playlist_preparser_Delete( playlist_preparser_t *preparser )
     if( preparser->fetcher )
         playlist_fetcher_Delete( preparser->fetcher );
 
+    if( preparser->cache )
+        playlist_metacache_Delete( preparser->cache );
+
+    vlc_mutex_destroy( &preparser->limits_lock );
     free( preparser );
 }
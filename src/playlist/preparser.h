@@ -30,13 +30,14 @@
  * Preparser opaque structure.
  *
  * The preparser object will retrieve the meta data of any given input item in
- * an asynchronous way.
+ * an asynchronous way, on a pool of "preparse-threads" threads. The results
+ * for local files are kept in a persistent cache.
  * It will also issue art fetching requests.
  */
 typedef struct playlist_preparser_t playlist_preparser_t;
 
 /**
- * This function creates the preparser object and thread.
+ * This function creates the preparser object and threads.
  */
 playlist_preparser_t *playlist_preparser_New( vlc_object_t * );
 
@@ -69,7 +70,7 @@ void playlist_preparser_fetcher_Push( playlist_preparser_t *, input_item_t *,
 void playlist_preparser_Cancel( playlist_preparser_t *, void *id );
 
 /**
- * This function destroys the preparser object and thread.
+ * This function destroys the preparser object and threads.
  *
  * All pending input items will be released.
  */
@@ -38,6 +38,7 @@
 #include <stdlib.h>                                                /* free() */
 #include <stdio.h>                                              /* sprintf() */
 #include <string.h>
+#include <time.h>
 
 #include <vlc_sout.h>
 
@@ -73,6 +74,13 @@ static int  mrl_Parse( mrl_t *p_mrl, const char *psz_mrl );
 /* mrl_Clean: clean p_mrl  after a call to mrl_Parse */
 static void mrl_Clean( mrl_t *p_mrl );
 
+/* Access outputs are allocated with the statistics of their chain */
+typedef struct
+{
+    sout_access_out_t access;
+    sout_stats_t     *p_stats;
+} sout_access_out_priv_t;
+
 #undef sout_NewInstance
 
 /*****************************************************************************
@@ -169,6 +177,7 @@ sout_packetizer_input_t *sout_InputNew( sout_instance_t *p_sout,
 
     /* *** add it to the stream chain */
     vlc_mutex_lock( &p_sout->lock );
+    p_input->p_stats = var_InheritAddress( p_sout, "sout-stats" );
     p_input->id = p_sout->p_stream->pf_add( p_sout->p_stream, p_fmt );
     vlc_mutex_unlock( &p_sout->lock );
 
@@ -233,13 +242,77 @@ int sout_InputSendBuffer( sout_packetizer_input_t *p_input,
     int                 i_ret;
 
     vlc_mutex_lock( &p_sout->lock );
-    i_ret = p_sout->p_stream->pf_send( p_sout->p_stream,
-                                       p_input->id, p_buffer );
+    if( p_input->p_stats != NULL )
+        i_ret = sout_StatsSend( p_input->p_stats, p_sout->p_stream,
+                                p_input->id, p_buffer );
+    else
+        i_ret = p_sout->p_stream->pf_send( p_sout->p_stream,
+                                           p_input->id, p_buffer );
     vlc_mutex_unlock( &p_sout->lock );
 
     return i_ret;
 }
 
+/*****************************************************************************
+ * Statistics
+ *****************************************************************************/
+#define SOUT_STATS_PERIOD CLOCK_FREQ
+
+static mtime_t ThreadCPUTime( void )
+{
+#ifdef CLOCK_THREAD_CPUTIME_ID
+    struct timespec ts;
+
+    if( clock_gettime( CLOCK_THREAD_CPUTIME_ID, &ts ) == 0 )
+        return INT64_C(1000000) * ts.tv_sec + ts.tv_nsec / 1000;
+#endif
+    return 0;
+}
+
+void sout_StatsInit( sout_stats_t *p_stats )
+{
+    atomic_init( &p_stats->i_bytes, 0 );
+    atomic_init( &p_stats->i_cpu_time, 0 );
+    p_stats->i_last_bytes = 0;
+    p_stats->i_last_date = mdate();
+    p_stats->i_bitrate = 0;
+}
+
+/* Only the synchronous part of the chain (muxing, packetizing, and
+ * transcoding unless threaded) is accounted */
+int sout_StatsSend( sout_stats_t *p_stats, sout_stream_t *p_stream,
+                    sout_stream_id_sys_t *id, block_t *p_buffer )
+{
+    const mtime_t i_start = ThreadCPUTime();
+    int i_ret = sout_StreamIdSend( p_stream, id, p_buffer );
+
+    atomic_fetch_add_explicit( &p_stats->i_cpu_time,
+                               ThreadCPUTime() - i_start,
+                               memory_order_relaxed );
+    return i_ret;
+}
+
+/* The bitrate is averaged between the calls, at least one period apart */
+void sout_StatsGet( sout_stats_t *p_stats, int64_t *pi_cpu_time,
+                    int64_t *pi_bitrate )
+{
+    const mtime_t i_now = mdate();
+
+    if( i_now - p_stats->i_last_date >= SOUT_STATS_PERIOD )
+    {
+        uint64_t i_bytes = atomic_load_explicit( &p_stats->i_bytes,
+                                                 memory_order_relaxed );
+
+        p_stats->i_bitrate = (i_bytes - p_stats->i_last_bytes) * 8
+                           * CLOCK_FREQ / (i_now - p_stats->i_last_date);
+        p_stats->i_last_bytes = i_bytes;
+        p_stats->i_last_date = i_now;
+    }
+    *pi_cpu_time = atomic_load_explicit( &p_stats->i_cpu_time,
+                                         memory_order_relaxed );
+    *pi_bitrate = p_stats->i_bitrate;
+}
+
 #undef sout_AccessOutNew
 /*****************************************************************************
  * sout_AccessOutNew: allocate a new access out
@@ -247,12 +320,15 @@ int sout_InputSendBuffer( sout_packetizer_input_t *p_input,
 sout_access_out_t *sout_AccessOutNew( vlc_object_t *p_sout,
                                       const char *psz_access, const char *psz_name )
 {
+    sout_access_out_priv_t *p_priv;
     sout_access_out_t *p_access;
     char              *psz_next;
 
-    p_access = vlc_custom_create( p_sout, sizeof( *p_access ), "access out" );
-    if( !p_access )
+    p_priv = vlc_custom_create( p_sout, sizeof( *p_priv ), "access out" );
+    if( !p_priv )
         return NULL;
+    p_priv->p_stats = var_InheritAddress( p_sout, "sout-stats" );
+    p_access = &p_priv->access;
 
     psz_next = config_ChainCreate( &p_access->psz_access, &p_access->p_cfg,
                                    psz_access );
@@ -320,7 +396,13 @@ ssize_t sout_AccessOutRead( sout_access_out_t *p_access, block_t *p_buffer )
  *****************************************************************************/
 ssize_t sout_AccessOutWrite( sout_access_out_t *p_access, block_t *p_buffer )
 {
-    return p_access->pf_write( p_access, p_buffer );
+    sout_access_out_priv_t *p_priv = (sout_access_out_priv_t *)p_access;
+    ssize_t i_ret = p_access->pf_write( p_access, p_buffer );
+
+    if( i_ret > 0 && p_priv->p_stats != NULL )
+        atomic_fetch_add_explicit( &p_priv->p_stats->i_bytes, i_ret,
+                                   memory_order_relaxed );
+    return i_ret;
 }
 
 /**
@@ -29,6 +29,32 @@
 
 # include <vlc_sout.h>
 # include <vlc_network.h>
+# include <vlc_atomic.h>
+
+/****************************************************************************
+ * sout_stats_t: statistics of a stream output chain
+ *
+ * The access outputs account the bytes they write to the statistics found in
+ * the "sout-stats" address variable of their parents when they are created,
+ * and so do the instances for the time spent sending to their chain.
+ ****************************************************************************/
+typedef struct
+{
+    atomic_uint_fast64_t i_bytes;    /* written by the access outputs */
+    atomic_uint_fast64_t i_cpu_time; /* spent sending to the chain */
+
+    /* bitrate sampling, see sout_StatsGet() */
+    uint64_t i_last_bytes;
+    mtime_t  i_last_date;
+    int64_t  i_bitrate;
+} sout_stats_t;
+
+void sout_StatsInit( sout_stats_t * );
+int sout_StatsSend( sout_stats_t *, sout_stream_t *, sout_stream_id_sys_t *,
+                    block_t * );
+/* Not thread-safe: the callers must serialize their calls */
+void sout_StatsGet( sout_stats_t *, int64_t *pi_cpu_time,
+                    int64_t *pi_bitrate );
 
 /****************************************************************************
  * sout_packetizer_input_t: p_sout <-> p_packetizer
@@ -38,6 +64,7 @@ struct sout_packetizer_input_t
     sout_instance_t     *p_sout;
 
     sout_stream_id_sys_t    *id;
+    sout_stats_t            *p_stats;
 };
 
 sout_instance_t *sout_NewInstance( vlc_object_t *, const char * );
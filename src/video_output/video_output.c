@@ -47,6 +47,7 @@
 #include <vlc_vout_osd.h>
 #include <vlc_image.h>
 #include <vlc_plugin.h>
+#include <vlc_modules.h>
 
 #include <libvlc.h>
 #include "vout_internal.h"
@@ -74,6 +75,9 @@ static void VoutDestructor(vlc_object_t *);
 /* Better be in advance when awakening than late... */
 #define VOUT_MWAIT_TOLERANCE (INT64_C(4000))
 
+/* Period of the static filter thread statistics */
+#define VOUT_FILTER_REPORT_DELAY (INT64_C(10000000))
+
 /* */
 static int VoutValidateFormat(video_format_t *dst,
                               const video_format_t *src)
@@ -144,6 +148,9 @@ static vout_thread_t *VoutCreate(vlc_object_t *object,
 
     /* Initialize locks */
     vlc_mutex_init(&vout->p->filter.lock);
+    vlc_mutex_init(&vout->p->pipeline.lock);
+    vlc_cond_init(&vout->p->pipeline.wait);
+    vlc_cond_init(&vout->p->pipeline.idle);
     vlc_mutex_init(&vout->p->spu_lock);
 
     /* Take care of some "interface/control" related initialisations */
@@ -292,6 +299,9 @@ static void VoutDestructor(vlc_object_t *object)
 
     /* Destroy the locks */
     vlc_mutex_destroy(&vout->p->spu_lock);
+    vlc_cond_destroy(&vout->p->pipeline.idle);
+    vlc_cond_destroy(&vout->p->pipeline.wait);
+    vlc_mutex_destroy(&vout->p->pipeline.lock);
     vlc_mutex_destroy(&vout->p->filter.lock);
     vout_control_Clean(&vout->p->control);
 
@@ -322,6 +332,12 @@ void vout_ChangePause(vout_thread_t *vout, bool is_paused, mtime_t date)
     vout_control_WaitEmpty(&vout->p->control);
 }
 
+void vout_ChangeLowLatency(vout_thread_t *vout, bool is_low_latency)
+{
+    vout_control_PushBool(&vout->p->control, VOUT_CONTROL_LOW_LATENCY,
+                          is_low_latency);
+}
+
 void vout_GetResetStatistic(vout_thread_t *vout, unsigned *restrict displayed,
                             unsigned *restrict lost)
 {
@@ -336,11 +352,21 @@ void vout_Flush(vout_thread_t *vout, mtime_t date)
 
 bool vout_IsEmpty(vout_thread_t *vout)
 {
-    picture_t *picture = picture_fifo_Peek(vout->p->decoder_fifo);
-    if (picture)
+    vout_thread_sys_t *sys = vout->p;
+
+    picture_t *picture = picture_fifo_Peek(sys->decoder_fifo);
+    if (picture) {
         picture_Release(picture);
+        return false;
+    }
 
-    return !picture;
+    /* Pictures being filtered ahead of display */
+    vlc_mutex_lock(&sys->pipeline.lock);
+    bool is_empty = sys->pipeline.count == 0 && !sys->pipeline.busy &&
+                    sys->pipeline.requeue == NULL &&
+                    sys->pipeline.pending == NULL;
+    vlc_mutex_unlock(&sys->pipeline.lock);
+    return is_empty;
 }
 
 void vout_NextPicture(vout_thread_t *vout, mtime_t *duration)
@@ -429,6 +455,11 @@ void vout_PutPicture(vout_thread_t *vout, picture_t *picture)
     {
         picture_fifo_Push(vout->p->decoder_fifo, picture);
 
+        vlc_mutex_lock(&vout->p->pipeline.lock);
+        vout->p->pipeline.has_input = true;
+        vlc_cond_signal(&vout->p->pipeline.wait);
+        vlc_mutex_unlock(&vout->p->pipeline.lock);
+
         vout_control_Wake(&vout->p->control);
     }
     else
@@ -694,6 +725,10 @@ static picture_t *VoutVideoFilterStaticNewPicture(filter_t *filter)
 {
     vout_thread_t *vout = filter->owner.sys;
 
+    /* The private pool also holds the prepared pictures */
+    if (vout->p->pipeline.active)
+        return VoutVideoFilterInteractiveNewPicture(filter);
+
     vlc_assert_locked(&vout->p->filter.lock);
     if (filter_chain_IsEmpty(vout->p->filter.chain_interactive))
         return VoutVideoFilterInteractiveNewPicture(filter);
@@ -701,6 +736,306 @@ static picture_t *VoutVideoFilterStaticNewPicture(filter_t *filter)
     return picture_NewFromFormat(&filter->fmt_out.video);
 }
 
+/*****************************************************************************
+ * Static filter thread
+ *
+ * When enabled, the static filters run ahead of display on a thread of their
+ * own, and the video output thread takes the filtered pictures from a queue.
+ * The video output thread suspends the filter thread before touching the
+ * static filter chain or the queue.
+ *****************************************************************************/
+void vout_SuspendFilterThread(vout_thread_t *vout)
+{
+    vout_thread_sys_t *sys = vout->p;
+
+    vlc_mutex_lock(&sys->pipeline.lock);
+    sys->pipeline.suspend++;
+    while (sys->pipeline.busy)
+        vlc_cond_wait(&sys->pipeline.idle, &sys->pipeline.lock);
+    vlc_mutex_unlock(&sys->pipeline.lock);
+}
+
+void vout_ResumeFilterThread(vout_thread_t *vout)
+{
+    vout_thread_sys_t *sys = vout->p;
+
+    vlc_mutex_lock(&sys->pipeline.lock);
+    assert(sys->pipeline.suspend > 0);
+    if (--sys->pipeline.suspend == 0)
+        vlc_cond_signal(&sys->pipeline.wait);
+    vlc_mutex_unlock(&sys->pipeline.lock);
+}
+
+static bool PictureIsFlushed(const picture_t *picture, bool below, mtime_t date)
+{
+    return ( below && picture->date <= date) ||
+           (!below && picture->date >= date);
+}
+
+/* Moves the decoded pictures of the queue back to the input of the filter
+ * thread, to filter them again. Must be called while suspended. */
+static void ThreadPipelineRequeue(vout_thread_t *vout)
+{
+    vout_thread_sys_t *sys = vout->p;
+    picture_t *list = NULL, **last = &list;
+
+    vlc_mutex_lock(&sys->pipeline.lock);
+    for (; sys->pipeline.count > 0; sys->pipeline.count--) {
+        vout_prepared_t *entry = &sys->pipeline.queue[sys->pipeline.first];
+
+        sys->pipeline.first = (sys->pipeline.first + 1) % sys->pipeline.depth;
+        picture_Release(entry->picture);
+        if (entry->decoded) {
+            *last = entry->decoded;
+            last = &entry->decoded->p_next;
+        }
+    }
+    *last = sys->pipeline.requeue;
+    sys->pipeline.requeue = list;
+    sys->pipeline.has_input = true;
+    vlc_mutex_unlock(&sys->pipeline.lock);
+}
+
+/* Drops the prepared pictures as picture_fifo_Flush() does. Must be called
+ * while suspended. */
+static void ThreadPipelineFlush(vout_thread_t *vout, bool below, mtime_t date)
+{
+    vout_thread_sys_t *sys = vout->p;
+
+    vlc_mutex_lock(&sys->pipeline.lock);
+    unsigned count = 0;
+    for (unsigned i = 0; i < sys->pipeline.count; i++) {
+        unsigned first = sys->pipeline.first;
+        vout_prepared_t entry =
+            sys->pipeline.queue[(first + i) % sys->pipeline.depth];
+
+        if (PictureIsFlushed(entry.picture, below, date)) {
+            picture_Release(entry.picture);
+            if (entry.decoded)
+                picture_Release(entry.decoded);
+        } else
+            sys->pipeline.queue[(first + count++) % sys->pipeline.depth] = entry;
+    }
+    sys->pipeline.count = count;
+
+    for (picture_t **pp = &sys->pipeline.requeue; *pp != NULL;) {
+        picture_t *picture = *pp;
+
+        if (PictureIsFlushed(picture, below, date)) {
+            *pp = picture->p_next;
+            picture->p_next = NULL;
+            picture_Release(picture);
+        } else
+            pp = &picture->p_next;
+    }
+
+    if (sys->pipeline.pending &&
+        PictureIsFlushed(sys->pipeline.pending, below, date)) {
+        picture_Release(sys->pipeline.pending);
+        sys->pipeline.pending = NULL;
+    }
+    sys->pipeline.has_input = true;
+    vlc_mutex_unlock(&sys->pipeline.lock);
+}
+
+/* Must be called while suspended */
+static void ThreadPipelineOffsetDate(vout_thread_t *vout, mtime_t duration)
+{
+    vout_thread_sys_t *sys = vout->p;
+
+    vlc_mutex_lock(&sys->pipeline.lock);
+    for (unsigned i = 0; i < sys->pipeline.count; i++) {
+        vout_prepared_t *entry = &sys->pipeline.queue[(sys->pipeline.first + i)
+                                                      % sys->pipeline.depth];
+
+        entry->picture->date += duration;
+        /* The chain may be empty */
+        if (entry->decoded && entry->decoded != entry->picture)
+            entry->decoded->date += duration;
+    }
+    for (picture_t *picture = sys->pipeline.requeue; picture != NULL;
+         picture = picture->p_next)
+        picture->date += duration;
+    if (sys->pipeline.pending)
+        sys->pipeline.pending->date += duration;
+    vlc_mutex_unlock(&sys->pipeline.lock);
+}
+
+static void ThreadPipelineReportFilter(filter_t *filter, mtime_t time,
+                                       unsigned count, void *opaque)
+{
+    vout_thread_t *vout = opaque;
+
+    if (count > 0)
+        msg_Dbg(vout, "static filter %s: %.2f ms per picture (%u pictures)",
+                module_get_object(filter->p_module),
+                time / (1000. * count), count);
+}
+
+static picture_t *ThreadPipelinePopInput(vout_thread_t *vout)
+{
+    vout_thread_sys_t *sys = vout->p;
+
+    vlc_mutex_lock(&sys->pipeline.lock);
+    picture_t *picture = sys->pipeline.requeue;
+    if (picture) {
+        sys->pipeline.requeue = picture->p_next;
+        picture->p_next = NULL;
+    }
+    vlc_mutex_unlock(&sys->pipeline.lock);
+
+    return picture ? picture : picture_fifo_Pop(sys->decoder_fifo);
+}
+
+static void *ThreadPipeline(void *object)
+{
+    vout_thread_t *vout = object;
+    vout_thread_sys_t *sys = vout->p;
+
+    vlc_mutex_lock(&sys->pipeline.lock);
+    for (;;) {
+        while (!sys->pipeline.exit &&
+               (sys->pipeline.suspend > 0 || sys->pipeline.pending ||
+                sys->pipeline.count >= sys->pipeline.depth ||
+                !sys->pipeline.has_input))
+            vlc_cond_wait(&sys->pipeline.wait, &sys->pipeline.lock);
+        if (sys->pipeline.exit)
+            break;
+
+        sys->pipeline.has_input = false;
+        sys->pipeline.busy = true;
+        vlc_mutex_unlock(&sys->pipeline.lock);
+
+        /* The filter chain is owned by this thread while busy */
+        picture_t *decoded = NULL;
+        picture_t *picture = filter_chain_VideoFilter(sys->filter.chain_static, NULL);
+        if (!picture) {
+            decoded = ThreadPipelinePopInput(vout);
+            if (decoded &&
+                VideoFormatIsCropArEqual(&decoded->format, &sys->filter.format))
+                picture = filter_chain_VideoFilter(sys->filter.chain_static,
+                                                   picture_Hold(decoded));
+        }
+
+        const mtime_t now = mdate();
+        const bool report = now >= sys->pipeline.report;
+        if (report) {
+            sys->pipeline.report = now + VOUT_FILTER_REPORT_DELAY;
+            filter_chain_GetResetTimes(sys->filter.chain_static,
+                                       ThreadPipelineReportFilter, vout);
+        }
+
+        vlc_mutex_lock(&sys->pipeline.lock);
+        if (picture) {
+            vout_prepared_t *entry =
+                &sys->pipeline.queue[(sys->pipeline.first + sys->pipeline.count)
+                                     % sys->pipeline.depth];
+            entry->picture = picture;
+            entry->decoded = decoded;
+            sys->pipeline.count++;
+        } else if (decoded) {
+            if (!VideoFormatIsCropArEqual(&decoded->format, &sys->filter.format))
+                /* Wait for the video output thread to change the filters */
+                sys->pipeline.pending = decoded;
+            else
+                picture_Release(decoded);
+        }
+        /* Keep going until the input is exhausted */
+        if (picture || decoded)
+            sys->pipeline.has_input = true;
+        sys->pipeline.busy = false;
+        vlc_cond_broadcast(&sys->pipeline.idle);
+
+        if (report && sys->pipeline.depth_samples > 0) {
+            msg_Dbg(vout, "static filter queue: %.1f of %u pictures on average",
+                    (double)sys->pipeline.depth_sum / sys->pipeline.depth_samples,
+                    sys->pipeline.depth);
+            sys->pipeline.depth_sum = 0;
+            sys->pipeline.depth_samples = 0;
+        }
+
+        if (picture || decoded) {
+            vlc_mutex_unlock(&sys->pipeline.lock);
+            vout_control_Wake(&sys->control);
+            vlc_mutex_lock(&sys->pipeline.lock);
+        }
+    }
+    vlc_mutex_unlock(&sys->pipeline.lock);
+    return NULL;
+}
+
+static void ThreadPipelineStart(vout_thread_t *vout)
+{
+    vout_thread_sys_t *sys = vout->p;
+
+    if (sys->pipeline.depth == 0)
+        return;
+
+    sys->pipeline.queue = vlc_alloc(sys->pipeline.depth,
+                                    sizeof(*sys->pipeline.queue));
+    if (unlikely(sys->pipeline.queue == NULL))
+        return;
+
+    sys->pipeline.first         = 0;
+    sys->pipeline.count         = 0;
+    sys->pipeline.requeue       = NULL;
+    sys->pipeline.pending       = NULL;
+    sys->pipeline.suspend       = 0;
+    sys->pipeline.busy          = false;
+    sys->pipeline.has_input     = true;
+    sys->pipeline.exit          = false;
+    sys->pipeline.report        = mdate() + VOUT_FILTER_REPORT_DELAY;
+    sys->pipeline.depth_sum     = 0;
+    sys->pipeline.depth_samples = 0;
+
+    sys->pipeline.active = true;
+    if (vlc_clone(&sys->pipeline.thread, ThreadPipeline, vout,
+                  VLC_THREAD_PRIORITY_VIDEO)) {
+        msg_Warn(vout, "cannot start the static filter thread");
+        sys->pipeline.active = false;
+        free(sys->pipeline.queue);
+        return;
+    }
+    msg_Dbg(vout, "static filters running up to %u pictures ahead",
+            sys->pipeline.depth);
+}
+
+static void ThreadPipelineStop(vout_thread_t *vout)
+{
+    vout_thread_sys_t *sys = vout->p;
+
+    if (!sys->pipeline.active)
+        return;
+
+    vlc_mutex_lock(&sys->pipeline.lock);
+    sys->pipeline.exit = true;
+    vlc_cond_signal(&sys->pipeline.wait);
+    vlc_mutex_unlock(&sys->pipeline.lock);
+
+    vlc_join(sys->pipeline.thread, NULL);
+    sys->pipeline.active = false;
+
+    for (; sys->pipeline.count > 0; sys->pipeline.count--) {
+        vout_prepared_t *entry = &sys->pipeline.queue[sys->pipeline.first];
+
+        sys->pipeline.first = (sys->pipeline.first + 1) % sys->pipeline.depth;
+        picture_Release(entry->picture);
+        if (entry->decoded)
+            picture_Release(entry->decoded);
+    }
+    while (sys->pipeline.requeue) {
+        picture_t *picture = sys->pipeline.requeue;
+
+        sys->pipeline.requeue = picture->p_next;
+        picture->p_next = NULL;
+        picture_Release(picture);
+    }
+    if (sys->pipeline.pending)
+        picture_Release(sys->pipeline.pending);
+    sys->pipeline.pending = NULL;
+    free(sys->pipeline.queue);
+}
+
 static void ThreadFilterFlush(vout_thread_t *vout, bool is_locked)
 {
     if (vout->p->displayed.current)
@@ -713,7 +1048,9 @@ static void ThreadFilterFlush(vout_thread_t *vout, bool is_locked)
 
     if (!is_locked)
         vlc_mutex_lock(&vout->p->filter.lock);
+    vout_SuspendFilterThread(vout);
     filter_chain_VideoFlush(vout->p->filter.chain_static);
+    vout_ResumeFilterThread(vout);
     filter_chain_VideoFlush(vout->p->filter.chain_interactive);
     if (!is_locked)
         vlc_mutex_unlock(&vout->p->filter.lock);
@@ -730,7 +1067,10 @@ static void ThreadChangeFilters(vout_thread_t *vout,
                                 int deinterlace,
                                 bool is_locked)
 {
+    vout_SuspendFilterThread(vout);
     ThreadFilterFlush(vout, is_locked);
+    if (vout->p->pipeline.active)
+        ThreadPipelineRequeue(vout);
     ThreadDelAllFilterCallbacks(vout);
 
     vlc_array_t array_static;
@@ -841,12 +1181,126 @@ static void ThreadChangeFilters(vout_thread_t *vout,
 
     if (!is_locked)
         vlc_mutex_unlock(&vout->p->filter.lock);
+    vout_ResumeFilterThread(vout);
 }
 
+/* Tells whether a picture is too late to be displayed, next_date being the
+ * date of the following one if known */
+static bool ThreadIsLate(vout_thread_t *vout, const picture_t *picture,
+                         mtime_t next_date)
+{
+    mtime_t late_threshold;
+    if (picture->format.i_frame_rate && picture->format.i_frame_rate_base)
+        late_threshold = ((CLOCK_FREQ/2) * picture->format.i_frame_rate_base) / picture->format.i_frame_rate;
+    else
+        late_threshold = VOUT_DISPLAY_LATE_THRESHOLD;
+    mtime_t predicted = mdate() + 0; /* TODO improve */
+    if (vout->p->is_low_latency) {
+        predicted += vout_chrono_GetHigh(&vout->p->render);
+
+        /* Catch up rather than displaying a backlog */
+        if (next_date > VLC_TS_INVALID && next_date <= predicted)
+            return true;
+    }
+    const mtime_t late = predicted - picture->date;
+    if (late > late_threshold) {
+        msg_Warn(vout, "picture is too late to be displayed (missing %"PRId64" ms)", late/1000);
+        return true;
+    } else if (late > 0) {
+        msg_Dbg(vout, "picture might be displayed late (missing %"PRId64" ms)", late/1000);
+    }
+    return false;
+}
+
+static int ThreadDisplayPreparePipelined(vout_thread_t *vout, bool reuse, bool frame_by_frame)
+{
+    vout_thread_sys_t *sys = vout->p;
+    bool is_late_dropped = sys->is_late_dropped && !sys->pause.is_on && !frame_by_frame;
+    picture_t *picture = NULL;
+
+    if (reuse && sys->displayed.decoded) {
+        /* Filter the last decoded picture again, then the queued ones so
+         * that the extra outputs of the filters stay in order */
+        vout_SuspendFilterThread(vout);
+        ThreadPipelineRequeue(vout);
+        vlc_mutex_lock(&sys->filter.lock);
+        filter_chain_VideoFlush(sys->filter.chain_static);
+        picture = filter_chain_VideoFilter(sys->filter.chain_static,
+                                           picture_Hold(sys->displayed.decoded));
+        vlc_mutex_unlock(&sys->filter.lock);
+        vout_ResumeFilterThread(vout);
+    }
+
+    while (!picture) {
+        mtime_t next_date = VLC_TS_INVALID;
+
+        vlc_mutex_lock(&sys->pipeline.lock);
+        while (frame_by_frame && sys->pipeline.count == 0 && sys->pipeline.busy)
+            vlc_cond_wait(&sys->pipeline.idle, &sys->pipeline.lock);
+
+        if (sys->pipeline.count == 0) {
+            picture_t *pending = sys->pipeline.pending;
+            vlc_mutex_unlock(&sys->pipeline.lock);
+            if (!pending)
+                return VLC_EGENERIC;
+
+            /* The filter thread waits for the filters of the new format */
+            ThreadChangeFilters(vout, &pending->format, sys->filter.configuration, -1, false);
+
+            vlc_mutex_lock(&sys->pipeline.lock);
+            pending->p_next = sys->pipeline.requeue;
+            sys->pipeline.requeue = pending;
+            sys->pipeline.pending = NULL;
+            sys->pipeline.has_input = true;
+            vlc_cond_signal(&sys->pipeline.wait);
+            vlc_mutex_unlock(&sys->pipeline.lock);
+            return VLC_EGENERIC;
+        }
+
+        vout_prepared_t entry = sys->pipeline.queue[sys->pipeline.first];
+        sys->pipeline.depth_sum += sys->pipeline.count;
+        sys->pipeline.depth_samples++;
+        sys->pipeline.first = (sys->pipeline.first + 1) % sys->pipeline.depth;
+        sys->pipeline.count--;
+        if (sys->pipeline.count > 0)
+            next_date = sys->pipeline.queue[sys->pipeline.first].picture->date;
+        vlc_cond_signal(&sys->pipeline.wait);
+        vlc_mutex_unlock(&sys->pipeline.lock);
+
+        if (is_late_dropped && !entry.picture->b_force &&
+            ThreadIsLate(vout, entry.picture, next_date)) {
+            picture_Release(entry.picture);
+            if (entry.decoded)
+                picture_Release(entry.decoded);
+            vout_statistic_AddLost(&sys->statistic, 1);
+            continue;
+        }
+
+        if (entry.decoded) {
+            if (sys->displayed.decoded)
+                picture_Release(sys->displayed.decoded);
+
+            sys->displayed.decoded       = entry.decoded;
+            sys->displayed.timestamp     = entry.decoded->date;
+            sys->displayed.is_interlaced = !entry.decoded->b_progressive;
+        }
+        picture = entry.picture;
+    }
+
+    assert(!sys->displayed.next);
+    if (!sys->displayed.current)
+        sys->displayed.current = picture;
+    else
+        sys->displayed.next    = picture;
+    return VLC_SUCCESS;
+}
 
 /* */
 static int ThreadDisplayPreparePicture(vout_thread_t *vout, bool reuse, bool frame_by_frame)
 {
+    if (vout->p->pipeline.active)
+        return ThreadDisplayPreparePipelined(vout, reuse, frame_by_frame);
+
     bool is_late_dropped = vout->p->is_late_dropped && !vout->p->pause.is_on && !frame_by_frame;
 
     vlc_mutex_lock(&vout->p->filter.lock);
@@ -862,20 +1316,18 @@ static int ThreadDisplayPreparePicture(vout_thread_t *vout, bool reuse, bool fra
             decoded = picture_fifo_Pop(vout->p->decoder_fifo);
             if (decoded) {
                 if (is_late_dropped && !decoded->b_force) {
-                    mtime_t late_threshold;
-                    if (decoded->format.i_frame_rate && decoded->format.i_frame_rate_base)
-                        late_threshold = ((CLOCK_FREQ/2) * decoded->format.i_frame_rate_base) / decoded->format.i_frame_rate;
-                    else
-                        late_threshold = VOUT_DISPLAY_LATE_THRESHOLD;
-                    const mtime_t predicted = mdate() + 0; /* TODO improve */
-                    const mtime_t late = predicted - decoded->date;
-                    if (late > late_threshold) {
-                        msg_Warn(vout, "picture is too late to be displayed (missing %"PRId64" ms)", late/1000);
+                    mtime_t next_date = VLC_TS_INVALID;
+                    if (vout->p->is_low_latency) {
+                        picture_t *next = picture_fifo_Peek(vout->p->decoder_fifo);
+                        if (next) {
+                            next_date = next->date;
+                            picture_Release(next);
+                        }
+                    }
+                    if (ThreadIsLate(vout, decoded, next_date)) {
                         picture_Release(decoded);
                         vout_statistic_AddLost(&vout->p->statistic, 1);
                         continue;
-                    } else if (late > 0) {
-                        msg_Dbg(vout, "picture might be displayed late (missing %"PRId64" ms)", late/1000);
                     }
                 }
                 if (!VideoFormatIsCropArEqual(&decoded->format, &vout->p->filter.format))
@@ -1298,12 +1750,16 @@ static void ThreadChangePause(vout_thread_t *vout, bool is_paused, mtime_t date)
             vout->p->step.timestamp += duration;
         if (vout->p->step.last > VLC_TS_INVALID)
             vout->p->step.last += duration;
+        vout_SuspendFilterThread(vout);
         picture_fifo_OffsetDate(vout->p->decoder_fifo, duration);
+        if (vout->p->pipeline.active)
+            ThreadPipelineOffsetDate(vout, duration);
         if (vout->p->displayed.decoded)
             vout->p->displayed.decoded->date += duration;
         spu_OffsetSubtitleDate(vout->p->spu, duration);
 
         ThreadFilterFlush(vout, false);
+        vout_ResumeFilterThread(vout);
     } else {
         vout->p->step.timestamp = VLC_TS_INVALID;
         vout->p->step.last      = VLC_TS_INVALID;
@@ -1321,7 +1777,10 @@ static void ThreadFlush(vout_thread_t *vout, bool below, mtime_t date)
     vout->p->step.timestamp = VLC_TS_INVALID;
     vout->p->step.last      = VLC_TS_INVALID;
 
+    vout_SuspendFilterThread(vout);
     ThreadFilterFlush(vout, false); /* FIXME too much */
+    if (vout->p->pipeline.active)
+        ThreadPipelineFlush(vout, below, date);
 
     picture_t *last = vout->p->displayed.decoded;
     if (last) {
@@ -1336,6 +1795,7 @@ static void ThreadFlush(vout_thread_t *vout, bool below, mtime_t date)
     }
 
     picture_fifo_Flush(vout->p->decoder_fifo, date, below);
+    vout_ResumeFilterThread(vout);
     vout_FilterFlush(vout->p->display.vd);
 }
 
@@ -1551,6 +2011,8 @@ static int ThreadStart(vout_thread_t *vout, vout_display_state_t *state)
     vout->p->spu_blend               = NULL;
 
     video_format_Print(VLC_OBJECT(vout), "original format", &vout->p->original);
+
+    ThreadPipelineStart(vout);
     return VLC_SUCCESS;
 error:
     if (vout->p->filter.chain_interactive != NULL)
@@ -1568,6 +2030,8 @@ error:
 
 static void ThreadStop(vout_thread_t *vout, vout_display_state_t *state)
 {
+    ThreadPipelineStop(vout);
+
     if (vout->p->spu_blend)
         filter_DeleteBlend(vout->p->spu_blend);
 
@@ -1596,6 +2060,8 @@ static void ThreadInit(vout_thread_t *vout)
 {
     vout->p->dead            = false;
     vout->p->is_late_dropped = var_InheritBool(vout, "drop-late-frames");
+    vout->p->is_low_latency  = false;
+    vout->p->pipeline.depth  = var_InheritInteger(vout, "vout-filter-queue");
     vout->p->pause.is_on     = false;
     vout->p->pause.date      = VLC_TS_INVALID;
 
@@ -1738,6 +2204,9 @@ static int ThreadControl(vout_thread_t *vout, vout_control_cmd_t cmd)
     case VOUT_CONTROL_STEP:
         ThreadStep(vout, cmd.u.time_ptr);
         break;
+    case VOUT_CONTROL_LOW_LATENCY:
+        vout->p->is_low_latency = cmd.u.boolean;
+        break;
     case VOUT_CONTROL_FULLSCREEN:
         ThreadChangeFullscreen(vout, cmd.u.boolean);
         break;
@@ -33,6 +33,12 @@ typedef struct vout_window_mouse_event_t vout_window_mouse_event_t;
  */
 void vout_ChangePause( vout_thread_t *, bool b_paused, mtime_t i_date );
 
+/**
+ * This function will make the display catch up with live sources rather
+ * than display their late pictures.
+ */
+void vout_ChangeLowLatency( vout_thread_t *, bool b_low_latency );
+
 /**
  * This function will apply an offset on subtitle subpicture.
  */
@@ -43,6 +43,13 @@
  */
 #define VOUT_MAX_PICTURES (20)
 
+/* Picture filtered ahead of display by the static filter thread */
+typedef struct {
+    picture_t *picture;
+    picture_t *decoded; /**< Source of the picture, or NULL if the picture is
+                             not the first one filtered out of it */
+} vout_prepared_t;
+
 /* */
 struct vout_thread_sys_t
 {
@@ -116,6 +123,7 @@ struct vout_thread_sys_t
 
     /* */
     bool            is_late_dropped;
+    bool            is_low_latency;
 
     /* Video filter2 chain */
     struct {
@@ -127,6 +135,31 @@ struct vout_thread_sys_t
         bool            has_deint;
     } filter;
 
+    /* Static filter chain thread */
+    struct {
+        unsigned        depth;      /**< Prepared pictures, 0 if disabled */
+        bool            active;
+        vlc_thread_t    thread;
+        vlc_mutex_t     lock;
+        vlc_cond_t      wait;       /**< Signaled to the filter thread */
+        vlc_cond_t      idle;       /**< Signaled by the filter thread */
+        vout_prepared_t *queue;
+        unsigned        first;
+        unsigned        count;
+        picture_t       *requeue;   /**< Decoded pictures to filter again */
+        picture_t       *pending;   /**< Decoded picture in a new format */
+        unsigned        suspend;
+        bool            busy;
+        bool            has_input;
+        bool            exit;
+
+        /* Statistics, reported by the filter thread */
+        mtime_t         report;
+        uint64_t        depth_sum;
+        unsigned        depth_samples;
+        unsigned        underruns;
+    } pipeline;
+
     /* */
     vlc_mouse_t     mouse;
 
@@ -164,6 +197,10 @@ int  vout_InitWrapper(vout_thread_t *);
 void vout_EndWrapper(vout_thread_t *);
 void vout_ManageWrapper(vout_thread_t *);
 
+/* */
+void vout_SuspendFilterThread(vout_thread_t *);
+void vout_ResumeFilterThread(vout_thread_t *);
+
 /* */
 int spu_ProcessMouse(spu_t *, const vlc_mouse_t *, const video_format_t *);
 void spu_Attach( spu_t *, vlc_object_t *input, bool );
@@ -651,6 +651,76 @@ static void SpuSelectSubpictures(spu_t *spu,
 
 
 
+/**
+ * Computes the bounding box of the non transparent pixels of a cached region
+ * picture, so that the fully transparent borders (most of a subtitle line
+ * rendered over the whole video width) are not blended again every frame.
+ */
+static void SpuRegionOpaqueArea(subpicture_region_private_t *private)
+{
+    const video_format_t *fmt = &private->fmt;
+    const picture_t *picture = private->p_picture;
+    unsigned plane, pixel_size, alpha_offset;
+
+    private->opaque.b_valid  = true;
+    private->opaque.i_x      = 0;
+    private->opaque.i_y      = 0;
+    private->opaque.i_width  = fmt->i_visible_width;
+    private->opaque.i_height = fmt->i_visible_height;
+
+    switch (fmt->i_chroma) {
+    case VLC_CODEC_YUVA:
+        plane = A_PLANE; pixel_size = 1; alpha_offset = 0;
+        break;
+    case VLC_CODEC_RGBA:
+    case VLC_CODEC_BGRA:
+        plane = 0; pixel_size = 4; alpha_offset = 3;
+        break;
+    case VLC_CODEC_ARGB:
+        plane = 0; pixel_size = 4; alpha_offset = 0;
+        break;
+    default:
+        return;
+    }
+    if (plane >= (unsigned)picture->i_planes)
+        return;
+
+    const plane_t *p = &picture->p[plane];
+    unsigned x_min = fmt->i_visible_width, x_max = 0;
+    unsigned y_min = fmt->i_visible_height, y_max = 0;
+
+    for (unsigned y = 0; y < fmt->i_visible_height; y++) {
+        const uint8_t *line = &p->p_pixels[(fmt->i_y_offset + y) * p->i_pitch +
+                                           fmt->i_x_offset * pixel_size +
+                                           alpha_offset];
+        unsigned x_first = 0;
+        while (x_first < fmt->i_visible_width && !line[x_first * pixel_size])
+            x_first++;
+        if (x_first >= fmt->i_visible_width)
+            continue;
+
+        unsigned x_last = fmt->i_visible_width - 1;
+        while (!line[x_last * pixel_size])
+            x_last--;
+
+        x_min = __MIN(x_min, x_first);
+        x_max = __MAX(x_max, x_last);
+        if (y_min > y)
+            y_min = y;
+        y_max = y;
+    }
+
+    if (x_min > x_max || y_min > y_max) {
+        private->opaque.i_width  = 0;
+        private->opaque.i_height = 0;
+        return;
+    }
+    private->opaque.i_x      = x_min;
+    private->opaque.i_y      = y_min;
+    private->opaque.i_width  = x_max - x_min + 1;
+    private->opaque.i_height = y_max - y_min + 1;
+}
+
 /**
  * It will transform the provided region into another region suitable for rendering.
  */
@@ -961,6 +1031,36 @@ static void SpuRenderRegion(spu_t *spu,
         }
     }
 
+    /* Only blend the part of a cached picture that is not transparent */
+    if (region->p_private && region_picture == region->p_private->p_picture &&
+        region_fmt.i_visible_width > 0 && region_fmt.i_visible_height > 0) {
+        subpicture_region_private_t *private = region->p_private;
+        if (!private->opaque.b_valid)
+            SpuRegionOpaqueArea(private);
+
+        /* Opaque area and visible window, in picture coordinates */
+        const int opaque_x = private->fmt.i_x_offset + private->opaque.i_x;
+        const int opaque_y = private->fmt.i_y_offset + private->opaque.i_y;
+        const int x = __MAX((int)region_fmt.i_x_offset, opaque_x);
+        const int y = __MAX((int)region_fmt.i_y_offset, opaque_y);
+        const int x_end = __MIN((int)(region_fmt.i_x_offset + region_fmt.i_visible_width),
+                                opaque_x + (int)private->opaque.i_width);
+        const int y_end = __MIN((int)(region_fmt.i_y_offset + region_fmt.i_visible_height),
+                                opaque_y + (int)private->opaque.i_height);
+
+        if (x >= x_end || y >= y_end) {
+            region_fmt.i_visible_width  =
+            region_fmt.i_visible_height = 0;
+        } else {
+            x_offset += x - (int)region_fmt.i_x_offset;
+            y_offset += y - (int)region_fmt.i_y_offset;
+            region_fmt.i_x_offset       = x;
+            region_fmt.i_y_offset       = y;
+            region_fmt.i_visible_width  = x_end - x;
+            region_fmt.i_visible_height = y_end - y;
+        }
+    }
+
     subpicture_region_t *dst = *dst_ptr = subpicture_region_New(&region_fmt);
     if (dst) {
         dst->i_x       = x_offset;
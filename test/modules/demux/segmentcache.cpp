@@ -0,0 +1,222 @@
+/*****************************************************************************
+ * segmentcache.cpp: test for the adaptive segment cache
+ *****************************************************************************
+ * Copyright (C) 2020 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc_common.h>
+#include <vlc_block.h>
+#include "../../../lib/libvlc_internal.h"
+#include "../../libvlc/test.h"
+
+#include "../modules/demux/adaptive/http/BytesRange.cpp"
+#include "../modules/demux/adaptive/http/SegmentCache.cpp"
+
+#include <cstring>
+
+const char vlc_module_name[] = "segmentcache";
+
+#define KIB 1024
+
+static block_t *Segment(size_t size, uint8_t fill)
+{
+    block_t *p_block = block_Alloc(size);
+    assert(p_block != NULL);
+    memset(p_block->p_buffer, fill, size);
+    return p_block;
+}
+
+/* Checks the content of a cached segment and releases it */
+static bool Check(block_t *p_chain, size_t size, uint8_t fill)
+{
+    if(!p_chain)
+        return false;
+    size_t total = 0;
+    for(const block_t *p = p_chain; p; p = p->p_next)
+    {
+        for(size_t i = 0; i < p->i_buffer; i++)
+            assert(p->p_buffer[i] == fill);
+        total += p->i_buffer;
+    }
+    block_ChainRelease(p_chain);
+    return total == size;
+}
+
+static SegmentCache *Acquire(vlc_object_t *obj, int64_t size, int64_t ttl)
+{
+    var_SetInteger(obj, "adaptive-cache-size", size);
+    var_SetInteger(obj, "adaptive-cache-ttl", ttl);
+    return SegmentCache::acquire(obj);
+}
+
+static void test_keys(void)
+{
+    const std::string url("http://example.com/seg1.m4s");
+    const std::string whole = SegmentCache::makeKey(url, BytesRange());
+    const std::string a = SegmentCache::makeKey(url, BytesRange(0, 999));
+    const std::string b = SegmentCache::makeKey(url, BytesRange(1000, 1999));
+
+    assert(whole == url);
+    assert(a != whole && b != whole && a != b);
+    assert(a == SegmentCache::makeKey(url, BytesRange(0, 999)));
+}
+
+static void test_limits(vlc_object_t *obj)
+{
+    /* Disabled */
+    assert(Acquire(obj, 0, 0) == NULL);
+
+    SegmentCache *cache = Acquire(obj, 1, 0);
+    assert(cache != NULL);
+
+    /* The same instance is shared */
+    SegmentCache *other = SegmentCache::acquire(obj);
+    assert(other == cache);
+    other->release();
+
+    /* A segment can use a quarter of the cache at most */
+    assert(!cache->accepts(0));
+    assert(cache->accepts(1));
+    assert(cache->accepts(256 * KIB));
+    assert(!cache->accepts(256 * KIB + 1));
+
+    cache->put("big", Segment(256 * KIB + 1, 1), "video/mp4");
+    SegmentCache::Stats stats = cache->getStats();
+    assert(stats.stored == 0 && stats.entries == 0 && stats.size == 0);
+
+    std::string type;
+    assert(cache->get("big", &type) == NULL);
+
+    /* Chains are cached as a whole, and the first copy is kept */
+    block_t *p_chain = Segment(100 * KIB, 2);
+    p_chain->p_next = Segment(50 * KIB, 2);
+    cache->put("chain", p_chain, "video/mp2t");
+    cache->put("chain", Segment(10 * KIB, 3), "text/plain");
+
+    stats = cache->getStats();
+    assert(stats.stored == 1 && stats.entries == 1);
+    assert(stats.size == 150 * KIB);
+
+    assert(Check(cache->get("chain", &type), 150 * KIB, 2));
+    assert(type == "video/mp2t");
+    assert(Check(cache->get("chain", &type), 150 * KIB, 2));
+
+    stats = cache->getStats();
+    assert(stats.hits == 2 && stats.misses == 1);
+    assert(stats.bytesSaved == 300 * KIB);
+
+    cache->release();
+}
+
+static void test_lru(vlc_object_t *obj)
+{
+    SegmentCache *cache = Acquire(obj, 1, 0);
+    assert(cache != NULL);
+
+    /* Fill the cache exactly */
+    static const char *const keys[] = { "a", "b", "c", "d" };
+    for(unsigned i = 0; i < 4; i++)
+        cache->put(keys[i], Segment(256 * KIB, i), "");
+
+    SegmentCache::Stats stats = cache->getStats();
+    assert(stats.entries == 4 && stats.size == 1024 * KIB);
+    assert(stats.evicted == 0);
+
+    /* "a" becomes the most recently used, so "b" is evicted */
+    std::string type;
+    assert(Check(cache->get("a", &type), 256 * KIB, 0));
+    cache->put("e", Segment(256 * KIB, 4), "");
+
+    stats = cache->getStats();
+    assert(stats.entries == 4 && stats.evicted == 1);
+    assert(cache->get("b", &type) == NULL);
+    assert(Check(cache->get("c", &type), 256 * KIB, 2));
+    assert(Check(cache->get("d", &type), 256 * KIB, 3));
+    assert(Check(cache->get("e", &type), 256 * KIB, 4));
+    assert(Check(cache->get("a", &type), 256 * KIB, 0));
+
+    /* Entries are evicted from the least recently used one: "c", then "d" */
+    cache->put("b", Segment(200 * KIB, 1), "");
+    cache->put("f", Segment(256 * KIB, 5), "");
+    stats = cache->getStats();
+    assert(stats.entries == 4 && stats.size == 968 * KIB);
+    assert(stats.evicted == 3);
+    assert(cache->get("c", &type) == NULL);
+    assert(cache->get("d", &type) == NULL);
+    assert(Check(cache->get("e", &type), 256 * KIB, 4));
+    assert(Check(cache->get("a", &type), 256 * KIB, 0));
+    assert(Check(cache->get("f", &type), 256 * KIB, 5));
+    assert(Check(cache->get("b", &type), 200 * KIB, 1));
+
+    cache->release();
+}
+
+static void test_ttl(vlc_object_t *obj)
+{
+    SegmentCache *cache = Acquire(obj, 1, 2);
+    assert(cache != NULL);
+
+    std::string type;
+    cache->put("old", Segment(KIB, 1), "");
+    mtime_t start = mdate();
+    assert(Check(cache->get("old", &type), KIB, 1));
+
+    mwait(start + CLOCK_FREQ);
+    cache->put("new", Segment(KIB, 2), "");
+    mtime_t stored = mdate();
+    mwait(start + CLOCK_FREQ * 22 / 10);
+
+    /* Expired entries are purged, whatever their use */
+    assert(cache->get("old", &type) == NULL);
+    assert(Check(cache->get("new", &type), KIB, 2));
+
+    SegmentCache::Stats stats = cache->getStats();
+    assert(stats.entries == 1 && stats.size == KIB);
+    assert(stats.evicted == 1);
+
+    mwait(stored + CLOCK_FREQ * 22 / 10);
+    assert(cache->get("new", &type) == NULL);
+    stats = cache->getStats();
+    assert(stats.entries == 0 && stats.size == 0);
+
+    cache->release();
+}
+
+int main(void)
+{
+    test_init();
+
+    const char *argv[] = { "-v" };
+    libvlc_instance_t *vlc = libvlc_new(ARRAY_SIZE(argv), argv);
+    assert(vlc != NULL);
+    vlc_object_t *obj = VLC_OBJECT(vlc->p_libvlc_int);
+
+    var_Create(obj, "adaptive-cache-size", VLC_VAR_INTEGER);
+    var_Create(obj, "adaptive-cache-ttl", VLC_VAR_INTEGER);
+
+    test_keys();
+    test_limits(obj);
+    test_lru(obj);
+    test_ttl(obj);
+
+    libvlc_release(vlc);
+    return 0;
+}
@@ -0,0 +1,252 @@
+/*****************************************************************************
+ * mp4recover.c: test for the recovery of interrupted MP4 recordings
+ *****************************************************************************
+ * Copyright (C) 2020 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <sys/stat.h>
+
+#include <vlc_common.h>
+#include <vlc_block.h>
+#include <vlc_sout.h>
+#include "../../../lib/libvlc_internal.h"
+#include "../../libvlc/test.h"
+
+#define main mp4recover_main
+#include "../bin/mp4recover.c"
+#undef main
+
+#define SECONDS       5
+#define VIDEO_PERIOD  (CLOCK_FREQ / 25)
+#define AUDIO_PERIOD  (1024 * CLOCK_FREQ / 48000)
+
+static char dir[] = "/tmp/vlc-mp4recover-XXXXXX";
+
+static block_t *Sample(size_t i_size, mtime_t i_dts, mtime_t i_length,
+                       bool b_video, bool b_key)
+{
+    block_t *p_block = block_Alloc(i_size);
+    assert(p_block != NULL);
+
+    memset(p_block->p_buffer, 0xAA, i_size);
+    if (b_video)
+    {   /* Annex B slice */
+        SetDWBE(p_block->p_buffer, 1);
+        p_block->p_buffer[4] = b_key ? 0x65 : 0x41;
+        p_block->i_flags = b_key ? BLOCK_FLAG_TYPE_I : BLOCK_FLAG_TYPE_P;
+    }
+    p_block->i_dts = p_block->i_pts = i_dts;
+    p_block->i_length = i_length;
+    return p_block;
+}
+
+/* Copies the first bytes of a file */
+static void Copy(const char *psz_from, const char *psz_to, size_t i_size)
+{
+    FILE *from = fopen(psz_from, "rb"), *to = fopen(psz_to, "wb");
+    assert(from != NULL && to != NULL);
+
+    char buf[4096];
+    while (i_size > 0)
+    {
+        size_t i_read = fread(buf, 1, __MIN(i_size, sizeof(buf)), from);
+        assert(i_read > 0);
+        assert(fwrite(buf, 1, i_read, to) == i_read);
+        i_size -= i_read;
+    }
+    fclose(from);
+    fclose(to);
+}
+
+static size_t FileSize(const char *psz_path)
+{
+    struct stat st;
+    assert(stat(psz_path, &st) == 0);
+    return st.st_size;
+}
+
+/* Records with checkpoints, and keeps a truncated copy of the file as it was
+ * before the end of the recording */
+static void Record(vlc_object_t *obj, const char *psz_path,
+                   const char *psz_copy)
+{
+    sout_instance_t *p_sout = vlc_object_create(obj, sizeof(*p_sout));
+    assert(p_sout != NULL);
+    p_sout->psz_sout = NULL;
+    p_sout->i_out_pace_nocontrol = 0;
+    p_sout->p_stream = NULL;
+    var_Create(p_sout, "sout-mux-caching", VLC_VAR_INTEGER);
+
+    sout_access_out_t *p_access = sout_AccessOutNew(p_sout, "file",
+                                                    psz_path);
+    assert(p_access != NULL);
+    sout_mux_t *p_mux = sout_MuxNew(p_sout,
+                                    "mp4{duration=60,checkpoint=1}",
+                                    p_access);
+    assert(p_mux != NULL);
+
+    static const uint8_t sps_pps[] = {
+        0, 0, 0, 1, 0x67, 0x64, 0x00, 0x1f, 0xac, 0xd9, 0x40, 0x50, 0x05,
+        0xbb, 0x01, 0x10,
+        0, 0, 0, 1, 0x68, 0xeb, 0xe3, 0xcb, 0x22, 0xc0,
+    };
+    static const uint8_t asc[] = { 0x11, 0x90 };
+    es_format_t vfmt, afmt;
+
+    es_format_Init(&vfmt, VIDEO_ES, VLC_CODEC_H264);
+    vfmt.video.i_width = vfmt.video.i_visible_width = 640;
+    vfmt.video.i_height = vfmt.video.i_visible_height = 360;
+    vfmt.video.i_frame_rate = 25;
+    vfmt.video.i_frame_rate_base = 1;
+    vfmt.i_extra = sizeof(sps_pps);
+    vfmt.p_extra = malloc(sizeof(sps_pps));
+    assert(vfmt.p_extra != NULL);
+    memcpy(vfmt.p_extra, sps_pps, sizeof(sps_pps));
+
+    es_format_Init(&afmt, AUDIO_ES, VLC_CODEC_MP4A);
+    afmt.audio.i_rate = 48000;
+    afmt.audio.i_channels = 2;
+    afmt.i_extra = sizeof(asc);
+    afmt.p_extra = malloc(sizeof(asc));
+    assert(afmt.p_extra != NULL);
+    memcpy(afmt.p_extra, asc, sizeof(asc));
+
+    sout_input_t *p_video = sout_MuxAddStream(p_mux, &vfmt);
+    sout_input_t *p_audio = sout_MuxAddStream(p_mux, &afmt);
+    assert(p_video != NULL && p_audio != NULL);
+    es_format_Clean(&vfmt);
+    es_format_Clean(&afmt);
+
+    const mtime_t i_start = CLOCK_FREQ;
+    unsigned i_video = 0, i_audio = 0;
+    for (;;)
+    {
+        const mtime_t i_vdts = i_start + i_video * VIDEO_PERIOD;
+        const mtime_t i_adts = i_start + i_audio * AUDIO_PERIOD;
+
+        if (__MIN(i_vdts, i_adts) >= i_start + SECONDS * CLOCK_FREQ)
+            break;
+        if (i_vdts <= i_adts)
+        {
+            block_t *p_block = Sample(1000 + (i_video * 37) % 3000, i_vdts,
+                                      VIDEO_PERIOD, true,
+                                      (i_video % 25) == 0);
+            sout_MuxSendBuffer(p_mux, p_video, p_block);
+            i_video++;
+        }
+        else
+        {
+            sout_MuxSendBuffer(p_mux, p_audio,
+                               Sample(300, i_adts, AUDIO_PERIOD, false,
+                                      false));
+            i_audio++;
+        }
+    }
+
+    /* Interrupted recording: cut in the middle of the last samples */
+    Copy(psz_path, psz_copy, FileSize(psz_path) - 1000);
+
+    sout_MuxDeleteStream(p_mux, p_video);
+    sout_MuxDeleteStream(p_mux, p_audio);
+    sout_MuxDelete(p_mux);
+    sout_AccessOutDelete(p_access);
+    vlc_object_release(p_sout);
+}
+
+static int Recover(const char *psz_path)
+{
+    char *argv[] = { (char *)"vlc-mp4-recover", (char *)psz_path, NULL };
+    return mp4recover_main(2, argv);
+}
+
+static void OnParsed(const libvlc_event_t *event, void *data)
+{
+    (void) event;
+    vlc_sem_post(data);
+}
+
+/* Checks that the file can be played back */
+static void CheckPlayable(libvlc_instance_t *vlc, const char *psz_path,
+                          libvlc_time_t i_min, libvlc_time_t i_max)
+{
+    libvlc_media_t *media = libvlc_media_new_path(vlc, psz_path);
+    assert(media != NULL);
+
+    vlc_sem_t sem;
+    vlc_sem_init(&sem, 0);
+    libvlc_event_manager_t *em = libvlc_media_event_manager(media);
+    libvlc_event_attach(em, libvlc_MediaParsedChanged, OnParsed, &sem);
+    assert(libvlc_media_parse_with_options(media, libvlc_media_parse_local,
+                                           -1) == 0);
+    vlc_sem_wait(&sem);
+    libvlc_event_detach(em, libvlc_MediaParsedChanged, OnParsed, &sem);
+    vlc_sem_destroy(&sem);
+
+    assert(libvlc_media_get_parsed_status(media)
+           == libvlc_media_parsed_status_done);
+
+    libvlc_media_track_t **tracks;
+    unsigned i_tracks = libvlc_media_tracks_get(media, &tracks);
+    assert(i_tracks == 2);
+    libvlc_media_tracks_release(tracks, i_tracks);
+
+    const libvlc_time_t i_duration = libvlc_media_get_duration(media);
+    assert(i_duration >= i_min && i_duration <= i_max);
+
+    libvlc_media_release(media);
+}
+
+int main(void)
+{
+    test_init();
+
+    assert(mkdtemp(dir) != NULL);
+
+    char *psz_path, *psz_copy;
+    assert(asprintf(&psz_path, "%s/rec.mp4", dir) >= 0);
+    assert(asprintf(&psz_copy, "%s/interrupted.mp4", dir) >= 0);
+
+    const char *argv[] = { "-v", "--vout=vdummy", "--aout=adummy" };
+    libvlc_instance_t *vlc = libvlc_new(ARRAY_SIZE(argv), argv);
+    assert(vlc != NULL);
+
+    Record(VLC_OBJECT(vlc->p_libvlc_int), psz_path, psz_copy);
+
+    /* The complete recording is indexed already */
+    CheckPlayable(vlc, psz_path, (SECONDS - 1) * 1000, (SECONDS + 1) * 1000);
+    assert(Recover(psz_path) != 0);
+
+    /* The interrupted recording is rebuilt from its checkpoints */
+    assert(Recover(psz_copy) == 0);
+    CheckPlayable(vlc, psz_copy, 2 * 1000, SECONDS * 1000);
+
+    /* Once rebuilt, there is nothing left to recover */
+    assert(Recover(psz_copy) != 0);
+
+    libvlc_release(vlc);
+
+    unlink(psz_copy);
+    unlink(psz_path);
+    rmdir(dir);
+    free(psz_copy);
+    free(psz_path);
+    return 0;
+}
@@ -1,5 +1,5 @@
 /*****************************************************************************
- * hxxx.c tests NAL conversions
+ * hxxx.c tests NAL conversions and Annex B packetization
  *****************************************************************************
  * Copyright (C) 2015 VLC authors and VideoLAN
  *
@@ -27,10 +27,14 @@
 #endif
 
 #include <assert.h>
+#include <stdlib.h>
 #include <vlc_common.h>
 #include <vlc_block.h>
+#include <vlc_block_helper.h>
 #include "../modules/packetizer/hxxx_nal.h"
 #include "../modules/packetizer/hxxx_nal.c"
+#include "../modules/packetizer/startcode_helper.h"
+#include "../modules/packetizer/packetizer_helper.h"
 
 static void test_iterators( const uint8_t *p_ab, size_t i_ab, /* AnnexB */
                             const uint8_t **pp_prefix, size_t *pi_prefix /* Prefixed */ )
@@ -213,9 +217,225 @@ static void test_annexb()
     test_iterators( NULL, 0, p_res, rgi_res );
 }
 
-int main( void )
+/*****************************************************************************
+ * Annex B packetization through packetizer_helper.h
+ *****************************************************************************/
+static const uint8_t p_annexb_startcode[3] = { 0x00, 0x00, 0x01 };
+
+typedef struct
+{
+    block_t  *p_au;       /* NALs of the current access unit */
+    block_t **pp_au_last;
+    unsigned  i_au;
+    unsigned  i_shared_au; /* access units output without any copy */
+} test_packetizer_t;
+
+static void TestReset( void *p_private, bool b_broken )
+{
+    test_packetizer_t *p_test = p_private;
+    VLC_UNUSED(b_broken);
+
+    block_ChainRelease( p_test->p_au );
+    p_test->p_au = NULL;
+    p_test->pp_au_last = &p_test->p_au;
+}
+
+static block_t *TestOutput( test_packetizer_t *p_test )
+{
+    if( p_test->p_au == NULL )
+        return NULL;
+
+    block_t *p_au = packetizer_ChainGather( p_test->p_au );
+    p_test->p_au = NULL;
+    p_test->pp_au_last = &p_test->p_au;
+    if( p_au != NULL )
+    {
+        p_test->i_au++;
+        if( packetizer_GetSource( p_au ) != NULL )
+            p_test->i_shared_au++;
+    }
+    return p_au;
+}
+
+/* Splits access units on AUD, like the H.264 packetizer does */
+static block_t *TestParse( void *p_private, bool *pb_ts_used, block_t *p_nal )
+{
+    test_packetizer_t *p_test = p_private;
+    block_t *p_au = NULL;
+
+    *pb_ts_used = false;
+    while( p_nal->i_buffer > 5 && p_nal->p_buffer[p_nal->i_buffer-1] == 0x00 )
+        p_nal->i_buffer--;
+
+    if( (p_nal->p_buffer[4] & 0x1f) == 9 )
+        p_au = TestOutput( p_test );
+    block_ChainLastAppend( &p_test->pp_au_last, p_nal );
+    return p_au;
+}
+
+static int TestValidate( void *p_private, block_t *p_au )
+{
+    VLC_UNUSED(p_private);
+    VLC_UNUSED(p_au);
+    return VLC_SUCCESS;
+}
+
+static block_t *TestDrain( void *p_private )
+{
+    return TestOutput( p_private );
+}
+
+/* Generates an Annex B stream of i_au access units made of an AUD, a small
+ * parameter set and i_slices slices of i_slice bytes. Payloads never contain
+ * two consecutive zeros, so that they have no emulation prevention. */
+static uint8_t *GenerateAnnexB( unsigned i_au, unsigned i_slices,
+                                size_t i_slice, size_t *pi_data )
+{
+    static const uint8_t p_aud[] = { 0, 0, 0, 1, 0x09, 0xf0 };
+    static const uint8_t p_sps[] = { 0, 0, 0, 1, 0x67, 0x42, 0xc0, 0x1e, 0xd9 };
+    static const uint8_t p_idr[] = { 0, 0, 0, 1, 0x65 };
+    const size_t i_au_size = sizeof(p_aud) + sizeof(p_sps)
+                           + i_slices * (sizeof(p_idr) + i_slice);
+    uint8_t *p_data = malloc( i_au * i_au_size );
+    assert( p_data != NULL );
+
+    uint8_t *p = p_data;
+    unsigned i_seed = 1;
+    for( unsigned i = 0; i < i_au; i++ )
+    {
+        memcpy( p, p_aud, sizeof(p_aud) );
+        p += sizeof(p_aud);
+        memcpy( p, p_sps, sizeof(p_sps) );
+        p += sizeof(p_sps);
+        for( unsigned j = 0; j < i_slices; j++ )
+        {
+            memcpy( p, p_idr, sizeof(p_idr) );
+            p += sizeof(p_idr);
+            for( size_t k = 0; k < i_slice; k++ )
+            {
+                i_seed = i_seed * 1103515245 + 12345;
+                *p++ = 1 + (i_seed >> 16) % 255;
+            }
+        }
+    }
+    *pi_data = p - p_data;
+    return p_data;
+}
+
+/* Packetizes a stream split into blocks of i_block bytes, checks that the
+ * access units match the input, and returns the processing time */
+static mtime_t test_packetize( const uint8_t *p_data, size_t i_data,
+                               size_t i_block, bool b_shared,
+                               unsigned i_au_expected, bool b_zero_copy )
+{
+    test_packetizer_t test = { .p_au = NULL };
+    test.pp_au_last = &test.p_au;
+
+    packetizer_t pack;
+    packetizer_Init( &pack, p_annexb_startcode, sizeof(p_annexb_startcode),
+                     startcode_FindAnnexB, p_annexb_startcode, 1, 5, b_shared,
+                     TestReset, TestParse, TestValidate, TestDrain, &test );
+
+    /* Prepare the input blocks out of the measured time */
+    const size_t i_blocks = (i_data + i_block - 1) / i_block;
+    block_t **pp_in = malloc( (i_blocks + 1) * sizeof(*pp_in) );
+    assert( pp_in != NULL );
+    for( size_t i = 0; i < i_blocks; i++ )
+    {
+        const size_t i_size = __MIN( i_block, i_data - i * i_block );
+        pp_in[i] = block_Alloc( i_size );
+        assert( pp_in[i] != NULL );
+        memcpy( pp_in[i]->p_buffer, &p_data[i * i_block], i_size );
+    }
+    pp_in[i_blocks] = NULL; /* drain */
+
+    size_t i_out = 0;
+    const mtime_t i_start = mdate();
+    for( size_t i = 0; i <= i_blocks; i++ )
+    {
+        /* the input is owned by the packetizer once it returns NULL */
+        block_t *p_au;
+        while( ( p_au = packetizer_Packetize( &pack,
+                                    pp_in[i] ? &pp_in[i] : NULL ) ) )
+        {
+            assert( p_au->p_next == NULL );
+            assert( i_out + p_au->i_buffer <= i_data );
+            assert( !memcmp( p_au->p_buffer, &p_data[i_out], p_au->i_buffer ) );
+            i_out += p_au->i_buffer;
+            block_Release( p_au );
+        }
+    }
+    const mtime_t i_time = mdate() - i_start;
+    free( pp_in );
+
+    assert( i_out == i_data );
+    assert( test.i_au == i_au_expected );
+    if( b_zero_copy )
+        assert( test.i_shared_au == test.i_au );
+    if( !b_shared )
+        assert( test.i_shared_au == 0 );
+
+    packetizer_Clean( &pack );
+    TestReset( &test, false );
+    return i_time;
+}
+
+static void test_packetizer( void )
+{
+    size_t i_data;
+    uint8_t *p_data = GenerateAnnexB( 16, 3, 1000, &i_data );
+
+    printf("\nTEST packetizer\n");
+    /* Access units are zero-copy when they fit in the input blocks */
+    test_packetize( p_data, i_data, i_data, true, 16, true );
+    test_packetize( p_data, i_data, i_data, false, 16, false );
+    /* Fragments spanning several blocks are copied */
+    const size_t rgi_block[] = { 1, 5, 188, 1000, 4096 };
+    for( size_t i = 0; i < ARRAY_SIZE(rgi_block); i++ )
+    {
+        test_packetize( p_data, i_data, rgi_block[i], true, 16, false );
+        test_packetize( p_data, i_data, rgi_block[i], false, 16, false );
+    }
+    free( p_data );
+
+    /* Large access units, each in its own input block */
+    p_data = GenerateAnnexB( 4, 4, 64 * 1024, &i_data );
+    test_packetize( p_data, i_data, i_data / 4, true, 4, true );
+    test_packetize( p_data, i_data, i_data / 4, false, 4, false );
+    free( p_data );
+}
+
+/* Throughput with high bitrate intra-like access units, each in its own
+ * input block as an elementary stream demuxer would output them */
+static void bench_packetizer( unsigned i_mb )
+{
+    const unsigned i_slices = 4;
+    const size_t i_slice = 256 * 1024;
+    const unsigned i_au = __MAX( 1, i_mb * 1024 * 1024 / (i_slices * i_slice) );
+    size_t i_data;
+    uint8_t *p_data = GenerateAnnexB( i_au, i_slices, i_slice, &i_data );
+    const size_t i_au_size = i_data / i_au;
+
+    printf("\nBENCH packetizer: %u access units of %zu bytes\n", i_au, i_au_size);
+    for( int i = 0; i < 2; i++ )
+    {
+        const bool b_shared = i == 0;
+        mtime_t i_time = test_packetize( p_data, i_data, i_au_size, b_shared,
+                                         i_au, b_shared );
+        printf("%-8s: %"PRId64" us, %.1f MiB/s\n",
+               b_shared ? "shared" : "copy", i_time,
+               i_time > 0 ? i_data * (double)CLOCK_FREQ / i_time / 1048576. : 0.);
+    }
+    free( p_data );
+}
+
+int main( int argc, char *argv[] )
 {
     test_annexb();
+    test_packetizer();
+    /* hxxx <MiB>: also benchmarks the packetizer with a stream of that size */
+    if( argc > 1 )
+        bench_packetizer( (unsigned)atoi( argv[1] ) );
 
     return 0;
 }
@@ -0,0 +1,321 @@
+/*****************************************************************************
+ * rtpsched.c: RTP send scheduler benchmark
+ *****************************************************************************
+ * Copyright (C) 2020 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/* Simulates many RTSP clients, each receiving one audio and one video RTP
+ * stream over loopback UDP, and compares the shared send scheduler with the
+ * former thread per elementary stream.
+ *
+ * usage: test_modules_stream_out_rtpsched [clients] [seconds] [threads]
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifdef NDEBUG
+ #undef NDEBUG
+#endif
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <vlc_common.h>
+#include <vlc_atomic.h>
+#include <vlc_block.h>
+#include "../modules/stream_out/rtpsched.c"
+
+#define DELAY          (100 * 1000) /* like the default RTP caching */
+#define VIDEO_PERIOD   (CLOCK_FREQ / 30)
+#define VIDEO_PACKETS  10
+#define AUDIO_PERIOD   (CLOCK_FREQ / 50)
+#define PACKET_SIZE    1316
+
+typedef struct
+{
+    atomic_ullong i_packets;
+    atomic_ullong i_calls;
+    atomic_ullong i_late; /* total lateness (µs) */
+    atomic_ullong i_late_max;
+} bench_stats_t;
+
+typedef struct
+{
+    int      fd;
+    mtime_t  i_period;
+    unsigned i_packets;
+    mtime_t  i_next;
+    uint16_t i_seq;
+    uint16_t i_seq_sent;
+    uint64_t i_queued;
+
+    bench_stats_t *stats;
+    /* scheduler */
+    rtp_sched_queue_t *queue;
+    /* thread per stream */
+    block_fifo_t *fifo;
+    vlc_thread_t  thread;
+} bench_stream_t;
+
+static void Account( bench_stats_t *stats, const block_t *out )
+{
+    mtime_t i_late = mdate() - (out->i_dts + DELAY);
+    if( i_late < 0 )
+        i_late = 0;
+
+    atomic_fetch_add( &stats->i_packets, 1 );
+    atomic_fetch_add( &stats->i_late, i_late );
+
+    unsigned long long i_max = atomic_load( &stats->i_late_max );
+    while( (unsigned long long)i_late > i_max
+        && !atomic_compare_exchange_weak( &stats->i_late_max, &i_max,
+                                          i_late ) );
+}
+
+/* Shared scheduler: one batch per frame and per sink */
+static void SchedSend( void *data, block_t *chain )
+{
+    bench_stream_t *st = data;
+    const mtime_t i_now = mdate();
+    block_t *out = chain;
+
+    while( out != NULL )
+    {
+        block_t *pktv[RTP_SCHED_BATCH];
+        unsigned pktc = 0;
+
+        for( ; out != NULL && pktc < RTP_SCHED_BATCH; out = out->p_next )
+        {
+            /* Packets are sent in order, and never before they are due */
+            assert( GetWBE( out->p_buffer + 2 ) == st->i_seq_sent );
+            assert( out->i_dts + DELAY - RTP_SCHED_TICK <= i_now );
+            st->i_seq_sent++;
+            Account( st->stats, out );
+            pktv[pktc++] = out;
+        }
+
+        rtp_sched_SendPackets( st->fd, pktv, pktc );
+#ifdef HAVE_SENDMMSG
+        atomic_fetch_add( &st->stats->i_calls, 1 );
+#else
+        atomic_fetch_add( &st->stats->i_calls, pktc );
+#endif
+    }
+    block_ChainRelease( chain );
+}
+
+/* Former design: one thread per stream, one system call per packet */
+static void *ThreadSend( void *data )
+{
+    bench_stream_t *st = data;
+
+    for( ;; )
+    {
+        block_t *out = block_FifoGet( st->fifo );
+        block_cleanup_push( out );
+        mwait( out->i_dts + DELAY );
+        vlc_cleanup_pop();
+
+        int canc = vlc_savecancel();
+        Account( st->stats, out );
+        send( st->fd, out->p_buffer, out->i_buffer, 0 );
+        atomic_fetch_add( &st->stats->i_calls, 1 );
+        block_Release( out );
+        vlc_restorecancel( canc );
+    }
+    return NULL;
+}
+
+static void Emit( bench_stream_t *st, bool b_sched, mtime_t i_dts )
+{
+    for( unsigned i = 0; i < st->i_packets; i++ )
+    {
+        block_t *out = block_Alloc( PACKET_SIZE );
+        assert( out != NULL );
+
+        memset( out->p_buffer, 0, PACKET_SIZE );
+        out->p_buffer[0] = 0x80;
+        SetWBE( out->p_buffer + 2, st->i_seq++ );
+        out->i_dts = i_dts;
+        st->i_queued++;
+
+        if( b_sched )
+            rtp_sched_Queue( st->queue, out );
+        else
+            block_FifoPut( st->fifo, out );
+    }
+}
+
+static mtime_t CPUTime( void )
+{
+    struct rusage ru;
+
+    getrusage( RUSAGE_SELF, &ru );
+    return (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * CLOCK_FREQ
+         + ru.ru_utime.tv_usec + ru.ru_stime.tv_usec;
+}
+
+static void Run( unsigned i_clients, unsigned i_seconds, unsigned i_threads,
+                 const struct sockaddr_in *dst )
+{
+    const bool b_sched = i_threads > 0;
+    const unsigned i_streams = 2 * i_clients;
+    bench_stream_t *streams = calloc( i_streams, sizeof( *streams ) );
+    bench_stats_t stats;
+
+    assert( streams != NULL );
+    atomic_init( &stats.i_packets, 0 );
+    atomic_init( &stats.i_calls, 0 );
+    atomic_init( &stats.i_late, 0 );
+    atomic_init( &stats.i_late_max, 0 );
+
+    const mtime_t i_start = mdate();
+    for( unsigned i = 0; i < i_streams; i++ )
+    {
+        bench_stream_t *st = &streams[i];
+        const bool b_video = (i & 1) == 0;
+
+        st->fd = socket( AF_INET, SOCK_DGRAM, 0 );
+        assert( st->fd != -1 );
+        if( connect( st->fd, (const struct sockaddr *)dst, sizeof( *dst ) ) )
+            abort();
+
+        st->i_period = b_video ? VIDEO_PERIOD : AUDIO_PERIOD;
+        st->i_packets = b_video ? VIDEO_PACKETS : 1;
+        /* Clients did not all start playing at the same time */
+        st->i_next = i_start + (mtime_t)rand() % st->i_period;
+        st->stats = &stats;
+
+        if( b_sched )
+        {
+            st->queue = rtp_sched_Attach( i_threads, DELAY, SchedSend, st );
+            assert( st->queue != NULL );
+        }
+        else
+        {
+            st->fifo = block_FifoNew();
+            assert( st->fifo != NULL );
+            if( vlc_clone( &st->thread, ThreadSend, st,
+                           VLC_THREAD_PRIORITY_HIGHEST ) )
+                abort();
+        }
+    }
+
+    const mtime_t i_cpu = CPUTime();
+    const mtime_t i_end = mdate() + (mtime_t)i_seconds * CLOCK_FREQ;
+    mtime_t i_now;
+
+    /* Feed the streams in real time, like the stream output would */
+    while( (i_now = mdate()) < i_end )
+    {
+        mtime_t i_wakeup = i_end;
+
+        for( unsigned i = 0; i < i_streams; i++ )
+        {
+            bench_stream_t *st = &streams[i];
+
+            while( st->i_next <= i_now )
+            {
+                Emit( st, b_sched, st->i_next );
+                st->i_next += st->i_period;
+            }
+            if( st->i_next < i_wakeup )
+                i_wakeup = st->i_next;
+        }
+        mwait( i_wakeup );
+    }
+
+    /* Let the last packets go */
+    mwait( mdate() + 2 * DELAY );
+    const mtime_t i_cpu_time = CPUTime() - i_cpu;
+
+    uint64_t i_queued = 0;
+    for( unsigned i = 0; i < i_streams; i++ )
+    {
+        bench_stream_t *st = &streams[i];
+
+        if( b_sched )
+            rtp_sched_Detach( st->queue );
+        else
+        {
+            vlc_cancel( st->thread );
+            vlc_join( st->thread, NULL );
+            block_FifoRelease( st->fifo );
+        }
+        close( st->fd );
+        i_queued += st->i_queued;
+    }
+    free( streams );
+
+    unsigned long long i_packets = atomic_load( &stats.i_packets );
+    assert( i_packets == i_queued );
+
+    if( b_sched )
+        printf( "scheduler (%u thread(s)):", i_threads );
+    else
+        printf( "thread per stream (%u threads):", i_streams );
+    printf( "\n  %llu packets, %llu send calls, CPU time %"PRId64" ms"
+            " (%.1f%% of one CPU)\n  lateness: average %llu us, max %llu us\n",
+            i_packets, atomic_load( &stats.i_calls ), i_cpu_time / 1000,
+            100. * i_cpu_time / ((i_seconds * CLOCK_FREQ) + 2 * DELAY),
+            i_packets ? atomic_load( &stats.i_late ) / i_packets : 0,
+            atomic_load( &stats.i_late_max ) );
+}
+
+int main( int argc, char **argv )
+{
+    unsigned i_clients = argc > 1 ? strtoul( argv[1], NULL, 0 ) : 100;
+    unsigned i_seconds = argc > 2 ? strtoul( argv[2], NULL, 0 ) : 2;
+    unsigned i_threads = argc > 3 ? strtoul( argv[3], NULL, 0 ) : 1;
+
+    if( i_clients == 0 || i_seconds == 0 || i_threads == 0 )
+    {
+        fprintf( stderr, "usage: %s [clients] [seconds] [threads]\n",
+                 argv[0] );
+        return 1;
+    }
+
+    /* Discard receiver: the packets that it does not read are dropped */
+    struct sockaddr_in dst = {
+        .sin_family = AF_INET,
+        .sin_addr.s_addr = htonl( INADDR_LOOPBACK ),
+    };
+    int fd = socket( AF_INET, SOCK_DGRAM, 0 );
+    if( fd == -1
+     || bind( fd, (struct sockaddr *)&dst, sizeof( dst ) )
+     || getsockname( fd, (struct sockaddr *)&dst, &(socklen_t){ sizeof(dst) } ) )
+    {
+        perror( "receiver" );
+        return 77;
+    }
+
+    printf( "%u clients, %u streams, %u seconds\n", i_clients, 2 * i_clients,
+            i_seconds );
+    Run( i_clients, i_seconds, 0, &dst );
+    Run( i_clients, i_seconds, i_threads, &dst );
+
+    close( fd );
+    return 0;
+}
@@ -0,0 +1,376 @@
+/*****************************************************************************
+ * seekindex.c: test for the seek index
+ *****************************************************************************
+ * Copyright (C) 2020 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <dirent.h>
+
+#include <vlc_common.h>
+#include <vlc_seekindex.h>
+#include <vlc_stream.h>
+#include <vlc_url.h>
+#include "../../../lib/libvlc_internal.h"
+#include "../../libvlc/test.h"
+
+#include <vlc/vlc.h>
+
+#define TRACKS  2
+#define ENTRIES 1000
+
+static char dir[] = "/tmp/vlc-seekindex-XXXXXX";
+static char *media;
+static stream_t stream;
+
+static vlc_seekindex_entry_t Entry( unsigned track, unsigned i )
+{
+    vlc_seekindex_entry_t e = {
+        .i_time = (int64_t)i * CLOCK_FREQ / 2 + track,
+        .i_pos = (uint64_t)i * 100000 + track * 17,
+        .i_size = i % 7 ? 1000 + i : 0,
+        .i_flags = i % 10 ? 0 : VLC_SEEKINDEX_KEYFRAME,
+    };
+    return e;
+}
+
+static bool Equals( const vlc_seekindex_entry_t *a,
+                    const vlc_seekindex_entry_t *b )
+{
+    return a->i_time == b->i_time && a->i_pos == b->i_pos &&
+           a->i_size == b->i_size && a->i_flags == b->i_flags;
+}
+
+static bool IsEmpty( const vlc_seekindex_t *idx )
+{
+    for( unsigned t = 0; t < TRACKS; t++ )
+        if( vlc_seekindex_Count( idx, t ) != 0 )
+            return false;
+    return vlc_seekindex_CountRanges( idx ) == 0;
+}
+
+static void CheckRanges( const vlc_seekindex_t *idx,
+                         const uint64_t (*ranges)[2], size_t count )
+{
+    assert( vlc_seekindex_CountRanges( idx ) == count );
+    for( size_t i = 0; i < count; i++ )
+    {
+        uint64_t start, end;
+        vlc_seekindex_GetRange( idx, i, &start, &end );
+        assert( start == ranges[i][0] && end == ranges[i][1] );
+    }
+}
+
+static void CheckIndex( const vlc_seekindex_t *idx )
+{
+    for( unsigned t = 0; t < TRACKS; t++ )
+    {
+        assert( vlc_seekindex_Count( idx, t ) == ENTRIES );
+        for( unsigned i = 0; i < ENTRIES; i++ )
+        {
+            vlc_seekindex_entry_t e = Entry( t, i );
+            assert( Equals( vlc_seekindex_Get( idx, t, i ), &e ) );
+        }
+    }
+    static const uint64_t ranges[][2] = {
+        { 0, 50000000 }, { 60000000, 99999999 } };
+    CheckRanges( idx, ranges, ARRAY_SIZE(ranges) );
+}
+
+static void test_ranges( vlc_object_t *obj )
+{
+    vlc_seekindex_t *idx = vlc_seekindex_Open( obj, &stream, "ranges" );
+    assert( idx != NULL );
+    assert( IsEmpty( idx ) );
+
+    /* Empty ranges are ignored */
+    assert( vlc_seekindex_AddRange( idx, 10, 10 ) == VLC_SUCCESS );
+    assert( vlc_seekindex_AddRange( idx, 20, 10 ) == VLC_SUCCESS );
+    assert( vlc_seekindex_CountRanges( idx ) == 0 );
+
+    vlc_seekindex_AddRange( idx, 100, 200 );
+    vlc_seekindex_AddRange( idx, 300, 400 );
+    vlc_seekindex_AddRange( idx, 0, 50 );
+    static const uint64_t disjoint[][2] = {
+        { 0, 50 }, { 100, 200 }, { 300, 400 } };
+    CheckRanges( idx, disjoint, ARRAY_SIZE(disjoint) );
+
+    /* Adjacent ranges are merged */
+    vlc_seekindex_AddRange( idx, 50, 60 );
+    vlc_seekindex_AddRange( idx, 200, 210 );
+    static const uint64_t adjacent[][2] = {
+        { 0, 60 }, { 100, 210 }, { 300, 400 } };
+    CheckRanges( idx, adjacent, ARRAY_SIZE(adjacent) );
+
+    /* Covered ranges change nothing */
+    vlc_seekindex_AddRange( idx, 120, 180 );
+    vlc_seekindex_AddRange( idx, 300, 400 );
+    CheckRanges( idx, adjacent, ARRAY_SIZE(adjacent) );
+    assert( vlc_seekindex_Covers( idx, 100, 210 ) );
+    assert( vlc_seekindex_Covers( idx, 0, 1 ) );
+    assert( !vlc_seekindex_Covers( idx, 50, 110 ) );
+    assert( !vlc_seekindex_Covers( idx, 399, 401 ) );
+
+    /* Overlapping ranges are merged, across several ranges */
+    vlc_seekindex_AddRange( idx, 350, 500 );
+    vlc_seekindex_AddRange( idx, 30, 150 );
+    static const uint64_t merged[][2] = { { 0, 210 }, { 300, 500 } };
+    CheckRanges( idx, merged, ARRAY_SIZE(merged) );
+
+    vlc_seekindex_AddRange( idx, 210, 300 );
+    static const uint64_t all[][2] = { { 0, 500 } };
+    CheckRanges( idx, all, ARRAY_SIZE(all) );
+    assert( vlc_seekindex_Covers( idx, 0, 500 ) );
+
+    vlc_seekindex_AddRange( idx, 1000, 2000 );
+    vlc_seekindex_AddRange( idx, 600, 700 );
+    vlc_seekindex_AddRange( idx, 0, 5000 );
+    static const uint64_t whole[][2] = { { 0, 5000 } };
+    CheckRanges( idx, whole, ARRAY_SIZE(whole) );
+
+    vlc_seekindex_Close( idx );
+}
+
+static void test_entries( vlc_object_t *obj )
+{
+    vlc_seekindex_t *idx = vlc_seekindex_Open( obj, &stream, "entries" );
+    assert( idx != NULL );
+    assert( IsEmpty( idx ) );
+
+    /* In order, backwards, and duplicated */
+    for( unsigned i = 0; i < ENTRIES; i++ )
+    {
+        vlc_seekindex_entry_t e = Entry( 0, i );
+        assert( vlc_seekindex_Add( idx, 0, &e ) == VLC_SUCCESS );
+    }
+    for( unsigned i = ENTRIES; i-- > 0; )
+    {
+        vlc_seekindex_entry_t e = Entry( 1, i );
+        assert( vlc_seekindex_Add( idx, 1, &e ) == VLC_SUCCESS );
+        assert( vlc_seekindex_Add( idx, 1, &e ) == VLC_SUCCESS );
+    }
+    vlc_seekindex_entry_t e = Entry( 0, ENTRIES / 2 );
+    assert( vlc_seekindex_Add( idx, 0, &e ) == VLC_SUCCESS );
+
+    vlc_seekindex_AddRange( idx, 60000000, 99999999 );
+    vlc_seekindex_AddRange( idx, 0, 50000000 );
+    CheckIndex( idx );
+
+    /* Lookup */
+    assert( vlc_seekindex_Count( idx, TRACKS ) == 0 );
+    assert( vlc_seekindex_Lookup( idx, TRACKS, 0, 0 ) == -1 );
+    assert( vlc_seekindex_Lookup( idx, 0, -1, 0 ) == -1 );
+    assert( vlc_seekindex_Lookup( idx, 0, 0, 0 ) == 0 );
+    assert( vlc_seekindex_Lookup( idx, 1, 0, 0 ) == -1 );
+    assert( vlc_seekindex_Lookup( idx, 0, CLOCK_FREQ * 2 - 1, 0 ) == 3 );
+    assert( vlc_seekindex_Lookup( idx, 0, CLOCK_FREQ * 2, 0 ) == 4 );
+    assert( vlc_seekindex_Lookup( idx, 0, CLOCK_FREQ * 10,
+                                  VLC_SEEKINDEX_KEYFRAME ) == 20 );
+    assert( vlc_seekindex_Lookup( idx, 0, CLOCK_FREQ * 10 - 1,
+                                  VLC_SEEKINDEX_KEYFRAME ) == 10 );
+    assert( vlc_seekindex_Lookup( idx, 0, INT64_MAX, 0 ) == ENTRIES - 1 );
+    assert( vlc_seekindex_Lookup( idx, 0, INT64_MAX,
+                                  VLC_SEEKINDEX_PRIVATE ) == -1 );
+
+    vlc_seekindex_Close( idx );
+
+    /* Round trip */
+    idx = vlc_seekindex_Open( obj, &stream, "entries" );
+    assert( idx != NULL );
+    CheckIndex( idx );
+    vlc_seekindex_Close( idx );
+
+    /* Indexes of other names are separate */
+    idx = vlc_seekindex_Open( obj, &stream, "other" );
+    assert( idx != NULL );
+    assert( IsEmpty( idx ) );
+    vlc_seekindex_Close( idx );
+}
+
+/* Returns the path of the only index file, or removes all of them */
+static char *FindIndex( bool remove )
+{
+    char *path, *found = NULL;
+    assert( asprintf( &path, "%s/vlc/seekindex", dir ) >= 0 );
+
+    DIR *d = opendir( path );
+    assert( d != NULL );
+    struct dirent *ent;
+    while( (ent = readdir( d )) != NULL )
+    {
+        if( ent->d_name[0] == '.' )
+            continue;
+        assert( found == NULL || remove );
+        free( found );
+        assert( asprintf( &found, "%s/%s", path, ent->d_name ) >= 0 );
+        if( remove )
+            unlink( found );
+    }
+    closedir( d );
+
+    if( remove )
+    {
+        rmdir( path );
+        free( found );
+        found = NULL;
+    }
+    free( path );
+    return found;
+}
+
+static void WriteFile( const char *path, const uint8_t *data, size_t size )
+{
+    FILE *file = fopen( path, "wb" );
+    assert( file != NULL );
+    assert( size == 0 || fwrite( data, size, 1, file ) == 1 );
+    fclose( file );
+}
+
+static void Sanitize( const vlc_seekindex_t *idx )
+{
+    /* Whatever was loaded must be usable */
+    for( unsigned t = 0; t < TRACKS; t++ )
+    {
+        size_t count = vlc_seekindex_Count( idx, t );
+        for( size_t i = 1; i < count; i++ )
+            assert( vlc_seekindex_Get( idx, t, i - 1 )->i_time <=
+                    vlc_seekindex_Get( idx, t, i )->i_time );
+        vlc_seekindex_Lookup( idx, t, INT64_MAX, VLC_SEEKINDEX_KEYFRAME );
+    }
+    uint64_t prev = 0;
+    for( size_t i = 0; i < vlc_seekindex_CountRanges( idx ); i++ )
+    {
+        uint64_t start, end;
+        vlc_seekindex_GetRange( idx, i, &start, &end );
+        assert( start >= prev && start < end );
+        prev = end;
+    }
+}
+
+static void test_corrupted( vlc_object_t *obj )
+{
+    vlc_seekindex_t *idx = vlc_seekindex_Open( obj, &stream, "entries" );
+    assert( idx != NULL );
+    vlc_seekindex_Close( idx );
+
+    char *path = FindIndex( false );
+    assert( path != NULL );
+    FILE *file = fopen( path, "rb" );
+    assert( file != NULL );
+    uint8_t *data = malloc( 65536 );
+    assert( data != NULL );
+    size_t size = fread( data, 1, 65536, file );
+    fclose( file );
+    assert( size > 0 && size < 65536 );
+
+    /* Truncated files are rejected */
+    for( size_t len = 0; len < size; len += len < 256 ? 1 : 97 )
+    {
+        /* Copy to an exact size buffer, to catch overreads */
+        uint8_t *copy = malloc( len + 1 );
+        assert( copy != NULL );
+        memcpy( copy, data, len );
+        WriteFile( path, copy, len );
+        free( copy );
+
+        idx = vlc_seekindex_Open( obj, &stream, "entries" );
+        assert( idx != NULL );
+        assert( IsEmpty( idx ) );
+        vlc_seekindex_Close( idx );
+    }
+
+    /* Corrupted files are rejected or still consistent */
+    for( size_t i = 0; i < size; i += i < 256 ? 1 : 61 )
+    {
+        static const uint8_t values[] = { 0x00, 0x7f, 0x80, 0xff };
+        for( size_t v = 0; v < ARRAY_SIZE(values); v++ )
+        {
+            const uint8_t byte = data[i];
+            data[i] = values[v];
+            WriteFile( path, data, size );
+            data[i] = byte;
+
+            idx = vlc_seekindex_Open( obj, &stream, "entries" );
+            assert( idx != NULL );
+            Sanitize( idx );
+            vlc_seekindex_Close( idx );
+        }
+    }
+
+    /* Unchanged file */
+    WriteFile( path, data, size );
+    idx = vlc_seekindex_Open( obj, &stream, "entries" );
+    assert( idx != NULL );
+    CheckIndex( idx );
+    vlc_seekindex_Close( idx );
+
+    /* The index is discarded when the media changes */
+    file = fopen( media, "ab" );
+    assert( file != NULL );
+    fputs( "more data", file );
+    fclose( file );
+    idx = vlc_seekindex_Open( obj, &stream, "entries" );
+    assert( idx != NULL );
+    assert( IsEmpty( idx ) );
+    vlc_seekindex_Close( idx );
+
+    free( path );
+    free( data );
+}
+
+int main( void )
+{
+    test_init();
+
+    assert( mkdtemp( dir ) != NULL );
+    setenv( "XDG_CACHE_HOME", dir, 1 );
+
+    const char *argv[] = { "-v" };
+    libvlc_instance_t *vlc = libvlc_new( ARRAY_SIZE(argv), argv );
+    assert( vlc != NULL );
+    vlc_object_t *obj = VLC_OBJECT(vlc->p_libvlc_int);
+
+    assert( asprintf( &media, "%s/media.ts", dir ) >= 0 );
+    WriteFile( media, (const uint8_t *)"media", 5 );
+    stream.psz_url = vlc_path2uri( media, NULL );
+    assert( stream.psz_url != NULL );
+
+    /* Only local files are indexed */
+    stream_t remote = { .psz_url = (char *)"http://example.com/media.ts" };
+    assert( vlc_seekindex_Open( obj, &remote, "entries" ) == NULL );
+
+    test_ranges( obj );
+    FindIndex( true );
+    test_entries( obj );
+    test_corrupted( obj );
+
+    libvlc_release( vlc );
+
+    FindIndex( true );
+    char *path;
+    assert( asprintf( &path, "%s/vlc", dir ) >= 0 );
+    rmdir( path );
+    free( path );
+    unlink( media );
+    rmdir( dir );
+    free( stream.psz_url );
+    free( media );
+    return 0;
+}
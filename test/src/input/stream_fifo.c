@@ -240,6 +240,65 @@ int main(void)
     vlc_stream_Delete(s);
     block_Release(block);
 
+    s = vlc_stream_fifo_New(parent);
+    assert(s != NULL);
+    val = vlc_stream_fifo_Write(s, "1st block\n", 10);
+    assert(val == 10);
+    val = vlc_stream_fifo_Write(s, "2nd block\n", 10);
+    assert(val == 10);
+    val = vlc_stream_fifo_Write(s, "3rd block\n", 10);
+    assert(val == 10);
+    vlc_stream_fifo_Close(s);
+
+    /* split a block by reference */
+    block = vlc_stream_ReadBlocks(s, 4);
+    assert(block != NULL);
+    assert(block->p_next == NULL);
+    assert(block->i_buffer == 4);
+    assert(vlc_stream_Tell(s) == 4);
+    assert(memcmp(block->p_buffer, "1st ", 4) == 0);
+    block_Release(block);
+
+    val = vlc_stream_Peek(s, &peek, 2);
+    assert(val == 2);
+    assert(memcmp(peek, "bl", 2) == 0);
+
+    /* read across blocks */
+    block = vlc_stream_ReadBlocks(s, 10);
+    assert(block != NULL);
+    assert(vlc_stream_Tell(s) == 14);
+    {
+        block_t *gathered = block_ChainGather(block);
+        assert(gathered != NULL);
+        assert(gathered->i_buffer == 10);
+        assert(memcmp(gathered->p_buffer, "block\n2nd ", 10) == 0);
+        block_Release(gathered);
+    }
+
+    block = vlc_stream_Block(s, 3);
+    assert(block != NULL);
+    assert(block->i_buffer == 3);
+    assert(vlc_stream_Tell(s) == 17);
+    assert(memcmp(block->p_buffer, "blo", 3) == 0);
+
+    /* short read at end of stream */
+    {
+        block_t *rest = vlc_stream_ReadBlocks(s, 100);
+        size_t len;
+
+        assert(rest != NULL);
+        block_ChainProperties(rest, NULL, &len, NULL);
+        assert(len == 13);
+        assert(vlc_stream_Tell(s) == 30);
+        block_ChainRelease(rest);
+    }
+    assert(vlc_stream_ReadBlocks(s, 1) == NULL);
+    assert(vlc_stream_Eof(s));
+    vlc_stream_Delete(s);
+    /* views must remain valid after the stream is gone */
+    assert(memcmp(block->p_buffer, "blo", 3) == 0);
+    block_Release(block);
+
     libvlc_release(vlc);
 
     return 0;
@@ -0,0 +1,221 @@
+/*****************************************************************************
+ * fft.c: test for the fast Fourier transforms
+ *****************************************************************************
+ * Copyright (C) 2020 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <math.h>
+
+#include <vlc_common.h>
+#include <vlc_fft.h>
+#include "../../../lib/libvlc_internal.h"
+#include "../../libvlc/test.h"
+
+#include <vlc/vlc.h>
+
+/* Relative to the largest output value */
+#define TOLERANCE 1e-5
+
+static double Compare( const float *ref, const float *test, unsigned count )
+{
+    double max = 0, err = 0;
+    for( unsigned i = 0; i < count; i++ )
+    {
+        max = __MAX( max, fabs( ref[i] ) );
+        err = __MAX( err, fabs( (double)ref[i] - test[i] ) );
+    }
+    return max > 0 ? err / max : err;
+}
+
+/* Naive transform of n complex values, or n real values if real */
+static void DFT( const float *in, float *out, unsigned n, bool real,
+                 bool inverse )
+{
+    const double sign = inverse ? 1. : -1.;
+
+    for( unsigned k = 0; k < n; k++ )
+    {
+        double re = 0, im = 0;
+        for( unsigned j = 0; j < n; j++ )
+        {
+            double a = sign * 2. * M_PI * ( (uint64_t)j * k % n ) / n;
+            double xr = real ? in[j] : in[2 * j];
+            double xi = real ? 0. : in[2 * j + 1];
+            re += xr * cos( a ) - xi * sin( a );
+            im += xr * sin( a ) + xi * cos( a );
+        }
+        out[2 * k]     = re;
+        out[2 * k + 1] = im;
+    }
+}
+
+static float *Signal( unsigned count )
+{
+    float *buf = malloc( count * sizeof (*buf) );
+    assert( buf != NULL );
+    for( unsigned i = 0; i < count; i++ )
+        buf[i] = rand() / (float)RAND_MAX - .5f;
+    return buf;
+}
+
+static void test_complex( vlc_object_t *obj, unsigned n )
+{
+    vlc_fft_t *fft = vlc_fft_New( obj, n, VLC_FFT_COMPLEX );
+    assert( fft != NULL );
+
+    float *in = Signal( 2 * n );
+    float *ref = malloc( 2 * n * sizeof (*ref) );
+    float *out = malloc( 2 * n * sizeof (*out) );
+    assert( ref != NULL && out != NULL );
+
+    DFT( in, ref, n, false, false );
+    vlc_fft_Forward( fft, in, out );
+    assert( Compare( ref, out, 2 * n ) < TOLERANCE );
+
+    DFT( in, ref, n, false, true );
+    vlc_fft_Inverse( fft, in, out );
+    assert( Compare( ref, out, 2 * n ) < TOLERANCE );
+
+    /* In place, and back */
+    memcpy( out, in, 2 * n * sizeof (*out) );
+    vlc_fft_Forward( fft, out, out );
+    vlc_fft_Inverse( fft, out, out );
+    for( unsigned i = 0; i < 2 * n; i++ )
+        out[i] /= n;
+    assert( Compare( in, out, 2 * n ) < TOLERANCE );
+
+    free( out );
+    free( ref );
+    free( in );
+    vlc_fft_Delete( fft );
+}
+
+static void test_real( vlc_object_t *obj, unsigned n )
+{
+    vlc_fft_t *fft = vlc_fft_New( obj, n, VLC_FFT_REAL );
+    assert( fft != NULL );
+
+    float *in = Signal( n );
+    float *ref = malloc( 2 * n * sizeof (*ref) );
+    float *out = malloc( ( n + 2 ) * sizeof (*out) );
+    float *back = malloc( n * sizeof (*back) );
+    float *power = malloc( ( n / 2 + 1 ) * sizeof (*power) );
+    assert( ref != NULL && out != NULL && back != NULL && power != NULL );
+
+    DFT( in, ref, n, true, false );
+    vlc_fft_Forward( fft, in, out );
+    assert( Compare( ref, out, n + 2 ) < TOLERANCE );
+
+    vlc_fft_PowerSpectrum( fft, in, power );
+    for( unsigned k = 0; k <= n / 2; k++ )
+        ref[k] = ref[2 * k] * ref[2 * k] + ref[2 * k + 1] * ref[2 * k + 1];
+    assert( Compare( ref, power, n / 2 + 1 ) < 4 * TOLERANCE );
+
+    /* The imaginary parts of the first and last values are ignored */
+    out[1] = out[n + 1] = 1000.f;
+    vlc_fft_Inverse( fft, out, back );
+    for( unsigned i = 0; i < n; i++ )
+        back[i] /= n;
+    assert( Compare( in, back, n ) < TOLERANCE );
+
+    free( power );
+    free( back );
+    free( out );
+    free( ref );
+    free( in );
+    vlc_fft_Delete( fft );
+}
+
+static void test_sizes( vlc_object_t *obj )
+{
+    static const unsigned bad_complex[] = { 0, 7, 11, 14, 49, 1000003 };
+    static const unsigned bad_real[] = { 0, 1, 5, 14, 15, 22 };
+
+    for( size_t i = 0; i < ARRAY_SIZE(bad_complex); i++ )
+    {
+        assert( !vlc_fft_IsSizeSupported( bad_complex[i], VLC_FFT_COMPLEX ) );
+        assert( vlc_fft_New( obj, bad_complex[i], VLC_FFT_COMPLEX ) == NULL );
+    }
+    for( size_t i = 0; i < ARRAY_SIZE(bad_real); i++ )
+    {
+        assert( !vlc_fft_IsSizeSupported( bad_real[i], VLC_FFT_REAL ) );
+        assert( vlc_fft_New( obj, bad_real[i], VLC_FFT_REAL ) == NULL );
+    }
+    assert( vlc_fft_IsSizeSupported( 1, VLC_FFT_COMPLEX ) );
+    assert( vlc_fft_IsSizeSupported( 2 * 3 * 5 * 64, VLC_FFT_REAL ) );
+}
+
+static void bench( vlc_object_t *obj, unsigned n )
+{
+    vlc_fft_t *fft = vlc_fft_New( obj, n, VLC_FFT_REAL );
+    assert( fft != NULL );
+
+    float *in = Signal( n );
+    float *power = malloc( ( n / 2 + 1 ) * sizeof (*power) );
+    assert( power != NULL );
+
+    /* Informative only: the speed depends on the machine */
+    const unsigned count = 2000;
+    mtime_t start = mdate();
+    for( unsigned i = 0; i < count; i++ )
+        vlc_fft_PowerSpectrum( fft, in, power );
+    printf( "real %u points: %.2f us per power spectrum\n", n,
+            (double)( mdate() - start ) / count );
+
+    free( power );
+    free( in );
+    vlc_fft_Delete( fft );
+}
+
+int main( void )
+{
+    test_init();
+
+    const char *argv[] = { "-v" };
+    libvlc_instance_t *vlc = libvlc_new( ARRAY_SIZE(argv), argv );
+    assert( vlc != NULL );
+    vlc_object_t *obj = VLC_OBJECT(vlc->p_libvlc_int);
+
+    test_sizes( obj );
+
+    for( unsigned n = 1; n <= 1024; n++ )
+        if( vlc_fft_IsSizeSupported( n, VLC_FFT_COMPLEX ) )
+            test_complex( obj, n );
+    for( unsigned n = 2; n <= 2048; n += 2 )
+        if( vlc_fft_IsSizeSupported( n, VLC_FFT_REAL ) )
+            test_real( obj, n );
+    test_complex( obj, 4096 );
+    test_real( obj, 4096 );
+
+    /* The same sizes share their tables */
+    vlc_fft_t *a = vlc_fft_New( obj, 960, VLC_FFT_COMPLEX );
+    vlc_fft_t *b = vlc_fft_New( obj, 960, VLC_FFT_COMPLEX );
+    assert( a != NULL && b != NULL );
+    vlc_fft_Delete( b );
+    vlc_fft_Delete( a );
+
+    bench( obj, 512 );
+    bench( obj, 2048 );
+    bench( obj, 4096 );
+
+    libvlc_release( vlc );
+    return 0;
+}
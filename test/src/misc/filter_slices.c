@@ -0,0 +1,205 @@
+/*****************************************************************************
+ * filter_slices.c: test for the video filter slice threads
+ *****************************************************************************
+ * Copyright (C) 2020 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc_common.h>
+#include <vlc_atomic.h>
+#include <vlc_filter.h>
+#include <vlc_picture.h>
+#include "../../../lib/libvlc_internal.h"
+#include "../../libvlc/test.h"
+
+#include <vlc/vlc.h>
+
+struct coverage
+{
+    unsigned i_workers;
+    unsigned i_overlap;
+    int pi_lines[PICTURE_PLANE_MAX];
+    atomic_uint *pp_count[PICTURE_PLANE_MAX];
+};
+
+static void CoverageSlice( filter_t *p_filter, const filter_slice_t *p_slice,
+                           void *p_data )
+{
+    struct coverage *p_cov = p_data;
+    const int i_lines = p_cov->pi_lines[p_slice->i_plane];
+    (void) p_filter;
+
+    assert( p_slice->i_worker < p_cov->i_workers );
+    assert( p_slice->i_start < p_slice->i_end );
+    assert( p_slice->i_end <= i_lines );
+    assert( p_slice->i_first ==
+            __MAX( p_slice->i_start - (int)p_cov->i_overlap, 0 ) );
+    /* Small slices only when the plane is not split */
+    assert( p_slice->i_end - p_slice->i_start >= 4 * (int)p_cov->i_overlap
+         || p_slice->i_end - p_slice->i_start == i_lines );
+
+    for( int i = p_slice->i_start; i < p_slice->i_end; i++ )
+        atomic_fetch_add( &p_cov->pp_count[p_slice->i_plane][i], 1 );
+}
+
+static void test_coverage( filter_t *p_filter, const picture_t *p_pic,
+                           int i_planes, unsigned i_overlap )
+{
+    struct coverage cov = {
+        .i_workers = filter_GetSliceWorkers( p_filter ),
+        .i_overlap = i_overlap,
+    };
+
+    for( int i = 0; i < p_pic->i_planes; i++ )
+    {
+        cov.pi_lines[i] = p_pic->p[i].i_visible_lines;
+        cov.pp_count[i] = malloc( cov.pi_lines[i] * sizeof( atomic_uint ) );
+        assert( cov.pp_count[i] != NULL );
+        for( int j = 0; j < cov.pi_lines[i]; j++ )
+            atomic_init( &cov.pp_count[i][j], 0 );
+    }
+
+    filter_ExecuteSlices( p_filter, p_pic, i_planes, i_overlap,
+                          CoverageSlice, &cov );
+
+    /* Every line of the requested planes exactly once, none of the others */
+    for( int i = 0; i < p_pic->i_planes; i++ )
+    {
+        const unsigned i_expected = i_planes <= 0 || i < i_planes;
+        for( int j = 0; j < cov.pi_lines[i]; j++ )
+            assert( atomic_load( &cov.pp_count[i][j] ) == i_expected );
+        free( cov.pp_count[i] );
+    }
+}
+
+struct caller
+{
+    filter_t *p_filter;
+    const picture_t *p_pic;
+};
+
+static void *Caller( void *data )
+{
+    const struct caller *p_caller = data;
+
+    for( int i = 0; i < 50; i++ )
+        test_coverage( p_caller->p_filter, p_caller->p_pic, 0, i % 8 );
+    return NULL;
+}
+
+/* 3x3 box blur, as a stand-in for a real filter */
+static void BlurSlice( filter_t *p_filter, const filter_slice_t *p_slice,
+                       void *p_data )
+{
+    const picture_t *const *pp_pics = p_data;
+    const plane_t *p_in = &pp_pics[0]->p[p_slice->i_plane];
+    const plane_t *p_out = &pp_pics[1]->p[p_slice->i_plane];
+    (void) p_filter;
+
+    for( int y = p_slice->i_start; y < p_slice->i_end; y++ )
+    {
+        const uint8_t *p_above = &p_in->p_pixels[__MAX(y - 1, 0) * p_in->i_pitch];
+        const uint8_t *p_line = &p_in->p_pixels[y * p_in->i_pitch];
+        const uint8_t *p_below = &p_in->p_pixels[__MIN(y + 1, p_in->i_visible_lines - 1) * p_in->i_pitch];
+        uint8_t *p_dst = &p_out->p_pixels[y * p_out->i_pitch];
+
+        p_dst[0] = p_line[0];
+        for( int x = 1; x < p_in->i_visible_pitch - 1; x++ )
+            p_dst[x] = ( p_above[x-1] + p_above[x] + p_above[x+1]
+                       + p_line[x-1]  + p_line[x]  + p_line[x+1]
+                       + p_below[x-1] + p_below[x] + p_below[x+1] ) / 9;
+        p_dst[p_in->i_visible_pitch - 1] = p_line[p_in->i_visible_pitch - 1];
+    }
+}
+
+static void test_threads( unsigned i_threads, bool b_bench )
+{
+    char psz_threads[24];
+    snprintf( psz_threads, sizeof( psz_threads ), "--filter-threads=%u",
+              i_threads );
+    const char *ppsz_argv[] = { "-v", "--vout=vdummy", psz_threads };
+
+    libvlc_instance_t *p_vlc = libvlc_new( ARRAY_SIZE( ppsz_argv ), ppsz_argv );
+    assert( p_vlc != NULL );
+
+    filter_t *p_filter = vlc_object_create( p_vlc->p_libvlc_int,
+                                            sizeof( *p_filter ) );
+    assert( p_filter != NULL );
+    assert( filter_GetSliceWorkers( p_filter ) == i_threads );
+
+    video_format_t fmt;
+    video_format_Setup( &fmt, VLC_CODEC_I420, 3840, 2160, 3840, 2160, 1, 1 );
+    picture_t *p_pic = picture_NewFromFormat( &fmt );
+    picture_t *p_out = picture_NewFromFormat( &fmt );
+    assert( p_pic != NULL && p_out != NULL );
+
+    /* Slicing of all the planes, some of them and with overlaps */
+    test_coverage( p_filter, p_pic, 0, 0 );
+    test_coverage( p_filter, p_pic, 1, 0 );
+    test_coverage( p_filter, p_pic, 2, 3 );
+    test_coverage( p_filter, p_pic, 0, 64 );
+    test_coverage( p_filter, p_pic, 0, 1000 );
+
+    /* Several filters at once */
+    vlc_thread_t th[4];
+    struct caller caller = { p_filter, p_pic };
+    for( unsigned i = 0; i < ARRAY_SIZE( th ); i++ )
+    {
+        int ret = vlc_clone( &th[i], Caller, &caller, VLC_THREAD_PRIORITY_LOW );
+        assert( ret == 0 );
+    }
+    for( unsigned i = 0; i < ARRAY_SIZE( th ); i++ )
+        vlc_join( th[i], NULL );
+
+    /* Informative only: the scaling depends on the machine */
+    if( b_bench )
+    {
+        for( int i = 0; i < p_pic->i_planes; i++ )
+            memset( p_pic->p[i].p_pixels, 0x80 + i,
+                    p_pic->p[i].i_pitch * p_pic->p[i].i_lines );
+
+        const picture_t *pp_pics[2] = { p_pic, p_out };
+        mtime_t i_start = mdate();
+        for( int i = 0; i < 10; i++ )
+            filter_ExecuteSlices( p_filter, p_pic, 0, 1, BlurSlice, pp_pics );
+        printf( "%u threads: %"PRId64" us per 4K frame\n", i_threads,
+                ( mdate() - i_start ) / 10 );
+    }
+
+    picture_Release( p_out );
+    picture_Release( p_pic );
+    vlc_object_release( p_filter );
+    libvlc_release( p_vlc );
+}
+
+int main( int argc, char *argv[] )
+{
+    /* filter_slices bench: also times a blur of 4K frames */
+    const bool b_bench = argc > 1 && !strcmp( argv[1], "bench" );
+
+    test_init();
+
+    test_threads( 1, b_bench );
+    test_threads( 2, b_bench );
+    test_threads( 4, b_bench );
+    test_threads( 8, b_bench );
+
+    return 0;
+}
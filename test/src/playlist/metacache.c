@@ -0,0 +1,273 @@
+/*****************************************************************************
+ * metacache.c: test for the preparser cache
+ *****************************************************************************
+ * Copyright (C) 2020 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc_common.h>
+#include "../src/playlist/metacache.c"
+#include "../../../lib/libvlc_internal.h"
+#include "../../libvlc/test.h"
+
+#include <vlc/vlc.h>
+
+const char vlc_module_name[] = "metacache";
+
+/* Not exported by the core: only remember the last restored track */
+static vlc_fourcc_t last_codec;
+static unsigned last_rate;
+
+void input_item_UpdateTracksInfo( input_item_t *item, const es_format_t *fmt )
+{
+    last_codec = fmt->i_codec;
+    last_rate = fmt->audio.i_rate;
+    (void) item;
+}
+
+static char dir[] = "/tmp/vlc-metacache-XXXXXX";
+
+static char *MakeFile( const char *name, const char *content )
+{
+    char *path;
+    assert( asprintf( &path, "%s/%s", dir, name ) >= 0 );
+
+    FILE *file = fopen( path, "wt" );
+    assert( file != NULL );
+    fputs( content, file );
+    fclose( file );
+    return path;
+}
+
+static input_item_t *NewItem( const char *path )
+{
+    char *uri = vlc_path2uri( path, NULL );
+    assert( uri != NULL );
+    input_item_t *item = input_item_New( uri, NULL );
+    assert( item != NULL );
+    free( uri );
+    return item;
+}
+
+/* Loads the cache file if needed, and counts the entries */
+static unsigned Count( playlist_metacache_t *cache )
+{
+    vlc_mutex_lock( &cache->lock );
+    EnsureLoaded( cache );
+    unsigned count = cache->i_entries;
+    vlc_mutex_unlock( &cache->lock );
+    return count;
+}
+
+static void Preparse( playlist_metacache_t *cache, const char *path,
+                      const char *title )
+{
+    input_item_t *item = NewItem( path );
+    playlist_metacache_stamp_t stamp;
+
+    assert( playlist_metacache_Restore( cache, item, &stamp ) != VLC_SUCCESS );
+    assert( stamp.b_valid );
+
+    input_item_SetTitle( item, title );
+    input_item_SetDuration( item, 42 * CLOCK_FREQ );
+
+    es_format_t *fmt = malloc( sizeof (*fmt) );
+    assert( fmt != NULL );
+    es_format_Init( fmt, AUDIO_ES, VLC_CODEC_MP3 );
+    fmt->audio.i_rate = 44100;
+    vlc_mutex_lock( &item->lock );
+    TAB_APPEND( item->i_es, item->es, fmt );
+    vlc_mutex_unlock( &item->lock );
+
+    playlist_metacache_Store( cache, item, &stamp );
+    input_item_Release( item );
+}
+
+static bool Restore( playlist_metacache_t *cache, const char *path,
+                     const char *title )
+{
+    input_item_t *item = NewItem( path );
+    playlist_metacache_stamp_t stamp;
+
+    last_codec = 0;
+    last_rate = 0;
+
+    bool ok = playlist_metacache_Restore( cache, item, &stamp ) == VLC_SUCCESS;
+    if( ok )
+    {
+        char *psz_title = input_item_GetTitle( item );
+        assert( psz_title != NULL && !strcmp( psz_title, title ) );
+        free( psz_title );
+        assert( input_item_GetDuration( item ) == 42 * CLOCK_FREQ );
+        assert( last_codec == VLC_CODEC_MP3 && last_rate == 44100 );
+    }
+    input_item_Release( item );
+    return ok;
+}
+
+static void test_save_load( vlc_object_t *obj, const char *a, const char *b )
+{
+    playlist_metacache_t *cache = playlist_metacache_New( obj );
+    assert( cache != NULL );
+    assert( Count( cache ) == 0 );
+
+    Preparse( cache, a, "first" );
+    Preparse( cache, b, "second" );
+    assert( Count( cache ) == 2 );
+    playlist_metacache_Delete( cache );
+
+    cache = playlist_metacache_New( obj );
+    assert( cache != NULL );
+    assert( Count( cache ) == 2 );
+    assert( Restore( cache, a, "first" ) );
+    assert( Restore( cache, b, "second" ) );
+    playlist_metacache_Delete( cache );
+}
+
+static void test_invalidation( vlc_object_t *obj, const char *a, const char *b )
+{
+    /* A modified file is not restored, and pruned on the next load */
+    FILE *file = fopen( b, "at" );
+    assert( file != NULL );
+    fputs( "more data\n", file );
+    fclose( file );
+
+    playlist_metacache_t *cache = playlist_metacache_New( obj );
+    assert( cache != NULL );
+    assert( Count( cache ) == 1 );
+    assert( Restore( cache, a, "first" ) );
+    assert( !Restore( cache, b, "second" ) );
+    playlist_metacache_Delete( cache );
+
+    /* So is a deleted file */
+    unlink( a );
+    cache = playlist_metacache_New( obj );
+    assert( cache != NULL );
+    assert( Count( cache ) == 0 );
+    playlist_metacache_Delete( cache );
+}
+
+static void test_limit( vlc_object_t *obj, const char *a, const char *c )
+{
+    playlist_metacache_t *cache = playlist_metacache_New( obj );
+    assert( cache != NULL );
+
+    Preparse( cache, a, "first" );
+
+    /* The least recently used entries are evicted first */
+    const playlist_metacache_stamp_t stamp = { true, 1, 1 };
+    for( unsigned i = 0; i < METACACHE_MAX_ENTRIES; i++ )
+    {
+        char uri[64];
+        sprintf( uri, "file:///nonexistent/%u", i );
+        input_item_t *item = input_item_New( uri, NULL );
+        assert( item != NULL );
+        playlist_metacache_Store( cache, item, &stamp );
+        input_item_Release( item );
+
+        if( i == METACACHE_MAX_ENTRIES / 2 )
+            assert( Restore( cache, a, "first" ) );
+    }
+
+    assert( Count( cache ) == METACACHE_MAX_ENTRIES );
+    assert( Restore( cache, a, "first" ) );
+    assert( !vlc_dictionary_has_key( &cache->entries,
+                                     "file:///nonexistent/0" ) );
+    assert( vlc_dictionary_has_key( &cache->entries,
+                                    "file:///nonexistent/1" ) );
+
+    /* The entries are saved regularly, not only on exit */
+    cache->i_next_save = 0;
+    Preparse( cache, c, "third" );
+
+    playlist_metacache_t *other = playlist_metacache_New( obj );
+    assert( other != NULL );
+    assert( Restore( other, c, "third" ) );
+    assert( Restore( other, a, "first" ) );
+    /* The missing files are pruned */
+    assert( Count( other ) == 2 );
+    playlist_metacache_Delete( other );
+
+    playlist_metacache_Delete( cache );
+}
+
+static void test_corrupted( vlc_object_t *obj, const char *a )
+{
+    static const char *const contents[] = {
+        "",
+        "VLC preparser cache 0\n",
+        "VLC preparser cache 1\n@\n@ 1 2\n@ x y file:///a\nd 1\n",
+        "VLC preparser cache 1\nm 0 orphan\n@ 1 2 %zz\n",
+    };
+
+    for( size_t i = 0; i < ARRAY_SIZE(contents); i++ )
+    {
+        char *path = MakeFile( "vlc/" METACACHE_FILE, contents[i] );
+        free( path );
+
+        playlist_metacache_t *cache = playlist_metacache_New( obj );
+        assert( cache != NULL );
+        assert( Count( cache ) == 0 );
+        assert( !Restore( cache, a, "first" ) );
+        playlist_metacache_Delete( cache );
+    }
+}
+
+int main( void )
+{
+    test_init();
+
+    assert( mkdtemp( dir ) != NULL );
+    setenv( "XDG_CACHE_HOME", dir, 1 );
+
+    const char *argv[] = { "-v" };
+    libvlc_instance_t *vlc = libvlc_new( ARRAY_SIZE(argv), argv );
+    assert( vlc != NULL );
+    vlc_object_t *obj = VLC_OBJECT(vlc->p_libvlc_int);
+
+    char *a = MakeFile( "a.mp3", "first file\n" );
+    char *b = MakeFile( "b.mp3", "second file\n" );
+
+    test_save_load( obj, a, b );
+    test_invalidation( obj, a, b );
+
+    free( MakeFile( "a.mp3", "first file again\n" ) );
+    char *c = MakeFile( "c.mp3", "third file\n" );
+    test_limit( obj, a, c );
+    test_corrupted( obj, a );
+
+    libvlc_release( vlc );
+
+    char *path;
+    assert( asprintf( &path, "%s/vlc/" METACACHE_FILE, dir ) >= 0 );
+    unlink( path );
+    free( path );
+    assert( asprintf( &path, "%s/vlc", dir ) >= 0 );
+    rmdir( path );
+    free( path );
+    unlink( c );
+    unlink( b );
+    unlink( a );
+    rmdir( dir );
+    free( c );
+    free( b );
+    free( a );
+    return 0;
+}